@@ -52,26 +52,63 @@ CorrespondenceGraph::NumCorrespondencesBetweenImages() const {
 }
 
 void CorrespondenceGraph::Finalize() {
+  size_t num_corrs = 0;
+  size_t num_corrs_offsets = 0;
   for (auto it = images_.begin(); it != images_.end();) {
     it->second.num_observations = 0;
-    for (auto& corr : it->second.corrs) {
-      corr.shrink_to_fit();
-      if (corr.size() > 0) {
+    for (point2D_t point2D_idx = 0; point2D_idx < it->second.num_points2D;
+         ++point2D_idx) {
+      const size_t num_point_corrs =
+          ImageCorrespondences(it->second, point2D_idx).size();
+      if (num_point_corrs > 0) {
         it->second.num_observations += 1;
+        num_corrs += num_point_corrs;
       }
     }
     if (it->second.num_observations == 0) {
       images_.erase(it++);
     } else {
+      num_corrs_offsets += it->second.num_points2D + 1;
       ++it;
     }
   }
+
+  // Pack the correspondences of all images into contiguous memory. Images
+  // that were packed before are copied from the previous arrays.
+  std::vector<Correspondence> corrs;
+  std::vector<point2D_t> corrs_offsets;
+  corrs.reserve(num_corrs);
+  corrs_offsets.reserve(num_corrs_offsets);
+
+  for (auto& image : images_) {
+    const size_t corrs_begin = corrs.size();
+    const size_t corrs_offsets_begin = corrs_offsets.size();
+    for (point2D_t point2D_idx = 0; point2D_idx < image.second.num_points2D;
+         ++point2D_idx) {
+      corrs_offsets.push_back(
+          static_cast<point2D_t>(corrs.size() - corrs_begin));
+      const CorrespondenceRange point_corrs =
+          ImageCorrespondences(image.second, point2D_idx);
+      corrs.insert(corrs.end(), point_corrs.begin(), point_corrs.end());
+    }
+    corrs_offsets.push_back(static_cast<point2D_t>(corrs.size() - corrs_begin));
+    image.second.corrs_begin = corrs_begin;
+    image.second.corrs_offsets_begin = corrs_offsets_begin;
+    // Release the nested correspondences right away, so that the peak memory
+    // does not hold both the full nested and the full packed graph.
+    std::vector<std::vector<Correspondence>>().swap(image.second.corrs);
+  }
+
+  corrs_.swap(corrs);
+  corrs_offsets_.swap(corrs_offsets);
 }
 
 void CorrespondenceGraph::AddImage(const image_t image_id,
                                    const size_t num_points) {
   CHECK(!ExistsImage(image_id));
-  images_[image_id].corrs.resize(num_points);
+  struct Image& image = images_[image_id];
+  image.num_points2D = static_cast<point2D_t>(num_points);
+  image.corrs.resize(num_points);
 }
 
 void CorrespondenceGraph::AddCorrespondences(const image_t image_id1,
@@ -87,6 +124,8 @@ void CorrespondenceGraph::AddCorrespondences(const image_t image_id1,
   // Corresponding images.
   struct Image& image1 = images_.at(image_id1);
   struct Image& image2 = images_.at(image_id2);
+  UnpackImage(&image1);
+  UnpackImage(&image2);
 
   // Store number of correspondences for each image to find good initial pair.
   image1.num_correspondences += matches.size();
@@ -165,7 +204,9 @@ CorrespondenceGraph::FindTransitiveCorrespondences(
     const image_t image_id, const point2D_t point2D_idx,
     const size_t transitivity) const {
   if (transitivity == 1) {
-    return FindCorrespondences(image_id, point2D_idx);
+    const CorrespondenceRange corrs =
+        FindCorrespondences(image_id, point2D_idx);
+    return std::vector<Correspondence>(corrs.begin(), corrs.end());
   }
 
   std::vector<Correspondence> found_corrs;
@@ -187,9 +228,9 @@ CorrespondenceGraph::FindTransitiveCorrespondences(
     for (size_t i = corr_queue_begin; i < corr_queue_end; ++i) {
       const Correspondence ref_corr = found_corrs[i];
 
-      const Image& image = images_.at(ref_corr.image_id);
-      const std::vector<Correspondence>& ref_corrs =
-          image.corrs[ref_corr.point2D_idx];
+      const CorrespondenceRange ref_corrs =
+          ImageCorrespondences(images_.at(ref_corr.image_id),
+                               ref_corr.point2D_idx);
 
       for (const Correspondence corr : ref_corrs) {
         // Check if correspondence already collected, otherwise collect.
@@ -235,9 +276,10 @@ FeatureMatches CorrespondenceGraph::FindCorrespondencesBetweenImages(
 
   const struct Image& image1 = images_.at(image_id1);
 
-  for (point2D_t point2D_idx1 = 0; point2D_idx1 < image1.corrs.size();
+  for (point2D_t point2D_idx1 = 0; point2D_idx1 < image1.num_points2D;
        ++point2D_idx1) {
-    for (const Correspondence& corr1 : image1.corrs[point2D_idx1]) {
+    for (const Correspondence& corr1 :
+         ImageCorrespondences(image1, point2D_idx1)) {
       if (corr1.image_id == image_id2) {
         found_corrs.emplace_back(point2D_idx1, corr1.point2D_idx);
       }
@@ -249,15 +291,26 @@ FeatureMatches CorrespondenceGraph::FindCorrespondencesBetweenImages(
 
 bool CorrespondenceGraph::IsTwoViewObservation(
     const image_t image_id, const point2D_t point2D_idx) const {
-  const struct Image& image = images_.at(image_id);
-  const std::vector<Correspondence>& corrs = image.corrs.at(point2D_idx);
+  const CorrespondenceRange corrs = FindCorrespondences(image_id, point2D_idx);
   if (corrs.size() != 1) {
     return false;
   }
-  const struct Image& other_image = images_.at(corrs[0].image_id);
-  const std::vector<Correspondence>& other_corrs =
-      other_image.corrs.at(corrs[0].point2D_idx);
-  return other_corrs.size() == 1;
+  return FindCorrespondences(corrs[0].image_id, corrs[0].point2D_idx).size() ==
+         1;
+}
+
+void CorrespondenceGraph::UnpackImage(struct Image* image) {
+  if (!image->corrs.empty() || image->num_points2D == 0) {
+    return;
+  }
+  std::vector<std::vector<Correspondence>> corrs(image->num_points2D);
+  for (point2D_t point2D_idx = 0; point2D_idx < image->num_points2D;
+       ++point2D_idx) {
+    const CorrespondenceRange point_corrs =
+        ImageCorrespondences(*image, point2D_idx);
+    corrs[point2D_idx].assign(point_corrs.begin(), point_corrs.end());
+  }
+  image->corrs.swap(corrs);
 }
 
 }  // namespace colmap
@@ -32,6 +32,7 @@
 #ifndef COLMAP_SRC_BASE_CORRESPONDENCE_GRAPH_H_
 #define COLMAP_SRC_BASE_CORRESPONDENCE_GRAPH_H_
 
+#include <stdexcept>
 #include <unordered_map>
 #include <vector>
 
@@ -57,6 +58,33 @@ class CorrespondenceGraph {
     point2D_t point2D_idx;
   };
 
+  // Read-only view of the correspondences of a single image point. The view
+  // is invalidated by any subsequent modification of the graph.
+  class CorrespondenceRange {
+   public:
+    CorrespondenceRange() : begin_(nullptr), end_(nullptr) {}
+    CorrespondenceRange(const Correspondence* begin, const Correspondence* end)
+        : begin_(begin), end_(end) {}
+
+    inline const Correspondence* begin() const { return begin_; }
+    inline const Correspondence* end() const { return end_; }
+    inline size_t size() const { return end_ - begin_; }
+    inline bool empty() const { return begin_ == end_; }
+    inline const Correspondence& operator[](const size_t idx) const {
+      return begin_[idx];
+    }
+    inline const Correspondence& at(const size_t idx) const {
+      if (idx >= size()) {
+        throw std::out_of_range("Correspondence index out of range");
+      }
+      return begin_[idx];
+    }
+
+   private:
+    const Correspondence* begin_;
+    const Correspondence* end_;
+  };
+
   CorrespondenceGraph();
 
   // Number of added images.
@@ -88,7 +116,12 @@ class CorrespondenceGraph {
   // - Calculates the number of observations per image by counting the number
   //   of image points that have at least one correspondence.
   // - Deletes images without observations, as they are useless for SfM.
-  // - Shrinks the correspondence vectors to their size to save memory.
+  // - Packs the correspondences of all images into a compressed sparse row
+  //   layout, i.e. one flat array of correspondences and one array of
+  //   per-point offsets, to save memory and to speed up traversal.
+  //
+  // Images and correspondences may still be added after finalization, in
+  // which case the affected images are unpacked again until the next call.
   void Finalize();
 
   // Add new image to the correspondence graph.
@@ -102,7 +135,7 @@ class CorrespondenceGraph {
                           const FeatureMatches& matches);
 
   // Find the correspondence of an image observation to all other images.
-  inline const std::vector<Correspondence>& FindCorrespondences(
+  inline CorrespondenceRange FindCorrespondences(
       const image_t image_id, const point2D_t point2D_idx) const;
 
   // Find correspondences to the given observation.
@@ -140,7 +173,16 @@ class CorrespondenceGraph {
     // to find a good initial pair, that is connected to many images.
     point2D_t num_correspondences = 0;
 
-    // Correspondences to other images per image point.
+    // Number of 2D points in the image.
+    point2D_t num_points2D = 0;
+
+    // Location of the packed correspondences in `corrs_` and of the per-point
+    // offsets into them in `corrs_offsets_`, set by `Finalize`.
+    size_t corrs_begin = 0;
+    size_t corrs_offsets_begin = 0;
+
+    // Correspondences to other images per image point. Only used while the
+    // graph is being built and empty once the image has been packed.
     std::vector<std::vector<Correspondence>> corrs;
   };
 
@@ -149,8 +191,21 @@ class CorrespondenceGraph {
     point2D_t num_correspondences = 0;
   };
 
+  // Unpack the correspondences of a finalized image for modification.
+  void UnpackImage(struct Image* image);
+
+  // Correspondences of an image point in either representation.
+  inline CorrespondenceRange ImageCorrespondences(
+      const struct Image& image, const point2D_t point2D_idx) const;
+
   EIGEN_STL_UMAP(image_t, Image) images_;
   std::unordered_map<image_pair_t, ImagePair> image_pairs_;
+
+  // Correspondences of all finalized images, ordered by image and point,
+  // and the offsets of each point's correspondences relative to the first
+  // correspondence of its image. An image with N points owns N + 1 offsets.
+  std::vector<Correspondence> corrs_;
+  std::vector<point2D_t> corrs_offsets_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -189,15 +244,31 @@ point2D_t CorrespondenceGraph::NumCorrespondencesBetweenImages(
   }
 }
 
-const std::vector<CorrespondenceGraph::Correspondence>&
+CorrespondenceGraph::CorrespondenceRange
 CorrespondenceGraph::FindCorrespondences(const image_t image_id,
                                          const point2D_t point2D_idx) const {
-  return images_.at(image_id).corrs.at(point2D_idx);
+  return ImageCorrespondences(images_.at(image_id), point2D_idx);
 }
 
 bool CorrespondenceGraph::HasCorrespondences(
     const image_t image_id, const point2D_t point2D_idx) const {
-  return !images_.at(image_id).corrs.at(point2D_idx).empty();
+  return !ImageCorrespondences(images_.at(image_id), point2D_idx).empty();
+}
+
+CorrespondenceGraph::CorrespondenceRange
+CorrespondenceGraph::ImageCorrespondences(const struct Image& image,
+                                          const point2D_t point2D_idx) const {
+  if (point2D_idx >= image.num_points2D) {
+    throw std::out_of_range("Point index out of range");
+  }
+  if (!image.corrs.empty()) {
+    const std::vector<Correspondence>& corrs = image.corrs[point2D_idx];
+    return CorrespondenceRange(corrs.data(), corrs.data() + corrs.size());
+  }
+  const point2D_t* offsets = &corrs_offsets_[image.corrs_offsets_begin];
+  const Correspondence* corrs = corrs_.data() + image.corrs_begin;
+  return CorrespondenceRange(corrs + offsets[point2D_idx],
+                             corrs + offsets[point2D_idx + 1]);
 }
 
 }  // namespace colmap
@@ -0,0 +1,230 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <unordered_map>
+
+#include "base/correspondence_graph.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/random.h"
+#include "util/timer.h"
+
+using namespace colmap;
+
+namespace {
+
+size_t num_allocated_bytes = 0;
+
+// Allocation header that records the requested number of bytes. It is padded
+// to keep the returned memory aligned for all fundamental types.
+union AllocationHeader {
+  size_t num_bytes;
+  std::max_align_t alignment;
+};
+
+typedef CorrespondenceGraph::Correspondence Correspondence;
+
+// Per-point vectors of correspondences, as stored by the correspondence graph
+// before it was packed into a compressed sparse row layout.
+class NestedCorrespondences {
+ public:
+  explicit NestedCorrespondences(const CorrespondenceGraph& graph,
+                                 const std::vector<image_t>& image_ids,
+                                 const point2D_t num_points2D) {
+    for (const image_t image_id : image_ids) {
+      auto& corrs = corrs_[image_id];
+      corrs.resize(num_points2D);
+      for (point2D_t point2D_idx = 0; point2D_idx < num_points2D;
+           ++point2D_idx) {
+        const auto point_corrs =
+            graph.FindCorrespondences(image_id, point2D_idx);
+        corrs[point2D_idx].assign(point_corrs.begin(), point_corrs.end());
+        corrs[point2D_idx].shrink_to_fit();
+      }
+    }
+  }
+
+  CorrespondenceGraph::CorrespondenceRange FindCorrespondences(
+      const image_t image_id, const point2D_t point2D_idx) const {
+    const auto& corrs = corrs_.at(image_id).at(point2D_idx);
+    return CorrespondenceGraph::CorrespondenceRange(
+        corrs.data(), corrs.data() + corrs.size());
+  }
+
+ private:
+  std::unordered_map<image_t, std::vector<std::vector<Correspondence>>> corrs_;
+};
+
+// Synthetic correspondence graph, in which every image is matched to its
+// neighbors in a sequence with a fixed number of matches per image pair.
+void CreateGraph(const std::vector<image_t>& image_ids,
+                 const point2D_t num_points2D, const size_t num_neighbors,
+                 const size_t num_matches, CorrespondenceGraph* graph) {
+  for (const image_t image_id : image_ids) {
+    graph->AddImage(image_id, num_points2D);
+  }
+
+  SetPRNGSeed(0);
+  for (size_t i = 0; i < image_ids.size(); ++i) {
+    const size_t end = std::min(image_ids.size(), i + num_neighbors + 1);
+    for (size_t j = i + 1; j < end; ++j) {
+      const point2D_t offset1 = RandomInteger<point2D_t>(0, num_points2D - 1);
+      const point2D_t offset2 = RandomInteger<point2D_t>(0, num_points2D - 1);
+      FeatureMatches matches(num_matches);
+      for (size_t k = 0; k < num_matches; ++k) {
+        matches[k].point2D_idx1 = (offset1 + k) % num_points2D;
+        matches[k].point2D_idx2 = (offset2 + k) % num_points2D;
+      }
+      graph->AddCorrespondences(image_ids[i], image_ids[j], matches);
+    }
+  }
+}
+
+template <typename Graph>
+void BenchmarkGraph(const std::string& name, const Graph& graph,
+                    const std::vector<image_t>& image_ids,
+                    const point2D_t num_points2D, const size_t num_bytes) {
+  const int kNumRepetitions = 3;
+
+  Timer timer;
+
+  // Traversal of all correspondences, as when counting the correspondences
+  // to registered images in `IncrementalMapper::FindNextImages`.
+  size_t num_corrs = 0;
+  timer.Start();
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    for (const image_t image_id : image_ids) {
+      for (point2D_t point2D_idx = 0; point2D_idx < num_points2D;
+           ++point2D_idx) {
+        num_corrs += graph.FindCorrespondences(image_id, point2D_idx).size();
+      }
+    }
+  }
+  const double traverse_time = timer.ElapsedSeconds() / kNumRepetitions;
+
+  // Two-level traversal starting from random observations, as when completing
+  // tracks in `IncrementalTriangulator::Complete`.
+  std::vector<std::pair<image_t, point2D_t>> observations(image_ids.size() *
+                                                          100);
+  for (auto& observation : observations) {
+    observation.first =
+        image_ids[RandomInteger<size_t>(0, image_ids.size() - 1)];
+    observation.second = RandomInteger<point2D_t>(0, num_points2D - 1);
+  }
+  size_t num_transitive_corrs = 0;
+  timer.Restart();
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    for (const auto& observation : observations) {
+      for (const auto& corr :
+           graph.FindCorrespondences(observation.first, observation.second)) {
+        num_transitive_corrs +=
+            graph.FindCorrespondences(corr.image_id, corr.point2D_idx).size();
+      }
+    }
+  }
+  const double transitive_time = timer.ElapsedSeconds() / kNumRepetitions;
+
+  std::cout << StringPrintf("%10s %10d %10.1fMB %9.4fs %9.4fs", name.c_str(),
+                            static_cast<int>(image_ids.size()),
+                            num_bytes / (1024.0 * 1024.0), traverse_time,
+                            transitive_time)
+            << std::endl;
+
+  // Prevent the compiler from optimizing away the loops.
+  CHECK_GE(num_corrs + num_transitive_corrs, 0);
+}
+
+}  // namespace
+
+void* operator new(const size_t num_bytes) {
+  char* ptr =
+      static_cast<char*>(std::malloc(sizeof(AllocationHeader) + num_bytes));
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  reinterpret_cast<AllocationHeader*>(ptr)->num_bytes = num_bytes;
+  num_allocated_bytes += num_bytes;
+  return ptr + sizeof(AllocationHeader);
+}
+
+void operator delete(void* ptr) noexcept {
+  if (ptr != nullptr) {
+    char* header_ptr = reinterpret_cast<char*>(
+        reinterpret_cast<uintptr_t>(ptr) - sizeof(AllocationHeader));
+    num_allocated_bytes -=
+        reinterpret_cast<AllocationHeader*>(header_ptr)->num_bytes;
+    std::free(header_ptr);
+  }
+}
+
+// Benchmark of the memory usage and traversal times of the correspondence
+// graph with per-point vectors of correspondences and with the packed layout
+// after finalization. Note that the memory excludes the allocator overhead,
+// which is substantially larger for the per-point vectors.
+int main(int argc, char** argv) {
+  InitializeGlog(argv);
+
+  const point2D_t kNumPoints2D = 5000;
+  const size_t kNumNeighbors = 20;
+  const size_t kNumMatches = 500;
+
+  std::cout << StringPrintf("%10s %10s %12s %10s %10s", "layout", "images",
+                            "memory", "traverse", "transitive")
+            << std::endl;
+
+  for (const size_t num_images : {100, 500, 2000}) {
+    std::vector<image_t> image_ids(num_images);
+    for (size_t i = 0; i < num_images; ++i) {
+      image_ids[i] = static_cast<image_t>(i + 1);
+    }
+
+    const size_t num_base_bytes = num_allocated_bytes;
+    CorrespondenceGraph graph;
+    CreateGraph(image_ids, kNumPoints2D, kNumNeighbors, kNumMatches, &graph);
+
+    {
+      const size_t num_graph_bytes = num_allocated_bytes;
+      const NestedCorrespondences nested_corrs(graph, image_ids, kNumPoints2D);
+      BenchmarkGraph("nested", nested_corrs, image_ids, kNumPoints2D,
+                     num_allocated_bytes - num_graph_bytes);
+    }
+
+    graph.Finalize();
+    BenchmarkGraph("csr", graph, image_ids, kNumPoints2D,
+                   num_allocated_bytes - num_base_bytes);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -371,3 +371,53 @@ BOOST_AUTO_TEST_CASE(TestDuplicate) {
   BOOST_CHECK_EQUAL(
       correspondence_graph.NumCorrespondencesBetweenImages().at(pair_id), 3);
 }
+
+BOOST_AUTO_TEST_CASE(TestAddAfterFinalize) {
+  CorrespondenceGraph correspondence_graph;
+  correspondence_graph.AddImage(0, 10);
+  correspondence_graph.AddImage(1, 10);
+  FeatureMatches matches01(2);
+  matches01[0].point2D_idx1 = 0;
+  matches01[0].point2D_idx2 = 1;
+  matches01[1].point2D_idx1 = 5;
+  matches01[1].point2D_idx2 = 6;
+  correspondence_graph.AddCorrespondences(0, 1, matches01);
+  correspondence_graph.Finalize();
+  BOOST_CHECK_EQUAL(correspondence_graph.FindCorrespondences(0, 0).size(), 1);
+  BOOST_CHECK_EQUAL(
+      correspondence_graph.FindCorrespondences(0, 0).at(0).image_id, 1);
+  BOOST_CHECK_EQUAL(
+      correspondence_graph.FindCorrespondences(0, 0).at(0).point2D_idx, 1);
+  BOOST_CHECK_EQUAL(correspondence_graph.FindCorrespondences(1, 6).size(), 1);
+  BOOST_CHECK_EQUAL(
+      correspondence_graph.FindCorrespondences(1, 6).at(0).point2D_idx, 5);
+  BOOST_CHECK(!correspondence_graph.HasCorrespondences(0, 9));
+  BOOST_CHECK_THROW(correspondence_graph.FindCorrespondences(0, 10),
+                    std::out_of_range);
+  BOOST_CHECK(correspondence_graph.IsTwoViewObservation(0, 0));
+
+  correspondence_graph.AddImage(2, 10);
+  FeatureMatches matches02(1);
+  matches02[0].point2D_idx1 = 0;
+  matches02[0].point2D_idx2 = 3;
+  correspondence_graph.AddCorrespondences(0, 2, matches02);
+  BOOST_CHECK_EQUAL(correspondence_graph.FindCorrespondences(0, 0).size(), 2);
+  BOOST_CHECK_EQUAL(correspondence_graph.FindCorrespondences(1, 6).size(), 1);
+  correspondence_graph.Finalize();
+  BOOST_CHECK_EQUAL(correspondence_graph.NumImages(), 3);
+  BOOST_CHECK_EQUAL(correspondence_graph.NumObservationsForImage(0), 2);
+  BOOST_CHECK_EQUAL(correspondence_graph.NumObservationsForImage(2), 1);
+  BOOST_CHECK_EQUAL(correspondence_graph.FindCorrespondences(0, 0).size(), 2);
+  BOOST_CHECK_EQUAL(
+      correspondence_graph.FindCorrespondences(0, 0).at(1).image_id, 2);
+  BOOST_CHECK_EQUAL(
+      correspondence_graph.FindCorrespondences(2, 3).at(0).point2D_idx, 0);
+  BOOST_CHECK(!correspondence_graph.IsTwoViewObservation(0, 0));
+  BOOST_CHECK_EQUAL(
+      correspondence_graph.FindTransitiveCorrespondences(1, 1, 2).size(), 2);
+  const FeatureMatches corrs01 =
+      correspondence_graph.FindCorrespondencesBetweenImages(0, 1);
+  BOOST_CHECK_EQUAL(corrs01.size(), 2);
+  BOOST_CHECK_EQUAL(corrs01[1].point2D_idx1, 5);
+  BOOST_CHECK_EQUAL(corrs01[1].point2D_idx2, 6);
+}
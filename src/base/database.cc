@@ -33,6 +33,7 @@
 
 #include <fstream>
 
+#include "util/misc.h"
 #include "util/sqlite3_utils.h"
 #include "util/string.h"
 #include "util/version.h"
@@ -193,6 +194,109 @@ void WriteDynamicMatrixBlob(sqlite3_stmt* sql_stmt, const MatrixType& matrix,
                                  static_cast<int>(num_bytes), SQLITE_STATIC));
 }
 
+// Number of rows that are inserted with a single multi-row INSERT statement
+// in the batched write methods. The number of bound parameters must stay
+// below SQLite's limit of 999 host parameters per statement.
+const static int kNumRowsPerBatchInsert = 32;
+
+std::string CreateBatchInsertSQL(const std::string& table_and_columns,
+                                 const int num_columns, const int num_rows) {
+  std::string row = "(";
+  for (int i = 0; i < num_columns; ++i) {
+    row += i == 0 ? "?" : ", ?";
+  }
+  row += ")";
+
+  std::string sql = "INSERT INTO " + table_and_columns + " VALUES" + row;
+  for (int i = 1; i < num_rows; ++i) {
+    sql += ", " + row;
+  }
+  sql += ";";
+
+  return sql;
+}
+
+// Row data of the matches and two-view geometries tables, which must live
+// until the statement is executed, since the blobs are bound statically.
+struct MatchesRow {
+  image_pair_t pair_id;
+  FeatureMatchesBlob blob;
+};
+
+struct TwoViewGeometryRow {
+  image_pair_t pair_id;
+  FeatureMatchesBlob inlier_matches;
+  int config;
+  bool has_matrices;
+  Eigen::Matrix3d Ft;
+  Eigen::Matrix3d Et;
+  Eigen::Matrix3d Ht;
+};
+
+MatchesRow CreateMatchesRow(const image_t image_id1, const image_t image_id2,
+                            const FeatureMatches& matches) {
+  MatchesRow row;
+  row.pair_id = Database::ImagePairToPairId(image_id1, image_id2);
+  row.blob = FeatureMatchesToBlob(matches);
+  if (Database::SwapImagePair(image_id1, image_id2)) {
+    SwapFeatureMatchesBlob(&row.blob);
+  }
+  return row;
+}
+
+TwoViewGeometryRow CreateTwoViewGeometryRow(
+    const image_t image_id1, const image_t image_id2,
+    const TwoViewGeometry& two_view_geometry) {
+  const TwoViewGeometry* two_view_geometry_ptr = &two_view_geometry;
+
+  // Invert the two-view geometry if the image pair has to be swapped.
+  std::unique_ptr<TwoViewGeometry> swapped_two_view_geometry;
+  if (Database::SwapImagePair(image_id1, image_id2)) {
+    swapped_two_view_geometry.reset(new TwoViewGeometry());
+    *swapped_two_view_geometry = two_view_geometry;
+    swapped_two_view_geometry->Invert();
+    two_view_geometry_ptr = swapped_two_view_geometry.get();
+  }
+
+  TwoViewGeometryRow row;
+  row.pair_id = Database::ImagePairToPairId(image_id1, image_id2);
+  row.inlier_matches =
+      FeatureMatchesToBlob(two_view_geometry_ptr->inlier_matches);
+  row.config = two_view_geometry_ptr->config;
+  row.has_matrices = two_view_geometry_ptr->inlier_matches.size() > 0;
+
+  // Transpose the matrices to obtain row-major data layout.
+  row.Ft = two_view_geometry_ptr->F.transpose();
+  row.Et = two_view_geometry_ptr->E.transpose();
+  row.Ht = two_view_geometry_ptr->H.transpose();
+
+  return row;
+}
+
+// Bind the row data to the parameters of a statement, starting at the
+// parameter with index `col + 1`.
+void BindMatchesRow(sqlite3_stmt* sql_stmt, const MatchesRow& row,
+                    const int col) {
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, col + 1, row.pair_id));
+  WriteDynamicMatrixBlob(sql_stmt, row.blob, col + 2);
+}
+
+void BindTwoViewGeometryRow(sqlite3_stmt* sql_stmt,
+                            const TwoViewGeometryRow& row, const int col) {
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, col + 1, row.pair_id));
+  WriteDynamicMatrixBlob(sql_stmt, row.inlier_matches, col + 2);
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, col + 5, row.config));
+  if (row.has_matrices) {
+    WriteStaticMatrixBlob(sql_stmt, row.Ft, col + 6);
+    WriteStaticMatrixBlob(sql_stmt, row.Et, col + 7);
+    WriteStaticMatrixBlob(sql_stmt, row.Ht, col + 8);
+  } else {
+    WriteStaticMatrixBlob(sql_stmt, Eigen::MatrixXd(0, 0), col + 6);
+    WriteStaticMatrixBlob(sql_stmt, Eigen::MatrixXd(0, 0), col + 7);
+    WriteStaticMatrixBlob(sql_stmt, Eigen::MatrixXd(0, 0), col + 8);
+  }
+}
+
 Camera ReadCameraRow(sqlite3_stmt* sql_stmt) {
   Camera camera;
 
@@ -278,9 +382,57 @@ void Database::Open(const std::string& path) {
   CreateTables();
   UpdateSchema();
   PrepareSQLStatements();
+
+  has_feature_generation_table_ = ExistsTable("feature_generation");
+
+  const std::string feature_store_path = GetFeatureStorePath(path);
+  if (path != ":memory:" && ExistsFile(feature_store_path)) {
+    CreateFeatureGenerationTable();
+    if (IsValidFeatureStore(feature_store_path)) {
+      // Newer commits in the feature store belong to database transactions
+      // that were not committed, e.g., because the writer was interrupted.
+      const uint64_t feature_generation = FeatureGeneration();
+      std::unique_ptr<FeatureStoreReader> feature_store_reader(
+          new FeatureStoreReader(feature_store_path, feature_generation));
+      if (feature_store_reader->Generation() == feature_generation) {
+        const size_t num_stale_entries =
+            InvalidateStaleFeatureStoreEntries(feature_store_reader.get());
+        if (num_stale_entries > 0) {
+          std::cout << StringPrintf(
+                           "WARNING: Ignoring %d stale entries in feature "
+                           "store %s. Re-export it using "
+                           "feature_store_exporter.",
+                           static_cast<int>(num_stale_entries),
+                           feature_store_path.c_str())
+                    << std::endl;
+        }
+        feature_store_path_ = feature_store_path;
+        feature_store_reader_ = std::move(feature_store_reader);
+      } else {
+        std::cout << StringPrintf(
+                         "WARNING: Ignoring feature store %s, because it is "
+                         "inconsistent with the database. Re-export it using "
+                         "feature_store_exporter.",
+                         feature_store_path.c_str())
+                  << std::endl;
+      }
+    } else {
+      std::cout << StringPrintf(
+                       "WARNING: Ignoring feature store %s, because it is "
+                       "invalid or was written by another version. Re-export "
+                       "it using feature_store_exporter.",
+                       feature_store_path.c_str())
+                << std::endl;
+    }
+  }
 }
 
 void Database::Close() {
+  feature_store_writer_.reset();
+  feature_store_reader_.reset();
+  feature_store_path_.clear();
+  has_feature_generation_table_ = false;
+
   if (database_ != nullptr) {
     FinalizeSQLStatements();
     sqlite3_close_v2(database_);
@@ -430,6 +582,10 @@ std::vector<Image> Database::ReadAllImages() const {
 }
 
 FeatureKeypoints Database::ReadKeypoints(const image_t image_id) const {
+  if (ExistsKeypointsView(image_id)) {
+    return feature_store_reader_->ReadKeypoints(image_id);
+  }
+
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_keypoints_, 1, image_id));
 
   const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_keypoints_));
@@ -442,6 +598,10 @@ FeatureKeypoints Database::ReadKeypoints(const image_t image_id) const {
 }
 
 FeatureDescriptors Database::ReadDescriptors(const image_t image_id) const {
+  if (ExistsDescriptorsView(image_id)) {
+    return feature_store_reader_->ReadDescriptors(image_id);
+  }
+
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_descriptors_, 1, image_id));
 
   const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_descriptors_));
@@ -454,6 +614,36 @@ FeatureDescriptors Database::ReadDescriptors(const image_t image_id) const {
   return descriptors;
 }
 
+bool Database::HasFeatureStore() const { return !feature_store_path_.empty(); }
+
+bool Database::ExistsKeypointsView(const image_t image_id) const {
+  return feature_store_reader_ &&
+         feature_store_reader_->ExistsKeypoints(image_id);
+}
+
+bool Database::ExistsDescriptorsView(const image_t image_id) const {
+  return feature_store_reader_ &&
+         feature_store_reader_->ExistsDescriptors(image_id);
+}
+
+FeatureKeypointsView Database::ReadKeypointsView(const image_t image_id) const {
+  CHECK(feature_store_reader_);
+  return feature_store_reader_->ReadKeypointsView(image_id);
+}
+
+FeatureDescriptorsView Database::ReadDescriptorsView(
+    const image_t image_id) const {
+  CHECK(feature_store_reader_);
+  return feature_store_reader_->ReadDescriptorsView(image_id);
+}
+
+uint64_t Database::FeatureGeneration() const {
+  if (!has_feature_generation_table_) {
+    return 0;
+  }
+  return MaxColumn("generation", "feature_generation");
+}
+
 FeatureMatches Database::ReadMatches(image_t image_id1,
                                      image_t image_id2) const {
   const image_pair_t pair_id = ImagePairToPairId(image_id1, image_id2);
@@ -652,6 +842,13 @@ image_t Database::WriteImage(const Image& image,
 
 void Database::WriteKeypoints(const image_t image_id,
                               const FeatureKeypoints& keypoints) const {
+  // The generation and feature store must be updated atomically with the
+  // keypoints, so implicitly wrap the write into a transaction if necessary.
+  const bool implicit_transaction = sqlite3_get_autocommit(database_) != 0;
+  if (implicit_transaction) {
+    BeginTransaction();
+  }
+
   const FeatureKeypointsBlob blob = FeatureKeypointsToBlob(keypoints);
 
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_write_keypoints_, 1, image_id));
@@ -659,82 +856,123 @@ void Database::WriteKeypoints(const image_t image_id,
 
   SQLITE3_CALL(sqlite3_step(sql_stmt_write_keypoints_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_write_keypoints_));
+
+  features_modified_ = true;
+
+  if (HasFeatureStore()) {
+    if (!feature_store_writer_) {
+      feature_store_writer_.reset(
+          new FeatureStoreWriter(feature_store_path_, FeatureGeneration()));
+    }
+    feature_store_writer_->WriteKeypoints(image_id, keypoints);
+    feature_store_reader_->Invalidate(image_id);
+  }
+
+  if (implicit_transaction) {
+    EndTransaction();
+  }
 }
 
 void Database::WriteDescriptors(const image_t image_id,
                                 const FeatureDescriptors& descriptors) const {
+  const bool implicit_transaction = sqlite3_get_autocommit(database_) != 0;
+  if (implicit_transaction) {
+    BeginTransaction();
+  }
+
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_write_descriptors_, 1, image_id));
   WriteDynamicMatrixBlob(sql_stmt_write_descriptors_, descriptors, 2);
 
   SQLITE3_CALL(sqlite3_step(sql_stmt_write_descriptors_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_write_descriptors_));
+
+  features_modified_ = true;
+
+  if (HasFeatureStore()) {
+    if (!feature_store_writer_) {
+      feature_store_writer_.reset(
+          new FeatureStoreWriter(feature_store_path_, FeatureGeneration()));
+    }
+    feature_store_writer_->WriteDescriptors(image_id, descriptors);
+    feature_store_reader_->Invalidate(image_id);
+  }
+
+  if (implicit_transaction) {
+    EndTransaction();
+  }
 }
 
 void Database::WriteMatches(const image_t image_id1, const image_t image_id2,
                             const FeatureMatches& matches) const {
-  const image_pair_t pair_id = ImagePairToPairId(image_id1, image_id2);
-  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_write_matches_, 1, pair_id));
-
-  // Important: the swapped data must live until the query is executed.
-  FeatureMatchesBlob blob = FeatureMatchesToBlob(matches);
-  if (SwapImagePair(image_id1, image_id2)) {
-    SwapFeatureMatchesBlob(&blob);
-    WriteDynamicMatrixBlob(sql_stmt_write_matches_, blob, 2);
-  } else {
-    WriteDynamicMatrixBlob(sql_stmt_write_matches_, blob, 2);
-  }
+  const MatchesRow row = CreateMatchesRow(image_id1, image_id2, matches);
+  BindMatchesRow(sql_stmt_write_matches_, row, 0);
 
   SQLITE3_CALL(sqlite3_step(sql_stmt_write_matches_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_write_matches_));
 }
 
+void Database::WriteMatches(
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<FeatureMatches>& matches) const {
+  CHECK_EQ(image_pairs.size(), matches.size());
+
+  std::vector<MatchesRow> rows(kNumRowsPerBatchInsert);
+
+  size_t i = 0;
+  for (; i + kNumRowsPerBatchInsert <= image_pairs.size();
+       i += kNumRowsPerBatchInsert) {
+    for (int j = 0; j < kNumRowsPerBatchInsert; ++j) {
+      rows[j] = CreateMatchesRow(image_pairs[i + j].first,
+                                 image_pairs[i + j].second, matches[i + j]);
+      BindMatchesRow(sql_stmt_write_matches_batch_, rows[j], 4 * j);
+    }
+
+    SQLITE3_CALL(sqlite3_step(sql_stmt_write_matches_batch_));
+    SQLITE3_CALL(sqlite3_reset(sql_stmt_write_matches_batch_));
+  }
+
+  for (; i < image_pairs.size(); ++i) {
+    WriteMatches(image_pairs[i].first, image_pairs[i].second, matches[i]);
+  }
+}
+
 void Database::WriteTwoViewGeometry(
     const image_t image_id1, const image_t image_id2,
     const TwoViewGeometry& two_view_geometry) const {
-  const image_pair_t pair_id = ImagePairToPairId(image_id1, image_id2);
-  SQLITE3_CALL(
-      sqlite3_bind_int64(sql_stmt_write_two_view_geometry_, 1, pair_id));
+  const TwoViewGeometryRow row =
+      CreateTwoViewGeometryRow(image_id1, image_id2, two_view_geometry);
+  BindTwoViewGeometryRow(sql_stmt_write_two_view_geometry_, row, 0);
 
-  const TwoViewGeometry* two_view_geometry_ptr = &two_view_geometry;
+  SQLITE3_CALL(sqlite3_step(sql_stmt_write_two_view_geometry_));
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_write_two_view_geometry_));
+}
 
-  // Invert the two-view geometry if the image pair has to be swapped.
-  std::unique_ptr<TwoViewGeometry> swapped_two_view_geometry;
-  if (SwapImagePair(image_id1, image_id2)) {
-    swapped_two_view_geometry.reset(new TwoViewGeometry());
-    *swapped_two_view_geometry = two_view_geometry;
-    swapped_two_view_geometry->Invert();
-    two_view_geometry_ptr = swapped_two_view_geometry.get();
-  }
+void Database::WriteTwoViewGeometries(
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<TwoViewGeometry>& two_view_geometries) const {
+  CHECK_EQ(image_pairs.size(), two_view_geometries.size());
 
-  const FeatureMatchesBlob inlier_matches =
-      FeatureMatchesToBlob(two_view_geometry_ptr->inlier_matches);
-  WriteDynamicMatrixBlob(sql_stmt_write_two_view_geometry_, inlier_matches, 2);
+  std::vector<TwoViewGeometryRow> rows(kNumRowsPerBatchInsert);
 
-  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_write_two_view_geometry_, 5,
-                                  two_view_geometry_ptr->config));
+  size_t i = 0;
+  for (; i + kNumRowsPerBatchInsert <= image_pairs.size();
+       i += kNumRowsPerBatchInsert) {
+    for (int j = 0; j < kNumRowsPerBatchInsert; ++j) {
+      rows[j] = CreateTwoViewGeometryRow(image_pairs[i + j].first,
+                                         image_pairs[i + j].second,
+                                         two_view_geometries[i + j]);
+      BindTwoViewGeometryRow(sql_stmt_write_two_view_geometries_batch_,
+                             rows[j], 8 * j);
+    }
 
-  // Transpose the matrices to obtain row-major data layout.
-  // Important: Do not move these objects inside the if-statement, because
-  // the objects must live until `sqlite3_step` is called on the statement.
-  const Eigen::Matrix3d Ft = two_view_geometry_ptr->F.transpose();
-  const Eigen::Matrix3d Et = two_view_geometry_ptr->E.transpose();
-  const Eigen::Matrix3d Ht = two_view_geometry_ptr->H.transpose();
-
-  if (two_view_geometry_ptr->inlier_matches.size() > 0) {
-    WriteStaticMatrixBlob(sql_stmt_write_two_view_geometry_, Ft, 6);
-    WriteStaticMatrixBlob(sql_stmt_write_two_view_geometry_, Et, 7);
-    WriteStaticMatrixBlob(sql_stmt_write_two_view_geometry_, Ht, 8);
-  } else {
-    WriteStaticMatrixBlob(sql_stmt_write_two_view_geometry_,
-                          Eigen::MatrixXd(0, 0), 6);
-    WriteStaticMatrixBlob(sql_stmt_write_two_view_geometry_,
-                          Eigen::MatrixXd(0, 0), 7);
-    WriteStaticMatrixBlob(sql_stmt_write_two_view_geometry_,
-                          Eigen::MatrixXd(0, 0), 8);
+    SQLITE3_CALL(sqlite3_step(sql_stmt_write_two_view_geometries_batch_));
+    SQLITE3_CALL(sqlite3_reset(sql_stmt_write_two_view_geometries_batch_));
   }
 
-  SQLITE3_CALL(sqlite3_step(sql_stmt_write_two_view_geometry_));
-  SQLITE3_CALL(sqlite3_reset(sql_stmt_write_two_view_geometry_));
+  for (; i < image_pairs.size(); ++i) {
+    WriteTwoViewGeometry(image_pairs[i].first, image_pairs[i].second,
+                         two_view_geometries[i]);
+  }
 }
 
 void Database::UpdateCamera(const Camera& camera) const {
@@ -926,6 +1164,20 @@ void Database::BeginTransaction() const {
 }
 
 void Database::EndTransaction() const {
+  // Commit the feature store before the database, such that an interrupted
+  // commit leaves a newer generation in the feature store, which is ignored.
+  if (features_modified_ && has_feature_generation_table_) {
+    const uint64_t feature_generation = FeatureGeneration() + 1;
+    const std::string sql =
+        StringPrintf("UPDATE feature_generation SET generation = %lld;",
+                     static_cast<long long>(feature_generation));
+    SQLITE3_EXEC(database_, sql.c_str(), nullptr);
+    if (feature_store_writer_) {
+      feature_store_writer_->Commit(feature_generation);
+    }
+  }
+  features_modified_ = false;
+
   SQLITE3_EXEC(database_, "END TRANSACTION", nullptr);
 }
 
@@ -1113,6 +1365,20 @@ void Database::PrepareSQLStatements() {
                                   &sql_stmt_write_two_view_geometry_, 0));
   sql_stmts_.push_back(sql_stmt_write_two_view_geometry_);
 
+  sql = CreateBatchInsertSQL("matches(pair_id, rows, cols, data)", 4,
+                             kNumRowsPerBatchInsert);
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
+                                  &sql_stmt_write_matches_batch_, 0));
+  sql_stmts_.push_back(sql_stmt_write_matches_batch_);
+
+  sql = CreateBatchInsertSQL(
+      "two_view_geometries(pair_id, rows, cols, data, config, F, E, H)", 8,
+      kNumRowsPerBatchInsert);
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
+                                  &sql_stmt_write_two_view_geometries_batch_,
+                                  0));
+  sql_stmts_.push_back(sql_stmt_write_two_view_geometries_batch_);
+
   //////////////////////////////////////////////////////////////////////////////
   // delete_*
   //////////////////////////////////////////////////////////////////////////////
@@ -1244,6 +1510,18 @@ void Database::CreateTwoViewGeometriesTable() const {
   }
 }
 
+void Database::CreateFeatureGenerationTable() const {
+  const std::string sql =
+      "CREATE TABLE IF NOT EXISTS feature_generation"
+      "   (generation  INTEGER  NOT NULL);"
+      "INSERT INTO feature_generation (generation)"
+      "   SELECT 0 WHERE NOT EXISTS (SELECT * FROM feature_generation);";
+
+  SQLITE3_EXEC(database_, sql.c_str(), nullptr);
+
+  has_feature_generation_table_ = true;
+}
+
 void Database::UpdateSchema() const {
   if (!ExistsColumn("two_view_geometries", "F")) {
     SQLITE3_EXEC(database_,
@@ -1267,6 +1545,58 @@ void Database::UpdateSchema() const {
   SQLITE3_EXEC(database_, update_user_version_sql.c_str(), nullptr);
 }
 
+size_t Database::InvalidateStaleFeatureStoreEntries(
+    FeatureStoreReader* reader) const {
+  std::unordered_map<image_t, size_t> num_keypoints;
+  std::unordered_map<image_t, std::pair<size_t, size_t>> num_descriptors;
+
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, "SELECT image_id, rows FROM keypoints;", -1, &sql_stmt, 0));
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt)) == SQLITE_ROW) {
+    num_keypoints.emplace(
+        static_cast<image_t>(sqlite3_column_int64(sql_stmt, 0)),
+        static_cast<size_t>(sqlite3_column_int64(sql_stmt, 1)));
+  }
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, "SELECT image_id, rows, cols FROM descriptors;", -1,
+      &sql_stmt, 0));
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt)) == SQLITE_ROW) {
+    num_descriptors.emplace(
+        static_cast<image_t>(sqlite3_column_int64(sql_stmt, 0)),
+        std::make_pair(static_cast<size_t>(sqlite3_column_int64(sql_stmt, 1)),
+                       static_cast<size_t>(sqlite3_column_int64(sql_stmt, 2))));
+  }
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  size_t num_stale_entries = 0;
+  for (const auto image_id : reader->ImageIds()) {
+    FeatureStoreEntry entry;
+    CHECK(reader->FindEntry(image_id, &entry));
+
+    bool stale = false;
+    if (entry.keypoints_offset > 0) {
+      const auto it = num_keypoints.find(image_id);
+      stale |= it == num_keypoints.end() || it->second != entry.num_keypoints;
+    }
+    if (entry.descriptors_offset > 0) {
+      const auto it = num_descriptors.find(image_id);
+      stale |= it == num_descriptors.end() ||
+               it->second.first != entry.num_descriptors ||
+               it->second.second != entry.descriptor_dim;
+    }
+
+    if (stale) {
+      reader->Invalidate(image_id);
+      num_stale_entries += 1;
+    }
+  }
+
+  return num_stale_entries;
+}
+
 bool Database::ExistsTable(const std::string& table_name) const {
   const std::string sql =
       "SELECT name FROM sqlite_master WHERE type='table' AND name = ?;";
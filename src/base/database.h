@@ -32,6 +32,7 @@
 #ifndef COLMAP_SRC_BASE_DATABASE_H_
 #define COLMAP_SRC_BASE_DATABASE_H_
 
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -40,6 +41,7 @@
 
 #include "SQLite/sqlite3.h"
 #include "base/camera.h"
+#include "base/feature_store.h"
 #include "base/image.h"
 #include "estimators/two_view_geometry.h"
 #include "feature/types.h"
@@ -67,7 +69,15 @@ class Database {
   ~Database();
 
   // Open and close database. The same database should not be opened
-  // concurrently in multiple threads or processes.
+  // concurrently in multiple threads or processes. If a feature store exists
+  // at `GetFeatureStorePath(path)`, it is memory-mapped and keypoints and
+  // descriptors are served from it. All subsequently written keypoints and
+  // descriptors are then also appended to the feature store and committed
+  // together with the database transaction. A feature store whose generation
+  // differs from the feature generation of the database is stale and ignored.
+  // Entries whose number of keypoints or descriptors differs from the database
+  // are ignored as well, since they were modified by a version without
+  // feature store support.
   void Open(const std::string& path);
   void Close();
 
@@ -149,6 +159,25 @@ class Database {
   FeatureKeypoints ReadKeypoints(const image_t image_id) const;
   FeatureDescriptors ReadDescriptors(const image_t image_id) const;
 
+  // Zero-copy access to the keypoints and descriptors in the memory-mapped
+  // feature store. The views are only valid until the database is closed and
+  // the entry must exist in the feature store, which is only the case if the
+  // features were written before the database was opened and have not been
+  // overwritten since. In contrast to the other methods, the views can be
+  // read concurrently from multiple threads, also while keypoints or
+  // descriptors are written.
+  bool HasFeatureStore() const;
+  bool ExistsKeypointsView(const image_t image_id) const;
+  bool ExistsDescriptorsView(const image_t image_id) const;
+  FeatureKeypointsView ReadKeypointsView(const image_t image_id) const;
+  FeatureDescriptorsView ReadDescriptorsView(const image_t image_id) const;
+
+  // The feature generation is incremented by every transaction that writes
+  // keypoints or descriptors and is used to detect stale feature stores. It is
+  // only tracked once a feature store was exported from or opened with the
+  // database and is zero before.
+  uint64_t FeatureGeneration() const;
+
   FeatureMatches ReadMatches(const image_t image_id1,
                              const image_t image_id2) const;
   std::vector<std::pair<image_pair_t, FeatureMatches>> ReadAllMatches() const;
@@ -186,6 +215,15 @@ class Database {
   void WriteTwoViewGeometry(const image_t image_id1, const image_t image_id2,
                             const TwoViewGeometry& two_view_geometry) const;
 
+  // Write the matches or two-view geometries of multiple image pairs at once
+  // using multi-row inserts, which is significantly faster than writing them
+  // one by one. The same requirements as for the single-pair methods apply.
+  void WriteMatches(const std::vector<std::pair<image_t, image_t>>& image_pairs,
+                    const std::vector<FeatureMatches>& matches) const;
+  void WriteTwoViewGeometries(
+      const std::vector<std::pair<image_t, image_t>>& image_pairs,
+      const std::vector<TwoViewGeometry>& two_view_geometries) const;
+
   // Update an existing camera in the database. The user is responsible for
   // making sure that the entry already exists.
   void UpdateCamera(const Camera& camera) const;
@@ -213,6 +251,8 @@ class Database {
 
  private:
   friend class DatabaseTransaction;
+  friend void ExportFeatureStore(const Database& database,
+                                 const std::string& path);
 
   // Combine multiple queries into one transaction by wrapping a code section
   // into a `BeginTransaction` and `EndTransaction`. You can create a scoped
@@ -236,8 +276,16 @@ class Database {
   void CreateMatchesTable() const;
   void CreateTwoViewGeometriesTable() const;
 
+  // Create the table of the feature generation, if not existing, called when
+  // a feature store is exported from or opened with the database.
+  void CreateFeatureGenerationTable() const;
+
   void UpdateSchema() const;
 
+  // Remove the entries from the feature store whose number of keypoints or
+  // descriptors differs from the database and return their number.
+  size_t InvalidateStaleFeatureStoreEntries(FeatureStoreReader* reader) const;
+
   bool ExistsTable(const std::string& table_name) const;
   bool ExistsColumn(const std::string& table_name,
                     const std::string& column_name) const;
@@ -254,6 +302,18 @@ class Database {
 
   sqlite3* database_ = nullptr;
 
+  // Memory-mapped feature store for reading and writer, which is lazily
+  // opened on the first write of keypoints or descriptors.
+  std::string feature_store_path_;
+  std::unique_ptr<FeatureStoreReader> feature_store_reader_;
+  mutable std::unique_ptr<FeatureStoreWriter> feature_store_writer_;
+
+  // Whether the current transaction wrote keypoints or descriptors.
+  mutable bool features_modified_ = false;
+
+  // Whether the database has a table of the feature generation.
+  mutable bool has_feature_generation_table_ = false;
+
   // Ensure that only one database object at a time updates the schema of a
   // database. Since the schema is updated every time a database is opened, this
   // is to ensure that there are no race conditions ("database locked" error
@@ -307,6 +367,8 @@ class Database {
   sqlite3_stmt* sql_stmt_write_descriptors_ = nullptr;
   sqlite3_stmt* sql_stmt_write_matches_ = nullptr;
   sqlite3_stmt* sql_stmt_write_two_view_geometry_ = nullptr;
+  sqlite3_stmt* sql_stmt_write_matches_batch_ = nullptr;
+  sqlite3_stmt* sql_stmt_write_two_view_geometries_batch_ = nullptr;
 
   // delete_*
   sqlite3_stmt* sql_stmt_delete_matches_ = nullptr;
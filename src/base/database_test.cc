@@ -382,6 +382,65 @@ BOOST_AUTO_TEST_CASE(TestTwoViewGeometry) {
   BOOST_CHECK_EQUAL(database.NumInlierMatches(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(TestBatchMatchesAndTwoViewGeometries) {
+  Database database(kMemoryDatabasePath);
+
+  // Use enough image pairs for multiple multi-row inserts and a remainder,
+  // where every other image pair is swapped.
+  const size_t kNumImagePairs = 70;
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<FeatureMatches> matches;
+  std::vector<TwoViewGeometry> two_view_geometries;
+  for (size_t i = 0; i < kNumImagePairs; ++i) {
+    if (i % 2 == 0) {
+      image_pairs.emplace_back(i + 1, i + 2);
+    } else {
+      image_pairs.emplace_back(i + 2, i + 1);
+    }
+    matches.emplace_back(i + 1);
+    for (size_t j = 0; j < matches.back().size(); ++j) {
+      matches.back()[j].point2D_idx1 = j;
+      matches.back()[j].point2D_idx2 = 2 * j;
+    }
+    TwoViewGeometry two_view_geometry;
+    two_view_geometry.config = TwoViewGeometry::ConfigurationType::CALIBRATED;
+    two_view_geometry.inlier_matches = matches.back();
+    two_view_geometry.F = Eigen::Matrix3d::Random();
+    two_view_geometry.E = Eigen::Matrix3d::Random();
+    two_view_geometry.H = Eigen::Matrix3d::Identity();
+    two_view_geometries.push_back(two_view_geometry);
+  }
+
+  database.WriteMatches(image_pairs, matches);
+  database.WriteTwoViewGeometries(image_pairs, two_view_geometries);
+
+  BOOST_CHECK_EQUAL(database.NumMatchedImagePairs(), kNumImagePairs);
+  BOOST_CHECK_EQUAL(database.NumVerifiedImagePairs(), kNumImagePairs);
+  BOOST_CHECK_EQUAL(database.NumMatches(),
+                    kNumImagePairs * (kNumImagePairs + 1) / 2);
+
+  for (size_t i = 0; i < kNumImagePairs; ++i) {
+    const FeatureMatches matches_read =
+        database.ReadMatches(image_pairs[i].first, image_pairs[i].second);
+    BOOST_CHECK_EQUAL(matches_read.size(), matches[i].size());
+    for (size_t j = 0; j < matches_read.size(); ++j) {
+      BOOST_CHECK_EQUAL(matches_read[j].point2D_idx1,
+                        matches[i][j].point2D_idx1);
+      BOOST_CHECK_EQUAL(matches_read[j].point2D_idx2,
+                        matches[i][j].point2D_idx2);
+    }
+
+    const TwoViewGeometry two_view_geometry_read = database.ReadTwoViewGeometry(
+        image_pairs[i].first, image_pairs[i].second);
+    BOOST_CHECK_EQUAL(two_view_geometry_read.config,
+                      two_view_geometries[i].config);
+    BOOST_CHECK_EQUAL(two_view_geometry_read.inlier_matches.size(),
+                      two_view_geometries[i].inlier_matches.size());
+    BOOST_CHECK(two_view_geometry_read.F.isApprox(two_view_geometries[i].F));
+    BOOST_CHECK(two_view_geometry_read.E.isApprox(two_view_geometries[i].E));
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestMerge) {
   Database database1(kMemoryDatabasePath);
   Database database2(kMemoryDatabasePath);
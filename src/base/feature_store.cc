@@ -0,0 +1,545 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include "base/feature_store.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "base/database.h"
+#include "util/logging.h"
+#include "util/misc.h"
+
+namespace colmap {
+namespace {
+
+const static char kFeatureStoreMagic[8] = {'C', 'O', 'L', 'M',
+                                           'A', 'P', 'F', 'S'};
+const static uint32_t kFeatureStoreVersion = 2;
+
+struct FeatureStoreHeader {
+  char magic[8];
+  uint32_t version = kFeatureStoreVersion;
+  uint32_t reserved = 0;
+  uint64_t segment_offset = 0;
+  uint64_t generation = 0;
+  uint8_t padding[32] = {0};
+};
+
+struct FeatureStoreSegmentHeader {
+  uint64_t num_entries = 0;
+  uint64_t generation = 0;
+  uint64_t prev_segment_offset = 0;
+  // Whether the segment contains all entries of its generation, such that
+  // older segments need not be read.
+  uint32_t is_complete = 0;
+  uint32_t reserved = 0;
+};
+
+static_assert(sizeof(FeatureStoreHeader) == 64,
+              "Unexpected feature store header size");
+static_assert(sizeof(FeatureStoreSegmentHeader) == 32,
+              "Unexpected feature store segment header size");
+static_assert(sizeof(FeatureStoreEntry) == 40,
+              "Unexpected feature store entry size");
+static_assert(sizeof(FeatureKeypoint) == 6 * sizeof(float),
+              "Keypoints must be stored as 6 consecutive floats");
+
+uint64_t AlignOffset(const uint64_t offset) {
+  return (offset + kFeatureStoreAlignment - 1) / kFeatureStoreAlignment *
+         kFeatureStoreAlignment;
+}
+
+bool CheckHeader(const FeatureStoreHeader& header, const uint64_t num_bytes) {
+  return std::memcmp(header.magic, kFeatureStoreMagic,
+                     sizeof(kFeatureStoreMagic)) == 0 &&
+         header.version == kFeatureStoreVersion &&
+         (header.segment_offset == 0 ||
+          (header.segment_offset >= sizeof(FeatureStoreHeader) &&
+           header.segment_offset + sizeof(FeatureStoreSegmentHeader) <=
+               num_bytes));
+}
+
+// Segments are appended to the file, so the previous segment must be located
+// before the current one, which also guarantees that the chain terminates.
+bool CheckSegment(const FeatureStoreSegmentHeader& segment,
+                  const uint64_t segment_offset, const uint64_t num_bytes) {
+  return segment.prev_segment_offset < segment_offset &&
+         (segment.prev_segment_offset == 0 ||
+          segment.prev_segment_offset >= sizeof(FeatureStoreHeader)) &&
+         segment_offset + sizeof(FeatureStoreSegmentHeader) +
+                 segment.num_entries * sizeof(FeatureStoreEntry) <=
+             num_bytes;
+}
+
+bool CheckEntry(const FeatureStoreEntry& entry, const uint64_t num_bytes) {
+  if (entry.keypoints_offset > 0 &&
+      entry.keypoints_offset + entry.num_keypoints * sizeof(FeatureKeypoint) >
+          num_bytes) {
+    return false;
+  }
+  if (entry.descriptors_offset > 0 &&
+      entry.descriptors_offset +
+              entry.num_descriptors * entry.descriptor_dim >
+          num_bytes) {
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+std::string GetFeatureStorePath(const std::string& database_path) {
+  return database_path + ".features";
+}
+
+bool IsValidFeatureStore(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  FeatureStoreHeader header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  return file.good() && CheckHeader(header, GetFileSize(path));
+}
+
+FeatureStoreReader::FeatureStoreReader(const std::string& path,
+                                       const uint64_t max_generation)
+    : file_(path), data_(file_.Data()), generation_(0) {
+  CHECK_GE(file_.NumBytes(), sizeof(FeatureStoreHeader)) << path;
+
+  FeatureStoreHeader header;
+  std::memcpy(&header, data_, sizeof(header));
+  CHECK(CheckHeader(header, file_.NumBytes()))
+      << "Invalid feature store: " << path;
+
+  // Skip the segments of newer commits and then merge the remaining segments
+  // from newest to oldest, such that newer entries take precedence.
+  bool found_generation = false;
+  uint64_t segment_offset = header.segment_offset;
+  while (segment_offset != 0) {
+    FeatureStoreSegmentHeader segment;
+    std::memcpy(&segment, data_ + segment_offset, sizeof(segment));
+    CHECK(CheckSegment(segment, segment_offset, file_.NumBytes()))
+        << "Invalid feature store segment: " << path;
+
+    if (segment.generation <= max_generation) {
+      if (!found_generation) {
+        generation_ = segment.generation;
+        found_generation = true;
+      }
+
+      const FeatureStoreEntry* entries =
+          reinterpret_cast<const FeatureStoreEntry*>(data_ + segment_offset +
+                                                     sizeof(segment));
+      for (uint64_t i = 0; i < segment.num_entries; ++i) {
+        CHECK(CheckEntry(entries[i], file_.NumBytes()))
+            << "Invalid feature store entry: " << path;
+        entries_.emplace(entries[i].image_id, entries[i]);
+      }
+
+      if (segment.is_complete) {
+        break;
+      }
+    }
+
+    segment_offset = segment.prev_segment_offset;
+  }
+}
+
+uint64_t FeatureStoreReader::Generation() const { return generation_; }
+
+size_t FeatureStoreReader::NumImages() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+std::vector<image_t> FeatureStoreReader::ImageIds() const {
+  std::vector<image_t> image_ids;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    image_ids.reserve(entries_.size());
+    for (const auto& entry : entries_) {
+      image_ids.push_back(entry.first);
+    }
+  }
+  std::sort(image_ids.begin(), image_ids.end());
+  return image_ids;
+}
+
+size_t FeatureStoreReader::NumKeypoints() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  size_t num_keypoints = 0;
+  for (const auto& entry : entries_) {
+    num_keypoints += entry.second.num_keypoints;
+  }
+  return num_keypoints;
+}
+
+size_t FeatureStoreReader::NumDescriptors() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  size_t num_descriptors = 0;
+  for (const auto& entry : entries_) {
+    num_descriptors += entry.second.num_descriptors;
+  }
+  return num_descriptors;
+}
+
+bool FeatureStoreReader::FindEntry(const image_t image_id,
+                                   FeatureStoreEntry* entry) const {
+  CHECK_NOTNULL(entry);
+  std::unique_lock<std::mutex> lock(mutex_);
+  const auto it = entries_.find(image_id);
+  if (it == entries_.end()) {
+    return false;
+  }
+  *entry = it->second;
+  return true;
+}
+
+bool FeatureStoreReader::ExistsKeypoints(const image_t image_id) const {
+  FeatureStoreEntry entry;
+  return FindEntry(image_id, &entry) && entry.keypoints_offset > 0;
+}
+
+bool FeatureStoreReader::ExistsDescriptors(const image_t image_id) const {
+  FeatureStoreEntry entry;
+  return FindEntry(image_id, &entry) && entry.descriptors_offset > 0;
+}
+
+void FeatureStoreReader::Invalidate(const image_t image_id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  entries_.erase(image_id);
+}
+
+// The mapped data of an entry remains valid after it was invalidated, since
+// the file is append-only.
+FeatureKeypointsView FeatureStoreReader::ReadKeypointsView(
+    const image_t image_id) const {
+  FeatureStoreEntry entry;
+  CHECK(FindEntry(image_id, &entry) && entry.keypoints_offset > 0);
+  return FeatureKeypointsView(reinterpret_cast<const FeatureKeypoint*>(
+                                  data_ + entry.keypoints_offset),
+                              static_cast<size_t>(entry.num_keypoints));
+}
+
+FeatureDescriptorsView FeatureStoreReader::ReadDescriptorsView(
+    const image_t image_id) const {
+  FeatureStoreEntry entry;
+  CHECK(FindEntry(image_id, &entry) && entry.descriptors_offset > 0);
+  return FeatureDescriptorsView(
+      data_ + entry.descriptors_offset,
+      static_cast<FeatureDescriptors::Index>(entry.num_descriptors),
+      static_cast<FeatureDescriptors::Index>(entry.descriptor_dim));
+}
+
+FeatureKeypoints FeatureStoreReader::ReadKeypoints(
+    const image_t image_id) const {
+  const FeatureKeypointsView view = ReadKeypointsView(image_id);
+  return FeatureKeypoints(view.begin(), view.end());
+}
+
+FeatureDescriptors FeatureStoreReader::ReadDescriptors(
+    const image_t image_id) const {
+  return ReadDescriptorsView(image_id);
+}
+
+FeatureStoreWriter::FeatureStoreWriter(const std::string& path,
+                                       const uint64_t max_generation)
+    : end_offset_(0), segment_offset_(0), generation_(0), num_segments_(0) {
+  if (ExistsFile(path)) {
+    end_offset_ = GetFileSize(path);
+
+    std::ifstream file(path, std::ios::binary);
+    CHECK(file.is_open()) << path;
+
+    FeatureStoreHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    CHECK(file.good() && CheckHeader(header, end_offset_))
+        << "Invalid feature store: " << path;
+
+    // Continue from the newest commit that is not newer than the maximum
+    // generation. The data of skipped commits is garbage and never reused.
+    uint64_t segment_offset = header.segment_offset;
+    while (segment_offset != 0) {
+      FeatureStoreSegmentHeader segment;
+      file.seekg(segment_offset);
+      file.read(reinterpret_cast<char*>(&segment), sizeof(segment));
+      CHECK(file.good() && CheckSegment(segment, segment_offset, end_offset_))
+          << "Invalid feature store segment: " << path;
+
+      if (segment.generation <= max_generation) {
+        if (num_segments_ == 0) {
+          segment_offset_ = segment_offset;
+          generation_ = segment.generation;
+        }
+        num_segments_ += 1;
+
+        std::vector<FeatureStoreEntry> entries(segment.num_entries);
+        file.read(reinterpret_cast<char*>(entries.data()),
+                  entries.size() * sizeof(FeatureStoreEntry));
+        CHECK(file.good()) << path;
+
+        for (const auto& entry : entries) {
+          CHECK(CheckEntry(entry, end_offset_))
+              << "Invalid feature store entry: " << path;
+          entries_.emplace(entry.image_id, entry);
+        }
+
+        if (segment.is_complete) {
+          break;
+        }
+      }
+
+      segment_offset = segment.prev_segment_offset;
+    }
+  } else {
+    std::ofstream file(path, std::ios::binary);
+    CHECK(file.is_open()) << path;
+    FeatureStoreHeader header;
+    std::memcpy(header.magic, kFeatureStoreMagic, sizeof(kFeatureStoreMagic));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    CHECK(file.good()) << path;
+    end_offset_ = sizeof(header);
+  }
+
+  file_.open(path, std::ios::binary | std::ios::in | std::ios::out);
+  CHECK(file_.is_open()) << path;
+}
+
+FeatureStoreWriter::~FeatureStoreWriter() { Close(); }
+
+uint64_t FeatureStoreWriter::Generation() const { return generation_; }
+
+bool FeatureStoreWriter::HasUncommittedEntries() const {
+  return !uncommitted_entries_.empty();
+}
+
+void FeatureStoreWriter::WriteKeypoints(const image_t image_id,
+                                        const FeatureKeypoints& keypoints) {
+  FeatureStoreEntry& entry = GetUncommittedEntry(image_id);
+  entry.num_keypoints = keypoints.size();
+  entry.keypoints_offset =
+      AppendData(reinterpret_cast<const char*>(keypoints.data()),
+                 keypoints.size() * sizeof(FeatureKeypoint));
+}
+
+void FeatureStoreWriter::WriteDescriptors(
+    const image_t image_id, const FeatureDescriptors& descriptors) {
+  FeatureStoreEntry& entry = GetUncommittedEntry(image_id);
+  entry.num_descriptors = static_cast<uint64_t>(descriptors.rows());
+  entry.descriptor_dim = static_cast<uint32_t>(descriptors.cols());
+  entry.descriptors_offset =
+      AppendData(reinterpret_cast<const char*>(descriptors.data()),
+                 static_cast<size_t>(descriptors.size()));
+}
+
+void FeatureStoreWriter::Commit(const uint64_t generation) {
+  CHECK(file_.is_open());
+  CHECK_GE(generation, generation_);
+
+  // Only write the changed entries, so that the cost of a commit does not
+  // depend on the total number of images in the store.
+  segment_offset_ = AppendSegment(uncommitted_entries_, generation,
+                                  segment_offset_, /*is_complete=*/false);
+  WriteHeader(segment_offset_, generation);
+
+  for (const auto& entry : uncommitted_entries_) {
+    entries_[entry.first] = entry.second;
+  }
+  uncommitted_entries_.clear();
+
+  generation_ = generation;
+  num_segments_ += 1;
+}
+
+void FeatureStoreWriter::Close() {
+  if (!file_.is_open()) {
+    return;
+  }
+
+  uncommitted_entries_.clear();
+
+  // Merge the chain of segments into a complete segment, so that readers do
+  // not have to walk it. The merged segment still links to the chain, such
+  // that older generations remain readable.
+  if (num_segments_ > 1) {
+    segment_offset_ = AppendSegment(entries_, generation_, segment_offset_,
+                                    /*is_complete=*/true);
+    WriteHeader(segment_offset_, generation_);
+    num_segments_ = 1;
+  }
+
+  file_.close();
+}
+
+uint64_t FeatureStoreWriter::AppendData(const char* data,
+                                        const size_t num_bytes) {
+  CHECK(file_.is_open());
+
+  const uint64_t offset = AlignOffset(end_offset_);
+  const std::vector<char> padding(offset - end_offset_, 0);
+
+  file_.seekp(end_offset_);
+  file_.write(padding.data(), padding.size());
+  file_.write(data, num_bytes);
+  CHECK(file_.good());
+
+  end_offset_ = offset + num_bytes;
+
+  return offset;
+}
+
+uint64_t FeatureStoreWriter::AppendSegment(
+    const std::map<image_t, FeatureStoreEntry>& entries,
+    const uint64_t generation, const uint64_t prev_segment_offset,
+    const bool is_complete) {
+  std::vector<char> data(sizeof(FeatureStoreSegmentHeader) +
+                         entries.size() * sizeof(FeatureStoreEntry));
+
+  FeatureStoreSegmentHeader segment;
+  segment.num_entries = entries.size();
+  segment.generation = generation;
+  segment.prev_segment_offset = prev_segment_offset;
+  segment.is_complete = is_complete ? 1 : 0;
+  std::memcpy(data.data(), &segment, sizeof(segment));
+
+  char* entry_data = data.data() + sizeof(segment);
+  for (const auto& entry : entries) {
+    std::memcpy(entry_data, &entry.second, sizeof(FeatureStoreEntry));
+    entry_data += sizeof(FeatureStoreEntry);
+  }
+
+  return AppendData(data.data(), data.size());
+}
+
+void FeatureStoreWriter::WriteHeader(const uint64_t segment_offset,
+                                     const uint64_t generation) {
+  FeatureStoreHeader header;
+  std::memcpy(header.magic, kFeatureStoreMagic, sizeof(kFeatureStoreMagic));
+  header.segment_offset = segment_offset;
+  header.generation = generation;
+
+  // Only update the header once the data and index are on disk, so that an
+  // interrupted writer leaves the previous index intact.
+  file_.flush();
+  file_.seekp(0);
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file_.flush();
+  CHECK(file_.good());
+}
+
+FeatureStoreEntry& FeatureStoreWriter::GetUncommittedEntry(
+    const image_t image_id) {
+  auto entry = uncommitted_entries_.find(image_id);
+  if (entry != uncommitted_entries_.end()) {
+    return entry->second;
+  }
+
+  // Start from the committed entry, such that writing only the keypoints or
+  // descriptors keeps the other part of the entry.
+  const auto committed_entry = entries_.find(image_id);
+  if (committed_entry != entries_.end()) {
+    return uncommitted_entries_.emplace(image_id, committed_entry->second)
+        .first->second;
+  }
+
+  FeatureStoreEntry& new_entry = uncommitted_entries_[image_id];
+  new_entry.image_id = image_id;
+  return new_entry;
+}
+
+void ExportFeatureStore(const Database& database, const std::string& path) {
+  // Write to a new file, since the writer appends to existing files, and only
+  // replace the existing file once the export is complete.
+  const std::string temp_path = path + ".tmp";
+  if (ExistsFile(temp_path)) {
+    CHECK_EQ(std::remove(temp_path.c_str()), 0) << temp_path;
+  }
+
+  // From now on, the database tracks the feature generation, such that
+  // modifications without the feature store are detected.
+  database.CreateFeatureGenerationTable();
+
+  FeatureStoreWriter writer(temp_path);
+  for (const auto& image : database.ReadAllImages()) {
+    if (database.ExistsKeypoints(image.ImageId())) {
+      writer.WriteKeypoints(image.ImageId(),
+                            database.ReadKeypoints(image.ImageId()));
+    }
+    if (database.ExistsDescriptors(image.ImageId())) {
+      writer.WriteDescriptors(image.ImageId(),
+                              database.ReadDescriptors(image.ImageId()));
+    }
+  }
+  writer.Commit(database.FeatureGeneration());
+  writer.Close();
+
+  CHECK_EQ(std::rename(temp_path.c_str(), path.c_str()), 0)
+      << "Failed to replace " << path;
+}
+
+size_t ImportFeatureStore(const std::string& path, Database* database) {
+  CHECK_NOTNULL(database);
+
+  const FeatureStoreReader reader(path);
+
+  DatabaseTransaction database_transaction(database);
+
+  size_t num_imported_images = 0;
+  for (const auto image_id : reader.ImageIds()) {
+    if (!database->ExistsImage(image_id)) {
+      continue;
+    }
+
+    bool imported = false;
+    if (reader.ExistsKeypoints(image_id) &&
+        !database->ExistsKeypoints(image_id)) {
+      database->WriteKeypoints(image_id, reader.ReadKeypoints(image_id));
+      imported = true;
+    }
+    if (reader.ExistsDescriptors(image_id) &&
+        !database->ExistsDescriptors(image_id)) {
+      database->WriteDescriptors(image_id, reader.ReadDescriptors(image_id));
+      imported = true;
+    }
+
+    if (imported) {
+      num_imported_images += 1;
+    }
+  }
+
+  return num_imported_images;
+}
+
+}  // namespace colmap
@@ -0,0 +1,227 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_BASE_FEATURE_STORE_H_
+#define COLMAP_SRC_BASE_FEATURE_STORE_H_
+
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "feature/types.h"
+#include "util/mapped_file.h"
+#include "util/types.h"
+
+namespace colmap {
+
+class Database;
+
+// The feature store is a flat binary file next to the SQLite database that
+// holds the keypoints and descriptors of all images in contiguous arrays. In
+// contrast to the SQLite blobs, the file is memory-mapped for reading and
+// keypoints and descriptors can be accessed without any deserialization.
+//
+// The file layout in native byte order is:
+//
+//    header (64 bytes): magic, version, offset and generation of the last
+//                       index segment
+//    data:              per-image keypoint arrays (6 floats per keypoint) and
+//                       descriptor arrays (row-major uint8), each aligned to
+//                       `kFeatureStoreAlignment` bytes
+//    index segments:    a segment header with the number of entries, the
+//                       generation, the offset of the previous segment, and
+//                       whether the segment is complete, followed by one
+//                       `FeatureStoreEntry` per image
+//
+// The file is append-only: every commit writes the new data and a segment
+// with the entries of the changed images after the end of the file and only
+// then updates the header. Thus, existing memory mappings stay valid and the
+// file stays consistent if the writer is interrupted. The index is the union
+// of the segments in the chain up to the first complete segment, where newer
+// segments take precedence. Every segment is tagged with the generation of
+// its commit, such that the state of an earlier commit can be read by
+// ignoring all newer segments. The database uses this to fall back to its own
+// generation, if a transaction was interrupted after committing the feature
+// store but before committing the database.
+
+const static size_t kFeatureStoreAlignment = 64;
+const static uint64_t kMaxFeatureStoreGeneration =
+    std::numeric_limits<uint64_t>::max();
+
+struct FeatureStoreEntry {
+  // Byte offsets of the keypoints and descriptors in the file or zero, if the
+  // image has no keypoints or descriptors in the store.
+  uint64_t keypoints_offset = 0;
+  uint64_t descriptors_offset = 0;
+  uint64_t num_keypoints = 0;
+  uint64_t num_descriptors = 0;
+  uint32_t image_id = kInvalidImageId;
+  uint32_t descriptor_dim = 0;
+};
+
+// Path of the feature store that belongs to the given database.
+std::string GetFeatureStorePath(const std::string& database_path);
+
+// Check whether the file at the given path is a feature store of the current
+// version, without mapping it.
+bool IsValidFeatureStore(const std::string& path);
+
+// Read-only, memory-mapped access to a feature store file. The index is read
+// once on construction from the newest commit whose generation is not greater
+// than `max_generation`, so entries committed to the file afterwards are not
+// visible. The class is thread-safe, i.e., entries can be invalidated while
+// other threads read from the store.
+class FeatureStoreReader {
+ public:
+  explicit FeatureStoreReader(
+      const std::string& path,
+      const uint64_t max_generation = kMaxFeatureStoreGeneration);
+
+  // The generation of the read commit or zero, if the store is empty.
+  uint64_t Generation() const;
+
+  size_t NumImages() const;
+  std::vector<image_t> ImageIds() const;
+
+  // The total number of keypoints and descriptors of all images.
+  size_t NumKeypoints() const;
+  size_t NumDescriptors() const;
+
+  // Copy the index entry of an image. Returns false if the image is not in
+  // the store.
+  bool FindEntry(const image_t image_id, FeatureStoreEntry* entry) const;
+
+  bool ExistsKeypoints(const image_t image_id) const;
+  bool ExistsDescriptors(const image_t image_id) const;
+
+  // Remove the entry of an image from the index, e.g., because it is stale.
+  // Views that were read before remain valid.
+  void Invalidate(const image_t image_id);
+
+  // Zero-copy access to the mapped data. The entry must exist.
+  FeatureKeypointsView ReadKeypointsView(const image_t image_id) const;
+  FeatureDescriptorsView ReadDescriptorsView(const image_t image_id) const;
+
+  // Copy the mapped data into newly allocated containers. The entry must exist.
+  FeatureKeypoints ReadKeypoints(const image_t image_id) const;
+  FeatureDescriptors ReadDescriptors(const image_t image_id) const;
+
+ private:
+  NON_COPYABLE(FeatureStoreReader)
+  NON_MOVABLE(FeatureStoreReader)
+
+  const MappedFile file_;
+  const uint8_t* data_;
+  uint64_t generation_;
+
+  // Guards the index, which is modified by `Invalidate`.
+  mutable std::mutex mutex_;
+  std::unordered_map<image_t, FeatureStoreEntry> entries_;
+};
+
+// Append keypoints and descriptors to a new or existing feature store file.
+// The writer continues from the newest commit whose generation is not greater
+// than `max_generation`, so that newer commits are discarded. Written entries
+// replace previous entries of the same image, but only become visible to new
+// readers on `Commit`. The same file must not be written concurrently by
+// multiple writers.
+class FeatureStoreWriter {
+ public:
+  explicit FeatureStoreWriter(
+      const std::string& path,
+      const uint64_t max_generation = kMaxFeatureStoreGeneration);
+  ~FeatureStoreWriter();
+
+  // The generation of the last commit or zero, if nothing was committed.
+  uint64_t Generation() const;
+
+  // Whether there are written entries that are not yet committed.
+  bool HasUncommittedEntries() const;
+
+  void WriteKeypoints(const image_t image_id,
+                      const FeatureKeypoints& keypoints);
+  void WriteDescriptors(const image_t image_id,
+                        const FeatureDescriptors& descriptors);
+
+  // Write an index segment with the uncommitted entries and update the header.
+  // The generation must not be smaller than the generation of the last commit.
+  void Commit(const uint64_t generation);
+
+  // Discard the uncommitted entries, merge all index segments into a single
+  // segment, and close the file.
+  void Close();
+
+ private:
+  NON_COPYABLE(FeatureStoreWriter)
+  NON_MOVABLE(FeatureStoreWriter)
+
+  uint64_t AppendData(const char* data, const size_t num_bytes);
+  uint64_t AppendSegment(const std::map<image_t, FeatureStoreEntry>& entries,
+                         const uint64_t generation,
+                         const uint64_t prev_segment_offset,
+                         const bool is_complete);
+  void WriteHeader(const uint64_t segment_offset, const uint64_t generation);
+  FeatureStoreEntry& GetUncommittedEntry(const image_t image_id);
+
+  std::fstream file_;
+  uint64_t end_offset_;
+  uint64_t segment_offset_;
+  uint64_t generation_;
+  size_t num_segments_;
+  std::map<image_t, FeatureStoreEntry> entries_;
+  std::map<image_t, FeatureStoreEntry> uncommitted_entries_;
+};
+
+// Write the keypoints and descriptors of all images in the database to the
+// feature store at the given path. The store is committed with the feature
+// generation of the database, so that the database uses it when it is opened
+// next time. If not yet existing, this creates the `feature_generation` table
+// in the database. An existing file at the path is replaced once the export is
+// complete. Note that the features are read through the database, so the
+// database should not have the replaced feature store attached, since
+// otherwise stale features could be exported.
+void ExportFeatureStore(const Database& database, const std::string& path);
+
+// Import the keypoints and descriptors from the feature store at the given
+// path into the database. Only images that exist in the database and have no
+// keypoints or descriptors yet are imported. Returns the number of images for
+// which features were imported.
+size_t ImportFeatureStore(const std::string& path, Database* database);
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_BASE_FEATURE_STORE_H_
@@ -0,0 +1,539 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "base/feature_store"
+#include "util/testing.h"
+
+#include <atomic>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include "base/database.h"
+#include "base/feature_store.h"
+#include "util/misc.h"
+
+using namespace colmap;
+
+namespace {
+
+FeatureKeypoints CreateKeypoints(const size_t num_keypoints) {
+  FeatureKeypoints keypoints(num_keypoints);
+  for (size_t i = 0; i < num_keypoints; ++i) {
+    keypoints[i] = FeatureKeypoint(i, 2 * i, 1, 2, 3, 4 + i);
+  }
+  return keypoints;
+}
+
+FeatureDescriptors CreateDescriptors(const size_t num_descriptors) {
+  FeatureDescriptors descriptors(num_descriptors, 128);
+  for (size_t i = 0; i < num_descriptors; ++i) {
+    for (int j = 0; j < 128; ++j) {
+      descriptors(i, j) = static_cast<uint8_t>(i + j);
+    }
+  }
+  return descriptors;
+}
+
+void CheckKeypoints(const FeatureKeypoints& keypoints,
+                    const FeatureKeypointsView& view) {
+  BOOST_CHECK_EQUAL(keypoints.size(), view.size());
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    BOOST_CHECK_EQUAL(keypoints[i].x, view[i].x);
+    BOOST_CHECK_EQUAL(keypoints[i].y, view[i].y);
+    BOOST_CHECK_EQUAL(keypoints[i].a11, view[i].a11);
+    BOOST_CHECK_EQUAL(keypoints[i].a12, view[i].a12);
+    BOOST_CHECK_EQUAL(keypoints[i].a21, view[i].a21);
+    BOOST_CHECK_EQUAL(keypoints[i].a22, view[i].a22);
+  }
+}
+
+bool ExistsFeatureGenerationTable(const std::string& database_path) {
+  sqlite3* sqlite_database;
+  sqlite3_open(database_path.c_str(), &sqlite_database);
+  sqlite3_stmt* sql_stmt;
+  sqlite3_prepare_v2(sqlite_database,
+                     "SELECT name FROM sqlite_master WHERE type='table' AND "
+                     "name='feature_generation';",
+                     -1, &sql_stmt, nullptr);
+  const bool exists = sqlite3_step(sql_stmt) == SQLITE_ROW;
+  sqlite3_finalize(sql_stmt);
+  sqlite3_close(sqlite_database);
+  return exists;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestWriteRead) {
+  const std::string path = CreateTempPath();
+
+  const FeatureKeypoints keypoints1 = CreateKeypoints(10);
+  const FeatureKeypoints keypoints2 = CreateKeypoints(0);
+  const FeatureDescriptors descriptors1 = CreateDescriptors(10);
+
+  {
+    FeatureStoreWriter writer(path);
+    writer.WriteKeypoints(1, keypoints1);
+    writer.WriteDescriptors(1, descriptors1);
+    writer.WriteKeypoints(2, keypoints2);
+    writer.Commit(1);
+  }
+
+  FeatureStoreReader reader(path);
+  BOOST_CHECK_EQUAL(reader.Generation(), 1);
+  BOOST_CHECK_EQUAL(reader.NumImages(), 2);
+  BOOST_CHECK_EQUAL(reader.ImageIds().at(0), 1);
+  BOOST_CHECK_EQUAL(reader.ImageIds().at(1), 2);
+  BOOST_CHECK(reader.ExistsKeypoints(1));
+  BOOST_CHECK(reader.ExistsDescriptors(1));
+  BOOST_CHECK(reader.ExistsKeypoints(2));
+  BOOST_CHECK(!reader.ExistsDescriptors(2));
+  BOOST_CHECK(!reader.ExistsKeypoints(3));
+
+  CheckKeypoints(keypoints1, reader.ReadKeypointsView(1));
+  CheckKeypoints(keypoints2, reader.ReadKeypointsView(2));
+  BOOST_CHECK_EQUAL(reader.ReadKeypoints(1).size(), keypoints1.size());
+
+  const FeatureDescriptorsView descriptors_view = reader.ReadDescriptorsView(1);
+  BOOST_CHECK_EQUAL(descriptors_view.rows(), 10);
+  BOOST_CHECK_EQUAL(descriptors_view.cols(), 128);
+  BOOST_CHECK(descriptors_view == descriptors1);
+  BOOST_CHECK_EQUAL(
+      reinterpret_cast<uintptr_t>(descriptors_view.data()) %
+          kFeatureStoreAlignment,
+      0);
+  BOOST_CHECK(reader.ReadDescriptors(1) == descriptors1);
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestConcurrentInvalidate) {
+  const std::string path = CreateTempPath();
+
+  const int kNumImages = 100;
+  {
+    FeatureStoreWriter writer(path);
+    for (int i = 1; i <= kNumImages; ++i) {
+      writer.WriteKeypoints(i, CreateKeypoints(i));
+    }
+    writer.Commit(1);
+  }
+
+  // Invalidate the entries while other threads read them. Every read must
+  // either see the full entry or no entry at all.
+  FeatureStoreReader reader(path);
+  std::atomic<int> num_invalid_reads(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&]() {
+      for (int k = 0; k < 100; ++k) {
+        for (int i = 1; i <= kNumImages; ++i) {
+          FeatureStoreEntry entry;
+          if (reader.FindEntry(i, &entry) &&
+              entry.num_keypoints != static_cast<uint64_t>(i)) {
+            num_invalid_reads += 1;
+          }
+        }
+      }
+    });
+  }
+  for (int i = 1; i <= kNumImages; ++i) {
+    reader.Invalidate(i);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  BOOST_CHECK_EQUAL(num_invalid_reads, 0);
+  BOOST_CHECK_EQUAL(reader.NumImages(), 0);
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestAppend) {
+  const std::string path = CreateTempPath();
+
+  const FeatureKeypoints keypoints1 = CreateKeypoints(10);
+  const FeatureKeypoints keypoints2 = CreateKeypoints(20);
+  const FeatureKeypoints keypoints3 = CreateKeypoints(5);
+
+  {
+    FeatureStoreWriter writer(path);
+    writer.WriteKeypoints(1, keypoints1);
+    writer.Commit(1);
+  }
+
+  // Existing mappings must remain valid while the file is appended.
+  FeatureStoreReader reader1(path);
+  const FeatureKeypointsView view1 = reader1.ReadKeypointsView(1);
+
+  {
+    FeatureStoreWriter writer(path);
+    writer.WriteKeypoints(2, keypoints2);
+    writer.WriteKeypoints(1, keypoints3);
+    writer.Commit(2);
+  }
+
+  CheckKeypoints(keypoints1, view1);
+  BOOST_CHECK_EQUAL(reader1.NumImages(), 1);
+
+  FeatureStoreReader reader2(path);
+  BOOST_CHECK_EQUAL(reader2.NumImages(), 2);
+  CheckKeypoints(keypoints3, reader2.ReadKeypointsView(1));
+  CheckKeypoints(keypoints2, reader2.ReadKeypointsView(2));
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestGeneration) {
+  const std::string path = CreateTempPath();
+
+  const FeatureKeypoints keypoints1 = CreateKeypoints(10);
+  const FeatureKeypoints keypoints2 = CreateKeypoints(20);
+  const FeatureDescriptors descriptors1 = CreateDescriptors(10);
+
+  {
+    FeatureStoreWriter writer(path);
+    BOOST_CHECK_EQUAL(writer.Generation(), 0);
+    writer.WriteKeypoints(1, keypoints1);
+    writer.WriteDescriptors(1, descriptors1);
+    BOOST_CHECK(writer.HasUncommittedEntries());
+    writer.Commit(1);
+    BOOST_CHECK(!writer.HasUncommittedEntries());
+    writer.WriteKeypoints(1, keypoints2);
+    writer.Commit(2);
+    // Uncommitted entries are discarded on close.
+    writer.WriteKeypoints(2, keypoints2);
+  }
+
+  {
+    FeatureStoreReader reader(path);
+    BOOST_CHECK_EQUAL(reader.Generation(), 2);
+    BOOST_CHECK_EQUAL(reader.NumImages(), 1);
+    CheckKeypoints(keypoints2, reader.ReadKeypointsView(1));
+    BOOST_CHECK(reader.ReadDescriptorsView(1) == descriptors1);
+  }
+
+  {
+    // Older generations remain readable.
+    FeatureStoreReader reader(path, 1);
+    BOOST_CHECK_EQUAL(reader.Generation(), 1);
+    CheckKeypoints(keypoints1, reader.ReadKeypointsView(1));
+    FeatureStoreReader empty_reader(path, 0);
+    BOOST_CHECK_EQUAL(empty_reader.Generation(), 0);
+    BOOST_CHECK_EQUAL(empty_reader.NumImages(), 0);
+  }
+
+  {
+    // Discard the commit of generation 3 by continuing from generation 2.
+    FeatureStoreWriter writer(path);
+    writer.WriteKeypoints(3, keypoints1);
+    writer.Commit(3);
+  }
+  {
+    FeatureStoreWriter writer(path, 2);
+    BOOST_CHECK_EQUAL(writer.Generation(), 2);
+    writer.WriteKeypoints(4, keypoints1);
+    writer.Commit(3);
+  }
+
+  FeatureStoreReader reader(path);
+  BOOST_CHECK_EQUAL(reader.Generation(), 3);
+  BOOST_CHECK_EQUAL(reader.NumImages(), 2);
+  BOOST_CHECK(!reader.ExistsKeypoints(3));
+  CheckKeypoints(keypoints1, reader.ReadKeypointsView(4));
+  CheckKeypoints(keypoints2, reader.ReadKeypointsView(1));
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestFeatureGenerationTable) {
+  const std::string database_path = CreateTempPath();
+  const std::string feature_store_path = GetFeatureStorePath(database_path);
+
+  {
+    Database database(database_path);
+    Camera camera;
+    camera.InitializeWithName("SIMPLE_PINHOLE", 1, 1, 1);
+    Image image;
+    image.SetName("image");
+    image.SetCameraId(database.WriteCamera(camera));
+    image.SetImageId(database.WriteImage(image));
+    database.WriteKeypoints(image.ImageId(), CreateKeypoints(10));
+    BOOST_CHECK_EQUAL(database.FeatureGeneration(), 0);
+  }
+
+  // The table is only created for databases with a feature store.
+  BOOST_CHECK(!ExistsFeatureGenerationTable(database_path));
+
+  {
+    Database database(database_path);
+    ExportFeatureStore(database, feature_store_path);
+    BOOST_CHECK_EQUAL(database.FeatureGeneration(), 0);
+  }
+
+  BOOST_CHECK(ExistsFeatureGenerationTable(database_path));
+
+  {
+    Database database(database_path);
+    BOOST_CHECK(database.HasFeatureStore());
+    database.WriteDescriptors(1, CreateDescriptors(10));
+    BOOST_CHECK_EQUAL(database.FeatureGeneration(), 1);
+  }
+
+  boost::filesystem::remove(database_path);
+  boost::filesystem::remove(feature_store_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestDatabase) {
+  const std::string database_path = CreateTempPath();
+  const std::string feature_store_path = GetFeatureStorePath(database_path);
+
+  const FeatureKeypoints keypoints1 = CreateKeypoints(10);
+  const FeatureKeypoints keypoints2 = CreateKeypoints(20);
+  const FeatureDescriptors descriptors1 = CreateDescriptors(10);
+  const FeatureDescriptors descriptors2 = CreateDescriptors(20);
+
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_PINHOLE", 1, 1, 1);
+  Image image1;
+  image1.SetName("image1");
+  Image image2;
+  image2.SetName("image2");
+
+  {
+    Database database(database_path);
+    BOOST_CHECK(!database.HasFeatureStore());
+    camera.SetCameraId(database.WriteCamera(camera));
+    image1.SetCameraId(camera.CameraId());
+    image2.SetCameraId(image1.CameraId());
+    image1.SetImageId(database.WriteImage(image1));
+    image2.SetImageId(database.WriteImage(image2));
+    database.WriteKeypoints(image1.ImageId(), keypoints1);
+    database.WriteDescriptors(image1.ImageId(), descriptors1);
+    ExportFeatureStore(database, feature_store_path);
+  }
+
+  {
+    // Features written while the store is open are only visible after
+    // re-opening the database, but they are still served from SQLite.
+    Database database(database_path);
+    BOOST_CHECK(database.HasFeatureStore());
+    BOOST_CHECK(database.ExistsKeypointsView(image1.ImageId()));
+    BOOST_CHECK(!database.ExistsKeypointsView(image2.ImageId()));
+    database.WriteKeypoints(image2.ImageId(), keypoints2);
+    database.WriteDescriptors(image2.ImageId(), descriptors2);
+    BOOST_CHECK(!database.ExistsKeypointsView(image2.ImageId()));
+    BOOST_CHECK_EQUAL(database.ReadKeypoints(image2.ImageId()).size(), 20);
+  }
+
+  {
+    Database database(database_path);
+    CheckKeypoints(keypoints1, database.ReadKeypointsView(image1.ImageId()));
+    CheckKeypoints(keypoints2, database.ReadKeypointsView(image2.ImageId()));
+    BOOST_CHECK(database.ReadDescriptorsView(image1.ImageId()) == descriptors1);
+    BOOST_CHECK(database.ReadDescriptorsView(image2.ImageId()) == descriptors2);
+    BOOST_CHECK(database.ReadDescriptors(image2.ImageId()) == descriptors2);
+    BOOST_CHECK_EQUAL(database.ReadKeypoints(image1.ImageId()).size(), 10);
+  }
+
+  {
+    const std::string imported_database_path = CreateTempPath();
+    Database database(imported_database_path);
+    database.WriteCamera(camera, /*use_camera_id=*/true);
+    database.WriteImage(image1, /*use_image_id=*/true);
+    BOOST_CHECK_EQUAL(ImportFeatureStore(feature_store_path, &database), 1);
+    BOOST_CHECK(!database.HasFeatureStore());
+    BOOST_CHECK_EQUAL(database.NumKeypoints(), 10);
+    BOOST_CHECK(database.ReadDescriptors(image1.ImageId()) == descriptors1);
+    database.Close();
+    boost::filesystem::remove(imported_database_path);
+  }
+
+  boost::filesystem::remove(database_path);
+  boost::filesystem::remove(feature_store_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestStaleAndReexport) {
+  const std::string database_path = CreateTempPath();
+  const std::string feature_store_path = GetFeatureStorePath(database_path);
+  const std::string moved_feature_store_path = CreateTempPath();
+
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_PINHOLE", 1, 1, 1);
+  Image image1;
+  image1.SetName("image1");
+  Image image2;
+  image2.SetName("image2");
+
+  {
+    Database database(database_path);
+    camera.SetCameraId(database.WriteCamera(camera));
+    image1.SetCameraId(camera.CameraId());
+    image2.SetCameraId(camera.CameraId());
+    image1.SetImageId(database.WriteImage(image1));
+    image2.SetImageId(database.WriteImage(image2));
+    database.WriteKeypoints(image1.ImageId(), CreateKeypoints(10));
+    database.WriteDescriptors(image1.ImageId(), CreateDescriptors(10));
+
+    // Exporting again replaces the file instead of appending to it.
+    ExportFeatureStore(database, feature_store_path);
+    const size_t num_bytes = GetFileSize(feature_store_path);
+    ExportFeatureStore(database, feature_store_path);
+    BOOST_CHECK_EQUAL(GetFileSize(feature_store_path), num_bytes);
+    BOOST_CHECK(!ExistsFile(feature_store_path + ".tmp"));
+  }
+
+  // Modify the database without the feature store.
+  boost::filesystem::rename(feature_store_path, moved_feature_store_path);
+  {
+    Database database(database_path);
+    BOOST_CHECK(!database.HasFeatureStore());
+    database.WriteKeypoints(image2.ImageId(), CreateKeypoints(20));
+    database.WriteDescriptors(image2.ImageId(), CreateDescriptors(20));
+  }
+  boost::filesystem::rename(moved_feature_store_path, feature_store_path);
+
+  {
+    Database database(database_path);
+    BOOST_CHECK(!database.HasFeatureStore());
+    BOOST_CHECK_EQUAL(database.ReadKeypoints(image2.ImageId()).size(), 20);
+    ExportFeatureStore(database, feature_store_path);
+  }
+
+  {
+    Database database(database_path);
+    BOOST_CHECK(database.HasFeatureStore());
+    BOOST_CHECK(database.ExistsKeypointsView(image1.ImageId()));
+    BOOST_CHECK(database.ExistsKeypointsView(image2.ImageId()));
+    CheckKeypoints(CreateKeypoints(20),
+                   database.ReadKeypointsView(image2.ImageId()));
+  }
+
+  boost::filesystem::remove(database_path);
+  boost::filesystem::remove(feature_store_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestStaleEntries) {
+  const std::string database_path = CreateTempPath();
+  const std::string feature_store_path = GetFeatureStorePath(database_path);
+  const std::string moved_feature_store_path = CreateTempPath();
+
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_PINHOLE", 1, 1, 1);
+  Image image1;
+  image1.SetName("image1");
+  Image image2;
+  image2.SetName("image2");
+
+  FeatureKeypoints keypoints1 = CreateKeypoints(10);
+  {
+    Database database(database_path);
+    camera.SetCameraId(database.WriteCamera(camera));
+    image1.SetCameraId(camera.CameraId());
+    image2.SetCameraId(camera.CameraId());
+    image1.SetImageId(database.WriteImage(image1));
+    image2.SetImageId(database.WriteImage(image2));
+    database.WriteKeypoints(image1.ImageId(), keypoints1);
+    database.WriteDescriptors(image1.ImageId(), CreateDescriptors(10));
+    database.WriteDescriptors(image2.ImageId(), CreateDescriptors(20));
+    ExportFeatureStore(database, feature_store_path);
+  }
+
+  // An interrupted commit leaves a newer generation in the feature store,
+  // which must be ignored.
+  {
+    Database database(database_path);
+    FeatureStoreWriter writer(feature_store_path);
+    writer.WriteKeypoints(image1.ImageId(), CreateKeypoints(5));
+    writer.Commit(database.FeatureGeneration() + 1);
+  }
+  {
+    Database database(database_path);
+    BOOST_CHECK(database.HasFeatureStore());
+    CheckKeypoints(keypoints1, database.ReadKeypointsView(image1.ImageId()));
+    // The next commit must not build on top of the interrupted commit.
+    DatabaseTransaction database_transaction(&database);
+    database.WriteKeypoints(image2.ImageId(), CreateKeypoints(20));
+  }
+  {
+    Database database(database_path);
+    BOOST_CHECK(database.HasFeatureStore());
+    CheckKeypoints(keypoints1, database.ReadKeypointsView(image1.ImageId()));
+    BOOST_CHECK(database.ExistsKeypointsView(image2.ImageId()));
+  }
+
+  // Replace the keypoints of an image with the same number of keypoints
+  // without the feature store.
+  boost::filesystem::rename(feature_store_path, moved_feature_store_path);
+  keypoints1 = CreateKeypoints(10);
+  keypoints1[0].x = 100;
+  {
+    Database database(database_path);
+    sqlite3* sqlite_database;
+    sqlite3_open(database_path.c_str(), &sqlite_database);
+    sqlite3_exec(sqlite_database, "DELETE FROM keypoints WHERE image_id = 1;",
+                 nullptr, nullptr, nullptr);
+    sqlite3_close(sqlite_database);
+    database.WriteKeypoints(image1.ImageId(), keypoints1);
+  }
+  boost::filesystem::rename(moved_feature_store_path, feature_store_path);
+
+  {
+    Database database(database_path);
+    BOOST_CHECK(!database.HasFeatureStore());
+    BOOST_CHECK_EQUAL(database.ReadKeypoints(image1.ImageId())[0].x, 100);
+    ExportFeatureStore(database, feature_store_path);
+  }
+
+  // Modify the database directly, e.g., by an older version, which is only
+  // detected for the modified entry.
+  {
+    sqlite3* sqlite_database;
+    sqlite3_open(database_path.c_str(), &sqlite_database);
+    sqlite3_exec(sqlite_database,
+                 "DELETE FROM descriptors WHERE image_id = 2;", nullptr,
+                 nullptr, nullptr);
+    sqlite3_close(sqlite_database);
+  }
+
+  {
+    Database database(database_path);
+    BOOST_CHECK(database.HasFeatureStore());
+    CheckKeypoints(keypoints1, database.ReadKeypointsView(image1.ImageId()));
+    BOOST_CHECK(!database.ExistsKeypointsView(image2.ImageId()));
+    BOOST_CHECK(!database.ExistsDescriptorsView(image2.ImageId()));
+    BOOST_CHECK(!database.ExistsDescriptors(image2.ImageId()));
+  }
+
+  boost::filesystem::remove(database_path);
+  boost::filesystem::remove(feature_store_path);
+}
@@ -31,6 +31,11 @@
 
 #include "base/graph_cut.h"
 
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <random>
 #include <unordered_map>
 
 #include <boost/graph/stoer_wagner_min_cut.hpp>
@@ -42,6 +47,7 @@ extern "C" {
 }
 
 #include "util/logging.h"
+#include "util/threading.h"
 
 namespace colmap {
 namespace {
@@ -145,6 +151,465 @@ class GraclusGraph {
   std::vector<idxtype> adjwgt_;
 };
 
+// Undirected graph with vertex and edge weights in compressed sparse row
+// format, where the neighbors of vertex `i` are stored in the range
+// `[offsets[i], offsets[i + 1])` of the neighbors and edge weights.
+struct CSRGraph {
+  size_t NumVertices() const { return vertex_weights.size(); }
+
+  std::vector<int> vertex_weights;
+  std::vector<size_t> offsets;
+  std::vector<int> neighbors;
+  std::vector<int> edge_weights;
+};
+
+// Graph level of the multilevel partitioning, where `coarse_vertices` maps
+// every vertex to its vertex in the next coarser level.
+struct GraphLevel {
+  CSRGraph graph;
+  std::vector<int> coarse_vertices;
+};
+
+// The graph is coarsened until it has fewer vertices than this number times the
+// number of parts or until coarsening does not reduce the graph significantly.
+const size_t kNumCoarsestVerticesPerPart = 20;
+const double kMinCoarseningRatio = 0.95;
+const int kNumMatchingRounds = 3;
+const int kNumInitialPartitionTrials = 4;
+const int kNumRefinementPasses = 8;
+
+// Run a function on all indices in `[0, num_elements)` in chunks on the pool.
+void ParallelFor(const size_t num_elements,
+                 const std::function<void(size_t, size_t)>& func,
+                 ThreadPool* thread_pool) {
+  const size_t kNumChunksPerThread = 4;
+  const size_t num_chunks = std::min(
+      num_elements, kNumChunksPerThread * thread_pool->NumThreads());
+  if (num_chunks <= 1) {
+    func(0, num_elements);
+    return;
+  }
+
+  const size_t chunk_size = (num_elements + num_chunks - 1) / num_chunks;
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_chunks);
+  for (size_t begin = 0; begin < num_elements; begin += chunk_size) {
+    futures.push_back(thread_pool->AddTask(
+        func, begin, std::min(num_elements, begin + chunk_size)));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
+// Sort the adjacent vertices and merge duplicate edges by summing weights.
+void SortAndMergeNeighbors(std::vector<std::pair<int, int>>* neighbors) {
+  std::sort(neighbors->begin(), neighbors->end());
+  size_t num_merged = 0;
+  for (size_t i = 0; i < neighbors->size(); ++i) {
+    if (num_merged > 0 &&
+        (*neighbors)[num_merged - 1].first == (*neighbors)[i].first) {
+      (*neighbors)[num_merged - 1].second += (*neighbors)[i].second;
+    } else {
+      (*neighbors)[num_merged] = (*neighbors)[i];
+      num_merged += 1;
+    }
+  }
+  neighbors->resize(num_merged);
+}
+
+// Build the compressed sparse row graph from the adjacency lists.
+void BuildCSRGraph(const std::vector<std::vector<std::pair<int, int>>>&
+                       adjacency_lists,
+                   CSRGraph* graph) {
+  graph->offsets.resize(adjacency_lists.size() + 1);
+  graph->offsets[0] = 0;
+  for (size_t i = 0; i < adjacency_lists.size(); ++i) {
+    graph->offsets[i + 1] = graph->offsets[i] + adjacency_lists[i].size();
+  }
+
+  graph->neighbors.resize(graph->offsets.back());
+  graph->edge_weights.resize(graph->offsets.back());
+  for (size_t i = 0; i < adjacency_lists.size(); ++i) {
+    size_t offset = graph->offsets[i];
+    for (const auto& neighbor : adjacency_lists[i]) {
+      graph->neighbors[offset] = neighbor.first;
+      graph->edge_weights[offset] = neighbor.second;
+      offset += 1;
+    }
+  }
+}
+
+// Compute a matching of the vertices, which prefers heavy edges, such that the
+// combined weight of matched vertices does not exceed the given maximum. In
+// each round, every unmatched vertex proposes in parallel to its unmatched
+// neighbor with the heaviest edge and mutual proposals are matched. The
+// remaining vertices are then matched greedily. Unmatched vertices are matched
+// to themselves.
+std::vector<int> ComputeHeavyEdgeMatching(const CSRGraph& graph,
+                                          const int max_vertex_weight,
+                                          ThreadPool* thread_pool) {
+  const size_t num_vertices = graph.NumVertices();
+
+  std::vector<int> matches(num_vertices, -1);
+
+  auto FindHeaviestNeighbor = [&](const size_t vertex) {
+    int heaviest_neighbor = -1;
+    int heaviest_edge_weight = 0;
+    for (size_t i = graph.offsets[vertex]; i < graph.offsets[vertex + 1];
+         ++i) {
+      const int neighbor = graph.neighbors[i];
+      if (matches[neighbor] == -1 &&
+          graph.vertex_weights[vertex] + graph.vertex_weights[neighbor] <=
+              max_vertex_weight &&
+          (graph.edge_weights[i] > heaviest_edge_weight ||
+           (graph.edge_weights[i] == heaviest_edge_weight &&
+            neighbor < heaviest_neighbor))) {
+        heaviest_neighbor = neighbor;
+        heaviest_edge_weight = graph.edge_weights[i];
+      }
+    }
+    return heaviest_neighbor;
+  };
+
+  std::vector<int> proposals(num_vertices);
+  for (int round = 0; round < kNumMatchingRounds; ++round) {
+    ParallelFor(num_vertices,
+                [&](const size_t begin, const size_t end) {
+                  for (size_t vertex = begin; vertex < end; ++vertex) {
+                    proposals[vertex] =
+                        matches[vertex] == -1 ? FindHeaviestNeighbor(vertex)
+                                              : -1;
+                  }
+                },
+                thread_pool);
+    ParallelFor(num_vertices,
+                [&](const size_t begin, const size_t end) {
+                  for (size_t vertex = begin; vertex < end; ++vertex) {
+                    const int proposal = proposals[vertex];
+                    if (proposal != -1 &&
+                        proposals[proposal] == static_cast<int>(vertex)) {
+                      matches[vertex] = proposal;
+                    }
+                  }
+                },
+                thread_pool);
+  }
+
+  for (size_t vertex = 0; vertex < num_vertices; ++vertex) {
+    if (matches[vertex] == -1) {
+      const int neighbor = FindHeaviestNeighbor(vertex);
+      if (neighbor == -1) {
+        matches[vertex] = static_cast<int>(vertex);
+      } else {
+        matches[vertex] = neighbor;
+        matches[neighbor] = static_cast<int>(vertex);
+      }
+    }
+  }
+
+  return matches;
+}
+
+// Contract the matched vertices of the graph into a coarser graph.
+void CoarsenGraph(const CSRGraph& graph, const std::vector<int>& matches,
+                  std::vector<int>* coarse_vertices, CSRGraph* coarse_graph,
+                  ThreadPool* thread_pool) {
+  const size_t num_vertices = graph.NumVertices();
+
+  // The coarse vertices are ordered by their first fine vertex.
+  coarse_vertices->resize(num_vertices);
+  std::vector<int> first_fine_vertices;
+  for (size_t vertex = 0; vertex < num_vertices; ++vertex) {
+    if (matches[vertex] >= static_cast<int>(vertex)) {
+      (*coarse_vertices)[vertex] = static_cast<int>(first_fine_vertices.size());
+      first_fine_vertices.push_back(static_cast<int>(vertex));
+    }
+  }
+  for (size_t vertex = 0; vertex < num_vertices; ++vertex) {
+    if (matches[vertex] < static_cast<int>(vertex)) {
+      (*coarse_vertices)[vertex] = (*coarse_vertices)[matches[vertex]];
+    }
+  }
+
+  const size_t num_coarse_vertices = first_fine_vertices.size();
+  coarse_graph->vertex_weights.resize(num_coarse_vertices);
+  std::vector<std::vector<std::pair<int, int>>> adjacency_lists(
+      num_coarse_vertices);
+  ParallelFor(
+      num_coarse_vertices,
+      [&](const size_t begin, const size_t end) {
+        for (size_t coarse_vertex = begin; coarse_vertex < end;
+             ++coarse_vertex) {
+          const int vertex1 = first_fine_vertices[coarse_vertex];
+          const int vertex2 = matches[vertex1];
+          auto& adjacency_list = adjacency_lists[coarse_vertex];
+          for (const int vertex : {vertex1, vertex2}) {
+            for (size_t i = graph.offsets[vertex];
+                 i < graph.offsets[vertex + 1]; ++i) {
+              const int coarse_neighbor =
+                  (*coarse_vertices)[graph.neighbors[i]];
+              if (coarse_neighbor != static_cast<int>(coarse_vertex)) {
+                adjacency_list.emplace_back(coarse_neighbor,
+                                            graph.edge_weights[i]);
+              }
+            }
+            if (vertex1 == vertex2) {
+              break;
+            }
+          }
+          SortAndMergeNeighbors(&adjacency_list);
+          coarse_graph->vertex_weights[coarse_vertex] =
+              graph.vertex_weights[vertex1] +
+              (vertex1 == vertex2 ? 0 : graph.vertex_weights[vertex2]);
+        }
+      },
+      thread_pool);
+
+  BuildCSRGraph(adjacency_lists, coarse_graph);
+}
+
+// Every cut edge is visited from both of its vertices, so the weight is summed
+// in 64 bits to not overflow for large graphs before halving it.
+int64_t ComputeCutWeight(const CSRGraph& graph,
+                         const std::vector<int>& labels) {
+  int64_t cut_weight = 0;
+  for (size_t vertex = 0; vertex < graph.NumVertices(); ++vertex) {
+    for (size_t i = graph.offsets[vertex]; i < graph.offsets[vertex + 1];
+         ++i) {
+      if (labels[vertex] != labels[graph.neighbors[i]]) {
+        cut_weight += graph.edge_weights[i];
+      }
+    }
+  }
+  return cut_weight / 2;
+}
+
+// Greedily move vertices to the neighboring part with the largest reduction of
+// the cut weight, while keeping the part weights between the minimum and
+// maximum. Vertices of overweight parts are also moved if this increases the
+// cut weight.
+void RefinePartition(const CSRGraph& graph, const int num_parts,
+                     const int min_part_weight, const int max_part_weight,
+                     std::vector<int>* labels) {
+  std::vector<int> part_weights(num_parts, 0);
+  for (size_t vertex = 0; vertex < graph.NumVertices(); ++vertex) {
+    part_weights[(*labels)[vertex]] += graph.vertex_weights[vertex];
+  }
+
+  std::vector<int> part_connectivities(num_parts, 0);
+  std::vector<int> neighbor_parts;
+  for (int pass = 0; pass < kNumRefinementPasses; ++pass) {
+    size_t num_moves = 0;
+    for (size_t vertex = 0; vertex < graph.NumVertices(); ++vertex) {
+      const int vertex_weight = graph.vertex_weights[vertex];
+      const int from_part = (*labels)[vertex];
+
+      const bool is_overweight = part_weights[from_part] > max_part_weight;
+      if (!is_overweight &&
+          part_weights[from_part] - vertex_weight < min_part_weight) {
+        continue;
+      }
+
+      neighbor_parts.clear();
+      for (size_t i = graph.offsets[vertex]; i < graph.offsets[vertex + 1];
+           ++i) {
+        const int part = (*labels)[graph.neighbors[i]];
+        if (part_connectivities[part] == 0) {
+          neighbor_parts.push_back(part);
+        }
+        part_connectivities[part] += graph.edge_weights[i];
+      }
+
+      int to_part = -1;
+      int max_gain = 0;
+      for (const int part : neighbor_parts) {
+        if (part == from_part ||
+            part_weights[part] + vertex_weight > max_part_weight) {
+          continue;
+        }
+        const int gain =
+            part_connectivities[part] - part_connectivities[from_part];
+        const bool improves_balance =
+            part_weights[part] + vertex_weight < part_weights[from_part];
+        if ((to_part == -1 && (is_overweight || gain > 0 ||
+                               (gain == 0 && improves_balance))) ||
+            (to_part != -1 && gain > max_gain)) {
+          to_part = part;
+          max_gain = gain;
+        }
+      }
+
+      // Overweight parts without a light neighboring part move their vertices
+      // to the lightest part, e.g., for disconnected graphs.
+      if (to_part == -1 && is_overweight) {
+        const int lightest_part = static_cast<int>(
+            std::min_element(part_weights.begin(), part_weights.end()) -
+            part_weights.begin());
+        if (part_weights[lightest_part] + vertex_weight <= max_part_weight) {
+          to_part = lightest_part;
+        }
+      }
+
+      for (const int part : neighbor_parts) {
+        part_connectivities[part] = 0;
+      }
+
+      if (to_part != -1) {
+        (*labels)[vertex] = to_part;
+        part_weights[from_part] -= vertex_weight;
+        part_weights[to_part] += vertex_weight;
+        num_moves += 1;
+      }
+    }
+
+    if (num_moves == 0) {
+      break;
+    }
+  }
+}
+
+// Move vertices out of parts, whose weight still exceeds the maximum after
+// refinement, to the neighboring part with the strongest connection or to the
+// lightest part. For unit vertex weights, as in the original graph, the
+// lightest part always has room, so that the maximum part weight is enforced.
+void BalancePartition(const CSRGraph& graph, const int num_parts,
+                      const int max_part_weight, std::vector<int>* labels) {
+  std::vector<int> part_weights(num_parts, 0);
+  for (size_t vertex = 0; vertex < graph.NumVertices(); ++vertex) {
+    part_weights[(*labels)[vertex]] += graph.vertex_weights[vertex];
+  }
+
+  std::vector<int> part_connectivities(num_parts, 0);
+  std::vector<int> neighbor_parts;
+  for (size_t vertex = 0; vertex < graph.NumVertices(); ++vertex) {
+    const int vertex_weight = graph.vertex_weights[vertex];
+    const int from_part = (*labels)[vertex];
+    if (part_weights[from_part] <= max_part_weight) {
+      continue;
+    }
+
+    neighbor_parts.clear();
+    for (size_t i = graph.offsets[vertex]; i < graph.offsets[vertex + 1];
+         ++i) {
+      const int part = (*labels)[graph.neighbors[i]];
+      if (part_connectivities[part] == 0) {
+        neighbor_parts.push_back(part);
+      }
+      part_connectivities[part] += graph.edge_weights[i];
+    }
+
+    int to_part = -1;
+    for (const int part : neighbor_parts) {
+      if (part != from_part &&
+          part_weights[part] + vertex_weight <= max_part_weight &&
+          (to_part == -1 ||
+           part_connectivities[part] > part_connectivities[to_part])) {
+        to_part = part;
+      }
+    }
+
+    for (const int part : neighbor_parts) {
+      part_connectivities[part] = 0;
+    }
+
+    if (to_part == -1) {
+      const int lightest_part = static_cast<int>(
+          std::min_element(part_weights.begin(), part_weights.end()) -
+          part_weights.begin());
+      if (part_weights[lightest_part] + vertex_weight <= max_part_weight) {
+        to_part = lightest_part;
+      }
+    }
+
+    if (to_part != -1) {
+      (*labels)[vertex] = to_part;
+      part_weights[from_part] -= vertex_weight;
+      part_weights[to_part] += vertex_weight;
+    }
+  }
+}
+
+// Partition the graph by growing the parts one after another from a random
+// seed vertex, always adding the vertex with the strongest connection to the
+// growing part. The best of multiple refined trials is returned.
+std::vector<int> ComputeInitialPartition(const CSRGraph& graph,
+                                         const int num_parts,
+                                         const int min_part_weight,
+                                         const int max_part_weight) {
+  const size_t num_vertices = graph.NumVertices();
+  const int total_weight = std::accumulate(graph.vertex_weights.begin(),
+                                           graph.vertex_weights.end(), 0);
+
+  std::mt19937 prng(0);
+
+  std::vector<int> best_labels;
+  int64_t best_cut_weight = std::numeric_limits<int64_t>::max();
+  for (int trial = 0; trial < kNumInitialPartitionTrials; ++trial) {
+    std::vector<int> labels(num_vertices, num_parts - 1);
+    std::vector<bool> assigned(num_vertices, false);
+    std::vector<int> unassigned_vertices(num_vertices);
+    std::iota(unassigned_vertices.begin(), unassigned_vertices.end(), 0);
+    std::shuffle(unassigned_vertices.begin(), unassigned_vertices.end(), prng);
+
+    int remaining_weight = total_weight;
+    for (int part = 0; part < num_parts - 1; ++part) {
+      const int target_weight = remaining_weight / (num_parts - part);
+      std::vector<int> connectivities(num_vertices, 0);
+      std::priority_queue<std::pair<int, int>> queue;
+      int part_weight = 0;
+      while (part_weight < target_weight) {
+        int vertex = -1;
+        while (!queue.empty()) {
+          const auto entry = queue.top();
+          queue.pop();
+          if (!assigned[entry.second]) {
+            vertex = entry.second;
+            break;
+          }
+        }
+
+        // Start a new region, if the part is not connected to any more
+        // unassigned vertices.
+        while (vertex == -1 && !unassigned_vertices.empty()) {
+          if (!assigned[unassigned_vertices.back()]) {
+            vertex = unassigned_vertices.back();
+          }
+          unassigned_vertices.pop_back();
+        }
+
+        if (vertex == -1) {
+          break;
+        }
+
+        assigned[vertex] = true;
+        labels[vertex] = part;
+        part_weight += graph.vertex_weights[vertex];
+        for (size_t i = graph.offsets[vertex]; i < graph.offsets[vertex + 1];
+             ++i) {
+          const int neighbor = graph.neighbors[i];
+          if (!assigned[neighbor]) {
+            connectivities[neighbor] += graph.edge_weights[i];
+            queue.emplace(connectivities[neighbor], neighbor);
+          }
+        }
+      }
+      remaining_weight -= part_weight;
+    }
+
+    RefinePartition(graph, num_parts, min_part_weight, max_part_weight,
+                    &labels);
+
+    const int64_t cut_weight = ComputeCutWeight(graph, labels);
+    if (cut_weight < best_cut_weight) {
+      best_labels = std::move(labels);
+      best_cut_weight = cut_weight;
+    }
+  }
+
+  return best_labels;
+}
+
 }  // namespace
 
 void ComputeMinGraphCutStoerWagner(
@@ -219,4 +684,112 @@ std::unordered_map<int, int> ComputeNormalizedMinGraphCut(
   return labels;
 }
 
+std::unordered_map<int, int> ComputeMultilevelGraphPartition(
+    const std::vector<std::pair<int, int>>& edges,
+    const std::vector<int>& weights, const int num_parts,
+    const double max_imbalance, const int num_threads) {
+  CHECK_EQ(edges.size(), weights.size());
+  CHECK_GT(num_parts, 0);
+  CHECK_GE(max_imbalance, 0);
+
+  // Map the vertex identifiers to consecutive indices.
+  std::unordered_map<int, int> labels;
+  std::vector<int> vertex_ids;
+  std::unordered_map<int, int> vertex_id_to_idx;
+  for (const auto& edge : edges) {
+    for (const int vertex_id : {edge.first, edge.second}) {
+      if (vertex_id_to_idx.emplace(vertex_id, vertex_ids.size()).second) {
+        vertex_ids.push_back(vertex_id);
+      }
+    }
+  }
+
+  const size_t num_vertices = vertex_ids.size();
+  if (num_vertices == 0) {
+    return labels;
+  } else if (num_parts == 1) {
+    for (const auto vertex_id : vertex_ids) {
+      labels.emplace(vertex_id, 0);
+    }
+    return labels;
+  }
+
+  std::vector<GraphLevel> levels(1);
+  {
+    std::vector<std::vector<std::pair<int, int>>> adjacency_lists(
+        num_vertices);
+    for (size_t i = 0; i < edges.size(); ++i) {
+      const int vertex_idx1 = vertex_id_to_idx.at(edges[i].first);
+      const int vertex_idx2 = vertex_id_to_idx.at(edges[i].second);
+      if (vertex_idx1 != vertex_idx2) {
+        adjacency_lists[vertex_idx1].emplace_back(vertex_idx2, weights[i]);
+        adjacency_lists[vertex_idx2].emplace_back(vertex_idx1, weights[i]);
+      }
+    }
+    for (auto& adjacency_list : adjacency_lists) {
+      SortAndMergeNeighbors(&adjacency_list);
+    }
+    levels[0].graph.vertex_weights.resize(num_vertices, 1);
+    BuildCSRGraph(adjacency_lists, &levels[0].graph);
+  }
+
+  const double average_part_weight = num_vertices / double(num_parts);
+  const int min_part_weight =
+      static_cast<int>((1 - max_imbalance) * average_part_weight);
+  const int max_part_weight =
+      std::max(static_cast<int>(std::ceil(average_part_weight)),
+               static_cast<int>((1 + max_imbalance) * average_part_weight));
+
+  ThreadPool thread_pool(GetEffectiveNumThreads(num_threads));
+
+  // Coarsen the graph, while limiting the vertex weights, such that the
+  // coarsest graph can still be partitioned in a balanced way.
+  const size_t max_num_coarsest_vertices =
+      kNumCoarsestVerticesPerPart * num_parts;
+  const int max_vertex_weight = std::max(
+      1, static_cast<int>(1.5 * num_vertices / max_num_coarsest_vertices));
+  while (levels.back().graph.NumVertices() > max_num_coarsest_vertices) {
+    GraphLevel& level = levels.back();
+    const std::vector<int> matches =
+        ComputeHeavyEdgeMatching(level.graph, max_vertex_weight, &thread_pool);
+    CSRGraph coarse_graph;
+    CoarsenGraph(level.graph, matches, &level.coarse_vertices, &coarse_graph,
+                 &thread_pool);
+    if (coarse_graph.NumVertices() >
+        kMinCoarseningRatio * level.graph.NumVertices()) {
+      level.coarse_vertices.clear();
+      break;
+    }
+    levels.emplace_back();
+    levels.back().graph = std::move(coarse_graph);
+  }
+
+  // Partition the coarsest graph and refine the partition at every level while
+  // projecting it back to the original graph.
+  std::vector<int> level_labels =
+      ComputeInitialPartition(levels.back().graph, num_parts,
+                              min_part_weight, max_part_weight);
+  for (int i = static_cast<int>(levels.size()) - 2; i >= 0; --i) {
+    const GraphLevel& level = levels[i];
+    std::vector<int> fine_level_labels(level.graph.NumVertices());
+    for (size_t vertex = 0; vertex < fine_level_labels.size(); ++vertex) {
+      fine_level_labels[vertex] = level_labels[level.coarse_vertices[vertex]];
+    }
+    RefinePartition(level.graph, num_parts, min_part_weight, max_part_weight,
+                    &fine_level_labels);
+    level_labels = std::move(fine_level_labels);
+  }
+
+  // Refinement only keeps the part weights within the bounds if it can, so the
+  // maximum part weight is finally enforced on the original graph.
+  BalancePartition(levels[0].graph, num_parts, max_part_weight, &level_labels);
+
+  labels.reserve(num_vertices);
+  for (size_t idx = 0; idx < num_vertices; ++idx) {
+    labels.emplace(vertex_ids[idx], level_labels[idx]);
+  }
+
+  return labels;
+}
+
 }  // namespace colmap
@@ -56,6 +56,20 @@ std::unordered_map<int, int> ComputeNormalizedMinGraphCut(
     const std::vector<std::pair<int, int>>& edges,
     const std::vector<int>& weights, const int num_parts);
 
+// Compute a balanced partition of an undirected graph into the given number of
+// parts using multilevel k-way partitioning. The graph is first coarsened by
+// contracting heavy edges in parallel, then the coarsest graph is partitioned
+// by greedy graph growing, and finally the partition is projected back and
+// refined at every level. Each part has at most `1 + max_imbalance` times the
+// average number of vertices, or the rounded up average, if it is larger. This
+// bound is enforced after the refinement, possibly at the cost of a larger cut,
+// whereas the lower bound of `1 - max_imbalance` times the average number of
+// vertices is only best-effort. Returns the part labels per vertex.
+std::unordered_map<int, int> ComputeMultilevelGraphPartition(
+    const std::vector<std::pair<int, int>>& edges,
+    const std::vector<int>& weights, const int num_parts,
+    const double max_imbalance = 0.05, const int num_threads = -1);
+
 // Compute the minimum graph cut of a directed S-T graph using the
 // Boykov-Kolmogorov max-flow min-cut algorithm, as descibed in:
 //   "An Experimental Comparison of Min-Cut/Max-Flow Algorithms for Energy
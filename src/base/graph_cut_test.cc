@@ -152,6 +152,131 @@ BOOST_AUTO_TEST_CASE(TestComputeNormalizedMinGraphCutDisconnected) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestComputeMultilevelGraphPartition) {
+  const std::vector<std::pair<int, int>> edges = {
+      {3, 4}, {3, 6}, {3, 5}, {0, 4}, {0, 1}, {0, 6}, {0, 7}, {0, 5},
+      {0, 2}, {4, 1}, {1, 6}, {1, 5}, {6, 7}, {7, 5}, {5, 2}, {3, 4}};
+  const std::vector<int> weights = {0, 3, 1, 3,  1, 2, 6, 1,
+                                    8, 1, 1, 80, 2, 1, 1, 4};
+  const auto labels = ComputeMultilevelGraphPartition(edges, weights, 2);
+  BOOST_CHECK_EQUAL(labels.size(), 8);
+  std::vector<int> part_sizes(2, 0);
+  for (const auto& label : labels) {
+    BOOST_CHECK_GE(label.second, 0);
+    BOOST_CHECK_LT(label.second, 2);
+    part_sizes[label.second] += 1;
+  }
+  BOOST_CHECK_LE(part_sizes[0], 5);
+  BOOST_CHECK_LE(part_sizes[1], 5);
+  BOOST_CHECK_EQUAL(labels.at(1), labels.at(5));
+  BOOST_CHECK_EQUAL(labels.at(0), labels.at(2));
+}
+
+BOOST_AUTO_TEST_CASE(TestComputeMultilevelGraphPartitionClusters) {
+  // Densely connected clusters with weak connections between clusters.
+  const int kNumClusters = 8;
+  const int kClusterSize = 100;
+  std::vector<std::pair<int, int>> edges;
+  std::vector<int> weights;
+  for (int cluster = 0; cluster < kNumClusters; ++cluster) {
+    for (int i = 0; i < kClusterSize; ++i) {
+      const int vertex = cluster * kClusterSize + i;
+      for (int j = 1; j <= 5; ++j) {
+        edges.emplace_back(vertex, cluster * kClusterSize +
+                                       (i + j * j) % kClusterSize);
+        weights.push_back(100);
+      }
+      if (i % 10 == 0) {
+        edges.emplace_back(
+            vertex, ((cluster + 1) % kNumClusters) * kClusterSize + i + 1);
+        weights.push_back(1);
+      }
+    }
+  }
+
+  const auto labels1 = ComputeMultilevelGraphPartition(
+      edges, weights, kNumClusters, /*max_imbalance=*/0.05,
+      /*num_threads=*/1);
+  BOOST_CHECK_EQUAL(labels1.size(), kNumClusters * kClusterSize);
+  std::vector<int> part_sizes(kNumClusters, 0);
+  for (const auto& label : labels1) {
+    BOOST_CHECK_GE(label.second, 0);
+    BOOST_CHECK_LT(label.second, kNumClusters);
+    BOOST_CHECK_EQUAL(
+        label.second,
+        labels1.at(label.first - label.first % kClusterSize));
+    part_sizes[label.second] += 1;
+  }
+  for (const auto part_size : part_sizes) {
+    BOOST_CHECK_EQUAL(part_size, kClusterSize);
+  }
+
+  // The partition is independent of the number of threads.
+  const auto labels2 = ComputeMultilevelGraphPartition(
+      edges, weights, kNumClusters, /*max_imbalance=*/0.05,
+      /*num_threads=*/4);
+  BOOST_CHECK(labels1 == labels2);
+}
+
+BOOST_AUTO_TEST_CASE(TestComputeMultilevelGraphPartitionBalance) {
+  // Grid graph with a larger weight on the horizontal edges.
+  const int kGridSize = 100;
+  std::vector<std::pair<int, int>> edges;
+  std::vector<int> weights;
+  for (int y = 0; y < kGridSize; ++y) {
+    for (int x = 0; x < kGridSize; ++x) {
+      if (x + 1 < kGridSize) {
+        edges.emplace_back(y * kGridSize + x, y * kGridSize + x + 1);
+        weights.push_back(2);
+      }
+      if (y + 1 < kGridSize) {
+        edges.emplace_back(y * kGridSize + x, (y + 1) * kGridSize + x);
+        weights.push_back(1);
+      }
+    }
+  }
+
+  for (const double max_imbalance : {0.0, 0.05}) {
+    for (const int num_parts : {2, 3, 7, 16}) {
+      const auto labels = ComputeMultilevelGraphPartition(
+          edges, weights, num_parts, max_imbalance);
+      BOOST_CHECK_EQUAL(labels.size(), kGridSize * kGridSize);
+      std::vector<int> part_sizes(num_parts, 0);
+      for (const auto& label : labels) {
+        part_sizes[label.second] += 1;
+      }
+      const double average_part_size = kGridSize * kGridSize / double(num_parts);
+      const int max_part_size =
+          std::max(static_cast<int>(std::ceil(average_part_size)),
+                   static_cast<int>((1 + max_imbalance) * average_part_size));
+      for (const auto part_size : part_sizes) {
+        BOOST_CHECK_GT(part_size, 0);
+        BOOST_CHECK_LE(part_size, max_part_size);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestComputeMultilevelGraphPartitionDisconnected) {
+  const std::vector<std::pair<int, int>> edges = {
+      {0, 1}, {1, 2}, {3, 4}, {5, 6}, {6, 7}, {8, 8}};
+  const std::vector<int> weights = {1, 1, 1, 1, 1, 1};
+  const auto labels = ComputeMultilevelGraphPartition(edges, weights, 3,
+                                                      /*max_imbalance=*/0);
+  BOOST_CHECK_EQUAL(labels.size(), 9);
+  std::vector<int> part_sizes(3, 0);
+  for (const auto& label : labels) {
+    part_sizes[label.second] += 1;
+  }
+  BOOST_CHECK_EQUAL(part_sizes[0], 3);
+  BOOST_CHECK_EQUAL(part_sizes[1], 3);
+  BOOST_CHECK_EQUAL(part_sizes[2], 3);
+
+  BOOST_CHECK(ComputeMultilevelGraphPartition({}, {}, 2).empty());
+  BOOST_CHECK_EQUAL(ComputeMultilevelGraphPartition(edges, weights, 1).size(),
+                    9);
+}
+
 BOOST_AUTO_TEST_CASE(TestMinSTGraphCut1) {
   MinSTGraphCut<int, int> graph(2);
   BOOST_CHECK_EQUAL(graph.NumNodes(), 2);
@@ -38,6 +38,8 @@ namespace colmap {
 
 bool ImageReaderOptions::Check() const {
   CHECK_OPTION_GT(default_focal_length_factor, 0.0);
+  CHECK_OPTION_GT(prefetch_depth, 0);
+  CHECK_OPTION_GE(prefetch_memory, 0.0);
   CHECK_OPTION(ExistsCameraModelWithName(camera_model));
   const int model_id = CameraModelNameToId(camera_model);
   if (!camera_params.empty()) {
@@ -48,7 +50,12 @@ bool ImageReaderOptions::Check() const {
 }
 
 ImageReader::ImageReader(const ImageReaderOptions& options, Database* database)
-    : options_(options), database_(database), image_index_(0) {
+    : options_(options),
+      database_(database),
+      image_index_(0),
+      prefetch_index_(0),
+      num_read_images_(0),
+      num_read_bytes_(0) {
   CHECK(options_.Check());
 
   // Ensure trailing slash, so that we can build the correct image name.
@@ -77,6 +84,9 @@ ImageReader::ImageReader(const ImageReaderOptions& options, Database* database)
       prev_camera_.SetPriorFocalLength(true);
     }
   }
+
+  thread_pool_.reset(
+      new ThreadPool(GetEffectiveNumThreads(options_.num_threads)));
 }
 
 ImageReader::Status ImageReader::Next(Camera* camera, Image* image,
@@ -88,19 +98,28 @@ ImageReader::Status ImageReader::Next(Camera* camera, Image* image,
   image_index_ += 1;
   CHECK_LE(image_index_, options_.image_list.size());
 
-  const std::string image_path = options_.image_list.at(image_index_ - 1);
+  Prefetch();
 
-  DatabaseTransaction database_transaction(database_);
+  CHECK(!prefetch_jobs_.empty());
+  PrefetchJob job = std::move(prefetch_jobs_.front());
+  prefetch_jobs_.pop_front();
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Set the image name.
-  //////////////////////////////////////////////////////////////////////////////
+  // Keep the workers busy while the current image is processed.
+  Prefetch();
 
-  image->SetName(image_path);
-  image->SetName(StringReplace(image->Name(), "\\", "/"));
-  image->SetName(
-      image->Name().substr(options_.image_path.size(),
-                           image->Name().size() - options_.image_path.size()));
+  if (job.decoded.valid()) {
+    job.decoded.get();
+  }
+
+  PrefetchedImage& data = *job.data;
+  *image = data.image;
+
+  if (!data.exists_features) {
+    num_read_images_ += 1;
+    num_read_bytes_ += data.bitmap.NumBytes() + data.mask.NumBytes();
+  }
+
+  DatabaseTransaction database_transaction(database_);
 
   const std::string image_folder = GetParentDir(image->Name());
 
@@ -108,39 +127,32 @@ ImageReader::Status ImageReader::Next(Camera* camera, Image* image,
   // Check if image already read.
   //////////////////////////////////////////////////////////////////////////////
 
-  const bool exists_image = database_->ExistsImageWithName(image->Name());
+  const bool exists_image = data.exists_image;
 
-  if (exists_image) {
-    *image = database_->ReadImageWithName(image->Name());
-    const bool exists_keypoints = database_->ExistsKeypoints(image->ImageId());
-    const bool exists_descriptors =
-        database_->ExistsDescriptors(image->ImageId());
-
-    if (exists_keypoints && exists_descriptors) {
-      return Status::IMAGE_EXISTS;
-    }
+  if (data.exists_features) {
+    return Status::IMAGE_EXISTS;
   }
 
   //////////////////////////////////////////////////////////////////////////////
   // Read image.
   //////////////////////////////////////////////////////////////////////////////
 
-  if (!bitmap->Read(image_path, false)) {
+  if (data.bitmap_error) {
     return Status::BITMAP_ERROR;
   }
 
+  *bitmap = std::move(data.bitmap);
+
   //////////////////////////////////////////////////////////////////////////////
   // Read mask.
   //////////////////////////////////////////////////////////////////////////////
 
-  if (mask && !options_.mask_path.empty()) {
-    const std::string mask_path =
-        JoinPaths(options_.mask_path,
-                  GetRelativePath(options_.image_path, image_path) + ".png");
-    if (ExistsFile(mask_path) && !mask->Read(mask_path, false)) {
+  if (mask) {
+    if (data.mask_error) {
       // NOTE: Maybe introduce a separate error type MASK_ERROR?
       return Status::BITMAP_ERROR;
     }
+    *mask = std::move(data.mask);
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -234,4 +246,62 @@ size_t ImageReader::NextIndex() const { return image_index_; }
 
 size_t ImageReader::NumImages() const { return options_.image_list.size(); }
 
+size_t ImageReader::NumPrefetchedImages() const {
+  return prefetch_jobs_.size();
+}
+
+void ImageReader::Prefetch() {
+  const size_t max_num_bytes =
+      static_cast<size_t>(options_.prefetch_memory * 1024 * 1024 * 1024);
+  const size_t mean_num_bytes =
+      num_read_images_ == 0 ? 0 : num_read_bytes_ / num_read_images_;
+
+  while (prefetch_index_ < options_.image_list.size() &&
+         prefetch_jobs_.size() < static_cast<size_t>(options_.prefetch_depth) &&
+         (prefetch_jobs_.empty() ||
+          (prefetch_jobs_.size() + 1) * mean_num_bytes <= max_num_bytes)) {
+    PrefetchJob job;
+    job.data = std::make_shared<PrefetchedImage>();
+
+    PrefetchedImage& data = *job.data;
+    data.path = options_.image_list.at(prefetch_index_);
+    prefetch_index_ += 1;
+
+    // The database is only accessed from the calling thread, the workers only
+    // decode the image and mask files.
+    data.image.SetName(StringReplace(data.path, "\\", "/"));
+    data.image.SetName(data.image.Name().substr(
+        options_.image_path.size(),
+        data.image.Name().size() - options_.image_path.size()));
+
+    data.exists_image = database_->ExistsImageWithName(data.image.Name());
+    if (data.exists_image) {
+      data.image = database_->ReadImageWithName(data.image.Name());
+      data.exists_features =
+          database_->ExistsKeypoints(data.image.ImageId()) &&
+          database_->ExistsDescriptors(data.image.ImageId());
+    }
+
+    if (!data.exists_features) {
+      std::string mask_path;
+      if (!options_.mask_path.empty()) {
+        mask_path = JoinPaths(
+            options_.mask_path,
+            GetRelativePath(options_.image_path, data.path) + ".png");
+      }
+
+      const std::shared_ptr<PrefetchedImage> data_ptr = job.data;
+      job.decoded = thread_pool_->AddTask([data_ptr, mask_path]() {
+        data_ptr->bitmap_error = !data_ptr->bitmap.Read(data_ptr->path, false);
+        if (!data_ptr->bitmap_error && !mask_path.empty() &&
+            ExistsFile(mask_path)) {
+          data_ptr->mask_error = !data_ptr->mask.Read(mask_path, false);
+        }
+      });
+    }
+
+    prefetch_jobs_.push_back(std::move(job));
+  }
+}
+
 }  // namespace colmap
@@ -32,6 +32,9 @@
 #ifndef COLMAP_SRC_BASE_IMAGE_READER_H_
 #define COLMAP_SRC_BASE_IMAGE_READER_H_
 
+#include <deque>
+#include <future>
+#include <memory>
 #include <unordered_set>
 
 #include "base/database.h"
@@ -87,12 +90,26 @@ struct ImageReaderOptions {
   // intensity value 0 in grayscale).
   std::string camera_mask_path = "";
 
+  // Number of threads that decode images ahead of the consumer. If set to a
+  // value <= 0, the number of threads equals the number of available cores.
+  int num_threads = -1;
+
+  // Maximum number of images that are decoded ahead of the consumer.
+  int prefetch_depth = 16;
+
+  // Maximum memory in GB of the images that are decoded ahead of the consumer.
+  // The memory of images that are still being decoded is estimated from the
+  // average size of the previously read images.
+  double prefetch_memory = 2.0;
+
   bool Check() const;
 };
 
 // Recursively iterate over the images in a directory. Skips an image if it
 // already exists in the database. Extracts the camera intrinsics from EXIF and
-// writes the camera information to the database.
+// writes the camera information to the database. The images are decoded ahead
+// in parallel, while the cameras and images are processed in the order of the
+// image list, such that the assigned identifiers are deterministic.
 class ImageReader {
  public:
   enum class Status {
@@ -111,7 +128,29 @@ class ImageReader {
   size_t NextIndex() const;
   size_t NumImages() const;
 
+  // Number of images that are currently decoded or being decoded ahead.
+  size_t NumPrefetchedImages() const;
+
  private:
+  struct PrefetchedImage {
+    std::string path;
+    Image image;
+    bool exists_image = false;
+    bool exists_features = false;
+    bool bitmap_error = false;
+    bool mask_error = false;
+    Bitmap bitmap;
+    Bitmap mask;
+  };
+
+  struct PrefetchJob {
+    std::shared_ptr<PrefetchedImage> data;
+    std::future<void> decoded;
+  };
+
+  // Schedule the decoding of the upcoming images within the prefetch limits.
+  void Prefetch();
+
   // Image reader options.
   ImageReaderOptions options_;
   Database* database_;
@@ -122,6 +161,16 @@ class ImageReader {
   // Names of image sub-folders.
   std::string prev_image_folder_;
   std::unordered_set<std::string> image_folders_;
+  // Index of the next image to prefetch.
+  size_t prefetch_index_;
+  // Images decoded ahead, in the order of the image list.
+  std::deque<PrefetchJob> prefetch_jobs_;
+  // Statistics of the previously read images to estimate the prefetch memory.
+  size_t num_read_images_;
+  size_t num_read_bytes_;
+  // Declared last, such that the workers are joined before the prefetched
+  // images are released.
+  std::unique_ptr<ThreadPool> thread_pool_;
 };
 
 }  // namespace colmap
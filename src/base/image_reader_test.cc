@@ -0,0 +1,178 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "base/image_reader"
+#include "util/testing.h"
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include "base/image_reader.h"
+#include "util/misc.h"
+
+using namespace colmap;
+
+namespace {
+
+void WriteBitmap(const std::string& path, const int width, const int height) {
+  Bitmap bitmap;
+  bitmap.Allocate(width, height, false);
+  bitmap.Fill(BitmapColor<uint8_t>(0));
+  BOOST_CHECK(bitmap.Write(path));
+}
+
+// Image directory with two folders, of which the second contains an image
+// with different dimensions and a file that is not an image.
+std::string CreateImageDirectory() {
+  const std::string image_path = CreateTempPath();
+  CreateDirIfNotExists(image_path);
+  CreateDirIfNotExists(JoinPaths(image_path, "a"));
+  CreateDirIfNotExists(JoinPaths(image_path, "b"));
+  WriteBitmap(JoinPaths(image_path, "a/1.png"), 10, 8);
+  WriteBitmap(JoinPaths(image_path, "a/2.png"), 10, 8);
+  WriteBitmap(JoinPaths(image_path, "b/3.png"), 10, 8);
+  WriteBitmap(JoinPaths(image_path, "b/4.png"), 12, 8);
+  WriteBitmap(JoinPaths(image_path, "b/5.png"), 10, 8);
+  std::ofstream file(JoinPaths(image_path, "b/6.txt"));
+  file << "no image";
+  return image_path;
+}
+
+struct ReadResult {
+  ImageReader::Status status;
+  std::string name;
+  camera_t camera_id;
+  int width;
+};
+
+std::vector<ReadResult> ReadImages(ImageReaderOptions options,
+                                   Database* database) {
+  ImageReader image_reader(options, database);
+  BOOST_CHECK_EQUAL(image_reader.NumImages(), 6);
+  std::vector<ReadResult> results;
+  while (image_reader.NextIndex() < image_reader.NumImages()) {
+    Camera camera;
+    Image image;
+    Bitmap bitmap;
+    ReadResult result;
+    result.status = image_reader.Next(&camera, &image, &bitmap, nullptr);
+    result.name = image.Name();
+    result.camera_id = image.CameraId();
+    result.width = bitmap.Width();
+    BOOST_CHECK_LE(image_reader.NumPrefetchedImages(),
+                   static_cast<size_t>(options.prefetch_depth));
+    if (result.status == ImageReader::Status::SUCCESS) {
+      BOOST_CHECK_EQUAL(camera.CameraId(), image.CameraId());
+      BOOST_CHECK_EQUAL(camera.Width(), static_cast<size_t>(bitmap.Width()));
+      image.SetImageId(database->WriteImage(image));
+      database->WriteKeypoints(image.ImageId(), FeatureKeypoints());
+      database->WriteDescriptors(image.ImageId(), FeatureDescriptors());
+    }
+    results.push_back(result);
+  }
+  return results;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestPrefetch) {
+  const std::string image_path = CreateImageDirectory();
+
+  ImageReaderOptions options;
+  options.image_path = image_path;
+  options.single_camera_per_folder = true;
+
+  std::vector<std::vector<ReadResult>> all_results;
+  for (const int num_threads : {1, 4}) {
+    for (const int prefetch_depth : {1, 3, 16}) {
+      for (const double prefetch_memory : {0.0, 1.0}) {
+        const std::string database_path = CreateTempPath();
+        Database database(database_path);
+        options.num_threads = num_threads;
+        options.prefetch_depth = prefetch_depth;
+        options.prefetch_memory = prefetch_memory;
+        all_results.push_back(ReadImages(options, &database));
+        BOOST_CHECK_EQUAL(database.NumCameras(), 2);
+        database.Close();
+        boost::filesystem::remove(database_path);
+      }
+    }
+  }
+
+  for (const auto& results : all_results) {
+    BOOST_REQUIRE_EQUAL(results.size(), 6);
+    const std::vector<std::string> kNames = {"a/1.png", "a/2.png", "b/3.png",
+                                             "b/4.png", "b/5.png", "b/6.txt"};
+    const std::vector<ImageReader::Status> kStatus = {
+        ImageReader::Status::SUCCESS,
+        ImageReader::Status::SUCCESS,
+        ImageReader::Status::SUCCESS,
+        ImageReader::Status::CAMERA_SINGLE_DIM_ERROR,
+        ImageReader::Status::SUCCESS,
+        ImageReader::Status::BITMAP_ERROR};
+    const std::vector<camera_t> kCameraIds = {1, 1, 2, 2, 2, kInvalidCameraId};
+    for (size_t i = 0; i < results.size(); ++i) {
+      BOOST_CHECK_EQUAL(results[i].name, kNames[i]);
+      BOOST_CHECK(results[i].status == kStatus[i]);
+      if (results[i].status == ImageReader::Status::SUCCESS) {
+        BOOST_CHECK_EQUAL(results[i].camera_id, kCameraIds[i]);
+        BOOST_CHECK_EQUAL(results[i].width, 10);
+      }
+    }
+  }
+
+  boost::filesystem::remove_all(image_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestImageExists) {
+  const std::string image_path = CreateImageDirectory();
+  const std::string database_path = CreateTempPath();
+
+  ImageReaderOptions options;
+  options.image_path = image_path;
+  options.num_threads = 2;
+
+  Database database(database_path);
+  ReadImages(options, &database);
+  const std::vector<ReadResult> results = ReadImages(options, &database);
+  BOOST_REQUIRE_EQUAL(results.size(), 6);
+  for (size_t i = 0; i < 5; ++i) {
+    BOOST_CHECK(results[i].status == ImageReader::Status::IMAGE_EXISTS);
+    BOOST_CHECK_EQUAL(results[i].width, 0);
+  }
+  BOOST_CHECK(results[5].status == ImageReader::Status::BITMAP_ERROR);
+  BOOST_CHECK_EQUAL(database.NumImages(), 5);
+  database.Close();
+
+  boost::filesystem::remove(database_path);
+  boost::filesystem::remove_all(image_path);
+}
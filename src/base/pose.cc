@@ -195,6 +195,20 @@ void InvertPose(const Eigen::Vector4d& qvec, const Eigen::Vector3d& tvec,
   *inv_tvec = -QuaternionRotatePoint(*inv_qvec, tvec);
 }
 
+void ApplyPoseChange(const Eigen::Vector4d& qvec1, const Eigen::Vector3d& tvec1,
+                     const Eigen::Vector4d& qvec2, const Eigen::Vector3d& tvec2,
+                     const Eigen::Vector4d& qvec3, const Eigen::Vector3d& tvec3,
+                     Eigen::Vector4d* qvec, Eigen::Vector3d* tvec) {
+  Eigen::Vector4d inv_qvec1;
+  Eigen::Vector3d inv_tvec1;
+  InvertPose(qvec1, tvec1, &inv_qvec1, &inv_tvec1);
+  Eigen::Vector4d change_qvec;
+  Eigen::Vector3d change_tvec;
+  ConcatenatePoses(inv_qvec1, inv_tvec1, qvec2, tvec2, &change_qvec,
+                   &change_tvec);
+  ConcatenatePoses(qvec3, tvec3, change_qvec, change_tvec, qvec, tvec);
+}
+
 void InterpolatePose(const Eigen::Vector4d& qvec1, const Eigen::Vector3d& tvec1,
                      const Eigen::Vector4d& qvec2, const Eigen::Vector3d& tvec2,
                      const double t, Eigen::Vector4d* qveci,
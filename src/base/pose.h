@@ -175,6 +175,21 @@ void ConcatenatePoses(const Eigen::Vector4d& qvec1,
 void InvertPose(const Eigen::Vector4d& qvec, const Eigen::Vector3d& tvec,
                 Eigen::Vector4d* inv_qvec, Eigen::Vector3d* inv_tvec);
 
+// Apply the change between two versions of a camera pose to a third version
+// of the pose, e.g., to merge the results of two concurrent refinements of the
+// same pose. The result is the transformation T2 * T1^-1 * T3, i.e., the third
+// pose if the pose was not changed and the change in the camera frame
+// otherwise.
+//
+// @param qvec1, tvec1      Original camera pose.
+// @param qvec2, tvec2      Changed camera pose.
+// @param qvec3, tvec3      Camera pose to which the change is applied.
+// @param qvec, tvec        Resulting camera pose.
+void ApplyPoseChange(const Eigen::Vector4d& qvec1, const Eigen::Vector3d& tvec1,
+                     const Eigen::Vector4d& qvec2, const Eigen::Vector3d& tvec2,
+                     const Eigen::Vector4d& qvec3, const Eigen::Vector3d& tvec3,
+                     Eigen::Vector4d* qvec, Eigen::Vector3d* tvec);
+
 // Linearly interpolate camera pose.
 //
 // @param qvec1, tvec1      Camera pose at t0 = 0.
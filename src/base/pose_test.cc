@@ -346,6 +346,38 @@ BOOST_AUTO_TEST_CASE(TestInvertPose) {
   BOOST_CHECK(inv_inv_tvec.isApprox(Eigen::Vector3d(0, 1, 2)));
 }
 
+BOOST_AUTO_TEST_CASE(TestApplyPoseChange) {
+  const Eigen::Vector4d qvec1 = Eigen::Vector4d::Random().normalized();
+  const Eigen::Vector3d tvec1 = Eigen::Vector3d::Random();
+  const Eigen::Vector4d qvec3 = Eigen::Vector4d::Random().normalized();
+  const Eigen::Vector3d tvec3 = Eigen::Vector3d::Random();
+
+  // An unchanged pose yields the third pose.
+  Eigen::Vector4d qvec;
+  Eigen::Vector3d tvec;
+  ApplyPoseChange(qvec1, tvec1, qvec1, tvec1, qvec3, tvec3, &qvec, &tvec);
+  BOOST_CHECK(NormalizeQuaternion(qvec).isApprox(NormalizeQuaternion(qvec3)) ||
+              NormalizeQuaternion(qvec).isApprox(-NormalizeQuaternion(qvec3)));
+  BOOST_CHECK(tvec.isApprox(tvec3));
+
+  // The change in the camera frame is applied to the third pose.
+  const Eigen::Vector4d qvec2 = Eigen::Vector4d::Random().normalized();
+  const Eigen::Vector3d tvec2 = Eigen::Vector3d::Random();
+  ApplyPoseChange(qvec1, tvec1, qvec2, tvec2, qvec3, tvec3, &qvec, &tvec);
+
+  auto PoseMatrix = [](const Eigen::Vector4d& qvec,
+                       const Eigen::Vector3d& tvec) {
+    Eigen::Matrix4d matrix = Eigen::Matrix4d::Identity();
+    matrix.topRows<3>() = ComposeProjectionMatrix(qvec, tvec);
+    return matrix;
+  };
+
+  const Eigen::Matrix4d expected_matrix = PoseMatrix(qvec2, tvec2) *
+                                          PoseMatrix(qvec1, tvec1).inverse() *
+                                          PoseMatrix(qvec3, tvec3);
+  BOOST_CHECK(PoseMatrix(qvec, tvec).isApprox(expected_matrix));
+}
+
 BOOST_AUTO_TEST_CASE(TestInterpolatePose) {
   const Eigen::Vector4d qvec1 = Eigen::Vector4d::Random().normalized();
   const Eigen::Vector3d tvec1 = Eigen::Vector3d::Random();
@@ -36,6 +36,7 @@
 #include "base/database_cache.h"
 #include "base/pose.h"
 #include "base/projection.h"
+#include "base/reconstruction_store.h"
 #include "base/similarity_transform.h"
 #include "base/triangulation.h"
 #include "estimators/similarity_transform.h"
@@ -638,7 +639,7 @@ void Reconstruction::TranscribeImageIdsToDatabase(const Database& database) {
   std::unordered_map<image_t, image_t> old_to_new_image_ids;
   old_to_new_image_ids.reserve(NumImages());
 
-  EIGEN_STL_UMAP(image_t, class Image) new_images;
+  ImageMap new_images;
   new_images.reserve(NumImages());
 
   for (auto& image : images_) {
@@ -802,6 +803,8 @@ void Reconstruction::Read(const std::string& path) {
              ExistsFile(JoinPaths(path, "images.txt")) &&
              ExistsFile(JoinPaths(path, "points3D.txt"))) {
     ReadText(path);
+  } else if (ExistsFile(JoinPaths(path, "reconstruction.store"))) {
+    ReadStore(path);
   } else {
     LOG(FATAL) << "cameras, images, points3D files do not exist at " << path;
   }
@@ -833,6 +836,101 @@ void Reconstruction::WriteBinary(const std::string& path) const {
   WritePoints3DBinary(JoinPaths(path, "points3D.bin"));
 }
 
+void Reconstruction::ReadStore(const std::string& path) {
+  const ReconstructionStoreReader reader(
+      JoinPaths(path, "reconstruction.store"));
+
+  for (const auto camera_id : reader.CameraIds()) {
+    cameras_.emplace(camera_id, reader.ReadCamera(camera_id));
+  }
+
+  for (const auto image_id : reader.ImageIds()) {
+    class Image image = reader.ReadImage(image_id);
+    image.SetUp(Camera(image.CameraId()));
+    reg_image_ids_.push_back(image_id);
+    images_.emplace(image_id, image);
+  }
+
+  for (auto& point3D : reader.ReadPoints3D()) {
+    num_added_points3D_ = std::max(num_added_points3D_, point3D.first);
+    point3D.second.Track().Compress();
+    points3D_.emplace(point3D.first, std::move(point3D.second));
+  }
+}
+
+void Reconstruction::ReadStore(const std::string& path,
+                               const std::vector<image_t>& image_ids) {
+  const ReconstructionStoreReader reader(
+      JoinPaths(path, "reconstruction.store"));
+
+  std::unordered_set<point3D_t> point3D_ids;
+  for (const auto image_id : image_ids) {
+    if (ExistsImage(image_id)) {
+      continue;
+    }
+
+    class Image image = reader.ReadImage(image_id);
+    if (!ExistsCamera(image.CameraId())) {
+      cameras_.emplace(image.CameraId(), reader.ReadCamera(image.CameraId()));
+    }
+
+    for (const auto& point2D : image.Points2D()) {
+      if (point2D.HasPoint3D()) {
+        point3D_ids.insert(point2D.Point3DId());
+      }
+    }
+
+    image.SetUp(Camera(image.CameraId()));
+    reg_image_ids_.push_back(image_id);
+    images_.emplace(image_id, image);
+  }
+
+  for (const auto point3D_id : point3D_ids) {
+    class Point3D point3D = reader.ReadPoint3D(point3D_id);
+    std::vector<TrackElement> track_elements;
+    track_elements.reserve(point3D.Track().Length());
+    for (const auto& track_el : point3D.Track().Elements()) {
+      if (ExistsImage(track_el.image_id)) {
+        track_elements.push_back(track_el);
+      }
+    }
+    point3D.Track().SetElements(track_elements);
+    point3D.Track().Compress();
+
+    // Points observed by previously read images only gain the observations
+    // of the newly read images.
+    if (ExistsPoint3D(point3D_id)) {
+      Point3D(point3D_id).SetTrack(point3D.Track());
+    } else {
+      num_added_points3D_ = std::max(num_added_points3D_, point3D_id);
+      points3D_.emplace(point3D_id, point3D);
+    }
+  }
+}
+
+void Reconstruction::WriteStore(const std::string& path) const {
+  const std::string store_path = JoinPaths(path, "reconstruction.store");
+  if (ExistsFile(store_path)) {
+    boost::filesystem::remove(store_path);
+  }
+
+  ReconstructionStoreWriter writer(store_path);
+
+  for (const auto& camera : cameras_) {
+    writer.WriteCamera(camera.second);
+  }
+
+  for (const auto image_id : reg_image_ids_) {
+    writer.WriteImage(images_.at(image_id));
+  }
+
+  for (const auto& point3D : points3D_) {
+    writer.WritePoint3D(point3D.first, point3D.second);
+  }
+
+  writer.Close();
+}
+
 std::vector<PlyPoint> Reconstruction::ConvertToPLY() const {
   std::vector<PlyPoint> ply_points;
   ply_points.reserve(points3D_.size());
@@ -1940,7 +2038,7 @@ void Reconstruction::SetObservationAsTriangulated(
 
   const class Image& image = Image(image_id);
   const Point2D& point2D = image.Point2D(point2D_idx);
-  const std::vector<CorrespondenceGraph::Correspondence>& corrs =
+  const CorrespondenceGraph::CorrespondenceRange corrs =
       correspondence_graph_->FindCorrespondences(image_id, point2D_idx);
 
   CHECK(image.IsRegistered());
@@ -1974,7 +2072,7 @@ void Reconstruction::ResetTriObservations(const image_t image_id,
 
   const class Image& image = Image(image_id);
   const Point2D& point2D = image.Point2D(point2D_idx);
-  const std::vector<CorrespondenceGraph::Correspondence>& corrs =
+  const CorrespondenceGraph::CorrespondenceRange corrs =
       correspondence_graph_->FindCorrespondences(image_id, point2D_idx);
 
   CHECK(image.IsRegistered());
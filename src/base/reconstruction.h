@@ -45,6 +45,7 @@
 #include "base/point3d.h"
 #include "base/track.h"
 #include "util/alignment.h"
+#include "util/slot_map.h"
 #include "util/types.h"
 
 namespace colmap {
@@ -67,6 +68,18 @@ class Reconstruction {
     size_t num_total_corrs = 0;
   };
 
+  // Containers of the images and 3D points. By default, they are hash maps.
+  // With RECONSTRUCTION_SLOT_MAP_ENABLED, they are slot maps that store the
+  // objects by their dense identifiers in contiguous blocks, which avoids the
+  // pointer chasing of hash maps when traversing or looking up the objects.
+#ifdef RECONSTRUCTION_SLOT_MAP_ENABLED
+  typedef SlotMap<image_t, class Image> ImageMap;
+  typedef SlotMap<point3D_t, class Point3D> Point3DMap;
+#else
+  typedef EIGEN_STL_UMAP(image_t, class Image) ImageMap;
+  typedef EIGEN_STL_UMAP(point3D_t, class Point3D) Point3DMap;
+#endif
+
   Reconstruction();
 
   // Get number of objects.
@@ -94,9 +107,9 @@ class Reconstruction {
 
   // Get reference to all objects.
   inline const EIGEN_STL_UMAP(camera_t, class Camera) & Cameras() const;
-  inline const EIGEN_STL_UMAP(image_t, class Image) & Images() const;
+  inline const ImageMap& Images() const;
   inline const std::vector<image_t>& RegImageIds() const;
-  inline const EIGEN_STL_UMAP(point3D_t, class Point3D) & Points3D() const;
+  inline const Point3DMap& Points3D() const;
   inline const std::unordered_map<image_pair_t, ImagePairStat>& ImagePairs()
       const;
 
@@ -248,7 +261,8 @@ class Reconstruction {
   double ComputeMeanObservationsPerRegImage() const;
   double ComputeMeanReprojectionError() const;
 
-  // Read data from text or binary file. Prefer binary data if it exists.
+  // Read data from text, binary, or store file. Prefer binary data if it
+  // exists, then text data, and only then the store.
   void Read(const std::string& path);
   void Write(const std::string& path) const;
 
@@ -260,6 +274,20 @@ class Reconstruction {
   void WriteText(const std::string& path) const;
   void WriteBinary(const std::string& path) const;
 
+  // Read/write data from/to the indexed store file `reconstruction.store` in
+  // the given directory, see `ReconstructionStoreReader`. Writing replaces an
+  // existing store file.
+  void ReadStore(const std::string& path);
+  void WriteStore(const std::string& path) const;
+
+  // Only read the given images, their cameras, and the 3D points observed by
+  // them from the store. The tracks of the 3D points are restricted to the read
+  // images. Use `ReconstructionStoreReader::ImageIdsInBox` to select the images
+  // in a region of the scene. The method can be called repeatedly to read
+  // further images into the reconstruction.
+  void ReadStore(const std::string& path,
+                 const std::vector<image_t>& image_ids);
+
   // Convert 3D points in reconstruction to PLY point cloud.
   std::vector<PlyPoint> ConvertToPLY() const;
 
@@ -328,8 +356,8 @@ class Reconstruction {
   const CorrespondenceGraph* correspondence_graph_;
 
   EIGEN_STL_UMAP(camera_t, class Camera) cameras_;
-  EIGEN_STL_UMAP(image_t, class Image) images_;
-  EIGEN_STL_UMAP(point3D_t, class Point3D) points3D_;
+  ImageMap images_;
+  Point3DMap points3D_;
 
   std::unordered_map<image_pair_t, ImagePairStat> image_pair_stats_;
 
@@ -406,7 +434,7 @@ const EIGEN_STL_UMAP(camera_t, Camera) & Reconstruction::Cameras() const {
   return cameras_;
 }
 
-const EIGEN_STL_UMAP(image_t, class Image) & Reconstruction::Images() const {
+const Reconstruction::ImageMap& Reconstruction::Images() const {
   return images_;
 }
 
@@ -414,7 +442,7 @@ const std::vector<image_t>& Reconstruction::RegImageIds() const {
   return reg_image_ids_;
 }
 
-const EIGEN_STL_UMAP(point3D_t, Point3D) & Reconstruction::Points3D() const {
+const Reconstruction::Point3DMap& Reconstruction::Points3D() const {
   return points3D_;
 }
 
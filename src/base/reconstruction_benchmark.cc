@@ -0,0 +1,213 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include <iostream>
+#include <unordered_map>
+
+#include "base/image.h"
+#include "base/point3d.h"
+#include "util/alignment.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/random.h"
+#include "util/slot_map.h"
+#include "util/timer.h"
+
+using namespace colmap;
+
+namespace {
+
+size_t num_allocated_bytes = 0;
+
+// Aligned allocator that keeps track of the allocated bytes of hash maps.
+template <typename T>
+class CountingAllocator : public Eigen::aligned_allocator<T> {
+ public:
+  template <typename U>
+  struct rebind {
+    typedef CountingAllocator<U> other;
+  };
+
+  CountingAllocator() {}
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U>&) {}
+
+  T* allocate(const size_t num, const void* hint = 0) {
+    num_allocated_bytes += num * sizeof(T);
+    return Eigen::aligned_allocator<T>::allocate(num, hint);
+  }
+
+  void deallocate(T* ptr, const size_t num) {
+    num_allocated_bytes -= num * sizeof(T);
+    Eigen::aligned_allocator<T>::deallocate(ptr, num);
+  }
+};
+
+template <typename Key, typename Value>
+using HashMap =
+    std::unordered_map<Key, Value, std::hash<Key>, std::equal_to<Key>,
+                       CountingAllocator<std::pair<const Key, Value>>>;
+
+template <typename Key, typename Value>
+size_t ContainerNumBytes(const HashMap<Key, Value>&) {
+  return num_allocated_bytes;
+}
+
+template <typename Key, typename Value>
+size_t ContainerNumBytes(const SlotMap<Key, Value>& map) {
+  return map.capacity() *
+         (sizeof(typename SlotMap<Key, Value>::value_type) + sizeof(bool));
+}
+
+template <typename ImageMap, typename Point3DMap>
+struct Model {
+  ImageMap images;
+  Point3DMap points3D;
+};
+
+// Synthetic model, in which every 3D point is observed in a few images and a
+// fraction of the 3D points was deleted, as after filtering.
+template <typename ImageMap, typename Point3DMap>
+void CreateModel(const size_t num_images, const size_t num_points3D,
+                 Model<ImageMap, Point3DMap>* model) {
+  const size_t kNumPoints2D = 4 * num_points3D / num_images;
+
+  for (image_t image_id = 1; image_id <= num_images; ++image_id) {
+    Image image;
+    image.SetImageId(image_id);
+    image.SetPoints2D(std::vector<Eigen::Vector2d>(
+        kNumPoints2D, Eigen::Vector2d(image_id, image_id)));
+    model->images.emplace(image_id, image);
+  }
+
+  SetPRNGSeed(0);
+  for (point3D_t point3D_id = 1; point3D_id <= num_points3D; ++point3D_id) {
+    if (RandomReal(0.0, 1.0) < 0.1) {
+      continue;
+    }
+    Point3D point3D;
+    point3D.SetError(RandomReal(0.0, 1.0));
+    const int track_length = RandomInteger(2, 6);
+    for (int i = 0; i < track_length; ++i) {
+      point3D.Track().AddElement(RandomInteger<image_t>(1, num_images),
+                                 RandomInteger<point2D_t>(0, kNumPoints2D - 1));
+    }
+    model->points3D.emplace(point3D_id, point3D);
+  }
+}
+
+template <typename ImageMap, typename Point3DMap>
+void BenchmarkModel(const std::string& name, const size_t num_images,
+                    const size_t num_points3D) {
+  const int kNumRepetitions = 5;
+
+  num_allocated_bytes = 0;
+  Model<ImageMap, Point3DMap> model;
+  CreateModel(num_images, num_points3D, &model);
+  const double num_megabytes = (ContainerNumBytes(model.images) +
+                                ContainerNumBytes(model.points3D)) /
+                               (1024.0 * 1024.0);
+
+  Timer timer;
+
+  // Traversal of all 3D points, as in `ComputeMeanReprojectionError`.
+  double error_sum = 0;
+  timer.Start();
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    for (const auto& point3D : model.points3D) {
+      error_sum += point3D.second.Error();
+    }
+  }
+  const double traverse_time = timer.ElapsedSeconds() / kNumRepetitions;
+
+  // Traversal of all observations, as in `FilterPoints3D` or when setting up
+  // the bundle adjustment problem.
+  double coord_sum = 0;
+  timer.Restart();
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    for (const auto& point3D : model.points3D) {
+      for (const auto& track_el : point3D.second.Track().Elements()) {
+        coord_sum += model.images.at(track_el.image_id)
+                         .Point2D(track_el.point2D_idx)
+                         .X();
+      }
+    }
+  }
+  const double tracks_time = timer.ElapsedSeconds() / kNumRepetitions;
+
+  // Random lookups of 3D points.
+  std::vector<point3D_t> point3D_ids(num_points3D);
+  for (auto& point3D_id : point3D_ids) {
+    point3D_id = RandomInteger<point3D_t>(1, num_points3D);
+  }
+  size_t num_found = 0;
+  timer.Restart();
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    for (const auto point3D_id : point3D_ids) {
+      num_found += model.points3D.count(point3D_id);
+    }
+  }
+  const double lookup_time = timer.ElapsedSeconds() / kNumRepetitions;
+
+  std::cout << StringPrintf("%10s %10d %10.1fMB %9.4fs %9.4fs %9.4fs",
+                            name.c_str(), static_cast<int>(num_points3D),
+                            num_megabytes, traverse_time, tracks_time,
+                            lookup_time)
+            << std::endl;
+
+  // Prevent the compiler from optimizing away the loops.
+  CHECK_GE(error_sum + coord_sum + num_found, 0);
+}
+
+}  // namespace
+
+// Benchmark of the memory usage and traversal times of the hash maps and slot
+// maps for storing the images and 3D points of a reconstruction. Note that the
+// memory excludes the heap storage of tracks and 2D points, which is the same
+// for both containers.
+int main(int argc, char** argv) {
+  InitializeGlog(argv);
+
+  std::cout << StringPrintf("%10s %10s %12s %10s %10s %10s", "container",
+                            "points", "memory", "traverse", "tracks",
+                            "lookup")
+            << std::endl;
+
+  for (const size_t num_points3D : {100000, 1000000, 5000000}) {
+    const size_t num_images = num_points3D / 500;
+    BenchmarkModel<HashMap<image_t, Image>, HashMap<point3D_t, Point3D>>(
+        "hash_map", num_images, num_points3D);
+    BenchmarkModel<SlotMap<image_t, Image>, SlotMap<point3D_t, Point3D>>(
+        "slot_map", num_images, num_points3D);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,823 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include "base/reconstruction_store.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
+
+#include "base/pose.h"
+#include "util/logging.h"
+#include "util/misc.h"
+
+namespace colmap {
+namespace {
+
+const static char kReconstructionStoreMagic[8] = {'C', 'O', 'L', 'M',
+                                                  'A', 'P', 'R', 'S'};
+const static uint32_t kReconstructionStoreVersion = 1;
+
+struct ReconstructionStoreHeader {
+  char magic[8];
+  uint32_t version = kReconstructionStoreVersion;
+  uint32_t reserved = 0;
+  uint64_t num_cameras = 0;
+  uint64_t num_images = 0;
+  uint64_t num_chunks = 0;
+  uint64_t num_segments = 0;
+  uint64_t directory_offset = 0;
+  uint8_t padding[8] = {0};
+};
+
+// Fixed-size part of the records, which is followed by the camera parameters,
+// the image name and 2D points, and the track elements, respectively.
+
+struct CameraRecord {
+  uint32_t camera_id;
+  int32_t model_id;
+  uint64_t width;
+  uint64_t height;
+  uint64_t num_params;
+};
+
+struct ImageRecord {
+  uint32_t image_id;
+  uint32_t camera_id;
+  double qvec[4];
+  double tvec[3];
+  uint64_t name_length;
+  uint64_t num_points2D;
+};
+
+struct Point2DRecord {
+  double xy[2];
+  uint64_t point3D_id;
+};
+
+struct Point3DRecord {
+  uint64_t point3D_id;
+  double xyz[3];
+  double error;
+  uint8_t color[3];
+  uint8_t reserved;
+  uint32_t track_length;
+};
+
+struct TrackElementRecord {
+  uint32_t image_id;
+  uint32_t point2D_idx;
+};
+
+struct SegmentRecord {
+  uint64_t point3D_id;
+  uint64_t offset;
+};
+
+static_assert(sizeof(ReconstructionStoreHeader) == 64,
+              "Unexpected reconstruction store header size");
+static_assert(sizeof(ReconstructionStoreCameraEntry) == 24,
+              "Unexpected reconstruction store camera entry size");
+static_assert(sizeof(ReconstructionStoreImageEntry) == 48,
+              "Unexpected reconstruction store image entry size");
+static_assert(sizeof(ReconstructionStoreChunkEntry) == 64,
+              "Unexpected reconstruction store chunk entry size");
+static_assert(sizeof(ReconstructionStoreSegmentEntry) == 16,
+              "Unexpected reconstruction store segment entry size");
+static_assert(sizeof(Point3DRecord) == 48,
+              "Unexpected reconstruction store point record size");
+static_assert(sizeof(SegmentRecord) == 16,
+              "Unexpected reconstruction store segment record size");
+
+uint64_t AlignOffset(const uint64_t offset) {
+  return (offset + kReconstructionStoreAlignment - 1) /
+         kReconstructionStoreAlignment * kReconstructionStoreAlignment;
+}
+
+uint64_t DirectoryNumBytes(const ReconstructionStoreHeader& header) {
+  return header.num_cameras * sizeof(ReconstructionStoreCameraEntry) +
+         header.num_images * sizeof(ReconstructionStoreImageEntry) +
+         header.num_chunks * sizeof(ReconstructionStoreChunkEntry) +
+         header.num_segments * sizeof(ReconstructionStoreSegmentEntry);
+}
+
+bool CheckHeader(const ReconstructionStoreHeader& header,
+                 const uint64_t num_bytes) {
+  return std::memcmp(header.magic, kReconstructionStoreMagic,
+                     sizeof(kReconstructionStoreMagic)) == 0 &&
+         header.version == kReconstructionStoreVersion &&
+         header.directory_offset >= sizeof(ReconstructionStoreHeader) &&
+         header.directory_offset + DirectoryNumBytes(header) <= num_bytes;
+}
+
+bool CheckRange(const uint64_t offset, const uint64_t num_bytes,
+                const uint64_t file_num_bytes) {
+  return offset >= sizeof(ReconstructionStoreHeader) &&
+         offset + num_bytes <= file_num_bytes;
+}
+
+// Read the directory entries from the given file contents and advance the
+// pointer past the entries.
+template <typename Entry>
+std::vector<Entry> ReadEntries(const uint64_t num_entries,
+                               const uint8_t** data) {
+  std::vector<Entry> entries(num_entries);
+  std::memcpy(entries.data(), *data, num_entries * sizeof(Entry));
+  *data += num_entries * sizeof(Entry);
+  return entries;
+}
+
+template <typename T>
+void AppendRecord(const T& record, std::vector<char>* data) {
+  const char* record_data = reinterpret_cast<const char*>(&record);
+  data->insert(data->end(), record_data, record_data + sizeof(T));
+}
+
+template <typename T>
+T ReadRecord(const uint8_t** data) {
+  T record;
+  std::memcpy(&record, *data, sizeof(T));
+  *data += sizeof(T);
+  return record;
+}
+
+void SerializeCamera(const Camera& camera, std::vector<char>* data) {
+  CameraRecord record;
+  record.camera_id = camera.CameraId();
+  record.model_id = camera.ModelId();
+  record.width = camera.Width();
+  record.height = camera.Height();
+  record.num_params = camera.NumParams();
+  AppendRecord(record, data);
+  for (const double param : camera.Params()) {
+    AppendRecord(param, data);
+  }
+}
+
+void SerializeImage(const Image& image, std::vector<char>* data) {
+  ImageRecord record;
+  record.image_id = image.ImageId();
+  record.camera_id = image.CameraId();
+  const Eigen::Vector4d normalized_qvec = NormalizeQuaternion(image.Qvec());
+  for (int i = 0; i < 4; ++i) {
+    record.qvec[i] = normalized_qvec(i);
+  }
+  for (int i = 0; i < 3; ++i) {
+    record.tvec[i] = image.Tvec(i);
+  }
+  record.name_length = image.Name().size();
+  record.num_points2D = image.NumPoints2D();
+  AppendRecord(record, data);
+  data->insert(data->end(), image.Name().begin(), image.Name().end());
+  for (const Point2D& point2D : image.Points2D()) {
+    Point2DRecord point2D_record;
+    point2D_record.xy[0] = point2D.X();
+    point2D_record.xy[1] = point2D.Y();
+    point2D_record.point3D_id = point2D.Point3DId();
+    AppendRecord(point2D_record, data);
+  }
+}
+
+void SerializePoint3D(const point3D_t point3D_id, const Point3D& point3D,
+                      std::vector<char>* data) {
+  Point3DRecord record;
+  record.point3D_id = point3D_id;
+  for (int i = 0; i < 3; ++i) {
+    record.xyz[i] = point3D.XYZ(i);
+    record.color[i] = point3D.Color(i);
+  }
+  record.error = point3D.Error();
+  record.reserved = 0;
+  record.track_length = static_cast<uint32_t>(point3D.Track().Length());
+  AppendRecord(record, data);
+  for (const auto& track_el : point3D.Track().Elements()) {
+    TrackElementRecord track_el_record;
+    track_el_record.image_id = track_el.image_id;
+    track_el_record.point2D_idx = track_el.point2D_idx;
+    AppendRecord(track_el_record, data);
+  }
+}
+
+size_t Point3DRecordNumBytes(const Point3DRecord& record) {
+  return sizeof(Point3DRecord) +
+         record.track_length * sizeof(TrackElementRecord);
+}
+
+Point3D DeserializePoint3D(const Point3DRecord& record,
+                           const uint8_t* track_data) {
+  Point3D point3D;
+  for (int i = 0; i < 3; ++i) {
+    point3D.XYZ(i) = record.xyz[i];
+    point3D.Color(i) = record.color[i];
+  }
+  point3D.SetError(record.error);
+  point3D.Track().Reserve(record.track_length);
+  for (uint32_t i = 0; i < record.track_length; ++i) {
+    const TrackElementRecord track_el =
+        ReadRecord<TrackElementRecord>(&track_data);
+    point3D.Track().AddElement(track_el.image_id, track_el.point2D_idx);
+  }
+  return point3D;
+}
+
+bool IsInBox(const double* xyz, const Eigen::Vector3d& min_bound,
+             const Eigen::Vector3d& max_bound) {
+  return xyz[0] >= min_bound(0) && xyz[1] >= min_bound(1) &&
+         xyz[2] >= min_bound(2) && xyz[0] <= max_bound(0) &&
+         xyz[1] <= max_bound(1) && xyz[2] <= max_bound(2);
+}
+
+bool OverlapsBox(const ReconstructionStoreChunkEntry& chunk,
+                 const Eigen::Vector3d& min_bound,
+                 const Eigen::Vector3d& max_bound) {
+  for (int i = 0; i < 3; ++i) {
+    if (chunk.max_bound[i] < min_bound(i) ||
+        chunk.min_bound[i] > max_bound(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Interleave the lower 21 bits of the three coordinates into a Morton code, so
+// that sorting by the code groups spatially close points together.
+uint64_t SpreadBits(uint64_t value) {
+  value &= 0x1fffff;
+  value = (value | value << 32) & 0x1f00000000ffff;
+  value = (value | value << 16) & 0x1f0000ff0000ff;
+  value = (value | value << 8) & 0x100f00f00f00f00f;
+  value = (value | value << 4) & 0x10c30c30c30c30c3;
+  value = (value | value << 2) & 0x1249249249249249;
+  return value;
+}
+
+uint64_t ComputeMortonCode(const Eigen::Vector3d& xyz,
+                           const Eigen::Vector3d& min_bound,
+                           const Eigen::Vector3d& scale) {
+  uint64_t code = 0;
+  for (int i = 0; i < 3; ++i) {
+    const double normalized = (xyz(i) - min_bound(i)) * scale(i);
+    const uint64_t quantized =
+        normalized > 0 ? static_cast<uint64_t>(
+                             std::min(normalized, double(0x1fffff)))
+                       : 0;
+    code |= SpreadBits(quantized) << i;
+  }
+  return code;
+}
+
+}  // namespace
+
+ReconstructionStoreReader::ReconstructionStoreReader(const std::string& path)
+    : file_(path), data_(file_.Data()) {
+  const uint64_t num_bytes = file_.NumBytes();
+  CHECK_GE(num_bytes, sizeof(ReconstructionStoreHeader)) << path;
+
+  ReconstructionStoreHeader header;
+  std::memcpy(&header, data_, sizeof(header));
+  CHECK(CheckHeader(header, num_bytes))
+      << "Invalid reconstruction store: " << path;
+
+  const uint8_t* directory = data_ + header.directory_offset;
+
+  for (const auto& camera : ReadEntries<ReconstructionStoreCameraEntry>(
+           header.num_cameras, &directory)) {
+    CHECK(CheckRange(camera.offset, camera.num_bytes, num_bytes))
+        << "Invalid reconstruction store camera entry: " << path;
+    cameras_.emplace(camera.camera_id, camera);
+  }
+
+  for (const auto& image : ReadEntries<ReconstructionStoreImageEntry>(
+           header.num_images, &directory)) {
+    CHECK(CheckRange(image.offset, image.num_bytes, num_bytes))
+        << "Invalid reconstruction store image entry: " << path;
+    images_.emplace(image.image_id, image);
+  }
+
+  chunks_ = ReadEntries<ReconstructionStoreChunkEntry>(header.num_chunks,
+                                                       &directory);
+  for (const auto& chunk : chunks_) {
+    // The size of the point records is only known when parsing the chunk, so
+    // only check the smallest possible extent here.
+    CHECK(CheckRange(chunk.offset, chunk.num_points3D * sizeof(Point3DRecord),
+                     num_bytes))
+        << "Invalid reconstruction store chunk entry: " << path;
+  }
+
+  segments_ = ReadEntries<ReconstructionStoreSegmentEntry>(header.num_segments,
+                                                           &directory);
+  for (const auto& segment : segments_) {
+    CHECK(CheckRange(segment.offset,
+                     segment.num_points3D * sizeof(SegmentRecord), num_bytes))
+        << "Invalid reconstruction store segment entry: " << path;
+  }
+  std::reverse(segments_.begin(), segments_.end());
+}
+
+size_t ReconstructionStoreReader::NumCameras() const { return cameras_.size(); }
+
+size_t ReconstructionStoreReader::NumImages() const { return images_.size(); }
+
+std::vector<camera_t> ReconstructionStoreReader::CameraIds() const {
+  std::vector<camera_t> camera_ids;
+  camera_ids.reserve(cameras_.size());
+  for (const auto& camera : cameras_) {
+    camera_ids.push_back(camera.first);
+  }
+  std::sort(camera_ids.begin(), camera_ids.end());
+  return camera_ids;
+}
+
+std::vector<image_t> ReconstructionStoreReader::ImageIds() const {
+  std::vector<image_t> image_ids;
+  image_ids.reserve(images_.size());
+  for (const auto& image : images_) {
+    image_ids.push_back(image.first);
+  }
+  std::sort(image_ids.begin(), image_ids.end());
+  return image_ids;
+}
+
+std::vector<point3D_t> ReconstructionStoreReader::Point3DIds() const {
+  std::vector<point3D_t> point3D_ids;
+  std::unordered_set<point3D_t> visited_point3D_ids;
+  for (const auto& segment : segments_) {
+    const SegmentRecord* records =
+        reinterpret_cast<const SegmentRecord*>(data_ + segment.offset);
+    for (uint64_t i = 0; i < segment.num_points3D; ++i) {
+      // Only the newest record of a point decides whether it exists.
+      if (visited_point3D_ids.insert(records[i].point3D_id).second &&
+          records[i].offset > 0) {
+        point3D_ids.push_back(records[i].point3D_id);
+      }
+    }
+  }
+  std::sort(point3D_ids.begin(), point3D_ids.end());
+  return point3D_ids;
+}
+
+bool ReconstructionStoreReader::ExistsCamera(const camera_t camera_id) const {
+  return cameras_.count(camera_id) > 0;
+}
+
+bool ReconstructionStoreReader::ExistsImage(const image_t image_id) const {
+  return images_.count(image_id) > 0;
+}
+
+bool ReconstructionStoreReader::ExistsPoint3D(
+    const point3D_t point3D_id) const {
+  return FindPoint3DOffset(point3D_id) > 0;
+}
+
+Camera ReconstructionStoreReader::ReadCamera(const camera_t camera_id) const {
+  CHECK(ExistsCamera(camera_id)) << "Camera " << camera_id
+                                 << " does not exist";
+  const auto& entry = cameras_.at(camera_id);
+  const uint8_t* data = data_ + entry.offset;
+
+  const CameraRecord record = ReadRecord<CameraRecord>(&data);
+  CHECK_EQ(entry.num_bytes,
+           sizeof(CameraRecord) + record.num_params * sizeof(double));
+
+  class Camera camera;
+  camera.SetCameraId(record.camera_id);
+  camera.SetModelId(record.model_id);
+  camera.SetWidth(record.width);
+  camera.SetHeight(record.height);
+  camera.Params().resize(record.num_params);
+  std::memcpy(camera.ParamsData(), data, record.num_params * sizeof(double));
+  CHECK(camera.VerifyParams());
+
+  return camera;
+}
+
+Image ReconstructionStoreReader::ReadImage(const image_t image_id) const {
+  CHECK(ExistsImage(image_id)) << "Image " << image_id << " does not exist";
+  const auto& entry = images_.at(image_id);
+  const uint8_t* data = data_ + entry.offset;
+
+  const ImageRecord record = ReadRecord<ImageRecord>(&data);
+  CHECK_EQ(entry.num_bytes, sizeof(ImageRecord) + record.name_length +
+                                record.num_points2D * sizeof(Point2DRecord));
+
+  class Image image;
+  image.SetImageId(record.image_id);
+  image.SetCameraId(record.camera_id);
+  image.SetQvec(Eigen::Vector4d(record.qvec[0], record.qvec[1], record.qvec[2],
+                                record.qvec[3]));
+  image.SetTvec(
+      Eigen::Vector3d(record.tvec[0], record.tvec[1], record.tvec[2]));
+  image.SetName(std::string(reinterpret_cast<const char*>(data),
+                            record.name_length));
+  data += record.name_length;
+
+  std::vector<Eigen::Vector2d> points2D;
+  points2D.reserve(record.num_points2D);
+  std::vector<point3D_t> point3D_ids;
+  point3D_ids.reserve(record.num_points2D);
+  for (uint64_t i = 0; i < record.num_points2D; ++i) {
+    const Point2DRecord point2D = ReadRecord<Point2DRecord>(&data);
+    points2D.emplace_back(point2D.xy[0], point2D.xy[1]);
+    point3D_ids.push_back(point2D.point3D_id);
+  }
+
+  image.SetPoints2D(points2D);
+  for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+       ++point2D_idx) {
+    if (point3D_ids[point2D_idx] != kInvalidPoint3DId) {
+      image.SetPoint3DForPoint2D(point2D_idx, point3D_ids[point2D_idx]);
+    }
+  }
+
+  image.SetRegistered(true);
+
+  return image;
+}
+
+Point3D ReconstructionStoreReader::ReadPoint3D(
+    const point3D_t point3D_id) const {
+  const uint64_t offset = FindPoint3DOffset(point3D_id);
+  CHECK_GT(offset, 0) << "3D point " << point3D_id << " does not exist";
+  const uint8_t* data = data_ + offset;
+  const Point3DRecord record = ReadRecord<Point3DRecord>(&data);
+  CHECK_EQ(record.point3D_id, point3D_id);
+  CHECK_LE(offset + Point3DRecordNumBytes(record), file_.NumBytes());
+  return DeserializePoint3D(record, data);
+}
+
+EIGEN_STL_UMAP(point3D_t, Point3D)
+ReconstructionStoreReader::ReadPoints3D() const {
+  const double kInf = std::numeric_limits<double>::infinity();
+  return ReadPoints3DInBox(Eigen::Vector3d::Constant(-kInf),
+                           Eigen::Vector3d::Constant(kInf));
+}
+
+std::vector<image_t> ReconstructionStoreReader::ImageIdsInBox(
+    const Eigen::Vector3d& min_bound, const Eigen::Vector3d& max_bound) const {
+  std::vector<image_t> image_ids;
+  for (const auto& image : images_) {
+    if (IsInBox(image.second.proj_center, min_bound, max_bound)) {
+      image_ids.push_back(image.first);
+    }
+  }
+  std::sort(image_ids.begin(), image_ids.end());
+  return image_ids;
+}
+
+EIGEN_STL_UMAP(point3D_t, Point3D)
+ReconstructionStoreReader::ReadPoints3DInBox(
+    const Eigen::Vector3d& min_bound, const Eigen::Vector3d& max_bound) const {
+  EIGEN_STL_UMAP(point3D_t, class Point3D) points3D;
+  for (const auto& chunk : chunks_) {
+    if (!OverlapsBox(chunk, min_bound, max_bound)) {
+      continue;
+    }
+
+    uint64_t offset = chunk.offset;
+    for (uint64_t i = 0; i < chunk.num_points3D; ++i) {
+      CHECK_LE(offset + sizeof(Point3DRecord), file_.NumBytes());
+      const uint8_t* data = data_ + offset;
+      const Point3DRecord record = ReadRecord<Point3DRecord>(&data);
+      const uint64_t record_offset = offset;
+      offset += Point3DRecordNumBytes(record);
+      CHECK_LE(offset, file_.NumBytes());
+
+      // Skip points outside the box and records that were superseded by a
+      // newer record or deleted later on.
+      if (IsInBox(record.xyz, min_bound, max_bound) &&
+          FindPoint3DOffset(record.point3D_id) == record_offset) {
+        points3D.emplace(record.point3D_id, DeserializePoint3D(record, data));
+      }
+    }
+  }
+  return points3D;
+}
+
+uint64_t ReconstructionStoreReader::FindPoint3DOffset(
+    const point3D_t point3D_id) const {
+  for (const auto& segment : segments_) {
+    const SegmentRecord* begin =
+        reinterpret_cast<const SegmentRecord*>(data_ + segment.offset);
+    const SegmentRecord* end = begin + segment.num_points3D;
+    const SegmentRecord* record = std::lower_bound(
+        begin, end, point3D_id,
+        [](const SegmentRecord& record, const point3D_t point3D_id) {
+          return record.point3D_id < point3D_id;
+        });
+    if (record != end && record->point3D_id == point3D_id) {
+      return record->offset;
+    }
+  }
+  return 0;
+}
+
+ReconstructionStoreWriter::ReconstructionStoreWriter(const std::string& path)
+    : end_offset_(0), dirty_(false) {
+  if (ExistsFile(path)) {
+    end_offset_ = GetFileSize(path);
+
+    std::ifstream file(path, std::ios::binary);
+    CHECK(file.is_open()) << path;
+
+    ReconstructionStoreHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    CHECK(file.good() && CheckHeader(header, end_offset_))
+        << "Invalid reconstruction store: " << path;
+
+    std::vector<uint8_t> directory(DirectoryNumBytes(header));
+    file.seekg(header.directory_offset);
+    file.read(reinterpret_cast<char*>(directory.data()), directory.size());
+    CHECK(file.good()) << path;
+
+    const uint8_t* directory_data = directory.data();
+    for (const auto& camera : ReadEntries<ReconstructionStoreCameraEntry>(
+             header.num_cameras, &directory_data)) {
+      cameras_.emplace(camera.camera_id, camera);
+    }
+    for (const auto& image : ReadEntries<ReconstructionStoreImageEntry>(
+             header.num_images, &directory_data)) {
+      images_.emplace(image.image_id, image);
+    }
+    chunks_ = ReadEntries<ReconstructionStoreChunkEntry>(header.num_chunks,
+                                                         &directory_data);
+    segments_ = ReadEntries<ReconstructionStoreSegmentEntry>(
+        header.num_segments, &directory_data);
+  } else {
+    std::ofstream file(path, std::ios::binary);
+    CHECK(file.is_open()) << path;
+    ReconstructionStoreHeader header;
+    std::memcpy(header.magic, kReconstructionStoreMagic,
+                sizeof(kReconstructionStoreMagic));
+    header.directory_offset = sizeof(header);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    CHECK(file.good()) << path;
+    end_offset_ = sizeof(header);
+  }
+
+  file_.open(path, std::ios::binary | std::ios::in | std::ios::out);
+  CHECK(file_.is_open()) << path;
+}
+
+ReconstructionStoreWriter::~ReconstructionStoreWriter() { Close(); }
+
+void ReconstructionStoreWriter::WriteCamera(const class Camera& camera) {
+  std::vector<char> data;
+  SerializeCamera(camera, &data);
+
+  ReconstructionStoreCameraEntry& entry = cameras_[camera.CameraId()];
+  entry.camera_id = camera.CameraId();
+  entry.num_bytes = data.size();
+  entry.offset = AppendData(data.data(), data.size());
+}
+
+void ReconstructionStoreWriter::WriteImage(const class Image& image) {
+  std::vector<char> data;
+  SerializeImage(image, &data);
+
+  ReconstructionStoreImageEntry& entry = images_[image.ImageId()];
+  entry.image_id = image.ImageId();
+  entry.camera_id = image.CameraId();
+  const Eigen::Vector3d proj_center = image.ProjectionCenter();
+  for (int i = 0; i < 3; ++i) {
+    entry.proj_center[i] = proj_center(i);
+  }
+  entry.num_bytes = data.size();
+  entry.offset = AppendData(data.data(), data.size());
+}
+
+void ReconstructionStoreWriter::WritePoint3D(const point3D_t point3D_id,
+                                             const class Point3D& point3D) {
+  PendingPoint3D pending_point3D;
+  pending_point3D.point3D_id = point3D_id;
+  pending_point3D.xyz = point3D.XYZ();
+  pending_point3D.record_offset = pending_records_.size();
+  SerializePoint3D(point3D_id, point3D, &pending_records_);
+  pending_point3D.record_num_bytes =
+      pending_records_.size() - pending_point3D.record_offset;
+  pending_points3D_.push_back(pending_point3D);
+}
+
+void ReconstructionStoreWriter::DeleteImage(const image_t image_id) {
+  if (images_.erase(image_id) > 0) {
+    dirty_ = true;
+  }
+}
+
+void ReconstructionStoreWriter::DeletePoint3D(const point3D_t point3D_id) {
+  PendingPoint3D pending_point3D;
+  pending_point3D.point3D_id = point3D_id;
+  pending_point3D.xyz.setZero();
+  pending_point3D.record_offset = 0;
+  pending_point3D.record_num_bytes = 0;
+  pending_points3D_.push_back(pending_point3D);
+}
+
+void ReconstructionStoreWriter::Flush() {
+  if (!file_.is_open()) {
+    return;
+  }
+
+  FlushPoints3D();
+
+  if (!dirty_) {
+    return;
+  }
+
+  std::vector<char> directory;
+  for (const auto& camera : cameras_) {
+    AppendRecord(camera.second, &directory);
+  }
+  for (const auto& image : images_) {
+    AppendRecord(image.second, &directory);
+  }
+  for (const auto& chunk : chunks_) {
+    AppendRecord(chunk, &directory);
+  }
+  for (const auto& segment : segments_) {
+    AppendRecord(segment, &directory);
+  }
+
+  ReconstructionStoreHeader header;
+  std::memcpy(header.magic, kReconstructionStoreMagic,
+              sizeof(kReconstructionStoreMagic));
+  header.num_cameras = cameras_.size();
+  header.num_images = images_.size();
+  header.num_chunks = chunks_.size();
+  header.num_segments = segments_.size();
+  header.directory_offset = AppendData(directory.data(), directory.size());
+
+  // Only update the header once the data and directory are on disk, so that
+  // an interrupted writer leaves the previous directory intact.
+  file_.flush();
+  file_.seekp(0);
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file_.flush();
+  CHECK(file_.good());
+
+  dirty_ = false;
+}
+
+void ReconstructionStoreWriter::Close() {
+  if (file_.is_open()) {
+    Flush();
+    file_.close();
+  }
+}
+
+void ReconstructionStoreWriter::FlushPoints3D() {
+  if (pending_points3D_.empty()) {
+    return;
+  }
+
+  // Sort the written points along a Z-order curve through their bounding box.
+  std::vector<size_t> written_idxs;
+  written_idxs.reserve(pending_points3D_.size());
+  Eigen::Vector3d min_bound =
+      Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+  Eigen::Vector3d max_bound =
+      Eigen::Vector3d::Constant(std::numeric_limits<double>::lowest());
+  for (size_t i = 0; i < pending_points3D_.size(); ++i) {
+    if (pending_points3D_[i].record_num_bytes > 0) {
+      written_idxs.push_back(i);
+      min_bound = min_bound.cwiseMin(pending_points3D_[i].xyz);
+      max_bound = max_bound.cwiseMax(pending_points3D_[i].xyz);
+    }
+  }
+
+  Eigen::Vector3d scale;
+  for (int i = 0; i < 3; ++i) {
+    const double extent = max_bound(i) - min_bound(i);
+    scale(i) = extent > 0 ? double(0x1fffff) / extent : 0.0;
+  }
+  std::vector<uint64_t> morton_codes(pending_points3D_.size(), 0);
+  for (const size_t idx : written_idxs) {
+    morton_codes[idx] =
+        ComputeMortonCode(pending_points3D_[idx].xyz, min_bound, scale);
+  }
+  std::stable_sort(written_idxs.begin(), written_idxs.end(),
+                   [&morton_codes](const size_t idx1, const size_t idx2) {
+                     return morton_codes[idx1] < morton_codes[idx2];
+                   });
+
+  // Write the chunks and remember the file offset of every written record.
+  std::vector<uint64_t> offsets(pending_points3D_.size(), 0);
+  std::vector<char> chunk_data;
+  for (size_t begin = 0; begin < written_idxs.size();
+       begin += kReconstructionStoreChunkSize) {
+    const size_t end =
+        std::min(begin + kReconstructionStoreChunkSize, written_idxs.size());
+
+    ReconstructionStoreChunkEntry chunk;
+    chunk.num_points3D = end - begin;
+    Eigen::Map<Eigen::Vector3d> chunk_min_bound(chunk.min_bound);
+    Eigen::Map<Eigen::Vector3d> chunk_max_bound(chunk.max_bound);
+    chunk_min_bound = pending_points3D_[written_idxs[begin]].xyz;
+    chunk_max_bound = chunk_min_bound;
+
+    chunk_data.clear();
+    for (size_t i = begin; i < end; ++i) {
+      const PendingPoint3D& point3D = pending_points3D_[written_idxs[i]];
+      chunk_min_bound = chunk_min_bound.cwiseMin(point3D.xyz);
+      chunk_max_bound = chunk_max_bound.cwiseMax(point3D.xyz);
+      offsets[written_idxs[i]] = chunk_data.size();
+      chunk_data.insert(
+          chunk_data.end(), pending_records_.begin() + point3D.record_offset,
+          pending_records_.begin() + point3D.record_offset +
+              point3D.record_num_bytes);
+    }
+
+    chunk.offset = AppendData(chunk_data.data(), chunk_data.size());
+    for (size_t i = begin; i < end; ++i) {
+      offsets[written_idxs[i]] += chunk.offset;
+    }
+
+    chunks_.push_back(chunk);
+  }
+
+  // Write the index segment, in which the last write or delete of a point
+  // since the previous flush wins.
+  std::vector<SegmentRecord> records;
+  records.reserve(pending_points3D_.size());
+  for (size_t i = 0; i < pending_points3D_.size(); ++i) {
+    SegmentRecord record;
+    record.point3D_id = pending_points3D_[i].point3D_id;
+    record.offset = offsets[i];
+    records.push_back(record);
+  }
+
+  std::stable_sort(records.begin(), records.end(),
+                   [](const SegmentRecord& record1,
+                      const SegmentRecord& record2) {
+                     return record1.point3D_id < record2.point3D_id;
+                   });
+
+  std::vector<SegmentRecord> unique_records;
+  unique_records.reserve(records.size());
+  for (const auto& record : records) {
+    if (!unique_records.empty() &&
+        unique_records.back().point3D_id == record.point3D_id) {
+      unique_records.back() = record;
+    } else {
+      unique_records.push_back(record);
+    }
+  }
+
+  ReconstructionStoreSegmentEntry segment;
+  segment.num_points3D = unique_records.size();
+  segment.offset =
+      AppendData(reinterpret_cast<const char*>(unique_records.data()),
+                 unique_records.size() * sizeof(SegmentRecord));
+  segments_.push_back(segment);
+
+  pending_points3D_.clear();
+  pending_records_.clear();
+}
+
+uint64_t ReconstructionStoreWriter::AppendData(const char* data,
+                                               const size_t num_bytes) {
+  CHECK(file_.is_open());
+
+  const uint64_t offset = AlignOffset(end_offset_);
+  const std::vector<char> padding(offset - end_offset_, 0);
+
+  file_.seekp(end_offset_);
+  file_.write(padding.data(), padding.size());
+  file_.write(data, num_bytes);
+  CHECK(file_.good());
+
+  end_offset_ = offset + num_bytes;
+  dirty_ = true;
+
+  return offset;
+}
+
+}  // namespace colmap
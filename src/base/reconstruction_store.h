@@ -0,0 +1,216 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_BASE_RECONSTRUCTION_STORE_H_
+#define COLMAP_SRC_BASE_RECONSTRUCTION_STORE_H_
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "base/camera.h"
+#include "base/image.h"
+#include "base/point3d.h"
+#include "util/alignment.h"
+#include "util/mapped_file.h"
+#include "util/types.h"
+
+namespace colmap {
+
+// The reconstruction store is a single binary file that holds the cameras,
+// registered images, and 3D points of a reconstruction in an indexed layout.
+// In contrast to the `cameras.bin`, `images.bin`, `points3D.bin` format, it is
+// memory-mapped for reading and individual cameras, images, and 3D points or
+// spatial subsets of the reconstruction can be loaded without reading the
+// entire file.
+//
+// The file layout in native byte order is:
+//
+//    header (64 bytes): magic, version, number of directory entries, and
+//                       directory offset
+//    data:              camera, image, and 3D point records, each record set
+//                       aligned to `kReconstructionStoreAlignment` bytes
+//    point index:       one segment per flush with sorted (point3D_id, offset)
+//                       pairs for all 3D points written since the last flush
+//    directory:         camera entries, image entries, point chunk entries,
+//                       and point index segment entries
+//
+// 3D points are written in chunks of up to `kReconstructionStoreChunkSize`
+// spatially close points, so that bounding box queries only touch the chunks
+// that overlap the box. Records are never modified in place: rewriting an
+// image or 3D point appends a new record and the newest record wins.
+//
+// As for the feature store, the directory is always written after the data and
+// only then the header is updated, so that existing memory mappings stay valid
+// and the file stays consistent if the writer is interrupted.
+
+const static size_t kReconstructionStoreAlignment = 64;
+const static size_t kReconstructionStoreChunkSize = 4096;
+
+struct ReconstructionStoreCameraEntry {
+  uint64_t offset = 0;
+  uint64_t num_bytes = 0;
+  uint32_t camera_id = kInvalidCameraId;
+  uint32_t reserved = 0;
+};
+
+struct ReconstructionStoreImageEntry {
+  uint64_t offset = 0;
+  uint64_t num_bytes = 0;
+  // Projection center of the image used for bounding box queries.
+  double proj_center[3] = {0, 0, 0};
+  uint32_t image_id = kInvalidImageId;
+  uint32_t camera_id = kInvalidCameraId;
+};
+
+struct ReconstructionStoreChunkEntry {
+  uint64_t offset = 0;
+  uint64_t num_points3D = 0;
+  // Axis-aligned bounding box of the 3D points in the chunk.
+  double min_bound[3] = {0, 0, 0};
+  double max_bound[3] = {0, 0, 0};
+};
+
+struct ReconstructionStoreSegmentEntry {
+  uint64_t offset = 0;
+  uint64_t num_points3D = 0;
+};
+
+// Read-only, memory-mapped access to a reconstruction store file. The
+// directory is read once on construction, so records written to the file
+// afterwards are not visible. The class is thread-safe.
+class ReconstructionStoreReader {
+ public:
+  explicit ReconstructionStoreReader(const std::string& path);
+
+  size_t NumCameras() const;
+  size_t NumImages() const;
+
+  std::vector<camera_t> CameraIds() const;
+  std::vector<image_t> ImageIds() const;
+
+  // Identifiers of all 3D points. In contrast to cameras and images, this
+  // requires a pass over the point index of the store.
+  std::vector<point3D_t> Point3DIds() const;
+
+  bool ExistsCamera(const camera_t camera_id) const;
+  bool ExistsImage(const image_t image_id) const;
+  bool ExistsPoint3D(const point3D_t point3D_id) const;
+
+  // Read a single object. The object must exist. Images are returned as
+  // registered images with their 2D points and 3D point references.
+  class Camera ReadCamera(const camera_t camera_id) const;
+  class Image ReadImage(const image_t image_id) const;
+  class Point3D ReadPoint3D(const point3D_t point3D_id) const;
+
+  // Read all 3D points in the store.
+  EIGEN_STL_UMAP(point3D_t, class Point3D) ReadPoints3D() const;
+
+  // Bounding box queries. Images are selected by their projection center. Only
+  // the point chunks that overlap with the bounding box are read.
+  std::vector<image_t> ImageIdsInBox(const Eigen::Vector3d& min_bound,
+                                     const Eigen::Vector3d& max_bound) const;
+  EIGEN_STL_UMAP(point3D_t, class Point3D)
+  ReadPoints3DInBox(const Eigen::Vector3d& min_bound,
+                    const Eigen::Vector3d& max_bound) const;
+
+ private:
+  NON_COPYABLE(ReconstructionStoreReader)
+  NON_MOVABLE(ReconstructionStoreReader)
+
+  // Offset of the newest record of the 3D point or zero if the point does not
+  // exist or was deleted.
+  uint64_t FindPoint3DOffset(const point3D_t point3D_id) const;
+
+  const MappedFile file_;
+  const uint8_t* data_;
+  std::unordered_map<camera_t, ReconstructionStoreCameraEntry> cameras_;
+  std::unordered_map<image_t, ReconstructionStoreImageEntry> images_;
+  std::vector<ReconstructionStoreChunkEntry> chunks_;
+  // Point index segments ordered from newest to oldest.
+  std::vector<ReconstructionStoreSegmentEntry> segments_;
+};
+
+// Append cameras, images, and 3D points to a new or existing reconstruction
+// store file. Previously written objects with the same identifier are
+// replaced. 3D points are buffered and written in spatially sorted chunks on
+// `Flush` and `Close`, which also write the directory and header. The same
+// file must not be written concurrently by multiple writers.
+class ReconstructionStoreWriter {
+ public:
+  explicit ReconstructionStoreWriter(const std::string& path);
+  ~ReconstructionStoreWriter();
+
+  void WriteCamera(const class Camera& camera);
+  void WriteImage(const class Image& image);
+  void WritePoint3D(const point3D_t point3D_id, const class Point3D& point3D);
+
+  void DeleteImage(const image_t image_id);
+  void DeletePoint3D(const point3D_t point3D_id);
+
+  void Flush();
+  void Close();
+
+ private:
+  NON_COPYABLE(ReconstructionStoreWriter)
+  NON_MOVABLE(ReconstructionStoreWriter)
+
+  // A written or, if `record_num_bytes` is zero, a deleted 3D point.
+  struct PendingPoint3D {
+    point3D_t point3D_id;
+    Eigen::Vector3d xyz;
+    size_t record_offset;
+    size_t record_num_bytes;
+  };
+
+  void FlushPoints3D();
+  uint64_t AppendData(const char* data, const size_t num_bytes);
+
+  std::fstream file_;
+  uint64_t end_offset_;
+  bool dirty_;
+  std::map<camera_t, ReconstructionStoreCameraEntry> cameras_;
+  std::map<image_t, ReconstructionStoreImageEntry> images_;
+  std::vector<ReconstructionStoreChunkEntry> chunks_;
+  std::vector<ReconstructionStoreSegmentEntry> segments_;
+  // The 3D points written or deleted since the last flush in order of the
+  // calls and their serialized records.
+  std::vector<PendingPoint3D> pending_points3D_;
+  std::vector<char> pending_records_;
+};
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_BASE_RECONSTRUCTION_STORE_H_
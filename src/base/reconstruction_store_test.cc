@@ -0,0 +1,328 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "base/reconstruction_store"
+#include "util/testing.h"
+
+#include <boost/filesystem.hpp>
+
+#include "base/reconstruction.h"
+#include "base/reconstruction_store.h"
+
+using namespace colmap;
+
+namespace {
+
+Camera CreateCamera(const camera_t camera_id) {
+  Camera camera;
+  camera.SetCameraId(camera_id);
+  camera.InitializeWithName("SIMPLE_RADIAL", 100 + camera_id, 640, 480);
+  return camera;
+}
+
+// Create an image at the given projection center, whose first 2D points
+// observe the given 3D points.
+Image CreateImage(const image_t image_id, const camera_t camera_id,
+                  const Eigen::Vector3d& proj_center,
+                  const std::vector<point3D_t>& point3D_ids) {
+  Image image;
+  image.SetImageId(image_id);
+  image.SetCameraId(camera_id);
+  image.SetName("image" + std::to_string(image_id));
+  image.SetTvec(-proj_center);
+  std::vector<Eigen::Vector2d> points2D;
+  for (size_t i = 0; i < point3D_ids.size() + 2; ++i) {
+    points2D.emplace_back(i, 2 * i + image_id);
+  }
+  image.SetPoints2D(points2D);
+  for (point2D_t i = 0; i < point3D_ids.size(); ++i) {
+    image.SetPoint3DForPoint2D(i, point3D_ids[i]);
+  }
+  image.SetRegistered(true);
+  return image;
+}
+
+Point3D CreatePoint3D(const Eigen::Vector3d& xyz, const size_t track_length) {
+  Point3D point3D;
+  point3D.SetXYZ(xyz);
+  point3D.SetColor(Eigen::Vector3ub(1, 2, 3));
+  point3D.SetError(0.5);
+  for (size_t i = 0; i < track_length; ++i) {
+    point3D.Track().AddElement(i + 1, i);
+  }
+  return point3D;
+}
+
+void CheckCamera(const Camera& camera1, const Camera& camera2) {
+  BOOST_CHECK_EQUAL(camera1.CameraId(), camera2.CameraId());
+  BOOST_CHECK_EQUAL(camera1.ModelId(), camera2.ModelId());
+  BOOST_CHECK_EQUAL(camera1.Width(), camera2.Width());
+  BOOST_CHECK_EQUAL(camera1.Height(), camera2.Height());
+  BOOST_CHECK(camera1.Params() == camera2.Params());
+}
+
+void CheckImage(const Image& image1, const Image& image2) {
+  BOOST_CHECK_EQUAL(image1.ImageId(), image2.ImageId());
+  BOOST_CHECK_EQUAL(image1.CameraId(), image2.CameraId());
+  BOOST_CHECK_EQUAL(image1.Name(), image2.Name());
+  BOOST_CHECK_EQUAL(image1.IsRegistered(), image2.IsRegistered());
+  BOOST_CHECK_EQUAL(image1.Qvec(), image2.Qvec());
+  BOOST_CHECK_EQUAL(image1.Tvec(), image2.Tvec());
+  BOOST_CHECK_EQUAL(image1.NumPoints3D(), image2.NumPoints3D());
+  BOOST_CHECK_EQUAL(image1.NumPoints2D(), image2.NumPoints2D());
+  for (point2D_t i = 0; i < image1.NumPoints2D(); ++i) {
+    BOOST_CHECK_EQUAL(image1.Point2D(i).XY(), image2.Point2D(i).XY());
+    BOOST_CHECK_EQUAL(image1.Point2D(i).Point3DId(),
+                      image2.Point2D(i).Point3DId());
+  }
+}
+
+void CheckPoint3D(const Point3D& point3D1, const Point3D& point3D2) {
+  BOOST_CHECK_EQUAL(point3D1.XYZ(), point3D2.XYZ());
+  BOOST_CHECK_EQUAL(point3D1.Color(), point3D2.Color());
+  BOOST_CHECK_EQUAL(point3D1.Error(), point3D2.Error());
+  BOOST_CHECK_EQUAL(point3D1.Track().Length(), point3D2.Track().Length());
+  for (size_t i = 0; i < point3D1.Track().Length(); ++i) {
+    BOOST_CHECK_EQUAL(point3D1.Track().Element(i).image_id,
+                      point3D2.Track().Element(i).image_id);
+    BOOST_CHECK_EQUAL(point3D1.Track().Element(i).point2D_idx,
+                      point3D2.Track().Element(i).point2D_idx);
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestWriteRead) {
+  const std::string path = CreateTempPath();
+
+  const Camera camera = CreateCamera(1);
+  const Image image1 = CreateImage(1, 1, Eigen::Vector3d(0, 0, 0), {1, 2});
+  const Image image2 = CreateImage(2, 1, Eigen::Vector3d(1, 0, 0), {2});
+  const Point3D point3D1 = CreatePoint3D(Eigen::Vector3d(1, 2, 3), 1);
+  const Point3D point3D2 = CreatePoint3D(Eigen::Vector3d(4, 5, 6), 2);
+
+  {
+    ReconstructionStoreWriter writer(path);
+    writer.WriteCamera(camera);
+    writer.WriteImage(image1);
+    writer.WriteImage(image2);
+    writer.WritePoint3D(1, point3D1);
+    writer.WritePoint3D(2, point3D2);
+  }
+
+  const ReconstructionStoreReader reader(path);
+  BOOST_CHECK_EQUAL(reader.NumCameras(), 1);
+  BOOST_CHECK_EQUAL(reader.NumImages(), 2);
+  BOOST_CHECK(reader.CameraIds() == std::vector<camera_t>({1}));
+  BOOST_CHECK(reader.ImageIds() == std::vector<image_t>({1, 2}));
+  BOOST_CHECK(reader.Point3DIds() == std::vector<point3D_t>({1, 2}));
+  BOOST_CHECK(reader.ExistsCamera(1));
+  BOOST_CHECK(!reader.ExistsCamera(2));
+  BOOST_CHECK(reader.ExistsImage(2));
+  BOOST_CHECK(!reader.ExistsImage(3));
+  BOOST_CHECK(reader.ExistsPoint3D(2));
+  BOOST_CHECK(!reader.ExistsPoint3D(3));
+
+  CheckCamera(reader.ReadCamera(1), camera);
+  CheckImage(reader.ReadImage(1), image1);
+  CheckImage(reader.ReadImage(2), image2);
+  CheckPoint3D(reader.ReadPoint3D(1), point3D1);
+  CheckPoint3D(reader.ReadPoint3D(2), point3D2);
+
+  const auto points3D = reader.ReadPoints3D();
+  BOOST_CHECK_EQUAL(points3D.size(), 2);
+  CheckPoint3D(points3D.at(1), point3D1);
+  CheckPoint3D(points3D.at(2), point3D2);
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestAppend) {
+  const std::string path = CreateTempPath();
+
+  {
+    ReconstructionStoreWriter writer(path);
+    writer.WriteCamera(CreateCamera(1));
+    writer.WriteImage(CreateImage(1, 1, Eigen::Vector3d(0, 0, 0), {1}));
+    writer.WriteImage(CreateImage(2, 1, Eigen::Vector3d(1, 0, 0), {2}));
+    for (point3D_t point3D_id = 1; point3D_id <= 3; ++point3D_id) {
+      writer.WritePoint3D(point3D_id,
+                          CreatePoint3D(Eigen::Vector3d(point3D_id, 0, 0), 1));
+    }
+  }
+
+  // Keep a mapping of the first version, which must stay valid.
+  const ReconstructionStoreReader reader1(path);
+
+  const Image image3 = CreateImage(3, 2, Eigen::Vector3d(2, 0, 0), {1, 4});
+  const Point3D point3D1 = CreatePoint3D(Eigen::Vector3d(7, 8, 9), 3);
+  const Point3D point3D4 = CreatePoint3D(Eigen::Vector3d(4, 0, 0), 2);
+
+  {
+    ReconstructionStoreWriter writer(path);
+    writer.WriteCamera(CreateCamera(2));
+    writer.WriteImage(image3);
+    writer.DeleteImage(2);
+    writer.WritePoint3D(1, point3D1);
+    writer.WritePoint3D(4, point3D4);
+    writer.DeletePoint3D(2);
+    writer.WritePoint3D(3, CreatePoint3D(Eigen::Vector3d(3, 0, 0), 1));
+    writer.DeletePoint3D(3);
+  }
+
+  const ReconstructionStoreReader reader2(path);
+
+  BOOST_CHECK(reader1.ImageIds() == std::vector<image_t>({1, 2}));
+  BOOST_CHECK(reader1.Point3DIds() == std::vector<point3D_t>({1, 2, 3}));
+  CheckPoint3D(reader1.ReadPoint3D(1),
+               CreatePoint3D(Eigen::Vector3d(1, 0, 0), 1));
+
+  BOOST_CHECK(reader2.CameraIds() == std::vector<camera_t>({1, 2}));
+  BOOST_CHECK(reader2.ImageIds() == std::vector<image_t>({1, 3}));
+  BOOST_CHECK(reader2.Point3DIds() == std::vector<point3D_t>({1, 4}));
+  BOOST_CHECK(!reader2.ExistsPoint3D(2));
+  BOOST_CHECK(!reader2.ExistsPoint3D(3));
+  CheckImage(reader2.ReadImage(3), image3);
+  CheckPoint3D(reader2.ReadPoint3D(1), point3D1);
+  CheckPoint3D(reader2.ReadPoint3D(4), point3D4);
+
+  const auto points3D = reader2.ReadPoints3D();
+  BOOST_CHECK_EQUAL(points3D.size(), 2);
+  CheckPoint3D(points3D.at(1), point3D1);
+  CheckPoint3D(points3D.at(4), point3D4);
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestBoundingBox) {
+  const std::string path = CreateTempPath();
+
+  const size_t kNumPoints3D = 5 * kReconstructionStoreChunkSize;
+
+  {
+    ReconstructionStoreWriter writer(path);
+    writer.WriteCamera(CreateCamera(1));
+    for (image_t image_id = 1; image_id <= 10; ++image_id) {
+      writer.WriteImage(
+          CreateImage(image_id, 1, Eigen::Vector3d(image_id, 0, 0), {}));
+    }
+    // Write the points in shuffled order, so that the chunks only overlap the
+    // bounding box if the points are sorted spatially.
+    for (size_t i = 0; i < kNumPoints3D; ++i) {
+      const size_t idx = (i * 7919) % kNumPoints3D;
+      writer.WritePoint3D(idx + 1,
+                          CreatePoint3D(Eigen::Vector3d(idx, idx % 10, 0), 1));
+    }
+  }
+
+  const ReconstructionStoreReader reader(path);
+
+  BOOST_CHECK(reader.ImageIdsInBox(Eigen::Vector3d(2.5, -1, -1),
+                                   Eigen::Vector3d(5, 1, 1)) ==
+              std::vector<image_t>({3, 4, 5}));
+  BOOST_CHECK(reader.ImageIdsInBox(Eigen::Vector3d(20, -1, -1),
+                                   Eigen::Vector3d(30, 1, 1))
+                  .empty());
+
+  const auto points3D = reader.ReadPoints3DInBox(Eigen::Vector3d(100, 0, 0),
+                                                 Eigen::Vector3d(199, 4, 0));
+  BOOST_CHECK_EQUAL(points3D.size(), 50);
+  for (const auto& point3D : points3D) {
+    BOOST_CHECK_EQUAL(point3D.first, point3D.second.X() + 1);
+    BOOST_CHECK_GE(point3D.second.X(), 100);
+    BOOST_CHECK_LE(point3D.second.X(), 199);
+    BOOST_CHECK_LE(point3D.second.Y(), 4);
+  }
+
+  BOOST_CHECK_EQUAL(reader.ReadPoints3D().size(), kNumPoints3D);
+  BOOST_CHECK_EQUAL(reader.Point3DIds().size(), kNumPoints3D);
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestReconstruction) {
+  const std::string path = CreateTempPath();
+  boost::filesystem::create_directory(path);
+
+  Reconstruction reconstruction;
+  reconstruction.AddCamera(CreateCamera(1));
+  reconstruction.AddCamera(CreateCamera(2));
+  for (image_t image_id = 1; image_id <= 3; ++image_id) {
+    Image image = CreateImage(image_id, image_id == 3 ? 2 : 1,
+                              Eigen::Vector3d(image_id, 0, 0), {});
+    image.SetRegistered(false);
+    reconstruction.AddImage(image);
+    reconstruction.RegisterImage(image_id);
+  }
+
+  Track track1;
+  track1.AddElement(1, 0);
+  track1.AddElement(2, 0);
+  const point3D_t point3D_id1 =
+      reconstruction.AddPoint3D(Eigen::Vector3d(1, 2, 3), track1);
+  Track track2;
+  track2.AddElement(2, 1);
+  track2.AddElement(3, 0);
+  const point3D_t point3D_id2 =
+      reconstruction.AddPoint3D(Eigen::Vector3d(4, 5, 6), track2);
+
+  reconstruction.WriteStore(path);
+
+  Reconstruction read_reconstruction;
+  read_reconstruction.Read(path);
+  BOOST_CHECK_EQUAL(read_reconstruction.NumCameras(), 2);
+  BOOST_CHECK_EQUAL(read_reconstruction.NumRegImages(), 3);
+  BOOST_CHECK_EQUAL(read_reconstruction.NumPoints3D(), 2);
+  for (const auto& image : reconstruction.Images()) {
+    CheckImage(read_reconstruction.Image(image.first), image.second);
+  }
+  CheckPoint3D(read_reconstruction.Point3D(point3D_id1),
+               reconstruction.Point3D(point3D_id1));
+  CheckPoint3D(read_reconstruction.Point3D(point3D_id2),
+               reconstruction.Point3D(point3D_id2));
+
+  Reconstruction partial_reconstruction;
+  partial_reconstruction.ReadStore(path, {1});
+  BOOST_CHECK_EQUAL(partial_reconstruction.NumCameras(), 1);
+  BOOST_CHECK_EQUAL(partial_reconstruction.NumRegImages(), 1);
+  BOOST_CHECK_EQUAL(partial_reconstruction.NumPoints3D(), 1);
+  BOOST_CHECK_EQUAL(
+      partial_reconstruction.Point3D(point3D_id1).Track().Length(), 1);
+
+  partial_reconstruction.ReadStore(path, {3});
+  BOOST_CHECK_EQUAL(partial_reconstruction.NumCameras(), 2);
+  BOOST_CHECK_EQUAL(partial_reconstruction.NumRegImages(), 2);
+  BOOST_CHECK_EQUAL(partial_reconstruction.NumPoints3D(), 2);
+  BOOST_CHECK_EQUAL(
+      partial_reconstruction.Point3D(point3D_id2).Track().Length(), 1);
+
+  boost::filesystem::remove_all(path);
+}
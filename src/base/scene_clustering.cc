@@ -31,6 +31,8 @@
 
 #include "base/scene_clustering.h"
 
+#include <map>
+#include <numeric>
 #include <set>
 
 #include "base/database.h"
@@ -38,10 +40,44 @@
 #include "util/random.h"
 
 namespace colmap {
+namespace {
+
+typedef std::pair<std::pair<int, int>, int> WeightedEdge;
+
+// Select the images outside of the cluster with the given label, which have
+// the strongest connections to the cluster.
+std::set<int> GetOverlappingImageIds(
+    std::vector<WeightedEdge>* overlapping_edges,
+    const std::unordered_map<int, int>& labels, const int label,
+    const int image_overlap) {
+  // Sort the overlapping edges by the number of inlier matches, such
+  // that we add overlapping images with many common observations.
+  std::sort(overlapping_edges->begin(), overlapping_edges->end(),
+            [](const WeightedEdge& edge1, const WeightedEdge& edge2) {
+              return edge1.second > edge2.second;
+            });
+
+  std::set<int> overlapping_image_ids;
+  for (const auto& edge : *overlapping_edges) {
+    if (overlapping_image_ids.size() >= static_cast<size_t>(image_overlap)) {
+      break;
+    }
+    if (labels.at(edge.first.first) == label) {
+      overlapping_image_ids.insert(edge.first.second);
+    } else {
+      overlapping_image_ids.insert(edge.first.first);
+    }
+  }
+
+  return overlapping_image_ids;
+}
+
+}  // namespace
 
 bool SceneClustering::Options::Check() const {
   CHECK_OPTION_GT(branching, 0);
   CHECK_OPTION_GE(image_overlap, 0);
+  CHECK_OPTION_GE(max_imbalance, 0);
   return true;
 }
 
@@ -67,7 +103,11 @@ void SceneClustering::Partition(
   root_cluster_.reset(new Cluster());
   root_cluster_->image_ids.insert(root_cluster_->image_ids.end(),
                                   image_ids.begin(), image_ids.end());
-  PartitionCluster(edges, num_inliers, root_cluster_.get());
+  if (options_.partition_type == Options::PartitionType::MULTILEVEL) {
+    PartitionMultilevel(edges, num_inliers);
+  } else {
+    PartitionCluster(edges, num_inliers, root_cluster_.get());
+  }
 }
 
 void SceneClustering::PartitionCluster(
@@ -98,8 +138,7 @@ void SceneClustering::PartitionCluster(
   // Collect the edges based on whether they are inter or intra child clusters.
   std::vector<std::vector<std::pair<int, int>>> child_edges(options_.branching);
   std::vector<std::vector<int>> child_weights(options_.branching);
-  std::vector<std::vector<std::pair<std::pair<int, int>, int>>>
-      overlapping_edges(options_.branching);
+  std::vector<std::vector<WeightedEdge>> overlapping_edges(options_.branching);
   for (size_t i = 0; i < edges.size(); ++i) {
     const int label1 = labels.at(edges[i].first);
     const int label2 = labels.at(edges[i].second);
@@ -120,27 +159,8 @@ void SceneClustering::PartitionCluster(
 
   if (options_.image_overlap > 0) {
     for (int i = 0; i < options_.branching; ++i) {
-      // Sort the overlapping edges by the number of inlier matches, such
-      // that we add overlapping images with many common observations.
-      std::sort(overlapping_edges[i].begin(), overlapping_edges[i].end(),
-                [](const std::pair<std::pair<int, int>, int>& edge1,
-                   const std::pair<std::pair<int, int>, int>& edge2) {
-                  return edge1.second > edge2.second;
-                });
-
-      // Select overlapping edges at random and add image to cluster.
-      std::set<int> overlapping_image_ids;
-      for (const auto& edge : overlapping_edges[i]) {
-        if (labels.at(edge.first.first) == i) {
-          overlapping_image_ids.insert(edge.first.second);
-        } else {
-          overlapping_image_ids.insert(edge.first.first);
-        }
-        if (overlapping_image_ids.size() >=
-            static_cast<size_t>(options_.image_overlap)) {
-          break;
-        }
-      }
+      const std::set<int> overlapping_image_ids = GetOverlappingImageIds(
+          &overlapping_edges[i], labels, i, options_.image_overlap);
 
       // Recursively append the overlapping images to cluster and its children.
       std::function<void(Cluster*)> InsertOverlappingImageIds =
@@ -158,6 +178,180 @@ void SceneClustering::PartitionCluster(
   }
 }
 
+void SceneClustering::PartitionMultilevel(
+    const std::vector<std::pair<int, int>>& edges,
+    const std::vector<int>& weights) {
+  CHECK_EQ(edges.size(), weights.size());
+
+  const size_t num_images = root_cluster_->image_ids.size();
+  if (edges.size() == 0 ||
+      num_images <= static_cast<size_t>(options_.leaf_max_num_images)) {
+    return;
+  }
+
+  // Choose the number of leaf clusters, such that even the largest leaf
+  // cluster of a balanced partition does not exceed the maximum size.
+  const int num_parts = static_cast<int>(
+      std::ceil((1 + options_.max_imbalance) * num_images /
+                options_.leaf_max_num_images));
+  const auto labels = ComputeMultilevelGraphPartition(
+      edges, weights, num_parts, options_.max_imbalance, options_.num_threads);
+
+  std::vector<Cluster> clusters(num_parts);
+  for (const auto image_id : root_cluster_->image_ids) {
+    clusters.at(labels.at(image_id)).image_ids.push_back(image_id);
+  }
+
+  // Collect the edges between leaf clusters, which determine the overlapping
+  // images and the grouping of the leaf clusters in the cluster tree.
+  std::vector<std::vector<WeightedEdge>> overlapping_edges(num_parts);
+  std::map<std::pair<int, int>, int> cluster_edge_weights;
+  for (size_t i = 0; i < edges.size(); ++i) {
+    const int label1 = labels.at(edges[i].first);
+    const int label2 = labels.at(edges[i].second);
+    if (label1 != label2) {
+      overlapping_edges[label1].emplace_back(edges[i], weights[i]);
+      overlapping_edges[label2].emplace_back(edges[i], weights[i]);
+      cluster_edge_weights[std::make_pair(std::min(label1, label2),
+                                          std::max(label1, label2))] +=
+          weights[i];
+    }
+  }
+
+  if (options_.image_overlap > 0) {
+    for (int i = 0; i < num_parts; ++i) {
+      const std::set<int> overlapping_image_ids = GetOverlappingImageIds(
+          &overlapping_edges[i], labels, i, options_.image_overlap);
+      clusters[i].image_ids.insert(clusters[i].image_ids.end(),
+                                   overlapping_image_ids.begin(),
+                                   overlapping_image_ids.end());
+    }
+  }
+
+  // Remove empty leaf clusters, which may occur for disconnected scene graphs.
+  // The cluster indices map the leaf cluster labels to the current clusters.
+  std::vector<int> cluster_idxs(num_parts, -1);
+  {
+    std::vector<Cluster> non_empty_clusters;
+    for (int i = 0; i < num_parts; ++i) {
+      if (!clusters[i].image_ids.empty()) {
+        cluster_idxs[i] = static_cast<int>(non_empty_clusters.size());
+        non_empty_clusters.push_back(std::move(clusters[i]));
+      }
+    }
+    clusters = std::move(non_empty_clusters);
+  }
+
+  // Hierarchically group the clusters into at most `branching` child clusters
+  // in the order of their connection strength, until the remaining clusters
+  // can become the children of the root cluster.
+  const size_t branching =
+      static_cast<size_t>(std::max(2, options_.branching));
+
+  while (clusters.size() > branching) {
+    std::map<std::pair<int, int>, int> current_cluster_edge_weights;
+    for (const auto& cluster_edge : cluster_edge_weights) {
+      const int cluster_idx1 = cluster_idxs[cluster_edge.first.first];
+      const int cluster_idx2 = cluster_idxs[cluster_edge.first.second];
+      if (cluster_idx1 != -1 && cluster_idx2 != -1 &&
+          cluster_idx1 != cluster_idx2) {
+        current_cluster_edge_weights[std::make_pair(
+            std::min(cluster_idx1, cluster_idx2),
+            std::max(cluster_idx1, cluster_idx2))] += cluster_edge.second;
+      }
+    }
+
+    std::vector<WeightedEdge> sorted_cluster_edges(
+        current_cluster_edge_weights.begin(),
+        current_cluster_edge_weights.end());
+    std::stable_sort(sorted_cluster_edges.begin(), sorted_cluster_edges.end(),
+                     [](const WeightedEdge& edge1, const WeightedEdge& edge2) {
+                       return edge1.second > edge2.second;
+                     });
+
+    std::vector<int> group_idxs(clusters.size());
+    std::iota(group_idxs.begin(), group_idxs.end(), 0);
+    std::vector<size_t> group_sizes(clusters.size(), 1);
+    std::function<int(int)> FindGroup = [&](const int cluster_idx) {
+      if (group_idxs[cluster_idx] != cluster_idx) {
+        group_idxs[cluster_idx] = FindGroup(group_idxs[cluster_idx]);
+      }
+      return group_idxs[cluster_idx];
+    };
+
+    auto MergeGroups = [&](const int cluster_idx1, const int cluster_idx2) {
+      const int group_idx1 = FindGroup(cluster_idx1);
+      const int group_idx2 = FindGroup(cluster_idx2);
+      if (group_idx1 == group_idx2 ||
+          group_sizes[group_idx1] + group_sizes[group_idx2] > branching) {
+        return false;
+      }
+      group_idxs[group_idx2] = group_idx1;
+      group_sizes[group_idx1] += group_sizes[group_idx2];
+      return true;
+    };
+
+    bool merged_groups = false;
+    for (const auto& cluster_edge : sorted_cluster_edges) {
+      if (MergeGroups(cluster_edge.first.first, cluster_edge.first.second)) {
+        merged_groups = true;
+      }
+    }
+
+    // Group unconnected clusters in order of their index, if none of the
+    // clusters are connected.
+    if (!merged_groups) {
+      for (size_t i = 1; i < clusters.size(); ++i) {
+        if (i % branching != 0) {
+          MergeGroups(static_cast<int>(i - 1), static_cast<int>(i));
+        }
+      }
+    }
+
+    // Create a parent cluster for each group with multiple clusters.
+    std::vector<Cluster> parent_clusters;
+    std::unordered_map<int, int> group_idx_to_parent_idx;
+    std::vector<int> parent_idxs(clusters.size());
+    for (size_t i = 0; i < clusters.size(); ++i) {
+      const int group_idx = FindGroup(static_cast<int>(i));
+      const auto parent_idx = group_idx_to_parent_idx.emplace(
+          group_idx, static_cast<int>(parent_clusters.size()));
+      if (parent_idx.second) {
+        parent_clusters.emplace_back();
+      }
+      parent_idxs[i] = parent_idx.first->second;
+      parent_clusters[parent_idx.first->second].child_clusters.push_back(
+          std::move(clusters[i]));
+    }
+
+    for (auto& parent_cluster : parent_clusters) {
+      if (parent_cluster.child_clusters.size() == 1) {
+        Cluster child_cluster = std::move(parent_cluster.child_clusters[0]);
+        parent_cluster = std::move(child_cluster);
+        continue;
+      }
+      std::set<image_t> image_ids;
+      for (const auto& child_cluster : parent_cluster.child_clusters) {
+        image_ids.insert(child_cluster.image_ids.begin(),
+                         child_cluster.image_ids.end());
+      }
+      parent_cluster.image_ids.assign(image_ids.begin(), image_ids.end());
+    }
+
+    for (auto& cluster_idx : cluster_idxs) {
+      if (cluster_idx != -1) {
+        cluster_idx = parent_idxs[cluster_idx];
+      }
+    }
+
+    clusters = std::move(parent_clusters);
+  }
+
+  if (clusters.size() > 1) {
+    root_cluster_->child_clusters = std::move(clusters);
+  }
+}
+
 const SceneClustering::Cluster* SceneClustering::GetRootCluster() const {
   return root_cluster_.get();
 }
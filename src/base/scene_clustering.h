@@ -45,6 +45,19 @@ namespace colmap {
 class SceneClustering {
  public:
   struct Options {
+    enum class PartitionType {
+      // Recursively partition every cluster into `branching` child clusters
+      // using normalized cuts.
+      NORMALIZED_CUT,
+      // Partition the scene graph into balanced leaf clusters in a single
+      // multilevel k-way partitioning and hierarchically group the leaf
+      // clusters with the strongest connections into the cluster tree.
+      MULTILEVEL,
+    };
+
+    // The method used to partition the scene graph.
+    PartitionType partition_type = PartitionType::NORMALIZED_CUT;
+
     // The branching factor of the hierarchical clustering.
     int branching = 2;
 
@@ -57,6 +70,13 @@ class SceneClustering {
     // overlap` images to satisfy the overlap constraint.
     int leaf_max_num_images = 500;
 
+    // The maximum relative deviation of the leaf cluster sizes from their
+    // average size in multilevel partitioning.
+    double max_imbalance = 0.05;
+
+    // The number of threads used for multilevel partitioning.
+    int num_threads = -1;
+
     bool Check() const;
   };
 
@@ -76,6 +96,8 @@ class SceneClustering {
  private:
   void PartitionCluster(const std::vector<std::pair<int, int>>& edges,
                         const std::vector<int>& weights, Cluster* cluster);
+  void PartitionMultilevel(const std::vector<std::pair<int, int>>& edges,
+                           const std::vector<int>& weights);
 
   const Options options_;
   std::unique_ptr<Cluster> root_cluster_;
@@ -0,0 +1,139 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include <iostream>
+
+#include "base/scene_clustering.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/random.h"
+#include "util/timer.h"
+
+using namespace colmap;
+
+namespace {
+
+// Synthetic view graph of images on a square grid, in which every image
+// overlaps with a random subset of the images in its neighborhood and the
+// number of inliers decreases with the distance between the images.
+void CreateViewGraph(const int num_images,
+                     std::vector<std::pair<image_t, image_t>>* image_pairs,
+                     std::vector<int>* num_inliers) {
+  const int kNeighborhoodRadius = 4;
+  const double kOverlapProbability = 0.3;
+
+  const int grid_size = static_cast<int>(std::sqrt(num_images));
+  SetPRNGSeed(0);
+  for (int y = 0; y < grid_size; ++y) {
+    for (int x = 0; x < grid_size; ++x) {
+      const image_t image_id1 = y * grid_size + x;
+      for (int dy = 0; dy <= kNeighborhoodRadius && y + dy < grid_size;
+           ++dy) {
+        for (int dx = -kNeighborhoodRadius;
+             dx <= kNeighborhoodRadius && x + dx < grid_size; ++dx) {
+          if ((dy == 0 && dx <= 0) || x + dx < 0 ||
+              RandomReal(0.0, 1.0) > kOverlapProbability) {
+            continue;
+          }
+          const image_t image_id2 = (y + dy) * grid_size + x + dx;
+          image_pairs->emplace_back(image_id1, image_id2);
+          num_inliers->push_back(static_cast<int>(
+              RandomReal(50.0, 1000.0) / (1 + std::abs(dx) + dy)));
+        }
+      }
+    }
+  }
+}
+
+void BenchmarkSceneClustering(
+    const std::string& name,
+    const SceneClustering::Options::PartitionType partition_type,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<int>& num_inliers) {
+  SceneClustering::Options options;
+  options.partition_type = partition_type;
+  options.image_overlap = 0;
+  options.leaf_max_num_images = 500;
+
+  Timer timer;
+  timer.Start();
+  SceneClustering scene_clustering(options);
+  scene_clustering.Partition(image_pairs, num_inliers);
+  const double elapsed_time = timer.ElapsedSeconds();
+
+  const auto leaf_clusters = scene_clustering.GetLeafClusters();
+  size_t min_num_images = std::numeric_limits<size_t>::max();
+  size_t max_num_images = 0;
+  for (const auto leaf_cluster : leaf_clusters) {
+    min_num_images = std::min(min_num_images, leaf_cluster->image_ids.size());
+    max_num_images = std::max(max_num_images, leaf_cluster->image_ids.size());
+  }
+
+  std::cout << StringPrintf(
+                   "%15s %10d %10d %9.3fs %8d %8d %8d",
+                   name.c_str(),
+                   static_cast<int>(
+                       scene_clustering.GetRootCluster()->image_ids.size()),
+                   static_cast<int>(image_pairs.size()), elapsed_time,
+                   static_cast<int>(leaf_clusters.size()),
+                   static_cast<int>(min_num_images),
+                   static_cast<int>(max_num_images))
+            << std::endl;
+}
+
+}  // namespace
+
+// Benchmark of the partitioning time and the balance of the leaf clusters for
+// recursive normalized cuts and multilevel partitioning on synthetic view
+// graphs of increasing size.
+int main(int argc, char** argv) {
+  InitializeGlog(argv);
+
+  std::cout << StringPrintf("%15s %10s %10s %10s %8s %8s %8s", "method",
+                            "images", "pairs", "time", "leaves", "min",
+                            "max")
+            << std::endl;
+
+  for (const int num_images : {10000, 100000, 400000}) {
+    std::vector<std::pair<image_t, image_t>> image_pairs;
+    std::vector<int> num_inliers;
+    CreateViewGraph(num_images, &image_pairs, &num_inliers);
+    BenchmarkSceneClustering(
+        "normalized_cut",
+        SceneClustering::Options::PartitionType::NORMALIZED_CUT, image_pairs,
+        num_inliers);
+    BenchmarkSceneClustering(
+        "multilevel", SceneClustering::Options::PartitionType::MULTILEVEL,
+        image_pairs, num_inliers);
+  }
+
+  return EXIT_SUCCESS;
+}
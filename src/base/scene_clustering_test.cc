@@ -214,3 +214,103 @@ BOOST_AUTO_TEST_CASE(TestTwoOverlap) {
   BOOST_CHECK(image_ids1.count(2));
   BOOST_CHECK(image_ids1.count(3));
 }
+
+namespace {
+
+// Chain of densely connected groups of images with weak connections between
+// consecutive groups.
+void CreateChainSceneGraph(
+    const int num_groups, const int group_size,
+    std::vector<std::pair<image_t, image_t>>* image_pairs,
+    std::vector<int>* num_inliers) {
+  for (int group = 0; group < num_groups; ++group) {
+    for (int i = 0; i < group_size; ++i) {
+      for (int j = i + 1; j < group_size; ++j) {
+        image_pairs->emplace_back(group * group_size + i,
+                                  group * group_size + j);
+        num_inliers->push_back(100);
+      }
+    }
+    if (group > 0) {
+      image_pairs->emplace_back(group * group_size - 1, group * group_size);
+      num_inliers->push_back(10);
+      image_pairs->emplace_back(group * group_size - 2, group * group_size);
+      num_inliers->push_back(5);
+    }
+  }
+}
+
+void CheckClusterTree(const SceneClustering::Cluster& cluster,
+                      const int branching) {
+  BOOST_CHECK_NE(cluster.child_clusters.size(), 1);
+  BOOST_CHECK_LE(cluster.child_clusters.size(), branching);
+  const std::set<image_t> image_ids(cluster.image_ids.begin(),
+                                    cluster.image_ids.end());
+  for (const auto& child_cluster : cluster.child_clusters) {
+    for (const auto image_id : child_cluster.image_ids) {
+      BOOST_CHECK(image_ids.count(image_id));
+    }
+    CheckClusterTree(child_cluster, branching);
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestMultilevel) {
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<int> num_inliers;
+  CreateChainSceneGraph(8, 10, &image_pairs, &num_inliers);
+  SceneClustering::Options options;
+  options.partition_type = SceneClustering::Options::PartitionType::MULTILEVEL;
+  options.branching = 2;
+  options.image_overlap = 0;
+  options.leaf_max_num_images = 11;
+  SceneClustering scene_clustering(options);
+  scene_clustering.Partition(image_pairs, num_inliers);
+  BOOST_CHECK_EQUAL(scene_clustering.GetRootCluster()->image_ids.size(), 80);
+  BOOST_CHECK_EQUAL(scene_clustering.GetRootCluster()->child_clusters.size(),
+                    2);
+  CheckClusterTree(*scene_clustering.GetRootCluster(), options.branching);
+
+  const auto leaf_clusters = scene_clustering.GetLeafClusters();
+  BOOST_CHECK_EQUAL(leaf_clusters.size(), 8);
+  std::set<image_t> image_ids;
+  for (const auto leaf_cluster : leaf_clusters) {
+    BOOST_CHECK_EQUAL(leaf_cluster->image_ids.size(), 10);
+    const image_t group = leaf_cluster->image_ids[0] / 10;
+    for (const auto image_id : leaf_cluster->image_ids) {
+      BOOST_CHECK_EQUAL(image_id / 10, group);
+      image_ids.insert(image_id);
+    }
+  }
+  BOOST_CHECK_EQUAL(image_ids.size(), 80);
+}
+
+BOOST_AUTO_TEST_CASE(TestMultilevelOverlap) {
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<int> num_inliers;
+  CreateChainSceneGraph(5, 10, &image_pairs, &num_inliers);
+  SceneClustering::Options options;
+  options.partition_type = SceneClustering::Options::PartitionType::MULTILEVEL;
+  options.branching = 3;
+  options.image_overlap = 1;
+  options.leaf_max_num_images = 11;
+  SceneClustering scene_clustering(options);
+  scene_clustering.Partition(image_pairs, num_inliers);
+  CheckClusterTree(*scene_clustering.GetRootCluster(), options.branching);
+
+  // Every leaf cluster is extended by the images with the strongest
+  // connections to its neighboring groups.
+  const auto leaf_clusters = scene_clustering.GetLeafClusters();
+  BOOST_CHECK_EQUAL(leaf_clusters.size(), 5);
+  for (const auto leaf_cluster : leaf_clusters) {
+    BOOST_CHECK_EQUAL(leaf_cluster->image_ids.size(), 11);
+    const std::set<image_t> image_ids(leaf_cluster->image_ids.begin(),
+                                      leaf_cluster->image_ids.end());
+    if (image_ids.count(0)) {
+      BOOST_CHECK(image_ids.count(10));
+    } else {
+      BOOST_CHECK(image_ids.count(*image_ids.begin() + 9));
+    }
+  }
+}
@@ -146,6 +146,18 @@ void WriteCOLMAPCommands(const bool geometric,
         << std::endl;
 }
 
+std::unique_ptr<WarpMapCache> CreateWarpMapCache(
+    const UndistortCameraOptions& options) {
+  CHECK_GE(options.warp_map_cache_size, 0);
+  if (options.warp_map_cache_size == 0) {
+    return nullptr;
+  }
+  const size_t max_num_bytes = static_cast<size_t>(
+      options.warp_map_cache_size * 1024 * 1024 * 1024);
+  return std::unique_ptr<WarpMapCache>(
+      new WarpMapCache(max_num_bytes, options.warp_map_cache_path));
+}
+
 }  // namespace
 
 COLMAPUndistorter::COLMAPUndistorter(const UndistortCameraOptions& options,
@@ -155,7 +167,8 @@ COLMAPUndistorter::COLMAPUndistorter(const UndistortCameraOptions& options,
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      reconstruction_(reconstruction) {}
+      reconstruction_(reconstruction),
+      warp_map_cache_(CreateWarpMapCache(options)) {}
 
 void COLMAPUndistorter::Run() {
   PrintHeading1("Image undistortion");
@@ -228,7 +241,7 @@ void COLMAPUndistorter::Undistort(const size_t reg_image_idx) const {
   Bitmap undistorted_bitmap;
   Camera undistorted_camera;
   UndistortImage(options_, distorted_bitmap, camera, &undistorted_bitmap,
-                 &undistorted_camera);
+                 &undistorted_camera, warp_map_cache_.get());
 
   undistorted_bitmap.Write(output_image_path);
 }
@@ -273,7 +286,8 @@ PMVSUndistorter::PMVSUndistorter(const UndistortCameraOptions& options,
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      reconstruction_(reconstruction) {}
+      reconstruction_(reconstruction),
+      warp_map_cache_(CreateWarpMapCache(options)) {}
 
 void PMVSUndistorter::Run() {
   PrintHeading1("Image undistortion (CMVS/PMVS)");
@@ -354,7 +368,7 @@ void PMVSUndistorter::Undistort(const size_t reg_image_idx) const {
   Bitmap undistorted_bitmap;
   Camera undistorted_camera;
   UndistortImage(options_, distorted_bitmap, camera, &undistorted_bitmap,
-                 &undistorted_camera);
+                 &undistorted_camera, warp_map_cache_.get());
 
   undistorted_bitmap.Write(output_image_path);
   WriteProjectionMatrix(proj_matrix_path, undistorted_camera, image, "CONTOUR");
@@ -505,7 +519,8 @@ CMPMVSUndistorter::CMPMVSUndistorter(const UndistortCameraOptions& options,
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      reconstruction_(reconstruction) {}
+      reconstruction_(reconstruction),
+      warp_map_cache_(CreateWarpMapCache(options)) {}
 
 void CMPMVSUndistorter::Run() {
   PrintHeading1("Image undistortion (CMP-MVS)");
@@ -554,7 +569,7 @@ void CMPMVSUndistorter::Undistort(const size_t reg_image_idx) const {
   Bitmap undistorted_bitmap;
   Camera undistorted_camera;
   UndistortImage(options_, distorted_bitmap, camera, &undistorted_bitmap,
-                 &undistorted_camera);
+                 &undistorted_camera, warp_map_cache_.get());
 
   undistorted_bitmap.Write(output_image_path);
   WriteProjectionMatrix(proj_matrix_path, undistorted_camera, image, "CONTOUR");
@@ -567,7 +582,8 @@ PureImageUndistorter::PureImageUndistorter(
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      image_names_and_cameras_(image_names_and_cameras) {}
+      image_names_and_cameras_(image_names_and_cameras),
+      warp_map_cache_(CreateWarpMapCache(options)) {}
 
 void PureImageUndistorter::Run() {
   PrintHeading1("Image undistortion");
@@ -616,7 +632,7 @@ void PureImageUndistorter::Undistort(const size_t image_idx) const {
   Bitmap undistorted_bitmap;
   Camera undistorted_camera;
   UndistortImage(options_, distorted_bitmap, camera, &undistorted_bitmap,
-                 &undistorted_camera);
+                 &undistorted_camera, warp_map_cache_.get());
     
   undistorted_bitmap.Write(output_image_path);
 }
@@ -905,7 +921,8 @@ Camera UndistortCamera(const UndistortCameraOptions& options,
 void UndistortImage(const UndistortCameraOptions& options,
                     const Bitmap& distorted_bitmap,
                     const Camera& distorted_camera, Bitmap* undistorted_bitmap,
-                    Camera* undistorted_camera) {
+                    Camera* undistorted_camera,
+                    WarpMapCache* warp_map_cache) {
   CHECK_EQ(distorted_camera.Width(), distorted_bitmap.Width());
   CHECK_EQ(distorted_camera.Height(), distorted_bitmap.Height());
 
@@ -915,8 +932,14 @@ void UndistortImage(const UndistortCameraOptions& options,
                                distorted_bitmap.IsRGB());
   distorted_bitmap.CloneMetadata(undistorted_bitmap);
 
-  WarpImageBetweenCameras(distorted_camera, *undistorted_camera,
-                          distorted_bitmap, undistorted_bitmap);
+  if (warp_map_cache == nullptr) {
+    WarpImageBetweenCameras(distorted_camera, *undistorted_camera,
+                            distorted_bitmap, undistorted_bitmap);
+  } else {
+    WarpImageBetweenCameras(distorted_camera, *undistorted_camera,
+                            distorted_bitmap, undistorted_bitmap,
+                            warp_map_cache);
+  }
 }
 
 void UndistortReconstruction(const UndistortCameraOptions& options,
@@ -33,6 +33,7 @@
 #define COLMAP_SRC_BASE_UNDISTORTION_H_
 
 #include "base/reconstruction.h"
+#include "base/warp.h"
 #include "util/alignment.h"
 #include "util/bitmap.h"
 #include "util/threading.h"
@@ -59,6 +60,18 @@ struct UndistortCameraOptions {
   double roi_min_y = 0.0;
   double roi_max_x = 1.0;
   double roi_max_y = 1.0;
+
+  // Maximum memory in gigabytes of the cached warp maps, which are shared by
+  // all images with the same camera and only computed once. Disabled by
+  // default, since the cached maps interpolate in fixed-point arithmetic and
+  // their output may differ by one intensity level from the default warping.
+  // The stereo rectifier does not cache maps, as they are specific to the
+  // relative pose of each image pair.
+  double warp_map_cache_size = 0.0;
+
+  // Optional directory, in which the warp maps are persisted across runs, if
+  // the warp map cache is enabled.
+  std::string warp_map_cache_path = "";
 };
 
 // Undistort images and export undistorted cameras, as required by the
@@ -82,6 +95,7 @@ class COLMAPUndistorter : public Thread {
   std::string image_path_;
   std::string output_path_;
   const Reconstruction& reconstruction_;
+  std::unique_ptr<WarpMapCache> warp_map_cache_;
 };
 
 // Undistort images and prepare data for CMVS/PMVS.
@@ -107,6 +121,7 @@ class PMVSUndistorter : public Thread {
   std::string image_path_;
   std::string output_path_;
   const Reconstruction& reconstruction_;
+  std::unique_ptr<WarpMapCache> warp_map_cache_;
 };
 
 // Undistort images and prepare data for CMP-MVS.
@@ -126,6 +141,7 @@ class CMPMVSUndistorter : public Thread {
   std::string image_path_;
   std::string output_path_;
   const Reconstruction& reconstruction_;
+  std::unique_ptr<WarpMapCache> warp_map_cache_;
 };
   
 // Undistort images and export undistorted cameras without the need for a
@@ -147,6 +163,7 @@ class PureImageUndistorter : public Thread {
   std::string image_path_;
   std::string output_path_;
   const std::vector<std::pair<std::string, Camera>>& image_names_and_cameras_;
+  std::unique_ptr<WarpMapCache> warp_map_cache_;
 };
 
 // Rectify stereo image pairs.
@@ -192,11 +209,13 @@ Camera UndistortCamera(const UndistortCameraOptions& options,
 
 // Undistort image such that the viewing geometry of the undistorted image
 // follows a pinhole camera model. See `UndistortCamera` for more details
-// on the undistortion conventions.
+// on the undistortion conventions. If a warp map cache is given, the pixel
+// mapping is shared with all other images of the same camera.
 void UndistortImage(const UndistortCameraOptions& options,
                     const Bitmap& distorted_image,
                     const Camera& distorted_camera, Bitmap* undistorted_image,
-                    Camera* undistorted_camera);
+                    Camera* undistorted_camera,
+                    WarpMapCache* warp_map_cache = nullptr);
 
 // Undistort all cameras in the reconstruction and accordingly all
 // observations in their corresponding images.
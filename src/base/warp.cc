@@ -31,12 +31,20 @@
 
 #include "base/warp.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
 #include "VLFeat/imopv.h"
+#include "util/endian.h"
 #include "util/logging.h"
+#include "util/misc.h"
 
 namespace colmap {
 namespace {
 
+const char kWarpMapMagic[8] = {'C', 'O', 'L', 'M', 'A', 'P', 'W', '2'};
+
 float GetPixelConstantBorder(const float* data, const int rows, const int cols,
                              const int row, const int col) {
   if (row >= 0 && col >= 0 && row < rows && col < cols) {
@@ -46,8 +54,362 @@ float GetPixelConstantBorder(const float* data, const int rows, const int cols,
   }
 }
 
+// Allocate a warp map in the source resolution for the given cameras.
+void AllocateWarpMap(const Camera& source_camera, const Camera& target_camera,
+                     WarpMap* warp_map) {
+  warp_map->width = static_cast<int>(source_camera.Width());
+  warp_map->height = static_cast<int>(source_camera.Height());
+  warp_map->target_width = static_cast<int>(target_camera.Width());
+  warp_map->target_height = static_cast<int>(target_camera.Height());
+  const size_t num_pixels =
+      static_cast<size_t>(warp_map->width) * warp_map->height;
+  warp_map->source_x.resize(num_pixels);
+  warp_map->source_y.resize(num_pixels);
+  warp_map->weight_x.resize(num_pixels);
+  warp_map->weight_y.resize(num_pixels);
+}
+
+// Set the interpolation location of a warped pixel with the same conventions
+// as `Bitmap::InterpolateBilinear` for the given source point, whose upper
+// left pixel center is (0.5, 0.5).
+void SetWarpMapPixel(const Eigen::Vector2d& source_point, const size_t idx,
+                     WarpMap* warp_map) {
+  const double x = source_point.x() - 0.5;
+  // FreeImage's coordinate system origin is in the lower left of the image.
+  const double inv_y = warp_map->height - 1 - (source_point.y() - 0.5);
+
+  // Note that the comparisons also reject non-finite coordinates.
+  if (!(x >= 0 && x < warp_map->width - 1 && inv_y >= 0 &&
+        inv_y < warp_map->height - 1)) {
+    warp_map->source_x[idx] = -1;
+    warp_map->source_y[idx] = -1;
+    warp_map->weight_x[idx] = 0;
+    warp_map->weight_y[idx] = 0;
+    return;
+  }
+
+  const int x0 = static_cast<int>(std::floor(x));
+  const int inv_y0 = static_cast<int>(std::floor(inv_y));
+  const double dx = x - x0;
+  const double dy = inv_y - inv_y0;
+
+  warp_map->source_x[idx] = x0;
+  warp_map->source_y[idx] = warp_map->height - 2 - inv_y0;
+  warp_map->weight_x[idx] =
+      static_cast<uint16_t>(std::round(dx * WarpMap::kWeightScale));
+  warp_map->weight_y[idx] =
+      static_cast<uint16_t>(std::round((1 - dy) * WarpMap::kWeightScale));
+}
+
+// Bilinearly interpolate one row of the warped image using fixed-point
+// arithmetic directly on the raw scanlines of the source image.
+template <int kChannels>
+void WarpScanline(const WarpMap& warp_map, const int y,
+                  const std::vector<const uint8_t*>& source_lines,
+                  uint8_t* target_line) {
+  const uint32_t kScale = WarpMap::kWeightScale;
+  const uint32_t kShift = 2 * WarpMap::kWeightBits;
+  const uint32_t kRound = 1u << (kShift - 1);
+
+  const size_t offset = static_cast<size_t>(y) * warp_map.width;
+  const int32_t* source_x = warp_map.source_x.data() + offset;
+  const int32_t* source_y = warp_map.source_y.data() + offset;
+  const uint16_t* weight_x = warp_map.weight_x.data() + offset;
+  const uint16_t* weight_y = warp_map.weight_y.data() + offset;
+
+  for (int x = 0; x < warp_map.width; ++x) {
+    uint8_t* target_pixel = target_line + kChannels * x;
+    if (source_x[x] < 0) {
+      for (int c = 0; c < kChannels; ++c) {
+        target_pixel[c] = 0;
+      }
+      continue;
+    }
+
+    const uint32_t wx1 = weight_x[x];
+    const uint32_t wy1 = weight_y[x];
+    const uint32_t wx0 = kScale - wx1;
+    const uint32_t wy0 = kScale - wy1;
+    const uint32_t w00 = wx0 * wy0;
+    const uint32_t w01 = wx1 * wy0;
+    const uint32_t w10 = wx0 * wy1;
+    const uint32_t w11 = wx1 * wy1;
+
+    const uint8_t* p0 = source_lines[source_y[x]] + kChannels * source_x[x];
+    const uint8_t* p1 = source_lines[source_y[x] + 1] + kChannels * source_x[x];
+    for (int c = 0; c < kChannels; ++c) {
+      target_pixel[c] = static_cast<uint8_t>(
+          (w00 * p0[c] + w01 * p0[c + kChannels] + w10 * p1[c] +
+           w11 * p1[c + kChannels] + kRound) >>
+          kShift);
+    }
+  }
+}
+
+std::string CameraKey(const Camera& camera) {
+  std::string key = StringPrintf("%d,%d,%d,", camera.ModelId(),
+                                 static_cast<int>(camera.Width()),
+                                 static_cast<int>(camera.Height()));
+  for (const double param : camera.Params()) {
+    key += StringPrintf("%a,", param);
+  }
+  return key;
+}
+
+// FNV-1a hash, which is stable across platforms and runs, as required for
+// naming the persisted warp maps.
+uint64_t HashKey(const std::string& key) {
+  uint64_t hash = 14695981039346656037ull;
+  for (const char c : key) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
 }  // namespace
 
+const int WarpMap::kWeightBits;
+const int WarpMap::kWeightScale;
+
+size_t WarpMap::NumBytes() const {
+  return (source_x.size() + source_y.size()) * sizeof(int32_t) +
+         (weight_x.size() + weight_y.size()) * sizeof(uint16_t);
+}
+
+bool WarpMap::Read(const std::string& path, const std::string& key) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  char magic[sizeof(kWarpMapMagic)];
+  file.read(magic, sizeof(magic));
+  if (!file.good() ||
+      !std::equal(magic, magic + sizeof(magic), kWarpMapMagic)) {
+    return false;
+  }
+
+  // Compare the full key, since the file names only contain its hash.
+  const uint64_t key_size = ReadBinaryLittleEndian<uint64_t>(&file);
+  if (!file.good() || key_size != key.size()) {
+    return false;
+  }
+  std::string file_key(key.size(), '\0');
+  file.read(&file_key[0], file_key.size());
+  if (!file.good() || file_key != key) {
+    return false;
+  }
+
+  width = ReadBinaryLittleEndian<int32_t>(&file);
+  height = ReadBinaryLittleEndian<int32_t>(&file);
+  target_width = ReadBinaryLittleEndian<int32_t>(&file);
+  target_height = ReadBinaryLittleEndian<int32_t>(&file);
+  if (!file.good() || width < 0 || height < 0) {
+    return false;
+  }
+
+  const size_t num_pixels = static_cast<size_t>(width) * height;
+  source_x.resize(num_pixels);
+  source_y.resize(num_pixels);
+  weight_x.resize(num_pixels);
+  weight_y.resize(num_pixels);
+  ReadBinaryLittleEndian<int32_t>(&file, &source_x);
+  ReadBinaryLittleEndian<int32_t>(&file, &source_y);
+  ReadBinaryLittleEndian<uint16_t>(&file, &weight_x);
+  ReadBinaryLittleEndian<uint16_t>(&file, &weight_y);
+  return file.good();
+}
+
+void WarpMap::Write(const std::string& path, const std::string& key) const {
+  std::ofstream file(path, std::ios::trunc | std::ios::binary);
+  CHECK(file.is_open()) << path;
+
+  file.write(kWarpMapMagic, sizeof(kWarpMapMagic));
+  WriteBinaryLittleEndian<uint64_t>(&file, key.size());
+  file.write(key.data(), key.size());
+  WriteBinaryLittleEndian<int32_t>(&file, width);
+  WriteBinaryLittleEndian<int32_t>(&file, height);
+  WriteBinaryLittleEndian<int32_t>(&file, target_width);
+  WriteBinaryLittleEndian<int32_t>(&file, target_height);
+  WriteBinaryLittleEndian<int32_t>(&file, source_x);
+  WriteBinaryLittleEndian<int32_t>(&file, source_y);
+  WriteBinaryLittleEndian<uint16_t>(&file, weight_x);
+  WriteBinaryLittleEndian<uint16_t>(&file, weight_y);
+}
+
+void ComputeWarpMapBetweenCameras(const Camera& source_camera,
+                                  const Camera& target_camera,
+                                  WarpMap* warp_map) {
+  CHECK_NOTNULL(warp_map);
+
+  // To avoid aliasing, perform the warping in the source resolution and
+  // then rescale the image at the end.
+  Camera scaled_target_camera = target_camera;
+  if (target_camera.Width() != source_camera.Width() ||
+      target_camera.Height() != source_camera.Height()) {
+    scaled_target_camera.Rescale(source_camera.Width(), source_camera.Height());
+  }
+
+  AllocateWarpMap(source_camera, target_camera, warp_map);
+
+  Eigen::Vector2d image_point;
+  for (int y = 0; y < warp_map->height; ++y) {
+    image_point.y() = y + 0.5;
+    for (int x = 0; x < warp_map->width; ++x) {
+      image_point.x() = x + 0.5;
+
+      // Camera models assume that the upper left pixel center is (0.5, 0.5).
+      const Eigen::Vector2d world_point =
+          scaled_target_camera.ImageToWorld(image_point);
+      const Eigen::Vector2d source_point =
+          source_camera.WorldToImage(world_point);
+
+      SetWarpMapPixel(source_point, y * warp_map->width + x, warp_map);
+    }
+  }
+}
+
+void WarpImageWithMap(const WarpMap& warp_map, const Bitmap& source_image,
+                      Bitmap* target_image) {
+  CHECK_EQ(warp_map.width, source_image.Width());
+  CHECK_EQ(warp_map.height, source_image.Height());
+  CHECK_NOTNULL(target_image);
+
+  target_image->Allocate(warp_map.width, warp_map.height,
+                         source_image.IsRGB());
+
+  std::vector<const uint8_t*> source_lines(source_image.Height());
+  for (int y = 0; y < source_image.Height(); ++y) {
+    source_lines[y] = source_image.GetScanline(y);
+  }
+
+  for (int y = 0; y < warp_map.height; ++y) {
+    // FreeImage's coordinate system origin is in the lower left of the image.
+    uint8_t* target_line =
+        FreeImage_GetScanLine(target_image->Data(), warp_map.height - 1 - y);
+    if (source_image.IsRGB()) {
+      WarpScanline<3>(warp_map, y, source_lines, target_line);
+    } else {
+      WarpScanline<1>(warp_map, y, source_lines, target_line);
+    }
+  }
+
+  if (warp_map.target_width != warp_map.width ||
+      warp_map.target_height != warp_map.height) {
+    target_image->Rescale(warp_map.target_width, warp_map.target_height);
+  }
+}
+
+WarpMapCache::WarpMapCache(const size_t max_num_bytes,
+                           const std::string& cache_path)
+    : max_num_bytes_(max_num_bytes),
+      cache_path_(cache_path),
+      num_bytes_(0),
+      num_accesses_(0) {
+  if (!cache_path_.empty()) {
+    CreateDirIfNotExists(cache_path_);
+  }
+}
+
+std::shared_ptr<const WarpMap> WarpMapCache::BetweenCameras(
+    const Camera& source_camera, const Camera& target_camera) {
+  const std::string key =
+      CameraKey(source_camera) + "|" + CameraKey(target_camera);
+  return Get(key, [&](WarpMap* warp_map) {
+    ComputeWarpMapBetweenCameras(source_camera, target_camera, warp_map);
+  });
+}
+
+size_t WarpMapCache::NumMaps() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+size_t WarpMapCache::NumBytes() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return num_bytes_;
+}
+
+std::shared_ptr<const WarpMap> WarpMapCache::Get(
+    const std::string& key,
+    const std::function<void(WarpMap*)>& compute_func) {
+  std::promise<std::shared_ptr<const WarpMap>> promise;
+  MapFuture future;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    num_accesses_ += 1;
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      it->second.last_access = num_accesses_;
+      future = it->second.warp_map;
+      lock.unlock();
+      return future.get();
+    }
+
+    // Register the pending map, so that concurrent requests for the same key
+    // wait for this thread instead of computing the map themselves.
+    future = promise.get_future().share();
+    Entry& entry = entries_[key];
+    entry.warp_map = future;
+    entry.last_access = num_accesses_;
+  }
+
+  std::shared_ptr<WarpMap> warp_map = std::make_shared<WarpMap>();
+  std::string path;
+  if (!cache_path_.empty()) {
+    path = JoinPaths(cache_path_,
+                     StringPrintf("%016llx.bin", static_cast<unsigned long long>(
+                                                     HashKey(key))));
+  }
+  // Maps persisted for a different key with the same hash are overwritten.
+  if (path.empty() || !warp_map->Read(path, key)) {
+    compute_func(warp_map.get());
+    if (!path.empty()) {
+      // Write to a uniquely named temporary file first, so that concurrent
+      // threads and processes never read a partially written map.
+      const std::string tmp_path =
+          path + "." + boost::filesystem::unique_path().string() + ".tmp";
+      warp_map->Write(tmp_path, key);
+      if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cout << "WARNING: Failed to write warp map to " << path
+                  << std::endl;
+        boost::filesystem::remove(tmp_path);
+      }
+    }
+  }
+  promise.set_value(warp_map);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  auto it = entries_.find(key);
+  if (it != entries_.end() && it->second.num_bytes == 0) {
+    it->second.num_bytes = warp_map->NumBytes();
+    num_bytes_ += it->second.num_bytes;
+  }
+
+  // Evict the least recently used computed maps, but never the requested map.
+  while (num_bytes_ > max_num_bytes_) {
+    auto lru_it = entries_.end();
+    for (auto entry_it = entries_.begin(); entry_it != entries_.end();
+         ++entry_it) {
+      if (entry_it->first != key && entry_it->second.num_bytes > 0 &&
+          (lru_it == entries_.end() ||
+           entry_it->second.last_access < lru_it->second.last_access)) {
+        lru_it = entry_it;
+      }
+    }
+    if (lru_it == entries_.end()) {
+      break;
+    }
+    num_bytes_ -= lru_it->second.num_bytes;
+    entries_.erase(lru_it);
+  }
+
+  return warp_map;
+}
+
 void WarpImageBetweenCameras(const Camera& source_camera,
                              const Camera& target_camera,
                              const Bitmap& source_image, Bitmap* target_image) {
@@ -95,6 +457,18 @@ void WarpImageBetweenCameras(const Camera& source_camera,
   }
 }
 
+void WarpImageBetweenCameras(const Camera& source_camera,
+                             const Camera& target_camera,
+                             const Bitmap& source_image, Bitmap* target_image,
+                             WarpMapCache* warp_map_cache) {
+  CHECK_EQ(source_camera.Width(), source_image.Width());
+  CHECK_EQ(source_camera.Height(), source_image.Height());
+  CHECK_NOTNULL(warp_map_cache);
+  WarpImageWithMap(
+      *warp_map_cache->BetweenCameras(source_camera, target_camera),
+      source_image, target_image);
+}
+
 void WarpImageWithHomography(const Eigen::Matrix3d& H,
                              const Bitmap& source_image, Bitmap* target_image) {
   CHECK_NOTNULL(target_image);
@@ -32,18 +32,115 @@
 #ifndef COLMAP_SRC_BASE_WARP_H_
 #define COLMAP_SRC_BASE_WARP_H_
 
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "base/camera.h"
 #include "util/alignment.h"
 #include "util/bitmap.h"
 
 namespace colmap {
 
+// Precomputed inverse mapping from the pixels of a target image to bilinearly
+// interpolated locations in a source image. Computing the mapping requires
+// projecting every pixel through the (possibly iterative) camera models, which
+// dominates the cost of warping, so that the map can be reused for all images
+// that share the same source and target cameras.
+struct WarpMap {
+  // Number of fractional bits of the fixed-point interpolation weights.
+  static const int kWeightBits = 11;
+  static const int kWeightScale = 1 << kWeightBits;
+
+  // Dimensions of the warped image, which equal the source image dimensions.
+  int width = 0;
+  int height = 0;
+
+  // Dimensions to which the warped image is rescaled after warping.
+  int target_width = 0;
+  int target_height = 0;
+
+  // Column and row of the top-left source pixel for each warped pixel in
+  // row-major order. The column is negative if the pixel falls outside of the
+  // source image.
+  std::vector<int32_t> source_x;
+  std::vector<int32_t> source_y;
+
+  // Interpolation weights of the right and the bottom source pixel in the
+  // range [0, kWeightScale].
+  std::vector<uint16_t> weight_x;
+  std::vector<uint16_t> weight_y;
+
+  size_t NumBytes() const;
+
+  // Read and write the map in binary format. The key identifies the cameras
+  // of the map and is stored in the file header. Reading returns false if the
+  // file is not a valid map or was written for a different key.
+  bool Read(const std::string& path, const std::string& key);
+  void Write(const std::string& path, const std::string& key) const;
+};
+
+// Compute the warp map equivalent to `WarpImageBetweenCameras`.
+void ComputeWarpMapBetweenCameras(const Camera& source_camera,
+                                  const Camera& target_camera,
+                                  WarpMap* warp_map);
+
+// Warp the source image using the given precomputed map. The function works on
+// the raw scanlines of the images and allocates the target image.
+void WarpImageWithMap(const WarpMap& warp_map, const Bitmap& source_image,
+                      Bitmap* target_image);
+
+// Thread-safe cache of warp maps keyed by their cameras. Maps are computed
+// once for concurrent requests of the same key and the least recently used
+// maps are evicted once the memory limit is exceeded. If a cache path is
+// given, maps are additionally persisted to and read from disk. Note that the
+// fixed-point interpolation of the maps may differ by one intensity level from
+// the floating point interpolation of the uncached warping functions.
+class WarpMapCache {
+ public:
+  WarpMapCache(const size_t max_num_bytes, const std::string& cache_path = "");
+
+  std::shared_ptr<const WarpMap> BetweenCameras(const Camera& source_camera,
+                                                const Camera& target_camera);
+
+  size_t NumMaps() const;
+  size_t NumBytes() const;
+
+ private:
+  typedef std::shared_future<std::shared_ptr<const WarpMap>> MapFuture;
+
+  struct Entry {
+    MapFuture warp_map;
+    size_t num_bytes = 0;
+    size_t last_access = 0;
+  };
+
+  std::shared_ptr<const WarpMap> Get(
+      const std::string& key,
+      const std::function<void(WarpMap*)>& compute_func);
+
+  const size_t max_num_bytes_;
+  const std::string cache_path_;
+  mutable std::mutex mutex_;
+  size_t num_bytes_;
+  size_t num_accesses_;
+  std::unordered_map<std::string, Entry> entries_;
+};
+
 // Warp source image to target image by projecting the pixels of the target
 // image up to infinity and projecting it down into the source image
 // (i.e. an inverse mapping). The function allocates the target image.
 void WarpImageBetweenCameras(const Camera& source_camera,
                              const Camera& target_camera,
                              const Bitmap& source_image, Bitmap* target_image);
+void WarpImageBetweenCameras(const Camera& source_camera,
+                             const Camera& target_camera,
+                             const Bitmap& source_image, Bitmap* target_image,
+                             WarpMapCache* warp_map_cache);
 
 // Warp an image with the given homography, where H defines the pixel mapping
 // from the target to source image. Note that the pixel centers are assumed to
@@ -32,6 +32,10 @@
 #define TEST_NAME "base/warp"
 #include "util/testing.h"
 
+#include <cstdlib>
+
+#include <boost/filesystem.hpp>
+
 #include "base/warp.h"
 #include "util/random.h"
 
@@ -69,6 +73,26 @@ void CheckBitmapsEqual(const Bitmap& bitmap1, const Bitmap& bitmap2) {
   }
 }
 
+// Check that the two bitmaps differ by at most one intensity level, ignoring a
+// 1px boundary.
+void CheckBitmapsNear(const Bitmap& bitmap1, const Bitmap& bitmap2) {
+  BOOST_REQUIRE_EQUAL(bitmap1.IsGrey(), bitmap2.IsGrey());
+  BOOST_REQUIRE_EQUAL(bitmap1.IsRGB(), bitmap2.IsRGB());
+  BOOST_REQUIRE_EQUAL(bitmap1.Width(), bitmap2.Width());
+  BOOST_REQUIRE_EQUAL(bitmap1.Height(), bitmap2.Height());
+  for (int x = 1; x < bitmap1.Width() - 1; ++x) {
+    for (int y = 1; y < bitmap1.Height() - 1; ++y) {
+      BitmapColor<uint8_t> color1;
+      BitmapColor<uint8_t> color2;
+      BOOST_CHECK(bitmap1.GetPixel(x, y, &color1));
+      BOOST_CHECK(bitmap2.GetPixel(x, y, &color2));
+      BOOST_CHECK_LE(std::abs(color1.r - color2.r), 1);
+      BOOST_CHECK_LE(std::abs(color1.g - color2.g), 1);
+      BOOST_CHECK_LE(std::abs(color1.b - color2.b), 1);
+    }
+  }
+}
+
 // Check that the two bitmaps are equal, ignoring a 1px boundary.
 void CheckBitmapsTransposed(const Bitmap& bitmap1, const Bitmap& bitmap2) {
   BOOST_REQUIRE_EQUAL(bitmap1.IsGrey(), bitmap2.IsGrey());
@@ -219,6 +243,89 @@ BOOST_AUTO_TEST_CASE(TestWarpImageWithHomographyBetweenCamerasTransposed) {
   CheckBitmapsTransposed(source_image_rgb, target_image_rgb);
 }
 
+BOOST_AUTO_TEST_CASE(TestWarpMapCache) {
+  Camera source_camera;
+  source_camera.InitializeWithName("SIMPLE_RADIAL", 100, 100, 80);
+  source_camera.Params(3) = 0.1;
+  Camera target_camera;
+  target_camera.InitializeWithName("PINHOLE", 100, 50, 40);
+
+  Bitmap source_image;
+  GenerateRandomBitmap(100, 80, true, &source_image);
+  Bitmap target_image;
+  WarpImageBetweenCameras(source_camera, target_camera, source_image,
+                          &target_image);
+
+  const std::string cache_path = CreateTempPath();
+
+  {
+    WarpMapCache cache(1024 * 1024 * 1024, cache_path);
+    for (int i = 0; i < 2; ++i) {
+      Bitmap cached_target_image;
+      WarpImageBetweenCameras(source_camera, target_camera, source_image,
+                              &cached_target_image, &cache);
+      BOOST_CHECK_EQUAL(cached_target_image.Width(), 50);
+      BOOST_CHECK_EQUAL(cached_target_image.Height(), 40);
+      CheckBitmapsNear(target_image, cached_target_image);
+    }
+    BOOST_CHECK_EQUAL(cache.NumMaps(), 1);
+    BOOST_CHECK_GT(cache.NumBytes(), 0);
+
+    // Exceeding the memory limit evicts all but the most recent map.
+    WarpMapCache small_cache(1, "");
+    small_cache.BetweenCameras(source_camera, target_camera);
+    small_cache.BetweenCameras(source_camera, source_camera);
+    BOOST_CHECK_EQUAL(small_cache.NumMaps(), 1);
+  }
+
+  // A new cache reads the persisted map.
+  WarpMapCache cache(1024 * 1024 * 1024, cache_path);
+  const auto warp_map = cache.BetweenCameras(source_camera, target_camera);
+  WarpMap expected_warp_map;
+  ComputeWarpMapBetweenCameras(source_camera, target_camera,
+                               &expected_warp_map);
+  BOOST_CHECK_EQUAL(warp_map->width, expected_warp_map.width);
+  BOOST_CHECK_EQUAL(warp_map->height, expected_warp_map.height);
+  BOOST_CHECK_EQUAL(warp_map->target_width, expected_warp_map.target_width);
+  BOOST_CHECK_EQUAL(warp_map->target_height, expected_warp_map.target_height);
+  BOOST_CHECK(warp_map->source_x == expected_warp_map.source_x);
+  BOOST_CHECK(warp_map->source_y == expected_warp_map.source_y);
+  BOOST_CHECK(warp_map->weight_x == expected_warp_map.weight_x);
+  BOOST_CHECK(warp_map->weight_y == expected_warp_map.weight_y);
+
+  boost::filesystem::remove_all(cache_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestWarpMapReadWrite) {
+  Camera source_camera;
+  source_camera.InitializeWithName("SIMPLE_RADIAL", 100, 100, 80);
+  Camera target_camera;
+  target_camera.InitializeWithName("PINHOLE", 100, 50, 40);
+
+  WarpMap warp_map;
+  ComputeWarpMapBetweenCameras(source_camera, target_camera, &warp_map);
+
+  const std::string path = CreateTempPath();
+  warp_map.Write(path, "key1");
+
+  // Maps are only read for the key with which they were written.
+  WarpMap read_warp_map;
+  BOOST_CHECK(!read_warp_map.Read(path, "key2"));
+  BOOST_CHECK(!read_warp_map.Read(path, "key"));
+  BOOST_CHECK(!read_warp_map.Read(path + ".missing", "key1"));
+  BOOST_CHECK(read_warp_map.Read(path, "key1"));
+  BOOST_CHECK_EQUAL(read_warp_map.width, warp_map.width);
+  BOOST_CHECK_EQUAL(read_warp_map.height, warp_map.height);
+  BOOST_CHECK_EQUAL(read_warp_map.target_width, warp_map.target_width);
+  BOOST_CHECK_EQUAL(read_warp_map.target_height, warp_map.target_height);
+  BOOST_CHECK(read_warp_map.source_x == warp_map.source_x);
+  BOOST_CHECK(read_warp_map.source_y == warp_map.source_y);
+  BOOST_CHECK(read_warp_map.weight_x == warp_map.weight_x);
+  BOOST_CHECK(read_warp_map.weight_y == warp_map.weight_y);
+
+  boost::filesystem::remove(path);
+}
+
 BOOST_AUTO_TEST_CASE(TestResampleImageBilinear) {
   std::vector<float> image(16);
   for (size_t i = 0; i < image.size(); ++i) {
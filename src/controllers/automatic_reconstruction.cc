@@ -83,6 +83,7 @@ AutomaticReconstructionController::AutomaticReconstructionController(
   option_manager_.sift_extraction->num_threads = options_.num_threads;
   option_manager_.sift_matching->num_threads = options_.num_threads;
   option_manager_.mapper->num_threads = options_.num_threads;
+  option_manager_.patch_match_stereo->num_threads = options_.num_threads;
   option_manager_.poisson_meshing->num_threads = options_.num_threads;
 
   ImageReaderOptions reader_options = *option_manager_.image_reader;
@@ -97,6 +98,7 @@ AutomaticReconstructionController::AutomaticReconstructionController(
 
   option_manager_.sift_extraction->use_gpu = options_.use_gpu;
   option_manager_.sift_matching->use_gpu = options_.use_gpu;
+  option_manager_.patch_match_stereo->use_gpu = options_.use_gpu;
 
   option_manager_.sift_extraction->gpu_index = options_.gpu_index;
   option_manager_.sift_matching->gpu_index = options_.gpu_index;
@@ -229,14 +231,6 @@ void AutomaticReconstructionController::RunSparseMapper() {
 }
 
 void AutomaticReconstructionController::RunDenseMapper() {
-#ifndef CUDA_ENABLED
-  std::cout
-      << std::endl
-      << "WARNING: Skipping dense reconstruction because CUDA is not available."
-      << std::endl;
-  return;
-#endif  // CUDA_ENABLED
-
   CreateDirIfNotExists(JoinPaths(options_.workspace_path, "dense"));
 
   for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
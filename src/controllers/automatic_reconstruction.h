@@ -74,7 +74,8 @@ class AutomaticReconstructionController : public Thread {
     // Whether to perform sparse mapping.
     bool sparse = true;
 
-// Whether to perform dense mapping.
+// Whether to perform dense mapping. Without CUDA, the much slower CPU
+// implementation of patch match stereo is used, so it is disabled by default.
 #ifdef CUDA_ENABLED
     bool dense = true;
 #else
@@ -87,7 +88,7 @@ class AutomaticReconstructionController : public Thread {
     // The number of threads to use in all stages.
     int num_threads = -1;
 
-    // Whether to use the GPU in feature extraction and matching.
+    // Whether to use the GPU in feature extraction, matching, and stereo.
     bool use_gpu = true;
 
     // Index of the GPU used for GPU stages. For multi-GPU computation,
@@ -31,24 +31,77 @@
 
 #include "controllers/hierarchical_mapper.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+#include "base/database.h"
 #include "base/scene_clustering.h"
+#include "util/file_job_queue.h"
 #include "util/misc.h"
+#include "util/option_manager.h"
 
 namespace colmap {
 namespace {
 
+// State of a cluster in the merge tree. The reconstructions of a cluster are
+// available once its own leaf reconstruction or the merge of its child
+// clusters finished.
+struct ClusterMergeNode {
+  int level = 0;
+  ReconstructionManager reconstruction_manager;
+};
+
+// Scheduling state of a cluster in `ReconstructAndMergeClusterTree`.
+struct ClusterScheduleNode {
+  const SceneClustering::Cluster* parent = nullptr;
+  size_t num_pending_child_clusters = 0;
+};
+
+// Timings of all merges at the same level of the cluster tree.
+struct MergeLevelTimings {
+  size_t num_merges = 0;
+  double merge_seconds = 0;
+  double finish_seconds = 0;
+};
+
+void InitializeMergeTree(
+    const SceneClustering::Cluster& cluster, const int level,
+    std::unordered_map<const SceneClustering::Cluster*, ClusterMergeNode>*
+        merge_nodes) {
+  (*merge_nodes)[&cluster].level = level;
+  for (const auto& child_cluster : cluster.child_clusters) {
+    InitializeMergeTree(child_cluster, level + 1, merge_nodes);
+  }
+}
+
+void InitializeScheduleTree(
+    const SceneClustering::Cluster& cluster,
+    const SceneClustering::Cluster* parent,
+    std::unordered_map<const SceneClustering::Cluster*, ClusterScheduleNode>*
+        schedule_nodes) {
+  ClusterScheduleNode& schedule_node = (*schedule_nodes)[&cluster];
+  schedule_node.parent = parent;
+  schedule_node.num_pending_child_clusters = cluster.child_clusters.size();
+  for (const auto& child_cluster : cluster.child_clusters) {
+    InitializeScheduleTree(child_cluster, &cluster, schedule_nodes);
+  }
+}
+
 void MergeClusters(
     const SceneClustering::Cluster& cluster,
-    std::unordered_map<const SceneClustering::Cluster*, ReconstructionManager>*
-        reconstruction_managers) {
+    std::unordered_map<const SceneClustering::Cluster*, ClusterMergeNode>*
+        merge_nodes) {
   // Extract all reconstructions from all child clusters.
   std::vector<Reconstruction*> reconstructions;
   for (const auto& child_cluster : cluster.child_clusters) {
-    if (!child_cluster.child_clusters.empty()) {
-      MergeClusters(child_cluster, reconstruction_managers);
-    }
-
-    auto& reconstruction_manager = reconstruction_managers->at(&child_cluster);
+    auto& reconstruction_manager =
+        merge_nodes->at(&child_cluster).reconstruction_manager;
     for (size_t i = 0; i < reconstruction_manager.Size(); ++i) {
       reconstructions.push_back(&reconstruction_manager.Get(i));
     }
@@ -77,22 +130,221 @@ void MergeClusters(
     }
   }
 
-  // Insert a new reconstruction manager for merged cluster.
-  auto& reconstruction_manager = (*reconstruction_managers)[&cluster];
+  // Move the merged reconstructions to the merged cluster.
+  auto& reconstruction_manager =
+      merge_nodes->at(&cluster).reconstruction_manager;
   for (const auto& reconstruction : reconstructions) {
     reconstruction_manager.Add();
     reconstruction_manager.Get(reconstruction_manager.Size() - 1) =
-        *reconstruction;
+        std::move(*reconstruction);
   }
 
-  // Delete all merged child cluster reconstruction managers.
+  // Release all merged child cluster reconstructions.
   for (const auto& child_cluster : cluster.child_clusters) {
-    reconstruction_managers->erase(&child_cluster);
+    merge_nodes->at(&child_cluster).reconstruction_manager.Clear();
+  }
+}
+
+void MergeClusterTree(
+    const SceneClustering::Cluster& cluster,
+    std::unordered_map<const SceneClustering::Cluster*, ClusterMergeNode>*
+        merge_nodes) {
+  if (cluster.child_clusters.empty()) {
+    return;
+  }
+
+  for (const auto& child_cluster : cluster.child_clusters) {
+    MergeClusterTree(child_cluster, merge_nodes);
+  }
+
+  MergeClusters(cluster, merge_nodes);
+
+  std::cout << StringPrintf(
+                   "Merged cluster with %d images into %d reconstruction(s)",
+                   static_cast<int>(cluster.image_ids.size()),
+                   static_cast<int>(
+                       merge_nodes->at(&cluster).reconstruction_manager.Size()))
+            << std::endl;
+}
+
+void PartitionScene(
+    const std::string& database_path, SceneClustering* scene_clustering,
+    std::unordered_map<image_t, std::string>* image_id_to_name) {
+  Database database(database_path);
+
+  std::cout << "Reading images..." << std::endl;
+  const auto images = database.ReadAllImages();
+  for (const auto& image : images) {
+    image_id_to_name->emplace(image.ImageId(), image.Name());
+  }
+
+  std::cout << "Reading scene graph..." << std::endl;
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<int> num_inliers;
+  database.ReadTwoViewGeometryNumInliers(&image_pairs, &num_inliers);
+
+  std::cout << "Partitioning scene graph..." << std::endl;
+  scene_clustering->Partition(image_pairs, num_inliers);
+}
+
+IncrementalMapperOptions GetClusterMapperOptions(
+    const HierarchicalMapperController::Options& options,
+    const IncrementalMapperOptions& mapper_options) {
+  IncrementalMapperOptions cluster_mapper_options = mapper_options;
+  cluster_mapper_options.max_model_overlap = 3;
+  cluster_mapper_options.init_num_trials = options.init_num_trials;
+  return cluster_mapper_options;
+}
+
+const std::string kClusterTreeFileName = "cluster_tree.txt";
+const std::string kJobImageListFileName = "image_list.txt";
+const std::string kJobProjectFileName = "project.ini";
+const std::string kJobSparseDirName = "sparse";
+
+std::string GetClusterJobName(const size_t cluster_idx) {
+  return StringPrintf("cluster%06d", static_cast<int>(cluster_idx));
+}
+
+// Renews the lease of a running job in a background thread, as long as the
+// object is alive.
+class JobLeaseRenewer {
+ public:
+  JobLeaseRenewer(FileJobQueue* queue, const std::string& job_name,
+                  const double lease_timeout)
+      : stop_(false) {
+    if (lease_timeout <= 0) {
+      return;
+    }
+    // Renew several times per timeout to tolerate delayed renewals.
+    const std::chrono::duration<double> interval(lease_timeout / 4);
+    thread_ = std::thread([this, queue, job_name, interval]() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!stop_cond_.wait_for(lock, interval, [this] { return stop_; })) {
+        if (!queue->Renew(job_name)) {
+          std::cerr << "WARNING: Failed to renew lease of job " << job_name
+                    << std::endl;
+        }
+      }
+    });
+  }
+
+  ~JobLeaseRenewer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    stop_cond_.notify_one();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+ private:
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable stop_cond_;
+  std::thread thread_;
+};
+
+void RequeueStaleHierarchicalMapperJobs(FileJobQueue* queue,
+                                        const double lease_timeout) {
+  if (lease_timeout <= 0) {
+    return;
+  }
+  for (const auto& job_name : queue->RequeueStale(lease_timeout)) {
+    std::cout << "WARNING: Requeued job " << job_name
+              << " with expired lease" << std::endl;
   }
 }
 
 }  // namespace
 
+void EnumerateClusters(const SceneClustering::Cluster& cluster,
+                       const int parent_cluster_idx,
+                       std::vector<const SceneClustering::Cluster*>* clusters,
+                       std::vector<int>* parent_cluster_idxs) {
+  const int cluster_idx = static_cast<int>(clusters->size());
+  clusters->push_back(&cluster);
+  parent_cluster_idxs->push_back(parent_cluster_idx);
+  for (const auto& child_cluster : cluster.child_clusters) {
+    EnumerateClusters(child_cluster, cluster_idx, clusters,
+                      parent_cluster_idxs);
+  }
+}
+
+void WriteClusterTree(
+    const std::string& path,
+    const std::vector<const SceneClustering::Cluster*>& clusters,
+    const std::vector<int>& parent_cluster_idxs) {
+  std::ofstream file(path, std::ios::trunc);
+  CHECK(file.is_open()) << path;
+
+  file << "# Cluster tree with one line per cluster in depth-first order:"
+       << std::endl;
+  file << "#   CLUSTER_IDX, PARENT_CLUSTER_IDX, IMAGE_IDS[]" << std::endl;
+
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    file << i << " " << parent_cluster_idxs[i];
+    for (const auto image_id : clusters[i]->image_ids) {
+      file << " " << image_id;
+    }
+    file << std::endl;
+  }
+}
+
+void ReadClusterTree(const std::string& path,
+                     SceneClustering::Cluster* root_cluster,
+                     std::vector<const SceneClustering::Cluster*>* clusters) {
+  std::vector<int> parent_cluster_idxs;
+  std::vector<std::vector<image_t>> image_ids;
+  for (const auto& line : ReadTextFileLines(path)) {
+    if (line[0] == '#') {
+      continue;
+    }
+
+    std::stringstream line_stream(line);
+    size_t cluster_idx;
+    int parent_cluster_idx;
+    line_stream >> cluster_idx >> parent_cluster_idx;
+    CHECK(!line_stream.fail()) << line;
+    CHECK_EQ(cluster_idx, parent_cluster_idxs.size());
+    CHECK_LT(parent_cluster_idx, static_cast<int>(cluster_idx));
+    CHECK_EQ(parent_cluster_idx < 0, cluster_idx == 0);
+
+    parent_cluster_idxs.push_back(parent_cluster_idx);
+    image_ids.emplace_back();
+    image_t image_id;
+    while (line_stream >> image_id) {
+      image_ids.back().push_back(image_id);
+    }
+  }
+
+  CHECK(!parent_cluster_idxs.empty()) << path;
+
+  std::vector<size_t> num_child_clusters(parent_cluster_idxs.size(), 0);
+  for (size_t i = 1; i < parent_cluster_idxs.size(); ++i) {
+    num_child_clusters[parent_cluster_idxs[i]] += 1;
+  }
+
+  // Reserve the child clusters upfront, such that the cluster addresses do not
+  // change when the later clusters in depth-first order are added.
+  std::vector<SceneClustering::Cluster*> mutable_clusters;
+  for (size_t i = 0; i < parent_cluster_idxs.size(); ++i) {
+    SceneClustering::Cluster* cluster = root_cluster;
+    if (i > 0) {
+      auto& child_clusters =
+          mutable_clusters[parent_cluster_idxs[i]]->child_clusters;
+      child_clusters.emplace_back();
+      cluster = &child_clusters.back();
+    }
+    cluster->image_ids = std::move(image_ids[i]);
+    cluster->child_clusters.reserve(num_child_clusters[i]);
+    mutable_clusters.push_back(cluster);
+  }
+
+  clusters->assign(mutable_clusters.begin(), mutable_clusters.end());
+}
+
 bool HierarchicalMapperController::Options::Check() const {
   CHECK_OPTION_GT(init_num_trials, -1);
   CHECK_OPTION_GE(num_workers, -1);
@@ -124,23 +376,7 @@ void HierarchicalMapperController::Run() {
 
   std::unordered_map<image_t, std::string> image_id_to_name;
 
-  {
-    Database database(options_.database_path);
-
-    std::cout << "Reading images..." << std::endl;
-    const auto images = database.ReadAllImages();
-    for (const auto& image : images) {
-      image_id_to_name.emplace(image.ImageId(), image.Name());
-    }
-
-    std::cout << "Reading scene graph..." << std::endl;
-    std::vector<std::pair<image_t, image_t>> image_pairs;
-    std::vector<int> num_inliers;
-    database.ReadTwoViewGeometryNumInliers(&image_pairs, &num_inliers);
-
-    std::cout << "Partitioning scene graph..." << std::endl;
-    scene_clustering.Partition(image_pairs, num_inliers);
-  }
+  PartitionScene(options_.database_path, &scene_clustering, &image_id_to_name);
 
   auto leaf_clusters = scene_clustering.GetLeafClusters();
 
@@ -181,9 +417,8 @@ void HierarchicalMapperController::Run() {
       return;
     }
 
-    IncrementalMapperOptions custom_options = mapper_options_;
-    custom_options.max_model_overlap = 3;
-    custom_options.init_num_trials = options_.init_num_trials;
+    IncrementalMapperOptions custom_options =
+        GetClusterMapperOptions(options_, mapper_options_);
     custom_options.num_threads = num_threads_per_worker;
 
     for (const auto image_id : cluster.image_ids) {
@@ -204,32 +439,361 @@ void HierarchicalMapperController::Run() {
               return cluster1->image_ids.size() > cluster2->image_ids.size();
             });
 
-  // Start the reconstruction workers.
+  //////////////////////////////////////////////////////////////////////////////
+  // Merge clusters
+  //////////////////////////////////////////////////////////////////////////////
 
-  std::unordered_map<const SceneClustering::Cluster*, ReconstructionManager>
-      reconstruction_managers;
-  reconstruction_managers.reserve(leaf_clusters.size());
+  // All nodes are created upfront, so the map is not modified concurrently.
+  const SceneClustering::Cluster* root_cluster =
+      scene_clustering.GetRootCluster();
+  std::unordered_map<const SceneClustering::Cluster*, ClusterMergeNode>
+      merge_nodes;
+  InitializeMergeTree(*root_cluster, 0, &merge_nodes);
+
+  std::mutex merge_mutex;
+  std::map<int, MergeLevelTimings> merge_level_timings;
+
+  auto MergeCluster = [&](const SceneClustering::Cluster& cluster) {
+    Timer timer;
+    timer.Start();
+    MergeClusters(cluster, &merge_nodes);
+    const double merge_seconds = timer.ElapsedSeconds();
+
+    std::unique_lock<std::mutex> lock(merge_mutex);
+    const ClusterMergeNode& merge_node = merge_nodes.at(&cluster);
+    MergeLevelTimings& timings = merge_level_timings[merge_node.level];
+    timings.num_merges += 1;
+    timings.merge_seconds += merge_seconds;
+    timings.finish_seconds = GetTimer().ElapsedSeconds();
+    std::cout << StringPrintf(
+                     "Merged cluster with %d images at level %d into %d "
+                     "reconstruction(s) in %.3fs",
+                     static_cast<int>(cluster.image_ids.size()),
+                     merge_node.level,
+                     static_cast<int>(merge_node.reconstruction_manager.Size()),
+                     merge_seconds)
+              << std::endl;
+  };
 
   ThreadPool thread_pool(num_eff_workers);
-  for (const auto& cluster : leaf_clusters) {
-    thread_pool.AddTask(ReconstructCluster, *cluster,
-                        &reconstruction_managers[cluster]);
+  ReconstructAndMergeClusterTree(
+      *root_cluster, leaf_clusters,
+      [&](const SceneClustering::Cluster& cluster) {
+        ReconstructCluster(cluster,
+                           &merge_nodes.at(&cluster).reconstruction_manager);
+      },
+      MergeCluster, &thread_pool);
+
+  std::cout << std::endl;
+  for (const auto& timings : merge_level_timings) {
+    std::cout << StringPrintf(
+                     "Merge level %d: %d merge(s) in %.3fs, finished after "
+                     "%.3fs",
+                     timings.first,
+                     static_cast<int>(timings.second.num_merges),
+                     timings.second.merge_seconds,
+                     timings.second.finish_seconds)
+              << std::endl;
   }
-  thread_pool.Wait();
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Merge clusters
-  //////////////////////////////////////////////////////////////////////////////
+  *reconstruction_manager_ =
+      std::move(merge_nodes.at(root_cluster).reconstruction_manager);
+
+  std::cout << std::endl;
+  GetTimer().PrintMinutes();
+}
+
+void ReconstructAndMergeClusterTree(
+    const SceneClustering::Cluster& root_cluster,
+    const std::vector<const SceneClustering::Cluster*>& leaf_clusters,
+    const std::function<void(const SceneClustering::Cluster&)>&
+        reconstruct_func,
+    const std::function<void(const SceneClustering::Cluster&)>& merge_func,
+    ThreadPool* thread_pool) {
+  CHECK_NOTNULL(thread_pool);
+
+  // All nodes are created upfront, so the map is not modified concurrently.
+  std::unordered_map<const SceneClustering::Cluster*, ClusterScheduleNode>
+      schedule_nodes;
+  InitializeScheduleTree(root_cluster, nullptr, &schedule_nodes);
+
+  std::mutex schedule_mutex;
+
+  std::function<void(const SceneClustering::Cluster*)> FinishCluster;
+
+  auto MergeCluster = [&](const SceneClustering::Cluster* cluster) {
+    merge_func(*cluster);
+    FinishCluster(cluster);
+  };
+
+  FinishCluster = [&](const SceneClustering::Cluster* cluster) {
+    const SceneClustering::Cluster* parent_cluster = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(schedule_mutex);
+      parent_cluster = schedule_nodes.at(cluster).parent;
+      if (parent_cluster == nullptr ||
+          --schedule_nodes.at(parent_cluster).num_pending_child_clusters > 0) {
+        return;
+      }
+    }
+    thread_pool->AddTask(MergeCluster, parent_cluster);
+  };
+
+  for (const auto cluster : leaf_clusters) {
+    CHECK(cluster->child_clusters.empty());
+    thread_pool->AddTask([&, cluster]() {
+      reconstruct_func(*cluster);
+      FinishCluster(cluster);
+    });
+  }
+
+  // The merges are added by the running tasks, so waiting for all tasks also
+  // waits for the merge of the root cluster.
+  thread_pool->Wait();
+}
+
+size_t ExportHierarchicalMapperJobs(
+    const HierarchicalMapperController::Options& options,
+    const SceneClustering::Options& clustering_options,
+    const IncrementalMapperOptions& mapper_options,
+    const std::string& queue_path) {
+  CHECK(options.Check());
+
+  PrintHeading1("Partitioning the scene");
+
+  SceneClustering scene_clustering(clustering_options);
+  std::unordered_map<image_t, std::string> image_id_to_name;
+  PartitionScene(options.database_path, &scene_clustering, &image_id_to_name);
+
+  std::vector<const SceneClustering::Cluster*> clusters;
+  std::vector<int> parent_cluster_idxs;
+  EnumerateClusters(*scene_clustering.GetRootCluster(), -1, &clusters,
+                    &parent_cluster_idxs);
+
+  PrintHeading1("Exporting cluster jobs");
+
+  FileJobQueue queue(queue_path);
+  WriteClusterTree(JoinPaths(queue_path, kClusterTreeFileName), clusters,
+                   parent_cluster_idxs);
+
+  // All jobs share the same options, which are written to every job to make
+  // them self-contained.
+  OptionManager job_options;
+  job_options.AddDatabaseOptions();
+  job_options.AddImageOptions();
+  job_options.AddMapperOptions();
+  *job_options.database_path = options.database_path;
+  *job_options.image_path = options.image_path;
+  *job_options.mapper = GetClusterMapperOptions(options, mapper_options);
+
+  size_t num_jobs = 0;
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    if (!clusters[i]->child_clusters.empty()) {
+      continue;
+    }
+
+    const std::string job_name = GetClusterJobName(i);
+    const std::string job_path = queue.Create(job_name);
+
+    std::ofstream file(JoinPaths(job_path, kJobImageListFileName));
+    CHECK(file.is_open()) << job_path;
+    for (const auto image_id : clusters[i]->image_ids) {
+      file << image_id_to_name.at(image_id) << std::endl;
+    }
+    file.close();
+
+    job_options.Write(JoinPaths(job_path, kJobProjectFileName));
+
+    queue.Push(job_name);
+    num_jobs += 1;
+
+    std::cout << StringPrintf("  Job %s with %d images", job_name.c_str(),
+                              static_cast<int>(clusters[i]->image_ids.size()))
+              << std::endl;
+  }
+
+  return num_jobs;
+}
+
+size_t ReconstructHierarchicalMapperJobs(const std::string& queue_path,
+                                         const double lease_timeout,
+                                         const bool requeue_failed) {
+  FileJobQueue queue(queue_path);
+
+  if (requeue_failed) {
+    for (const auto& job_name : queue.Jobs(FileJobQueue::JobStatus::FAILED)) {
+      queue.Requeue(job_name);
+      std::cout << "Requeued failed job " << job_name << std::endl;
+    }
+  }
+
+  size_t num_jobs = 0;
+  std::string job_name;
+  while (true) {
+    RequeueStaleHierarchicalMapperJobs(&queue, lease_timeout);
+    if (!queue.Pop(&job_name)) {
+      break;
+    }
+
+    PrintHeading1("Reconstructing job " + job_name);
+
+    const std::string job_path = queue.JobPath(job_name);
+
+    // A previous worker may have moved its output into the job and lost the
+    // lease before it could finish the job.
+    if (ExistsDir(JoinPaths(job_path, kJobSparseDirName))) {
+      if (queue.Finish(job_name)) {
+        num_jobs += 1;
+      }
+      continue;
+    }
+
+    OptionManager job_options;
+    job_options.AddDatabaseOptions();
+    job_options.AddImageOptions();
+    job_options.AddMapperOptions();
+    if (!job_options.Read(JoinPaths(job_path, kJobProjectFileName))) {
+      std::cerr << "ERROR: Failed to read options of job " << job_name
+                << std::endl;
+      queue.Fail(job_name);
+      continue;
+    }
+
+    // An empty list of image names would reconstruct all images.
+    ReconstructionManager reconstruction_manager;
+    const std::vector<std::string> image_names =
+        ReadTextFileLines(JoinPaths(job_path, kJobImageListFileName));
+    if (!image_names.empty()) {
+      JobLeaseRenewer lease_renewer(&queue, job_name, lease_timeout);
+      job_options.mapper->image_names.insert(image_names.begin(),
+                                             image_names.end());
+      IncrementalMapperController mapper(
+          job_options.mapper.get(), *job_options.image_path,
+          *job_options.database_path, &reconstruction_manager);
+      mapper.Start();
+      mapper.Wait();
+    }
+
+    // Failed jobs remain visible to the merger and can be requeued, e.g.,
+    // after adjusting the mapper options of the job.
+    if (reconstruction_manager.Size() == 0) {
+      std::cerr << "ERROR: Job " << job_name
+                << " produced no reconstruction" << std::endl;
+      if (!queue.Fail(job_name)) {
+        std::cerr << "WARNING: Job " << job_name
+                  << " was requeued by another worker" << std::endl;
+      }
+      continue;
+    }
+
+    // Write the output to a private directory, since the job may have been
+    // requeued and claimed by another worker in the meantime.
+    const std::string sparse_path = queue.CreateOutput(job_name);
+    reconstruction_manager.Write(sparse_path, &job_options);
+
+    if (!queue.Finish(job_name, sparse_path, kJobSparseDirName)) {
+      std::cerr << "WARNING: Job " << job_name
+                << " was requeued by another worker" << std::endl;
+      continue;
+    }
+
+    num_jobs += 1;
+  }
+
+  return num_jobs;
+}
+
+bool MergeHierarchicalMapperJobs(
+    const std::string& queue_path,
+    ReconstructionManager* reconstruction_manager) {
+  CHECK_NOTNULL(reconstruction_manager);
+
+  FileJobQueue queue(queue_path);
+
+  const std::vector<std::string> running_job_names =
+      queue.Jobs(FileJobQueue::JobStatus::RUNNING);
+  for (const auto& job_name : running_job_names) {
+    std::cerr << StringPrintf("Job %s is running, last lease renewal %ds ago",
+                              job_name.c_str(),
+                              static_cast<int>(queue.LeaseAge(job_name)))
+              << std::endl;
+  }
+
+  const std::vector<std::string> failed_job_names =
+      queue.Jobs(FileJobQueue::JobStatus::FAILED);
+
+  const size_t num_unfinished_jobs =
+      queue.Jobs(FileJobQueue::JobStatus::CREATED).size() +
+      queue.Jobs(FileJobQueue::JobStatus::PENDING).size() +
+      running_job_names.size();
+  if (num_unfinished_jobs > 0) {
+    std::cerr << StringPrintf("ERROR: %d jobs are not yet finished",
+                              static_cast<int>(num_unfinished_jobs))
+              << std::endl;
+    if (!running_job_names.empty()) {
+      std::cerr << "Jobs of crashed workers are requeued by running a worker "
+                   "with `--lease_timeout`"
+                << std::endl;
+    }
+    return false;
+  }
+
+  for (const auto& job_name : failed_job_names) {
+    std::cout << "WARNING: Ignoring failed job " << job_name << std::endl;
+  }
+  if (!failed_job_names.empty()) {
+    std::cout << "Failed jobs are retried by running a worker with "
+                 "`--requeue_failed 1`"
+              << std::endl;
+  }
+
+  PrintHeading1("Reading cluster reconstructions");
+
+  SceneClustering::Cluster root_cluster;
+  std::vector<const SceneClustering::Cluster*> clusters;
+  ReadClusterTree(JoinPaths(queue_path, kClusterTreeFileName), &root_cluster,
+                  &clusters);
+
+  std::unordered_map<const SceneClustering::Cluster*, ClusterMergeNode>
+      merge_nodes;
+  InitializeMergeTree(root_cluster, 0, &merge_nodes);
+
+  const std::vector<std::string> finished_job_names =
+      queue.Jobs(FileJobQueue::JobStatus::FINISHED);
+  const std::unordered_set<std::string> finished_job_names_set(
+      finished_job_names.begin(), finished_job_names.end());
+
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    const std::string job_name = GetClusterJobName(i);
+    if (!clusters[i]->child_clusters.empty() ||
+        finished_job_names_set.count(job_name) == 0) {
+      continue;
+    }
+
+    auto& cluster_reconstruction_manager =
+        merge_nodes.at(clusters[i]).reconstruction_manager;
+    std::vector<std::string> reconstruction_paths =
+        GetDirList(JoinPaths(queue.JobPath(job_name), kJobSparseDirName));
+    std::sort(reconstruction_paths.begin(), reconstruction_paths.end());
+    for (const auto& reconstruction_path : reconstruction_paths) {
+      cluster_reconstruction_manager.Read(reconstruction_path);
+    }
+
+    std::cout << StringPrintf("  Job %s with %d reconstruction(s)",
+                              job_name.c_str(),
+                              static_cast<int>(
+                                  cluster_reconstruction_manager.Size()))
+              << std::endl;
+  }
 
   PrintHeading1("Merging clusters");
 
-  MergeClusters(*scene_clustering.GetRootCluster(), &reconstruction_managers);
+  MergeClusterTree(root_cluster, &merge_nodes);
 
-  CHECK_EQ(reconstruction_managers.size(), 1);
-  *reconstruction_manager_ = std::move(reconstruction_managers.begin()->second);
+  *reconstruction_manager =
+      std::move(merge_nodes.at(&root_cluster).reconstruction_manager);
 
-  std::cout << std::endl;
-  GetTimer().PrintMinutes();
+  return true;
 }
 
 }  // namespace colmap
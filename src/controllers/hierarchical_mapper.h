@@ -77,6 +77,69 @@ class HierarchicalMapperController : public Thread {
   ReconstructionManager* reconstruction_manager_;
 };
 
+// Reconstruct the leaf clusters of the cluster tree in the given order using
+// the thread pool and merge every parent cluster as soon as all of its child
+// clusters are finished. Independent subtrees are thus merged concurrently
+// with each other and with the reconstruction of the remaining leaf clusters.
+// Returns once all clusters are reconstructed and merged.
+void ReconstructAndMergeClusterTree(
+    const SceneClustering::Cluster& root_cluster,
+    const std::vector<const SceneClustering::Cluster*>& leaf_clusters,
+    const std::function<void(const SceneClustering::Cluster&)>&
+        reconstruct_func,
+    const std::function<void(const SceneClustering::Cluster&)>& merge_func,
+    ThreadPool* thread_pool);
+
+// Enumerate all clusters of the tree in depth-first order together with the
+// index of their parent cluster, which is -1 for the root cluster.
+void EnumerateClusters(const SceneClustering::Cluster& cluster,
+                       const int parent_cluster_idx,
+                       std::vector<const SceneClustering::Cluster*>* clusters,
+                       std::vector<int>* parent_cluster_idxs);
+
+// Write the enumerated clusters as a text file with one line per cluster and
+// read them back into a cluster tree, in which case `clusters` points to the
+// clusters of `root_cluster` in the written order.
+void WriteClusterTree(
+    const std::string& path,
+    const std::vector<const SceneClustering::Cluster*>& clusters,
+    const std::vector<int>& parent_cluster_idxs);
+void ReadClusterTree(const std::string& path,
+                     SceneClustering::Cluster* root_cluster,
+                     std::vector<const SceneClustering::Cluster*>* clusters);
+
+// Distributed hierarchical mapping, in which the leaf clusters are exported as
+// self-contained jobs into a file job queue, reconstructed by any number of
+// worker processes with access to the queue, the images, and the database,
+// and finally merged by a coordinator. The image and database paths must be
+// valid for all worker processes, e.g., on shared storage.
+
+// Partition the scene and export every leaf cluster as a job with the list of
+// its images and its mapper options. The cluster tree is stored in the queue,
+// so that the reconstructed clusters can later be merged. Returns the number
+// of exported jobs.
+size_t ExportHierarchicalMapperJobs(
+    const HierarchicalMapperController::Options& options,
+    const SceneClustering::Options& clustering_options,
+    const IncrementalMapperOptions& mapper_options,
+    const std::string& queue_path);
+
+// Reconstruct pending jobs of the queue until no pending jobs are left. The
+// reconstructions are written to the "sparse" folder of each job. Jobs
+// without any reconstruction are marked as failed. If the lease timeout in
+// seconds is positive, the worker renews the lease of its running job and
+// requeues running jobs of other workers with expired leases, e.g., after
+// they crashed. Failed jobs are optionally requeued before reconstructing.
+// Returns the number of reconstructed jobs.
+size_t ReconstructHierarchicalMapperJobs(const std::string& queue_path,
+                                         const double lease_timeout = 0,
+                                         const bool requeue_failed = false);
+
+// Merge the reconstructed jobs of the queue bottom-up along the cluster tree.
+// Failed jobs are ignored. Returns false if some jobs are not yet finished.
+bool MergeHierarchicalMapperJobs(const std::string& queue_path,
+                                 ReconstructionManager* reconstruction_manager);
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_CONTROLLERS_HIERARCHICAL_MAPPER_H_
@@ -0,0 +1,195 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "controllers/hierarchical_mapper"
+#include "util/testing.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <boost/filesystem.hpp>
+
+#include "controllers/hierarchical_mapper.h"
+#include "util/random.h"
+
+using namespace colmap;
+
+namespace {
+
+// Create an unbalanced cluster tree, in which the first child cluster of
+// every level is again partitioned up to the given depth. The child clusters
+// have overlapping images and the root cluster has no images.
+void CreateClusterTree(const int depth, SceneClustering::Cluster* cluster) {
+  if (depth == 0) {
+    return;
+  }
+  cluster->child_clusters.resize(depth % 2 == 0 ? 2 : 3);
+  for (size_t i = 0; i < cluster->child_clusters.size(); ++i) {
+    cluster->child_clusters[i].image_ids = {static_cast<image_t>(depth),
+                                            static_cast<image_t>(i + 1)};
+  }
+  CreateClusterTree(depth - 1, &cluster->child_clusters[0]);
+}
+
+void GetClusters(const SceneClustering::Cluster& cluster,
+                 std::vector<const SceneClustering::Cluster*>* clusters,
+                 std::vector<const SceneClustering::Cluster*>* leaf_clusters) {
+  clusters->push_back(&cluster);
+  if (cluster.child_clusters.empty()) {
+    leaf_clusters->push_back(&cluster);
+  }
+  for (const auto& child_cluster : cluster.child_clusters) {
+    GetClusters(child_cluster, clusters, leaf_clusters);
+  }
+}
+
+void CheckReconstructAndMerge(const SceneClustering::Cluster& root_cluster,
+                              const int num_threads) {
+  std::vector<const SceneClustering::Cluster*> clusters;
+  std::vector<const SceneClustering::Cluster*> leaf_clusters;
+  GetClusters(root_cluster, &clusters, &leaf_clusters);
+
+  std::mutex mutex;
+  std::unordered_map<const SceneClustering::Cluster*, int> num_reconstructs;
+  std::unordered_map<const SceneClustering::Cluster*, int> num_merges;
+  std::unordered_set<const SceneClustering::Cluster*> finished_clusters;
+
+  ThreadPool thread_pool(num_threads);
+  ReconstructAndMergeClusterTree(
+      root_cluster, leaf_clusters,
+      [&](const SceneClustering::Cluster& cluster) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(RandomInteger(0, 1000)));
+        std::unique_lock<std::mutex> lock(mutex);
+        BOOST_CHECK(cluster.child_clusters.empty());
+        num_reconstructs[&cluster] += 1;
+        finished_clusters.insert(&cluster);
+      },
+      [&](const SceneClustering::Cluster& cluster) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(RandomInteger(0, 1000)));
+        std::unique_lock<std::mutex> lock(mutex);
+        BOOST_CHECK(!cluster.child_clusters.empty());
+        for (const auto& child_cluster : cluster.child_clusters) {
+          BOOST_CHECK_EQUAL(finished_clusters.count(&child_cluster), 1);
+        }
+        num_merges[&cluster] += 1;
+        finished_clusters.insert(&cluster);
+      },
+      &thread_pool);
+
+  BOOST_CHECK_EQUAL(finished_clusters.size(), clusters.size());
+  for (const auto cluster : clusters) {
+    if (cluster->child_clusters.empty()) {
+      BOOST_CHECK_EQUAL(num_reconstructs[cluster], 1);
+      BOOST_CHECK_EQUAL(num_merges.count(cluster), 0);
+    } else {
+      BOOST_CHECK_EQUAL(num_reconstructs.count(cluster), 0);
+      BOOST_CHECK_EQUAL(num_merges[cluster], 1);
+    }
+  }
+}
+
+void CheckEqualClusterTrees(const SceneClustering::Cluster& cluster1,
+                            const SceneClustering::Cluster& cluster2) {
+  BOOST_CHECK(cluster1.image_ids == cluster2.image_ids);
+  BOOST_CHECK_EQUAL(cluster1.child_clusters.size(),
+                    cluster2.child_clusters.size());
+  for (size_t i = 0; i < std::min(cluster1.child_clusters.size(),
+                                  cluster2.child_clusters.size());
+       ++i) {
+    CheckEqualClusterTrees(cluster1.child_clusters[i],
+                           cluster2.child_clusters[i]);
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestReconstructAndMergeClusterTreeSingleCluster) {
+  SceneClustering::Cluster root_cluster;
+  root_cluster.image_ids = {1, 2, 3};
+  CheckReconstructAndMerge(root_cluster, 1);
+  CheckReconstructAndMerge(root_cluster, 4);
+}
+
+BOOST_AUTO_TEST_CASE(TestReconstructAndMergeClusterTree) {
+  SetPRNGSeed(0);
+  SceneClustering::Cluster root_cluster;
+  CreateClusterTree(4, &root_cluster);
+  for (const int num_threads : {1, 2, 4, 8}) {
+    CheckReconstructAndMerge(root_cluster, num_threads);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestWriteReadClusterTree) {
+  SceneClustering::Cluster root_cluster;
+  CreateClusterTree(4, &root_cluster);
+
+  std::vector<const SceneClustering::Cluster*> clusters;
+  std::vector<const SceneClustering::Cluster*> leaf_clusters;
+  GetClusters(root_cluster, &clusters, &leaf_clusters);
+
+  std::vector<const SceneClustering::Cluster*> enumerated_clusters;
+  std::vector<int> parent_cluster_idxs;
+  EnumerateClusters(root_cluster, -1, &enumerated_clusters,
+                    &parent_cluster_idxs);
+  BOOST_CHECK(enumerated_clusters == clusters);
+  BOOST_CHECK_EQUAL(parent_cluster_idxs.size(), clusters.size());
+  BOOST_CHECK_EQUAL(parent_cluster_idxs[0], -1);
+  for (size_t i = 1; i < clusters.size(); ++i) {
+    const auto& child_clusters =
+        clusters[parent_cluster_idxs[i]]->child_clusters;
+    BOOST_CHECK(clusters[i] >= child_clusters.data() &&
+                clusters[i] < child_clusters.data() + child_clusters.size());
+  }
+
+  const std::string path = CreateTempPath();
+  WriteClusterTree(path, enumerated_clusters, parent_cluster_idxs);
+
+  SceneClustering::Cluster read_root_cluster;
+  std::vector<const SceneClustering::Cluster*> read_clusters;
+  ReadClusterTree(path, &read_root_cluster, &read_clusters);
+  boost::filesystem::remove(path);
+
+  CheckEqualClusterTrees(root_cluster, read_root_cluster);
+
+  // The read clusters are enumerated in the same order as the written ones.
+  BOOST_CHECK_EQUAL(read_clusters.size(), clusters.size());
+  std::vector<const SceneClustering::Cluster*> read_enumerated_clusters;
+  std::vector<int> read_parent_cluster_idxs;
+  EnumerateClusters(read_root_cluster, -1, &read_enumerated_clusters,
+                    &read_parent_cluster_idxs);
+  BOOST_CHECK(read_clusters == read_enumerated_clusters);
+  BOOST_CHECK(read_parent_cluster_idxs == parent_cluster_idxs);
+}
@@ -46,14 +46,12 @@ size_t TriangulateImage(const IncrementalMapperOptions& options,
   return num_tris;
 }
 
-void AdjustGlobalBundle(const IncrementalMapperOptions& options,
-                        IncrementalMapper* mapper) {
-  BundleAdjustmentOptions custom_ba_options = options.GlobalBundleAdjustment();
-
-  const size_t num_reg_images = mapper->GetReconstruction().NumRegImages();
+// Use stricter convergence criteria for first registered images.
+const size_t kMinNumRegImagesForFastBA = 10;
 
-  // Use stricter convergence criteria for first registered images.
-  const size_t kMinNumRegImagesForFastBA = 10;
+BundleAdjustmentOptions GetGlobalBundleAdjustmentOptions(
+    const IncrementalMapperOptions& options, const size_t num_reg_images) {
+  BundleAdjustmentOptions custom_ba_options = options.GlobalBundleAdjustment();
   if (num_reg_images < kMinNumRegImagesForFastBA) {
     custom_ba_options.solver_options.function_tolerance /= 10;
     custom_ba_options.solver_options.gradient_tolerance /= 10;
@@ -61,6 +59,14 @@ void AdjustGlobalBundle(const IncrementalMapperOptions& options,
     custom_ba_options.solver_options.max_num_iterations *= 2;
     custom_ba_options.solver_options.max_linear_solver_iterations = 200;
   }
+  return custom_ba_options;
+}
+
+void AdjustGlobalBundle(const IncrementalMapperOptions& options,
+                        IncrementalMapper* mapper) {
+  const size_t num_reg_images = mapper->GetReconstruction().NumRegImages();
+  const BundleAdjustmentOptions custom_ba_options =
+      GetGlobalBundleAdjustmentOptions(options, num_reg_images);
 
   PrintHeading1("Global bundle adjustment");
   if (options.ba_global_use_pba && !options.fix_existing_images &&
@@ -130,6 +136,37 @@ void IterativeGlobalRefinement(const IncrementalMapperOptions& options,
   FilterImages(options, mapper);
 }
 
+// Retriangulate and start global bundle adjustment of a copy of the
+// reconstruction in the background, see `IncrementalMapper`.
+void BeginAsyncGlobalRefinement(const IncrementalMapperOptions& options,
+                                IncrementalMapper* mapper) {
+  PrintHeading1("Retriangulation");
+  CompleteAndMergeTracks(options, mapper);
+  std::cout << "  => Retriangulated observations: "
+            << mapper->Retriangulate(options.Triangulation()) << std::endl;
+
+  PrintHeading1("Starting asynchronous global bundle adjustment");
+  mapper->BeginAsyncGlobalBundle(
+      options.Mapper(),
+      GetGlobalBundleAdjustmentOptions(
+          options, mapper->GetReconstruction().NumRegImages()));
+}
+
+// Transfer the result of the asynchronous global bundle adjustment to the
+// reconstruction and clean up the reconstruction as in a synchronous global
+// refinement iteration.
+void EndAsyncGlobalRefinement(const IncrementalMapperOptions& options,
+                              IncrementalMapper* mapper) {
+  PrintHeading1("Finishing asynchronous global bundle adjustment");
+  if (!mapper->EndAsyncGlobalBundle()) {
+    std::cout << "  => Bundle adjustment failed." << std::endl;
+    return;
+  }
+  CompleteAndMergeTracks(options, mapper);
+  FilterPoints(options, mapper);
+  FilterImages(options, mapper);
+}
+
 void ExtractColors(const std::string& image_path, const image_t image_id,
                    Reconstruction* reconstruction) {
   if (!reconstruction->ExtractColorsForImage(image_id, image_path)) {
@@ -195,7 +232,9 @@ IncrementalMapper::Options IncrementalMapperOptions::Mapper() const {
   options.max_focal_length_ratio = max_focal_length_ratio;
   options.max_extra_param = max_extra_param;
   options.num_threads = num_threads;
+  options.abs_pose_ransac_num_threads = abs_pose_ransac_num_threads;
   options.local_ba_num_images = ba_local_num_images;
+  options.local_ba_reuse_problem = ba_local_reuse_problem;
   options.fix_existing_images = fix_existing_images;
   return options;
 }
@@ -528,15 +567,26 @@ void IncrementalMapperController::Reconstruct(
           TriangulateImage(*options_, next_image, &mapper);
           IterativeLocalRefinement(*options_, next_image_id, &mapper);
 
-          if (reconstruction.NumRegImages() >=
-                  options_->ba_global_images_ratio * ba_prev_num_reg_images ||
-              reconstruction.NumRegImages() >=
-                  options_->ba_global_images_freq + ba_prev_num_reg_images ||
-              reconstruction.NumPoints3D() >=
-                  options_->ba_global_points_ratio * ba_prev_num_points ||
-              reconstruction.NumPoints3D() >=
-                  options_->ba_global_points_freq + ba_prev_num_points) {
-            IterativeGlobalRefinement(*options_, &mapper);
+          if (mapper.IsAsyncGlobalBundleFinished()) {
+            EndAsyncGlobalRefinement(*options_, &mapper);
+          }
+
+          // A new global refinement is only started after the pending
+          // asynchronous one has finished.
+          if (!mapper.IsAsyncGlobalBundlePending() &&
+              (reconstruction.NumRegImages() >=
+                   options_->ba_global_images_ratio * ba_prev_num_reg_images ||
+               reconstruction.NumRegImages() >=
+                   options_->ba_global_images_freq + ba_prev_num_reg_images ||
+               reconstruction.NumPoints3D() >=
+                   options_->ba_global_points_ratio * ba_prev_num_points ||
+               reconstruction.NumPoints3D() >=
+                   options_->ba_global_points_freq + ba_prev_num_points)) {
+            if (options_->ba_global_async) {
+              BeginAsyncGlobalRefinement(*options_, &mapper);
+            } else {
+              IterativeGlobalRefinement(*options_, &mapper);
+            }
             ba_prev_num_points = reconstruction.NumPoints3D();
             ba_prev_num_reg_images = reconstruction.NumRegImages();
           }
@@ -583,6 +633,9 @@ void IncrementalMapperController::Reconstruct(
       if (!reg_next_success && prev_reg_next_success) {
         reg_next_success = true;
         prev_reg_next_success = false;
+        if (mapper.IsAsyncGlobalBundlePending()) {
+          EndAsyncGlobalRefinement(*options_, &mapper);
+        }
         IterativeGlobalRefinement(*options_, &mapper);
       } else {
         prev_reg_next_success = reg_next_success;
@@ -595,6 +648,10 @@ void IncrementalMapperController::Reconstruct(
       break;
     }
 
+    if (mapper.IsAsyncGlobalBundlePending()) {
+      EndAsyncGlobalRefinement(*options_, &mapper);
+    }
+
     // Only run final global BA, if last incremental BA was not global.
     if (reconstruction.NumRegImages() >= 2 &&
         reconstruction.NumRegImages() != ba_prev_num_reg_images &&
@@ -76,6 +76,10 @@ struct IncrementalMapperOptions {
   // The number of threads to use during reconstruction.
   int num_threads = -1;
 
+  // The number of threads to evaluate the RANSAC trials of absolute pose
+  // estimation concurrently when registering an image.
+  int abs_pose_ransac_num_threads = 1;
+
   // Thresholds for filtering images with degenerate intrinsics.
   double min_focal_length_ratio = 0.1;
   double max_focal_length_ratio = 10.0;
@@ -96,6 +100,9 @@ struct IncrementalMapperOptions {
   // The maximum number of local bundle adjustment iterations.
   int ba_local_max_num_iterations = 25;
 
+  // Whether to reuse the local bundle adjustment problem across images.
+  bool ba_local_reuse_problem = false;
+
   // Whether to use PBA in global bundle adjustment.
   bool ba_global_use_pba = false;
 
@@ -111,6 +118,15 @@ struct IncrementalMapperOptions {
   // The maximum number of global bundle adjustment iterations.
   int ba_global_max_num_iterations = 50;
 
+  // Whether to run global bundle adjustment on a copy of the reconstruction
+  // in the background, while the registration of images continues. Unlike the
+  // synchronous refinement, the background refinement runs a single bundle
+  // adjustment with Ceres, followed by one round of track completion and
+  // filtering, so `ba_global_max_refinements` and `ba_global_use_pba` only
+  // apply to the synchronous refinements that are still performed, e.g., when
+  // no further image can be registered.
+  bool ba_global_async = false;
+
   // The thresholds for iterative bundle adjustment refinements.
   int ba_local_max_refinements = 2;
   double ba_local_max_refinement_change = 0.001;
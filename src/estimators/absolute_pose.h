@@ -37,6 +37,8 @@
 
 #include <Eigen/Core>
 
+#include "estimators/utils.h"
+#include "optim/residual_evaluator.h"
 #include "util/alignment.h"
 #include "util/types.h"
 
@@ -177,6 +179,22 @@ class EPNPEstimator {
   std::array<Eigen::Vector3d, 4> ccs_;
 };
 
+template <>
+class ResidualEvaluator<P3PEstimator> : public ReprojectionErrorEvaluator {
+ public:
+  ResidualEvaluator(P3PEstimator*, const std::vector<Eigen::Vector2d>& X,
+                    const std::vector<Eigen::Vector3d>& Y)
+      : ReprojectionErrorEvaluator(X, Y) {}
+};
+
+template <>
+class ResidualEvaluator<EPNPEstimator> : public ReprojectionErrorEvaluator {
+ public:
+  ResidualEvaluator(EPNPEstimator*, const std::vector<Eigen::Vector2d>& X,
+                    const std::vector<Eigen::Vector3d>& Y)
+      : ReprojectionErrorEvaluator(X, Y) {}
+};
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_ESTIMATORS_ABSOLUTE_POSE_H_
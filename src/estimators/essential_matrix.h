@@ -38,6 +38,8 @@
 
 #include <ceres/ceres.h>
 
+#include "estimators/utils.h"
+#include "optim/residual_evaluator.h"
 #include "util/alignment.h"
 #include "util/types.h"
 
@@ -122,6 +124,26 @@ class EssentialMatrixEightPointEstimator {
                         std::vector<double>* residuals);
 };
 
+template <>
+class ResidualEvaluator<EssentialMatrixFivePointEstimator>
+    : public SampsonErrorEvaluator {
+ public:
+  ResidualEvaluator(EssentialMatrixFivePointEstimator*,
+                    const std::vector<Eigen::Vector2d>& X,
+                    const std::vector<Eigen::Vector2d>& Y)
+      : SampsonErrorEvaluator(X, Y) {}
+};
+
+template <>
+class ResidualEvaluator<EssentialMatrixEightPointEstimator>
+    : public SampsonErrorEvaluator {
+ public:
+  ResidualEvaluator(EssentialMatrixEightPointEstimator*,
+                    const std::vector<Eigen::Vector2d>& X,
+                    const std::vector<Eigen::Vector2d>& Y)
+      : SampsonErrorEvaluator(X, Y) {}
+};
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_ESTIMATORS_ESSENTIAL_MATRIX_H_
@@ -37,6 +37,8 @@
 #include <Eigen/Core>
 
 #include "estimators/homography_matrix.h"
+#include "estimators/utils.h"
+#include "optim/residual_evaluator.h"
 #include "util/alignment.h"
 #include "util/types.h"
 
@@ -124,6 +126,26 @@ class FundamentalMatrixEightPointEstimator {
                         std::vector<double>* residuals);
 };
 
+template <>
+class ResidualEvaluator<FundamentalMatrixSevenPointEstimator>
+    : public SampsonErrorEvaluator {
+ public:
+  ResidualEvaluator(FundamentalMatrixSevenPointEstimator*,
+                    const std::vector<Eigen::Vector2d>& X,
+                    const std::vector<Eigen::Vector2d>& Y)
+      : SampsonErrorEvaluator(X, Y) {}
+};
+
+template <>
+class ResidualEvaluator<FundamentalMatrixEightPointEstimator>
+    : public SampsonErrorEvaluator {
+ public:
+  ResidualEvaluator(FundamentalMatrixEightPointEstimator*,
+                    const std::vector<Eigen::Vector2d>& X,
+                    const std::vector<Eigen::Vector2d>& Y)
+      : SampsonErrorEvaluator(X, Y) {}
+};
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_ESTIMATORS_FUNDAMENTAL_MATRIX_H_
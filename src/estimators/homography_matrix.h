@@ -36,6 +36,8 @@
 
 #include <Eigen/Core>
 
+#include "estimators/utils.h"
+#include "optim/residual_evaluator.h"
 #include "util/alignment.h"
 #include "util/types.h"
 
@@ -78,6 +80,16 @@ class HomographyMatrixEstimator {
                         std::vector<double>* residuals);
 };
 
+template <>
+class ResidualEvaluator<HomographyMatrixEstimator>
+    : public TransferErrorEvaluator {
+ public:
+  ResidualEvaluator(HomographyMatrixEstimator*,
+                    const std::vector<Eigen::Vector2d>& X,
+                    const std::vector<Eigen::Vector2d>& Y)
+      : TransferErrorEvaluator(X, Y) {}
+};
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_ESTIMATORS_HOMOGRAPHY_MATRIX_H_
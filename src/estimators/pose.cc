@@ -101,20 +101,34 @@ bool EstimateAbsolutePose(const AbsolutePoseEstimationOptions& options,
     focal_length_factors.push_back(1);
   }
 
-  std::vector<std::future<void>> futures;
-  futures.resize(focal_length_factors.size());
   std::vector<typename AbsolutePoseRANSAC::Report,
               Eigen::aligned_allocator<typename AbsolutePoseRANSAC::Report>>
       reports;
   reports.resize(focal_length_factors.size());
 
-  ThreadPool thread_pool(std::min(
-      options.num_threads, static_cast<int>(focal_length_factors.size())));
+  // Only parallelize over multiple focal length samples, since a thread pool
+  // per registered image is too expensive for a single RANSAC run. The RANSAC
+  // hypotheses themselves only run in parallel, if explicitly requested in
+  // the RANSAC options.
+  if (focal_length_factors.size() == 1) {
+    EstimateAbsolutePoseKernel(*camera, focal_length_factors[0], points2D,
+                               points3D, options.ransac_options, &reports[0]);
+  } else {
+    ThreadPool thread_pool(
+        std::min(GetEffectiveNumThreads(options.num_threads),
+                 static_cast<int>(focal_length_factors.size())));
+
+    std::vector<std::future<void>> futures;
+    futures.resize(focal_length_factors.size());
+    for (size_t i = 0; i < focal_length_factors.size(); ++i) {
+      futures[i] = thread_pool.AddTask(
+          EstimateAbsolutePoseKernel, *camera, focal_length_factors[i],
+          points2D, points3D, options.ransac_options, &reports[i]);
+    }
 
-  for (size_t i = 0; i < focal_length_factors.size(); ++i) {
-    futures[i] = thread_pool.AddTask(
-        EstimateAbsolutePoseKernel, *camera, focal_length_factors[i], points2D,
-        points3D, options.ransac_options, &reports[i]);
+    for (auto& future : futures) {
+      future.get();
+    }
   }
 
   double focal_length_factor = 0;
@@ -124,8 +138,7 @@ bool EstimateAbsolutePose(const AbsolutePoseEstimationOptions& options,
 
   // Find best model among all focal lengths.
   for (size_t i = 0; i < focal_length_factors.size(); ++i) {
-    futures[i].get();
-    const auto report = reports[i];
+    const auto& report = reports[i];
     if (report.success && report.support.num_inliers > *num_inliers) {
       *num_inliers = report.support.num_inliers;
       proj_matrix = report.model;
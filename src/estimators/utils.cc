@@ -34,6 +34,188 @@
 #include "util/logging.h"
 
 namespace colmap {
+namespace {
+
+// Number of points whose residuals are computed at once. The coordinates and
+// intermediate results of a block fit into the L1 cache.
+const size_t kResidualBlockSize = 256;
+
+// The following kernels compute the residuals of up to `kResidualBlockSize`
+// points in structure-of-arrays layout. In contrast to the array-of-structures
+// layout of `std::vector<Eigen::Vector2d>`, the loops over contiguous
+// coordinate arrays are vectorized by the compiler.
+
+void ComputeSquaredSampsonErrorBlock(const double* x1_0, const double* x1_1,
+                                     const double* x2_0, const double* x2_1,
+                                     const size_t num_points,
+                                     const Eigen::Matrix3d& E,
+                                     double* residuals) {
+  const double E_00 = E(0, 0);
+  const double E_01 = E(0, 1);
+  const double E_02 = E(0, 2);
+  const double E_10 = E(1, 0);
+  const double E_11 = E(1, 1);
+  const double E_12 = E(1, 2);
+  const double E_20 = E(2, 0);
+  const double E_21 = E(2, 1);
+  const double E_22 = E(2, 2);
+
+  for (size_t i = 0; i < num_points; ++i) {
+    // Ex1 = E * points1[i].homogeneous();
+    const double Ex1_0 = E_00 * x1_0[i] + E_01 * x1_1[i] + E_02;
+    const double Ex1_1 = E_10 * x1_0[i] + E_11 * x1_1[i] + E_12;
+    const double Ex1_2 = E_20 * x1_0[i] + E_21 * x1_1[i] + E_22;
+
+    // Etx2 = E.transpose() * points2[i].homogeneous();
+    const double Etx2_0 = E_00 * x2_0[i] + E_10 * x2_1[i] + E_20;
+    const double Etx2_1 = E_01 * x2_0[i] + E_11 * x2_1[i] + E_21;
+
+    // x2tEx1 = points2[i].homogeneous().transpose() * Ex1;
+    const double x2tEx1 = x2_0[i] * Ex1_0 + x2_1[i] * Ex1_1 + Ex1_2;
+
+    // Sampson distance
+    residuals[i] =
+        x2tEx1 * x2tEx1 /
+        (Ex1_0 * Ex1_0 + Ex1_1 * Ex1_1 + Etx2_0 * Etx2_0 + Etx2_1 * Etx2_1);
+  }
+}
+
+void ComputeSquaredReprojectionErrorBlock(
+    const double* x_0, const double* x_1, const double* X_0,
+    const double* X_1, const double* X_2, const size_t num_points,
+    const Eigen::Matrix3x4d& proj_matrix, double* residuals) {
+  const double P_00 = proj_matrix(0, 0);
+  const double P_01 = proj_matrix(0, 1);
+  const double P_02 = proj_matrix(0, 2);
+  const double P_03 = proj_matrix(0, 3);
+  const double P_10 = proj_matrix(1, 0);
+  const double P_11 = proj_matrix(1, 1);
+  const double P_12 = proj_matrix(1, 2);
+  const double P_13 = proj_matrix(1, 3);
+  const double P_20 = proj_matrix(2, 0);
+  const double P_21 = proj_matrix(2, 1);
+  const double P_22 = proj_matrix(2, 2);
+  const double P_23 = proj_matrix(2, 3);
+
+  double px_2[kResidualBlockSize];
+
+  for (size_t i = 0; i < num_points; ++i) {
+    // Project 3D point from world to camera.
+    const double px_0 = P_00 * X_0[i] + P_01 * X_1[i] + P_02 * X_2[i] + P_03;
+    const double px_1 = P_10 * X_0[i] + P_11 * X_1[i] + P_12 * X_2[i] + P_13;
+    px_2[i] = P_20 * X_0[i] + P_21 * X_1[i] + P_22 * X_2[i] + P_23;
+
+    const double inv_px_2 = 1.0 / px_2[i];
+    const double dx_0 = x_0[i] - px_0 * inv_px_2;
+    const double dx_1 = x_1[i] - px_1 * inv_px_2;
+
+    residuals[i] = dx_0 * dx_0 + dx_1 * dx_1;
+  }
+
+  // Check if 3D point is in front of camera. This is done in a separate loop,
+  // since the branch prevents the vectorization of the above loop.
+  for (size_t i = 0; i < num_points; ++i) {
+    if (px_2[i] <= std::numeric_limits<double>::epsilon()) {
+      residuals[i] = std::numeric_limits<double>::max();
+    }
+  }
+}
+
+void ComputeSquaredTransferErrorBlock(const double* s_0, const double* s_1,
+                                      const double* d_0, const double* d_1,
+                                      const size_t num_points,
+                                      const Eigen::Matrix3d& H,
+                                      double* residuals) {
+  const double H_00 = H(0, 0);
+  const double H_01 = H(0, 1);
+  const double H_02 = H(0, 2);
+  const double H_10 = H(1, 0);
+  const double H_11 = H(1, 1);
+  const double H_12 = H(1, 2);
+  const double H_20 = H(2, 0);
+  const double H_21 = H(2, 1);
+  const double H_22 = H(2, 2);
+
+  for (size_t i = 0; i < num_points; ++i) {
+    const double pd_0 = H_00 * s_0[i] + H_01 * s_1[i] + H_02;
+    const double pd_1 = H_10 * s_0[i] + H_11 * s_1[i] + H_12;
+    const double pd_2 = H_20 * s_0[i] + H_21 * s_1[i] + H_22;
+
+    const double inv_pd_2 = 1.0 / pd_2;
+    const double dd_0 = d_0[i] - pd_0 * inv_pd_2;
+    const double dd_1 = d_1[i] - pd_1 * inv_pd_2;
+
+    residuals[i] = dd_0 * dd_0 + dd_1 * dd_1;
+  }
+}
+
+// Evaluate a residual kernel for corresponding 2D points, which are either
+// read directly from the columns of the structure-of-arrays containers or
+// transposed block by block into a buffer on the stack.
+template <typename Kernel, typename Model>
+void ComputeResiduals2D2D(const Kernel& kernel,
+                          const std::vector<Eigen::Vector2d>& points1,
+                          const std::vector<Eigen::Vector2d>& points2,
+                          const Model& model, std::vector<double>* residuals) {
+  CHECK_EQ(points1.size(), points2.size());
+
+  const size_t num_points = points1.size();
+  residuals->resize(num_points);
+
+  double x1_0[kResidualBlockSize];
+  double x1_1[kResidualBlockSize];
+  double x2_0[kResidualBlockSize];
+  double x2_1[kResidualBlockSize];
+
+  for (size_t begin = 0; begin < num_points; begin += kResidualBlockSize) {
+    const size_t num_block_points =
+        std::min(kResidualBlockSize, num_points - begin);
+    for (size_t i = 0; i < num_block_points; ++i) {
+      x1_0[i] = points1[begin + i](0);
+      x1_1[i] = points1[begin + i](1);
+      x2_0[i] = points2[begin + i](0);
+      x2_1[i] = points2[begin + i](1);
+    }
+    kernel(x1_0, x1_1, x2_0, x2_1, num_block_points, model,
+           residuals->data() + begin);
+  }
+}
+
+template <typename Kernel, typename Model>
+void ComputeResiduals2D2D(const Kernel& kernel, const Points2DSoA& points1,
+                          const Points2DSoA& points2, const Model& model,
+                          std::vector<double>* residuals) {
+  CHECK_EQ(points1.rows(), points2.rows());
+
+  const size_t num_points = static_cast<size_t>(points1.rows());
+  residuals->resize(num_points);
+
+  for (size_t begin = 0; begin < num_points; begin += kResidualBlockSize) {
+    const size_t num_block_points =
+        std::min(kResidualBlockSize, num_points - begin);
+    kernel(points1.col(0).data() + begin, points1.col(1).data() + begin,
+           points2.col(0).data() + begin, points2.col(1).data() + begin,
+           num_block_points, model, residuals->data() + begin);
+  }
+}
+
+}  // namespace
+
+Points2DSoA ConvertToSoA(const std::vector<Eigen::Vector2d>& points) {
+  Points2DSoA points_soa(points.size(), 2);
+  for (size_t i = 0; i < points.size(); ++i) {
+    points_soa.row(i) = points[i].transpose();
+  }
+  return points_soa;
+}
+
+Points3DSoA ConvertToSoA(const std::vector<Eigen::Vector3d>& points) {
+  Points3DSoA points_soa(points.size(), 3);
+  for (size_t i = 0; i < points.size(); ++i) {
+    points_soa.row(i) = points[i].transpose();
+  }
+  return points_soa;
+}
 
 void CenterAndNormalizeImagePoints(const std::vector<Eigen::Vector2d>& points,
                                    std::vector<Eigen::Vector2d>* normed_points,
@@ -88,97 +270,115 @@ void ComputeSquaredSampsonError(const std::vector<Eigen::Vector2d>& points1,
                                 const std::vector<Eigen::Vector2d>& points2,
                                 const Eigen::Matrix3d& E,
                                 std::vector<double>* residuals) {
-  CHECK_EQ(points1.size(), points2.size());
+  ComputeResiduals2D2D(ComputeSquaredSampsonErrorBlock, points1, points2, E,
+                       residuals);
+}
 
-  residuals->resize(points1.size());
+void ComputeSquaredSampsonError(const Points2DSoA& points1,
+                                const Points2DSoA& points2,
+                                const Eigen::Matrix3d& E,
+                                std::vector<double>* residuals) {
+  ComputeResiduals2D2D(ComputeSquaredSampsonErrorBlock, points1, points2, E,
+                       residuals);
+}
 
-  // Note that this code might not be as nice as Eigen expressions,
-  // but it is significantly faster in various tests
+void ComputeSquaredReprojectionError(
+    const std::vector<Eigen::Vector2d>& points2D,
+    const std::vector<Eigen::Vector3d>& points3D,
+    const Eigen::Matrix3x4d& proj_matrix, std::vector<double>* residuals) {
+  CHECK_EQ(points2D.size(), points3D.size());
 
-  const double E_00 = E(0, 0);
-  const double E_01 = E(0, 1);
-  const double E_02 = E(0, 2);
-  const double E_10 = E(1, 0);
-  const double E_11 = E(1, 1);
-  const double E_12 = E(1, 2);
-  const double E_20 = E(2, 0);
-  const double E_21 = E(2, 1);
-  const double E_22 = E(2, 2);
+  const size_t num_points = points2D.size();
+  residuals->resize(num_points);
 
-  for (size_t i = 0; i < points1.size(); ++i) {
-    const double x1_0 = points1[i](0);
-    const double x1_1 = points1[i](1);
-    const double x2_0 = points2[i](0);
-    const double x2_1 = points2[i](1);
+  double x_0[kResidualBlockSize];
+  double x_1[kResidualBlockSize];
+  double X_0[kResidualBlockSize];
+  double X_1[kResidualBlockSize];
+  double X_2[kResidualBlockSize];
 
-    // Ex1 = E * points1[i].homogeneous();
-    const double Ex1_0 = E_00 * x1_0 + E_01 * x1_1 + E_02;
-    const double Ex1_1 = E_10 * x1_0 + E_11 * x1_1 + E_12;
-    const double Ex1_2 = E_20 * x1_0 + E_21 * x1_1 + E_22;
+  for (size_t begin = 0; begin < num_points; begin += kResidualBlockSize) {
+    const size_t num_block_points =
+        std::min(kResidualBlockSize, num_points - begin);
+    for (size_t i = 0; i < num_block_points; ++i) {
+      x_0[i] = points2D[begin + i](0);
+      x_1[i] = points2D[begin + i](1);
+      X_0[i] = points3D[begin + i](0);
+      X_1[i] = points3D[begin + i](1);
+      X_2[i] = points3D[begin + i](2);
+    }
+    ComputeSquaredReprojectionErrorBlock(x_0, x_1, X_0, X_1, X_2,
+                                         num_block_points, proj_matrix,
+                                         residuals->data() + begin);
+  }
+}
 
-    // Etx2 = E.transpose() * points2[i].homogeneous();
-    const double Etx2_0 = E_00 * x2_0 + E_10 * x2_1 + E_20;
-    const double Etx2_1 = E_01 * x2_0 + E_11 * x2_1 + E_21;
+void ComputeSquaredReprojectionError(const Points2DSoA& points2D,
+                                     const Points3DSoA& points3D,
+                                     const Eigen::Matrix3x4d& proj_matrix,
+                                     std::vector<double>* residuals) {
+  CHECK_EQ(points2D.rows(), points3D.rows());
 
-    // x2tEx1 = points2[i].homogeneous().transpose() * Ex1;
-    const double x2tEx1 = x2_0 * Ex1_0 + x2_1 * Ex1_1 + Ex1_2;
+  const size_t num_points = static_cast<size_t>(points2D.rows());
+  residuals->resize(num_points);
 
-    // Sampson distance
-    (*residuals)[i] =
-        x2tEx1 * x2tEx1 /
-        (Ex1_0 * Ex1_0 + Ex1_1 * Ex1_1 + Etx2_0 * Etx2_0 + Etx2_1 * Etx2_1);
+  for (size_t begin = 0; begin < num_points; begin += kResidualBlockSize) {
+    const size_t num_block_points =
+        std::min(kResidualBlockSize, num_points - begin);
+    ComputeSquaredReprojectionErrorBlock(
+        points2D.col(0).data() + begin, points2D.col(1).data() + begin,
+        points3D.col(0).data() + begin, points3D.col(1).data() + begin,
+        points3D.col(2).data() + begin, num_block_points, proj_matrix,
+        residuals->data() + begin);
   }
 }
 
-void ComputeSquaredReprojectionError(
-    const std::vector<Eigen::Vector2d>& points2D,
-    const std::vector<Eigen::Vector3d>& points3D,
-    const Eigen::Matrix3x4d& proj_matrix, std::vector<double>* residuals) {
-  CHECK_EQ(points2D.size(), points3D.size());
-
-  residuals->resize(points2D.size());
-
-  // Note that this code might not be as nice as Eigen expressions,
-  // but it is significantly faster in various tests.
+void ComputeSquaredTransferError(const std::vector<Eigen::Vector2d>& points1,
+                                 const std::vector<Eigen::Vector2d>& points2,
+                                 const Eigen::Matrix3d& H,
+                                 std::vector<double>* residuals) {
+  ComputeResiduals2D2D(ComputeSquaredTransferErrorBlock, points1, points2, H,
+                       residuals);
+}
 
-  const double P_00 = proj_matrix(0, 0);
-  const double P_01 = proj_matrix(0, 1);
-  const double P_02 = proj_matrix(0, 2);
-  const double P_03 = proj_matrix(0, 3);
-  const double P_10 = proj_matrix(1, 0);
-  const double P_11 = proj_matrix(1, 1);
-  const double P_12 = proj_matrix(1, 2);
-  const double P_13 = proj_matrix(1, 3);
-  const double P_20 = proj_matrix(2, 0);
-  const double P_21 = proj_matrix(2, 1);
-  const double P_22 = proj_matrix(2, 2);
-  const double P_23 = proj_matrix(2, 3);
+void ComputeSquaredTransferError(const Points2DSoA& points1,
+                                 const Points2DSoA& points2,
+                                 const Eigen::Matrix3d& H,
+                                 std::vector<double>* residuals) {
+  ComputeResiduals2D2D(ComputeSquaredTransferErrorBlock, points1, points2, H,
+                       residuals);
+}
 
-  for (size_t i = 0; i < points2D.size(); ++i) {
-    const double X_0 = points3D[i](0);
-    const double X_1 = points3D[i](1);
-    const double X_2 = points3D[i](2);
+SampsonErrorEvaluator::SampsonErrorEvaluator(
+    const std::vector<Eigen::Vector2d>& points1,
+    const std::vector<Eigen::Vector2d>& points2)
+    : points1_(ConvertToSoA(points1)), points2_(ConvertToSoA(points2)) {}
 
-    // Project 3D point from world to camera.
-    const double px_2 = P_20 * X_0 + P_21 * X_1 + P_22 * X_2 + P_23;
+void SampsonErrorEvaluator::Residuals(const Eigen::Matrix3d& E,
+                                      std::vector<double>* residuals) const {
+  ComputeSquaredSampsonError(points1_, points2_, E, residuals);
+}
 
-    // Check if 3D point is in front of camera.
-    if (px_2 > std::numeric_limits<double>::epsilon()) {
-      const double px_0 = P_00 * X_0 + P_01 * X_1 + P_02 * X_2 + P_03;
-      const double px_1 = P_10 * X_0 + P_11 * X_1 + P_12 * X_2 + P_13;
+ReprojectionErrorEvaluator::ReprojectionErrorEvaluator(
+    const std::vector<Eigen::Vector2d>& points2D,
+    const std::vector<Eigen::Vector3d>& points3D)
+    : points2D_(ConvertToSoA(points2D)), points3D_(ConvertToSoA(points3D)) {}
 
-      const double x_0 = points2D[i](0);
-      const double x_1 = points2D[i](1);
+void ReprojectionErrorEvaluator::Residuals(
+    const Eigen::Matrix3x4d& proj_matrix,
+    std::vector<double>* residuals) const {
+  ComputeSquaredReprojectionError(points2D_, points3D_, proj_matrix,
+                                  residuals);
+}
 
-      const double inv_px_2 = 1.0 / px_2;
-      const double dx_0 = x_0 - px_0 * inv_px_2;
-      const double dx_1 = x_1 - px_1 * inv_px_2;
+TransferErrorEvaluator::TransferErrorEvaluator(
+    const std::vector<Eigen::Vector2d>& points1,
+    const std::vector<Eigen::Vector2d>& points2)
+    : points1_(ConvertToSoA(points1)), points2_(ConvertToSoA(points2)) {}
 
-      (*residuals)[i] = dx_0 * dx_0 + dx_1 * dx_1;
-    } else {
-      (*residuals)[i] = std::numeric_limits<double>::max();
-    }
-  }
+void TransferErrorEvaluator::Residuals(const Eigen::Matrix3d& H,
+                                       std::vector<double>* residuals) const {
+  ComputeSquaredTransferError(points1_, points2_, H, residuals);
 }
 
 }  // namespace colmap
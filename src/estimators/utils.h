@@ -41,6 +41,17 @@
 
 namespace colmap {
 
+// Points in structure-of-arrays layout, where each column stores one
+// coordinate of all points contiguously in memory. In contrast to
+// `std::vector<Eigen::Vector2d>`, this layout allows to evaluate the residuals
+// of many points with vectorized instructions.
+typedef Eigen::Matrix<double, Eigen::Dynamic, 2> Points2DSoA;
+typedef Eigen::Matrix<double, Eigen::Dynamic, 3> Points3DSoA;
+
+// Convert points from array-of-structures to structure-of-arrays layout.
+Points2DSoA ConvertToSoA(const std::vector<Eigen::Vector2d>& points);
+Points3DSoA ConvertToSoA(const std::vector<Eigen::Vector3d>& points);
+
 // Center and normalize image points.
 //
 // The points are transformed in a two-step procedure that is expressed
@@ -73,6 +84,10 @@ void ComputeSquaredSampsonError(const std::vector<Eigen::Vector2d>& points1,
                                 const std::vector<Eigen::Vector2d>& points2,
                                 const Eigen::Matrix3d& E,
                                 std::vector<double>* residuals);
+void ComputeSquaredSampsonError(const Points2DSoA& points1,
+                                const Points2DSoA& points2,
+                                const Eigen::Matrix3d& E,
+                                std::vector<double>* residuals);
 
 // Calculate the squared reprojection error given a set of 2D-3D point
 // correspondences and a projection matrix. Returns DBL_MAX if a 3D point is
@@ -86,6 +101,70 @@ void ComputeSquaredReprojectionError(
     const std::vector<Eigen::Vector2d>& points2D,
     const std::vector<Eigen::Vector3d>& points3D,
     const Eigen::Matrix3x4d& proj_matrix, std::vector<double>* residuals);
+void ComputeSquaredReprojectionError(const Points2DSoA& points2D,
+                                     const Points3DSoA& points3D,
+                                     const Eigen::Matrix3x4d& proj_matrix,
+                                     std::vector<double>* residuals);
+
+// Calculate the squared transfer error of a set of corresponding points and
+// a given homography, i.e. the squared distance between the second points and
+// the first points transformed by the homography.
+//
+// @param points1     First set of corresponding points.
+// @param points2     Second set of corresponding points.
+// @param H           3x3 projective transformation matrix.
+// @param residuals   Output vector of residuals.
+void ComputeSquaredTransferError(const std::vector<Eigen::Vector2d>& points1,
+                                 const std::vector<Eigen::Vector2d>& points2,
+                                 const Eigen::Matrix3d& H,
+                                 std::vector<double>* residuals);
+void ComputeSquaredTransferError(const Points2DSoA& points1,
+                                 const Points2DSoA& points2,
+                                 const Eigen::Matrix3d& H,
+                                 std::vector<double>* residuals);
+
+// Residual evaluators for RANSAC, which convert the samples once to the
+// structure-of-arrays layout and then evaluate the vectorized residual kernels
+// for each model. See `ResidualEvaluator` for details.
+
+class SampsonErrorEvaluator {
+ public:
+  SampsonErrorEvaluator(const std::vector<Eigen::Vector2d>& points1,
+                        const std::vector<Eigen::Vector2d>& points2);
+
+  void Residuals(const Eigen::Matrix3d& E,
+                 std::vector<double>* residuals) const;
+
+ private:
+  const Points2DSoA points1_;
+  const Points2DSoA points2_;
+};
+
+class ReprojectionErrorEvaluator {
+ public:
+  ReprojectionErrorEvaluator(const std::vector<Eigen::Vector2d>& points2D,
+                             const std::vector<Eigen::Vector3d>& points3D);
+
+  void Residuals(const Eigen::Matrix3x4d& proj_matrix,
+                 std::vector<double>* residuals) const;
+
+ private:
+  const Points2DSoA points2D_;
+  const Points3DSoA points3D_;
+};
+
+class TransferErrorEvaluator {
+ public:
+  TransferErrorEvaluator(const std::vector<Eigen::Vector2d>& points1,
+                         const std::vector<Eigen::Vector2d>& points2);
+
+  void Residuals(const Eigen::Matrix3d& H,
+                 std::vector<double>* residuals) const;
+
+ private:
+  const Points2DSoA points1_;
+  const Points2DSoA points2_;
+};
 
 }  // namespace colmap
 
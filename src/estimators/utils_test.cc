@@ -34,6 +34,7 @@
 
 #include "base/essential_matrix.h"
 #include "estimators/utils.h"
+#include "util/random.h"
 
 using namespace colmap;
 
@@ -81,3 +82,137 @@ BOOST_AUTO_TEST_CASE(TestComputeSquaredSampsonError) {
   BOOST_CHECK_EQUAL(residuals[1], 0.5);
   BOOST_CHECK_EQUAL(residuals[2], 2);
 }
+
+BOOST_AUTO_TEST_CASE(TestConvertToSoA) {
+  std::vector<Eigen::Vector2d> points2D;
+  std::vector<Eigen::Vector3d> points3D;
+  for (size_t i = 0; i < 5; ++i) {
+    points2D.emplace_back(i, 2 * i);
+    points3D.emplace_back(i, 2 * i, 3 * i);
+  }
+
+  const Points2DSoA points2D_soa = ConvertToSoA(points2D);
+  const Points3DSoA points3D_soa = ConvertToSoA(points3D);
+  BOOST_CHECK_EQUAL(points2D_soa.rows(), 5);
+  BOOST_CHECK_EQUAL(points3D_soa.rows(), 5);
+  for (size_t i = 0; i < 5; ++i) {
+    BOOST_CHECK_EQUAL(points2D_soa.row(i).transpose(), points2D[i]);
+    BOOST_CHECK_EQUAL(points3D_soa.row(i).transpose(), points3D[i]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestComputeSquaredReprojectionError) {
+  std::vector<Eigen::Vector2d> points2D;
+  points2D.emplace_back(0, 0);
+  points2D.emplace_back(1, 0);
+  points2D.emplace_back(0, 0);
+  std::vector<Eigen::Vector3d> points3D;
+  points3D.emplace_back(0, 0, 1);
+  points3D.emplace_back(2, 0, 2);
+  points3D.emplace_back(0, 0, -1);
+
+  const Eigen::Matrix3x4d proj_matrix = Eigen::Matrix3x4d::Identity();
+
+  std::vector<double> residuals;
+  ComputeSquaredReprojectionError(points2D, points3D, proj_matrix, &residuals);
+
+  BOOST_CHECK_EQUAL(residuals.size(), 3);
+  BOOST_CHECK_EQUAL(residuals[0], 0);
+  BOOST_CHECK_EQUAL(residuals[1], 0);
+  BOOST_CHECK_EQUAL(residuals[2], std::numeric_limits<double>::max());
+}
+
+BOOST_AUTO_TEST_CASE(TestComputeSquaredTransferError) {
+  std::vector<Eigen::Vector2d> points1;
+  points1.emplace_back(0, 0);
+  points1.emplace_back(1, 2);
+  std::vector<Eigen::Vector2d> points2;
+  points2.emplace_back(1, 0);
+  points2.emplace_back(2, 4);
+
+  Eigen::Matrix3d H = Eigen::Matrix3d::Identity();
+  H(0, 2) = 1;
+
+  std::vector<double> residuals;
+  ComputeSquaredTransferError(points1, points2, H, &residuals);
+
+  BOOST_CHECK_EQUAL(residuals.size(), 2);
+  BOOST_CHECK_EQUAL(residuals[0], 0);
+  BOOST_CHECK_EQUAL(residuals[1], 4);
+}
+
+BOOST_AUTO_TEST_CASE(TestResidualsSoA) {
+  SetPRNGSeed(0);
+
+  // Cover multiple full blocks and a partial block.
+  const size_t kNumPoints = 1000;
+
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+  std::vector<Eigen::Vector3d> points3D;
+  for (size_t i = 0; i < kNumPoints; ++i) {
+    points1.emplace_back(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0));
+    points2.emplace_back(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0));
+    points3D.emplace_back(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0),
+                          RandomReal(-1.0, 5.0));
+  }
+
+  const Points2DSoA points1_soa = ConvertToSoA(points1);
+  const Points2DSoA points2_soa = ConvertToSoA(points2);
+  const Points3DSoA points3D_soa = ConvertToSoA(points3D);
+
+  const Eigen::Matrix3d E = EssentialMatrixFromPose(
+      Eigen::Matrix3d::Identity(), Eigen::Vector3d(1, 0.1, 0.2).normalized());
+  Eigen::Matrix3d H = Eigen::Matrix3d::Identity();
+  H(2, 0) = 0.01;
+  H(0, 2) = 0.1;
+  Eigen::Matrix3x4d proj_matrix = Eigen::Matrix3x4d::Identity();
+  proj_matrix(0, 3) = 0.1;
+
+  std::vector<double> residuals;
+  std::vector<double> residuals_soa;
+
+  ComputeSquaredSampsonError(points1, points2, E, &residuals);
+  ComputeSquaredSampsonError(points1_soa, points2_soa, E, &residuals_soa);
+  BOOST_CHECK_EQUAL(residuals.size(), kNumPoints);
+  BOOST_CHECK_EQUAL(residuals_soa.size(), kNumPoints);
+  for (size_t i = 0; i < kNumPoints; ++i) {
+    const Eigen::Vector3d Ex1 = E * points1[i].homogeneous();
+    const Eigen::Vector3d Etx2 = E.transpose() * points2[i].homogeneous();
+    const double x2tEx1 = points2[i].homogeneous().dot(Ex1);
+    const double residual = x2tEx1 * x2tEx1 / (Ex1.head<2>().squaredNorm() +
+                                               Etx2.head<2>().squaredNorm());
+    BOOST_CHECK_CLOSE(residuals[i], residual, 1e-6);
+    BOOST_CHECK_EQUAL(residuals[i], residuals_soa[i]);
+  }
+
+  ComputeSquaredReprojectionError(points1, points3D, proj_matrix, &residuals);
+  ComputeSquaredReprojectionError(points1_soa, points3D_soa, proj_matrix,
+                                  &residuals_soa);
+  BOOST_CHECK_EQUAL(residuals.size(), kNumPoints);
+  BOOST_CHECK_EQUAL(residuals_soa.size(), kNumPoints);
+  for (size_t i = 0; i < kNumPoints; ++i) {
+    const Eigen::Vector3d proj_point3D =
+        proj_matrix * points3D[i].homogeneous();
+    if (proj_point3D.z() > std::numeric_limits<double>::epsilon()) {
+      const double residual =
+          (points1[i] - proj_point3D.hnormalized()).squaredNorm();
+      BOOST_CHECK_CLOSE(residuals[i], residual, 1e-6);
+    } else {
+      BOOST_CHECK_EQUAL(residuals[i], std::numeric_limits<double>::max());
+    }
+    BOOST_CHECK_EQUAL(residuals[i], residuals_soa[i]);
+  }
+
+  ComputeSquaredTransferError(points1, points2, H, &residuals);
+  ComputeSquaredTransferError(points1_soa, points2_soa, H, &residuals_soa);
+  BOOST_CHECK_EQUAL(residuals.size(), kNumPoints);
+  BOOST_CHECK_EQUAL(residuals_soa.size(), kNumPoints);
+  for (size_t i = 0; i < kNumPoints; ++i) {
+    const double residual =
+        (points2[i] - (H * points1[i].homogeneous()).hnormalized())
+            .squaredNorm();
+    BOOST_CHECK_CLOSE(residuals[i], residual, 1e-6);
+    BOOST_CHECK_EQUAL(residuals[i], residuals_soa[i]);
+  }
+}
@@ -392,12 +392,6 @@ int RunDelaunayMesher(int argc, char** argv) {
 }
 
 int RunPatchMatchStereo(int argc, char** argv) {
-#ifndef CUDA_ENABLED
-  std::cerr << "ERROR: Dense stereo reconstruction requires CUDA, which is not "
-               "available on your system."
-            << std::endl;
-  return EXIT_FAILURE;
-#else   // CUDA_ENABLED
   std::string workspace_path;
   std::string workspace_format = "COLMAP";
   std::string pmvs_option_name = "option-all";
@@ -428,7 +422,6 @@ int RunPatchMatchStereo(int argc, char** argv) {
   controller.Wait();
 
   return EXIT_SUCCESS;
-#endif  // CUDA_ENABLED
 }
 
 int RunExhaustiveMatcher(int argc, char** argv) {
@@ -557,6 +550,72 @@ int RunFeatureImporter(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunFeatureStoreExporter(int argc, char** argv) {
+  std::string feature_store_path;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddDefaultOption("feature_store_path", &feature_store_path);
+  options.Parse(argc, argv);
+
+  // By default, write the feature store next to the database, so that it is
+  // used and kept up-to-date whenever the database is opened.
+  if (feature_store_path.empty()) {
+    feature_store_path = GetFeatureStorePath(*options.database_path);
+  }
+
+  // Remove an existing feature store of the database, which might be stale,
+  // such that the features are exported from the SQLite tables.
+  if (feature_store_path == GetFeatureStorePath(*options.database_path) &&
+      ExistsFile(feature_store_path)) {
+    std::cout << "Replacing existing feature store" << std::endl;
+    boost::filesystem::remove(feature_store_path);
+  }
+
+  Database database(*options.database_path);
+
+  PrintHeading1("Exporting feature store");
+
+  Timer timer;
+  timer.Start();
+
+  ExportFeatureStore(database, feature_store_path);
+
+  std::cout << StringPrintf("Exported features of %d images in %.3fs",
+                            static_cast<int>(database.NumImages()),
+                            timer.ElapsedSeconds())
+            << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
+int RunFeatureStoreImporter(int argc, char** argv) {
+  std::string feature_store_path;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddRequiredOption("feature_store_path", &feature_store_path);
+  options.Parse(argc, argv);
+
+  if (!ExistsFile(feature_store_path)) {
+    std::cout << "ERROR: Feature store file does not exist." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Database database(*options.database_path);
+
+  PrintHeading1("Importing feature store");
+
+  const size_t num_imported_images =
+      ImportFeatureStore(feature_store_path, &database);
+
+  std::cout << StringPrintf("Imported features of %d images",
+                            static_cast<int>(num_imported_images))
+            << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
 // Read stereo image pair names from a text file. The text file is expected to
 // have one image pair per line, e.g.:
 //
@@ -844,6 +903,10 @@ int RunImageUndistorter(int argc, char** argv) {
   options.AddDefaultOption("roi_min_y", &undistort_camera_options.roi_min_y);
   options.AddDefaultOption("roi_max_x", &undistort_camera_options.roi_max_x);
   options.AddDefaultOption("roi_max_y", &undistort_camera_options.roi_max_y);
+  options.AddDefaultOption("warp_map_cache_size",
+                           &undistort_camera_options.warp_map_cache_size);
+  options.AddDefaultOption("warp_map_cache_path",
+                           &undistort_camera_options.warp_map_cache_path);
   options.Parse(argc, argv);
 
   CreateDirIfNotExists(output_path);
@@ -897,6 +960,10 @@ int RunImageUndistorterStandalone(int argc, char** argv) {
   options.AddDefaultOption("roi_min_y", &undistort_camera_options.roi_min_y);
   options.AddDefaultOption("roi_max_x", &undistort_camera_options.roi_max_x);
   options.AddDefaultOption("roi_max_y", &undistort_camera_options.roi_max_y);
+  options.AddDefaultOption("warp_map_cache_size",
+                           &undistort_camera_options.warp_map_cache_size);
+  options.AddDefaultOption("warp_map_cache_path",
+                           &undistort_camera_options.warp_map_cache_path);
   options.Parse(argc, argv);
 
   CreateDirIfNotExists(output_path);
@@ -1038,9 +1105,25 @@ int RunMapper(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+void SetPartitionType(const std::string& partition_type,
+                      SceneClustering::Options* clustering_options) {
+  std::string partition_type_lower = partition_type;
+  StringToLower(&partition_type_lower);
+  if (partition_type_lower == "normalized_cut") {
+    clustering_options->partition_type =
+        SceneClustering::Options::PartitionType::NORMALIZED_CUT;
+  } else if (partition_type_lower == "multilevel") {
+    clustering_options->partition_type =
+        SceneClustering::Options::PartitionType::MULTILEVEL;
+  } else {
+    LOG(FATAL) << "Invalid partition type provided";
+  }
+}
+
 int RunHierarchicalMapper(int argc, char** argv) {
   HierarchicalMapperController::Options hierarchical_options;
   SceneClustering::Options clustering_options;
+  std::string partition_type = "normalized_cut";
   std::string output_path;
 
   OptionManager options;
@@ -1049,12 +1132,16 @@ int RunHierarchicalMapper(int argc, char** argv) {
   options.AddRequiredOption("image_path", &hierarchical_options.image_path);
   options.AddRequiredOption("output_path", &output_path);
   options.AddDefaultOption("num_workers", &hierarchical_options.num_workers);
+  options.AddDefaultOption("partition_type", &partition_type,
+                           "{normalized_cut, multilevel}");
   options.AddDefaultOption("image_overlap", &clustering_options.image_overlap);
   options.AddDefaultOption("leaf_max_num_images",
                            &clustering_options.leaf_max_num_images);
   options.AddMapperOptions();
   options.Parse(argc, argv);
 
+  SetPartitionType(partition_type, &clustering_options);
+
   if (!ExistsDir(output_path)) {
     std::cerr << "ERROR: `output_path` is not a directory." << std::endl;
     return EXIT_FAILURE;
@@ -1073,6 +1160,97 @@ int RunHierarchicalMapper(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunHierarchicalMapperExporter(int argc, char** argv) {
+  HierarchicalMapperController::Options hierarchical_options;
+  SceneClustering::Options clustering_options;
+  std::string partition_type = "normalized_cut";
+  std::string queue_path;
+
+  OptionManager options;
+  options.AddRequiredOption("database_path",
+                            &hierarchical_options.database_path);
+  options.AddRequiredOption("image_path", &hierarchical_options.image_path);
+  options.AddRequiredOption("queue_path", &queue_path);
+  options.AddDefaultOption("partition_type", &partition_type,
+                           "{normalized_cut, multilevel}");
+  options.AddDefaultOption("image_overlap", &clustering_options.image_overlap);
+  options.AddDefaultOption("leaf_max_num_images",
+                           &clustering_options.leaf_max_num_images);
+  options.AddMapperOptions();
+  options.Parse(argc, argv);
+
+  SetPartitionType(partition_type, &clustering_options);
+
+  if (ExistsDir(queue_path) && !GetDirList(queue_path).empty()) {
+    std::cerr << "ERROR: `queue_path` is not empty." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const size_t num_jobs = ExportHierarchicalMapperJobs(
+      hierarchical_options, clustering_options, *options.mapper, queue_path);
+
+  std::cout << StringPrintf("Exported %d jobs", static_cast<int>(num_jobs))
+            << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
+int RunHierarchicalMapperWorker(int argc, char** argv) {
+  std::string queue_path;
+  double lease_timeout = 600;
+  bool requeue_failed = false;
+
+  OptionManager options;
+  options.AddRequiredOption("queue_path", &queue_path);
+  options.AddDefaultOption("lease_timeout", &lease_timeout);
+  options.AddDefaultOption("requeue_failed", &requeue_failed);
+  options.Parse(argc, argv);
+
+  if (!ExistsDir(queue_path)) {
+    std::cerr << "ERROR: `queue_path` is not a directory." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const size_t num_jobs = ReconstructHierarchicalMapperJobs(
+      queue_path, lease_timeout, requeue_failed);
+
+  std::cout << std::endl;
+  std::cout << StringPrintf("Reconstructed %d jobs",
+                            static_cast<int>(num_jobs))
+            << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
+int RunHierarchicalMapperMerger(int argc, char** argv) {
+  std::string queue_path;
+  std::string output_path;
+
+  OptionManager options;
+  options.AddRequiredOption("queue_path", &queue_path);
+  options.AddRequiredOption("output_path", &output_path);
+  options.Parse(argc, argv);
+
+  if (!ExistsDir(queue_path)) {
+    std::cerr << "ERROR: `queue_path` is not a directory." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (!ExistsDir(output_path)) {
+    std::cerr << "ERROR: `output_path` is not a directory." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ReconstructionManager reconstruction_manager;
+  if (!MergeHierarchicalMapperJobs(queue_path, &reconstruction_manager)) {
+    return EXIT_FAILURE;
+  }
+
+  reconstruction_manager.Write(output_path, nullptr);
+
+  return EXIT_SUCCESS;
+}
+
 int RunMatchesImporter(int argc, char** argv) {
   std::string match_list_path;
   std::string match_type = "pairs";
@@ -1240,7 +1418,7 @@ int RunModelConverter(int argc, char** argv) {
   options.AddRequiredOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
   options.AddRequiredOption("output_type", &output_type,
-                            "{BIN, TXT, NVM, Bundler, VRML, PLY}");
+                            "{BIN, TXT, STORE, NVM, Bundler, VRML, PLY}");
   options.Parse(argc, argv);
 
   Reconstruction reconstruction;
@@ -1251,6 +1429,8 @@ int RunModelConverter(int argc, char** argv) {
     reconstruction.WriteBinary(output_path);
   } else if (output_type == "txt") {
     reconstruction.WriteText(output_path);
+  } else if (output_type == "store") {
+    reconstruction.WriteStore(output_path);
   } else if (output_type == "nvm") {
     reconstruction.ExportNVM(output_path);
   } else if (output_type == "bundler") {
@@ -2121,7 +2301,15 @@ int main(int argc, char** argv) {
   commands.emplace_back("exhaustive_matcher", &RunExhaustiveMatcher);
   commands.emplace_back("feature_extractor", &RunFeatureExtractor);
   commands.emplace_back("feature_importer", &RunFeatureImporter);
+  commands.emplace_back("feature_store_exporter", &RunFeatureStoreExporter);
+  commands.emplace_back("feature_store_importer", &RunFeatureStoreImporter);
   commands.emplace_back("hierarchical_mapper", &RunHierarchicalMapper);
+  commands.emplace_back("hierarchical_mapper_exporter",
+                        &RunHierarchicalMapperExporter);
+  commands.emplace_back("hierarchical_mapper_merger",
+                        &RunHierarchicalMapperMerger);
+  commands.emplace_back("hierarchical_mapper_worker",
+                        &RunHierarchicalMapperWorker);
   commands.emplace_back("image_deleter", &RunImageDeleter);
   commands.emplace_back("image_filterer", &RunImageFilterer);
   commands.emplace_back("image_rectifier", &RunImageRectifier);
@@ -31,6 +31,7 @@
 
 #include "feature/extraction.h"
 
+#include <map>
 #include <numeric>
 
 #include "SiftGPU/SiftGPU.h"
@@ -113,11 +114,16 @@ SiftFeatureExtractor::SiftFeatureExtractor(
   extractor_queue_.reset(new JobQueue<internal::ImageData>(kQueueSize));
   writer_queue_.reset(new JobQueue<internal::ImageData>(kQueueSize));
 
+  reader_stats_.reset(new internal::ExtractionStageStats("Reader", 1));
+  writer_stats_.reset(new internal::ExtractionStageStats("Writer", 1));
+
   if (sift_options_.max_image_size > 0) {
+    resizer_stats_.reset(
+        new internal::ExtractionStageStats("Resizer", num_threads));
     for (int i = 0; i < num_threads; ++i) {
       resizers_.emplace_back(new internal::ImageResizerThread(
           sift_options_.max_image_size, resizer_queue_.get(),
-          extractor_queue_.get()));
+          extractor_queue_.get(), resizer_stats_.get()));
     }
   }
 
@@ -135,25 +141,34 @@ SiftFeatureExtractor::SiftFeatureExtractor(
     }
 #endif  // CUDA_ENABLED
 
+    extractor_stats_.reset(new internal::ExtractionStageStats(
+        "Extractor", static_cast<int>(gpu_indices.size())));
+
     auto sift_gpu_options = sift_options_;
     for (const auto& gpu_index : gpu_indices) {
       sift_gpu_options.gpu_index = std::to_string(gpu_index);
       extractors_.emplace_back(new internal::SiftFeatureExtractorThread(
           sift_gpu_options, camera_mask, extractor_queue_.get(),
-          writer_queue_.get()));
+          writer_queue_.get(), extractor_stats_.get()));
     }
   } else {
+    extractor_stats_.reset(
+        new internal::ExtractionStageStats("Extractor", num_threads));
+
     auto custom_sift_options = sift_options_;
     custom_sift_options.use_gpu = false;
+    // The tile memory limit applies to all extraction threads together.
+    custom_sift_options.max_tile_memory /= num_threads;
     for (int i = 0; i < num_threads; ++i) {
       extractors_.emplace_back(new internal::SiftFeatureExtractorThread(
           custom_sift_options, camera_mask, extractor_queue_.get(),
-          writer_queue_.get()));
+          writer_queue_.get(), extractor_stats_.get()));
     }
   }
 
   writer_.reset(new internal::FeatureWriterThread(
-      image_reader_.NumImages(), &database_, writer_queue_.get()));
+      image_reader_.NumImages(), &database_, writer_queue_.get(),
+      writer_stats_.get()));
 }
 
 void SiftFeatureExtractor::Run() {
@@ -184,11 +199,19 @@ void SiftFeatureExtractor::Run() {
       break;
     }
 
+    const size_t queue_size = image_reader_.NumPrefetchedImages();
+
+    Timer timer;
+    timer.Start();
+
     internal::ImageData image_data;
+    image_data.index = image_reader_.NextIndex();
     image_data.status =
         image_reader_.Next(&image_data.camera, &image_data.image,
                            &image_data.bitmap, &image_data.mask);
 
+    reader_stats_->Add(timer.ElapsedSeconds(), queue_size);
+
     if (image_data.status != ImageReader::Status::SUCCESS) {
       image_data.bitmap.Deallocate();
     }
@@ -216,6 +239,19 @@ void SiftFeatureExtractor::Run() {
   writer_queue_->Stop();
   writer_->Wait();
 
+  const double elapsed_seconds = GetTimer().ElapsedSeconds();
+  std::cout << std::endl << "Pipeline statistics:" << std::endl;
+  std::cout << "  Stage      Threads  Images  Busy [s]  Utilization  "
+               "Queue (mean/max)"
+            << std::endl;
+  reader_stats_->Print(elapsed_seconds);
+  if (resizer_stats_) {
+    resizer_stats_->Print(elapsed_seconds);
+  }
+  extractor_stats_->Print(elapsed_seconds);
+  writer_stats_->Print(elapsed_seconds);
+  std::cout << std::endl;
+
   GetTimer().PrintMinutes();
 }
 
@@ -285,10 +321,45 @@ void FeatureImporter::Run() {
 
 namespace internal {
 
+ExtractionStageStats::ExtractionStageStats(const std::string& name,
+                                           const int num_threads)
+    : name_(name),
+      num_threads_(num_threads),
+      num_images_(0),
+      busy_seconds_(0),
+      queue_size_sum_(0),
+      max_queue_size_(0) {}
+
+void ExtractionStageStats::Add(const double busy_seconds,
+                               const size_t queue_size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  num_images_ += 1;
+  busy_seconds_ += busy_seconds;
+  queue_size_sum_ += queue_size;
+  max_queue_size_ = std::max(max_queue_size_, queue_size);
+}
+
+void ExtractionStageStats::Print(const double elapsed_seconds) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const double utilization =
+      elapsed_seconds > 0 ? busy_seconds_ / (elapsed_seconds * num_threads_)
+                          : 0;
+  const double mean_queue_size =
+      num_images_ > 0 ? static_cast<double>(queue_size_sum_) / num_images_ : 0;
+  std::cout << StringPrintf("  %-10s %7d %7d %9.2f %11.1f%% %9.2f/%d",
+                            name_.c_str(), num_threads_,
+                            static_cast<int>(num_images_), busy_seconds_,
+                            100 * utilization, mean_queue_size,
+                            static_cast<int>(max_queue_size_))
+            << std::endl;
+}
+
 ImageResizerThread::ImageResizerThread(const int max_image_size,
                                        JobQueue<ImageData>* input_queue,
-                                       JobQueue<ImageData>* output_queue)
+                                       JobQueue<ImageData>* output_queue,
+                                       ExtractionStageStats* stats)
     : max_image_size_(max_image_size),
+      stats_(stats),
       input_queue_(input_queue),
       output_queue_(output_queue) {}
 
@@ -298,8 +369,12 @@ void ImageResizerThread::Run() {
       break;
     }
 
+    const size_t queue_size = input_queue_->Size();
     const auto input_job = input_queue_->Pop();
     if (input_job.IsValid()) {
+      Timer timer;
+      timer.Start();
+
       auto image_data = input_job.Data();
 
       if (image_data.status == ImageReader::Status::SUCCESS) {
@@ -318,6 +393,8 @@ void ImageResizerThread::Run() {
         }
       }
 
+      stats_->Add(timer.ElapsedSeconds(), queue_size);
+
       output_queue_->Push(image_data);
     } else {
       break;
@@ -328,9 +405,11 @@ void ImageResizerThread::Run() {
 SiftFeatureExtractorThread::SiftFeatureExtractorThread(
     const SiftExtractionOptions& sift_options,
     const std::shared_ptr<Bitmap>& camera_mask,
-    JobQueue<ImageData>* input_queue, JobQueue<ImageData>* output_queue)
+    JobQueue<ImageData>* input_queue, JobQueue<ImageData>* output_queue,
+    ExtractionStageStats* stats)
     : sift_options_(sift_options),
       camera_mask_(camera_mask),
+      stats_(stats),
       input_queue_(input_queue),
       output_queue_(output_queue) {
   CHECK(sift_options_.Check());
@@ -365,8 +444,12 @@ void SiftFeatureExtractorThread::Run() {
       break;
     }
 
+    const size_t queue_size = input_queue_->Size();
     const auto input_job = input_queue_->Pop();
     if (input_job.IsValid()) {
+      Timer timer;
+      timer.Start();
+
       auto image_data = input_job.Data();
 
       if (image_data.status == ImageReader::Status::SUCCESS) {
@@ -403,6 +486,8 @@ void SiftFeatureExtractorThread::Run() {
 
       image_data.bitmap.Deallocate();
 
+      stats_->Add(timer.ElapsedSeconds(), queue_size);
+
       output_queue_->Push(image_data);
     } else {
       break;
@@ -412,100 +497,122 @@ void SiftFeatureExtractorThread::Run() {
 
 FeatureWriterThread::FeatureWriterThread(const size_t num_images,
                                          Database* database,
-                                         JobQueue<ImageData>* input_queue)
-    : num_images_(num_images), database_(database), input_queue_(input_queue) {}
+                                         JobQueue<ImageData>* input_queue,
+                                         ExtractionStageStats* stats)
+    : num_images_(num_images),
+      database_(database),
+      stats_(stats),
+      input_queue_(input_queue),
+      image_index_(0) {}
 
 void FeatureWriterThread::Run() {
-  size_t image_index = 0;
+  // The extractor threads may finish the images out of order. Buffer them, so
+  // that the images are written and the image identifiers assigned in the
+  // order of the image reader.
+  std::map<size_t, ImageData> pending_image_data;
+
   while (true) {
     if (IsStopped()) {
       break;
     }
 
+    const size_t queue_size = input_queue_->Size();
     auto input_job = input_queue_->Pop();
     if (input_job.IsValid()) {
+      Timer timer;
+      timer.Start();
+
       auto& image_data = input_job.Data();
+      pending_image_data.emplace(image_data.index, std::move(image_data));
 
-      image_index += 1;
-
-      std::cout << StringPrintf("Processed file [%d/%d]", image_index,
-                                num_images_)
-                << std::endl;
-
-      std::cout << StringPrintf("  Name:            %s",
-                                image_data.image.Name().c_str())
-                << std::endl;
-
-      if (image_data.status == ImageReader::Status::IMAGE_EXISTS) {
-        std::cout << "  SKIP: Features for image already extracted."
-                  << std::endl;
-      } else if (image_data.status == ImageReader::Status::BITMAP_ERROR) {
-        std::cout << "  ERROR: Failed to read image file format." << std::endl;
-      } else if (image_data.status ==
-                 ImageReader::Status::CAMERA_SINGLE_DIM_ERROR) {
-        std::cout << "  ERROR: Single camera specified, "
-                     "but images have different dimensions."
-                  << std::endl;
-      } else if (image_data.status ==
-                 ImageReader::Status::CAMERA_EXIST_DIM_ERROR) {
-        std::cout << "  ERROR: Image previously processed, but current image "
-                     "has different dimensions."
-                  << std::endl;
-      } else if (image_data.status == ImageReader::Status::CAMERA_PARAM_ERROR) {
-        std::cout << "  ERROR: Camera has invalid parameters." << std::endl;
-      } else if (image_data.status == ImageReader::Status::FAILURE) {
-        std::cout << "  ERROR: Failed to extract features." << std::endl;
+      while (!pending_image_data.empty() &&
+             pending_image_data.begin()->first == image_index_) {
+        Write(&pending_image_data.begin()->second);
+        pending_image_data.erase(pending_image_data.begin());
       }
 
-      if (image_data.status != ImageReader::Status::SUCCESS) {
-        continue;
-      }
+      stats_->Add(timer.ElapsedSeconds(), queue_size);
+    } else {
+      break;
+    }
+  }
+}
 
-      std::cout << StringPrintf("  Dimensions:      %d x %d",
-                                image_data.camera.Width(),
-                                image_data.camera.Height())
-                << std::endl;
-      std::cout << StringPrintf("  Camera:          #%d - %s",
-                                image_data.camera.CameraId(),
-                                image_data.camera.ModelName().c_str())
-                << std::endl;
-      std::cout << StringPrintf("  Focal Length:    %.2fpx",
-                                image_data.camera.MeanFocalLength());
-      if (image_data.camera.HasPriorFocalLength()) {
-        std::cout << " (Prior)" << std::endl;
-      } else {
-        std::cout << std::endl;
-      }
-      if (image_data.image.HasTvecPrior()) {
-        std::cout << StringPrintf(
-                         "  GPS:             LAT=%.3f, LON=%.3f, ALT=%.3f",
-                         image_data.image.TvecPrior(0),
-                         image_data.image.TvecPrior(1),
-                         image_data.image.TvecPrior(2))
-                  << std::endl;
-      }
-      std::cout << StringPrintf("  Features:        %d",
-                                image_data.keypoints.size())
-                << std::endl;
+void FeatureWriterThread::Write(ImageData* image_data) {
+  image_index_ += 1;
+
+  std::cout << StringPrintf("Processed file [%d/%d]", image_index_,
+                            num_images_)
+            << std::endl;
+
+  std::cout << StringPrintf("  Name:            %s",
+                            image_data->image.Name().c_str())
+            << std::endl;
+
+  if (image_data->status == ImageReader::Status::IMAGE_EXISTS) {
+    std::cout << "  SKIP: Features for image already extracted." << std::endl;
+  } else if (image_data->status == ImageReader::Status::BITMAP_ERROR) {
+    std::cout << "  ERROR: Failed to read image file format." << std::endl;
+  } else if (image_data->status ==
+             ImageReader::Status::CAMERA_SINGLE_DIM_ERROR) {
+    std::cout << "  ERROR: Single camera specified, "
+                 "but images have different dimensions."
+              << std::endl;
+  } else if (image_data->status ==
+             ImageReader::Status::CAMERA_EXIST_DIM_ERROR) {
+    std::cout << "  ERROR: Image previously processed, but current image "
+                 "has different dimensions."
+              << std::endl;
+  } else if (image_data->status == ImageReader::Status::CAMERA_PARAM_ERROR) {
+    std::cout << "  ERROR: Camera has invalid parameters." << std::endl;
+  } else if (image_data->status == ImageReader::Status::FAILURE) {
+    std::cout << "  ERROR: Failed to extract features." << std::endl;
+  }
 
-      DatabaseTransaction database_transaction(database_);
+  if (image_data->status != ImageReader::Status::SUCCESS) {
+    return;
+  }
 
-      if (image_data.image.ImageId() == kInvalidImageId) {
-        image_data.image.SetImageId(database_->WriteImage(image_data.image));
-      }
+  std::cout << StringPrintf("  Dimensions:      %d x %d",
+                            image_data->camera.Width(),
+                            image_data->camera.Height())
+            << std::endl;
+  std::cout << StringPrintf("  Camera:          #%d - %s",
+                            image_data->camera.CameraId(),
+                            image_data->camera.ModelName().c_str())
+            << std::endl;
+  std::cout << StringPrintf("  Focal Length:    %.2fpx",
+                            image_data->camera.MeanFocalLength());
+  if (image_data->camera.HasPriorFocalLength()) {
+    std::cout << " (Prior)" << std::endl;
+  } else {
+    std::cout << std::endl;
+  }
+  if (image_data->image.HasTvecPrior()) {
+    std::cout << StringPrintf("  GPS:             LAT=%.3f, LON=%.3f, ALT=%.3f",
+                              image_data->image.TvecPrior(0),
+                              image_data->image.TvecPrior(1),
+                              image_data->image.TvecPrior(2))
+              << std::endl;
+  }
+  std::cout << StringPrintf("  Features:        %d",
+                            image_data->keypoints.size())
+            << std::endl;
 
-      if (!database_->ExistsKeypoints(image_data.image.ImageId())) {
-        database_->WriteKeypoints(image_data.image.ImageId(),
-                                  image_data.keypoints);
-      }
+  DatabaseTransaction database_transaction(database_);
 
-      if (!database_->ExistsDescriptors(image_data.image.ImageId())) {
-        database_->WriteDescriptors(image_data.image.ImageId(),
-                                    image_data.descriptors);
-      }
-    } else {
-      break;
-    }
+  if (image_data->image.ImageId() == kInvalidImageId) {
+    image_data->image.SetImageId(database_->WriteImage(image_data->image));
+  }
+
+  if (!database_->ExistsKeypoints(image_data->image.ImageId())) {
+    database_->WriteKeypoints(image_data->image.ImageId(),
+                              image_data->keypoints);
+  }
+
+  if (!database_->ExistsDescriptors(image_data->image.ImageId())) {
+    database_->WriteDescriptors(image_data->image.ImageId(),
+                                image_data->descriptors);
   }
 }
 
@@ -43,6 +43,7 @@ namespace colmap {
 namespace internal {
 
 struct ImageData;
+class ExtractionStageStats;
 
 }  // namespace internal
 
@@ -68,6 +69,11 @@ class SiftFeatureExtractor : public Thread {
   std::unique_ptr<JobQueue<internal::ImageData>> resizer_queue_;
   std::unique_ptr<JobQueue<internal::ImageData>> extractor_queue_;
   std::unique_ptr<JobQueue<internal::ImageData>> writer_queue_;
+
+  std::unique_ptr<internal::ExtractionStageStats> reader_stats_;
+  std::unique_ptr<internal::ExtractionStageStats> resizer_stats_;
+  std::unique_ptr<internal::ExtractionStageStats> extractor_stats_;
+  std::unique_ptr<internal::ExtractionStageStats> writer_stats_;
 };
 
 // Import features from text files. Each image must have a corresponding text
@@ -91,6 +97,10 @@ class FeatureImporter : public Thread {
 namespace internal {
 
 struct ImageData {
+  // Index of the image in the image reader, used to write the images in the
+  // order in which they were read.
+  size_t index = 0;
+
   ImageReader::Status status = ImageReader::Status::FAILURE;
 
   Camera camera;
@@ -102,15 +112,40 @@ struct ImageData {
   FeatureDescriptors descriptors;
 };
 
+// Accumulates the number of processed images, the busy time, and the
+// occupancy of the input queue of one stage of the extraction pipeline.
+class ExtractionStageStats {
+ public:
+  ExtractionStageStats(const std::string& name, const int num_threads);
+
+  // Record one processed image and the size of the input queue before it was
+  // dequeued. This function is thread-safe.
+  void Add(const double busy_seconds, const size_t queue_size);
+
+  // Print the statistics given the total elapsed time of the pipeline.
+  void Print(const double elapsed_seconds) const;
+
+ private:
+  const std::string name_;
+  const int num_threads_;
+  mutable std::mutex mutex_;
+  size_t num_images_;
+  double busy_seconds_;
+  size_t queue_size_sum_;
+  size_t max_queue_size_;
+};
+
 class ImageResizerThread : public Thread {
  public:
   ImageResizerThread(const int max_image_size, JobQueue<ImageData>* input_queue,
-                     JobQueue<ImageData>* output_queue);
+                     JobQueue<ImageData>* output_queue,
+                     ExtractionStageStats* stats);
 
  private:
   void Run();
 
   const int max_image_size_;
+  ExtractionStageStats* stats_;
 
   JobQueue<ImageData>* input_queue_;
   JobQueue<ImageData>* output_queue_;
@@ -121,13 +156,15 @@ class SiftFeatureExtractorThread : public Thread {
   SiftFeatureExtractorThread(const SiftExtractionOptions& sift_options,
                              const std::shared_ptr<Bitmap>& camera_mask,
                              JobQueue<ImageData>* input_queue,
-                             JobQueue<ImageData>* output_queue);
+                             JobQueue<ImageData>* output_queue,
+                             ExtractionStageStats* stats);
 
  private:
   void Run();
 
   const SiftExtractionOptions sift_options_;
   std::shared_ptr<Bitmap> camera_mask_;
+  ExtractionStageStats* stats_;
 
   std::unique_ptr<OpenGLContextManager> opengl_context_;
 
@@ -138,14 +175,19 @@ class SiftFeatureExtractorThread : public Thread {
 class FeatureWriterThread : public Thread {
  public:
   FeatureWriterThread(const size_t num_images, Database* database,
-                      JobQueue<ImageData>* input_queue);
+                      JobQueue<ImageData>* input_queue,
+                      ExtractionStageStats* stats);
 
  private:
   void Run();
+  void Write(ImageData* image_data);
 
   const size_t num_images_;
   Database* database_;
+  ExtractionStageStats* stats_;
   JobQueue<ImageData>* input_queue_;
+  // Number of images written so far.
+  size_t image_index_;
 };
 
 }  // namespace internal
@@ -31,11 +31,13 @@
 
 #include "feature/matching.h"
 
+#include <algorithm>
 #include <fstream>
 #include <numeric>
 
 #include "SiftGPU/SiftGPU.h"
 #include "base/gps.h"
+#include "base/pose.h"
 #include "feature/utils.h"
 #include "retrieval/visual_index.h"
 #include "util/cuda.h"
@@ -48,39 +50,102 @@ void PrintElapsedTime(const Timer& timer) {
   std::cout << StringPrintf(" in %.3fs", timer.ElapsedSeconds()) << std::endl;
 }
 
+void PrintWriteStats(const FeatureMatcherWriter::Stats& stats) {
+  std::cout << StringPrintf(
+                   "Wrote %d image pairs in %d transactions in %.3fs "
+                   "(%.1f image pairs/s)",
+                   static_cast<int>(stats.num_image_pairs),
+                   static_cast<int>(stats.num_transactions),
+                   stats.write_seconds,
+                   stats.write_seconds > 0
+                       ? stats.num_image_pairs / stats.write_seconds
+                       : 0.0)
+            << std::endl;
+}
+
+void PrintStageStats(const std::string& name,
+                     const FeatureMatcherStageStats& stats,
+                     const double elapsed_seconds) {
+  if (stats.num_threads == 0) {
+    return;
+  }
+  const double utilization =
+      elapsed_seconds > 0
+          ? stats.busy_seconds / (stats.num_threads * elapsed_seconds)
+          : 0.0;
+  std::cout << StringPrintf(
+                   "%s: %d image pairs on %d threads in %.3fs "
+                   "(%.1f%% utilization)",
+                   name.c_str(), static_cast<int>(stats.num_image_pairs),
+                   stats.num_threads,
+                   stats.busy_seconds, 100.0 * utilization)
+            << std::endl;
+}
+
+void PrintPipelineStats(const SiftFeatureMatcher::PipelineStats& stats) {
+  PrintStageStats("Matching", stats.matching, stats.elapsed_seconds);
+  PrintStageStats("Verification", stats.verification, stats.elapsed_seconds);
+  PrintStageStats("Guided matching", stats.guided_matching,
+                  stats.elapsed_seconds);
+}
+
 void IndexImagesInVisualIndex(const int num_threads, const int num_checks,
                               const int max_num_features,
                               const std::vector<image_t>& image_ids,
                               Thread* thread, FeatureMatcherCache* cache,
                               retrieval::VisualIndex<>* visual_index) {
+  // The images are indexed in parallel, so each image uses a single thread.
   retrieval::VisualIndex<>::IndexOptions index_options;
-  index_options.num_threads = num_threads;
+  index_options.num_threads = 1;
   index_options.num_checks = num_checks;
 
-  for (size_t i = 0; i < image_ids.size(); ++i) {
-    if (thread->IsStopped()) {
-      return;
-    }
-
+  auto IndexFunc = [&](const image_t image_id) {
     Timer timer;
     timer.Start();
 
-    std::cout << StringPrintf("Indexing image [%d/%d]", i + 1, image_ids.size())
-              << std::flush;
+    const auto keypoints = cache->GetKeypoints(image_id);
+    const auto descriptors = cache->GetDescriptors(image_id);
+    if (max_num_features > 0 && descriptors->rows() > max_num_features) {
+      auto top_keypoints = *keypoints;
+      auto top_descriptors = *descriptors;
+      ExtractTopScaleFeatures(&top_keypoints, &top_descriptors,
+                              max_num_features);
+      visual_index->Add(index_options, image_id, top_keypoints,
+                        top_descriptors);
+    } else {
+      visual_index->Add(index_options, image_id, *keypoints, *descriptors);
+    }
 
-    auto keypoints = cache->GetKeypoints(image_ids[i]);
-    auto descriptors = cache->GetDescriptors(image_ids[i]);
-    if (max_num_features > 0 && descriptors.rows() > max_num_features) {
-      ExtractTopScaleFeatures(&keypoints, &descriptors, max_num_features);
+    return timer.ElapsedSeconds();
+  };
+
+  ThreadPool thread_pool(num_threads);
+
+  std::vector<std::future<double>> futures;
+  futures.reserve(image_ids.size());
+  for (const auto image_id : image_ids) {
+    futures.push_back(thread_pool.AddTask(IndexFunc, image_id));
+  }
+
+  for (size_t i = 0; i < futures.size(); ++i) {
+    if (thread->IsStopped()) {
+      thread_pool.Stop();
+      return;
     }
 
-    visual_index->Add(index_options, image_ids[i], keypoints, descriptors);
+    const double elapsed_seconds = futures[i].get();
 
-    PrintElapsedTime(timer);
+    std::cout << StringPrintf("Indexing image [%d/%d] in %.3fs", i + 1,
+                              image_ids.size(), elapsed_seconds)
+              << std::endl;
   }
 
   // Compute the TF-IDF weights, etc.
-  visual_index->Prepare();
+  Timer timer;
+  timer.Start();
+  std::cout << "Preparing index..." << std::flush;
+  visual_index->Prepare(num_threads);
+  PrintElapsedTime(timer);
 }
 
 void MatchNearestNeighborsInVisualIndex(
@@ -107,8 +172,8 @@ void MatchNearestNeighborsInVisualIndex(
   query_options.num_checks = num_checks;
   query_options.num_images_after_verification = num_images_after_verification;
   auto QueryFunc = [&](const image_t image_id) {
-    auto keypoints = cache->GetKeypoints(image_id);
-    auto descriptors = cache->GetDescriptors(image_id);
+    auto keypoints = *cache->GetKeypoints(image_id);
+    auto descriptors = *cache->GetDescriptors(image_id);
     if (max_num_features > 0 && descriptors.rows() > max_num_features) {
       ExtractTopScaleFeatures(&keypoints, &descriptors, max_num_features);
     }
@@ -196,6 +261,8 @@ bool VocabTreeMatchingOptions::Check() const {
 bool SpatialMatchingOptions::Check() const {
   CHECK_OPTION_GT(max_num_neighbors, 0);
   CHECK_OPTION_GT(max_distance, 0.0);
+  CHECK_OPTION_GE(max_viewing_angle, 0.0);
+  CHECK_OPTION_LE(max_viewing_angle, 180.0);
   return true;
 }
 
@@ -213,11 +280,19 @@ bool ImagePairsMatchingOptions::Check() const {
 bool FeaturePairsMatchingOptions::Check() const { return true; }
 
 FeatureMatcherCache::FeatureMatcherCache(const size_t cache_size,
-                                         const Database* database)
-    : cache_size_(cache_size), database_(database) {
+                                         Database* database)
+    : cache_size_(cache_size),
+      database_(database),
+      has_matching_options_(false) {
   CHECK_NOTNULL(database_);
 }
 
+void FeatureMatcherCache::SetMatchingOptions(
+    const SiftMatchingOptions& options) {
+  matching_options_ = options;
+  has_matching_options_ = true;
+}
+
 void FeatureMatcherCache::Setup() {
   const std::vector<Camera> cameras = database_->ReadAllCameras();
   cameras_cache_.reserve(cameras.size());
@@ -231,15 +306,59 @@ void FeatureMatcherCache::Setup() {
     images_cache_.emplace(image.ImageId(), image);
   }
 
-  keypoints_cache_.reset(new LRUCache<image_t, FeatureKeypoints>(
-      cache_size_, [this](const image_t image_id) {
-        return database_->ReadKeypoints(image_id);
+  // The database connection is shared, so only the database reads on cache
+  // misses are serialized, while hits only lock their cache shard. Features
+  // in the memory-mapped feature store are read without the database lock and
+  // the derived data is computed directly from the zero-copy views.
+  const size_t kNumCacheShards = 16;
+
+  keypoints_cache_.reset(new ShardedLRUCache<image_t, FeatureKeypoints>(
+      cache_size_, kNumCacheShards, [this](const image_t image_id) {
+        if (database_->ExistsKeypointsView(image_id)) {
+          const FeatureKeypointsView keypoints =
+              database_->ReadKeypointsView(image_id);
+          return std::make_shared<const FeatureKeypoints>(keypoints.begin(),
+                                                          keypoints.end());
+        }
+        std::unique_lock<std::mutex> lock(database_mutex_);
+        return std::make_shared<const FeatureKeypoints>(
+            database_->ReadKeypoints(image_id));
       }));
 
-  descriptors_cache_.reset(new LRUCache<image_t, FeatureDescriptors>(
-      cache_size_, [this](const image_t image_id) {
-        return database_->ReadDescriptors(image_id);
+  descriptors_cache_.reset(new ShardedLRUCache<image_t, FeatureDescriptors>(
+      cache_size_, kNumCacheShards, [this](const image_t image_id) {
+        if (database_->ExistsDescriptorsView(image_id)) {
+          return std::make_shared<const FeatureDescriptors>(
+              database_->ReadDescriptorsView(image_id));
+        }
+        std::unique_lock<std::mutex> lock(database_mutex_);
+        return std::make_shared<const FeatureDescriptors>(
+            database_->ReadDescriptors(image_id));
       }));
+
+  points_cache_.reset(
+      new ShardedLRUCache<image_t, std::vector<Eigen::Vector2d>>(
+          cache_size_, kNumCacheShards, [this](const image_t image_id) {
+            if (database_->ExistsKeypointsView(image_id)) {
+              return std::make_shared<const std::vector<Eigen::Vector2d>>(
+                  FeatureKeypointsToPointsVector(
+                      database_->ReadKeypointsView(image_id)));
+            }
+            return std::make_shared<const std::vector<Eigen::Vector2d>>(
+                FeatureKeypointsToPointsVector(*GetKeypoints(image_id)));
+          }));
+
+  matching_descriptors_cache_.reset(
+      new ShardedLRUCache<image_t, SiftMatchingDescriptors>(
+          cache_size_, kNumCacheShards, [this](const image_t image_id) {
+            CHECK(has_matching_options_);
+            if (database_->ExistsDescriptorsView(image_id)) {
+              return std::make_shared<const SiftMatchingDescriptors>(
+                  matching_options_, database_->ReadDescriptorsView(image_id));
+            }
+            return std::make_shared<const SiftMatchingDescriptors>(
+                matching_options_, GetDescriptors(image_id));
+          }));
 }
 
 const Camera& FeatureMatcherCache::GetCamera(const camera_t camera_id) const {
@@ -250,18 +369,26 @@ const Image& FeatureMatcherCache::GetImage(const image_t image_id) const {
   return images_cache_.at(image_id);
 }
 
-const FeatureKeypoints& FeatureMatcherCache::GetKeypoints(
+std::shared_ptr<const FeatureKeypoints> FeatureMatcherCache::GetKeypoints(
     const image_t image_id) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
   return keypoints_cache_->Get(image_id);
 }
 
-const FeatureDescriptors& FeatureMatcherCache::GetDescriptors(
+std::shared_ptr<const FeatureDescriptors> FeatureMatcherCache::GetDescriptors(
     const image_t image_id) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
   return descriptors_cache_->Get(image_id);
 }
 
+std::shared_ptr<const std::vector<Eigen::Vector2d>>
+FeatureMatcherCache::GetPoints(const image_t image_id) {
+  return points_cache_->Get(image_id);
+}
+
+std::shared_ptr<const SiftMatchingDescriptors>
+FeatureMatcherCache::GetMatchingDescriptors(const image_t image_id) {
+  return matching_descriptors_cache_->Get(image_id);
+}
+
 FeatureMatches FeatureMatcherCache::GetMatches(const image_t image_id1,
                                                const image_t image_id2) {
   std::unique_lock<std::mutex> lock(database_mutex_);
@@ -303,6 +430,16 @@ void FeatureMatcherCache::WriteTwoViewGeometry(
   database_->WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
 }
 
+void FeatureMatcherCache::WriteMatchesAndTwoViewGeometries(
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<FeatureMatches>& matches,
+    const std::vector<TwoViewGeometry>& two_view_geometries) {
+  std::unique_lock<std::mutex> lock(database_mutex_);
+  DatabaseTransaction database_transaction(database_);
+  database_->WriteMatches(image_pairs, matches);
+  database_->WriteTwoViewGeometries(image_pairs, two_view_geometries);
+}
+
 void FeatureMatcherCache::DeleteMatches(const image_t image_id1,
                                         const image_t image_id2) {
   std::unique_lock<std::mutex> lock(database_mutex_);
@@ -315,6 +452,21 @@ void FeatureMatcherCache::DeleteInlierMatches(const image_t image_id1,
   database_->DeleteInlierMatches(image_id1, image_id2);
 }
 
+namespace internal {
+
+void FeatureMatcherStatsAccumulator::Add(const double busy_seconds) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  stats_.num_image_pairs += 1;
+  stats_.busy_seconds += busy_seconds;
+}
+
+FeatureMatcherStageStats FeatureMatcherStatsAccumulator::Get() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace internal
+
 FeatureMatcherThread::FeatureMatcherThread(const SiftMatchingOptions& options,
                                            FeatureMatcherCache* cache)
     : options_(options), cache_(cache) {}
@@ -323,6 +475,10 @@ void FeatureMatcherThread::SetMaxNumMatches(const int max_num_matches) {
   options_.max_num_matches = max_num_matches;
 }
 
+FeatureMatcherStageStats FeatureMatcherThread::GetStats() {
+  return stats_.Get();
+}
+
 SiftCPUFeatureMatcher::SiftCPUFeatureMatcher(const SiftMatchingOptions& options,
                                              FeatureMatcherCache* cache,
                                              JobQueue<Input>* input_queue,
@@ -345,11 +501,15 @@ void SiftCPUFeatureMatcher::Run() {
     if (input_job.IsValid()) {
       auto data = input_job.Data();
 
-      const FeatureDescriptors descriptors1 =
-          cache_->GetDescriptors(data.image_id1);
-      const FeatureDescriptors descriptors2 =
-          cache_->GetDescriptors(data.image_id2);
-      MatchSiftFeaturesCPU(options_, descriptors1, descriptors2, &data.matches);
+      Timer timer;
+      timer.Start();
+
+      const auto descriptors1 = cache_->GetMatchingDescriptors(data.image_id1);
+      const auto descriptors2 = cache_->GetMatchingDescriptors(data.image_id2);
+      MatchSiftFeaturesCPU(options_, *descriptors1, *descriptors2,
+                           &data.matches);
+
+      stats_.Add(timer.ElapsedSeconds());
 
       CHECK(output_queue_->Push(data));
     }
@@ -397,6 +557,9 @@ void SiftGPUFeatureMatcher::Run() {
     if (input_job.IsValid()) {
       auto data = input_job.Data();
 
+      Timer timer;
+      timer.Start();
+
       const FeatureDescriptors* descriptors1_ptr;
       GetDescriptorData(0, data.image_id1, &descriptors1_ptr);
       const FeatureDescriptors* descriptors2_ptr;
@@ -404,6 +567,8 @@ void SiftGPUFeatureMatcher::Run() {
       MatchSiftFeaturesGPU(options_, descriptors1_ptr, descriptors2_ptr,
                            &sift_match_gpu, &data.matches);
 
+      stats_.Add(timer.ElapsedSeconds());
+
       CHECK(output_queue_->Push(data));
     }
   }
@@ -418,7 +583,7 @@ void SiftGPUFeatureMatcher::GetDescriptorData(
     *descriptors_ptr = nullptr;
   } else {
     prev_uploaded_descriptors_[index] = cache_->GetDescriptors(image_id);
-    *descriptors_ptr = &prev_uploaded_descriptors_[index];
+    *descriptors_ptr = prev_uploaded_descriptors_[index].get();
     prev_uploaded_image_ids_[index] = image_id;
   }
 }
@@ -450,14 +615,18 @@ void GuidedSiftCPUFeatureMatcher::Run() {
         continue;
       }
 
-      const FeatureKeypoints keypoints1 = cache_->GetKeypoints(data.image_id1);
-      const FeatureKeypoints keypoints2 = cache_->GetKeypoints(data.image_id2);
-      const FeatureDescriptors descriptors1 =
-          cache_->GetDescriptors(data.image_id1);
-      const FeatureDescriptors descriptors2 =
-          cache_->GetDescriptors(data.image_id2);
-      MatchGuidedSiftFeaturesCPU(options_, keypoints1, keypoints2, descriptors1,
-                                 descriptors2, &data.two_view_geometry);
+      Timer timer;
+      timer.Start();
+
+      const auto keypoints1 = cache_->GetKeypoints(data.image_id1);
+      const auto keypoints2 = cache_->GetKeypoints(data.image_id2);
+      const auto descriptors1 = cache_->GetMatchingDescriptors(data.image_id1);
+      const auto descriptors2 = cache_->GetMatchingDescriptors(data.image_id2);
+      MatchGuidedSiftFeaturesCPU(options_, *keypoints1, *keypoints2,
+                                 *descriptors1, *descriptors2,
+                                 &data.two_view_geometry);
+
+      stats_.Add(timer.ElapsedSeconds());
 
       CHECK(output_queue_->Push(data));
     }
@@ -510,6 +679,9 @@ void GuidedSiftGPUFeatureMatcher::Run() {
         continue;
       }
 
+      Timer timer;
+      timer.Start();
+
       const FeatureDescriptors* descriptors1_ptr;
       const FeatureKeypoints* keypoints1_ptr;
       GetFeatureData(0, data.image_id1, &keypoints1_ptr, &descriptors1_ptr);
@@ -521,6 +693,8 @@ void GuidedSiftGPUFeatureMatcher::Run() {
                                  descriptors1_ptr, descriptors2_ptr,
                                  &sift_match_gpu, &data.two_view_geometry);
 
+      stats_.Add(timer.ElapsedSeconds());
+
       CHECK(output_queue_->Push(data));
     }
   }
@@ -538,8 +712,8 @@ void GuidedSiftGPUFeatureMatcher::GetFeatureData(
   } else {
     prev_uploaded_keypoints_[index] = cache_->GetKeypoints(image_id);
     prev_uploaded_descriptors_[index] = cache_->GetDescriptors(image_id);
-    *keypoints_ptr = &prev_uploaded_keypoints_[index];
-    *descriptors_ptr = &prev_uploaded_descriptors_[index];
+    *keypoints_ptr = prev_uploaded_keypoints_[index].get();
+    *descriptors_ptr = prev_uploaded_descriptors_[index].get();
     prev_uploaded_image_ids_[index] = image_id;
   }
 }
@@ -565,6 +739,10 @@ TwoViewGeometryVerifier::TwoViewGeometryVerifier(
       options_.min_inlier_ratio;
 }
 
+FeatureMatcherStageStats TwoViewGeometryVerifier::GetStats() {
+  return stats_.Get();
+}
+
 void TwoViewGeometryVerifier::Run() {
   while (true) {
     if (IsStopped()) {
@@ -580,35 +758,143 @@ void TwoViewGeometryVerifier::Run() {
         continue;
       }
 
+      Timer timer;
+      timer.Start();
+
       const auto& camera1 =
           cache_->GetCamera(cache_->GetImage(data.image_id1).CameraId());
       const auto& camera2 =
           cache_->GetCamera(cache_->GetImage(data.image_id2).CameraId());
-      const auto keypoints1 = cache_->GetKeypoints(data.image_id1);
-      const auto keypoints2 = cache_->GetKeypoints(data.image_id2);
-      const auto points1 = FeatureKeypointsToPointsVector(keypoints1);
-      const auto points2 = FeatureKeypointsToPointsVector(keypoints2);
+      const auto points1 = cache_->GetPoints(data.image_id1);
+      const auto points2 = cache_->GetPoints(data.image_id2);
 
       if (options_.multiple_models) {
-        data.two_view_geometry.EstimateMultiple(camera1, points1, camera2,
-                                                points2, data.matches,
+        data.two_view_geometry.EstimateMultiple(camera1, *points1, camera2,
+                                                *points2, data.matches,
                                                 two_view_geometry_options_);
       } else {
-        data.two_view_geometry.Estimate(camera1, points1, camera2, points2,
+        data.two_view_geometry.Estimate(camera1, *points1, camera2, *points2,
                                         data.matches,
                                         two_view_geometry_options_);
       }
 
+      stats_.Add(timer.ElapsedSeconds());
+
       CHECK(output_queue_->Push(data));
     }
   }
 }
 
+FeatureMatcherWriter::FeatureMatcherWriter(const size_t batch_size,
+                                           FeatureMatcherCache* cache)
+    : batch_size_(batch_size), cache_(cache), input_queue_(2 * batch_size) {
+  CHECK_GT(batch_size_, 0);
+  CHECK_NOTNULL(cache_);
+}
+
+void FeatureMatcherWriter::Write(const Input& data) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    pending_image_pair_ids_.insert(
+        Database::ImagePairToPairId(data.image_id1, data.image_id2));
+  }
+  CHECK(input_queue_.Push(data));
+}
+
+bool FeatureMatcherWriter::IsPending(const image_t image_id1,
+                                     const image_t image_id2) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return pending_image_pair_ids_.count(
+             Database::ImagePairToPairId(image_id1, image_id2)) > 0;
+}
+
+void FeatureMatcherWriter::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  pending_condition_.wait(lock,
+                          [this]() { return pending_image_pair_ids_.empty(); });
+}
+
+void FeatureMatcherWriter::Stop() {
+  Thread::Stop();
+  input_queue_.Stop();
+}
+
+FeatureMatcherWriter::Stats FeatureMatcherWriter::GetStats() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void FeatureMatcherWriter::Run() {
+  std::vector<Input> batch;
+  batch.reserve(batch_size_);
+
+  while (true) {
+    if (IsStopped()) {
+      break;
+    }
+
+    auto input_job = input_queue_.Pop();
+    if (input_job.IsValid()) {
+      batch.push_back(std::move(input_job.Data()));
+
+      // Collect all already queued results up to the batch size. Under load,
+      // this fills up the batches, while otherwise results are written with
+      // minimal latency.
+      while (batch.size() < batch_size_ && input_queue_.Size() > 0) {
+        auto next_input_job = input_queue_.Pop();
+        if (!next_input_job.IsValid()) {
+          break;
+        }
+        batch.push_back(std::move(next_input_job.Data()));
+      }
+
+      WriteBatch(&batch);
+    } else {
+      break;
+    }
+  }
+}
+
+void FeatureMatcherWriter::WriteBatch(std::vector<Input>* batch) {
+  Timer timer;
+  timer.Start();
+
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<FeatureMatches> matches;
+  std::vector<TwoViewGeometry> two_view_geometries;
+  image_pairs.reserve(batch->size());
+  matches.reserve(batch->size());
+  two_view_geometries.reserve(batch->size());
+  for (auto& data : *batch) {
+    image_pairs.emplace_back(data.image_id1, data.image_id2);
+    matches.push_back(std::move(data.matches));
+    two_view_geometries.push_back(std::move(data.two_view_geometry));
+  }
+
+  cache_->WriteMatchesAndTwoViewGeometries(image_pairs, matches,
+                                           two_view_geometries);
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto& image_pair : image_pairs) {
+      pending_image_pair_ids_.erase(
+          Database::ImagePairToPairId(image_pair.first, image_pair.second));
+    }
+    stats_.num_image_pairs += image_pairs.size();
+    stats_.num_transactions += 1;
+    stats_.write_seconds += timer.ElapsedSeconds();
+  }
+  pending_condition_.notify_all();
+
+  batch->clear();
+}
+
 SiftFeatureMatcher::SiftFeatureMatcher(const SiftMatchingOptions& options,
                                        Database* database,
                                        FeatureMatcherCache* cache)
     : options_(options), database_(database), cache_(cache), is_setup_(false) {
   CHECK(options_.Check());
+  CHECK_NOTNULL(cache_)->SetMatchingOptions(options_);
 
   const int num_threads = GetEffectiveNumThreads(options_.num_threads);
   CHECK_GT(num_threads, 0);
@@ -669,9 +955,16 @@ SiftFeatureMatcher::SiftFeatureMatcher(const SiftMatchingOptions& options,
           options_, cache, &verifier_queue_, &output_queue_));
     }
   }
+
+  writer_.reset(new FeatureMatcherWriter(
+      static_cast<size_t>(options_.write_batch_size), cache));
 }
 
 SiftFeatureMatcher::~SiftFeatureMatcher() {
+  if (is_setup_) {
+    Drain(0);
+  }
+
   matcher_queue_.Wait();
   verifier_queue_.Wait();
   guided_matcher_queue_.Wait();
@@ -705,6 +998,10 @@ SiftFeatureMatcher::~SiftFeatureMatcher() {
   for (auto& guided_matcher : guided_matchers_) {
     guided_matcher->Wait();
   }
+
+  writer_->Flush();
+  writer_->Stop();
+  writer_->Wait();
 }
 
 bool SiftFeatureMatcher::Setup() {
@@ -726,6 +1023,8 @@ bool SiftFeatureMatcher::Setup() {
     guided_matcher->Start();
   }
 
+  writer_->Start();
+
   for (auto& matcher : matchers_) {
     if (!matcher->CheckValidSetup()) {
       return false;
@@ -740,11 +1039,19 @@ bool SiftFeatureMatcher::Setup() {
 
   is_setup_ = true;
 
+  timer_.Start();
+
   return true;
 }
 
 void SiftFeatureMatcher::Match(
     const std::vector<std::pair<image_t, image_t>>& image_pairs) {
+  MatchAsync(image_pairs);
+  Drain(0);
+}
+
+void SiftFeatureMatcher::MatchAsync(
+    const std::vector<std::pair<image_t, image_t>>& image_pairs) {
   CHECK_NOTNULL(database_);
   CHECK_NOTNULL(cache_);
   CHECK(is_setup_);
@@ -757,24 +1064,23 @@ void SiftFeatureMatcher::Match(
   // Match the image pairs
   //////////////////////////////////////////////////////////////////////////////
 
-  std::unordered_set<image_pair_t> image_pair_ids;
-  image_pair_ids.reserve(image_pairs.size());
-
-  size_t num_outputs = 0;
   for (const auto image_pair : image_pairs) {
     // Avoid self-matches.
     if (image_pair.first == image_pair.second) {
       continue;
     }
 
-    // Avoid duplicate image pairs.
+    // Avoid duplicate image pairs within and across the queued batches.
     const image_pair_t pair_id =
         Database::ImagePairToPairId(image_pair.first, image_pair.second);
-    if (image_pair_ids.count(pair_id) > 0) {
+    if (pending_image_pair_ids_.count(pair_id) > 0) {
       continue;
     }
 
-    image_pair_ids.insert(pair_id);
+    // The results of previously matched image pairs might not be written yet.
+    if (writer_->IsPending(image_pair.first, image_pair.second)) {
+      continue;
+    }
 
     const bool exists_matches =
         cache_->ExistsMatches(image_pair.first, image_pair.second);
@@ -785,7 +1091,7 @@ void SiftFeatureMatcher::Match(
       continue;
     }
 
-    num_outputs += 1;
+    pending_image_pair_ids_.insert(pair_id);
 
     // If only one of the matches or inlier matches exist, we recompute them
     // from scratch and delete the existing results. This must be done before
@@ -808,31 +1114,75 @@ void SiftFeatureMatcher::Match(
       CHECK(matcher_queue_.Push(data));
     }
   }
+}
 
+void SiftFeatureMatcher::Drain(const size_t max_num_pending) {
   //////////////////////////////////////////////////////////////////////////////
-  // Write results to database
+  // Queue results for writing to database
   //////////////////////////////////////////////////////////////////////////////
 
-  for (size_t i = 0; i < num_outputs; ++i) {
-    const auto output_job = output_queue_.Pop();
+  // Collect the already finished results without blocking.
+  while (output_queue_.Size() > 0) {
+    auto output_job = output_queue_.Pop();
     CHECK(output_job.IsValid());
-    auto output = output_job.Data();
+    CollectOutput(&output_job.Data());
+  }
 
-    if (output.matches.size() < static_cast<size_t>(options_.min_num_inliers)) {
-      output.matches = {};
-    }
+  while (pending_image_pair_ids_.size() > max_num_pending) {
+    auto output_job = output_queue_.Pop();
+    CHECK(output_job.IsValid());
+    CollectOutput(&output_job.Data());
+  }
+}
 
-    if (output.two_view_geometry.inlier_matches.size() <
-        static_cast<size_t>(options_.min_num_inliers)) {
-      output.two_view_geometry = TwoViewGeometry();
-    }
+size_t SiftFeatureMatcher::NumPending() const {
+  return pending_image_pair_ids_.size();
+}
+
+void SiftFeatureMatcher::Flush() { writer_->Flush(); }
+
+FeatureMatcherWriter::Stats SiftFeatureMatcher::WriteStats() {
+  return writer_->GetStats();
+}
+
+SiftFeatureMatcher::PipelineStats SiftFeatureMatcher::GetPipelineStats() {
+  const auto AccumulateStats = [](const FeatureMatcherStageStats& thread_stats,
+                                  FeatureMatcherStageStats* stage_stats) {
+    stage_stats->num_threads += 1;
+    stage_stats->num_image_pairs += thread_stats.num_image_pairs;
+    stage_stats->busy_seconds += thread_stats.busy_seconds;
+  };
+
+  PipelineStats stats;
+  stats.elapsed_seconds = is_setup_ ? timer_.ElapsedSeconds() : 0.0;
+  for (auto& matcher : matchers_) {
+    AccumulateStats(matcher->GetStats(), &stats.matching);
+  }
+  for (auto& verifier : verifiers_) {
+    AccumulateStats(verifier->GetStats(), &stats.verification);
+  }
+  for (auto& guided_matcher : guided_matchers_) {
+    AccumulateStats(guided_matcher->GetStats(), &stats.guided_matching);
+  }
 
-    cache_->WriteMatches(output.image_id1, output.image_id2, output.matches);
-    cache_->WriteTwoViewGeometry(output.image_id1, output.image_id2,
-                                 output.two_view_geometry);
+  return stats;
+}
+
+void SiftFeatureMatcher::CollectOutput(internal::FeatureMatcherData* output) {
+  if (output->matches.size() < static_cast<size_t>(options_.min_num_inliers)) {
+    output->matches = {};
+  }
+
+  if (output->two_view_geometry.inlier_matches.size() <
+      static_cast<size_t>(options_.min_num_inliers)) {
+    output->two_view_geometry = TwoViewGeometry();
   }
 
-  CHECK_EQ(output_queue_.Size(), 0);
+  // Mark the image pair as pending in the writer before releasing it here, so
+  // that it cannot be queued again in between.
+  writer_->Write(*output);
+  pending_image_pair_ids_.erase(
+      Database::ImagePairToPairId(output->image_id1, output->image_id2));
 }
 
 ExhaustiveFeatureMatcher::ExhaustiveFeatureMatcher(
@@ -866,12 +1216,14 @@ void ExhaustiveFeatureMatcher::Run() {
   std::vector<std::pair<image_t, image_t>> image_pairs;
   image_pairs.reserve(num_pairs_per_block);
 
-  for (size_t start_idx1 = 0; start_idx1 < image_ids.size();
-       start_idx1 += block_size) {
+  for (size_t block_idx1 = 0; block_idx1 < num_blocks; ++block_idx1) {
+    const size_t start_idx1 = block_idx1 * block_size;
     const size_t end_idx1 =
         std::min(image_ids.size(), start_idx1 + block_size) - 1;
-    for (size_t start_idx2 = 0; start_idx2 < image_ids.size();
-         start_idx2 += block_size) {
+    for (size_t i = 0; i < num_blocks; ++i) {
+      // Serpentine order, so that consecutive blocks share images.
+      const size_t block_idx2 = block_idx1 % 2 == 0 ? i : num_blocks - i - 1;
+      const size_t start_idx2 = block_idx2 * block_size;
       const size_t end_idx2 =
           std::min(image_ids.size(), start_idx2 + block_size) - 1;
 
@@ -884,8 +1236,8 @@ void ExhaustiveFeatureMatcher::Run() {
       timer.Start();
 
       std::cout << StringPrintf("Matching block [%d/%d, %d/%d]",
-                                start_idx1 / block_size + 1, num_blocks,
-                                start_idx2 / block_size + 1, num_blocks)
+                                block_idx1 + 1, num_blocks, block_idx2 + 1,
+                                num_blocks)
                 << std::flush;
 
       image_pairs.clear();
@@ -901,13 +1253,20 @@ void ExhaustiveFeatureMatcher::Run() {
         }
       }
 
-      DatabaseTransaction database_transaction(&database_);
-      matcher_.Match(image_pairs);
+      // Queue the block and collect the results of the previous block, while
+      // the matching threads already work on the current block.
+      matcher_.MatchAsync(image_pairs);
+      matcher_.Drain(image_pairs.size());
 
       PrintElapsedTime(timer);
     }
   }
 
+  matcher_.Drain(0);
+  matcher_.Flush();
+  PrintWriteStats(matcher_.WriteStats());
+  PrintPipelineStats(matcher_.GetPipelineStats());
+
   GetTimer().PrintMinutes();
 }
 
@@ -941,6 +1300,9 @@ void SequentialFeatureMatcher::Run() {
     RunLoopDetection(ordered_image_ids);
   }
 
+  matcher_.Flush();
+  PrintWriteStats(matcher_.WriteStats());
+
   GetTimer().PrintMinutes();
 }
 
@@ -1003,7 +1365,6 @@ void SequentialFeatureMatcher::RunSequentialMatching(
       }
     }
 
-    DatabaseTransaction database_transaction(&database_);
     matcher_.Match(image_pairs);
 
     PrintElapsedTime(timer);
@@ -1116,9 +1477,122 @@ void VocabTreeFeatureMatcher::Run() {
       options_.num_images_after_verification, options_.max_num_features,
       image_ids, this, &cache_, &visual_index, &matcher_);
 
+  matcher_.Flush();
+  PrintWriteStats(matcher_.WriteStats());
+
   GetTimer().PrintMinutes();
 }
 
+void FindSpatialNearestNeighbors(const std::vector<Eigen::Vector3d>& locations,
+                                 const int max_num_neighbors,
+                                 const double max_distance,
+                                 const int num_threads,
+                                 std::vector<std::vector<size_t>>* neighbors) {
+  CHECK_GT(max_num_neighbors, 0);
+  CHECK_GT(max_distance, 0);
+  CHECK_NOTNULL(neighbors);
+
+  neighbors->clear();
+  neighbors->resize(locations.size());
+
+  if (locations.empty()) {
+    return;
+  }
+
+  // Center the locations, such that GPS coordinates in the Earth-centered
+  // frame can be represented in single precision without losing accuracy.
+  Eigen::Vector3d mean_location = Eigen::Vector3d::Zero();
+  for (const auto& location : locations) {
+    mean_location += location;
+  }
+  mean_location /= locations.size();
+
+  Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> location_matrix(
+      locations.size(), 3);
+  for (size_t i = 0; i < locations.size(); ++i) {
+    location_matrix.row(i) =
+        (locations[i] - mean_location).cast<float>().transpose();
+  }
+
+  const flann::Matrix<float> flann_locations(location_matrix.data(),
+                                             locations.size(), 3);
+  flann::KDTreeSingleIndex<flann::L2<float>> search_index(
+      flann_locations, flann::KDTreeSingleIndexParams());
+  search_index.buildIndex();
+
+  // Each location is its own nearest neighbor, which is discarded below.
+  flann::SearchParams search_params;
+  search_params.max_neighbors = max_num_neighbors + 1;
+  search_params.sorted = true;
+
+  // Note that FLANN's L2 distance is the squared Euclidean distance.
+  const float max_squared_distance =
+      static_cast<float>(max_distance * max_distance);
+
+  ThreadPool thread_pool(num_threads);
+
+  const size_t kNumTasksPerThread = 4;
+  const size_t num_locations_per_task = std::max<size_t>(
+      1, locations.size() / (kNumTasksPerThread * thread_pool.NumThreads()));
+
+  const auto SearchNeighbors = [&](const size_t begin, const size_t end) {
+    const flann::Matrix<float> queries(location_matrix.row(begin).data(),
+                                       end - begin, 3);
+    std::vector<std::vector<size_t>> indices;
+    std::vector<std::vector<float>> distances;
+    search_index.radiusSearch(queries, indices, distances,
+                              max_squared_distance, search_params);
+    for (size_t i = begin; i < end; ++i) {
+      auto& location_neighbors = (*neighbors)[i];
+      location_neighbors.reserve(max_num_neighbors);
+      for (const size_t idx : indices[i - begin]) {
+        if (location_neighbors.size() ==
+            static_cast<size_t>(max_num_neighbors)) {
+          break;
+        }
+        if (idx != i) {
+          location_neighbors.push_back(idx);
+        }
+      }
+    }
+  };
+
+  for (size_t begin = 0; begin < locations.size();
+       begin += num_locations_per_task) {
+    const size_t end =
+        std::min(locations.size(), begin + num_locations_per_task);
+    thread_pool.AddTask(SearchNeighbors, begin, end);
+  }
+
+  thread_pool.Wait();
+}
+
+void FilterSpatialNeighborsByViewingAngle(
+    const std::vector<Eigen::Vector3d>& viewing_directions,
+    const double max_viewing_angle,
+    std::vector<std::vector<size_t>>* neighbors) {
+  CHECK_NOTNULL(neighbors);
+  CHECK_EQ(viewing_directions.size(), neighbors->size());
+
+  const double min_viewing_angle_cos = std::cos(DegToRad(max_viewing_angle));
+
+  for (size_t i = 0; i < neighbors->size(); ++i) {
+    if (viewing_directions[i].isZero()) {
+      continue;
+    }
+    auto& location_neighbors = (*neighbors)[i];
+    location_neighbors.erase(
+        std::remove_if(location_neighbors.begin(), location_neighbors.end(),
+                       [&](const size_t idx) {
+                         return !viewing_directions[idx].isZero() &&
+                                viewing_directions[i].dot(
+                                    viewing_directions[idx]) <
+                                    min_viewing_angle_cos;
+                       }),
+        location_neighbors.end());
+  }
+}
+
 SpatialFeatureMatcher::SpatialFeatureMatcher(
     const SpatialMatchingOptions& options,
     const SiftMatchingOptions& match_options, const std::string& database_path)
@@ -1151,22 +1625,21 @@ void SpatialFeatureMatcher::Run() {
 
   std::cout << "Indexing images..." << std::flush;
 
-  GPSTransform gps_transform;
-
-  size_t num_locations = 0;
-  Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> location_matrix(
-      image_ids.size(), 3);
+  std::vector<Eigen::Vector3d> locations;
+  locations.reserve(image_ids.size());
 
   std::vector<size_t> location_idxs;
   location_idxs.reserve(image_ids.size());
 
-  std::vector<Eigen::Vector3d> ells(1);
+  const bool filter_viewing_angle = options_.max_viewing_angle < 180;
+  std::vector<Eigen::Vector3d> viewing_directions;
 
   for (size_t i = 0; i < image_ids.size(); ++i) {
     const auto image_id = image_ids[i];
     const auto& image = cache_.GetImage(image_id);
 
-    if ((image.TvecPrior(0) == 0 && image.TvecPrior(1) == 0 &&
+    if (!image.HasTvecPrior() ||
+        (image.TvecPrior(0) == 0 && image.TvecPrior(1) == 0 &&
          options_.ignore_z) ||
         (image.TvecPrior(0) == 0 && image.TvecPrior(1) == 0 &&
          image.TvecPrior(2) == 0 && !options_.ignore_z)) {
@@ -1174,54 +1647,35 @@ void SpatialFeatureMatcher::Run() {
     }
 
     location_idxs.push_back(i);
-
-    if (options_.is_gps) {
-      ells[0](0) = image.TvecPrior(0);
-      ells[0](1) = image.TvecPrior(1);
-      ells[0](2) = options_.ignore_z ? 0 : image.TvecPrior(2);
-
-      const auto xyzs = gps_transform.EllToXYZ(ells);
-
-      location_matrix(num_locations, 0) = static_cast<float>(xyzs[0](0));
-      location_matrix(num_locations, 1) = static_cast<float>(xyzs[0](1));
-      location_matrix(num_locations, 2) = static_cast<float>(xyzs[0](2));
-    } else {
-      location_matrix(num_locations, 0) =
-          static_cast<float>(image.TvecPrior(0));
-      location_matrix(num_locations, 1) =
-          static_cast<float>(image.TvecPrior(1));
-      location_matrix(num_locations, 2) =
-          static_cast<float>(options_.ignore_z ? 0 : image.TvecPrior(2));
+    locations.emplace_back(image.TvecPrior(0), image.TvecPrior(1),
+                           options_.ignore_z ? 0 : image.TvecPrior(2));
+
+    if (filter_viewing_angle) {
+      if (image.HasQvecPrior()) {
+        // The viewing direction is the z-axis of the camera in the world.
+        viewing_directions.push_back(
+            QuaternionToRotationMatrix(NormalizeQuaternion(image.QvecPrior()))
+                .row(2)
+                .transpose());
+      } else {
+        viewing_directions.emplace_back(0, 0, 0);
+      }
     }
+  }
 
-    num_locations += 1;
+  if (options_.is_gps) {
+    GPSTransform gps_transform;
+    locations = gps_transform.EllToXYZ(locations);
   }
 
   PrintElapsedTime(timer);
 
-  if (num_locations == 0) {
+  if (locations.empty()) {
     std::cout << " => No images with location data." << std::endl;
     GetTimer().PrintMinutes();
     return;
   }
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Building spatial index
-  //////////////////////////////////////////////////////////////////////////////
-
-  timer.Restart();
-
-  std::cout << "Building search index..." << std::flush;
-
-  flann::Matrix<float> locations(location_matrix.data(), num_locations,
-                                 location_matrix.cols());
-
-  flann::LinearIndexParams index_params;
-  flann::LinearIndex<flann::L2<float>> search_index(index_params);
-  search_index.buildIndex(locations);
-
-  PrintElapsedTime(timer);
-
   //////////////////////////////////////////////////////////////////////////////
   // Searching spatial index
   //////////////////////////////////////////////////////////////////////////////
@@ -1230,41 +1684,25 @@ void SpatialFeatureMatcher::Run() {
 
   std::cout << "Searching for nearest neighbors..." << std::flush;
 
-  const int knn = std::min<int>(options_.max_num_neighbors, num_locations);
-
-  Eigen::Matrix<size_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      index_matrix(num_locations, knn);
-  flann::Matrix<size_t> indices(index_matrix.data(), num_locations, knn);
-
-  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      distance_matrix(num_locations, knn);
-  flann::Matrix<float> distances(distance_matrix.data(), num_locations, knn);
-
-  flann::SearchParams search_params(flann::FLANN_CHECKS_AUTOTUNED);
-  if (match_options_.num_threads == ThreadPool::kMaxNumThreads) {
-    search_params.cores = std::thread::hardware_concurrency();
-  } else {
-    search_params.cores = match_options_.num_threads;
-  }
-  if (search_params.cores <= 0) {
-    search_params.cores = 1;
+  std::vector<std::vector<size_t>> neighbors;
+  FindSpatialNearestNeighbors(locations, options_.max_num_neighbors,
+                              options_.max_distance,
+                              match_options_.num_threads, &neighbors);
+  if (filter_viewing_angle) {
+    FilterSpatialNeighborsByViewingAngle(
+        viewing_directions, options_.max_viewing_angle, &neighbors);
   }
 
-  search_index.knnSearch(locations, indices, distances, knn, search_params);
-
   PrintElapsedTime(timer);
 
   //////////////////////////////////////////////////////////////////////////////
   // Matching
   //////////////////////////////////////////////////////////////////////////////
 
-  const float max_distance =
-      static_cast<float>(options_.max_distance * options_.max_distance);
-
   std::vector<std::pair<image_t, image_t>> image_pairs;
-  image_pairs.reserve(knn);
+  image_pairs.reserve(options_.max_num_neighbors);
 
-  for (size_t i = 0; i < num_locations; ++i) {
+  for (size_t i = 0; i < locations.size(); ++i) {
     if (IsStopped()) {
       GetTimer().PrintMinutes();
       return;
@@ -1272,35 +1710,25 @@ void SpatialFeatureMatcher::Run() {
 
     timer.Restart();
 
-    std::cout << StringPrintf("Matching image [%d/%d]", i + 1, num_locations)
+    std::cout << StringPrintf("Matching image [%d/%d]", i + 1, locations.size())
               << std::flush;
 
     image_pairs.clear();
 
-    for (int j = 0; j < knn; ++j) {
-      // Check if query equals result.
-      if (index_matrix(i, j) == i) {
-        continue;
-      }
-
-      // Since the nearest neighbors are sorted by distance, we can break.
-      if (distance_matrix(i, j) > max_distance) {
-        break;
-      }
-
-      const size_t idx = location_idxs[i];
-      const image_t image_id = image_ids.at(idx);
-      const size_t nn_idx = location_idxs.at(index_matrix(i, j));
-      const image_t nn_image_id = image_ids.at(nn_idx);
+    const image_t image_id = image_ids.at(location_idxs[i]);
+    for (const size_t nn_location_idx : neighbors[i]) {
+      const image_t nn_image_id = image_ids.at(location_idxs[nn_location_idx]);
       image_pairs.emplace_back(image_id, nn_image_id);
     }
 
-    DatabaseTransaction database_transaction(&database_);
     matcher_.Match(image_pairs);
 
     PrintElapsedTime(timer);
   }
 
+  matcher_.Flush();
+  PrintWriteStats(matcher_.WriteStats());
+
   GetTimer().PrintMinutes();
 }
 
@@ -1343,6 +1771,9 @@ void TransitiveFeatureMatcher::Run() {
                               options_.num_iterations)
               << std::endl;
 
+    // Make sure that the results of the previous iteration are written.
+    matcher_.Flush();
+
     std::vector<std::pair<image_t, image_t>> existing_image_pairs;
     std::vector<int> existing_num_inliers;
     database_.ReadTwoViewGeometryNumInliers(&existing_image_pairs,
@@ -1375,7 +1806,6 @@ void TransitiveFeatureMatcher::Run() {
                 num_batches += 1;
                 std::cout << StringPrintf("  Batch %d", num_batches)
                           << std::flush;
-                DatabaseTransaction database_transaction(&database_);
                 matcher_.Match(image_pairs);
                 image_pairs.clear();
                 PrintElapsedTime(timer);
@@ -1394,11 +1824,13 @@ void TransitiveFeatureMatcher::Run() {
 
     num_batches += 1;
     std::cout << StringPrintf("  Batch %d", num_batches) << std::flush;
-    DatabaseTransaction database_transaction(&database_);
     matcher_.Match(image_pairs);
     PrintElapsedTime(timer);
   }
 
+  matcher_.Flush();
+  PrintWriteStats(matcher_.WriteStats());
+
   GetTimer().PrintMinutes();
 }
 
@@ -1501,12 +1933,14 @@ void ImagePairsFeatureMatcher::Run() {
       block_image_pairs.push_back(image_pairs[j]);
     }
 
-    DatabaseTransaction database_transaction(&database_);
     matcher_.Match(block_image_pairs);
 
     PrintElapsedTime(timer);
   }
 
+  matcher_.Flush();
+  PrintWriteStats(matcher_.WriteStats());
+
   GetTimer().PrintMinutes();
 }
 
@@ -1616,8 +2050,8 @@ void FeaturePairsFeatureMatcher::Run() {
     if (options_.verify_matches) {
       database_.WriteMatches(image1.ImageId(), image2.ImageId(), matches);
 
-      const auto keypoints1 = cache_.GetKeypoints(image1.ImageId());
-      const auto keypoints2 = cache_.GetKeypoints(image2.ImageId());
+      const auto points1 = cache_.GetPoints(image1.ImageId());
+      const auto points2 = cache_.GetPoints(image2.ImageId());
 
       TwoViewGeometry two_view_geometry;
       TwoViewGeometry::Options two_view_geometry_options;
@@ -1634,10 +2068,8 @@ void FeaturePairsFeatureMatcher::Run() {
       two_view_geometry_options.ransac_options.min_inlier_ratio =
           match_options_.min_inlier_ratio;
 
-      two_view_geometry.Estimate(
-          camera1, FeatureKeypointsToPointsVector(keypoints1), camera2,
-          FeatureKeypointsToPointsVector(keypoints2), matches,
-          two_view_geometry_options);
+      two_view_geometry.Estimate(camera1, *points1, camera2, *points2,
+                                 matches, two_view_geometry_options);
 
       database_.WriteTwoViewGeometry(image1.ImageId(), image2.ImageId(),
                                      two_view_geometry);
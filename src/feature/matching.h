@@ -34,6 +34,7 @@
 
 #include <array>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "base/database.h"
@@ -132,6 +133,11 @@ struct SpatialMatchingOptions {
   // coordinates the unit is Euclidean distance in meters.
   double max_distance = 100;
 
+  // The maximum angle in degrees between the viewing directions of the query
+  // and nearest neighbor. Only applies if both images have an orientation
+  // prior, and the default of 180 degrees disables the filtering.
+  double max_viewing_angle = 180;
+
   bool Check() const;
 };
 
@@ -165,6 +171,18 @@ struct FeaturePairsMatchingOptions {
   bool Check() const;
 };
 
+// Processing statistics of one stage of the feature matching pipeline.
+struct FeatureMatcherStageStats {
+  // Number of threads of the stage.
+  int num_threads = 0;
+
+  // Number of image pairs processed by the stage.
+  size_t num_image_pairs = 0;
+
+  // Total time the threads of the stage spent processing image pairs.
+  double busy_seconds = 0;
+};
+
 namespace internal {
 
 struct FeatureMatcherData {
@@ -174,19 +192,48 @@ struct FeatureMatcherData {
   TwoViewGeometry two_view_geometry;
 };
 
+// Thread-safe accumulator of the processing statistics of a pipeline thread.
+class FeatureMatcherStatsAccumulator {
+ public:
+  void Add(const double busy_seconds);
+  FeatureMatcherStageStats Get();
+
+ private:
+  std::mutex mutex_;
+  FeatureMatcherStageStats stats_;
+};
+
 }  // namespace internal
 
-// Cache for feature matching to minimize database access during matching.
+// Cache for feature matching to minimize database access during matching. The
+// keypoints and descriptors are cached in a sharded LRU cache and returned as
+// shared handles, so concurrent matcher threads do not serialize on cache hits
+// and the returned features remain valid even if they are evicted meanwhile.
+// Data derived from the features of an image, which is needed for every image
+// pair involving the image, is prepared once and cached in the same way.
 class FeatureMatcherCache {
  public:
-  FeatureMatcherCache(const size_t cache_size, const Database* database);
+  FeatureMatcherCache(const size_t cache_size, Database* database);
+
+  // Set the options, for which the descriptors are prepared in
+  // `GetMatchingDescriptors`. Must be called before the first call to it.
+  void SetMatchingOptions(const SiftMatchingOptions& options);
 
   void Setup();
 
   const Camera& GetCamera(const camera_t camera_id) const;
   const Image& GetImage(const image_t image_id) const;
-  const FeatureKeypoints& GetKeypoints(const image_t image_id);
-  const FeatureDescriptors& GetDescriptors(const image_t image_id);
+  std::shared_ptr<const FeatureKeypoints> GetKeypoints(const image_t image_id);
+  std::shared_ptr<const FeatureDescriptors> GetDescriptors(
+      const image_t image_id);
+
+  // The image coordinates of the keypoints for geometric verification.
+  std::shared_ptr<const std::vector<Eigen::Vector2d>> GetPoints(
+      const image_t image_id);
+
+  // The descriptors prepared for matching on the CPU.
+  std::shared_ptr<const SiftMatchingDescriptors> GetMatchingDescriptors(
+      const image_t image_id);
   FeatureMatches GetMatches(const image_t image_id1, const image_t image_id2);
   std::vector<image_t> GetImageIds() const;
 
@@ -198,17 +245,31 @@ class FeatureMatcherCache {
   void WriteTwoViewGeometry(const image_t image_id1, const image_t image_id2,
                             const TwoViewGeometry& two_view_geometry);
 
+  // Write the matches and two-view geometries of multiple image pairs in a
+  // single database transaction using multi-row inserts.
+  void WriteMatchesAndTwoViewGeometries(
+      const std::vector<std::pair<image_t, image_t>>& image_pairs,
+      const std::vector<FeatureMatches>& matches,
+      const std::vector<TwoViewGeometry>& two_view_geometries);
+
   void DeleteMatches(const image_t image_id1, const image_t image_id2);
   void DeleteInlierMatches(const image_t image_id1, const image_t image_id2);
 
  private:
   const size_t cache_size_;
-  const Database* database_;
+  Database* database_;
   std::mutex database_mutex_;
+  SiftMatchingOptions matching_options_;
+  bool has_matching_options_;
   EIGEN_STL_UMAP(camera_t, Camera) cameras_cache_;
   EIGEN_STL_UMAP(image_t, Image) images_cache_;
-  std::unique_ptr<LRUCache<image_t, FeatureKeypoints>> keypoints_cache_;
-  std::unique_ptr<LRUCache<image_t, FeatureDescriptors>> descriptors_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, FeatureKeypoints>> keypoints_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, FeatureDescriptors>>
+      descriptors_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, std::vector<Eigen::Vector2d>>>
+      points_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, SiftMatchingDescriptors>>
+      matching_descriptors_cache_;
 };
 
 class FeatureMatcherThread : public Thread {
@@ -218,9 +279,12 @@ class FeatureMatcherThread : public Thread {
 
   void SetMaxNumMatches(const int max_num_matches);
 
+  FeatureMatcherStageStats GetStats();
+
  protected:
   SiftMatchingOptions options_;
   FeatureMatcherCache* cache_;
+  internal::FeatureMatcherStatsAccumulator stats_;
 };
 
 class SiftCPUFeatureMatcher : public FeatureMatcherThread {
@@ -263,7 +327,8 @@ class SiftGPUFeatureMatcher : public FeatureMatcherThread {
 
   // The previously uploaded images to the GPU.
   std::array<image_t, 2> prev_uploaded_image_ids_;
-  std::array<FeatureDescriptors, 2> prev_uploaded_descriptors_;
+  std::array<std::shared_ptr<const FeatureDescriptors>, 2>
+      prev_uploaded_descriptors_;
 };
 
 class GuidedSiftCPUFeatureMatcher : public FeatureMatcherThread {
@@ -307,8 +372,10 @@ class GuidedSiftGPUFeatureMatcher : public FeatureMatcherThread {
 
   // The previously uploaded images to the GPU.
   std::array<image_t, 2> prev_uploaded_image_ids_;
-  std::array<FeatureKeypoints, 2> prev_uploaded_keypoints_;
-  std::array<FeatureDescriptors, 2> prev_uploaded_descriptors_;
+  std::array<std::shared_ptr<const FeatureKeypoints>, 2>
+      prev_uploaded_keypoints_;
+  std::array<std::shared_ptr<const FeatureDescriptors>, 2>
+      prev_uploaded_descriptors_;
 };
 
 class TwoViewGeometryVerifier : public Thread {
@@ -321,6 +388,8 @@ class TwoViewGeometryVerifier : public Thread {
                           JobQueue<Input>* input_queue,
                           JobQueue<Output>* output_queue);
 
+  FeatureMatcherStageStats GetStats();
+
  protected:
   void Run() override;
 
@@ -329,15 +398,78 @@ class TwoViewGeometryVerifier : public Thread {
   FeatureMatcherCache* cache_;
   JobQueue<Input>* input_queue_;
   JobQueue<Output>* output_queue_;
+  internal::FeatureMatcherStatsAccumulator stats_;
+};
+
+// Asynchronously writes the results of the feature matching pipeline to the
+// database, so that matching does not stall on the single SQLite writer. The
+// queued image pairs are committed in transactions of at most `batch_size`
+// image pairs using multi-row inserts. If the writer falls behind by more than
+// twice the batch size, `Write` blocks until the queue drains.
+class FeatureMatcherWriter : public Thread {
+ public:
+  typedef internal::FeatureMatcherData Input;
+
+  struct Stats {
+    // Number of written image pairs and committed transactions.
+    size_t num_image_pairs = 0;
+    size_t num_transactions = 0;
+
+    // Total time spent in database writes.
+    double write_seconds = 0;
+  };
+
+  FeatureMatcherWriter(const size_t batch_size, FeatureMatcherCache* cache);
+
+  // Queue the results of an image pair for writing.
+  void Write(const Input& data);
+
+  // Whether the results of an image pair are queued but not yet written. For
+  // image pairs, the order of `image_id1` and `image_id2` does not matter.
+  bool IsPending(const image_t image_id1, const image_t image_id2);
+
+  // Block until all queued results are written to the database.
+  void Flush();
+
+  void Stop() override;
+
+  Stats GetStats();
+
+ private:
+  void Run() override;
+
+  void WriteBatch(std::vector<Input>* batch);
+
+  const size_t batch_size_;
+  FeatureMatcherCache* cache_;
+  JobQueue<Input> input_queue_;
+
+  std::mutex mutex_;
+  std::condition_variable pending_condition_;
+  std::unordered_set<image_pair_t> pending_image_pair_ids_;
+  Stats stats_;
 };
 
 // Multi-threaded and multi-GPU SIFT feature matcher, which writes the computed
 // results to the database and skips already matched image pairs. To improve
-// performance of the matching by taking advantage of caching and database
-// transactions, pass multiple images to the `Match` function. Note that the
-// database should be in an active transaction while calling `Match`.
+// performance of the matching by taking advantage of caching, pass multiple
+// images to the `Match` function. The results are written asynchronously, so
+// call `Flush` before accessing the matches in the database directly.
+//
+// To keep the pipeline busy across batches, queue the next batch with
+// `MatchAsync` before collecting the results of the previous batch with
+// `Drain`, instead of waiting for each batch with `Match`.
 class SiftFeatureMatcher {
  public:
+  struct PipelineStats {
+    // Time since the setup of the matcher.
+    double elapsed_seconds = 0;
+
+    FeatureMatcherStageStats matching;
+    FeatureMatcherStageStats verification;
+    FeatureMatcherStageStats guided_matching;
+  };
+
   SiftFeatureMatcher(const SiftMatchingOptions& options, Database* database,
                      FeatureMatcherCache* cache);
 
@@ -346,10 +478,31 @@ class SiftFeatureMatcher {
   // Setup the matchers and return if successful.
   bool Setup();
 
-  // Match one batch of multiple image pairs.
+  // Match one batch of multiple image pairs and wait for the results.
   void Match(const std::vector<std::pair<image_t, image_t>>& image_pairs);
 
+  // Queue one batch of multiple image pairs without waiting for the results.
+  void MatchAsync(const std::vector<std::pair<image_t, image_t>>& image_pairs);
+
+  // Pass the results of matched image pairs to the writer and block until at
+  // most `max_num_pending` queued image pairs remain unfinished.
+  void Drain(const size_t max_num_pending);
+
+  // Number of queued image pairs, whose results were not yet collected.
+  size_t NumPending() const;
+
+  // Block until the results of all matched image pairs are written.
+  void Flush();
+
+  // Throughput statistics of the database writes.
+  FeatureMatcherWriter::Stats WriteStats();
+
+  // Utilization statistics of the matching pipeline stages.
+  PipelineStats GetPipelineStats();
+
  private:
+  void CollectOutput(internal::FeatureMatcherData* output);
+
   SiftMatchingOptions options_;
   Database* database_;
   FeatureMatcherCache* cache_;
@@ -358,13 +511,19 @@ class SiftFeatureMatcher {
 
   std::vector<std::unique_ptr<FeatureMatcherThread>> matchers_;
   std::vector<std::unique_ptr<FeatureMatcherThread>> guided_matchers_;
-  std::vector<std::unique_ptr<Thread>> verifiers_;
+  std::vector<std::unique_ptr<TwoViewGeometryVerifier>> verifiers_;
+  std::unique_ptr<FeatureMatcherWriter> writer_;
   std::unique_ptr<ThreadPool> thread_pool_;
 
   JobQueue<internal::FeatureMatcherData> matcher_queue_;
   JobQueue<internal::FeatureMatcherData> verifier_queue_;
   JobQueue<internal::FeatureMatcherData> guided_matcher_queue_;
   JobQueue<internal::FeatureMatcherData> output_queue_;
+
+  // Image pairs that were queued but whose results were not yet collected.
+  std::unordered_set<image_pair_t> pending_image_pair_ids_;
+
+  Timer timer_;
 };
 
 // Exhaustively match images by processing each block in the exhaustive match
@@ -390,6 +549,11 @@ class SiftFeatureMatcher {
 //
 // Pairs will only be matched if 1, to avoid duplicate pairs. Pairs with #
 // are on the main diagonal and denote pairs of the same image.
+//
+// The blocks are traversed in serpentine order, such that consecutive blocks
+// share the images of one block and their features remain in the cache. The
+// next block is queued before the results of the previous block are collected,
+// so that the matching threads do not idle at the end of each block.
 class ExhaustiveFeatureMatcher : public Thread {
  public:
   ExhaustiveFeatureMatcher(const ExhaustiveMatchingOptions& options,
@@ -461,6 +625,25 @@ class VocabTreeFeatureMatcher : public Thread {
   SiftFeatureMatcher matcher_;
 };
 
+// Find the spatial nearest neighbors of the given locations using a KD-tree.
+// For each location, at most `max_num_neighbors` other locations within
+// `max_distance` are returned as indices sorted by increasing distance. The
+// queries are distributed over `num_threads` threads.
+void FindSpatialNearestNeighbors(const std::vector<Eigen::Vector3d>& locations,
+                                 const int max_num_neighbors,
+                                 const double max_distance,
+                                 const int num_threads,
+                                 std::vector<std::vector<size_t>>* neighbors);
+
+// Remove the spatial nearest neighbors, whose viewing direction deviates by
+// more than `max_viewing_angle` degrees from the viewing direction of the
+// query location. Locations without a viewing direction, given as a zero
+// vector, are never removed and do not remove any of their neighbors.
+void FilterSpatialNeighborsByViewingAngle(
+    const std::vector<Eigen::Vector3d>& viewing_directions,
+    const double max_viewing_angle,
+    std::vector<std::vector<size_t>>* neighbors);
+
 // Match images against spatial nearest neighbors using prior location
 // information, e.g. provided manually or extracted from EXIF.
 class SpatialFeatureMatcher : public Thread {
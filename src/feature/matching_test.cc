@@ -0,0 +1,260 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "feature/matching"
+#include "util/testing.h"
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+
+#include <boost/filesystem.hpp>
+
+#include "base/database.h"
+#include "feature/matching.h"
+#include "util/math.h"
+#include "util/random.h"
+
+using namespace colmap;
+
+namespace {
+
+// Create a database, in which all images observe the same features with
+// slightly perturbed descriptors in a different order, such that all image
+// pairs have sufficiently many matches.
+void CreateDatabase(const std::string& path, const size_t num_images,
+                    const size_t num_features) {
+  SetPRNGSeed(0);
+
+  FeatureDescriptors descriptors(num_features, 128);
+  for (size_t i = 0; i < num_features; ++i) {
+    for (int j = 0; j < 128; ++j) {
+      descriptors(i, j) = static_cast<uint8_t>(RandomInteger(0, 100));
+    }
+  }
+
+  Database database(path);
+
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_RADIAL", 100, 100, 100);
+  camera.SetCameraId(database.WriteCamera(camera));
+
+  for (size_t i = 0; i < num_images; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(camera.CameraId());
+    image.SetImageId(database.WriteImage(image));
+
+    std::vector<int> order(num_features);
+    std::iota(order.begin(), order.end(), 0);
+    Shuffle(static_cast<uint32_t>(num_features), &order);
+
+    FeatureKeypoints keypoints(num_features);
+    FeatureDescriptors image_descriptors(num_features, 128);
+    for (size_t j = 0; j < num_features; ++j) {
+      keypoints[j] = FeatureKeypoint(RandomReal(0.0f, 100.0f),
+                                     RandomReal(0.0f, 100.0f));
+      for (int k = 0; k < 128; ++k) {
+        image_descriptors(j, k) = static_cast<uint8_t>(
+            descriptors(order[j], k) + RandomInteger(0, 2));
+      }
+    }
+
+    database.WriteKeypoints(image.ImageId(), keypoints);
+    database.WriteDescriptors(image.ImageId(), image_descriptors);
+  }
+}
+
+std::map<image_pair_t, FeatureMatches> ReadAllMatches(
+    const std::string& path) {
+  Database database(path);
+  std::map<image_pair_t, FeatureMatches> matches;
+  for (auto& pair_matches : database.ReadAllMatches()) {
+    matches.emplace(pair_matches.first, std::move(pair_matches.second));
+  }
+  return matches;
+}
+
+void CheckEqualMatches(const std::map<image_pair_t, FeatureMatches>& matches1,
+                       const std::map<image_pair_t, FeatureMatches>& matches2) {
+  BOOST_CHECK_EQUAL(matches1.size(), matches2.size());
+  for (const auto& pair_matches : matches1) {
+    BOOST_CHECK_EQUAL(matches2.count(pair_matches.first), 1);
+    if (matches2.count(pair_matches.first) == 0) {
+      continue;
+    }
+    const FeatureMatches& other_matches = matches2.at(pair_matches.first);
+    BOOST_CHECK_EQUAL(pair_matches.second.size(), other_matches.size());
+    for (size_t i = 0; i < std::min(pair_matches.second.size(),
+                                    other_matches.size());
+         ++i) {
+      BOOST_CHECK_EQUAL(pair_matches.second[i].point2D_idx1,
+                        other_matches[i].point2D_idx1);
+      BOOST_CHECK_EQUAL(pair_matches.second[i].point2D_idx2,
+                        other_matches[i].point2D_idx2);
+    }
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestExhaustivePipelinedAndBlockingMatching) {
+  const size_t kNumImages = 8;
+  const size_t kNumFeatures = 50;
+
+  SiftMatchingOptions match_options;
+  match_options.use_gpu = false;
+  match_options.num_threads = 2;
+
+  // Match all image pairs in one blocking batch.
+  const std::string blocking_path = CreateTempPath();
+  CreateDatabase(blocking_path, kNumImages, kNumFeatures);
+  {
+    Database database(blocking_path);
+    FeatureMatcherCache cache(kNumImages, &database);
+    SiftFeatureMatcher matcher(match_options, &database, &cache);
+    BOOST_CHECK(matcher.Setup());
+    cache.Setup();
+
+    std::vector<std::pair<image_t, image_t>> image_pairs;
+    for (image_t image_id1 = 1; image_id1 <= kNumImages; ++image_id1) {
+      for (image_t image_id2 = image_id1 + 1; image_id2 <= kNumImages;
+           ++image_id2) {
+        image_pairs.emplace_back(image_id1, image_id2);
+      }
+    }
+    matcher.Match(image_pairs);
+    BOOST_CHECK_EQUAL(matcher.NumPending(), 0);
+    matcher.Flush();
+  }
+
+  const auto blocking_matches = ReadAllMatches(blocking_path);
+  BOOST_CHECK_EQUAL(blocking_matches.size(),
+                    kNumImages * (kNumImages - 1) / 2);
+  for (const auto& pair_matches : blocking_matches) {
+    BOOST_CHECK_GE(pair_matches.second.size(),
+                   static_cast<size_t>(match_options.min_num_inliers));
+  }
+
+  // Match the same image pairs in pipelined blocks of different size, where
+  // the number of images is not a multiple of the block size, so that the
+  // serpentine traversal includes a partial block.
+  for (const int block_size : {2, 3, 5, 10}) {
+    const std::string pipelined_path = CreateTempPath();
+    CreateDatabase(pipelined_path, kNumImages, kNumFeatures);
+    {
+      ExhaustiveMatchingOptions options;
+      options.block_size = block_size;
+      ExhaustiveFeatureMatcher matcher(options, match_options, pipelined_path);
+      matcher.Start();
+      matcher.Wait();
+    }
+
+    CheckEqualMatches(ReadAllMatches(pipelined_path), blocking_matches);
+
+    boost::filesystem::remove(pipelined_path);
+  }
+
+  boost::filesystem::remove(blocking_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestFindSpatialNearestNeighbors) {
+  const std::vector<Eigen::Vector3d> locations = {
+      Eigen::Vector3d(0, 0, 0), Eigen::Vector3d(1, 0, 0),
+      Eigen::Vector3d(3, 0, 0), Eigen::Vector3d(7, 0, 0)};
+
+  for (const int num_threads : {1, 4}) {
+    std::vector<std::vector<size_t>> neighbors;
+    FindSpatialNearestNeighbors(locations, 10, 2.5, num_threads, &neighbors);
+    BOOST_CHECK_EQUAL(neighbors.size(), 4);
+    BOOST_CHECK(neighbors[0] == std::vector<size_t>({1}));
+    BOOST_CHECK(neighbors[1] == std::vector<size_t>({0, 2}));
+    BOOST_CHECK(neighbors[2] == std::vector<size_t>({1}));
+    BOOST_CHECK(neighbors[3].empty());
+
+    FindSpatialNearestNeighbors(locations, 10, 10, num_threads, &neighbors);
+    BOOST_CHECK_EQUAL(neighbors.size(), 4);
+    BOOST_CHECK(neighbors[0] == std::vector<size_t>({1, 2, 3}));
+    BOOST_CHECK(neighbors[1] == std::vector<size_t>({0, 2, 3}));
+    BOOST_CHECK(neighbors[2] == std::vector<size_t>({1, 0, 3}));
+    BOOST_CHECK(neighbors[3] == std::vector<size_t>({2, 1, 0}));
+
+    FindSpatialNearestNeighbors(locations, 1, 10, num_threads, &neighbors);
+    BOOST_CHECK_EQUAL(neighbors.size(), 4);
+    BOOST_CHECK(neighbors[0] == std::vector<size_t>({1}));
+    BOOST_CHECK(neighbors[1] == std::vector<size_t>({0}));
+    BOOST_CHECK(neighbors[2] == std::vector<size_t>({1}));
+    BOOST_CHECK(neighbors[3] == std::vector<size_t>({2}));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestFindSpatialNearestNeighborsDuplicateLocations) {
+  const std::vector<Eigen::Vector3d> locations = {Eigen::Vector3d(1, 2, 3),
+                                                  Eigen::Vector3d(1, 2, 3),
+                                                  Eigen::Vector3d(1, 2, 4)};
+
+  std::vector<std::vector<size_t>> neighbors;
+  FindSpatialNearestNeighbors(locations, 10, 2, 1, &neighbors);
+  BOOST_CHECK_EQUAL(neighbors.size(), 3);
+  BOOST_CHECK(neighbors[0] == std::vector<size_t>({1, 2}));
+  BOOST_CHECK(neighbors[1] == std::vector<size_t>({0, 2}));
+  BOOST_CHECK_EQUAL(neighbors[2].size(), 2);
+  BOOST_CHECK(std::find(neighbors[2].begin(), neighbors[2].end(), 2) ==
+              neighbors[2].end());
+}
+
+BOOST_AUTO_TEST_CASE(TestFilterSpatialNeighborsByViewingAngle) {
+  const double kAngle30 = DegToRad(30.0);
+  const std::vector<Eigen::Vector3d> viewing_directions = {
+      Eigen::Vector3d(0, 0, 1),
+      Eigen::Vector3d(0, std::sin(kAngle30), std::cos(kAngle30)),
+      Eigen::Vector3d(0, 1, 0), Eigen::Vector3d(0, 0, 0)};
+  const std::vector<std::vector<size_t>> all_neighbors = {
+      {1, 2, 3}, {0, 2, 3}, {0, 1, 3}, {0, 1, 2}};
+
+  std::vector<std::vector<size_t>> neighbors = all_neighbors;
+  FilterSpatialNeighborsByViewingAngle(viewing_directions, 45, &neighbors);
+  BOOST_CHECK(neighbors[0] == std::vector<size_t>({1, 3}));
+  BOOST_CHECK(neighbors[1] == std::vector<size_t>({0, 3}));
+  BOOST_CHECK(neighbors[2] == std::vector<size_t>({3}));
+  BOOST_CHECK(neighbors[3] == all_neighbors[3]);
+
+  neighbors = all_neighbors;
+  FilterSpatialNeighborsByViewingAngle(viewing_directions, 75, &neighbors);
+  BOOST_CHECK(neighbors[0] == std::vector<size_t>({1, 3}));
+  BOOST_CHECK(neighbors[1] == std::vector<size_t>({0, 2, 3}));
+  BOOST_CHECK(neighbors[2] == std::vector<size_t>({1, 3}));
+  BOOST_CHECK(neighbors[3] == all_neighbors[3]);
+
+  neighbors = all_neighbors;
+  FilterSpatialNeighborsByViewingAngle(viewing_directions, 100, &neighbors);
+  BOOST_CHECK(neighbors == all_neighbors);
+}
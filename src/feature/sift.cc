@@ -32,9 +32,14 @@
 #include "feature/sift.h"
 
 #include <array>
+#include <cstring>
 #include <fstream>
 #include <memory>
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 #include "FLANN/flann.hpp"
 #include "SiftGPU/SiftGPU.h"
 #include "VLFeat/covdet.h"
@@ -45,42 +50,139 @@
 #include "util/math.h"
 #include "util/misc.h"
 #include "util/opengl_utils.h"
+#include "util/threading.h"
 
 namespace colmap {
+
+// FLANN index over the descriptors of one image. Note that the index only
+// references the descriptors, which must outlive the index.
+class SiftMatchingDescriptors::FLANNIndex
+    : public flann::Index<flann::L2<uint8_t>> {
+ public:
+  explicit FLANNIndex(const Eigen::Ref<const FeatureDescriptors>& descriptors)
+      : flann::Index<flann::L2<uint8_t>>(
+            flann::Matrix<uint8_t>(const_cast<uint8_t*>(descriptors.data()),
+                                   descriptors.rows(), 128),
+            flann::KDTreeIndexParams(kNumTreesInForest)) {
+    buildIndex();
+  }
+
+ private:
+  static const int kNumTreesInForest = 4;
+};
+
 namespace {
 
-size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
-                                       const float max_ratio,
-                                       const float max_distance,
-                                       std::vector<int>* matches) {
+// Number of descriptors per tile in the blocked brute-force matcher. A tile of
+// the first set of descriptors (32 x 256 bytes) is matched against a tile of the
+// second set (256 x 256 bytes), so that both tiles remain in the L2 cache while
+// every pair of descriptors between them is compared.
+const int kBruteForceBlockSize1 = 32;
+const int kBruteForceBlockSize2 = 256;
+
+// Number of tasks per thread when computing the orientations and descriptors
+// of an octave in parallel, to balance the load across the threads.
+const int kNumSiftTasksPerThread = 4;
+
+// Margin of the tiles in multiples of the largest keypoint scale. It covers
+// the descriptor window of VLFeat with a radius of ~10.6 times the scale.
+const double kSiftTileMarginFactor = 12.0;
+
+// SIFT descriptors widened to 16-bit integers. The uint8 values are in the
+// full range [0, 255], such that the unsigned/signed byte multiply-add
+// instructions cannot be used without overflow and we instead rely on the
+// 16-bit multiply-add instructions.
+typedef SiftMatchingDescriptors::Int16Descriptors FeatureDescriptorsInt16;
+
+// Compute the dot product between two 128-dimensional SIFT descriptors. The
+// instruction set is chosen at compile time, e.g., configure with
+// -march=native to enable the AVX2 or AVX-512 code path.
+inline int ComputeSiftDescriptorDotProduct(const int16_t* descriptor1,
+                                           const int16_t* descriptor2) {
+#if defined(__AVX512BW__)
+  __m512i sum = _mm512_setzero_si512();
+  for (int i = 0; i < 128; i += 32) {
+    sum = _mm512_add_epi32(
+        sum, _mm512_madd_epi16(_mm512_loadu_si512(descriptor1 + i),
+                               _mm512_loadu_si512(descriptor2 + i)));
+  }
+  return _mm512_reduce_add_epi32(sum);
+#elif defined(__AVX2__)
+  __m256i sum = _mm256_setzero_si256();
+  for (int i = 0; i < 128; i += 16) {
+    sum = _mm256_add_epi32(
+        sum,
+        _mm256_madd_epi16(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(descriptor1 + i)),
+            _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(descriptor2 + i))));
+  }
+  __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                 _mm256_extracti128_si256(sum, 1));
+  sum128 = _mm_add_epi32(sum128,
+                         _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum128 = _mm_add_epi32(sum128,
+                         _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum128);
+#elif defined(__SSE2__)
+  __m128i sum = _mm_setzero_si128();
+  for (int i = 0; i < 128; i += 8) {
+    sum = _mm_add_epi32(
+        sum,
+        _mm_madd_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(descriptor1 + i)),
+            _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(descriptor2 + i))));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+#else
+  int sum = 0;
+  for (int i = 0; i < 128; ++i) {
+    sum += descriptor1[i] * descriptor2[i];
+  }
+  return sum;
+#endif
+}
+
+// The best and second best match of a single descriptor, which is updated
+// incrementally as the candidate descriptors are visited in order.
+struct SiftBestMatch {
+  inline void Update(const int idx, const int dist) {
+    if (dist > best_dist) {
+      best_idx = idx;
+      second_best_dist = best_dist;
+      best_dist = dist;
+    } else if (dist > second_best_dist) {
+      second_best_dist = dist;
+    }
+  }
+
+  int best_idx = -1;
+  int best_dist = 0;
+  int second_best_dist = 0;
+};
+
+size_t FindBestMatchesOneWayBruteForce(
+    const std::vector<SiftBestMatch>& best_matches, const float max_ratio,
+    const float max_distance, std::vector<int>* matches) {
   // SIFT descriptor vectors are normalized to length 512.
   const float kDistNorm = 1.0f / (512.0f * 512.0f);
 
   size_t num_matches = 0;
-  matches->resize(dists.rows(), -1);
+  matches->resize(best_matches.size(), -1);
 
-  for (Eigen::Index i1 = 0; i1 < dists.rows(); ++i1) {
-    int best_i2 = -1;
-    int best_dist = 0;
-    int second_best_dist = 0;
-    for (Eigen::Index i2 = 0; i2 < dists.cols(); ++i2) {
-      const int dist = dists(i1, i2);
-      if (dist > best_dist) {
-        best_i2 = i2;
-        second_best_dist = best_dist;
-        best_dist = dist;
-      } else if (dist > second_best_dist) {
-        second_best_dist = dist;
-      }
-    }
+  for (size_t i1 = 0; i1 < best_matches.size(); ++i1) {
+    const SiftBestMatch& best_match = best_matches[i1];
 
     // Check if any match found.
-    if (best_i2 == -1) {
+    if (best_match.best_idx == -1) {
       continue;
     }
 
     const float best_dist_normed =
-        std::acos(std::min(kDistNorm * best_dist, 1.0f));
+        std::acos(std::min(kDistNorm * best_match.best_dist, 1.0f));
 
     // Check if match distance passes threshold.
     if (best_dist_normed > max_distance) {
@@ -88,7 +190,7 @@ size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
     }
 
     const float second_best_dist_normed =
-        std::acos(std::min(kDistNorm * second_best_dist, 1.0f));
+        std::acos(std::min(kDistNorm * best_match.second_best_dist, 1.0f));
 
     // Check if match passes ratio test. Keep this comparison >= in order to
     // ensure that the case of best == second_best is detected.
@@ -97,26 +199,78 @@ size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
     }
 
     num_matches += 1;
-    (*matches)[i1] = best_i2;
+    (*matches)[i1] = best_match.best_idx;
   }
 
   return num_matches;
 }
 
-void FindBestMatchesBruteForce(const Eigen::MatrixXi& dists,
-                               const float max_ratio, const float max_distance,
-                               const bool cross_check,
-                               FeatureMatches* matches) {
+// Brute-force matching of all pairs of descriptors. The descriptors are
+// compared tile by tile and the best/second best matches in both directions
+// are accumulated on the fly, so that the full distance matrix is never
+// materialized. Pairs rejected by the optional guided filter are skipped.
+void FindBestMatchesBruteForce(
+    const FeatureKeypoints* keypoints1, const FeatureKeypoints* keypoints2,
+    const FeatureDescriptorsInt16& descriptors1_int16,
+    const FeatureDescriptorsInt16& descriptors2_int16,
+    const std::function<bool(float, float, float, float)>& guided_filter,
+    const float max_ratio, const float max_distance, const bool cross_check,
+    FeatureMatches* matches) {
+  if (guided_filter != nullptr) {
+    CHECK_NOTNULL(keypoints1);
+    CHECK_NOTNULL(keypoints2);
+    CHECK_EQ(keypoints1->size(), descriptors1_int16.rows());
+    CHECK_EQ(keypoints2->size(), descriptors2_int16.rows());
+  }
+
   matches->clear();
 
+  const int num_descriptors1 = static_cast<int>(descriptors1_int16.rows());
+  const int num_descriptors2 = static_cast<int>(descriptors2_int16.rows());
+
+  std::vector<SiftBestMatch> best_matches12(num_descriptors1);
+  std::vector<SiftBestMatch> best_matches21(cross_check ? num_descriptors2
+                                                        : 0);
+
+  // Note that the tiles are traversed such that each descriptor sees its
+  // candidates in ascending order, which yields the same tie-breaking as an
+  // exhaustive row-by-row scan.
+  for (int block_start1 = 0; block_start1 < num_descriptors1;
+       block_start1 += kBruteForceBlockSize1) {
+    const int block_end1 =
+        std::min(block_start1 + kBruteForceBlockSize1, num_descriptors1);
+    for (int block_start2 = 0; block_start2 < num_descriptors2;
+         block_start2 += kBruteForceBlockSize2) {
+      const int block_end2 =
+          std::min(block_start2 + kBruteForceBlockSize2, num_descriptors2);
+      for (int i1 = block_start1; i1 < block_end1; ++i1) {
+        const int16_t* descriptor1 = descriptors1_int16.row(i1).data();
+        SiftBestMatch& best_match12 = best_matches12[i1];
+        for (int i2 = block_start2; i2 < block_end2; ++i2) {
+          if (guided_filter != nullptr &&
+              guided_filter((*keypoints1)[i1].x, (*keypoints1)[i1].y,
+                            (*keypoints2)[i2].x, (*keypoints2)[i2].y)) {
+            continue;
+          }
+          const int dist = ComputeSiftDescriptorDotProduct(
+              descriptor1, descriptors2_int16.row(i2).data());
+          best_match12.Update(i2, dist);
+          if (cross_check) {
+            best_matches21[i2].Update(i1, dist);
+          }
+        }
+      }
+    }
+  }
+
   std::vector<int> matches12;
   const size_t num_matches12 = FindBestMatchesOneWayBruteForce(
-      dists, max_ratio, max_distance, &matches12);
+      best_matches12, max_ratio, max_distance, &matches12);
 
   if (cross_check) {
     std::vector<int> matches21;
     const size_t num_matches21 = FindBestMatchesOneWayBruteForce(
-        dists.transpose(), max_ratio, max_distance, &matches21);
+        best_matches21, max_ratio, max_distance, &matches21);
     matches->reserve(std::min(num_matches12, num_matches21));
     for (size_t i1 = 0; i1 < matches12.size(); ++i1) {
       if (matches12[i1] != -1 && matches21[matches12[i1]] != -1 &&
@@ -165,49 +319,33 @@ FeatureDescriptors TransformVLFeatToUBCFeatureDescriptors(
   return ubc_descriptors;
 }
 
-Eigen::MatrixXi ComputeSiftDistanceMatrix(
-    const FeatureKeypoints* keypoints1, const FeatureKeypoints* keypoints2,
-    const FeatureDescriptors& descriptors1,
-    const FeatureDescriptors& descriptors2,
-    const std::function<bool(float, float, float, float)>& guided_filter) {
-  if (guided_filter != nullptr) {
-    CHECK_NOTNULL(keypoints1);
-    CHECK_NOTNULL(keypoints2);
-    CHECK_EQ(keypoints1->size(), descriptors1.rows());
-    CHECK_EQ(keypoints2->size(), descriptors2.rows());
-  }
-
-  const Eigen::Matrix<int, Eigen::Dynamic, 128> descriptors1_int =
-      descriptors1.cast<int>();
-  const Eigen::Matrix<int, Eigen::Dynamic, 128> descriptors2_int =
-      descriptors2.cast<int>();
-
-  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> dists(
-      descriptors1.rows(), descriptors2.rows());
+FeatureDescriptorsView CreateFeatureDescriptorsView(
+    const std::shared_ptr<const FeatureDescriptors>& descriptors) {
+  CHECK(descriptors);
+  return FeatureDescriptorsView(descriptors->data(), descriptors->rows(),
+                                descriptors->cols());
+}
 
-  for (FeatureDescriptors::Index i1 = 0; i1 < descriptors1.rows(); ++i1) {
-    for (FeatureDescriptors::Index i2 = 0; i2 < descriptors2.rows(); ++i2) {
-      if (guided_filter != nullptr &&
-          guided_filter((*keypoints1)[i1].x, (*keypoints1)[i1].y,
-                        (*keypoints2)[i2].x, (*keypoints2)[i2].y)) {
-        dists(i1, i2) = 0;
-      } else {
-        dists(i1, i2) = descriptors1_int.row(i1).dot(descriptors2_int.row(i2));
-      }
-    }
+std::unique_ptr<SiftMatchingDescriptors::FLANNIndex> CreateFLANNIndex(
+    const Eigen::Ref<const FeatureDescriptors>& descriptors) {
+  if (descriptors.rows() == 0) {
+    return nullptr;
   }
-
-  return dists;
+  return std::unique_ptr<SiftMatchingDescriptors::FLANNIndex>(
+      new SiftMatchingDescriptors::FLANNIndex(descriptors));
 }
 
+// Find the nearest neighbors of the query descriptors in the FLANN index of
+// the database descriptors, which may be null if there are no descriptors.
 void FindBestMatchesOneWayFLANN(
-    const FeatureDescriptors& query, const FeatureDescriptors& database,
+    const Eigen::Ref<const FeatureDescriptors>& query,
+    const Eigen::Ref<const FeatureDescriptors>& database,
+    const SiftMatchingDescriptors::FLANNIndex* database_index,
     Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>*
         indices,
     Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>*
         distances) {
   const size_t kNumNearestNeighbors = 2;
-  const size_t kNumTreesInForest = 4;
 
   indices->resize(query.rows(), std::min(kNumNearestNeighbors,
                                          static_cast<size_t>(database.rows())));
@@ -216,23 +354,20 @@ void FindBestMatchesOneWayFLANN(
       std::min(kNumNearestNeighbors, static_cast<size_t>(database.rows())));
   const flann::Matrix<uint8_t> query_matrix(const_cast<uint8_t*>(query.data()),
                                             query.rows(), 128);
-  const flann::Matrix<uint8_t> database_matrix(
-      const_cast<uint8_t*>(database.data()), database.rows(), 128);
 
   if (query.rows() == 0 || database.rows() == 0) {
     return;
   }
 
+  CHECK_NOTNULL(database_index);
+
   flann::Matrix<int> indices_matrix(indices->data(), query.rows(),
                                     kNumNearestNeighbors);
   std::vector<float> distances_vector(query.rows() * kNumNearestNeighbors);
   flann::Matrix<float> distances_matrix(distances_vector.data(), query.rows(),
                                         kNumNearestNeighbors);
-  flann::Index<flann::L2<uint8_t>> index(
-      database_matrix, flann::KDTreeIndexParams(kNumTreesInForest));
-  index.buildIndex();
-  index.knnSearch(query_matrix, indices_matrix, distances_matrix,
-                  kNumNearestNeighbors, flann::SearchParams(128));
+  database_index->knnSearch(query_matrix, indices_matrix, distances_matrix,
+                            kNumNearestNeighbors, flann::SearchParams(128));
 
   for (Eigen::Index query_index = 0; query_index < indices->rows();
        ++query_index) {
@@ -348,6 +483,90 @@ void FindBestMatchesFLANN(
   }
 }
 
+void MatchSiftFeaturesFLANN(
+    const SiftMatchingOptions& match_options,
+    const Eigen::Ref<const FeatureDescriptors>& descriptors1,
+    const Eigen::Ref<const FeatureDescriptors>& descriptors2,
+    const SiftMatchingDescriptors::FLANNIndex* index1,
+    const SiftMatchingDescriptors::FLANNIndex* index2,
+    FeatureMatches* matches) {
+  CHECK(match_options.Check());
+  CHECK_NOTNULL(matches);
+
+  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      indices_1to2;
+  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      distances_1to2;
+  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      indices_2to1;
+  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      distances_2to1;
+
+  FindBestMatchesOneWayFLANN(descriptors1, descriptors2, index2,
+                             &indices_1to2, &distances_1to2);
+  if (match_options.cross_check) {
+    FindBestMatchesOneWayFLANN(descriptors2, descriptors1, index1,
+                               &indices_2to1, &distances_2to1);
+  }
+
+  FindBestMatchesFLANN(indices_1to2, distances_1to2, indices_2to1,
+                       distances_2to1, match_options.max_ratio,
+                       match_options.max_distance, match_options.cross_check,
+                       matches);
+}
+
+void MatchGuidedSiftFeaturesBruteForce(
+    const SiftMatchingOptions& match_options,
+    const FeatureKeypoints& keypoints1, const FeatureKeypoints& keypoints2,
+    const FeatureDescriptorsInt16& descriptors1_int16,
+    const FeatureDescriptorsInt16& descriptors2_int16,
+    TwoViewGeometry* two_view_geometry) {
+  CHECK(match_options.Check());
+  CHECK_NOTNULL(two_view_geometry);
+
+  const float max_residual = match_options.max_error * match_options.max_error;
+
+  const Eigen::Matrix3f F = two_view_geometry->F.cast<float>();
+  const Eigen::Matrix3f H = two_view_geometry->H.cast<float>();
+
+  std::function<bool(float, float, float, float)> guided_filter;
+  if (two_view_geometry->config == TwoViewGeometry::CALIBRATED ||
+      two_view_geometry->config == TwoViewGeometry::UNCALIBRATED) {
+    guided_filter = [&](const float x1, const float y1, const float x2,
+                        const float y2) {
+      const Eigen::Vector3f p1(x1, y1, 1.0f);
+      const Eigen::Vector3f p2(x2, y2, 1.0f);
+      const Eigen::Vector3f Fx1 = F * p1;
+      const Eigen::Vector3f Ftx2 = F.transpose() * p2;
+      const float x2tFx1 = p2.transpose() * Fx1;
+      return x2tFx1 * x2tFx1 /
+                 (Fx1(0) * Fx1(0) + Fx1(1) * Fx1(1) + Ftx2(0) * Ftx2(0) +
+                  Ftx2(1) * Ftx2(1)) >
+             max_residual;
+    };
+  } else if (two_view_geometry->config == TwoViewGeometry::PLANAR ||
+             two_view_geometry->config == TwoViewGeometry::PANORAMIC ||
+             two_view_geometry->config ==
+                 TwoViewGeometry::PLANAR_OR_PANORAMIC) {
+    guided_filter = [&](const float x1, const float y1, const float x2,
+                        const float y2) {
+      const Eigen::Vector3f p1(x1, y1, 1.0f);
+      const Eigen::Vector2f p2(x2, y2);
+      return ((H * p1).hnormalized() - p2).squaredNorm() > max_residual;
+    };
+  } else {
+    return;
+  }
+
+  CHECK(guided_filter);
+
+  FindBestMatchesBruteForce(&keypoints1, &keypoints2, descriptors1_int16,
+                            descriptors2_int16, guided_filter,
+                            match_options.max_ratio, match_options.max_distance,
+                            match_options.cross_check,
+                            &two_view_geometry->inlier_matches);
+}
+
 void WarnIfMaxNumMatchesReachedGPU(const SiftMatchGPU& sift_match_gpu,
                                    const FeatureDescriptors& descriptors) {
   if (sift_match_gpu.GetMaxSift() < descriptors.rows()) {
@@ -364,6 +583,158 @@ void WarnDarknessAdaptivityNotAvailable() {
             << std::endl;
 }
 
+// Compute the gradient of the current octave by computing the orientations of a
+// keypoint in the center of the octave. The given keypoint must be detected in
+// the current octave.
+void UpdateSiftGradient(VlSiftFilt* sift, const VlSiftKeypoint& keypoint) {
+  const double scale = std::pow(2.0, vl_sift_get_octave_index(sift));
+  VlSiftKeypoint center_keypoint = keypoint;
+  center_keypoint.x = scale * (vl_sift_get_octave_width(sift) / 2);
+  center_keypoint.y = scale * (vl_sift_get_octave_height(sift) / 2);
+  center_keypoint.is = sift->s_min + 1;
+  double angles[4];
+  vl_sift_calc_keypoint_orientations(sift, angles, &center_keypoint);
+}
+
+// Extract the features of an image in overlapping tiles, which bounds the
+// memory of the scale space. The tile offsets are aligned to the sampling grid
+// of the coarsest octave and the margins cover the support of the largest
+// keypoints, such that a tile produces the same features as the whole image
+// in its interior, up to floating point rounding of the keypoint locations.
+// Every feature is kept only by the tile whose interior contains it, which
+// removes the duplicates in the overlapping margins.
+bool ExtractSiftFeaturesCPUTiled(const SiftExtractionOptions& options,
+                                 const Bitmap& bitmap,
+                                 FeatureKeypoints* keypoints,
+                                 FeatureDescriptors* descriptors) {
+  const int last_octave = options.first_octave + options.num_octaves - 1;
+  const int alignment = 1 << std::max(0, last_octave);
+  const double max_sigma = 1.6 *
+                           std::pow(2.0, 1.0 / options.octave_resolution) *
+                           std::pow(2.0, last_octave + 1);
+  const int margin =
+      alignment * static_cast<int>(std::ceil(kSiftTileMarginFactor *
+                                             max_sigma / alignment));
+
+  // Largest tile including the margins that satisfies the memory limit.
+  const double num_bytes_per_pixel =
+      EstimateSiftExtractionMemory(options, 1024, 1024) / (1024.0 * 1024.0);
+  const int max_tile_size = static_cast<int>(std::sqrt(
+      options.max_tile_memory * 1024 * 1024 * 1024 / num_bytes_per_pixel));
+  const int tile_size =
+      alignment * ((max_tile_size - 2 * margin) / alignment);
+  if (tile_size <= 0) {
+    std::cerr << StringPrintf(
+                     "ERROR: Tile memory of %.3fGB is too small for the tile "
+                     "margin of %dpx.",
+                     options.max_tile_memory, margin)
+              << std::endl;
+    return false;
+  }
+
+  SiftExtractionOptions tile_options = options;
+  tile_options.max_tile_memory = 0;
+  tile_options.max_num_features = std::numeric_limits<int>::max();
+
+  // The features in the interior of all tiles, where the descriptors of each
+  // tile are stored in a separate matrix to avoid reallocations.
+  FeatureKeypoints tiled_keypoints;
+  std::vector<FeatureDescriptors> tiled_descriptors;
+
+  for (int tile_y = 0; tile_y < bitmap.Height(); tile_y += tile_size) {
+    for (int tile_x = 0; tile_x < bitmap.Width(); tile_x += tile_size) {
+      const int min_x = std::max(0, tile_x - margin);
+      const int min_y = std::max(0, tile_y - margin);
+      const int max_x = std::min(bitmap.Width(), tile_x + tile_size + margin);
+      const int max_y = std::min(bitmap.Height(), tile_y + tile_size + margin);
+
+      // Copy the tile by scanlines, which is much faster than by pixels for
+      // very large images. FreeImage stores the scanlines bottom-up.
+      Bitmap tile;
+      tile.Allocate(max_x - min_x, max_y - min_y, !bitmap.IsGrey());
+      const size_t num_pixel_bytes = bitmap.BitsPerPixel() / 8;
+      const size_t num_tile_line_bytes = num_pixel_bytes * tile.Width();
+      for (int y = min_y; y < max_y; ++y) {
+        memcpy(FreeImage_GetScanLine(tile.Data(), max_y - 1 - y),
+               bitmap.GetScanline(y) + num_pixel_bytes * min_x,
+               num_tile_line_bytes);
+      }
+
+      FeatureKeypoints tile_keypoints;
+      FeatureDescriptors tile_descriptors;
+      if (!ExtractSiftFeaturesCPU(
+              tile_options, tile, &tile_keypoints,
+              descriptors == nullptr ? nullptr : &tile_descriptors)) {
+        return false;
+      }
+
+      size_t num_interior_features = 0;
+      for (size_t i = 0; i < tile_keypoints.size(); ++i) {
+        FeatureKeypoint keypoint = tile_keypoints[i];
+        keypoint.x += min_x;
+        keypoint.y += min_y;
+        if (keypoint.x >= tile_x && keypoint.x < tile_x + tile_size &&
+            keypoint.y >= tile_y && keypoint.y < tile_y + tile_size) {
+          tiled_keypoints.push_back(keypoint);
+          if (descriptors != nullptr) {
+            tile_descriptors.row(num_interior_features) =
+                tile_descriptors.row(i);
+          }
+          num_interior_features += 1;
+        }
+      }
+
+      if (descriptors != nullptr) {
+        tile_descriptors.conservativeResize(num_interior_features, 128);
+        tiled_descriptors.push_back(std::move(tile_descriptors));
+      }
+    }
+  }
+
+  // Keep the features with the largest scales to satisfy max_num_features.
+  float min_scale = 0;
+  if (tiled_keypoints.size() > static_cast<size_t>(options.max_num_features)) {
+    std::vector<float> scales(tiled_keypoints.size());
+    for (size_t i = 0; i < tiled_keypoints.size(); ++i) {
+      scales[i] = tiled_keypoints[i].ComputeScale();
+    }
+    std::nth_element(scales.begin(),
+                     scales.begin() + options.max_num_features - 1,
+                     scales.end(), std::greater<float>());
+    min_scale = scales[options.max_num_features - 1];
+  }
+
+  std::vector<size_t> kept_indices;
+  kept_indices.reserve(tiled_keypoints.size());
+  for (size_t i = 0; i < tiled_keypoints.size(); ++i) {
+    if (tiled_keypoints[i].ComputeScale() >= min_scale) {
+      kept_indices.push_back(i);
+    }
+  }
+
+  keypoints->resize(kept_indices.size());
+  for (size_t i = 0; i < kept_indices.size(); ++i) {
+    (*keypoints)[i] = tiled_keypoints[kept_indices[i]];
+  }
+
+  if (descriptors != nullptr) {
+    descriptors->resize(kept_indices.size(), 128);
+    size_t tile_idx = 0;
+    size_t tile_begin = 0;
+    for (size_t i = 0; i < kept_indices.size(); ++i) {
+      while (kept_indices[i] >=
+             tile_begin + tiled_descriptors[tile_idx].rows()) {
+        tile_begin += tiled_descriptors[tile_idx].rows();
+        tile_idx += 1;
+      }
+      descriptors->row(i) =
+          tiled_descriptors[tile_idx].row(kept_indices[i] - tile_begin);
+    }
+  }
+
+  return true;
+}
+
 }  // namespace
 
 bool SiftExtractionOptions::Check() const {
@@ -376,6 +747,7 @@ bool SiftExtractionOptions::Check() const {
   CHECK_OPTION_GT(peak_threshold, 0.0);
   CHECK_OPTION_GT(edge_threshold, 0.0);
   CHECK_OPTION_GT(max_num_orientations, 0);
+  CHECK_OPTION_GE(max_tile_memory, 0.0);
   if (domain_size_pooling) {
     CHECK_OPTION_GT(dsp_min_scale, 0);
     CHECK_OPTION_GE(dsp_max_scale, dsp_min_scale);
@@ -397,9 +769,25 @@ bool SiftMatchingOptions::Check() const {
   CHECK_OPTION_GE(min_inlier_ratio, 0);
   CHECK_OPTION_LE(min_inlier_ratio, 1);
   CHECK_OPTION_GE(min_num_inliers, 0);
+  CHECK_OPTION_GT(write_batch_size, 0);
   return true;
 }
 
+size_t EstimateSiftExtractionMemory(const SiftExtractionOptions& options,
+                                    const int width, const int height) {
+  // The first octave dominates the memory of the scale space. VLFeat stores
+  // a temporary buffer and per level the Gaussian, the difference of
+  // Gaussians, and the two gradient components.
+  const double octave_scale = std::pow(2.0, -2 * options.first_octave);
+  const int num_octave_floats = 4 * options.octave_resolution + 10;
+  // The 8-bit and floating point copies of the input image.
+  const int num_image_bytes = sizeof(uint8_t) + sizeof(float);
+  const double num_pixels = static_cast<double>(width) * height;
+  return static_cast<size_t>(
+      num_pixels *
+      (octave_scale * num_octave_floats * sizeof(float) + num_image_bytes));
+}
+
 bool ExtractSiftFeaturesCPU(const SiftExtractionOptions& options,
                             const Bitmap& bitmap, FeatureKeypoints* keypoints,
                             FeatureDescriptors* descriptors) {
@@ -410,6 +798,13 @@ bool ExtractSiftFeaturesCPU(const SiftExtractionOptions& options,
   CHECK(!options.estimate_affine_shape);
   CHECK(!options.domain_size_pooling);
 
+  if (options.max_tile_memory > 0 &&
+      EstimateSiftExtractionMemory(options, bitmap.Width(), bitmap.Height()) >
+          options.max_tile_memory * 1024 * 1024 * 1024) {
+    return ExtractSiftFeaturesCPUTiled(options, bitmap, keypoints,
+                                       descriptors);
+  }
+
   if (options.darkness_adaptivity) {
     WarnDarknessAdaptivityNotAvailable();
   }
@@ -426,6 +821,15 @@ bool ExtractSiftFeaturesCPU(const SiftExtractionOptions& options,
   vl_sift_set_peak_thresh(sift.get(), options.peak_threshold);
   vl_sift_set_edge_thresh(sift.get(), options.edge_threshold);
 
+  // The keypoints of an octave are processed in parallel, which produces the
+  // same features as the sequential extraction.
+  std::unique_ptr<ThreadPool> thread_pool;
+  const int num_image_threads =
+      GetEffectiveNumThreads(options.num_threads_per_image);
+  if (num_image_threads > 1) {
+    thread_pool.reset(new ThreadPool(num_image_threads));
+  }
+
   // Iterate through octaves.
   std::vector<size_t> level_num_features;
   std::vector<FeatureKeypoints> level_keypoints;
@@ -458,6 +862,83 @@ bool ExtractSiftFeaturesCPU(const SiftExtractionOptions& options,
       continue;
     }
 
+    // Compute the orientations and descriptors of all keypoints in the octave.
+    std::vector<int> num_orientations(num_keypoints);
+    std::vector<std::array<double, 4>> orientations(num_keypoints);
+    FeatureDescriptors octave_descriptors;
+    if (descriptors != nullptr) {
+      octave_descriptors.resize(options.max_num_orientations * num_keypoints,
+                                128);
+    }
+
+    auto ComputeOrientationsAndDescriptors = [&](const int begin,
+                                                 const int end) {
+      for (int i = begin; i < end; ++i) {
+        // Extract feature orientations.
+        if (options.upright) {
+          num_orientations[i] = 1;
+          orientations[i][0] = 0.0;
+        } else {
+          num_orientations[i] = vl_sift_calc_keypoint_orientations(
+              sift.get(), orientations[i].data(), &vl_keypoints[i]);
+        }
+
+        // Note that this is different from SiftGPU, which selects the top
+        // global maxima as orientations while this selects the first two
+        // local maxima. It is not clear which procedure is better.
+        num_orientations[i] =
+            std::min(num_orientations[i], options.max_num_orientations);
+
+        if (descriptors == nullptr) {
+          continue;
+        }
+
+        for (int o = 0; o < num_orientations[i]; ++o) {
+          Eigen::MatrixXf desc(1, 128);
+          vl_sift_calc_keypoint_descriptor(sift.get(), desc.data(),
+                                           &vl_keypoints[i],
+                                           orientations[i][o]);
+          if (options.normalization ==
+              SiftExtractionOptions::Normalization::L2) {
+            desc = L2NormalizeFeatureDescriptors(desc);
+          } else if (options.normalization ==
+                     SiftExtractionOptions::Normalization::L1_ROOT) {
+            desc = L1RootNormalizeFeatureDescriptors(desc);
+          } else {
+            LOG(FATAL) << "Normalization type not supported";
+          }
+
+          octave_descriptors.row(options.max_num_orientations * i + o) =
+              FeatureDescriptorsToUnsignedByte(desc);
+        }
+      }
+    };
+
+    if (thread_pool) {
+      // VLFeat lazily computes the gradient of the octave in the first call
+      // that needs it, so it must be updated before the parallel section.
+      UpdateSiftGradient(sift.get(), vl_keypoints[0]);
+      const int num_tasks =
+          std::min(num_keypoints,
+                   kNumSiftTasksPerThread *
+                       static_cast<int>(thread_pool->NumThreads()));
+      std::vector<std::future<void>> futures;
+      futures.reserve(num_tasks);
+      for (int t = 0; t < num_tasks; ++t) {
+        futures.push_back(thread_pool->AddTask(
+            ComputeOrientationsAndDescriptors,
+            static_cast<int>((static_cast<int64_t>(t) * num_keypoints) /
+                             num_tasks),
+            static_cast<int>((static_cast<int64_t>(t + 1) * num_keypoints) /
+                             num_tasks)));
+      }
+      for (auto& future : futures) {
+        future.get();
+      }
+    } else {
+      ComputeOrientationsAndDescriptors(0, num_keypoints);
+    }
+
     // Extract features with different orientations per DOG level.
     size_t level_idx = 0;
     int prev_level = -1;
@@ -485,45 +966,14 @@ bool ExtractSiftFeaturesCPU(const SiftExtractionOptions& options,
       level_num_features.back() += 1;
       prev_level = vl_keypoints[i].is;
 
-      // Extract feature orientations.
-      double angles[4];
-      int num_orientations;
-      if (options.upright) {
-        num_orientations = 1;
-        angles[0] = 0.0;
-      } else {
-        num_orientations = vl_sift_calc_keypoint_orientations(
-            sift.get(), angles, &vl_keypoints[i]);
-      }
-
-      // Note that this is different from SiftGPU, which selects the top
-      // global maxima as orientations while this selects the first two
-      // local maxima. It is not clear which procedure is better.
-      const int num_used_orientations =
-          std::min(num_orientations, options.max_num_orientations);
-
-      for (int o = 0; o < num_used_orientations; ++o) {
-        level_keypoints.back()[level_idx] =
-            FeatureKeypoint(vl_keypoints[i].x + 0.5f, vl_keypoints[i].y + 0.5f,
-                            vl_keypoints[i].sigma, angles[o]);
+      for (int o = 0; o < num_orientations[i]; ++o) {
+        level_keypoints.back()[level_idx] = FeatureKeypoint(
+            vl_keypoints[i].x + 0.5f, vl_keypoints[i].y + 0.5f,
+            vl_keypoints[i].sigma, orientations[i][o]);
         if (descriptors != nullptr) {
-          Eigen::MatrixXf desc(1, 128);
-          vl_sift_calc_keypoint_descriptor(sift.get(), desc.data(),
-                                           &vl_keypoints[i], angles[o]);
-          if (options.normalization ==
-              SiftExtractionOptions::Normalization::L2) {
-            desc = L2NormalizeFeatureDescriptors(desc);
-          } else if (options.normalization ==
-                     SiftExtractionOptions::Normalization::L1_ROOT) {
-            desc = L1RootNormalizeFeatureDescriptors(desc);
-          } else {
-            LOG(FATAL) << "Normalization type not supported";
-          }
-
           level_descriptors.back().row(level_idx) =
-              FeatureDescriptorsToUnsignedByte(desc);
+              octave_descriptors.row(options.max_num_orientations * i + o);
         }
-
         level_idx += 1;
       }
     }
@@ -965,48 +1415,36 @@ void MatchSiftFeaturesCPUBruteForce(const SiftMatchingOptions& match_options,
   CHECK(match_options.Check());
   CHECK_NOTNULL(matches);
 
-  const Eigen::MatrixXi distances = ComputeSiftDistanceMatrix(
-      nullptr, nullptr, descriptors1, descriptors2, nullptr);
-
-  FindBestMatchesBruteForce(distances, match_options.max_ratio,
-                            match_options.max_distance,
-                            match_options.cross_check, matches);
+  FindBestMatchesBruteForce(
+      nullptr, nullptr, FeatureDescriptorsInt16(descriptors1.cast<int16_t>()),
+      FeatureDescriptorsInt16(descriptors2.cast<int16_t>()), nullptr,
+      match_options.max_ratio, match_options.max_distance,
+      match_options.cross_check, matches);
 }
 
 void MatchSiftFeaturesCPUFLANN(const SiftMatchingOptions& match_options,
                                const FeatureDescriptors& descriptors1,
                                const FeatureDescriptors& descriptors2,
                                FeatureMatches* matches) {
-  CHECK(match_options.Check());
-  CHECK_NOTNULL(matches);
-
-  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      indices_1to2;
-  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      distances_1to2;
-  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      indices_2to1;
-  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      distances_2to1;
-
-  FindBestMatchesOneWayFLANN(descriptors1, descriptors2, &indices_1to2,
-                             &distances_1to2);
-  if (match_options.cross_check) {
-    FindBestMatchesOneWayFLANN(descriptors2, descriptors1, &indices_2to1,
-                               &distances_2to1);
-  }
-
-  FindBestMatchesFLANN(indices_1to2, distances_1to2, indices_2to1,
-                       distances_2to1, match_options.max_ratio,
-                       match_options.max_distance, match_options.cross_check,
-                       matches);
+  const auto index1 = match_options.cross_check
+                          ? CreateFLANNIndex(descriptors1)
+                          : nullptr;
+  const auto index2 = CreateFLANNIndex(descriptors2);
+  MatchSiftFeaturesFLANN(match_options, descriptors1, descriptors2,
+                         index1.get(), index2.get(), matches);
 }
 
 void MatchSiftFeaturesCPU(const SiftMatchingOptions& match_options,
                           const FeatureDescriptors& descriptors1,
                           const FeatureDescriptors& descriptors2,
                           FeatureMatches* matches) {
-  MatchSiftFeaturesCPUFLANN(match_options, descriptors1, descriptors2, matches);
+  if (match_options.cpu_brute_force_matcher) {
+    MatchSiftFeaturesCPUBruteForce(match_options, descriptors1, descriptors2,
+                                   matches);
+  } else {
+    MatchSiftFeaturesCPUFLANN(match_options, descriptors1, descriptors2,
+                              matches);
+  }
 }
 
 void MatchGuidedSiftFeaturesCPU(const SiftMatchingOptions& match_options,
@@ -1015,70 +1453,90 @@ void MatchGuidedSiftFeaturesCPU(const SiftMatchingOptions& match_options,
                                 const FeatureDescriptors& descriptors1,
                                 const FeatureDescriptors& descriptors2,
                                 TwoViewGeometry* two_view_geometry) {
-  CHECK(match_options.Check());
-  CHECK_NOTNULL(two_view_geometry);
-
-  const float max_residual = match_options.max_error * match_options.max_error;
+  MatchGuidedSiftFeaturesBruteForce(
+      match_options, keypoints1, keypoints2,
+      FeatureDescriptorsInt16(descriptors1.cast<int16_t>()),
+      FeatureDescriptorsInt16(descriptors2.cast<int16_t>()),
+      two_view_geometry);
+}
 
-  const Eigen::Matrix3f F = two_view_geometry->F.cast<float>();
-  const Eigen::Matrix3f H = two_view_geometry->H.cast<float>();
+SiftMatchingDescriptors::SiftMatchingDescriptors(
+    const SiftMatchingOptions& match_options,
+    const std::shared_ptr<const FeatureDescriptors>& descriptors)
+    : SiftMatchingDescriptors(match_options,
+                              CreateFeatureDescriptorsView(descriptors)) {
+  // Keep the descriptors alive, since the view and the index reference them.
+  descriptors_ = descriptors;
+}
 
-  std::function<bool(float, float, float, float)> guided_filter;
-  if (two_view_geometry->config == TwoViewGeometry::CALIBRATED ||
-      two_view_geometry->config == TwoViewGeometry::UNCALIBRATED) {
-    guided_filter = [&](const float x1, const float y1, const float x2,
-                        const float y2) {
-      const Eigen::Vector3f p1(x1, y1, 1.0f);
-      const Eigen::Vector3f p2(x2, y2, 1.0f);
-      const Eigen::Vector3f Fx1 = F * p1;
-      const Eigen::Vector3f Ftx2 = F.transpose() * p2;
-      const float x2tFx1 = p2.transpose() * Fx1;
-      return x2tFx1 * x2tFx1 /
-                 (Fx1(0) * Fx1(0) + Fx1(1) * Fx1(1) + Ftx2(0) * Ftx2(0) +
-                  Ftx2(1) * Ftx2(1)) >
-             max_residual;
-    };
-  } else if (two_view_geometry->config == TwoViewGeometry::PLANAR ||
-             two_view_geometry->config == TwoViewGeometry::PANORAMIC ||
-             two_view_geometry->config ==
-                 TwoViewGeometry::PLANAR_OR_PANORAMIC) {
-    guided_filter = [&](const float x1, const float y1, const float x2,
-                        const float y2) {
-      const Eigen::Vector3f p1(x1, y1, 1.0f);
-      const Eigen::Vector2f p2(x2, y2);
-      return ((H * p1).hnormalized() - p2).squaredNorm() > max_residual;
-    };
-  } else {
-    return;
+SiftMatchingDescriptors::SiftMatchingDescriptors(
+    const SiftMatchingOptions& match_options,
+    const FeatureDescriptorsView& descriptors)
+    : has_int16_descriptors_(match_options.cpu_brute_force_matcher ||
+                             match_options.guided_matching),
+      has_flann_index_(!match_options.cpu_brute_force_matcher),
+      descriptors_view_(descriptors) {
+  if (has_int16_descriptors_) {
+    descriptors_int16_ = descriptors_view_.cast<int16_t>();
+  }
+  if (has_flann_index_) {
+    flann_index_ = CreateFLANNIndex(descriptors_view_);
   }
+}
 
-  CHECK(guided_filter);
+SiftMatchingDescriptors::~SiftMatchingDescriptors() {}
 
-  const Eigen::MatrixXi dists = ComputeSiftDistanceMatrix(
-      &keypoints1, &keypoints2, descriptors1, descriptors2, guided_filter);
+const FeatureDescriptorsView& SiftMatchingDescriptors::Descriptors() const {
+  return descriptors_view_;
+}
 
-  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      indices_1to2(dists.rows(), dists.cols());
-  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      indices_2to1(dists.cols(), dists.rows());
-  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      distances_1to2 = dists;
-  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      distances_2to1 = dists.transpose();
+bool SiftMatchingDescriptors::HasInt16Descriptors() const {
+  return has_int16_descriptors_;
+}
 
-  for (int i = 0; i < indices_1to2.rows(); ++i) {
-    indices_1to2.row(i) = Eigen::VectorXi::LinSpaced(indices_1to2.cols(), 0,
-                                                     indices_1to2.cols() - 1);
-  }
-  for (int i = 0; i < indices_2to1.rows(); ++i) {
-    indices_2to1.row(i) = Eigen::VectorXi::LinSpaced(indices_2to1.cols(), 0,
-                                                     indices_2to1.cols() - 1);
+const SiftMatchingDescriptors::Int16Descriptors&
+SiftMatchingDescriptors::DescriptorsInt16() const {
+  CHECK(has_int16_descriptors_);
+  return descriptors_int16_;
+}
+
+bool SiftMatchingDescriptors::HasFLANNIndex() const { return has_flann_index_; }
+
+const SiftMatchingDescriptors::FLANNIndex* SiftMatchingDescriptors::Index()
+    const {
+  CHECK(has_flann_index_);
+  return flann_index_.get();
+}
+
+void MatchSiftFeaturesCPU(const SiftMatchingOptions& match_options,
+                          const SiftMatchingDescriptors& descriptors1,
+                          const SiftMatchingDescriptors& descriptors2,
+                          FeatureMatches* matches) {
+  if (match_options.cpu_brute_force_matcher) {
+    CHECK(match_options.Check());
+    CHECK_NOTNULL(matches);
+    FindBestMatchesBruteForce(nullptr, nullptr, descriptors1.DescriptorsInt16(),
+                              descriptors2.DescriptorsInt16(), nullptr,
+                              match_options.max_ratio,
+                              match_options.max_distance,
+                              match_options.cross_check, matches);
+  } else {
+    MatchSiftFeaturesFLANN(match_options, descriptors1.Descriptors(),
+                           descriptors2.Descriptors(), descriptors1.Index(),
+                           descriptors2.Index(), matches);
   }
+}
 
-  FindBestMatchesFLANN(indices_1to2, distances_1to2, indices_2to1,
-                       distances_2to1, match_options.max_ratio,
-                       match_options.max_distance, match_options.cross_check,
-                       &two_view_geometry->inlier_matches);
+void MatchGuidedSiftFeaturesCPU(const SiftMatchingOptions& match_options,
+                                const FeatureKeypoints& keypoints1,
+                                const FeatureKeypoints& keypoints2,
+                                const SiftMatchingDescriptors& descriptors1,
+                                const SiftMatchingDescriptors& descriptors2,
+                                TwoViewGeometry* two_view_geometry) {
+  MatchGuidedSiftFeaturesBruteForce(match_options, keypoints1, keypoints2,
+                                    descriptors1.DescriptorsInt16(),
+                                    descriptors2.DescriptorsInt16(),
+                                    two_view_geometry);
 }
 
 bool CreateSiftGPUMatcher(const SiftMatchingOptions& match_options,
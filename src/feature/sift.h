@@ -32,6 +32,8 @@
 #ifndef COLMAP_SRC_FEATURE_SIFT_H_
 #define COLMAP_SRC_FEATURE_SIFT_H_
 
+#include <memory>
+
 #include "estimators/two_view_geometry.h"
 #include "feature/types.h"
 #include "util/bitmap.h"
@@ -45,6 +47,23 @@ struct SiftExtractionOptions {
   // Number of threads for feature extraction.
   int num_threads = -1;
 
+  // Number of threads to extract the features of a single image on the CPU,
+  // which is useful for very large images. The extracted features are the
+  // same for any number of threads. If set to a value <= 0, the number of
+  // threads equals the number of available cores.
+  int num_threads_per_image = 1;
+
+  // Maximum memory in GB to extract the features of images on the CPU. Images
+  // that exceed this limit are split into overlapping tiles, which are
+  // processed one after another. The limit applies to each call of
+  // `ExtractSiftFeaturesCPU`, but the feature extractor divides it evenly
+  // among its CPU extraction threads, so that it bounds the memory of all
+  // concurrently extracted images. Note that the memory of the image itself
+  // and of the extracted features is not included. Set max_image_size to a
+  // sufficiently large value to extract features of very large images at full
+  // resolution. If set to 0, images are never split into tiles.
+  double max_tile_memory = 0.0;
+
   // Whether to use the GPU for feature extraction.
   bool use_gpu = true;
 
@@ -133,6 +152,10 @@ struct SiftMatchingOptions {
   // Whether to enable cross checking in matching.
   bool cross_check = true;
 
+  // Whether to use exact brute-force matching instead of approximate
+  // FLANN-based nearest neighbor search when matching on the CPU.
+  bool cpu_brute_force_matcher = false;
+
   // Maximum number of matches.
   int max_num_matches = 32768;
 
@@ -161,11 +184,22 @@ struct SiftMatchingOptions {
   // Whether to perform guided matching, if geometric verification succeeds.
   bool guided_matching = false;
 
+  // The maximum number of image pairs to write to the database in one
+  // transaction. The results are written asynchronously in a separate thread
+  // and up to twice as many image pairs are buffered in memory.
+  int write_batch_size = 1000;
+
   bool Check() const;
 };
 
+// Estimate the peak memory in bytes of the CPU SIFT extraction for an image of
+// the given size without splitting it into tiles.
+size_t EstimateSiftExtractionMemory(const SiftExtractionOptions& options,
+                                    const int width, const int height);
+
 // Extract SIFT features for the given image on the CPU. Only extract
-// descriptors if the given input is not NULL.
+// descriptors if the given input is not NULL. If the image exceeds the memory
+// limit, it is split into tiles, see `SiftExtractionOptions::max_tile_memory`.
 bool ExtractSiftFeaturesCPU(const SiftExtractionOptions& options,
                             const Bitmap& bitmap, FeatureKeypoints* keypoints,
                             FeatureDescriptors* descriptors);
@@ -210,7 +244,11 @@ void LoadSiftFeaturesFromTextFile(const std::string& path,
                                   FeatureKeypoints* keypoints,
                                   FeatureDescriptors* descriptors);
 
-// Match the given SIFT features on the CPU.
+// Match the given SIFT features on the CPU. The brute-force matcher compares
+// all pairs of descriptors in cache-sized tiles using SIMD dot products and
+// applies the ratio test and cross check without materializing the full
+// distance matrix. `MatchSiftFeaturesCPU` dispatches to the brute-force or
+// FLANN matcher depending on `cpu_brute_force_matcher`.
 void MatchSiftFeaturesCPUBruteForce(const SiftMatchingOptions& match_options,
                                     const FeatureDescriptors& descriptors1,
                                     const FeatureDescriptors& descriptors2,
@@ -230,6 +268,63 @@ void MatchGuidedSiftFeaturesCPU(const SiftMatchingOptions& match_options,
                                 const FeatureDescriptors& descriptors2,
                                 TwoViewGeometry* two_view_geometry);
 
+// Descriptors of one image prepared for matching on the CPU. Every image is
+// typically matched against many other images, so the widened descriptors of
+// the brute-force matcher and the FLANN index are computed once per image and
+// then shared across all its image pairs. Which of them are prepared depends
+// on the matching options, which must therefore be the same for matching.
+class SiftMatchingDescriptors {
+ public:
+  typedef Eigen::Matrix<int16_t, Eigen::Dynamic, 128, Eigen::RowMajor>
+      Int16Descriptors;
+
+  // Opaque FLANN index, which is only defined in the implementation.
+  class FLANNIndex;
+
+  SiftMatchingDescriptors(
+      const SiftMatchingOptions& match_options,
+      const std::shared_ptr<const FeatureDescriptors>& descriptors);
+
+  // Prepare descriptors that are owned elsewhere, e.g., in the memory-mapped
+  // feature store, without copying them. The data must outlive this object.
+  SiftMatchingDescriptors(const SiftMatchingOptions& match_options,
+                          const FeatureDescriptorsView& descriptors);
+  ~SiftMatchingDescriptors();
+
+  const FeatureDescriptorsView& Descriptors() const;
+
+  // Descriptors widened to 16-bit integers for the brute-force matcher, which
+  // are prepared for brute-force or guided matching.
+  bool HasInt16Descriptors() const;
+  const Int16Descriptors& DescriptorsInt16() const;
+
+  // Index for the FLANN matcher, which is prepared if the brute-force matcher
+  // is disabled. Null if there are no descriptors.
+  bool HasFLANNIndex() const;
+  const FLANNIndex* Index() const;
+
+ private:
+  bool has_int16_descriptors_;
+  bool has_flann_index_;
+  std::shared_ptr<const FeatureDescriptors> descriptors_;
+  FeatureDescriptorsView descriptors_view_;
+  Int16Descriptors descriptors_int16_;
+  std::unique_ptr<FLANNIndex> flann_index_;
+};
+
+// Match the prepared SIFT features on the CPU. Produces the same results as
+// the above functions, apart from the randomization of the FLANN index.
+void MatchSiftFeaturesCPU(const SiftMatchingOptions& match_options,
+                          const SiftMatchingDescriptors& descriptors1,
+                          const SiftMatchingDescriptors& descriptors2,
+                          FeatureMatches* matches);
+void MatchGuidedSiftFeaturesCPU(const SiftMatchingOptions& match_options,
+                                const FeatureKeypoints& keypoints1,
+                                const FeatureKeypoints& keypoints2,
+                                const SiftMatchingDescriptors& descriptors1,
+                                const SiftMatchingDescriptors& descriptors2,
+                                TwoViewGeometry* two_view_geometry);
+
 // Create a SiftGPU feature matcher. Note that if CUDA is not available or the
 // gpu_index is -1, the OpenGLContextManager must be created in the main thread
 // of the Qt application before calling this function. The same SiftMatchGPU
@@ -0,0 +1,199 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include <iostream>
+
+#include "feature/sift.h"
+#include "feature/utils.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/random.h"
+#include "util/timer.h"
+
+using namespace colmap;
+
+namespace {
+
+FeatureDescriptors CreateRandomFeatureDescriptors(const size_t num_features) {
+  Eigen::MatrixXf descriptors(num_features, 128);
+  for (size_t i = 0; i < num_features; ++i) {
+    for (size_t j = 0; j < 128; ++j) {
+      descriptors(i, j) = std::pow(RandomReal(0.0f, 1.0f), 2);
+    }
+  }
+  return FeatureDescriptorsToUnsignedByte(
+      L2NormalizeFeatureDescriptors(descriptors));
+}
+
+// Reference implementation of the previous brute-force matcher, which first
+// computes the dense integer distance matrix and then scans it in both
+// directions. Only used to compare the run time and the matches.
+void MatchSiftFeaturesDistanceMatrix(const SiftMatchingOptions& match_options,
+                                     const FeatureDescriptors& descriptors1,
+                                     const FeatureDescriptors& descriptors2,
+                                     FeatureMatches* matches) {
+  const float kDistNorm = 1.0f / (512.0f * 512.0f);
+
+  const Eigen::Matrix<int, Eigen::Dynamic, 128> descriptors1_int =
+      descriptors1.cast<int>();
+  const Eigen::Matrix<int, Eigen::Dynamic, 128> descriptors2_int =
+      descriptors2.cast<int>();
+  const Eigen::MatrixXi dists =
+      descriptors1_int * descriptors2_int.transpose();
+
+  auto FindBestMatchesOneWay = [&](const Eigen::MatrixXi& dists,
+                                   std::vector<int>* matches) {
+    matches->resize(dists.rows(), -1);
+    for (Eigen::Index i1 = 0; i1 < dists.rows(); ++i1) {
+      int best_i2 = -1;
+      int best_dist = 0;
+      int second_best_dist = 0;
+      for (Eigen::Index i2 = 0; i2 < dists.cols(); ++i2) {
+        const int dist = dists(i1, i2);
+        if (dist > best_dist) {
+          best_i2 = i2;
+          second_best_dist = best_dist;
+          best_dist = dist;
+        } else if (dist > second_best_dist) {
+          second_best_dist = dist;
+        }
+      }
+      if (best_i2 == -1) {
+        continue;
+      }
+      const float best_dist_normed =
+          std::acos(std::min(kDistNorm * best_dist, 1.0f));
+      if (best_dist_normed > match_options.max_distance) {
+        continue;
+      }
+      const float second_best_dist_normed =
+          std::acos(std::min(kDistNorm * second_best_dist, 1.0f));
+      if (best_dist_normed >=
+          match_options.max_ratio * second_best_dist_normed) {
+        continue;
+      }
+      (*matches)[i1] = best_i2;
+    }
+  };
+
+  std::vector<int> matches12;
+  std::vector<int> matches21;
+  FindBestMatchesOneWay(dists, &matches12);
+  if (match_options.cross_check) {
+    FindBestMatchesOneWay(dists.transpose(), &matches21);
+  }
+
+  matches->clear();
+  for (size_t i1 = 0; i1 < matches12.size(); ++i1) {
+    if (matches12[i1] == -1) {
+      continue;
+    }
+    if (match_options.cross_check &&
+        matches21[matches12[i1]] != static_cast<int>(i1)) {
+      continue;
+    }
+    FeatureMatch match;
+    match.point2D_idx1 = i1;
+    match.point2D_idx2 = matches12[i1];
+    matches->push_back(match);
+  }
+}
+
+template <typename MatchFunc>
+double TimeMatching(const int num_repetitions, const MatchFunc& match_func) {
+  Timer timer;
+  timer.Start();
+  for (int i = 0; i < num_repetitions; ++i) {
+    match_func();
+  }
+  return timer.ElapsedSeconds() / num_repetitions;
+}
+
+}  // namespace
+
+// Micro-benchmark of the CPU brute-force SIFT matcher against the previous
+// dense distance matrix implementation and the approximate FLANN matcher.
+int main(int argc, char** argv) {
+  InitializeGlog(argv);
+
+  SetPRNGSeed(0);
+
+  const int kNumRepetitions = 3;
+
+  SiftMatchingOptions match_options;
+  match_options.use_gpu = false;
+
+  std::cout << StringPrintf("%10s %12s %12s %12s %10s", "features",
+                            "dist_matrix", "brute_force", "flann", "speedup")
+            << std::endl;
+
+  for (const int num_features : {1000, 2000, 4000, 8000}) {
+    const FeatureDescriptors descriptors1 =
+        CreateRandomFeatureDescriptors(num_features);
+    FeatureDescriptors descriptors2 =
+        CreateRandomFeatureDescriptors(num_features);
+    // Make half of the features matchable.
+    descriptors2.topRows(num_features / 2) =
+        descriptors1.topRows(num_features / 2);
+
+    FeatureMatches matches_reference;
+    FeatureMatches matches_brute_force;
+    FeatureMatches matches_flann;
+
+    const double time_reference = TimeMatching(kNumRepetitions, [&]() {
+      MatchSiftFeaturesDistanceMatrix(match_options, descriptors1,
+                                      descriptors2, &matches_reference);
+    });
+    const double time_brute_force = TimeMatching(kNumRepetitions, [&]() {
+      MatchSiftFeaturesCPUBruteForce(match_options, descriptors1, descriptors2,
+                                     &matches_brute_force);
+    });
+    const double time_flann = TimeMatching(kNumRepetitions, [&]() {
+      MatchSiftFeaturesCPUFLANN(match_options, descriptors1, descriptors2,
+                                &matches_flann);
+    });
+
+    CHECK_EQ(matches_reference.size(), matches_brute_force.size());
+    for (size_t i = 0; i < matches_reference.size(); ++i) {
+      CHECK_EQ(matches_reference[i].point2D_idx1,
+               matches_brute_force[i].point2D_idx1);
+      CHECK_EQ(matches_reference[i].point2D_idx2,
+               matches_brute_force[i].point2D_idx2);
+    }
+
+    std::cout << StringPrintf("%10d %11.4fs %11.4fs %11.4fs %9.2fx",
+                              num_features, time_reference, time_brute_force,
+                              time_flann, time_reference / time_brute_force)
+              << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
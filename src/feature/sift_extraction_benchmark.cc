@@ -0,0 +1,117 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include <iostream>
+#include <limits>
+
+#include "feature/sift.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/random.h"
+#include "util/threading.h"
+#include "util/timer.h"
+
+using namespace colmap;
+
+namespace {
+
+// Smoothed random noise, which produces a dense set of SIFT features.
+void CreateRandomBitmap(const int width, const int height, Bitmap* bitmap) {
+  bitmap->Allocate(width, height, false);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      bitmap->SetPixel(x, y, BitmapColor<uint8_t>(RandomInteger(0, 255)));
+    }
+  }
+  bitmap->Smooth(2, 2);
+}
+
+double TimeExtraction(const SiftExtractionOptions& options,
+                      const Bitmap& bitmap, FeatureKeypoints* keypoints,
+                      FeatureDescriptors* descriptors) {
+  Timer timer;
+  timer.Start();
+  CHECK(ExtractSiftFeaturesCPU(options, bitmap, keypoints, descriptors));
+  return timer.ElapsedSeconds();
+}
+
+}  // namespace
+
+// Benchmark of the CPU SIFT extraction time per megapixel, when processing
+// the keypoints of a single image sequentially and in parallel.
+int main(int argc, char** argv) {
+  InitializeGlog(argv);
+
+  SetPRNGSeed(0);
+
+  SiftExtractionOptions options;
+  options.use_gpu = false;
+  options.max_num_features = std::numeric_limits<int>::max();
+
+  const int num_threads = GetEffectiveNumThreads(-1);
+
+  std::cout << StringPrintf("%10s %10s %12s %12s %10s", "megapixels",
+                            "features", "serial/MP",
+                            StringPrintf("%d threads/MP", num_threads).c_str(),
+                            "speedup")
+            << std::endl;
+
+  for (const int size : {1024, 2048, 4096}) {
+    Bitmap bitmap;
+    CreateRandomBitmap(size, size, &bitmap);
+    const double num_megapixels = size * size / 1e6;
+
+    FeatureKeypoints keypoints_serial;
+    FeatureDescriptors descriptors_serial;
+    options.num_threads_per_image = 1;
+    const double time_serial = TimeExtraction(
+        options, bitmap, &keypoints_serial, &descriptors_serial);
+
+    FeatureKeypoints keypoints_parallel;
+    FeatureDescriptors descriptors_parallel;
+    options.num_threads_per_image = num_threads;
+    const double time_parallel = TimeExtraction(
+        options, bitmap, &keypoints_parallel, &descriptors_parallel);
+
+    CHECK_EQ(keypoints_serial.size(), keypoints_parallel.size());
+    CHECK(descriptors_serial == descriptors_parallel);
+
+    std::cout << StringPrintf("%10.1f %10d %11.4fs %11.4fs %9.2fx",
+                              num_megapixels,
+                              static_cast<int>(keypoints_serial.size()),
+                              time_serial / num_megapixels,
+                              time_parallel / num_megapixels,
+                              time_serial / time_parallel)
+            << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
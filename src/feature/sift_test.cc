@@ -79,6 +79,115 @@ BOOST_AUTO_TEST_CASE(TestExtractSiftFeaturesCPU) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestExtractSiftFeaturesCPUParallel) {
+  Bitmap bitmap;
+  bitmap.Allocate(256, 256, false);
+  SetPRNGSeed(0);
+  for (int y = 0; y < bitmap.Height(); ++y) {
+    for (int x = 0; x < bitmap.Width(); ++x) {
+      bitmap.SetPixel(x, y, BitmapColor<uint8_t>(RandomInteger(0, 255)));
+    }
+  }
+  bitmap.Smooth(2, 2);
+
+  for (const bool upright : {false, true}) {
+    SiftExtractionOptions options;
+    options.upright = upright;
+
+    FeatureKeypoints ref_keypoints;
+    FeatureDescriptors ref_descriptors;
+    BOOST_CHECK(ExtractSiftFeaturesCPU(options, bitmap, &ref_keypoints,
+                                       &ref_descriptors));
+    BOOST_CHECK_GT(ref_keypoints.size(), 100);
+
+    for (const int num_threads_per_image : {2, 3, -1}) {
+      options.num_threads_per_image = num_threads_per_image;
+
+      FeatureKeypoints keypoints;
+      FeatureDescriptors descriptors;
+      BOOST_CHECK(
+          ExtractSiftFeaturesCPU(options, bitmap, &keypoints, &descriptors));
+
+      BOOST_CHECK_EQUAL(keypoints.size(), ref_keypoints.size());
+      for (size_t i = 0; i < keypoints.size(); ++i) {
+        BOOST_CHECK_EQUAL(keypoints[i].x, ref_keypoints[i].x);
+        BOOST_CHECK_EQUAL(keypoints[i].y, ref_keypoints[i].y);
+        BOOST_CHECK_EQUAL(keypoints[i].a11, ref_keypoints[i].a11);
+        BOOST_CHECK_EQUAL(keypoints[i].a12, ref_keypoints[i].a12);
+        BOOST_CHECK_EQUAL(keypoints[i].a21, ref_keypoints[i].a21);
+        BOOST_CHECK_EQUAL(keypoints[i].a22, ref_keypoints[i].a22);
+      }
+      BOOST_CHECK(descriptors == ref_descriptors);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestExtractSiftFeaturesCPUTiled) {
+  Bitmap bitmap;
+  bitmap.Allocate(600, 500, false);
+  SetPRNGSeed(0);
+  for (int y = 0; y < bitmap.Height(); ++y) {
+    for (int x = 0; x < bitmap.Width(); ++x) {
+      bitmap.SetPixel(x, y, BitmapColor<uint8_t>(RandomInteger(0, 255)));
+    }
+  }
+  bitmap.Smooth(2, 2);
+
+  SiftExtractionOptions options;
+  options.num_octaves = 2;
+  options.max_num_features = std::numeric_limits<int>::max();
+
+  FeatureKeypoints ref_keypoints;
+  FeatureDescriptors ref_descriptors;
+  BOOST_CHECK(ExtractSiftFeaturesCPU(options, bitmap, &ref_keypoints,
+                                     &ref_descriptors));
+
+  // Split the image into multiple tiles in both dimensions.
+  options.max_tile_memory =
+      EstimateSiftExtractionMemory(options, 350, 350) / (1024.0 * 1024 * 1024);
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  BOOST_CHECK(
+      ExtractSiftFeaturesCPU(options, bitmap, &keypoints, &descriptors));
+
+  // The tiles produce the same features as the whole image, up to ordering
+  // and rounding errors of the keypoint locations.
+  BOOST_CHECK_EQUAL(keypoints.size(), ref_keypoints.size());
+  BOOST_CHECK_EQUAL(descriptors.rows(), ref_descriptors.rows());
+  size_t num_equal_features = 0;
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    for (size_t j = 0; j < ref_keypoints.size(); ++j) {
+      if (std::abs(keypoints[i].x - ref_keypoints[j].x) < 1e-3 &&
+          std::abs(keypoints[i].y - ref_keypoints[j].y) < 1e-3 &&
+          std::abs(keypoints[i].ComputeOrientation() -
+                   ref_keypoints[j].ComputeOrientation()) < 1e-3 &&
+          (descriptors.row(i).cast<int>() -
+           ref_descriptors.row(j).cast<int>())
+                  .cwiseAbs()
+                  .maxCoeff() <= 1) {
+        num_equal_features += 1;
+        break;
+      }
+    }
+  }
+  BOOST_CHECK_EQUAL(num_equal_features, ref_keypoints.size());
+
+  // Limiting the number of features keeps the largest scales.
+  options.max_num_features = 100;
+  BOOST_CHECK(
+      ExtractSiftFeaturesCPU(options, bitmap, &keypoints, &descriptors));
+  BOOST_CHECK_GE(keypoints.size(), 100);
+  BOOST_CHECK_LT(keypoints.size(), ref_keypoints.size());
+  BOOST_CHECK_EQUAL(descriptors.rows(), keypoints.size());
+
+  // The margin of the tiles does not fit into the memory limit.
+  options.max_tile_memory =
+      EstimateSiftExtractionMemory(options, 10, 10) / (1024.0 * 1024 * 1024);
+  BOOST_CHECK(
+      !ExtractSiftFeaturesCPU(options, bitmap, &keypoints, &descriptors));
+}
+
 BOOST_AUTO_TEST_CASE(TestExtractCovariantSiftFeaturesCPU) {
   Bitmap bitmap;
   CreateImageWithSquare(256, &bitmap);
@@ -324,6 +433,27 @@ BOOST_AUTO_TEST_CASE(TestMatchSiftFeaturesCPU) {
   BOOST_CHECK_EQUAL(matches.size(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(TestMatchSiftFeaturesCPUBruteForceBlocks) {
+  // Use more descriptors than fit into a single block of the matcher.
+  const FeatureDescriptors descriptors2 = CreateRandomFeatureDescriptors(600);
+  const FeatureDescriptors descriptors1 = descriptors2.bottomRows(300);
+
+  SiftMatchingOptions match_options;
+  match_options.cpu_brute_force_matcher = true;
+
+  FeatureMatches matches;
+  MatchSiftFeaturesCPU(match_options, descriptors1, descriptors2, &matches);
+  BOOST_CHECK_EQUAL(matches.size(), 300);
+  for (size_t i = 0; i < matches.size(); ++i) {
+    BOOST_CHECK_EQUAL(matches[i].point2D_idx1, i);
+    BOOST_CHECK_EQUAL(matches[i].point2D_idx2, 300 + i);
+  }
+
+  match_options.cross_check = false;
+  MatchSiftFeaturesCPU(match_options, descriptors1, descriptors2, &matches);
+  BOOST_CHECK_EQUAL(matches.size(), 300);
+}
+
 BOOST_AUTO_TEST_CASE(TestMatchSiftFeaturesCPUFLANNvsBruteForce) {
   SiftMatchingOptions match_options;
   match_options.max_num_matches = 1000;
@@ -476,6 +606,69 @@ BOOST_AUTO_TEST_CASE(TestMatchGuidedSiftFeaturesCPU) {
   BOOST_CHECK_EQUAL(two_view_geometry.inlier_matches.size(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(TestMatchSiftFeaturesCPUPrepared) {
+  const auto descriptors1 = std::make_shared<const FeatureDescriptors>(
+      CreateRandomFeatureDescriptors(100));
+  const auto descriptors2 = std::make_shared<const FeatureDescriptors>(
+      descriptors1->colwise().reverse());
+  const auto empty_descriptors = std::make_shared<const FeatureDescriptors>(
+      CreateRandomFeatureDescriptors(0));
+
+  for (const bool brute_force : {true, false}) {
+    SiftMatchingOptions match_options;
+    match_options.cpu_brute_force_matcher = brute_force;
+
+    const SiftMatchingDescriptors prepared1(match_options, descriptors1);
+    const SiftMatchingDescriptors prepared2(match_options, descriptors2);
+    const SiftMatchingDescriptors prepared_empty(match_options,
+                                                 empty_descriptors);
+    BOOST_CHECK_EQUAL(prepared1.HasInt16Descriptors(), brute_force);
+    BOOST_CHECK_EQUAL(prepared1.HasFLANNIndex(), !brute_force);
+
+    FeatureMatches matches;
+    FeatureMatches prepared_matches;
+    MatchSiftFeaturesCPU(match_options, *descriptors1, *descriptors2,
+                         &matches);
+    MatchSiftFeaturesCPU(match_options, prepared1, prepared2,
+                         &prepared_matches);
+    BOOST_CHECK_EQUAL(prepared_matches.size(), 100);
+    CheckEqualMatches(matches, prepared_matches);
+
+    // Descriptors owned elsewhere are prepared without copying them.
+    const SiftMatchingDescriptors prepared_view2(
+        match_options,
+        FeatureDescriptorsView(descriptors2->data(), descriptors2->rows(),
+                               descriptors2->cols()));
+    BOOST_CHECK_EQUAL(prepared_view2.Descriptors().data(),
+                      descriptors2->data());
+    MatchSiftFeaturesCPU(match_options, prepared1, prepared_view2,
+                         &prepared_matches);
+    CheckEqualMatches(matches, prepared_matches);
+
+    MatchSiftFeaturesCPU(match_options, prepared_empty, prepared2,
+                         &prepared_matches);
+    BOOST_CHECK_EQUAL(prepared_matches.size(), 0);
+    MatchSiftFeaturesCPU(match_options, prepared1, prepared_empty,
+                         &prepared_matches);
+    BOOST_CHECK_EQUAL(prepared_matches.size(), 0);
+  }
+
+  SiftMatchingOptions match_options;
+  match_options.guided_matching = true;
+  const SiftMatchingDescriptors prepared1(match_options, descriptors1);
+  const SiftMatchingDescriptors prepared2(match_options, descriptors2);
+  BOOST_CHECK(prepared1.HasInt16Descriptors());
+
+  const FeatureKeypoints keypoints1(100);
+  const FeatureKeypoints keypoints2(100);
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::PLANAR_OR_PANORAMIC;
+  two_view_geometry.H = Eigen::Matrix3d::Identity();
+  MatchGuidedSiftFeaturesCPU(match_options, keypoints1, keypoints2, prepared1,
+                             prepared2, &two_view_geometry);
+  BOOST_CHECK_EQUAL(two_view_geometry.inlier_matches.size(), 100);
+}
+
 BOOST_AUTO_TEST_CASE(TestMatchSiftFeaturesGPU) {
   char app_name[] = "Test";
   int argc = 1;
@@ -0,0 +1,156 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include <iostream>
+
+#include "FLANN/flann.hpp"
+#include "base/gps.h"
+#include "feature/matching.h"
+#include "util/logging.h"
+#include "util/math.h"
+#include "util/misc.h"
+#include "util/random.h"
+#include "util/timer.h"
+
+using namespace colmap;
+
+namespace {
+
+const int kMaxNumNeighbors = 50;
+const double kMaxDistance = 100;
+
+// Synthetic GPS locations of an aerial survey, which flies the area in
+// parallel lines and takes an image every few meters along each line.
+std::vector<Eigen::Vector3d> CreateAerialSurvey(const size_t num_images) {
+  const double kLineSpacing = 40;
+  const double kImageSpacing = 20;
+  const double kAltitude = 500;
+  const double kLatitude = 47.37;
+  const double kLongitude = 8.54;
+  const double kMetersPerDegree = 111320;
+
+  const size_t num_images_per_line =
+      static_cast<size_t>(std::ceil(std::sqrt(2.0 * num_images)));
+
+  SetPRNGSeed(0);
+
+  std::vector<Eigen::Vector3d> ells(num_images);
+  for (size_t i = 0; i < num_images; ++i) {
+    const double x = kLineSpacing * (i / num_images_per_line) +
+                     RandomReal(-1.0, 1.0);
+    const double y = kImageSpacing * (i % num_images_per_line) +
+                     RandomReal(-1.0, 1.0);
+    ells[i](0) = kLatitude + y / kMetersPerDegree;
+    ells[i](1) = kLongitude +
+                 x / (kMetersPerDegree * std::cos(DegToRad(kLatitude)));
+    ells[i](2) = kAltitude + RandomReal(-5.0, 5.0);
+  }
+
+  GPSTransform gps_transform;
+  return gps_transform.EllToXYZ(ells);
+}
+
+// The previous exhaustive search of the nearest neighbors.
+size_t FindNearestNeighborsLinear(
+    const std::vector<Eigen::Vector3d>& locations) {
+  Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> location_matrix(
+      locations.size(), 3);
+  for (size_t i = 0; i < locations.size(); ++i) {
+    location_matrix.row(i) = locations[i].cast<float>().transpose();
+  }
+
+  const flann::Matrix<float> flann_locations(location_matrix.data(),
+                                             locations.size(), 3);
+  flann::LinearIndex<flann::L2<float>> search_index(flann_locations);
+  search_index.buildIndex();
+
+  const size_t knn = std::min<size_t>(kMaxNumNeighbors, locations.size());
+  Eigen::Matrix<size_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      index_matrix(locations.size(), knn);
+  flann::Matrix<size_t> indices(index_matrix.data(), locations.size(), knn);
+  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      distance_matrix(locations.size(), knn);
+  flann::Matrix<float> distances(distance_matrix.data(), locations.size(),
+                                 knn);
+  search_index.knnSearch(flann_locations, indices, distances, knn,
+                         flann::SearchParams());
+
+  const float max_squared_distance = kMaxDistance * kMaxDistance;
+  return (distance_matrix.array() <= max_squared_distance).count();
+}
+
+}  // namespace
+
+// Benchmark of the spatial nearest neighbor search of the spatial matcher on
+// synthetic aerial surveys. The exhaustive search is only run for the smaller
+// surveys due to its quadratic complexity.
+int main(int argc, char** argv) {
+  InitializeGlog(argv);
+
+  const size_t kMaxNumImagesLinear = 20000;
+
+  std::cout << StringPrintf("%10s %12s %12s %12s", "images", "linear",
+                            "kd_tree", "neighbors")
+            << std::endl;
+
+  for (const size_t num_images : {1000, 10000, 20000, 100000, 300000}) {
+    const std::vector<Eigen::Vector3d> locations =
+        CreateAerialSurvey(num_images);
+
+    Timer timer;
+
+    std::string linear_time = "-";
+    if (num_images <= kMaxNumImagesLinear) {
+      timer.Start();
+      CHECK_GT(FindNearestNeighborsLinear(locations), 0);
+      linear_time = StringPrintf("%.4fs", timer.ElapsedSeconds());
+    }
+
+    timer.Restart();
+    std::vector<std::vector<size_t>> neighbors;
+    FindSpatialNearestNeighbors(locations, kMaxNumNeighbors, kMaxDistance, -1,
+                                &neighbors);
+    const double kd_tree_time = timer.ElapsedSeconds();
+
+    size_t num_neighbors = 0;
+    for (const auto& location_neighbors : neighbors) {
+      num_neighbors += location_neighbors.size();
+    }
+
+    std::cout << StringPrintf("%10d %12s %11.4fs %12.1f",
+                              static_cast<int>(num_images),
+                              linear_time.c_str(), kd_tree_time,
+                              static_cast<double>(num_neighbors) / num_images)
+              << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
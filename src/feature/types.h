@@ -98,6 +98,32 @@ typedef Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
     FeatureDescriptors;
 typedef std::vector<FeatureMatch> FeatureMatches;
 
+// Zero-copy view of the keypoints of an image, e.g., in a memory-mapped
+// feature store. The view is only valid as long as the viewed data.
+class FeatureKeypointsView {
+ public:
+  FeatureKeypointsView() : data_(nullptr), size_(0) {}
+  FeatureKeypointsView(const FeatureKeypoint* data, const size_t size)
+      : data_(data), size_(size) {}
+
+  inline size_t size() const { return size_; }
+  inline bool empty() const { return size_ == 0; }
+  inline const FeatureKeypoint* data() const { return data_; }
+  inline const FeatureKeypoint* begin() const { return data_; }
+  inline const FeatureKeypoint* end() const { return data_ + size_; }
+  inline const FeatureKeypoint& operator[](const size_t idx) const {
+    return data_[idx];
+  }
+
+ private:
+  const FeatureKeypoint* data_;
+  size_t size_;
+};
+
+// Zero-copy view of the descriptors of an image. The view is only valid as
+// long as the viewed data.
+typedef Eigen::Map<const FeatureDescriptors> FeatureDescriptorsView;
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_FEATURE_TYPES_H_
@@ -39,6 +39,8 @@ namespace colmap {
 // Convert feature keypoints to vector of points.
 std::vector<Eigen::Vector2d> FeatureKeypointsToPointsVector(
     const FeatureKeypoints& keypoints);
+std::vector<Eigen::Vector2d> FeatureKeypointsToPointsVector(
+    const FeatureKeypointsView& keypoints);
 
 // L2-normalize feature descriptor, where each row represents one feature.
 Eigen::MatrixXf L2NormalizeFeatureDescriptors(
@@ -78,6 +78,13 @@ int FindNextImage(const std::vector<std::vector<int>>& overlapping_images,
   return -1;
 }
 
+// Unique key of a pixel in the fused pixel masks of all images.
+inline uint64_t PixelKey(const int image_idx, const int row, const int col,
+                         const int width) {
+  return (static_cast<uint64_t>(image_idx) << 32) |
+         static_cast<uint64_t>(row * width + col);
+}
+
 }  // namespace internal
 
 void StereoFusionOptions::Print() const {
@@ -92,6 +99,7 @@ void StereoFusionOptions::Print() const {
   PrintOption(max_normal_error);
   PrintOption(check_num_images);
   PrintOption(cache_size);
+  PrintOption(num_threads);
 #undef PrintOption
 }
 
@@ -104,6 +112,7 @@ bool StereoFusionOptions::Check() const {
   CHECK_OPTION_GE(max_normal_error, 0);
   CHECK_OPTION_GT(check_num_images, 0);
   CHECK_OPTION_GT(cache_size, 0);
+  CHECK_OPTION_NE(num_threads, 0);
   return true;
 }
 
@@ -184,6 +193,10 @@ void StereoFusion::Run() {
   P_.resize(model.images.size());
   inv_P_.resize(model.images.size());
   inv_R_.resize(model.images.size());
+  inputs_cache_.reset();
+
+  // Maximum number of bytes of the inputs of a single image.
+  size_t max_image_num_bytes = 0;
 
   const auto image_names = ReadTextFileLines(JoinPaths(
       workspace_path_, workspace_options.stereo_folder, "fusion.cfg"));
@@ -213,6 +226,13 @@ void StereoFusion::Run() {
     depth_map_sizes_.at(image_idx) =
         std::make_pair(depth_map.GetWidth(), depth_map.GetHeight());
 
+    const size_t num_depth_map_pixels =
+        depth_map.GetWidth() * depth_map.GetHeight();
+    max_image_num_bytes = std::max(
+        max_image_num_bytes,
+        3 * image.GetWidth() * image.GetHeight() +
+            4 * sizeof(float) * num_depth_map_pixels);
+
     bitmap_scales_.at(image_idx) = std::make_pair(
         static_cast<float>(depth_map.GetWidth()) / image.GetWidth(),
         static_cast<float>(depth_map.GetHeight()) / image.GetHeight());
@@ -235,6 +255,41 @@ void StereoFusion::Run() {
             .transpose();
   }
 
+  const int num_threads = GetEffectiveNumThreads(options_.num_threads);
+
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (num_threads > 1) {
+    // The workspace cache is not thread-safe, so that the threads share the
+    // inputs through a thread-safe cache with the same memory budget instead.
+    workspace_->ClearCache();
+    const size_t max_num_images = std::max<size_t>(
+        1, static_cast<size_t>(1024.0 * 1024.0 * 1024.0 * options_.cache_size /
+                               std::max<size_t>(1, max_image_num_bytes)));
+    inputs_cache_.reset(new ShardedLRUCache<int, FusionInputs>(
+        max_num_images, 1, [this](const int image_idx) {
+          std::shared_ptr<FusionInputs> inputs =
+              std::make_shared<FusionInputs>();
+          workspace_->ReadBitmap(image_idx, &inputs->bitmap);
+          workspace_->ReadDepthMap(image_idx, &inputs->depth_map);
+          workspace_->ReadNormalMap(image_idx, &inputs->normal_map);
+          return std::shared_ptr<const FusionInputs>(std::move(inputs));
+        }));
+
+    fusion_state_.inputs.clear();
+    fusion_state_.inputs.resize(model.images.size());
+    fusion_state_.input_image_idxs.clear();
+
+    thread_pool.reset(new ThreadPool(num_threads));
+    thread_fusion_states_.clear();
+    thread_fusion_states_.resize(num_threads);
+    for (auto& state : thread_fusion_states_) {
+      state.speculative = true;
+      state.inputs.resize(model.images.size());
+    }
+    num_speculative_fusions_ = 0;
+    num_conflicting_fusions_ = 0;
+  }
+
   size_t num_fused_images = 0;
   for (int image_idx = 0; image_idx >= 0;
        image_idx = internal::FindNextImage(overlapping_images_, used_images_,
@@ -250,24 +305,10 @@ void StereoFusion::Run() {
                               model.images.size())
               << std::flush;
 
-    const int width = depth_map_sizes_.at(image_idx).first;
-    const int height = depth_map_sizes_.at(image_idx).second;
-    const auto& fused_pixel_mask = fused_pixel_masks_.at(image_idx);
-
-    FusionData data;
-    data.image_idx = image_idx;
-    data.traversal_depth = 0;
-
-    for (data.row = 0; data.row < height; ++data.row) {
-      for (data.col = 0; data.col < width; ++data.col) {
-        if (fused_pixel_mask.Get(data.row, data.col)) {
-          continue;
-        }
-
-        fusion_queue_.push_back(data);
-
-        Fuse();
-      }
+    if (thread_pool) {
+      FuseImageParallel(image_idx, thread_pool.get());
+    } else {
+      FuseImage(image_idx);
     }
 
     num_fused_images += 1;
@@ -278,6 +319,12 @@ void StereoFusion::Run() {
               << std::endl;
   }
 
+  if (thread_pool) {
+    PrintThreadStatistics();
+    ReleaseInputs(&fusion_state_);
+    inputs_cache_.reset();
+  }
+
   fused_points_.shrink_to_fit();
   fused_points_visibility_.shrink_to_fit();
 
@@ -292,39 +339,229 @@ void StereoFusion::Run() {
   GetTimer().PrintMinutes();
 }
 
-void StereoFusion::Fuse() {
-  CHECK_EQ(fusion_queue_.size(), 1);
+void StereoFusion::FuseImage(const int image_idx) {
+  const int width = depth_map_sizes_.at(image_idx).first;
+  const int height = depth_map_sizes_.at(image_idx).second;
+  const auto& fused_pixel_mask = fused_pixel_masks_.at(image_idx);
+
+  for (int row = 0; row < height; ++row) {
+    for (int col = 0; col < width; ++col) {
+      if (fused_pixel_mask.Get(row, col)) {
+        continue;
+      }
+      FuseAndAppend(&fusion_state_, image_idx, row, col);
+    }
+  }
+}
+
+void StereoFusion::FuseImageParallel(const int image_idx,
+                                     ThreadPool* thread_pool) {
+  // Number of rows in a band of the reference image fused by a single task.
+  const int kNumRowsPerBand = 4;
+
+  const int height = depth_map_sizes_.at(image_idx).second;
+  const int num_bands = (height + kNumRowsPerBand - 1) / kNumRowsPerBand;
+  const int num_bands_per_round =
+      4 * static_cast<int>(thread_pool->NumThreads());
+
+  std::vector<std::vector<SpeculativeFusion>> band_results;
+
+  // In each round, the bands are first fused speculatively in parallel based
+  // on the fused pixel masks at the start of the round. Afterwards, the
+  // results are validated and committed in sequential order, where the
+  // results that read a since modified mask value are fused again.
+  for (int round_start = 0; round_start < num_bands;
+       round_start += num_bands_per_round) {
+    const int round_end =
+        std::min(num_bands, round_start + num_bands_per_round);
+
+    band_results.clear();
+    band_results.resize(round_end - round_start);
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(round_end - round_start);
+    for (int band_idx = round_start; band_idx < round_end; ++band_idx) {
+      const int row_start = band_idx * kNumRowsPerBand;
+      const int row_end = std::min(height, row_start + kNumRowsPerBand);
+      auto* results = &band_results[band_idx - round_start];
+      futures.push_back(thread_pool->AddTask(
+          [this, thread_pool, image_idx, row_start, row_end, results]() {
+            FusionState* state =
+                &thread_fusion_states_.at(thread_pool->GetThreadIndex());
+            FuseBand(image_idx, row_start, row_end, state, results);
+          }));
+    }
+
+    for (auto& future : futures) {
+      future.get();
+    }
+
+    for (int band_idx = round_start; band_idx < round_end; ++band_idx) {
+      const int row_start = band_idx * kNumRowsPerBand;
+      const int row_end = std::min(height, row_start + kNumRowsPerBand);
+      CommitBand(image_idx, row_start, row_end,
+                 band_results[band_idx - round_start]);
+    }
+
+    ReleaseInputs(&fusion_state_);
+  }
+}
+
+void StereoFusion::FuseBand(const int image_idx, const int row_start,
+                            const int row_end, FusionState* state,
+                            std::vector<SpeculativeFusion>* results) {
+  CHECK(state->speculative);
+
+  Timer timer;
+  timer.Start();
+
+  const int width = depth_map_sizes_.at(image_idx).first;
+
+  state->speculative_fused_pixels.clear();
+  results->clear();
+
+  for (int row = row_start; row < row_end; ++row) {
+    for (int col = 0; col < width; ++col) {
+      state->seed_idx = static_cast<int>(results->size());
+      if (IsPixelFused(state, image_idx, row, col)) {
+        continue;
+      }
+
+      results->emplace_back();
+      SpeculativeFusion& result = results->back();
+      result.row = row;
+      result.col = col;
+      result.has_point = Fuse(state, image_idx, row, col, &result.point,
+                              &result.point_visibility);
+      result.mask_reads.swap(state->mask_reads);
+      result.fused_pixels.swap(state->fused_pixels);
+
+      state->num_seed_pixels += 1;
+      if (result.has_point) {
+        state->num_fused_points += 1;
+      }
+    }
+  }
+
+  // Allow the cache to evict the inputs used by this band.
+  ReleaseInputs(state);
+
+  state->elapsed_seconds += timer.ElapsedSeconds();
+}
+
+void StereoFusion::CommitBand(const int image_idx, const int row_start,
+                              const int row_end,
+                              const std::vector<SpeculativeFusion>& results) {
+  const int width = depth_map_sizes_.at(image_idx).first;
+  const auto& fused_pixel_mask = fused_pixel_masks_.at(image_idx);
+
+  size_t result_idx = 0;
+  for (int row = row_start; row < row_end; ++row) {
+    for (int col = 0; col < width; ++col) {
+      // Find the speculative result for the current pixel, if any.
+      const SpeculativeFusion* result = nullptr;
+      while (result_idx < results.size() &&
+             (results[result_idx].row < row ||
+              (results[result_idx].row == row &&
+               results[result_idx].col < col))) {
+        result_idx += 1;
+      }
+      if (result_idx < results.size() && results[result_idx].row == row &&
+          results[result_idx].col == col) {
+        result = &results[result_idx];
+      }
+
+      if (fused_pixel_mask.Get(row, col)) {
+        continue;
+      }
 
+      // The speculative result is only valid, if the fusion observed the same
+      // fused pixel masks as the sequential fusion at this point.
+      bool valid = result != nullptr;
+      if (valid) {
+        num_speculative_fusions_ += 1;
+        for (const auto& mask_read : result->mask_reads) {
+          if (fused_pixel_masks_[mask_read.image_idx].Get(
+                  mask_read.row, mask_read.col) != mask_read.fused) {
+            valid = false;
+            num_conflicting_fusions_ += 1;
+            break;
+          }
+        }
+      }
+
+      if (valid) {
+        for (const auto& fused_pixel : result->fused_pixels) {
+          fused_pixel_masks_[fused_pixel.image_idx].Set(
+              fused_pixel.row, fused_pixel.col, true);
+        }
+        if (result->has_point) {
+          fused_points_.push_back(result->point);
+          fused_points_visibility_.push_back(result->point_visibility);
+        }
+      } else {
+        FuseAndAppend(&fusion_state_, image_idx, row, col);
+      }
+    }
+  }
+}
+
+void StereoFusion::FuseAndAppend(FusionState* state, const int image_idx,
+                                 const int row, const int col) {
+  PlyPoint fused_point;
+  std::vector<int> fused_point_visibility;
+  if (Fuse(state, image_idx, row, col, &fused_point,
+           &fused_point_visibility)) {
+    fused_points_.push_back(fused_point);
+    fused_points_visibility_.push_back(std::move(fused_point_visibility));
+  }
+}
+
+bool StereoFusion::Fuse(FusionState* state, const int ref_image_idx,
+                        const int ref_row, const int ref_col,
+                        PlyPoint* fused_point,
+                        std::vector<int>* fused_point_visibility) {
   Eigen::Vector4f fused_ref_point = Eigen::Vector4f::Zero();
   Eigen::Vector3f fused_ref_normal = Eigen::Vector3f::Zero();
 
-  fused_point_x_.clear();
-  fused_point_y_.clear();
-  fused_point_z_.clear();
-  fused_point_nx_.clear();
-  fused_point_ny_.clear();
-  fused_point_nz_.clear();
-  fused_point_r_.clear();
-  fused_point_g_.clear();
-  fused_point_b_.clear();
-  fused_point_visibility_.clear();
-
-  while (!fusion_queue_.empty()) {
-    const auto data = fusion_queue_.back();
+  state->fused_point_x.clear();
+  state->fused_point_y.clear();
+  state->fused_point_z.clear();
+  state->fused_point_nx.clear();
+  state->fused_point_ny.clear();
+  state->fused_point_nz.clear();
+  state->fused_point_r.clear();
+  state->fused_point_g.clear();
+  state->fused_point_b.clear();
+  state->fused_point_visibility.clear();
+  state->mask_reads.clear();
+  state->fused_pixels.clear();
+
+  auto& fusion_queue = state->fusion_queue;
+  fusion_queue.clear();
+
+  FusionData ref_data;
+  ref_data.image_idx = ref_image_idx;
+  ref_data.row = ref_row;
+  ref_data.col = ref_col;
+  ref_data.traversal_depth = 0;
+  fusion_queue.push_back(ref_data);
+
+  while (!fusion_queue.empty()) {
+    const auto data = fusion_queue.back();
     const int image_idx = data.image_idx;
     const int row = data.row;
     const int col = data.col;
     const int traversal_depth = data.traversal_depth;
 
-    fusion_queue_.pop_back();
+    fusion_queue.pop_back();
 
     // Check if pixel already fused.
-    auto& fused_pixel_mask = fused_pixel_masks_.at(image_idx);
-    if (fused_pixel_mask.Get(row, col)) {
+    if (IsPixelFused(state, image_idx, row, col)) {
       continue;
     }
 
-    const auto& depth_map = workspace_->GetDepthMap(image_idx);
+    const auto& depth_map = GetDepthMap(state, image_idx);
     const float depth = depth_map.Get(row, col);
 
     // Pixels with negative depth are filtered.
@@ -355,7 +592,7 @@ void StereoFusion::Fuse() {
     }
 
     // Determine normal direction in global reference frame.
-    const auto& normal_map = workspace_->GetNormalMap(image_idx);
+    const auto& normal_map = GetNormalMap(state, image_idx);
     const Eigen::Vector3f normal =
         inv_R_.at(image_idx) * Eigen::Vector3f(normal_map.Get(row, col, 0),
                                                normal_map.Get(row, col, 1),
@@ -377,23 +614,23 @@ void StereoFusion::Fuse() {
     // Read the color of the pixel.
     BitmapColor<uint8_t> color;
     const auto& bitmap_scale = bitmap_scales_.at(image_idx);
-    workspace_->GetBitmap(image_idx).InterpolateNearestNeighbor(
+    GetBitmap(state, image_idx).InterpolateNearestNeighbor(
         col / bitmap_scale.first, row / bitmap_scale.second, &color);
 
     // Set the current pixel as visited.
-    fused_pixel_mask.Set(row, col, true);
+    SetPixelFused(state, image_idx, row, col);
 
     // Accumulate statistics for fused point.
-    fused_point_x_.push_back(xyz(0));
-    fused_point_y_.push_back(xyz(1));
-    fused_point_z_.push_back(xyz(2));
-    fused_point_nx_.push_back(normal(0));
-    fused_point_ny_.push_back(normal(1));
-    fused_point_nz_.push_back(normal(2));
-    fused_point_r_.push_back(color.r);
-    fused_point_g_.push_back(color.g);
-    fused_point_b_.push_back(color.b);
-    fused_point_visibility_.insert(image_idx);
+    state->fused_point_x.push_back(xyz(0));
+    state->fused_point_y.push_back(xyz(1));
+    state->fused_point_z.push_back(xyz(2));
+    state->fused_point_nx.push_back(normal(0));
+    state->fused_point_ny.push_back(normal(1));
+    state->fused_point_nz.push_back(normal(2));
+    state->fused_point_r.push_back(color.r);
+    state->fused_point_g.push_back(color.g);
+    state->fused_point_b.push_back(color.b);
+    state->fused_point_visibility.insert(image_idx);
 
     // Remember the first pixel as the reference.
     if (traversal_depth == 0) {
@@ -401,7 +638,8 @@ void StereoFusion::Fuse() {
       fused_ref_normal = normal;
     }
 
-    if (fused_point_x_.size() >= static_cast<size_t>(options_.max_num_pixels)) {
+    if (state->fused_point_x.size() >=
+        static_cast<size_t>(options_.max_num_pixels)) {
       break;
     }
 
@@ -432,44 +670,161 @@ void StereoFusion::Fuse() {
         continue;
       }
 
-      fusion_queue_.push_back(next_data);
+      fusion_queue.push_back(next_data);
     }
   }
 
-  fusion_queue_.clear();
+  fusion_queue.clear();
 
-  const size_t num_pixels = fused_point_x_.size();
-  if (num_pixels >= static_cast<size_t>(options_.min_num_pixels)) {
-    PlyPoint fused_point;
+  const size_t num_pixels = state->fused_point_x.size();
+  if (num_pixels < static_cast<size_t>(options_.min_num_pixels)) {
+    return false;
+  }
 
-    Eigen::Vector3f fused_normal;
-    fused_normal.x() = internal::Median(&fused_point_nx_);
-    fused_normal.y() = internal::Median(&fused_point_ny_);
-    fused_normal.z() = internal::Median(&fused_point_nz_);
-    const float fused_normal_norm = fused_normal.norm();
-    if (fused_normal_norm < std::numeric_limits<float>::epsilon()) {
-      return;
-    }
+  Eigen::Vector3f fused_normal;
+  fused_normal.x() = internal::Median(&state->fused_point_nx);
+  fused_normal.y() = internal::Median(&state->fused_point_ny);
+  fused_normal.z() = internal::Median(&state->fused_point_nz);
+  const float fused_normal_norm = fused_normal.norm();
+  if (fused_normal_norm < std::numeric_limits<float>::epsilon()) {
+    return false;
+  }
 
-    fused_point.x = internal::Median(&fused_point_x_);
-    fused_point.y = internal::Median(&fused_point_y_);
-    fused_point.z = internal::Median(&fused_point_z_);
+  fused_point->x = internal::Median(&state->fused_point_x);
+  fused_point->y = internal::Median(&state->fused_point_y);
+  fused_point->z = internal::Median(&state->fused_point_z);
 
-    fused_point.nx = fused_normal.x() / fused_normal_norm;
-    fused_point.ny = fused_normal.y() / fused_normal_norm;
-    fused_point.nz = fused_normal.z() / fused_normal_norm;
+  fused_point->nx = fused_normal.x() / fused_normal_norm;
+  fused_point->ny = fused_normal.y() / fused_normal_norm;
+  fused_point->nz = fused_normal.z() / fused_normal_norm;
 
-    fused_point.r = TruncateCast<float, uint8_t>(
-        std::round(internal::Median(&fused_point_r_)));
-    fused_point.g = TruncateCast<float, uint8_t>(
-        std::round(internal::Median(&fused_point_g_)));
-    fused_point.b = TruncateCast<float, uint8_t>(
-        std::round(internal::Median(&fused_point_b_)));
+  fused_point->r = TruncateCast<float, uint8_t>(
+      std::round(internal::Median(&state->fused_point_r)));
+  fused_point->g = TruncateCast<float, uint8_t>(
+      std::round(internal::Median(&state->fused_point_g)));
+  fused_point->b = TruncateCast<float, uint8_t>(
+      std::round(internal::Median(&state->fused_point_b)));
 
-    fused_points_.push_back(fused_point);
-    fused_points_visibility_.emplace_back(fused_point_visibility_.begin(),
-                                          fused_point_visibility_.end());
+  // Sort the visibility, since the iteration order of the hash set is not
+  // deterministic.
+  fused_point_visibility->assign(state->fused_point_visibility.begin(),
+                                 state->fused_point_visibility.end());
+  std::sort(fused_point_visibility->begin(), fused_point_visibility->end());
+
+  return true;
+}
+
+void StereoFusion::PrintThreadStatistics() const {
+  std::cout << std::endl;
+  for (size_t thread_idx = 0; thread_idx < thread_fusion_states_.size();
+       ++thread_idx) {
+    const auto& state = thread_fusion_states_[thread_idx];
+    const double pixels_per_second =
+        state.elapsed_seconds > 0
+            ? state.num_seed_pixels / state.elapsed_seconds
+            : 0.0;
+    std::cout << StringPrintf(
+                     "Thread %d: %d seed pixels, %d points in %.3fs (%.0f "
+                     "pixels/s)",
+                     static_cast<int>(thread_idx),
+                     static_cast<int>(state.num_seed_pixels),
+                     static_cast<int>(state.num_fused_points),
+                     state.elapsed_seconds, pixels_per_second)
+              << std::endl;
+  }
+  std::cout << StringPrintf(
+                   "Re-fused %d of %d speculative fusions due to conflicts",
+                   static_cast<int>(num_conflicting_fusions_),
+                   static_cast<int>(num_speculative_fusions_))
+            << std::endl;
+}
+
+bool StereoFusion::IsPixelFused(FusionState* state, const int image_idx,
+                                const int row, const int col) const {
+  if (!state->speculative) {
+    return fused_pixel_masks_[image_idx].Get(row, col);
+  }
+
+  FusedPixel mask_read;
+  mask_read.image_idx = image_idx;
+  mask_read.row = row;
+  mask_read.col = col;
+
+  const auto it = state->speculative_fused_pixels.find(internal::PixelKey(
+      image_idx, row, col, depth_map_sizes_[image_idx].first));
+  if (it == state->speculative_fused_pixels.end()) {
+    mask_read.fused = fused_pixel_masks_[image_idx].Get(row, col);
+  } else if (it->second == state->seed_idx) {
+    // Pixels fused by the current seed itself do not depend on the masks.
+    return true;
+  } else {
+    mask_read.fused = true;
+  }
+
+  state->mask_reads.push_back(mask_read);
+
+  return mask_read.fused;
+}
+
+void StereoFusion::SetPixelFused(FusionState* state, const int image_idx,
+                                 const int row, const int col) {
+  if (!state->speculative) {
+    fused_pixel_masks_[image_idx].Set(row, col, true);
+    return;
+  }
+
+  state->speculative_fused_pixels.emplace(
+      internal::PixelKey(image_idx, row, col,
+                         depth_map_sizes_[image_idx].first),
+      state->seed_idx);
+
+  FusedPixel fused_pixel;
+  fused_pixel.image_idx = image_idx;
+  fused_pixel.row = row;
+  fused_pixel.col = col;
+  fused_pixel.fused = true;
+  state->fused_pixels.push_back(fused_pixel);
+}
+
+const StereoFusion::FusionInputs& StereoFusion::GetInputs(
+    FusionState* state, const int image_idx) {
+  auto& inputs = state->inputs.at(image_idx);
+  if (!inputs) {
+    inputs = inputs_cache_->Get(image_idx);
+    state->input_image_idxs.push_back(image_idx);
+  }
+  return *inputs;
+}
+
+void StereoFusion::ReleaseInputs(FusionState* state) {
+  for (const int image_idx : state->input_image_idxs) {
+    state->inputs[image_idx].reset();
+  }
+  state->input_image_idxs.clear();
+}
+
+const Bitmap& StereoFusion::GetBitmap(FusionState* state,
+                                      const int image_idx) {
+  if (!inputs_cache_) {
+    return workspace_->GetBitmap(image_idx);
+  }
+  return GetInputs(state, image_idx).bitmap;
+}
+
+const DepthMap& StereoFusion::GetDepthMap(FusionState* state,
+                                          const int image_idx) {
+  if (!inputs_cache_) {
+    return workspace_->GetDepthMap(image_idx);
+  }
+  return GetInputs(state, image_idx).depth_map;
+}
+
+const NormalMap& StereoFusion::GetNormalMap(FusionState* state,
+                                            const int image_idx) {
+  if (!inputs_cache_) {
+    return workspace_->GetNormalMap(image_idx);
   }
+  return GetInputs(state, image_idx).normal_map;
 }
 
 void WritePointsVisibility(
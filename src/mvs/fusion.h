@@ -32,6 +32,7 @@
 #ifndef COLMAP_SRC_MVS_FUSION_H_
 #define COLMAP_SRC_MVS_FUSION_H_
 
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -84,6 +85,14 @@ struct StereoFusionOptions {
   // consume a lot of memory, if the consistency graph is dense.
   double cache_size = 32.0;
 
+  // Number of threads used to fuse the pixels of a reference image. The image
+  // is partitioned into bands of rows, which are fused speculatively in
+  // parallel and then committed in the same order as in the sequential fusion,
+  // such that the result is identical to single-threaded fusion. The inputs
+  // are shared by the threads through a cache bounded by cache_size, where an
+  // image is only evicted once no thread fuses a band that uses it.
+  int num_threads = 1;
+
   // Check the options for validity.
   bool Check() const;
 
@@ -101,12 +110,117 @@ class StereoFusion : public Thread {
                const std::string& pmvs_option_name,
                const std::string& input_type);
 
+  // The fused points and the indices of the images, in which they are visible.
+  // The image indices of each point are sorted in increasing order.
   const std::vector<PlyPoint>& GetFusedPoints() const;
   const std::vector<std::vector<int>>& GetFusedPointsVisibility() const;
 
  private:
+  struct FusionData {
+    int image_idx = kInvalidImageId;
+    int row = 0;
+    int col = 0;
+    int traversal_depth = -1;
+    bool operator()(const FusionData& data1, const FusionData& data2) {
+      return data1.image_idx > data2.image_idx;
+    }
+  };
+
+  // The inputs of an image shared by the threads of multi-threaded fusion.
+  struct FusionInputs {
+    Bitmap bitmap;
+    DepthMap depth_map;
+    NormalMap normal_map;
+  };
+
+  // A pixel and its state in the fused pixel masks.
+  struct FusedPixel {
+    int image_idx = kInvalidImageId;
+    int row = 0;
+    int col = 0;
+    bool fused = false;
+  };
+
+  // The state of a fusion thread. In speculative mode, the fused pixel masks
+  // are only read and all reads and modifications are recorded in the state,
+  // so that the speculative result can be validated and committed later.
+  struct FusionState {
+    bool speculative = false;
+
+    // Index of the current seed pixel in the band of the thread.
+    int seed_idx = -1;
+
+    // Next points to fuse.
+    std::vector<FusionData> fusion_queue;
+
+    // Points of different pixels of the currently point to be fused.
+    std::vector<float> fused_point_x;
+    std::vector<float> fused_point_y;
+    std::vector<float> fused_point_z;
+    std::vector<float> fused_point_nx;
+    std::vector<float> fused_point_ny;
+    std::vector<float> fused_point_nz;
+    std::vector<uint8_t> fused_point_r;
+    std::vector<uint8_t> fused_point_g;
+    std::vector<uint8_t> fused_point_b;
+    std::unordered_set<int> fused_point_visibility;
+
+    // Pixels speculatively fused in the current band, mapped to the index of
+    // the seed pixel that fused them.
+    std::unordered_map<uint64_t, int> speculative_fused_pixels;
+
+    // Mask reads and fused pixels of the current speculative seed.
+    std::vector<FusedPixel> mask_reads;
+    std::vector<FusedPixel> fused_pixels;
+
+    // Inputs held by the thread in multi-threaded fusion, indexed by image,
+    // and the indices of the images with held inputs.
+    std::vector<std::shared_ptr<const FusionInputs>> inputs;
+    std::vector<int> input_image_idxs;
+
+    // Throughput statistics.
+    size_t num_seed_pixels = 0;
+    size_t num_fused_points = 0;
+    double elapsed_seconds = 0.0;
+  };
+
+  // The speculative fusion result of a single seed pixel.
+  struct SpeculativeFusion {
+    int row = 0;
+    int col = 0;
+    bool has_point = false;
+    PlyPoint point;
+    std::vector<int> point_visibility;
+    std::vector<FusedPixel> mask_reads;
+    std::vector<FusedPixel> fused_pixels;
+  };
+
   void Run();
-  void Fuse();
+  void FuseImage(const int image_idx);
+  void FuseImageParallel(const int image_idx, ThreadPool* thread_pool);
+  void FuseBand(const int image_idx, const int row_start, const int row_end,
+                FusionState* state, std::vector<SpeculativeFusion>* results);
+  void CommitBand(const int image_idx, const int row_start, const int row_end,
+                  const std::vector<SpeculativeFusion>& results);
+  bool Fuse(FusionState* state, const int image_idx, const int row,
+            const int col, PlyPoint* fused_point,
+            std::vector<int>* fused_point_visibility);
+  void FuseAndAppend(FusionState* state, const int image_idx, const int row,
+                     const int col);
+  void PrintThreadStatistics() const;
+
+  bool IsPixelFused(FusionState* state, const int image_idx, const int row,
+                    const int col) const;
+  void SetPixelFused(FusionState* state, const int image_idx, const int row,
+                     const int col);
+
+  // Access the inputs of an image. In multi-threaded fusion, the inputs are
+  // taken from the shared cache and held by the state until they are released.
+  const FusionInputs& GetInputs(FusionState* state, const int image_idx);
+  void ReleaseInputs(FusionState* state);
+  const Bitmap& GetBitmap(FusionState* state, const int image_idx);
+  const DepthMap& GetDepthMap(FusionState* state, const int image_idx);
+  const NormalMap& GetNormalMap(FusionState* state, const int image_idx);
 
   const StereoFusionOptions options_;
   const std::string workspace_path_;
@@ -127,34 +241,19 @@ class StereoFusion : public Thread {
   std::vector<Eigen::Matrix<float, 3, 4, Eigen::RowMajor>> inv_P_;
   std::vector<Eigen::Matrix<float, 3, 3, Eigen::RowMajor>> inv_R_;
 
-  struct FusionData {
-    int image_idx = kInvalidImageId;
-    int row = 0;
-    int col = 0;
-    int traversal_depth = -1;
-    bool operator()(const FusionData& data1, const FusionData& data2) {
-      return data1.image_idx > data2.image_idx;
-    }
-  };
+  // Cache of the inputs for concurrent access in multi-threaded fusion.
+  std::unique_ptr<ShardedLRUCache<int, FusionInputs>> inputs_cache_;
 
-  // Next points to fuse.
-  std::vector<FusionData> fusion_queue_;
+  // State of the sequential fusion and the per-thread states of the parallel
+  // fusion, respectively.
+  FusionState fusion_state_;
+  std::vector<FusionState> thread_fusion_states_;
+  size_t num_speculative_fusions_ = 0;
+  size_t num_conflicting_fusions_ = 0;
 
   // Already fused points.
   std::vector<PlyPoint> fused_points_;
   std::vector<std::vector<int>> fused_points_visibility_;
-
-  // Points of different pixels of the currently point to be fused.
-  std::vector<float> fused_point_x_;
-  std::vector<float> fused_point_y_;
-  std::vector<float> fused_point_z_;
-  std::vector<float> fused_point_nx_;
-  std::vector<float> fused_point_ny_;
-  std::vector<float> fused_point_nz_;
-  std::vector<uint8_t> fused_point_r_;
-  std::vector<uint8_t> fused_point_g_;
-  std::vector<uint8_t> fused_point_b_;
-  std::unordered_set<int> fused_point_visibility_;
 };
 
 // Write the visiblity information into a binary file of the following format:
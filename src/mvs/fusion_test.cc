@@ -0,0 +1,220 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "mvs/fusion_test"
+#include "util/testing.h"
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include "base/pose.h"
+#include "base/reconstruction.h"
+#include "mvs/fusion.h"
+#include "util/bitmap.h"
+#include "util/misc.h"
+
+using namespace colmap;
+using namespace colmap::mvs;
+
+namespace {
+
+const int kWidth = 40;
+const int kHeight = 30;
+const int kNumImages = 3;
+const double kFocalLength = 40;
+const double kPlaneDepth = 10;
+const double kBaseline = 1;
+
+std::string GetImageName(const int image_idx) {
+  return StringPrintf("image%d.png", image_idx);
+}
+
+// Create a workspace of a fronto-parallel plane observed by cameras, which
+// are translated along the x-axis by an integer disparity.
+std::string CreateWorkspace() {
+  const std::string workspace_path = CreateTempPath();
+  CreateDirIfNotExists(workspace_path);
+  CreateDirIfNotExists(JoinPaths(workspace_path, "sparse"));
+  CreateDirIfNotExists(JoinPaths(workspace_path, "images"));
+  CreateDirIfNotExists(JoinPaths(workspace_path, "stereo"));
+  CreateDirIfNotExists(JoinPaths(workspace_path, "stereo", "depth_maps"));
+  CreateDirIfNotExists(JoinPaths(workspace_path, "stereo", "normal_maps"));
+
+  Reconstruction reconstruction;
+
+  Camera camera;
+  camera.SetCameraId(1);
+  camera.InitializeWithName("PINHOLE", kFocalLength, kWidth, kHeight);
+  reconstruction.AddCamera(camera);
+
+  std::vector<std::string> image_names;
+  for (int i = 0; i < kNumImages; ++i) {
+    const image_t image_id = i + 1;
+    image_names.push_back(GetImageName(i));
+
+    colmap::Image image;
+    image.SetImageId(image_id);
+    image.SetCameraId(1);
+    image.SetName(image_names.back());
+    image.SetQvec(ComposeIdentityQuaternion());
+    image.SetTvec(Eigen::Vector3d(-i * kBaseline, 0, 0));
+    image.SetPoints2D(
+        std::vector<Eigen::Vector2d>(kNumImages, Eigen::Vector2d::Zero()));
+    reconstruction.AddImage(image);
+    reconstruction.RegisterImage(image_id);
+
+    Bitmap bitmap;
+    bitmap.Allocate(kWidth, kHeight, true);
+    for (int y = 0; y < kHeight; ++y) {
+      for (int x = 0; x < kWidth; ++x) {
+        bitmap.SetPixel(x, y,
+                        BitmapColor<uint8_t>(5 * x, 7 * y, 50 * i));
+      }
+    }
+    bitmap.Write(JoinPaths(workspace_path, "images", image_names.back()));
+
+    DepthMap depth_map(kWidth, kHeight, 0.5 * kPlaneDepth, 2 * kPlaneDepth);
+    depth_map.Fill(kPlaneDepth);
+    depth_map.Write(JoinPaths(workspace_path, "stereo", "depth_maps",
+                              image_names.back() + ".geometric.bin"));
+
+    NormalMap normal_map(kWidth, kHeight);
+    for (int y = 0; y < kHeight; ++y) {
+      for (int x = 0; x < kWidth; ++x) {
+        normal_map.Set(y, x, 2, -1.0f);
+      }
+    }
+    normal_map.Write(JoinPaths(workspace_path, "stereo", "normal_maps",
+                               image_names.back() + ".geometric.bin"));
+  }
+
+  // Points observed in all images, such that all images overlap.
+  for (int i = 0; i < kNumImages; ++i) {
+    Track track;
+    for (int j = 0; j < kNumImages; ++j) {
+      track.AddElement(j + 1, i);
+    }
+    reconstruction.AddPoint3D(Eigen::Vector3d(i, 0, kPlaneDepth), track);
+  }
+
+  reconstruction.Write(JoinPaths(workspace_path, "sparse"));
+  std::ofstream file(JoinPaths(workspace_path, "stereo", "fusion.cfg"));
+  for (const auto& image_name : image_names) {
+    file << image_name << std::endl;
+  }
+
+  return workspace_path;
+}
+
+void Fuse(const std::string& workspace_path, const int num_threads,
+          const double cache_size, std::vector<PlyPoint>* points,
+          std::vector<std::vector<int>>* points_visibility) {
+  StereoFusionOptions options;
+  options.min_num_pixels = 2;
+  options.num_threads = num_threads;
+  options.cache_size = cache_size;
+  StereoFusion fusion(options, workspace_path, "COLMAP", "", "geometric");
+  fusion.Start();
+  fusion.Wait();
+  *points = fusion.GetFusedPoints();
+  *points_visibility = fusion.GetFusedPointsVisibility();
+}
+
+void CheckEqualPoints(const std::vector<PlyPoint>& points1,
+                      const std::vector<PlyPoint>& points2) {
+  BOOST_REQUIRE_EQUAL(points1.size(), points2.size());
+  for (size_t i = 0; i < points1.size(); ++i) {
+    BOOST_CHECK_EQUAL(points1[i].x, points2[i].x);
+    BOOST_CHECK_EQUAL(points1[i].y, points2[i].y);
+    BOOST_CHECK_EQUAL(points1[i].z, points2[i].z);
+    BOOST_CHECK_EQUAL(points1[i].nx, points2[i].nx);
+    BOOST_CHECK_EQUAL(points1[i].ny, points2[i].ny);
+    BOOST_CHECK_EQUAL(points1[i].nz, points2[i].nz);
+    BOOST_CHECK_EQUAL(points1[i].r, points2[i].r);
+    BOOST_CHECK_EQUAL(points1[i].g, points2[i].g);
+    BOOST_CHECK_EQUAL(points1[i].b, points2[i].b);
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestDeterministic) {
+  const std::string workspace_path = CreateWorkspace();
+
+  std::vector<PlyPoint> points1;
+  std::vector<std::vector<int>> points_visibility1;
+  Fuse(workspace_path, 1, 32, &points1, &points_visibility1);
+
+  std::vector<PlyPoint> points2;
+  std::vector<std::vector<int>> points_visibility2;
+  Fuse(workspace_path, 1, 32, &points2, &points_visibility2);
+
+  std::vector<PlyPoint> points3;
+  std::vector<std::vector<int>> points_visibility3;
+  Fuse(workspace_path, 3, 32, &points3, &points_visibility3);
+
+  BOOST_CHECK_GT(points1.size(), 0);
+  CheckEqualPoints(points1, points2);
+  CheckEqualPoints(points1, points3);
+  BOOST_CHECK(points_visibility1 == points_visibility2);
+  BOOST_CHECK(points_visibility1 == points_visibility3);
+
+  for (const auto& point_visibility : points_visibility1) {
+    BOOST_CHECK_GE(point_visibility.size(), 2);
+    BOOST_CHECK(
+        std::is_sorted(point_visibility.begin(), point_visibility.end()));
+  }
+
+  boost::filesystem::remove_all(workspace_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestSmallCache) {
+  const std::string workspace_path = CreateWorkspace();
+
+  std::vector<PlyPoint> points1;
+  std::vector<std::vector<int>> points_visibility1;
+  Fuse(workspace_path, 1, 32, &points1, &points_visibility1);
+
+  // The cache can only hold the inputs of a single image, so that the inputs
+  // are evicted and read again while the threads fuse the reference images.
+  const double kCacheSize = 1e-9;
+  for (const int num_threads : {1, 3}) {
+    std::vector<PlyPoint> points2;
+    std::vector<std::vector<int>> points_visibility2;
+    Fuse(workspace_path, num_threads, kCacheSize, &points2,
+         &points_visibility2);
+    CheckEqualPoints(points1, points2);
+    BOOST_CHECK(points_visibility1 == points_visibility2);
+  }
+
+  boost::filesystem::remove_all(workspace_path);
+}
@@ -35,7 +35,11 @@
 #include <unordered_set>
 
 #include "mvs/consistency_graph.h"
-#include "mvs/patch_match_cuda.h"
+#include "mvs/patch_match_cpu.h"
+#ifdef CUDA_ENABLED
+#include "mvs/patch_match_cuda_factory.h"
+#include "util/cuda.h"
+#endif
 #include "mvs/workspace.h"
 #include "util/math.h"
 #include "util/misc.h"
@@ -48,11 +52,17 @@ namespace mvs {
 PatchMatch::PatchMatch(const PatchMatchOptions& options, const Problem& problem)
     : options_(options), problem_(problem) {}
 
-PatchMatch::~PatchMatch() {}
+PatchMatch::~PatchMatch() {
+#ifdef CUDA_ENABLED
+  DeletePatchMatchCuda(patch_match_cuda_);
+#endif
+}
 
 void PatchMatchOptions::Print() const {
   PrintHeading2("PatchMatchOptions");
   PrintOption(max_image_size);
+  PrintOption(use_gpu);
+  PrintOption(num_threads);
   PrintOption(gpu_index);
   PrintOption(depth_min);
   PrintOption(depth_max);
@@ -158,26 +168,57 @@ void PatchMatch::Run() {
 
   Check();
 
-  patch_match_cuda_.reset(new PatchMatchCuda(options_, problem_));
-  patch_match_cuda_->Run();
+#ifdef CUDA_ENABLED
+  if (options_.use_gpu) {
+    DeletePatchMatchCuda(patch_match_cuda_);
+    patch_match_cuda_ = CreatePatchMatchCuda(options_, problem_);
+    RunPatchMatchCuda(patch_match_cuda_);
+    return;
+  }
+#endif
+
+  patch_match_cpu_.reset(new PatchMatchCPU(options_, problem_));
+  patch_match_cpu_->Run();
 }
 
 DepthMap PatchMatch::GetDepthMap() const {
-  return patch_match_cuda_->GetDepthMap();
+#ifdef CUDA_ENABLED
+  if (patch_match_cuda_) {
+    return GetPatchMatchCudaDepthMap(*patch_match_cuda_);
+  }
+#endif
+  return patch_match_cpu_->GetDepthMap();
 }
 
 NormalMap PatchMatch::GetNormalMap() const {
-  return patch_match_cuda_->GetNormalMap();
+#ifdef CUDA_ENABLED
+  if (patch_match_cuda_) {
+    return GetPatchMatchCudaNormalMap(*patch_match_cuda_);
+  }
+#endif
+  return patch_match_cpu_->GetNormalMap();
 }
 
 Mat<float> PatchMatch::GetSelProbMap() const {
-  return patch_match_cuda_->GetSelProbMap();
+#ifdef CUDA_ENABLED
+  if (patch_match_cuda_) {
+    return GetPatchMatchCudaSelProbMap(*patch_match_cuda_);
+  }
+#endif
+  return patch_match_cpu_->GetSelProbMap();
 }
 
 ConsistencyGraph PatchMatch::GetConsistencyGraph() const {
   const auto& ref_image = problem_.images->at(problem_.ref_image_idx);
+#ifdef CUDA_ENABLED
+  if (patch_match_cuda_) {
+    return ConsistencyGraph(
+        ref_image.GetWidth(), ref_image.GetHeight(),
+        GetPatchMatchCudaConsistentImageIdxs(*patch_match_cuda_));
+  }
+#endif
   return ConsistencyGraph(ref_image.GetWidth(), ref_image.GetHeight(),
-                          patch_match_cuda_->GetConsistentImageIdxs());
+                          patch_match_cpu_->GetConsistentImageIdxs());
 }
 
 PatchMatchController::PatchMatchController(const PatchMatchOptions& options,
@@ -393,13 +434,22 @@ void PatchMatchController::ReadProblems() {
 }
 
 void PatchMatchController::ReadGpuIndices() {
-  gpu_indices_ = CSVToVector<int>(options_.gpu_index);
-  if (gpu_indices_.size() == 1 && gpu_indices_[0] == -1) {
-    const int num_cuda_devices = GetNumCudaDevices();
-    CHECK_GT(num_cuda_devices, 0);
-    gpu_indices_.resize(num_cuda_devices);
-    std::iota(gpu_indices_.begin(), gpu_indices_.end(), 0);
+#ifdef CUDA_ENABLED
+  if (options_.use_gpu) {
+    gpu_indices_ = CSVToVector<int>(options_.gpu_index);
+    if (gpu_indices_.size() == 1 && gpu_indices_[0] == -1) {
+      const int num_cuda_devices = GetNumCudaDevices();
+      CHECK_GT(num_cuda_devices, 0);
+      gpu_indices_.resize(num_cuda_devices);
+      std::iota(gpu_indices_.begin(), gpu_indices_.end(), 0);
+    }
+    return;
   }
+#endif
+
+  // The CPU implementation processes one problem at a time and parallelizes
+  // within the problem, which keeps the memory usage bounded.
+  gpu_indices_ = {-1};
 }
 
 void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
@@ -53,6 +53,7 @@ namespace mvs {
 const static size_t kMaxPatchMatchWindowRadius = 32;
 
 class ConsistencyGraph;
+class PatchMatchCPU;
 class PatchMatchCuda;
 class Workspace;
 
@@ -60,6 +61,13 @@ struct PatchMatchOptions {
   // Maximum image size in either dimension.
   int max_image_size = -1;
 
+  // Whether to use the Cuda implementation. Otherwise, or if COLMAP was built
+  // without Cuda support, the multi-threaded CPU implementation is used.
+  bool use_gpu = true;
+
+  // Number of threads of the CPU implementation.
+  int num_threads = -1;
+
   // Index of the GPU used for patch match. For multi-GPU usage,
   // you should separate multiple GPU indices by comma, e.g., "0,1,2,3".
   std::string gpu_index = "-1";
@@ -168,9 +176,9 @@ struct PatchMatchOptions {
   }
 };
 
-// This is a wrapper class around the actual PatchMatchCuda implementation. This
-// class is necessary to hide Cuda code from any boost or Eigen code, since
-// NVCC/MSVC cannot compile complex C++ code.
+// This is a wrapper class around the actual PatchMatchCuda and PatchMatchCPU
+// implementations. This class is necessary to hide Cuda code from any boost or
+// Eigen code, since NVCC/MSVC cannot compile complex C++ code.
 class PatchMatch {
  public:
   struct Problem {
@@ -211,7 +219,11 @@ class PatchMatch {
  private:
   const PatchMatchOptions options_;
   const Problem problem_;
-  std::unique_ptr<PatchMatchCuda> patch_match_cuda_;
+#ifdef CUDA_ENABLED
+  // Owned raw pointer, since PatchMatchCuda is only complete in Cuda code.
+  PatchMatchCuda* patch_match_cuda_ = nullptr;
+#endif
+  std::unique_ptr<PatchMatchCPU> patch_match_cpu_;
 };
 
 // This thread processes all problems in a workspace. A workspace has the
@@ -0,0 +1,184 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include <iostream>
+#include <random>
+
+#include "mvs/patch_match.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/threading.h"
+#include "util/timer.h"
+
+using namespace colmap;
+using namespace colmap::mvs;
+
+namespace {
+
+const float kPlaneDepth = 10.0f;
+const float kBaseline = 0.5f;
+
+// Render images of a fronto-parallel plane with a random texture from cameras,
+// which are translated along the x-axis. The reference image is the first.
+std::vector<Image> CreateImages(const int width, const int height,
+                                const int num_images) {
+  const float focal_length = 1.2f * width;
+  const float K[9] = {focal_length, 0, width / 2.0f, 0, focal_length,
+                      height / 2.0f, 0, 0, 1};
+  const float R[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+
+  // Random texture with a resolution of roughly two pixels.
+  const float texel_size = 2 * kPlaneDepth / focal_length;
+  const int texture_width =
+      static_cast<int>(num_images * kBaseline / texel_size) + width + 2;
+  const int texture_height = height + 2;
+  std::vector<uint8_t> texture(texture_width * texture_height);
+  std::mt19937 prng(0);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  for (auto& value : texture) {
+    value = static_cast<uint8_t>(distribution(prng));
+  }
+
+  std::vector<Image> images;
+  for (int i = 0; i < num_images; ++i) {
+    const float center_x = i * kBaseline;
+    const float T[3] = {-center_x, 0, 0};
+    Image image("", width, height, K, R, T);
+    Bitmap bitmap;
+    bitmap.Allocate(width, height, false);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        const float plane_x =
+            center_x + kPlaneDepth * (x - K[2]) / focal_length;
+        const float plane_y = kPlaneDepth * (y - K[5]) / focal_length;
+        const int texel_x = std::max(
+            0, std::min(texture_width - 1,
+                        static_cast<int>(plane_x / texel_size) + width / 2));
+        const int texel_y = std::max(
+            0, std::min(texture_height - 1,
+                        static_cast<int>(plane_y / texel_size) + height / 2));
+        bitmap.SetPixel(x, y, BitmapColor<uint8_t>(
+                                  texture[texel_y * texture_width + texel_x]));
+      }
+    }
+    image.SetBitmap(bitmap);
+    images.push_back(image);
+  }
+  return images;
+}
+
+double TimePatchMatch(const PatchMatchOptions& options,
+                      std::vector<Image>* images) {
+  PatchMatch::Problem problem;
+  problem.ref_image_idx = 0;
+  for (size_t i = 1; i < images->size(); ++i) {
+    problem.src_image_idxs.push_back(i);
+  }
+  problem.images = images;
+
+  Timer timer;
+  timer.Start();
+  PatchMatch patch_match(options, problem);
+  patch_match.Run();
+  return timer.ElapsedSeconds();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  InitializeGlog(argv);
+
+  const int kNumImages = 5;
+
+  PatchMatchOptions options;
+  options.depth_min = 0.5f * kPlaneDepth;
+  options.depth_max = 1.5f * kPlaneDepth;
+  options.sigma_spatial = options.window_radius;
+  options.num_iterations = 1;
+  options.geom_consistency = false;
+  options.filter = false;
+
+  struct Result {
+    int width;
+    int height;
+    std::vector<double> times;
+  };
+
+  std::vector<std::string> backends = {"cpu_1_thread", "cpu_all_threads"};
+#ifdef CUDA_ENABLED
+  backends.push_back("cuda");
+#endif
+
+  std::vector<Result> results;
+  for (const auto& size : std::vector<std::pair<int, int>>{
+           {320, 240}, {640, 480}, {1280, 960}}) {
+    std::vector<Image> images =
+        CreateImages(size.first, size.second, kNumImages);
+
+    Result result;
+    result.width = size.first;
+    result.height = size.second;
+
+    for (const auto& backend : backends) {
+      PatchMatchOptions backend_options = options;
+      backend_options.use_gpu = backend == "cuda";
+      backend_options.num_threads = backend == "cpu_1_thread" ? 1 : -1;
+      result.times.push_back(TimePatchMatch(backend_options, &images));
+    }
+
+    results.push_back(result);
+  }
+
+  // Report the run time per megapixel and iteration of all backends.
+  std::cout << std::endl
+            << StringPrintf("Seconds per megapixel and iteration with %d "
+                            "source images (%d CPU threads):",
+                            kNumImages - 1, GetEffectiveNumThreads(-1))
+            << std::endl;
+  std::cout << StringPrintf("%12s", "size");
+  for (const auto& backend : backends) {
+    std::cout << StringPrintf(" %16s", backend.c_str());
+  }
+  std::cout << std::endl;
+  for (const auto& result : results) {
+    const double num_megapixels = result.width * result.height / 1e6;
+    std::cout << StringPrintf("%12s", StringPrintf("%dx%d", result.width,
+                                                   result.height)
+                                          .c_str());
+    for (const double time : result.times) {
+      std::cout << StringPrintf(" %15.3fs", time / num_megapixels /
+                                                options.num_iterations);
+    }
+    std::cout << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
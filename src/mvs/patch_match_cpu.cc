@@ -0,0 +1,1299 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define _USE_MATH_DEFINES
+
+#include "mvs/patch_match_cpu.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "util/logging.h"
+#include "util/math.h"
+#include "util/misc.h"
+#include "util/timer.h"
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+// Maximum number of depth and normal hypotheses that are evaluated per pixel,
+// i.e. the current, the four propagated, and three randomly perturbed ones.
+const int kMaxNumHypotheses = 8;
+
+// Probability for pixels without neighbors and initial selection probability.
+const float kUniformProb = 0.5f;
+
+// Number of window samples that are processed at once.
+#if defined(__AVX__)
+const int kSIMDWidth = 8;
+#elif defined(__SSE2__)
+const int kSIMDWidth = 4;
+#else
+const int kSIMDWidth = 1;
+#endif
+
+inline void Mat33DotVec3(const float mat[9], const float vec[3],
+                         float result[3]) {
+  result[0] = mat[0] * vec[0] + mat[1] * vec[1] + mat[2] * vec[2];
+  result[1] = mat[3] * vec[0] + mat[4] * vec[1] + mat[5] * vec[2];
+  result[2] = mat[6] * vec[0] + mat[7] * vec[1] + mat[8] * vec[2];
+}
+
+inline void Mat33DotVec3Homogeneous(const float mat[9], const float vec[2],
+                                    float result[2]) {
+  const float inv_z = 1.0f / (mat[6] * vec[0] + mat[7] * vec[1] + mat[8]);
+  result[0] = inv_z * (mat[0] * vec[0] + mat[1] * vec[1] + mat[2]);
+  result[1] = inv_z * (mat[3] * vec[0] + mat[4] * vec[1] + mat[5]);
+}
+
+inline float DotProduct3(const float vec1[3], const float vec2[3]) {
+  return vec1[0] * vec2[0] + vec1[1] * vec2[1] + vec1[2] * vec2[2];
+}
+
+inline float GenerateRandomUniform(std::mt19937* prng) {
+  return std::uniform_real_distribution<float>(0.0f, 1.0f)(*prng);
+}
+
+inline float PerturbDepth(const float perturbation, const float depth,
+                          std::mt19937* prng) {
+  const float depth_min = (1.0f - perturbation) * depth;
+  const float depth_max = (1.0f + perturbation) * depth;
+  return GenerateRandomUniform(prng) * (depth_max - depth_min) + depth_min;
+}
+
+// Bilinearly interpolate the image, which has a border of one zero pixel, at
+// the given coordinates. Coordinates outside the image evaluate to zero,
+// which is equivalent to the border address mode of the Cuda textures.
+inline float InterpolateBilinear(const float* image, const int width,
+                                 const int height, const float col,
+                                 const float row) {
+  if (!(col >= -1.0f && col < width && row >= -1.0f && row < height)) {
+    return 0.0f;
+  }
+
+  const float col_floor = std::floor(col);
+  const float row_floor = std::floor(row);
+  const float col_frac = col - col_floor;
+  const float row_frac = row - row_floor;
+
+  const int padded_width = width + 2;
+  const float* data = image + (static_cast<int>(row_floor) + 1) * padded_width +
+                      static_cast<int>(col_floor) + 1;
+
+  const float top = data[0] + col_frac * (data[1] - data[0]);
+  const float bottom =
+      data[padded_width] +
+      col_frac * (data[padded_width + 1] - data[padded_width]);
+  return top + row_frac * (bottom - top);
+}
+
+// Warp the reference image coordinates of the window samples to the source
+// image using the homography H.
+void WarpWindow(const float H[9], const int num_samples, const float* rows,
+                const float* cols, float* src_rows, float* src_cols) {
+  int i = 0;
+#if defined(__AVX__)
+  const __m256 H0 = _mm256_set1_ps(H[0]);
+  const __m256 H1 = _mm256_set1_ps(H[1]);
+  const __m256 H2 = _mm256_set1_ps(H[2]);
+  const __m256 H3 = _mm256_set1_ps(H[3]);
+  const __m256 H4 = _mm256_set1_ps(H[4]);
+  const __m256 H5 = _mm256_set1_ps(H[5]);
+  const __m256 H6 = _mm256_set1_ps(H[6]);
+  const __m256 H7 = _mm256_set1_ps(H[7]);
+  const __m256 H8 = _mm256_set1_ps(H[8]);
+  for (; i + 8 <= num_samples; i += 8) {
+    const __m256 row = _mm256_loadu_ps(rows + i);
+    const __m256 col = _mm256_loadu_ps(cols + i);
+    const __m256 x = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(H0, col), _mm256_mul_ps(H1, row)), H2);
+    const __m256 y = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(H3, col), _mm256_mul_ps(H4, row)), H5);
+    const __m256 z = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(H6, col), _mm256_mul_ps(H7, row)), H8);
+    const __m256 inv_z = _mm256_div_ps(_mm256_set1_ps(1.0f), z);
+    _mm256_storeu_ps(src_cols + i, _mm256_mul_ps(x, inv_z));
+    _mm256_storeu_ps(src_rows + i, _mm256_mul_ps(y, inv_z));
+  }
+#elif defined(__SSE2__)
+  const __m128 H0 = _mm_set1_ps(H[0]);
+  const __m128 H1 = _mm_set1_ps(H[1]);
+  const __m128 H2 = _mm_set1_ps(H[2]);
+  const __m128 H3 = _mm_set1_ps(H[3]);
+  const __m128 H4 = _mm_set1_ps(H[4]);
+  const __m128 H5 = _mm_set1_ps(H[5]);
+  const __m128 H6 = _mm_set1_ps(H[6]);
+  const __m128 H7 = _mm_set1_ps(H[7]);
+  const __m128 H8 = _mm_set1_ps(H[8]);
+  for (; i + 4 <= num_samples; i += 4) {
+    const __m128 row = _mm_loadu_ps(rows + i);
+    const __m128 col = _mm_loadu_ps(cols + i);
+    const __m128 x =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(H0, col), _mm_mul_ps(H1, row)), H2);
+    const __m128 y =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(H3, col), _mm_mul_ps(H4, row)), H5);
+    const __m128 z =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(H6, col), _mm_mul_ps(H7, row)), H8);
+    const __m128 inv_z = _mm_div_ps(_mm_set1_ps(1.0f), z);
+    _mm_storeu_ps(src_cols + i, _mm_mul_ps(x, inv_z));
+    _mm_storeu_ps(src_rows + i, _mm_mul_ps(y, inv_z));
+  }
+#endif
+  for (; i < num_samples; ++i) {
+    const float inv_z = 1.0f / (H[6] * cols[i] + H[7] * rows[i] + H[8]);
+    src_cols[i] = inv_z * (H[0] * cols[i] + H[1] * rows[i] + H[2]);
+    src_rows[i] = inv_z * (H[3] * cols[i] + H[4] * rows[i] + H[5]);
+  }
+}
+
+// Accumulate the bilaterally weighted sum of the source colors, the squared
+// source colors, and the product of source and reference colors.
+void AccumulateWeightedColors(const int num_samples, const float* weights,
+                              const float* weighted_ref_colors,
+                              const float* src_colors, float* src_color_sum,
+                              float* src_color_squared_sum,
+                              float* src_ref_color_sum) {
+  int i = 0;
+  float sums[3] = {0.0f, 0.0f, 0.0f};
+#if defined(__AVX__)
+  __m256 sum = _mm256_setzero_ps();
+  __m256 squared_sum = _mm256_setzero_ps();
+  __m256 ref_sum = _mm256_setzero_ps();
+  for (; i + 8 <= num_samples; i += 8) {
+    const __m256 src_color = _mm256_loadu_ps(src_colors + i);
+    const __m256 weighted_src_color =
+        _mm256_mul_ps(_mm256_loadu_ps(weights + i), src_color);
+    sum = _mm256_add_ps(sum, weighted_src_color);
+    squared_sum =
+        _mm256_add_ps(squared_sum, _mm256_mul_ps(weighted_src_color, src_color));
+    ref_sum = _mm256_add_ps(
+        ref_sum,
+        _mm256_mul_ps(_mm256_loadu_ps(weighted_ref_colors + i), src_color));
+  }
+  float lanes[3][8];
+  _mm256_storeu_ps(lanes[0], sum);
+  _mm256_storeu_ps(lanes[1], squared_sum);
+  _mm256_storeu_ps(lanes[2], ref_sum);
+  for (int j = 0; j < 3; ++j) {
+    for (int k = 0; k < 8; ++k) {
+      sums[j] += lanes[j][k];
+    }
+  }
+#elif defined(__SSE2__)
+  __m128 sum = _mm_setzero_ps();
+  __m128 squared_sum = _mm_setzero_ps();
+  __m128 ref_sum = _mm_setzero_ps();
+  for (; i + 4 <= num_samples; i += 4) {
+    const __m128 src_color = _mm_loadu_ps(src_colors + i);
+    const __m128 weighted_src_color =
+        _mm_mul_ps(_mm_loadu_ps(weights + i), src_color);
+    sum = _mm_add_ps(sum, weighted_src_color);
+    squared_sum =
+        _mm_add_ps(squared_sum, _mm_mul_ps(weighted_src_color, src_color));
+    ref_sum = _mm_add_ps(
+        ref_sum, _mm_mul_ps(_mm_loadu_ps(weighted_ref_colors + i), src_color));
+  }
+  float lanes[3][4];
+  _mm_storeu_ps(lanes[0], sum);
+  _mm_storeu_ps(lanes[1], squared_sum);
+  _mm_storeu_ps(lanes[2], ref_sum);
+  for (int j = 0; j < 3; ++j) {
+    for (int k = 0; k < 4; ++k) {
+      sums[j] += lanes[j][k];
+    }
+  }
+#endif
+  for (; i < num_samples; ++i) {
+    const float weighted_src_color = weights[i] * src_colors[i];
+    sums[0] += weighted_src_color;
+    sums[1] += weighted_src_color * src_colors[i];
+    sums[2] += weighted_ref_colors[i] * src_colors[i];
+  }
+  *src_color_sum = sums[0];
+  *src_color_squared_sum = sums[1];
+  *src_ref_color_sum = sums[2];
+}
+
+void TransformPDFToCDF(float* probs, const int num_probs) {
+  float prob_sum = 0.0f;
+  for (int i = 0; i < num_probs; ++i) {
+    prob_sum += probs[i];
+  }
+  const float inv_prob_sum = 1.0f / prob_sum;
+
+  float cum_prob = 0.0f;
+  for (int i = 0; i < num_probs; ++i) {
+    const float prob = probs[i] * inv_prob_sum;
+    cum_prob += prob;
+    probs[i] = cum_prob;
+  }
+}
+
+// Host version of the likelihood functions in patch_match_cuda.cu.
+class LikelihoodComputer {
+ public:
+  LikelihoodComputer(const float ncc_sigma, const float min_triangulation_angle,
+                     const float incident_angle_sigma)
+      : cos_min_triangulation_angle_(std::cos(min_triangulation_angle)),
+        inv_incident_angle_sigma_square_(
+            -0.5f / (incident_angle_sigma * incident_angle_sigma)),
+        inv_ncc_sigma_square_(-0.5f / (ncc_sigma * ncc_sigma)),
+        ncc_norm_factor_(ComputeNCCCostNormFactor(ncc_sigma)) {}
+
+  // Compute forward message from current cost and forward message of
+  // previous / neighboring pixel.
+  float ComputeForwardMessage(const float cost, const float prev) const {
+    const float kNoChangeProb = 0.99999f;
+    const float kChangeProb = 1.0f - kNoChangeProb;
+    const float emission = ComputeNCCProb(cost);
+    const float zn0 =
+        (prev * kChangeProb + (1.0f - prev) * kNoChangeProb) * kUniformProb;
+    const float zn1 =
+        (prev * kNoChangeProb + (1.0f - prev) * kChangeProb) * emission;
+    return zn1 / (zn0 + zn1);
+  }
+
+  // Compute the selection probability from the forward and backward message.
+  float ComputeSelProb(const float alpha, const float beta, const float prev,
+                       const float prev_weight) const {
+    const float zn0 = (1.0f - alpha) * (1.0f - beta);
+    const float zn1 = alpha * beta;
+    const float curr = zn1 / (zn0 + zn1);
+    return prev_weight * prev + (1.0f - prev_weight) * curr;
+  }
+
+  // Compute NCC probability. Note that cost = 1 - NCC.
+  float ComputeNCCProb(const float cost) const {
+    return std::exp(cost * cost * inv_ncc_sigma_square_) * ncc_norm_factor_;
+  }
+
+  // Compute the triangulation angle probability.
+  float ComputeTriProb(const float cos_triangulation_angle) const {
+    const float abs_cos_triangulation_angle =
+        std::abs(cos_triangulation_angle);
+    if (abs_cos_triangulation_angle > cos_min_triangulation_angle_) {
+      const float scaled = 1.0f - (1.0f - abs_cos_triangulation_angle) /
+                                      (1.0f - cos_min_triangulation_angle_);
+      const float likelihood = 1.0f - scaled * scaled;
+      return std::min(1.0f, std::max(0.0f, likelihood));
+    } else {
+      return 1.0f;
+    }
+  }
+
+  // Compute the incident angle probability.
+  float ComputeIncProb(const float cos_incident_angle) const {
+    const float x = 1.0f - std::max(0.0f, cos_incident_angle);
+    return std::exp(x * x * inv_incident_angle_sigma_square_);
+  }
+
+  // Compute the warping/resolution prior probability.
+  float ComputeResolutionProb(const int window_radius, const float H[9],
+                              const float row, const float col) const {
+    // Warp corners of patch in reference image to source image.
+    float src1[2];
+    const float ref1[2] = {col - window_radius, row - window_radius};
+    Mat33DotVec3Homogeneous(H, ref1, src1);
+    float src2[2];
+    const float ref2[2] = {col - window_radius, row + window_radius};
+    Mat33DotVec3Homogeneous(H, ref2, src2);
+    float src3[2];
+    const float ref3[2] = {col + window_radius, row + window_radius};
+    Mat33DotVec3Homogeneous(H, ref3, src3);
+    float src4[2];
+    const float ref4[2] = {col + window_radius, row - window_radius};
+    Mat33DotVec3Homogeneous(H, ref4, src4);
+
+    // Compute area of patches in reference and source image.
+    const float window_size = 2 * window_radius + 1;
+    const float ref_area = window_size * window_size;
+    const float src_area = std::abs(
+        0.5f * (src1[0] * src2[1] - src2[0] * src1[1] - src1[0] * src4[1] +
+                src2[0] * src3[1] - src3[0] * src2[1] + src4[0] * src1[1] +
+                src3[0] * src4[1] - src4[0] * src3[1]));
+
+    if (ref_area > src_area) {
+      return src_area / ref_area;
+    } else {
+      return ref_area / src_area;
+    }
+  }
+
+ private:
+  // The normalization for the likelihood function, i.e. the normalization for
+  // the prior on the matching cost.
+  static float ComputeNCCCostNormFactor(const float ncc_sigma) {
+    // A = sqrt(2pi)*sigma/2*erf(sqrt(2)/sigma)
+    // erf(x) = 2/sqrt(pi) * integral from 0 to x of exp(-t^2) dt
+    return 2.0f / (std::sqrt(2.0f * static_cast<float>(M_PI)) * ncc_sigma *
+                   std::erf(2.0f / (ncc_sigma * 1.414213562f)));
+  }
+
+  float cos_min_triangulation_angle_;
+  float inv_incident_angle_sigma_square_;
+  float inv_ncc_sigma_square_;
+  float ncc_norm_factor_;
+};
+
+}  // namespace
+
+PatchMatchCPU::PatchMatchCPU(const PatchMatchOptions& options,
+                             const PatchMatch::Problem& problem)
+    : options_(options), problem_(problem), ref_width_(0), ref_height_(0) {
+  thread_pool_.reset(new ThreadPool(options_.num_threads));
+  thread_workspaces_.resize(thread_pool_->NumThreads());
+  InitRefImage();
+  InitSourceImages();
+  InitWorkspaceMemory();
+}
+
+void PatchMatchCPU::Run() {
+  Timer total_timer;
+  total_timer.Start();
+
+  Timer init_timer;
+  init_timer.Start();
+
+  ParallelForRows([this](const int row, Workspace* workspace) {
+    ComputeInitialCostRow(row, workspace);
+  });
+
+  std::cout << StringPrintf("Initialization: %.4fs",
+                            init_timer.ElapsedSeconds())
+            << std::endl;
+
+  const float total_num_steps = options_.num_iterations * 4;
+
+  PassOptions pass_options;
+  for (int iter = 0; iter < options_.num_iterations; ++iter) {
+    Timer iter_timer;
+    iter_timer.Start();
+
+    for (int sweep = 0; sweep < 4; ++sweep) {
+      Timer sweep_timer;
+      sweep_timer.Start();
+
+      // Exponentially reduce amount of perturbation during the optimization.
+      pass_options.perturbation = 1.0f / std::pow(2.0f, iter + sweep / 4.0f);
+
+      // Linearly increase the influence of previous selection probabilities.
+      pass_options.prev_sel_prob_weight =
+          static_cast<float>(iter * 4 + sweep) / total_num_steps;
+
+      prev_sel_prob_map_ = sel_prob_map_;
+
+      for (int color = 0; color < 2; ++color) {
+        pass_options.stage += 1;
+        pass_options.color = color;
+        ParallelForRows(
+            [this, &pass_options](const int row, Workspace* workspace) {
+              UpdateRow(row, pass_options, workspace);
+            });
+      }
+
+      std::cout << StringPrintf(" Sweep %d: %.4fs", sweep + 1,
+                                sweep_timer.ElapsedSeconds())
+                << std::endl;
+    }
+
+    std::cout << StringPrintf("Iteration %d: %.4fs", iter + 1,
+                              iter_timer.ElapsedSeconds())
+              << std::endl;
+  }
+
+  if (options_.filter) {
+    consistency_mask_ =
+        Mat<uint8_t>(ref_width_, ref_height_, src_images_.size());
+    ParallelForRows([this](const int row, Workspace* workspace) {
+      FilterRow(row, workspace);
+    });
+  }
+
+  std::cout << StringPrintf("Total: %.4fs", total_timer.ElapsedSeconds())
+            << std::endl;
+}
+
+DepthMap PatchMatchCPU::GetDepthMap() const {
+  return DepthMap(depth_map_, options_.depth_min, options_.depth_max);
+}
+
+NormalMap PatchMatchCPU::GetNormalMap() const { return NormalMap(normal_map_); }
+
+Mat<float> PatchMatchCPU::GetSelProbMap() const { return sel_prob_map_; }
+
+std::vector<int> PatchMatchCPU::GetConsistentImageIdxs() const {
+  const Mat<uint8_t>& mask = consistency_mask_;
+  std::vector<int> consistent_image_idxs;
+  std::vector<int> pixel_consistent_image_idxs;
+  pixel_consistent_image_idxs.reserve(mask.GetDepth());
+  for (size_t r = 0; r < mask.GetHeight(); ++r) {
+    for (size_t c = 0; c < mask.GetWidth(); ++c) {
+      pixel_consistent_image_idxs.clear();
+      for (size_t d = 0; d < mask.GetDepth(); ++d) {
+        if (mask.Get(r, c, d)) {
+          pixel_consistent_image_idxs.push_back(problem_.src_image_idxs[d]);
+        }
+      }
+      if (pixel_consistent_image_idxs.size() > 0) {
+        consistent_image_idxs.push_back(c);
+        consistent_image_idxs.push_back(r);
+        consistent_image_idxs.push_back(pixel_consistent_image_idxs.size());
+        consistent_image_idxs.insert(consistent_image_idxs.end(),
+                                     pixel_consistent_image_idxs.begin(),
+                                     pixel_consistent_image_idxs.end());
+      }
+    }
+  }
+  return consistent_image_idxs;
+}
+
+void PatchMatchCPU::InitRefImage() {
+  const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+
+  ref_width_ = static_cast<int>(ref_image.GetWidth());
+  ref_height_ = static_cast<int>(ref_image.GetHeight());
+
+  ref_K_[0] = ref_image.GetK()[0];
+  ref_K_[1] = ref_image.GetK()[2];
+  ref_K_[2] = ref_image.GetK()[4];
+  ref_K_[3] = ref_image.GetK()[5];
+
+  ref_inv_K_[0] = 1.0f / ref_K_[0];
+  ref_inv_K_[1] = -ref_K_[1] / ref_K_[0];
+  ref_inv_K_[2] = 1.0f / ref_K_[2];
+  ref_inv_K_[3] = -ref_K_[3] / ref_K_[2];
+
+  // Pad the reference image, so that the windows never leave the image.
+  const int window_radius = options_.window_radius;
+  padded_ref_width_ = ref_width_ + 2 * window_radius;
+  ref_image_.resize(padded_ref_width_ * (ref_height_ + 2 * window_radius),
+                    0.0f);
+  const Bitmap& bitmap = ref_image.GetBitmap();
+  for (int r = 0; r < ref_height_; ++r) {
+    const uint8_t* scanline = bitmap.GetScanline(r);
+    float* dest =
+        ref_image_.data() + (r + window_radius) * padded_ref_width_ +
+        window_radius;
+    for (int c = 0; c < ref_width_; ++c) {
+      dest[c] = scanline[c] / 255.0f;
+    }
+  }
+
+  for (int row = -window_radius; row <= window_radius;
+       row += options_.window_step) {
+    for (int col = -window_radius; col <= window_radius;
+         col += options_.window_step) {
+      window_row_offsets_.push_back(row);
+      window_col_offsets_.push_back(col);
+    }
+  }
+}
+
+void PatchMatchCPU::InitSourceImages() {
+  const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+
+  src_images_.resize(problem_.src_image_idxs.size());
+  for (size_t i = 0; i < problem_.src_image_idxs.size(); ++i) {
+    const int image_idx = problem_.src_image_idxs[i];
+    const Image& image = problem_.images->at(image_idx);
+    SourceImage& src_image = src_images_[i];
+
+    src_image.width = static_cast<int>(image.GetWidth());
+    src_image.height = static_cast<int>(image.GetHeight());
+
+    src_image.K[0] = image.GetK()[0];
+    src_image.K[1] = image.GetK()[2];
+    src_image.K[2] = image.GetK()[4];
+    src_image.K[3] = image.GetK()[5];
+
+    ComputeRelativePose(ref_image.GetR(), ref_image.GetT(), image.GetR(),
+                        image.GetT(), src_image.R, src_image.T);
+    ComputeProjectionCenter(src_image.R, src_image.T, src_image.C);
+    ComposeProjectionMatrix(image.GetK(), src_image.R, src_image.T,
+                            src_image.P);
+    ComposeInverseProjectionMatrix(image.GetK(), src_image.R, src_image.T,
+                                   src_image.inv_P);
+
+    const int padded_width = src_image.width + 2;
+    src_image.image.resize(padded_width * (src_image.height + 2), 0.0f);
+    const Bitmap& bitmap = image.GetBitmap();
+    for (int r = 0; r < src_image.height; ++r) {
+      const uint8_t* scanline = bitmap.GetScanline(r);
+      float* dest = src_image.image.data() + (r + 1) * padded_width + 1;
+      for (int c = 0; c < src_image.width; ++c) {
+        dest[c] = scanline[c] / 255.0f;
+      }
+    }
+
+    if (options_.geom_consistency) {
+      src_image.depth_map = &problem_.depth_maps->at(image_idx);
+    }
+  }
+}
+
+void PatchMatchCPU::InitWorkspaceMemory() {
+  const size_t num_src_images = src_images_.size();
+
+  depth_map_ = Mat<float>(ref_width_, ref_height_, 1);
+  normal_map_ = Mat<float>(ref_width_, ref_height_, 3);
+  sel_prob_map_ = Mat<float>(ref_width_, ref_height_, num_src_images);
+  sel_prob_map_.Fill(kUniformProb);
+  prev_sel_prob_map_ = sel_prob_map_;
+  cost_map_ = Mat<float>(ref_width_, ref_height_, num_src_images);
+  consistency_mask_ = Mat<uint8_t>(0, 0, 0);
+
+  const int num_window_samples = static_cast<int>(window_row_offsets_.size());
+  const int num_padded_window_samples =
+      (num_window_samples + kSIMDWidth - 1) / kSIMDWidth * kSIMDWidth;
+  for (auto& workspace : thread_workspaces_) {
+    RefPatch& patch = workspace.patch;
+    patch.num_samples = num_padded_window_samples;
+    patch.rows.resize(num_padded_window_samples, 0.0f);
+    patch.cols.resize(num_padded_window_samples, 0.0f);
+    patch.weights.resize(num_padded_window_samples, 0.0f);
+    patch.weighted_colors.resize(num_padded_window_samples, 0.0f);
+    workspace.src_rows.resize(num_padded_window_samples);
+    workspace.src_cols.resize(num_padded_window_samples);
+    workspace.src_colors.resize(num_padded_window_samples);
+    workspace.neighbor_probs.resize(num_src_images);
+    workspace.sampling_probs.resize(num_src_images);
+    workspace.sample_counts.resize(num_src_images);
+    workspace.hypothesis_costs.resize(kMaxNumHypotheses * num_src_images);
+  }
+
+  if (options_.geom_consistency) {
+    const DepthMap& init_depth_map =
+        problem_.depth_maps->at(problem_.ref_image_idx);
+    const NormalMap& init_normal_map =
+        problem_.normal_maps->at(problem_.ref_image_idx);
+    std::copy(init_depth_map.GetData().begin(), init_depth_map.GetData().end(),
+              depth_map_.GetPtr());
+    std::copy(init_normal_map.GetData().begin(),
+              init_normal_map.GetData().end(), normal_map_.GetPtr());
+  } else {
+    ParallelForRows(
+        [this](const int row, Workspace* workspace) { InitRow(row, workspace); });
+  }
+}
+
+void PatchMatchCPU::ParallelForRows(
+    const std::function<void(int, Workspace*)>& func) {
+  std::vector<std::future<void>> futures;
+  futures.reserve(ref_height_);
+  for (int row = 0; row < ref_height_; ++row) {
+    futures.push_back(thread_pool_->AddTask([this, &func, row]() {
+      func(row, &thread_workspaces_.at(thread_pool_->GetThreadIndex()));
+    }));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
+std::mt19937 PatchMatchCPU::GetRowPRNG(const int stage, const int row) const {
+  std::seed_seq seed_seq{problem_.ref_image_idx, stage, row};
+  return std::mt19937(seed_seq);
+}
+
+void PatchMatchCPU::InitRow(const int row, Workspace* workspace) {
+  std::mt19937 prng = GetRowPRNG(0, row);
+  for (int col = 0; col < ref_width_; ++col) {
+    depth_map_.Set(row, col,
+                   GenerateRandomUniform(&prng) *
+                           (options_.depth_max - options_.depth_min) +
+                       options_.depth_min);
+    float normal[3];
+    GenerateRandomNormal(row, col, &prng, normal);
+    for (int i = 0; i < 3; ++i) {
+      normal_map_.Set(row, col, i, normal[i]);
+    }
+  }
+}
+
+void PatchMatchCPU::ComputeInitialCostRow(const int row,
+                                          Workspace* workspace) {
+  for (int col = 0; col < ref_width_; ++col) {
+    ComputeRefPatch(row, col, &workspace->patch);
+    const float depth = depth_map_.Get(row, col);
+    float normal[3];
+    normal_map_.GetSlice(row, col, normal);
+    for (size_t image_idx = 0; image_idx < src_images_.size(); ++image_idx) {
+      cost_map_.Set(row, col, image_idx,
+                    ComputePhotoConsistencyCost(image_idx, depth, normal,
+                                                workspace));
+    }
+  }
+}
+
+void PatchMatchCPU::UpdateRow(const int row, const PassOptions& pass_options,
+                              Workspace* workspace) {
+  std::mt19937 prng = GetRowPRNG(pass_options.stage, row);
+  for (int col = (row + pass_options.color) % 2; col < ref_width_; col += 2) {
+    UpdatePixel(row, col, pass_options, &prng, workspace);
+  }
+}
+
+void PatchMatchCPU::UpdatePixel(const int row, const int col,
+                                const PassOptions& pass_options,
+                                std::mt19937* prng, Workspace* workspace) {
+  const int num_src_images = static_cast<int>(src_images_.size());
+
+  // Direct access to the maps, since this is the innermost loop.
+  const size_t num_pixels = static_cast<size_t>(ref_width_) * ref_height_;
+  const size_t pixel_idx = static_cast<size_t>(row) * ref_width_ + col;
+  float* depth_map = depth_map_.GetPtr();
+  float* normal_map = normal_map_.GetPtr();
+  float* sel_prob_map = sel_prob_map_.GetPtr();
+  const float* prev_sel_prob_map = prev_sel_prob_map_.GetPtr();
+  float* cost_map = cost_map_.GetPtr();
+
+  const LikelihoodComputer likelihood_computer(
+      options_.ncc_sigma, DegToRad(options_.min_triangulation_angle),
+      options_.incident_angle_sigma);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Collect hypotheses from the current pixel, its neighbors, and random
+  // perturbations. Note that the neighbors have the opposite color and are
+  // therefore not modified concurrently.
+  //////////////////////////////////////////////////////////////////////////////
+
+  int num_hypotheses = 0;
+  float depths[kMaxNumHypotheses];
+  float normals[kMaxNumHypotheses][3];
+
+  const float curr_depth = depth_map[pixel_idx];
+  const float curr_normal[3] = {normal_map[pixel_idx],
+                                normal_map[pixel_idx + num_pixels],
+                                normal_map[pixel_idx + 2 * num_pixels]};
+  depths[num_hypotheses] = curr_depth;
+  std::copy(curr_normal, curr_normal + 3, normals[num_hypotheses]);
+  num_hypotheses += 1;
+
+  std::fill(workspace->neighbor_probs.begin(),
+            workspace->neighbor_probs.end(), 0.0f);
+
+  const int kNeighborOffsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+  int num_neighbors = 0;
+  for (int i = 0; i < 4; ++i) {
+    const int neighbor_row = row + kNeighborOffsets[i][0];
+    const int neighbor_col = col + kNeighborOffsets[i][1];
+    if (neighbor_row < 0 || neighbor_row >= ref_height_ || neighbor_col < 0 ||
+        neighbor_col >= ref_width_) {
+      continue;
+    }
+
+    const size_t neighbor_idx =
+        static_cast<size_t>(neighbor_row) * ref_width_ + neighbor_col;
+    float* normal = normals[num_hypotheses];
+    for (int j = 0; j < 3; ++j) {
+      normal[j] = normal_map[neighbor_idx + j * num_pixels];
+    }
+    depths[num_hypotheses] =
+        PropagateDepth(neighbor_row, neighbor_col, depth_map[neighbor_idx],
+                       normal, row, col);
+    num_hypotheses += 1;
+
+    for (int image_idx = 0; image_idx < num_src_images; ++image_idx) {
+      workspace->neighbor_probs[image_idx] +=
+          sel_prob_map[neighbor_idx + image_idx * num_pixels];
+    }
+    num_neighbors += 1;
+  }
+
+  // The averaged selection probabilities of the neighbors replace the forward
+  // message of the previous pixel in the column-wise sweeps.
+  for (int image_idx = 0; image_idx < num_src_images; ++image_idx) {
+    if (num_neighbors == 0) {
+      workspace->neighbor_probs[image_idx] = kUniformProb;
+    } else {
+      workspace->neighbor_probs[image_idx] /= num_neighbors;
+    }
+  }
+
+  const float rand_depth =
+      PerturbDepth(pass_options.perturbation, curr_depth, prng);
+  float rand_normal[3];
+  PerturbNormal(row, col, pass_options.perturbation * M_PI, curr_normal, prng,
+                rand_normal);
+
+  depths[num_hypotheses] = rand_depth;
+  std::copy(rand_normal, rand_normal + 3, normals[num_hypotheses]);
+  num_hypotheses += 1;
+  depths[num_hypotheses] = curr_depth;
+  std::copy(rand_normal, rand_normal + 3, normals[num_hypotheses]);
+  num_hypotheses += 1;
+  depths[num_hypotheses] = rand_depth;
+  std::copy(curr_normal, curr_normal + 3, normals[num_hypotheses]);
+  num_hypotheses += 1;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compute selection probabilities and modulate them with priors.
+  //////////////////////////////////////////////////////////////////////////////
+
+  float point[3];
+  ComputePointAtDepth(row, col, curr_depth, point);
+
+  float* sampling_probs = workspace->sampling_probs.data();
+  for (int image_idx = 0; image_idx < num_src_images; ++image_idx) {
+    const float cost = cost_map[pixel_idx + image_idx * num_pixels];
+    const float alpha = likelihood_computer.ComputeForwardMessage(
+        cost, workspace->neighbor_probs[image_idx]);
+    const float prev_prob =
+        prev_sel_prob_map[pixel_idx + image_idx * num_pixels];
+    const float sel_prob = likelihood_computer.ComputeSelProb(
+        alpha, kUniformProb, prev_prob, pass_options.prev_sel_prob_weight);
+
+    float cos_triangulation_angle;
+    float cos_incident_angle;
+    ComputeViewingAngles(point, curr_normal, image_idx,
+                         &cos_triangulation_angle, &cos_incident_angle);
+    const float tri_prob =
+        likelihood_computer.ComputeTriProb(cos_triangulation_angle);
+    const float inc_prob =
+        likelihood_computer.ComputeIncProb(cos_incident_angle);
+
+    float H[9];
+    ComposeHomography(image_idx, row, col, curr_depth, curr_normal, H);
+    const float res_prob = likelihood_computer.ComputeResolutionProb(
+        options_.window_radius, H, row, col);
+
+    sampling_probs[image_idx] = sel_prob * tri_prob * inc_prob * res_prob;
+  }
+
+  TransformPDFToCDF(sampling_probs, num_src_images);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compute matching cost using Monte Carlo sampling of source images. Since
+  // the costs are deterministic, a source image that is sampled multiple
+  // times is only evaluated once and weighted by its number of samples.
+  //////////////////////////////////////////////////////////////////////////////
+
+  int* sample_counts = workspace->sample_counts.data();
+  std::fill(sample_counts, sample_counts + num_src_images, 0);
+  for (int sample = 0; sample < options_.num_samples; ++sample) {
+    const float rand_prob = GenerateRandomUniform(prng) - FLT_EPSILON;
+    for (int image_idx = 0; image_idx < num_src_images; ++image_idx) {
+      if (sampling_probs[image_idx] > rand_prob) {
+        sample_counts[image_idx] += 1;
+        break;
+      }
+    }
+  }
+
+  ComputeRefPatch(row, col, &workspace->patch);
+
+  // The costs of the current hypothesis are already known.
+  float* hypothesis_costs = workspace->hypothesis_costs.data();
+  for (int image_idx = 0; image_idx < num_src_images; ++image_idx) {
+    hypothesis_costs[image_idx] = cost_map[pixel_idx + image_idx * num_pixels];
+  }
+  std::fill(hypothesis_costs + num_src_images,
+            hypothesis_costs + num_hypotheses * num_src_images, -1.0f);
+
+  float costs[kMaxNumHypotheses];
+  for (int i = 0; i < num_hypotheses; ++i) {
+    costs[i] = 0.0f;
+    for (int image_idx = 0; image_idx < num_src_images; ++image_idx) {
+      const int num_samples = sample_counts[image_idx];
+      if (num_samples == 0) {
+        continue;
+      }
+      float& cost = hypothesis_costs[i * num_src_images + image_idx];
+      if (cost < 0.0f) {
+        cost = ComputePhotoConsistencyCost(image_idx, depths[i], normals[i],
+                                           workspace);
+      }
+      costs[i] += num_samples * cost;
+      if (options_.geom_consistency) {
+        costs[i] += num_samples * options_.geom_consistency_regularizer *
+                    ComputeGeomConsistencyCost(row, col, depths[i], image_idx);
+      }
+    }
+  }
+
+  // Find the parameters of the minimum cost.
+  int min_cost_idx = 0;
+  for (int i = 1; i < num_hypotheses; ++i) {
+    if (costs[i] <= costs[min_cost_idx]) {
+      min_cost_idx = i;
+    }
+  }
+
+  const float best_depth = depths[min_cost_idx];
+  const float* best_normal = normals[min_cost_idx];
+
+  // Save best new parameters.
+  depth_map[pixel_idx] = best_depth;
+  for (int i = 0; i < 3; ++i) {
+    normal_map[pixel_idx + i * num_pixels] = best_normal[i];
+  }
+
+  // Use the new cost to recompute the updated selection probabilities.
+  for (int image_idx = 0; image_idx < num_src_images; ++image_idx) {
+    float cost = hypothesis_costs[min_cost_idx * num_src_images + image_idx];
+    if (cost < 0.0f) {
+      cost = ComputePhotoConsistencyCost(image_idx, best_depth, best_normal,
+                                         workspace);
+    }
+    cost_map[pixel_idx + image_idx * num_pixels] = cost;
+
+    const float alpha = likelihood_computer.ComputeForwardMessage(
+        cost, workspace->neighbor_probs[image_idx]);
+    const float prev_prob =
+        prev_sel_prob_map[pixel_idx + image_idx * num_pixels];
+    sel_prob_map[pixel_idx + image_idx * num_pixels] =
+        likelihood_computer.ComputeSelProb(alpha, kUniformProb, prev_prob,
+                                           pass_options.prev_sel_prob_weight);
+  }
+}
+
+void PatchMatchCPU::FilterRow(const int row, Workspace* workspace) {
+  const LikelihoodComputer likelihood_computer(
+      options_.ncc_sigma, DegToRad(options_.min_triangulation_angle),
+      options_.incident_angle_sigma);
+  const float min_ncc_prob =
+      likelihood_computer.ComputeNCCProb(1.0f - options_.filter_min_ncc);
+  const float cos_min_triangulation_angle =
+      std::cos(DegToRad(options_.filter_min_triangulation_angle));
+
+  for (int col = 0; col < ref_width_; ++col) {
+    const float depth = depth_map_.Get(row, col);
+    float normal[3];
+    normal_map_.GetSlice(row, col, normal);
+
+    float point[3];
+    ComputePointAtDepth(row, col, depth, point);
+
+    int num_consistent = 0;
+    for (size_t image_idx = 0; image_idx < src_images_.size(); ++image_idx) {
+      float cos_triangulation_angle;
+      float cos_incident_angle;
+      ComputeViewingAngles(point, normal, image_idx, &cos_triangulation_angle,
+                           &cos_incident_angle);
+      if (cos_triangulation_angle > cos_min_triangulation_angle ||
+          cos_incident_angle <= 0.0f) {
+        continue;
+      }
+
+      if (sel_prob_map_.Get(row, col, image_idx) < min_ncc_prob) {
+        continue;
+      }
+
+      if (options_.geom_consistency &&
+          ComputeGeomConsistencyCost(row, col, depth, image_idx) >
+              options_.filter_geom_consistency_max_cost) {
+        continue;
+      }
+
+      consistency_mask_.Set(row, col, image_idx, 1);
+      num_consistent += 1;
+    }
+
+    if (num_consistent < options_.filter_min_num_consistent) {
+      const float kFilterValue = 0.0f;
+      depth_map_.Set(row, col, kFilterValue);
+      normal_map_.Set(row, col, 0, kFilterValue);
+      normal_map_.Set(row, col, 1, kFilterValue);
+      normal_map_.Set(row, col, 2, kFilterValue);
+      for (size_t image_idx = 0; image_idx < src_images_.size(); ++image_idx) {
+        consistency_mask_.Set(row, col, image_idx, 0);
+      }
+    }
+  }
+}
+
+void PatchMatchCPU::ComputeRefPatch(const int row, const int col,
+                                    RefPatch* patch) const {
+  if (patch->row == row && patch->col == col) {
+    return;
+  }
+
+  patch->row = row;
+  patch->col = col;
+
+  const float spatial_normalization =
+      1.0f / (2.0f * options_.sigma_spatial * options_.sigma_spatial);
+  const float color_normalization =
+      1.0f / (2.0f * options_.sigma_color * options_.sigma_color);
+
+  const float* ref_center =
+      ref_image_.data() + (row + options_.window_radius) * padded_ref_width_ +
+      col + options_.window_radius;
+  const float center_color = *ref_center;
+
+  float color_sum = 0.0f;
+  float color_squared_sum = 0.0f;
+  float bilateral_weight_sum = 0.0f;
+  for (size_t i = 0; i < window_row_offsets_.size(); ++i) {
+    const int row_offset = window_row_offsets_[i];
+    const int col_offset = window_col_offsets_[i];
+    const float color = ref_center[row_offset * padded_ref_width_ + col_offset];
+    const float color_dist = center_color - color;
+    const float bilateral_weight = std::exp(
+        -(row_offset * row_offset + col_offset * col_offset) *
+            spatial_normalization -
+        color_dist * color_dist * color_normalization);
+    patch->rows[i] = row + row_offset;
+    patch->cols[i] = col + col_offset;
+    patch->weights[i] = bilateral_weight;
+    patch->weighted_colors[i] = bilateral_weight * color;
+    color_sum += bilateral_weight * color;
+    color_squared_sum += bilateral_weight * color * color;
+    bilateral_weight_sum += bilateral_weight;
+  }
+
+  // Normalize the weights, so that the source sums need no normalization.
+  const float inv_bilateral_weight_sum = 1.0f / bilateral_weight_sum;
+  for (size_t i = 0; i < window_row_offsets_.size(); ++i) {
+    patch->weights[i] *= inv_bilateral_weight_sum;
+    patch->weighted_colors[i] *= inv_bilateral_weight_sum;
+  }
+  for (int i = static_cast<int>(window_row_offsets_.size());
+       i < patch->num_samples; ++i) {
+    patch->rows[i] = row;
+    patch->cols[i] = col;
+  }
+
+  patch->color_sum = color_sum * inv_bilateral_weight_sum;
+  patch->color_squared_sum = color_squared_sum * inv_bilateral_weight_sum;
+}
+
+float PatchMatchCPU::ComputePhotoConsistencyCost(const int src_image_idx,
+                                                 const float depth,
+                                                 const float normal[3],
+                                                 Workspace* workspace) const {
+  // Maximum photo consistency cost as 1 - min(NCC).
+  const float kMaxCost = 2.0f;
+
+  const RefPatch& patch = workspace->patch;
+  const SourceImage& src_image = src_images_[src_image_idx];
+
+  float H[9];
+  ComposeHomography(src_image_idx, patch.row, patch.col, depth, normal, H);
+
+  float* src_rows = workspace->src_rows.data();
+  float* src_cols = workspace->src_cols.data();
+  float* src_colors = workspace->src_colors.data();
+
+  WarpWindow(H, patch.num_samples, patch.rows.data(), patch.cols.data(),
+             src_rows, src_cols);
+  for (int i = 0; i < patch.num_samples; ++i) {
+    src_colors[i] =
+        InterpolateBilinear(src_image.image.data(), src_image.width,
+                            src_image.height, src_cols[i], src_rows[i]);
+  }
+
+  float src_color_sum;
+  float src_color_squared_sum;
+  float src_ref_color_sum;
+  AccumulateWeightedColors(patch.num_samples, patch.weights.data(),
+                           patch.weighted_colors.data(), src_colors,
+                           &src_color_sum, &src_color_squared_sum,
+                           &src_ref_color_sum);
+
+  const float ref_color_var =
+      patch.color_squared_sum - patch.color_sum * patch.color_sum;
+  const float src_color_var =
+      src_color_squared_sum - src_color_sum * src_color_sum;
+
+  // Based on Jensen's Inequality for convex functions, the variance
+  // should always be larger than 0. Do not make this threshold smaller.
+  const float kMinVar = 1e-5f;
+  if (ref_color_var < kMinVar || src_color_var < kMinVar) {
+    return kMaxCost;
+  } else {
+    const float src_ref_color_covar =
+        src_ref_color_sum - patch.color_sum * src_color_sum;
+    const float src_ref_color_var = std::sqrt(ref_color_var * src_color_var);
+    return std::max(
+        0.0f, std::min(kMaxCost, 1.0f - src_ref_color_covar / src_ref_color_var));
+  }
+}
+
+float PatchMatchCPU::ComputeGeomConsistencyCost(const int row, const int col,
+                                                const float depth,
+                                                const int src_image_idx) const {
+  const float max_cost = options_.geom_consistency_max_cost;
+  const SourceImage& src_image = src_images_[src_image_idx];
+  const float* P = src_image.P;
+  const float* inv_P = src_image.inv_P;
+
+  // Project point in reference image to world.
+  float forward_point[3];
+  ComputePointAtDepth(row, col, depth, forward_point);
+
+  // Project world point to source image.
+  const float inv_forward_z =
+      1.0f / (P[8] * forward_point[0] + P[9] * forward_point[1] +
+              P[10] * forward_point[2] + P[11]);
+  float src_col =
+      inv_forward_z * (P[0] * forward_point[0] + P[1] * forward_point[1] +
+                       P[2] * forward_point[2] + P[3]);
+  float src_row =
+      inv_forward_z * (P[4] * forward_point[0] + P[5] * forward_point[1] +
+                       P[6] * forward_point[2] + P[7]);
+
+  // Extract depth in source image with nearest neighbor interpolation.
+  const float src_col_round = std::floor(src_col + 0.5f);
+  const float src_row_round = std::floor(src_row + 0.5f);
+  if (!(src_col_round >= 0 && src_col_round < src_image.width &&
+        src_row_round >= 0 && src_row_round < src_image.height)) {
+    return max_cost;
+  }
+  const float src_depth =
+      src_image.depth_map->Get(static_cast<size_t>(src_row_round),
+                               static_cast<size_t>(src_col_round));
+
+  // Projection outside of source image.
+  if (src_depth == 0.0f) {
+    return max_cost;
+  }
+
+  // Project point in source image to world.
+  src_col *= src_depth;
+  src_row *= src_depth;
+  const float backward_point_x =
+      inv_P[0] * src_col + inv_P[1] * src_row + inv_P[2] * src_depth + inv_P[3];
+  const float backward_point_y =
+      inv_P[4] * src_col + inv_P[5] * src_row + inv_P[6] * src_depth + inv_P[7];
+  const float backward_point_z = inv_P[8] * src_col + inv_P[9] * src_row +
+                                 inv_P[10] * src_depth + inv_P[11];
+  const float inv_backward_point_z = 1.0f / backward_point_z;
+
+  // Project world point back to reference image.
+  const float backward_col =
+      inv_backward_point_z *
+      (ref_K_[0] * backward_point_x + ref_K_[1] * backward_point_z);
+  const float backward_row =
+      inv_backward_point_z *
+      (ref_K_[2] * backward_point_y + ref_K_[3] * backward_point_z);
+
+  // Return truncated reprojection error between original observation and
+  // the forward-backward projected observation.
+  const float diff_col = col - backward_col;
+  const float diff_row = row - backward_row;
+  return std::min(max_cost,
+                  std::sqrt(diff_col * diff_col + diff_row * diff_row));
+}
+
+void PatchMatchCPU::ComposeHomography(const int src_image_idx, const int row,
+                                      const int col, const float depth,
+                                      const float normal[3],
+                                      float H[9]) const {
+  const SourceImage& src_image = src_images_[src_image_idx];
+  const float* K = src_image.K;
+  const float* R = src_image.R;
+  const float* T = src_image.T;
+
+  // Distance to the plane.
+  const float dist =
+      depth * (normal[0] * (ref_inv_K_[0] * col + ref_inv_K_[1]) +
+               normal[1] * (ref_inv_K_[2] * row + ref_inv_K_[3]) + normal[2]);
+  const float inv_dist = 1.0f / dist;
+
+  const float inv_dist_N0 = inv_dist * normal[0];
+  const float inv_dist_N1 = inv_dist * normal[1];
+  const float inv_dist_N2 = inv_dist * normal[2];
+
+  // Homography as H = K * (R - T * n' / d) * Kref^-1.
+  H[0] = ref_inv_K_[0] * (K[0] * (R[0] + inv_dist_N0 * T[0]) +
+                          K[1] * (R[6] + inv_dist_N0 * T[2]));
+  H[1] = ref_inv_K_[2] * (K[0] * (R[1] + inv_dist_N1 * T[0]) +
+                          K[1] * (R[7] + inv_dist_N1 * T[2]));
+  H[2] = K[0] * (R[2] + inv_dist_N2 * T[0]) +
+         K[1] * (R[8] + inv_dist_N2 * T[2]) +
+         ref_inv_K_[1] * (K[0] * (R[0] + inv_dist_N0 * T[0]) +
+                          K[1] * (R[6] + inv_dist_N0 * T[2])) +
+         ref_inv_K_[3] * (K[0] * (R[1] + inv_dist_N1 * T[0]) +
+                          K[1] * (R[7] + inv_dist_N1 * T[2]));
+  H[3] = ref_inv_K_[0] * (K[2] * (R[3] + inv_dist_N0 * T[1]) +
+                          K[3] * (R[6] + inv_dist_N0 * T[2]));
+  H[4] = ref_inv_K_[2] * (K[2] * (R[4] + inv_dist_N1 * T[1]) +
+                          K[3] * (R[7] + inv_dist_N1 * T[2]));
+  H[5] = K[2] * (R[5] + inv_dist_N2 * T[1]) +
+         K[3] * (R[8] + inv_dist_N2 * T[2]) +
+         ref_inv_K_[1] * (K[2] * (R[3] + inv_dist_N0 * T[1]) +
+                          K[3] * (R[6] + inv_dist_N0 * T[2])) +
+         ref_inv_K_[3] * (K[2] * (R[4] + inv_dist_N1 * T[1]) +
+                          K[3] * (R[7] + inv_dist_N1 * T[2]));
+  H[6] = ref_inv_K_[0] * (R[6] + inv_dist_N0 * T[2]);
+  H[7] = ref_inv_K_[2] * (R[7] + inv_dist_N1 * T[2]);
+  H[8] = R[8] + ref_inv_K_[1] * (R[6] + inv_dist_N0 * T[2]) +
+         ref_inv_K_[3] * (R[7] + inv_dist_N1 * T[2]) + inv_dist_N2 * T[2];
+}
+
+void PatchMatchCPU::ComputeViewingAngles(const float point[3],
+                                         const float normal[3],
+                                         const int src_image_idx,
+                                         float* cos_triangulation_angle,
+                                         float* cos_incident_angle) const {
+  // Projection center of source image.
+  const float* C = src_images_[src_image_idx].C;
+
+  // Ray from point to camera.
+  const float SX[3] = {C[0] - point[0], C[1] - point[1], C[2] - point[2]};
+
+  // Length of ray from reference image to point.
+  const float RX_inv_norm = 1.0f / std::sqrt(DotProduct3(point, point));
+
+  // Length of ray from source image to point.
+  const float SX_inv_norm = 1.0f / std::sqrt(DotProduct3(SX, SX));
+
+  *cos_incident_angle = DotProduct3(SX, normal) * SX_inv_norm;
+  *cos_triangulation_angle = DotProduct3(SX, point) * RX_inv_norm * SX_inv_norm;
+}
+
+void PatchMatchCPU::ComputePointAtDepth(const float row, const float col,
+                                        const float depth,
+                                        float point[3]) const {
+  point[0] = depth * (ref_inv_K_[0] * col + ref_inv_K_[1]);
+  point[1] = depth * (ref_inv_K_[2] * row + ref_inv_K_[3]);
+  point[2] = depth;
+}
+
+float PatchMatchCPU::PropagateDepth(const int src_row, const int src_col,
+                                    const float src_depth,
+                                    const float src_normal[3], const int row,
+                                    const int col) const {
+  // Intersect the viewing ray through (row, col) with the plane through the
+  // point at the source pixel.
+  float src_point[3];
+  ComputePointAtDepth(src_row, src_col, src_depth, src_point);
+  const float ray[3] = {ref_inv_K_[0] * col + ref_inv_K_[1],
+                        ref_inv_K_[2] * row + ref_inv_K_[3], 1.0f};
+  const float denom = DotProduct3(src_normal, ray);
+  const float kEps = 1e-5f;
+  if (std::abs(denom) < kEps) {
+    return src_depth;
+  }
+  const float depth = DotProduct3(src_normal, src_point) / denom;
+  if (depth <= 0.0f) {
+    return src_depth;
+  }
+  return depth;
+}
+
+void PatchMatchCPU::GenerateRandomNormal(const int row, const int col,
+                                         std::mt19937* prng,
+                                         float normal[3]) const {
+  // Unbiased sampling of normal, according to George Marsaglia, "Choosing a
+  // Point from the Surface of a Sphere", 1972.
+  float v1 = 0.0f;
+  float v2 = 0.0f;
+  float s = 2.0f;
+  while (s >= 1.0f) {
+    v1 = 2.0f * GenerateRandomUniform(prng) - 1.0f;
+    v2 = 2.0f * GenerateRandomUniform(prng) - 1.0f;
+    s = v1 * v1 + v2 * v2;
+  }
+
+  const float s_norm = std::sqrt(1.0f - s);
+  normal[0] = 2.0f * v1 * s_norm;
+  normal[1] = 2.0f * v2 * s_norm;
+  normal[2] = 1.0f - 2.0f * s;
+
+  // Make sure normal is looking away from camera.
+  const float view_ray[3] = {ref_inv_K_[0] * col + ref_inv_K_[1],
+                             ref_inv_K_[2] * row + ref_inv_K_[3], 1.0f};
+  if (DotProduct3(normal, view_ray) > 0) {
+    normal[0] = -normal[0];
+    normal[1] = -normal[1];
+    normal[2] = -normal[2];
+  }
+}
+
+void PatchMatchCPU::PerturbNormal(const int row, const int col,
+                                  const float perturbation,
+                                  const float normal[3], std::mt19937* prng,
+                                  float perturbed_normal[3],
+                                  const int num_trials) const {
+  // Perturbation rotation angles.
+  const float a1 = (GenerateRandomUniform(prng) - 0.5f) * perturbation;
+  const float a2 = (GenerateRandomUniform(prng) - 0.5f) * perturbation;
+  const float a3 = (GenerateRandomUniform(prng) - 0.5f) * perturbation;
+
+  const float sin_a1 = std::sin(a1);
+  const float sin_a2 = std::sin(a2);
+  const float sin_a3 = std::sin(a3);
+  const float cos_a1 = std::cos(a1);
+  const float cos_a2 = std::cos(a2);
+  const float cos_a3 = std::cos(a3);
+
+  // R = Rx * Ry * Rz
+  float R[9];
+  R[0] = cos_a2 * cos_a3;
+  R[1] = -cos_a2 * sin_a3;
+  R[2] = sin_a2;
+  R[3] = cos_a1 * sin_a3 + cos_a3 * sin_a1 * sin_a2;
+  R[4] = cos_a1 * cos_a3 - sin_a1 * sin_a2 * sin_a3;
+  R[5] = -cos_a2 * sin_a1;
+  R[6] = sin_a1 * sin_a3 - cos_a1 * cos_a3 * sin_a2;
+  R[7] = cos_a3 * sin_a1 + cos_a1 * sin_a2 * sin_a3;
+  R[8] = cos_a1 * cos_a2;
+
+  // Perturb the normal vector.
+  Mat33DotVec3(R, normal, perturbed_normal);
+
+  // Make sure the perturbed normal is still looking in the same direction as
+  // the viewing direction, otherwise try again but with smaller perturbation.
+  const float view_ray[3] = {ref_inv_K_[0] * col + ref_inv_K_[1],
+                             ref_inv_K_[2] * row + ref_inv_K_[3], 1.0f};
+  if (DotProduct3(perturbed_normal, view_ray) >= 0.0f) {
+    const int kMaxNumTrials = 3;
+    if (num_trials < kMaxNumTrials) {
+      PerturbNormal(row, col, 0.5f * perturbation, normal, prng,
+                    perturbed_normal, num_trials + 1);
+      return;
+    } else {
+      perturbed_normal[0] = normal[0];
+      perturbed_normal[1] = normal[1];
+      perturbed_normal[2] = normal[2];
+      return;
+    }
+  }
+
+  // Make sure normal has unit norm.
+  const float inv_norm =
+      1.0f / std::sqrt(DotProduct3(perturbed_normal, perturbed_normal));
+  perturbed_normal[0] *= inv_norm;
+  perturbed_normal[1] *= inv_norm;
+  perturbed_normal[2] *= inv_norm;
+}
+
+}  // namespace mvs
+}  // namespace colmap
@@ -0,0 +1,210 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_MVS_PATCH_MATCH_CPU_H_
+#define COLMAP_SRC_MVS_PATCH_MATCH_CPU_H_
+
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "mvs/depth_map.h"
+#include "mvs/image.h"
+#include "mvs/mat.h"
+#include "mvs/normal_map.h"
+#include "mvs/patch_match.h"
+#include "util/threading.h"
+
+namespace colmap {
+namespace mvs {
+
+// CPU implementation of the photometric and geometric consistency patch match
+// algorithm in `PatchMatchCuda`. It uses the same cost function, view
+// selection, and filtering, but instead of the four directional sweeps of the
+// Cuda implementation, the hypotheses are propagated in a red/black
+// checkerboard scheme: In each pass, first all "red" pixels with even
+// `row + col` are updated and then all "black" pixels. Since the
+// four-connected neighbors of a pixel have the opposite color, all pixels of
+// one color can be updated independently and the rows are processed in
+// parallel. The random number generators are seeded per row, so that the
+// output does not depend on the number of threads.
+class PatchMatchCPU {
+ public:
+  PatchMatchCPU(const PatchMatchOptions& options,
+                const PatchMatch::Problem& problem);
+
+  void Run();
+
+  DepthMap GetDepthMap() const;
+  NormalMap GetNormalMap() const;
+  Mat<float> GetSelProbMap() const;
+  std::vector<int> GetConsistentImageIdxs() const;
+
+ private:
+  // Calibration and relative pose from the reference to a source image.
+  struct SourceImage {
+    int width = 0;
+    int height = 0;
+    // Calibration as {fx, cx, fy, cy}.
+    float K[4];
+    // Relative rotation, translation, and projection center.
+    float R[9];
+    float T[3];
+    float C[3];
+    // Relative projection and inverse projection matrix.
+    float P[12];
+    float inv_P[12];
+    // Normalized intensities with a border of one zero pixel.
+    std::vector<float> image;
+    // Depth map for the geometric consistency term.
+    const DepthMap* depth_map = nullptr;
+  };
+
+  // Bilaterally weighted window around a reference pixel, which is reused
+  // for all photometric consistency costs of the pixel. The number of window
+  // samples is padded to a multiple of the SIMD width with zero weights.
+  struct RefPatch {
+    int row = -1;
+    int col = -1;
+    int num_samples = 0;
+    std::vector<float> rows;
+    std::vector<float> cols;
+    std::vector<float> weights;
+    std::vector<float> weighted_colors;
+    float color_sum = 0.0f;
+    float color_squared_sum = 0.0f;
+  };
+
+  // Per-thread scratch memory for the pixel updates.
+  struct Workspace {
+    RefPatch patch;
+    std::vector<float> src_rows;
+    std::vector<float> src_cols;
+    std::vector<float> src_colors;
+    std::vector<float> neighbor_probs;
+    std::vector<float> sampling_probs;
+    std::vector<int> sample_counts;
+    // Photometric consistency costs per hypothesis and source image.
+    std::vector<float> hypothesis_costs;
+  };
+
+  // Parameters that change over the course of the optimization.
+  struct PassOptions {
+    int stage = 0;
+    int color = 0;
+    float perturbation = 1.0f;
+    float prev_sel_prob_weight = 0.0f;
+  };
+
+  void InitRefImage();
+  void InitSourceImages();
+  void InitWorkspaceMemory();
+
+  // Execute the function for all rows in parallel and wait for completion.
+  void ParallelForRows(const std::function<void(int, Workspace*)>& func);
+
+  // Random number generator for the given row and optimization stage of the
+  // reference image.
+  std::mt19937 GetRowPRNG(const int stage, const int row) const;
+
+  void InitRow(const int row, Workspace* workspace);
+  void ComputeInitialCostRow(const int row, Workspace* workspace);
+  void UpdateRow(const int row, const PassOptions& pass_options,
+                 Workspace* workspace);
+  void UpdatePixel(const int row, const int col,
+                   const PassOptions& pass_options, std::mt19937* prng,
+                   Workspace* workspace);
+  void FilterRow(const int row, Workspace* workspace);
+
+  void ComputeRefPatch(const int row, const int col, RefPatch* patch) const;
+  float ComputePhotoConsistencyCost(const int src_image_idx, const float depth,
+                                    const float normal[3],
+                                    Workspace* workspace) const;
+  float ComputeGeomConsistencyCost(const int row, const int col,
+                                   const float depth,
+                                   const int src_image_idx) const;
+
+  void ComposeHomography(const int src_image_idx, const int row,
+                         const int col, const float depth,
+                         const float normal[3], float H[9]) const;
+  void ComputeViewingAngles(const float point[3], const float normal[3],
+                            const int src_image_idx,
+                            float* cos_triangulation_angle,
+                            float* cos_incident_angle) const;
+  void ComputePointAtDepth(const float row, const float col, const float depth,
+                           float point[3]) const;
+  float PropagateDepth(const int src_row, const int src_col,
+                       const float src_depth, const float src_normal[3],
+                       const int row, const int col) const;
+  void GenerateRandomNormal(const int row, const int col, std::mt19937* prng,
+                            float normal[3]) const;
+  void PerturbNormal(const int row, const int col, const float perturbation,
+                     const float normal[3], std::mt19937* prng,
+                     float perturbed_normal[3], const int num_trials = 0) const;
+
+  const PatchMatchOptions options_;
+  const PatchMatch::Problem problem_;
+
+  std::unique_ptr<ThreadPool> thread_pool_;
+  std::vector<Workspace> thread_workspaces_;
+
+  int ref_width_;
+  int ref_height_;
+
+  // Calibration of reference image as {fx, cx, fy, cy}.
+  float ref_K_[4];
+  // Calibration of reference image as {1/fx, -cx/fx, 1/fy, -cy/fy}.
+  float ref_inv_K_[4];
+
+  // Normalized intensities of the reference image with a zero border of
+  // `window_radius` pixels.
+  int padded_ref_width_;
+  std::vector<float> ref_image_;
+
+  std::vector<SourceImage> src_images_;
+
+  // Vertical and horizontal offsets of the window samples.
+  std::vector<int> window_row_offsets_;
+  std::vector<int> window_col_offsets_;
+
+  Mat<float> depth_map_;
+  Mat<float> normal_map_;
+  Mat<float> sel_prob_map_;
+  Mat<float> prev_sel_prob_map_;
+  Mat<float> cost_map_;
+  Mat<uint8_t> consistency_mask_;
+};
+
+}  // namespace mvs
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_MVS_PATCH_MATCH_CPU_H_
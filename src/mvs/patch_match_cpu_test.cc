@@ -0,0 +1,220 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "mvs/patch_match_cpu_test"
+#include "util/testing.h"
+
+#include <random>
+
+#include "mvs/patch_match_cpu.h"
+
+using namespace colmap;
+using namespace colmap::mvs;
+
+namespace {
+
+const int kWidth = 80;
+const int kHeight = 60;
+const float kFocalLength = 100.0f;
+const float kPlaneDepth = 10.0f;
+const float kBaseline = 1.0f;
+const int kTextureGridSize = 200;
+const float kTextureGridSpacing = 0.3f;
+
+// Smooth random texture on the plane, which is evaluated by bilinearly
+// interpolating random values on a regular grid.
+class PlaneTexture {
+ public:
+  PlaneTexture() : values_(kTextureGridSize * kTextureGridSize) {
+    std::mt19937 prng(0);
+    std::uniform_real_distribution<float> distribution(0.0f, 255.0f);
+    for (auto& value : values_) {
+      value = distribution(prng);
+    }
+  }
+
+  uint8_t Evaluate(const float x, const float y) const {
+    const float grid_x = x / kTextureGridSpacing + kTextureGridSize / 2;
+    const float grid_y = y / kTextureGridSpacing + kTextureGridSize / 2;
+    const int x0 = static_cast<int>(std::floor(grid_x));
+    const int y0 = static_cast<int>(std::floor(grid_y));
+    const float dx = grid_x - x0;
+    const float dy = grid_y - y0;
+    const float top = (1 - dx) * values_[y0 * kTextureGridSize + x0] +
+                      dx * values_[y0 * kTextureGridSize + x0 + 1];
+    const float bottom =
+        (1 - dx) * values_[(y0 + 1) * kTextureGridSize + x0] +
+        dx * values_[(y0 + 1) * kTextureGridSize + x0 + 1];
+    return static_cast<uint8_t>((1 - dy) * top + dy * bottom);
+  }
+
+ private:
+  std::vector<float> values_;
+};
+
+// Render images of a fronto-parallel textured plane from cameras, which are
+// translated along the x-axis.
+std::vector<Image> CreateImages(const int num_images) {
+  const PlaneTexture texture;
+  const float K[9] = {kFocalLength, 0, kWidth / 2.0f, 0, kFocalLength,
+                      kHeight / 2.0f, 0, 0, 1};
+  const float R[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+
+  std::vector<Image> images;
+  for (int i = 0; i < num_images; ++i) {
+    const float center_x = i * kBaseline;
+    const float T[3] = {-center_x, 0, 0};
+    Image image("", kWidth, kHeight, K, R, T);
+    Bitmap bitmap;
+    bitmap.Allocate(kWidth, kHeight, false);
+    for (int y = 0; y < kHeight; ++y) {
+      for (int x = 0; x < kWidth; ++x) {
+        const float plane_x =
+            center_x + kPlaneDepth * (x - K[2]) / kFocalLength;
+        const float plane_y = kPlaneDepth * (y - K[5]) / kFocalLength;
+        bitmap.SetPixel(x, y, BitmapColor<uint8_t>(
+                                  texture.Evaluate(plane_x, plane_y)));
+      }
+    }
+    image.SetBitmap(bitmap);
+    images.push_back(image);
+  }
+  return images;
+}
+
+PatchMatchOptions CreateOptions() {
+  PatchMatchOptions options;
+  options.depth_min = 0.5f * kPlaneDepth;
+  options.depth_max = 1.5f * kPlaneDepth;
+  options.window_radius = 3;
+  options.sigma_spatial = options.window_radius;
+  options.num_iterations = 3;
+  options.geom_consistency = false;
+  options.filter = false;
+  return options;
+}
+
+PatchMatch::Problem CreateProblem(std::vector<Image>* images) {
+  PatchMatch::Problem problem;
+  problem.ref_image_idx = 1;
+  problem.src_image_idxs = {0, 2};
+  problem.images = images;
+  return problem;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestFrontoParallelPlane) {
+  std::vector<Image> images = CreateImages(3);
+  PatchMatchOptions options = CreateOptions();
+  options.num_threads = 2;
+
+  PatchMatchCPU patch_match(options, CreateProblem(&images));
+  patch_match.Run();
+
+  const DepthMap depth_map = patch_match.GetDepthMap();
+  const NormalMap normal_map = patch_match.GetNormalMap();
+  BOOST_CHECK_EQUAL(depth_map.GetWidth(), kWidth);
+  BOOST_CHECK_EQUAL(depth_map.GetHeight(), kHeight);
+  BOOST_CHECK_EQUAL(normal_map.GetWidth(), kWidth);
+  BOOST_CHECK_EQUAL(normal_map.GetHeight(), kHeight);
+  BOOST_CHECK_EQUAL(patch_match.GetSelProbMap().GetDepth(), 2);
+  BOOST_CHECK(patch_match.GetConsistentImageIdxs().empty());
+
+  // Ignore the image border, which is not visible in all images.
+  const int kBorder = 15;
+  int num_pixels = 0;
+  int num_correct_depths = 0;
+  int num_correct_normals = 0;
+  for (int row = kBorder; row < kHeight - kBorder; ++row) {
+    for (int col = kBorder; col < kWidth - kBorder; ++col) {
+      num_pixels += 1;
+      if (std::abs(depth_map.Get(row, col) - kPlaneDepth) <
+          0.02f * kPlaneDepth) {
+        num_correct_depths += 1;
+      }
+      if (normal_map.Get(row, col, 2) < -0.95f) {
+        num_correct_normals += 1;
+      }
+    }
+  }
+
+  BOOST_CHECK_GT(num_correct_depths, 0.9 * num_pixels);
+  BOOST_CHECK_GT(num_correct_normals, 0.8 * num_pixels);
+}
+
+BOOST_AUTO_TEST_CASE(TestFilter) {
+  std::vector<Image> images = CreateImages(3);
+  PatchMatchOptions options = CreateOptions();
+  options.filter = true;
+  options.filter_min_num_consistent = 2;
+
+  PatchMatchCPU patch_match1(options, CreateProblem(&images));
+  patch_match1.Run();
+
+  const DepthMap depth_map1 = patch_match1.GetDepthMap();
+  BOOST_CHECK_GT(depth_map1.Get(kHeight / 2, kWidth / 2), 0.0f);
+  BOOST_CHECK(!patch_match1.GetConsistentImageIdxs().empty());
+
+  // There are only two source images, so every pixel must be filtered.
+  options.filter_min_num_consistent = 3;
+  PatchMatchCPU patch_match2(options, CreateProblem(&images));
+  patch_match2.Run();
+
+  const DepthMap depth_map2 = patch_match2.GetDepthMap();
+  for (int row = 0; row < kHeight; ++row) {
+    for (int col = 0; col < kWidth; ++col) {
+      BOOST_CHECK_EQUAL(depth_map2.Get(row, col), 0.0f);
+    }
+  }
+  BOOST_CHECK(patch_match2.GetConsistentImageIdxs().empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestIndependentOfNumThreads) {
+  std::vector<Image> images = CreateImages(3);
+  PatchMatchOptions options = CreateOptions();
+  options.num_iterations = 1;
+
+  options.num_threads = 1;
+  PatchMatchCPU patch_match1(options, CreateProblem(&images));
+  patch_match1.Run();
+
+  options.num_threads = 3;
+  PatchMatchCPU patch_match2(options, CreateProblem(&images));
+  patch_match2.Run();
+
+  BOOST_CHECK(patch_match1.GetDepthMap().GetData() ==
+              patch_match2.GetDepthMap().GetData());
+  BOOST_CHECK(patch_match1.GetNormalMap().GetData() ==
+              patch_match2.GetNormalMap().GetData());
+  BOOST_CHECK(patch_match1.GetSelProbMap().GetData() ==
+              patch_match2.GetSelProbMap().GetData());
+}
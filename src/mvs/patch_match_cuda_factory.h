@@ -0,0 +1,62 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_MVS_PATCH_MATCH_CUDA_FACTORY_H_
+#define COLMAP_SRC_MVS_PATCH_MATCH_CUDA_FACTORY_H_
+
+#include <vector>
+
+#include "mvs/depth_map.h"
+#include "mvs/normal_map.h"
+#include "mvs/patch_match.h"
+
+namespace colmap {
+namespace mvs {
+
+// Host-only interface to PatchMatchCuda. The implementation is compiled by
+// NVCC, so that PatchMatch can be compiled by the host compiler without
+// including any Cuda headers.
+PatchMatchCuda* CreatePatchMatchCuda(const PatchMatchOptions& options,
+                                     const PatchMatch::Problem& problem);
+void DeletePatchMatchCuda(PatchMatchCuda* patch_match_cuda);
+
+void RunPatchMatchCuda(PatchMatchCuda* patch_match_cuda);
+
+DepthMap GetPatchMatchCudaDepthMap(const PatchMatchCuda& patch_match_cuda);
+NormalMap GetPatchMatchCudaNormalMap(const PatchMatchCuda& patch_match_cuda);
+Mat<float> GetPatchMatchCudaSelProbMap(const PatchMatchCuda& patch_match_cuda);
+std::vector<int> GetPatchMatchCudaConsistentImageIdxs(
+    const PatchMatchCuda& patch_match_cuda);
+
+}  // namespace mvs
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_MVS_PATCH_MATCH_CUDA_FACTORY_H_
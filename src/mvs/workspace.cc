@@ -87,11 +87,7 @@ const Bitmap& Workspace::GetBitmap(const int image_idx) {
   auto& cached_image = cache_.GetMutable(image_idx);
   if (!cached_image.bitmap) {
     cached_image.bitmap.reset(new Bitmap());
-    cached_image.bitmap->Read(GetBitmapPath(image_idx), options_.image_as_rgb);
-    if (options_.max_image_size > 0) {
-      cached_image.bitmap->Rescale(model_.images.at(image_idx).GetWidth(),
-                                   model_.images.at(image_idx).GetHeight());
-    }
+    ReadBitmap(image_idx, cached_image.bitmap.get());
     cached_image.num_bytes += cached_image.bitmap->NumBytes();
     cache_.UpdateNumBytes(image_idx);
   }
@@ -102,11 +98,7 @@ const DepthMap& Workspace::GetDepthMap(const int image_idx) {
   auto& cached_image = cache_.GetMutable(image_idx);
   if (!cached_image.depth_map) {
     cached_image.depth_map.reset(new DepthMap());
-    cached_image.depth_map->Read(GetDepthMapPath(image_idx));
-    if (options_.max_image_size > 0) {
-      cached_image.depth_map->Downsize(model_.images.at(image_idx).GetWidth(),
-                                       model_.images.at(image_idx).GetHeight());
-    }
+    ReadDepthMap(image_idx, cached_image.depth_map.get());
     cached_image.num_bytes += cached_image.depth_map->GetNumBytes();
     cache_.UpdateNumBytes(image_idx);
   }
@@ -117,18 +109,38 @@ const NormalMap& Workspace::GetNormalMap(const int image_idx) {
   auto& cached_image = cache_.GetMutable(image_idx);
   if (!cached_image.normal_map) {
     cached_image.normal_map.reset(new NormalMap());
-    cached_image.normal_map->Read(GetNormalMapPath(image_idx));
-    if (options_.max_image_size > 0) {
-      cached_image.normal_map->Downsize(
-          model_.images.at(image_idx).GetWidth(),
-          model_.images.at(image_idx).GetHeight());
-    }
+    ReadNormalMap(image_idx, cached_image.normal_map.get());
     cached_image.num_bytes += cached_image.normal_map->GetNumBytes();
     cache_.UpdateNumBytes(image_idx);
   }
   return *cached_image.normal_map;
 }
 
+void Workspace::ReadBitmap(const int image_idx, Bitmap* bitmap) const {
+  bitmap->Read(GetBitmapPath(image_idx), options_.image_as_rgb);
+  if (options_.max_image_size > 0) {
+    bitmap->Rescale(model_.images.at(image_idx).GetWidth(),
+                    model_.images.at(image_idx).GetHeight());
+  }
+}
+
+void Workspace::ReadDepthMap(const int image_idx, DepthMap* depth_map) const {
+  depth_map->Read(GetDepthMapPath(image_idx));
+  if (options_.max_image_size > 0) {
+    depth_map->Downsize(model_.images.at(image_idx).GetWidth(),
+                        model_.images.at(image_idx).GetHeight());
+  }
+}
+
+void Workspace::ReadNormalMap(const int image_idx,
+                              NormalMap* normal_map) const {
+  normal_map->Read(GetNormalMapPath(image_idx));
+  if (options_.max_image_size > 0) {
+    normal_map->Downsize(model_.images.at(image_idx).GetWidth(),
+                         model_.images.at(image_idx).GetHeight());
+  }
+}
+
 std::string Workspace::GetBitmapPath(const int image_idx) const {
   return model_.images.at(image_idx).GetPath();
 }
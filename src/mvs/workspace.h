@@ -72,6 +72,12 @@ class Workspace {
   const DepthMap& GetDepthMap(const int image_idx);
   const NormalMap& GetNormalMap(const int image_idx);
 
+  // Read the bitmap, depth map, and normal map of an image without caching
+  // them. In contrast to the cached accessors, these functions are thread-safe.
+  void ReadBitmap(const int image_idx, Bitmap* bitmap) const;
+  void ReadDepthMap(const int image_idx, DepthMap* depth_map) const;
+  void ReadNormalMap(const int image_idx, NormalMap* normal_map) const;
+
   // Get paths to bitmap, depth map, normal map and consistency graph.
   std::string GetBitmapPath(const int image_idx) const;
   std::string GetDepthMapPath(const int image_idx) const;
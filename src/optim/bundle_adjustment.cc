@@ -31,6 +31,7 @@
 
 #include "optim/bundle_adjustment.h"
 
+#include <algorithm>
 #include <iomanip>
 
 #ifdef OPENMP_ENABLED
@@ -245,6 +246,213 @@ void BundleAdjustmentConfig::RemoveConstantPoint(const point3D_t point3D_id) {
   constant_point3D_ids_.erase(point3D_id);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// BundleAdjustmentSolverPlan
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Compute the number of variable 3D points and covisible image pairs.
+void ComputeCovisibilityStats(const BundleAdjustmentConfig& config,
+                              const Reconstruction& reconstruction,
+                              BundleAdjustmentProblemStats* stats) {
+  // All 3D points observed by the images are added to the problem and only the
+  // constant 3D points are not eliminated in the Schur complement.
+  std::unordered_set<point3D_t> point3D_ids = config.VariablePoints();
+  for (const image_t image_id : config.Images()) {
+    for (const Point2D& point2D : reconstruction.Image(image_id).Points2D()) {
+      if (point2D.HasPoint3D() &&
+          !config.HasConstantPoint(point2D.Point3DId())) {
+        point3D_ids.insert(point2D.Point3DId());
+      }
+    }
+  }
+  stats->num_points = point3D_ids.size();
+
+  // Images outside of the configuration have constant poses and thus do not
+  // contribute to the reduced camera system.
+  std::unordered_set<uint64_t> image_pairs;
+  std::vector<image_t> image_ids;
+  for (const point3D_t point3D_id : point3D_ids) {
+    image_ids.clear();
+    for (const auto& track_el :
+         reconstruction.Point3D(point3D_id).Track().Elements()) {
+      if (config.HasImage(track_el.image_id)) {
+        image_ids.push_back(track_el.image_id);
+      }
+    }
+    std::sort(image_ids.begin(), image_ids.end());
+    image_ids.erase(std::unique(image_ids.begin(), image_ids.end()),
+                    image_ids.end());
+    for (size_t i = 0; i < image_ids.size(); ++i) {
+      for (size_t j = i + 1; j < image_ids.size(); ++j) {
+        image_pairs.insert(static_cast<uint64_t>(image_ids[i]) << 32 |
+                           image_ids[j]);
+      }
+    }
+  }
+  stats->num_covisible_image_pairs = image_pairs.size();
+}
+
+ceres::Solver::Options CreateSolverOptions(
+    const BundleAdjustmentOptions& options,
+    const BundleAdjustmentConfig& config, const Reconstruction& reconstruction,
+    const int num_residuals, BundleAdjustmentSolverPlan* plan,
+    BundleAdjustmentProblemStats* stats) {
+  // The covisibility is only needed to select the solver and its computation
+  // is quadratic in the track lengths, so it is skipped otherwise.
+  *stats = BundleAdjustmentProblemStats();
+  stats->num_images = config.NumImages();
+  if (options.auto_select_solver) {
+    ComputeCovisibilityStats(config, reconstruction, stats);
+  }
+  stats->num_residuals = static_cast<size_t>(num_residuals);
+  *plan = PlanBundleAdjustmentSolver(options, *stats);
+  ceres::Solver::Options solver_options = options.solver_options;
+  plan->Apply(&solver_options);
+  return solver_options;
+}
+
+// Indices of the camera parameters that are not refined.
+std::vector<int> GetConstantCameraParams(const BundleAdjustmentOptions& options,
+                                         const Camera& camera) {
+  std::vector<int> const_camera_params;
+
+  if (!options.refine_focal_length) {
+    const std::vector<size_t>& params_idxs = camera.FocalLengthIdxs();
+    const_camera_params.insert(const_camera_params.end(), params_idxs.begin(),
+                               params_idxs.end());
+  }
+  if (!options.refine_principal_point) {
+    const std::vector<size_t>& params_idxs = camera.PrincipalPointIdxs();
+    const_camera_params.insert(const_camera_params.end(), params_idxs.begin(),
+                               params_idxs.end());
+  }
+  if (!options.refine_extra_params) {
+    const std::vector<size_t>& params_idxs = camera.ExtraParamsIdxs();
+    const_camera_params.insert(const_camera_params.end(), params_idxs.begin(),
+                               params_idxs.end());
+  }
+
+  return const_camera_params;
+}
+
+}  // namespace
+
+double BundleAdjustmentProblemStats::AverageNumCovisibleImages() const {
+  if (num_images == 0) {
+    return 0;
+  }
+  return 2.0 * num_covisible_image_pairs / num_images;
+}
+
+BundleAdjustmentProblemStats ComputeBundleAdjustmentProblemStats(
+    const BundleAdjustmentConfig& config,
+    const Reconstruction& reconstruction) {
+  BundleAdjustmentProblemStats stats;
+  stats.num_images = config.NumImages();
+  stats.num_residuals = config.NumResiduals(reconstruction);
+  ComputeCovisibilityStats(config, reconstruction, &stats);
+  return stats;
+}
+
+void BundleAdjustmentSolverPlan::Apply(
+    ceres::Solver::Options* solver_options) const {
+  solver_options->linear_solver_type = linear_solver_type;
+  solver_options->preconditioner_type = preconditioner_type;
+  solver_options->visibility_clustering_type = visibility_clustering_type;
+  solver_options->num_threads = num_threads;
+#if CERES_VERSION_MAJOR < 2
+  solver_options->num_linear_solver_threads = num_linear_solver_threads;
+#endif  // CERES_VERSION_MAJOR
+}
+
+BundleAdjustmentSolverPlan PlanBundleAdjustmentSolver(
+    const BundleAdjustmentOptions& options,
+    const BundleAdjustmentProblemStats& stats) {
+  const ceres::Solver::Options& solver_options = options.solver_options;
+
+  BundleAdjustmentSolverPlan plan;
+  plan.linear_solver_type = solver_options.linear_solver_type;
+  plan.preconditioner_type = solver_options.preconditioner_type;
+  plan.visibility_clustering_type = solver_options.visibility_clustering_type;
+
+  if (stats.num_residuals <
+      static_cast<size_t>(options.min_num_residuals_for_multi_threading)) {
+    plan.num_threads = 1;
+#if CERES_VERSION_MAJOR < 2
+    plan.num_linear_solver_threads = 1;
+#endif  // CERES_VERSION_MAJOR
+  } else {
+    plan.num_threads = GetEffectiveNumThreads(solver_options.num_threads);
+#if CERES_VERSION_MAJOR < 2
+    plan.num_linear_solver_threads =
+        GetEffectiveNumThreads(solver_options.num_linear_solver_threads);
+#endif  // CERES_VERSION_MAJOR
+  }
+
+  // Empirical choices.
+  const size_t kMaxNumImagesDirectDenseSolver = 50;
+  const size_t kMaxNumImagesDirectSparseSolver = 1000;
+
+  if (!options.auto_select_solver) {
+    if (stats.num_images <= kMaxNumImagesDirectDenseSolver) {
+      plan.linear_solver_type = ceres::DENSE_SCHUR;
+    } else if (stats.num_images <= kMaxNumImagesDirectSparseSolver) {
+      plan.linear_solver_type = ceres::SPARSE_SCHUR;
+    } else {  // Indirect sparse (preconditioned CG) solver.
+      plan.linear_solver_type = ceres::ITERATIVE_SCHUR;
+      plan.preconditioner_type = ceres::SCHUR_JACOBI;
+    }
+    return plan;
+  }
+
+  const size_t kMaxNumImagesSparseCovisibilitySolver = 20000;
+  const double kMaxNumCovisibleImagesSparseSolver = 25;
+  const double kMinNumCovisibleImagesClusterPreconditioner = 10;
+  const size_t kMinNumResidualsPerThread = 10000;
+
+  const size_t num_images = stats.num_images;
+  const double num_covisible_images = stats.AverageNumCovisibleImages();
+  const bool has_sparse_solver =
+      ceres::IsSparseLinearAlgebraLibraryTypeAvailable(
+          solver_options.sparse_linear_algebra_library_type);
+
+  if (num_images <= kMaxNumImagesDirectDenseSolver) {
+    plan.linear_solver_type = ceres::DENSE_SCHUR;
+  } else if (has_sparse_solver &&
+             (num_images <= kMaxNumImagesDirectSparseSolver ||
+              (num_images <= kMaxNumImagesSparseCovisibilitySolver &&
+               num_covisible_images <= kMaxNumCovisibleImagesSparseSolver))) {
+    // The factorization of a reduced camera system with sparse covisibility,
+    // e.g., for sequential or street-level imagery, has little fill-in.
+    plan.linear_solver_type = ceres::SPARSE_SCHUR;
+  } else {  // Indirect sparse (preconditioned CG) solver.
+    plan.linear_solver_type = ceres::ITERATIVE_SCHUR;
+    // The visibility-based preconditioners are only implemented for
+    // SuiteSparse and only pay off when cameras are strongly coupled.
+    if (solver_options.sparse_linear_algebra_library_type ==
+            ceres::SUITE_SPARSE &&
+        has_sparse_solver &&
+        num_covisible_images >= kMinNumCovisibleImagesClusterPreconditioner) {
+      plan.preconditioner_type = ceres::CLUSTER_JACOBI;
+      plan.visibility_clustering_type = ceres::SINGLE_LINKAGE;
+    } else {
+      plan.preconditioner_type = ceres::SCHUR_JACOBI;
+    }
+  }
+
+  const int max_num_threads = std::max(
+      1, static_cast<int>(stats.num_residuals / kMinNumResidualsPerThread));
+  plan.num_threads = std::min(plan.num_threads, max_num_threads);
+#if CERES_VERSION_MAJOR < 2
+  plan.num_linear_solver_threads =
+      std::min(plan.num_linear_solver_threads, max_num_threads);
+#endif  // CERES_VERSION_MAJOR
+
+  return plan;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // BundleAdjuster
 ////////////////////////////////////////////////////////////////////////////////
@@ -268,35 +476,11 @@ bool BundleAdjuster::Solve(Reconstruction* reconstruction) {
     return false;
   }
 
-  ceres::Solver::Options solver_options = options_.solver_options;
-
-  // Empirical choice.
-  const size_t kMaxNumImagesDirectDenseSolver = 50;
-  const size_t kMaxNumImagesDirectSparseSolver = 1000;
-  const size_t num_images = config_.NumImages();
-  if (num_images <= kMaxNumImagesDirectDenseSolver) {
-    solver_options.linear_solver_type = ceres::DENSE_SCHUR;
-  } else if (num_images <= kMaxNumImagesDirectSparseSolver) {
-    solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
-  } else {  // Indirect sparse (preconditioned CG) solver.
-    solver_options.linear_solver_type = ceres::ITERATIVE_SCHUR;
-    solver_options.preconditioner_type = ceres::SCHUR_JACOBI;
-  }
-
-  if (problem_->NumResiduals() <
-      options_.min_num_residuals_for_multi_threading) {
-    solver_options.num_threads = 1;
-#if CERES_VERSION_MAJOR < 2
-    solver_options.num_linear_solver_threads = 1;
-#endif  // CERES_VERSION_MAJOR
-  } else {
-    solver_options.num_threads =
-        GetEffectiveNumThreads(solver_options.num_threads);
-#if CERES_VERSION_MAJOR < 2
-    solver_options.num_linear_solver_threads =
-        GetEffectiveNumThreads(solver_options.num_linear_solver_threads);
-#endif  // CERES_VERSION_MAJOR
-  }
+  BundleAdjustmentSolverPlan plan;
+  BundleAdjustmentProblemStats stats;
+  const ceres::Solver::Options solver_options =
+      CreateSolverOptions(options_, config_, *reconstruction,
+                          problem_->NumResiduals(), &plan, &stats);
 
   std::string solver_error;
   CHECK(solver_options.IsValid(&solver_error)) << solver_error;
@@ -310,6 +494,7 @@ bool BundleAdjuster::Solve(Reconstruction* reconstruction) {
   if (options_.print_summary) {
     PrintHeading2("Bundle adjustment report");
     PrintSolverSummary(summary_);
+    PrintSolverPlan(plan, stats);
   }
 
   TearDown(reconstruction);
@@ -490,23 +675,8 @@ void BundleAdjuster::ParameterizeCameras(Reconstruction* reconstruction) {
       problem_->SetParameterBlockConstant(camera.ParamsData());
       continue;
     } else {
-      std::vector<int> const_camera_params;
-
-      if (!options_.refine_focal_length) {
-        const std::vector<size_t>& params_idxs = camera.FocalLengthIdxs();
-        const_camera_params.insert(const_camera_params.end(),
-                                   params_idxs.begin(), params_idxs.end());
-      }
-      if (!options_.refine_principal_point) {
-        const std::vector<size_t>& params_idxs = camera.PrincipalPointIdxs();
-        const_camera_params.insert(const_camera_params.end(),
-                                   params_idxs.begin(), params_idxs.end());
-      }
-      if (!options_.refine_extra_params) {
-        const std::vector<size_t>& params_idxs = camera.ExtraParamsIdxs();
-        const_camera_params.insert(const_camera_params.end(),
-                                   params_idxs.begin(), params_idxs.end());
-      }
+      const std::vector<int> const_camera_params =
+          GetConstantCameraParams(options_, camera);
 
       if (const_camera_params.size() > 0) {
         ceres::SubsetParameterization* camera_params_parameterization =
@@ -533,6 +703,395 @@ void BundleAdjuster::ParameterizePoints(Reconstruction* reconstruction) {
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// PersistentBundleAdjuster
+////////////////////////////////////////////////////////////////////////////////
+
+PersistentBundleAdjuster::PersistentBundleAdjuster()
+    : reconstruction_(nullptr),
+      loss_function_(new ceres::LossFunctionWrapper(new ceres::TrivialLoss(),
+                                                    ceres::TAKE_OWNERSHIP)),
+      quaternion_parameterization_(new ceres::QuaternionParameterization()),
+      num_added_residual_blocks_(0),
+      num_removed_residual_blocks_(0) {
+  Reset();
+}
+
+bool PersistentBundleAdjuster::Solve(const BundleAdjustmentOptions& options,
+                                     const BundleAdjustmentConfig& config,
+                                     Reconstruction* reconstruction) {
+  CHECK_NOTNULL(reconstruction);
+  CHECK(options.Check());
+
+  // The parameterization of the cameras cannot be changed once the camera is
+  // added to the problem. Parameters, which were moved in memory, e.g., after
+  // the reconstruction was replaced, cannot be updated in the problem.
+  if (reconstruction != reconstruction_ ||
+      options.refine_focal_length != options_.refine_focal_length ||
+      options.refine_principal_point != options_.refine_principal_point ||
+      options.refine_extra_params != options_.refine_extra_params ||
+      !HasValidParameters(*reconstruction)) {
+    Reset();
+  }
+
+  options_ = options;
+  reconstruction_ = reconstruction;
+  loss_function_->Reset(options_.CreateLossFunction(), ceres::TAKE_OWNERSHIP);
+
+  num_added_residual_blocks_ = 0;
+  num_removed_residual_blocks_ = 0;
+
+  // Collect the observations of the configuration, as in `BundleAdjuster`.
+  std::unordered_map<uint64_t, point3D_t> observations;
+  std::unordered_map<point3D_t, size_t> point3D_num_observations;
+  std::unordered_set<camera_t> variable_camera_ids;
+
+  for (const image_t image_id : config.Images()) {
+    const Image& image = reconstruction->Image(image_id);
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      const Point2D& point2D = image.Point2D(point2D_idx);
+      if (point2D.HasPoint3D()) {
+        observations.emplace(
+            static_cast<uint64_t>(image_id) << 32 | point2D_idx,
+            point2D.Point3DId());
+        point3D_num_observations[point2D.Point3DId()] += 1;
+        variable_camera_ids.insert(image.CameraId());
+      }
+    }
+  }
+
+  auto AddPointObservations = [&](const point3D_t point3D_id) {
+    const Point3D& point3D = reconstruction->Point3D(point3D_id);
+    for (const auto& track_el : point3D.Track().Elements()) {
+      if (!config.HasImage(track_el.image_id) &&
+          observations
+              .emplace(static_cast<uint64_t>(track_el.image_id) << 32 |
+                           track_el.point2D_idx,
+                       point3D_id)
+              .second) {
+        point3D_num_observations[point3D_id] += 1;
+      }
+    }
+  };
+
+  for (const point3D_t point3D_id : config.VariablePoints()) {
+    AddPointObservations(point3D_id);
+  }
+  for (const point3D_t point3D_id : config.ConstantPoints()) {
+    AddPointObservations(point3D_id);
+  }
+
+  // Ceres cannot change the parameterization of a parameter block, so images
+  // with a different set of constant translation components must be re-added.
+  std::vector<image_t> changed_image_ids;
+  for (const auto& image : images_) {
+    if (image.second.constant_tvec_idxs !=
+        GetConstantTvecIdxs(config, image.first)) {
+      changed_image_ids.push_back(image.first);
+    }
+  }
+  for (const image_t image_id : changed_image_ids) {
+    RemoveImage(image_id);
+  }
+
+  // Remove the residuals of observations that left the configuration or that
+  // belong to a different 3D point than before, e.g., after merging tracks.
+  for (auto it = residuals_.begin(); it != residuals_.end();) {
+    const auto observation = observations.find(it->first);
+    if (observation == observations.end() ||
+        observation->second != it->second.point3D_id) {
+      RemoveResidual(static_cast<image_t>(it->first >> 32), it->second);
+      it = residuals_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Add the residuals of observations that entered the configuration.
+  for (const auto& observation : observations) {
+    if (residuals_.count(observation.first) == 0) {
+      AddResidual(static_cast<image_t>(observation.first >> 32),
+                  static_cast<point2D_t>(observation.first & 0xFFFFFFFF),
+                  observation.second, config, reconstruction);
+    }
+  }
+
+  if (residuals_.empty()) {
+    return false;
+  }
+
+  // Fix or free the parameters according to the current configuration.
+  for (const auto& image : images_) {
+    const bool constant_pose = !options_.refine_extrinsics ||
+                               !config.HasImage(image.first) ||
+                               config.HasConstantPose(image.first);
+    if (constant_pose) {
+      problem_->SetParameterBlockConstant(image.second.qvec_data);
+      problem_->SetParameterBlockConstant(image.second.tvec_data);
+    } else {
+      // CostFunction assumes unit quaternions.
+      reconstruction->Image(image.first).NormalizeQvec();
+      problem_->SetParameterBlockVariable(image.second.qvec_data);
+      problem_->SetParameterBlockVariable(image.second.tvec_data);
+    }
+  }
+
+  const bool constant_camera = !options_.refine_focal_length &&
+                               !options_.refine_principal_point &&
+                               !options_.refine_extra_params;
+  for (const auto& camera : cameras_) {
+    if (constant_camera || config.IsConstantCamera(camera.first) ||
+        variable_camera_ids.count(camera.first) == 0) {
+      problem_->SetParameterBlockConstant(camera.second.data);
+    } else {
+      problem_->SetParameterBlockVariable(camera.second.data);
+    }
+  }
+
+  // All 3D points in the problem still exist, since the residuals of deleted
+  // 3D points were removed above. Their positions may have been changed, e.g.,
+  // by global bundle adjustment or by merging tracks.
+  for (auto& point3D : points3D_) {
+    const Point3D& rec_point3D = reconstruction->Point3D(point3D.first);
+    point3D.second.xyz = rec_point3D.XYZ();
+    if (config.HasConstantPoint(point3D.first) ||
+        rec_point3D.Track().Length() >
+            point3D_num_observations.at(point3D.first)) {
+      problem_->SetParameterBlockConstant(point3D.second.xyz.data());
+    } else {
+      problem_->SetParameterBlockVariable(point3D.second.xyz.data());
+    }
+  }
+
+  BundleAdjustmentSolverPlan plan;
+  BundleAdjustmentProblemStats stats;
+  const ceres::Solver::Options solver_options =
+      CreateSolverOptions(options_, config, *reconstruction,
+                          problem_->NumResiduals(), &plan, &stats);
+
+  std::string solver_error;
+  CHECK(solver_options.IsValid(&solver_error)) << solver_error;
+
+  ceres::Solve(solver_options, problem_.get(), &summary_);
+
+  if (solver_options.minimizer_progress_to_stdout) {
+    std::cout << std::endl;
+  }
+
+  if (options_.print_summary) {
+    PrintHeading2("Bundle adjustment report");
+    PrintSolverSummary(summary_);
+    PrintSolverPlan(plan, stats);
+  }
+
+  for (const auto& point3D : points3D_) {
+    reconstruction->Point3D(point3D.first).XYZ() = point3D.second.xyz;
+  }
+
+  return true;
+}
+
+void PersistentBundleAdjuster::Reset() {
+  ceres::Problem::Options problem_options;
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  problem_options.local_parameterization_ownership =
+      ceres::DO_NOT_TAKE_OWNERSHIP;
+  problem_options.enable_fast_removal = true;
+  problem_.reset(new ceres::Problem(problem_options));
+
+  reconstruction_ = nullptr;
+  images_.clear();
+  cameras_.clear();
+  points3D_.clear();
+  residuals_.clear();
+}
+
+const ceres::Solver::Summary& PersistentBundleAdjuster::Summary() const {
+  return summary_;
+}
+
+size_t PersistentBundleAdjuster::NumAddedResidualBlocks() const {
+  return num_added_residual_blocks_;
+}
+
+size_t PersistentBundleAdjuster::NumRemovedResidualBlocks() const {
+  return num_removed_residual_blocks_;
+}
+
+bool PersistentBundleAdjuster::HasValidParameters(
+    const Reconstruction& reconstruction) const {
+  for (const auto& image : images_) {
+    if (!reconstruction.ExistsImage(image.first)) {
+      return false;
+    }
+    const Image& rec_image = reconstruction.Image(image.first);
+    if (rec_image.Qvec().data() != image.second.qvec_data ||
+        rec_image.Tvec().data() != image.second.tvec_data ||
+        rec_image.CameraId() != image.second.camera_id) {
+      return false;
+    }
+  }
+
+  for (const auto& camera : cameras_) {
+    if (!reconstruction.ExistsCamera(camera.first) ||
+        reconstruction.Camera(camera.first).ParamsData() !=
+            camera.second.data) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void PersistentBundleAdjuster::AddResidual(const image_t image_id,
+                                           const point2D_t point2D_idx,
+                                           const point3D_t point3D_id,
+                                           const BundleAdjustmentConfig& config,
+                                           Reconstruction* reconstruction) {
+  Image& image = reconstruction->Image(image_id);
+  Camera& camera = reconstruction->Camera(image.CameraId());
+  const Point3D& point3D = reconstruction->Point3D(point3D_id);
+
+  ImageBlocks& image_blocks = images_[image_id];
+  if (image_blocks.num_residuals == 0) {
+    image_blocks.qvec_data = image.Qvec().data();
+    image_blocks.tvec_data = image.Tvec().data();
+    image_blocks.camera_id = image.CameraId();
+    image_blocks.constant_tvec_idxs = GetConstantTvecIdxs(config, image_id);
+    problem_->AddParameterBlock(image_blocks.qvec_data, 4,
+                                quaternion_parameterization_.get());
+    if (image_blocks.constant_tvec_idxs.empty()) {
+      problem_->AddParameterBlock(image_blocks.tvec_data, 3);
+    } else {
+      problem_->AddParameterBlock(
+          image_blocks.tvec_data, 3,
+          GetSubsetParameterization(3, image_blocks.constant_tvec_idxs));
+    }
+  }
+
+  ParameterBlock& camera_block = cameras_[image.CameraId()];
+  if (camera_block.num_residuals == 0) {
+    camera_block.data = camera.ParamsData();
+    const std::vector<int> const_camera_params =
+        GetConstantCameraParams(options_, camera);
+    const bool constant_camera = !options_.refine_focal_length &&
+                                 !options_.refine_principal_point &&
+                                 !options_.refine_extra_params;
+    if (constant_camera || const_camera_params.empty()) {
+      problem_->AddParameterBlock(camera_block.data,
+                                  static_cast<int>(camera.NumParams()));
+    } else {
+      problem_->AddParameterBlock(
+          camera_block.data, static_cast<int>(camera.NumParams()),
+          GetSubsetParameterization(static_cast<int>(camera.NumParams()),
+                                    const_camera_params));
+    }
+  }
+
+  PointBlock& point3D_block = points3D_[point3D_id];
+  if (point3D_block.num_residuals == 0) {
+    point3D_block.xyz = point3D.XYZ();
+    problem_->AddParameterBlock(point3D_block.xyz.data(), 3);
+  }
+
+  // Constant poses are modeled as constant parameter blocks instead of being
+  // baked into the cost function, so that the residual can be reused when the
+  // pose becomes variable or is changed by another bundle adjustment.
+  ceres::CostFunction* cost_function = nullptr;
+
+  switch (camera.ModelId()) {
+#define CAMERA_MODEL_CASE(CameraModel)                                 \
+  case CameraModel::kModelId:                                          \
+    cost_function = BundleAdjustmentCostFunction<CameraModel>::Create( \
+        image.Point2D(point2D_idx).XY());                              \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+
+  ResidualBlock& residual =
+      residuals_[static_cast<uint64_t>(image_id) << 32 | point2D_idx];
+  residual.point3D_id = point3D_id;
+  residual.residual_block_id = problem_->AddResidualBlock(
+      cost_function, loss_function_.get(), image_blocks.qvec_data,
+      image_blocks.tvec_data, point3D_block.xyz.data(), camera_block.data);
+
+  image_blocks.num_residuals += 1;
+  camera_block.num_residuals += 1;
+  point3D_block.num_residuals += 1;
+  num_added_residual_blocks_ += 1;
+}
+
+void PersistentBundleAdjuster::RemoveResidual(const image_t image_id,
+                                              const ResidualBlock& residual) {
+  problem_->RemoveResidualBlock(residual.residual_block_id);
+  num_removed_residual_blocks_ += 1;
+
+  // Remove parameter blocks without any residuals.
+  auto image_blocks = images_.find(image_id);
+  CHECK(image_blocks != images_.end());
+  auto camera_block = cameras_.find(image_blocks->second.camera_id);
+  CHECK(camera_block != cameras_.end());
+  auto point3D_block = points3D_.find(residual.point3D_id);
+  CHECK(point3D_block != points3D_.end());
+
+  image_blocks->second.num_residuals -= 1;
+  if (image_blocks->second.num_residuals == 0) {
+    problem_->RemoveParameterBlock(image_blocks->second.qvec_data);
+    problem_->RemoveParameterBlock(image_blocks->second.tvec_data);
+    images_.erase(image_blocks);
+  }
+
+  camera_block->second.num_residuals -= 1;
+  if (camera_block->second.num_residuals == 0) {
+    problem_->RemoveParameterBlock(camera_block->second.data);
+    cameras_.erase(camera_block);
+  }
+
+  point3D_block->second.num_residuals -= 1;
+  if (point3D_block->second.num_residuals == 0) {
+    problem_->RemoveParameterBlock(point3D_block->second.xyz.data());
+    points3D_.erase(point3D_block);
+  }
+}
+
+void PersistentBundleAdjuster::RemoveImage(const image_t image_id) {
+  for (auto it = residuals_.begin(); it != residuals_.end();) {
+    if (static_cast<image_t>(it->first >> 32) == image_id) {
+      RemoveResidual(image_id, it->second);
+      it = residuals_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  CHECK_EQ(images_.count(image_id), 0);
+}
+
+std::vector<int> PersistentBundleAdjuster::GetConstantTvecIdxs(
+    const BundleAdjustmentConfig& config, const image_t image_id) const {
+  // The parameterization is irrelevant for constant poses.
+  if (!options_.refine_extrinsics || !config.HasImage(image_id) ||
+      config.HasConstantPose(image_id) || !config.HasConstantTvec(image_id)) {
+    return {};
+  }
+  return config.ConstantTvec(image_id);
+}
+
+ceres::LocalParameterization*
+PersistentBundleAdjuster::GetSubsetParameterization(
+    const int size, const std::vector<int>& constant_params) {
+  auto& parameterization =
+      subset_parameterizations_[std::make_pair(size, constant_params)];
+  if (!parameterization) {
+    parameterization.reset(
+        new ceres::SubsetParameterization(size, constant_params));
+  }
+  return parameterization.get();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // ParallelBundleAdjuster
 ////////////////////////////////////////////////////////////////////////////////
@@ -829,27 +1388,23 @@ bool RigBundleAdjuster::Solve(Reconstruction* reconstruction,
     return false;
   }
 
-  ceres::Solver::Options solver_options = options_.solver_options;
-
-  // Empirical choice.
-  const size_t kMaxNumImagesDirectDenseSolver = 50;
-  const size_t kMaxNumImagesDirectSparseSolver = 1000;
-  const size_t num_images = config_.NumImages();
-  if (num_images <= kMaxNumImagesDirectDenseSolver) {
-    solver_options.linear_solver_type = ceres::DENSE_SCHUR;
-  } else if (num_images <= kMaxNumImagesDirectSparseSolver) {
-    solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
-  } else {  // Indirect sparse (preconditioned CG) solver.
-    solver_options.linear_solver_type = ceres::ITERATIVE_SCHUR;
-    solver_options.preconditioner_type = ceres::SCHUR_JACOBI;
-  }
-
-  solver_options.num_threads =
-      GetEffectiveNumThreads(solver_options.num_threads);
+  BundleAdjustmentSolverPlan plan;
+  BundleAdjustmentProblemStats stats;
+  ceres::Solver::Options solver_options =
+      CreateSolverOptions(options_, config_, *reconstruction,
+                          problem_->NumResiduals(), &plan, &stats);
+
+  // Unless the solver is selected automatically, rig bundle adjustment uses
+  // all threads regardless of the number of residuals.
+  if (!options_.auto_select_solver) {
+    plan.num_threads =
+        GetEffectiveNumThreads(options_.solver_options.num_threads);
 #if CERES_VERSION_MAJOR < 2
-  solver_options.num_linear_solver_threads =
-      GetEffectiveNumThreads(solver_options.num_linear_solver_threads);
+    plan.num_linear_solver_threads = GetEffectiveNumThreads(
+        options_.solver_options.num_linear_solver_threads);
 #endif  // CERES_VERSION_MAJOR
+    plan.Apply(&solver_options);
+  }
 
   std::string solver_error;
   CHECK(solver_options.IsValid(&solver_error)) << solver_error;
@@ -863,6 +1418,7 @@ bool RigBundleAdjuster::Solve(Reconstruction* reconstruction,
   if (options_.print_summary) {
     PrintHeading2("Rig Bundle adjustment report");
     PrintSolverSummary(summary_);
+    PrintSolverPlan(plan, stats);
   }
 
   TearDown(reconstruction, *camera_rigs);
@@ -1201,4 +1757,27 @@ void PrintSolverSummary(const ceres::Solver::Summary& summary) {
   std::cout << std::endl;
 }
 
+void PrintSolverPlan(const BundleAdjustmentSolverPlan& plan,
+                     const BundleAdjustmentProblemStats& stats) {
+  if (stats.num_covisible_image_pairs > 0) {
+    const std::streamsize precision = std::cout.precision();
+    std::cout << std::right << std::setw(16) << "Covisibility : ";
+    std::cout << std::left << std::setprecision(3)
+              << stats.AverageNumCovisibleImages() << " [images]" << std::endl;
+    std::cout.precision(precision);
+  }
+
+  std::cout << std::right << std::setw(16) << "Solver : ";
+  std::cout << std::left
+            << ceres::LinearSolverTypeToString(plan.linear_solver_type);
+  if (plan.linear_solver_type == ceres::ITERATIVE_SCHUR) {
+    std::cout << ", "
+              << ceres::PreconditionerTypeToString(plan.preconditioner_type);
+  }
+  std::cout << std::endl;
+
+  std::cout << std::right << std::setw(16) << "Threads : ";
+  std::cout << std::left << plan.num_threads << std::endl;
+}
+
 }  // namespace colmap
@@ -32,6 +32,7 @@
 #ifndef COLMAP_SRC_OPTIM_BUNDLE_ADJUSTMENT_H_
 #define COLMAP_SRC_OPTIM_BUNDLE_ADJUSTMENT_H_
 
+#include <map>
 #include <memory>
 #include <unordered_set>
 
@@ -74,6 +75,13 @@ struct BundleAdjustmentOptions {
   // due to the overhead of threading.
   int min_num_residuals_for_multi_threading = 50000;
 
+  // Whether to choose the linear solver, preconditioner, and number of threads
+  // from the structure of the problem. Otherwise, the linear solver is chosen
+  // only from the number of images. Disabled by default until the results of
+  // `bundle_adjustment_benchmark` justify changing the solver of existing
+  // pipelines.
+  bool auto_select_solver = false;
+
   // Ceres-Solver options.
   ceres::Solver::Options solver_options;
 
@@ -166,6 +174,61 @@ class BundleAdjustmentConfig {
   std::unordered_map<image_t, std::vector<int>> constant_tvecs_;
 };
 
+// Structural statistics of a bundle adjustment problem, which determine the
+// size and sparsity of the reduced camera system (Schur complement) after
+// eliminating the 3D points.
+struct BundleAdjustmentProblemStats {
+  // Number of images in the configuration, i.e. the number of camera blocks
+  // in the reduced camera system.
+  size_t num_images = 0;
+
+  // Number of variable 3D points, which are eliminated by the Schur solvers.
+  size_t num_points = 0;
+
+  // Number of residuals of the problem.
+  size_t num_residuals = 0;
+
+  // Number of image pairs in the configuration that observe at least one
+  // common variable 3D point, i.e. the number of non-zero off-diagonal blocks
+  // in the upper triangle of the reduced camera system.
+  size_t num_covisible_image_pairs = 0;
+
+  // Average number of images that an image is covisible with.
+  double AverageNumCovisibleImages() const;
+};
+
+BundleAdjustmentProblemStats ComputeBundleAdjustmentProblemStats(
+    const BundleAdjustmentConfig& config, const Reconstruction& reconstruction);
+
+// Configuration of the Ceres linear solver for a bundle adjustment problem.
+struct BundleAdjustmentSolverPlan {
+  ceres::LinearSolverType linear_solver_type = ceres::DENSE_SCHUR;
+  ceres::PreconditionerType preconditioner_type = ceres::JACOBI;
+  ceres::VisibilityClusteringType visibility_clustering_type =
+      ceres::CANONICAL_VIEWS;
+  int num_threads = 1;
+#if CERES_VERSION_MAJOR < 2
+  int num_linear_solver_threads = 1;
+#endif  // CERES_VERSION_MAJOR
+
+  // Overwrite the corresponding fields of the solver options.
+  void Apply(ceres::Solver::Options* solver_options) const;
+};
+
+// Choose the linear solver, preconditioner, and number of threads for the
+// given problem. Small problems use a dense Schur complement. Larger problems
+// are factorized sparsely as long as the reduced camera system is small or its
+// camera covisibility is sparse enough to limit fill-in. All other problems
+// are solved iteratively, where strongly coupled cameras use the
+// visibility-based cluster Jacobi preconditioner instead of the block diagonal
+// Schur Jacobi preconditioner, which ignores the coupling. The number of
+// threads grows with the number of residuals, since each thread must have
+// enough work to amortize the threading overhead. If the automatic selection
+// is disabled, the linear solver is chosen only from the number of images.
+BundleAdjustmentSolverPlan PlanBundleAdjustmentSolver(
+    const BundleAdjustmentOptions& options,
+    const BundleAdjustmentProblemStats& stats);
+
 // Bundle adjustment based on Ceres-Solver. Enables most flexible configurations
 // and provides best solution quality.
 class BundleAdjuster {
@@ -202,6 +265,103 @@ class BundleAdjuster {
   std::unordered_map<point3D_t, size_t> point3D_num_observations_;
 };
 
+// Bundle adjustment based on Ceres-Solver that keeps the problem alive across
+// consecutive calls to `Solve` with overlapping configurations, such as the
+// local bundles in incremental mapping. Only the residuals of observations that
+// entered or left the configuration since the previous call are added to or
+// removed from the problem, while the cost functions and parameter blocks of
+// all other observations are reused. The problem references the camera and
+// pose parameters of the reconstruction, so the reconstruction must not be
+// destroyed while the problem is alive. Passing a different reconstruction
+// resets the problem. The 3D points are parameterized by copies, which are
+// synchronized with the reconstruction in every call to `Solve`, since 3D
+// points may be deleted in between, e.g., by merging or filtering.
+class PersistentBundleAdjuster {
+ public:
+  PersistentBundleAdjuster();
+
+  bool Solve(const BundleAdjustmentOptions& options,
+             const BundleAdjustmentConfig& config,
+             Reconstruction* reconstruction);
+
+  // Remove all residuals and parameters from the problem.
+  void Reset();
+
+  // Get the Ceres solver summary for the last call to `Solve`.
+  const ceres::Solver::Summary& Summary() const;
+
+  // The number of residual blocks that were added to and removed from the
+  // problem in the last call to `Solve`.
+  size_t NumAddedResidualBlocks() const;
+  size_t NumRemovedResidualBlocks() const;
+
+ private:
+  struct ImageBlocks {
+    double* qvec_data = nullptr;
+    double* tvec_data = nullptr;
+    camera_t camera_id = kInvalidCameraId;
+    std::vector<int> constant_tvec_idxs;
+    size_t num_residuals = 0;
+  };
+
+  struct ParameterBlock {
+    double* data = nullptr;
+    size_t num_residuals = 0;
+  };
+
+  struct PointBlock {
+    Eigen::Vector3d xyz = Eigen::Vector3d::Zero();
+    size_t num_residuals = 0;
+  };
+
+  struct ResidualBlock {
+    point3D_t point3D_id = kInvalidPoint3DId;
+    ceres::ResidualBlockId residual_block_id = nullptr;
+  };
+
+  bool HasValidParameters(const Reconstruction& reconstruction) const;
+
+  void AddResidual(const image_t image_id, const point2D_t point2D_idx,
+                   const point3D_t point3D_id,
+                   const BundleAdjustmentConfig& config,
+                   Reconstruction* reconstruction);
+  void RemoveResidual(const image_t image_id, const ResidualBlock& residual);
+  void RemoveImage(const image_t image_id);
+
+  std::vector<int> GetConstantTvecIdxs(const BundleAdjustmentConfig& config,
+                                       const image_t image_id) const;
+
+  // Get the shared parameterization for blocks of the given size with the
+  // given constant parameters.
+  ceres::LocalParameterization* GetSubsetParameterization(
+      const int size, const std::vector<int>& constant_params);
+
+  BundleAdjustmentOptions options_;
+  const Reconstruction* reconstruction_;
+  std::unique_ptr<ceres::LossFunctionWrapper> loss_function_;
+  // The parameterizations are stateless and shared by all parameter blocks of
+  // the problem, since blocks are repeatedly removed and re-added and the
+  // problem would otherwise keep every parameterization until it is reset.
+  std::unique_ptr<ceres::LocalParameterization> quaternion_parameterization_;
+  std::map<std::pair<int, std::vector<int>>,
+           std::unique_ptr<ceres::LocalParameterization>>
+      subset_parameterizations_;
+  std::unique_ptr<ceres::Problem> problem_;
+  ceres::Solver::Summary summary_;
+
+  std::unordered_map<image_t, ImageBlocks> images_;
+  std::unordered_map<camera_t, ParameterBlock> cameras_;
+  // Node-based container, so that the parameter blocks of the 3D points
+  // stay valid when other 3D points are inserted or erased.
+  std::unordered_map<point3D_t, PointBlock> points3D_;
+  // Residuals of the problem for each observation, identified by the image
+  // identifier in the upper and the 2D point index in the lower 32 bits.
+  std::unordered_map<uint64_t, ResidualBlock> residuals_;
+
+  size_t num_added_residual_blocks_;
+  size_t num_removed_residual_blocks_;
+};
+
 // Bundle adjustment using PBA (GPU or CPU). Less flexible and accurate than
 // Ceres-Solver bundle adjustment but much faster. Only supports SimpleRadial
 // camera model.
@@ -328,6 +488,11 @@ class RigBundleAdjuster : public BundleAdjuster {
 
 void PrintSolverSummary(const ceres::Solver::Summary& summary);
 
+// Print the chosen solver configuration. The covisibility is only printed if
+// it was computed, i.e., if the solver was selected automatically.
+void PrintSolverPlan(const BundleAdjustmentSolverPlan& plan,
+                     const BundleAdjustmentProblemStats& stats);
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_OPTIM_BUNDLE_ADJUSTMENT_H_
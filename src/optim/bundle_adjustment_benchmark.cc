@@ -0,0 +1,198 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include <iostream>
+#include <numeric>
+
+#include <Eigen/Core>
+
+#include "base/camera_models.h"
+#include "base/projection.h"
+#include "base/reconstruction.h"
+#include "optim/bundle_adjustment.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/random.h"
+#include "util/timer.h"
+
+using namespace colmap;
+
+namespace {
+
+// Synthetic scene of images along a straight trajectory, where every 3D point
+// is observed by a few images within a window of consecutive images. Small
+// windows lead to the sparse covisibility of sequential imagery, while large
+// windows lead to the dense covisibility of Internet photo collections. The
+// 3D points are perturbed to simulate an unrefined reconstruction.
+void CreateScene(const size_t num_images, const size_t window_size,
+                 Reconstruction* reconstruction,
+                 BundleAdjustmentConfig* config) {
+  const size_t kNumPoints2DPerImage = 200;
+  const int kMinTrackLength = 3;
+  const int kMaxTrackLength = 6;
+  const double kFocalLength = 1000;
+  const size_t kImageSize = 1000;
+
+  SetPRNGSeed(0);
+
+  Camera camera;
+  camera.InitializeWithId(SimpleRadialCameraModel::model_id, kFocalLength,
+                          kImageSize, kImageSize);
+  camera.SetCameraId(1);
+  reconstruction->AddCamera(camera);
+
+  std::vector<Eigen::Matrix3x4d> proj_matrices(num_images);
+  for (size_t i = 0; i < num_images; ++i) {
+    Image image;
+    image.SetImageId(static_cast<image_t>(i + 1));
+    image.SetCameraId(camera.CameraId());
+    image.SetName(std::to_string(i));
+    image.Qvec() = ComposeIdentityQuaternion();
+    image.Tvec() = Eigen::Vector3d(-static_cast<double>(i), 0, 0);
+    proj_matrices[i] = image.ProjectionMatrix();
+    reconstruction->AddImage(image);
+  }
+
+  const size_t num_points3D = num_images * kNumPoints2DPerImage * 2 /
+                              (kMinTrackLength + kMaxTrackLength);
+
+  std::vector<Eigen::Vector3d> points3D(num_points3D);
+  std::vector<Track> tracks(num_points3D);
+  std::vector<std::vector<Eigen::Vector2d>> points2D(num_images);
+  for (size_t point3D_idx = 0; point3D_idx < num_points3D; ++point3D_idx) {
+    const size_t window_begin =
+        RandomInteger<size_t>(0, num_images - window_size);
+    const Eigen::Vector3d xyz(
+        window_begin + RandomReal<double>(0, window_size),
+        RandomReal(-2.0, 2.0), RandomReal(5.0, 10.0));
+
+    std::vector<size_t> image_idxs(window_size);
+    std::iota(image_idxs.begin(), image_idxs.end(), window_begin);
+    Shuffle(static_cast<uint32_t>(window_size), &image_idxs);
+    image_idxs.resize(std::min<size_t>(
+        window_size, RandomInteger(kMinTrackLength, kMaxTrackLength)));
+
+    for (const size_t image_idx : image_idxs) {
+      const Eigen::Vector2d point2D =
+          ProjectPointToImage(xyz, proj_matrices[image_idx], camera) +
+          Eigen::Vector2d(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0));
+      tracks[point3D_idx].AddElement(static_cast<image_t>(image_idx + 1),
+                                     points2D[image_idx].size());
+      points2D[image_idx].push_back(point2D);
+    }
+
+    points3D[point3D_idx] =
+        xyz + 0.05 * Eigen::Vector3d(RandomReal(-1.0, 1.0),
+                                     RandomReal(-1.0, 1.0),
+                                     RandomReal(-1.0, 1.0));
+  }
+
+  for (size_t i = 0; i < num_images; ++i) {
+    const image_t image_id = static_cast<image_t>(i + 1);
+    reconstruction->Image(image_id).SetPoints2D(points2D[i]);
+    reconstruction->RegisterImage(image_id);
+    config->AddImage(image_id);
+  }
+
+  for (size_t point3D_idx = 0; point3D_idx < num_points3D; ++point3D_idx) {
+    reconstruction->AddPoint3D(points3D[point3D_idx], tracks[point3D_idx]);
+  }
+
+  // Fix the gauge ambiguity of the reconstruction.
+  config->SetConstantPose(1);
+  config->SetConstantTvec(2, {0});
+}
+
+void BenchmarkScene(const std::string& name, const size_t num_images,
+                    const size_t window_size, const bool auto_select_solver) {
+  Reconstruction reconstruction;
+  BundleAdjustmentConfig config;
+  CreateScene(num_images, window_size, &reconstruction, &config);
+
+  BundleAdjustmentOptions options;
+  options.print_summary = false;
+  options.solver_options.function_tolerance = 1e-6;
+  options.solver_options.max_num_iterations = 50;
+  options.auto_select_solver = auto_select_solver;
+
+  BundleAdjustmentProblemStats stats =
+      ComputeBundleAdjustmentProblemStats(config, reconstruction);
+  const BundleAdjustmentSolverPlan plan =
+      PlanBundleAdjustmentSolver(options, stats);
+
+  Timer timer;
+  timer.Start();
+  BundleAdjuster bundle_adjuster(options, config);
+  CHECK(bundle_adjuster.Solve(&reconstruction));
+  const double elapsed_time = timer.ElapsedSeconds();
+
+  const ceres::Solver::Summary& summary = bundle_adjuster.Summary();
+  const std::string solver =
+      plan.linear_solver_type == ceres::ITERATIVE_SCHUR
+          ? ceres::PreconditionerTypeToString(plan.preconditioner_type)
+          : ceres::LinearSolverTypeToString(plan.linear_solver_type);
+
+  std::cout << StringPrintf(
+                   "%10s %7s %7d %6.1f %15s %7d %9.3fs %5d %9.4fpx",
+                   name.c_str(), auto_select_solver ? "auto" : "legacy",
+                   static_cast<int>(num_images),
+                   stats.AverageNumCovisibleImages(), solver.c_str(),
+                   plan.num_threads, elapsed_time,
+                   summary.num_successful_steps +
+                       summary.num_unsuccessful_steps,
+                   std::sqrt(summary.final_cost /
+                             summary.num_residuals_reduced))
+            << std::endl;
+}
+
+}  // namespace
+
+// Benchmark of the time to convergence of bundle adjustment on synthetic
+// scenes of varying size and covisibility, comparing the solver chosen from the
+// problem structure against the previous choice based on the number of images.
+int main(int argc, char** argv) {
+  InitializeGlog(argv);
+
+  std::cout << StringPrintf("%10s %7s %7s %6s %15s %7s %10s %5s %11s", "scene",
+                            "plan", "images", "covis", "solver", "threads",
+                            "time", "iters", "cost")
+            << std::endl;
+
+  for (const size_t num_images : {30, 300, 3000, 10000}) {
+    for (const bool auto_select_solver : {false, true}) {
+      BenchmarkScene("sequential", num_images, 8, auto_select_solver);
+      BenchmarkScene("dense", num_images, std::min<size_t>(num_images, 100),
+                     auto_select_solver);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
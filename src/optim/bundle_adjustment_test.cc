@@ -207,6 +207,106 @@ BOOST_AUTO_TEST_CASE(TestConfigNumObservations) {
   BOOST_CHECK_EQUAL(config.NumResiduals(reconstruction), 800);
 }
 
+BOOST_AUTO_TEST_CASE(TestProblemStats) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(4, 100, &reconstruction, &correspondence_graph);
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+
+  BundleAdjustmentProblemStats stats =
+      ComputeBundleAdjustmentProblemStats(config, reconstruction);
+  BOOST_CHECK_EQUAL(stats.num_images, 2);
+  BOOST_CHECK_EQUAL(stats.num_points, 100);
+  BOOST_CHECK_EQUAL(stats.num_residuals, 400);
+  BOOST_CHECK_EQUAL(stats.num_covisible_image_pairs, 1);
+  BOOST_CHECK_EQUAL(stats.AverageNumCovisibleImages(), 1);
+
+  config.AddImage(2);
+  config.AddConstantPoint(2);
+
+  stats = ComputeBundleAdjustmentProblemStats(config, reconstruction);
+  BOOST_CHECK_EQUAL(stats.num_images, 3);
+  BOOST_CHECK_EQUAL(stats.num_points, 99);
+  BOOST_CHECK_EQUAL(stats.num_residuals, 602);
+  BOOST_CHECK_EQUAL(stats.num_covisible_image_pairs, 3);
+  BOOST_CHECK_EQUAL(stats.AverageNumCovisibleImages(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(TestPlanSolver) {
+  BundleAdjustmentOptions options;
+  BOOST_CHECK(!options.auto_select_solver);
+  options.auto_select_solver = true;
+  options.solver_options.num_threads = 8;
+  options.solver_options.sparse_linear_algebra_library_type =
+      ceres::SUITE_SPARSE;
+  const bool has_suite_sparse =
+      ceres::IsSparseLinearAlgebraLibraryTypeAvailable(ceres::SUITE_SPARSE);
+
+  BundleAdjustmentProblemStats stats;
+  stats.num_images = 20;
+  stats.num_points = 1000;
+  stats.num_residuals = 10000;
+  stats.num_covisible_image_pairs = 190;
+  BundleAdjustmentSolverPlan plan = PlanBundleAdjustmentSolver(options, stats);
+  BOOST_CHECK_EQUAL(plan.linear_solver_type, ceres::DENSE_SCHUR);
+  BOOST_CHECK_EQUAL(plan.num_threads, 1);
+
+  stats.num_images = 500;
+  stats.num_points = 100000;
+  stats.num_residuals = 1000000;
+  stats.num_covisible_image_pairs = 50000;
+  plan = PlanBundleAdjustmentSolver(options, stats);
+  BOOST_CHECK_EQUAL(plan.linear_solver_type,
+                    has_suite_sparse ? ceres::SPARSE_SCHUR
+                                     : ceres::ITERATIVE_SCHUR);
+  BOOST_CHECK_EQUAL(plan.num_threads, 8);
+
+  // Sequential imagery with sparse covisibility.
+  stats.num_images = 10000;
+  stats.num_points = 1000000;
+  stats.num_residuals = 60000;
+  stats.num_covisible_image_pairs = 50000;
+  plan = PlanBundleAdjustmentSolver(options, stats);
+  BOOST_CHECK_EQUAL(plan.linear_solver_type,
+                    has_suite_sparse ? ceres::SPARSE_SCHUR
+                                     : ceres::ITERATIVE_SCHUR);
+  BOOST_CHECK_EQUAL(plan.num_threads, 6);
+
+  // Internet imagery with dense covisibility.
+  stats.num_residuals = 10000000;
+  stats.num_covisible_image_pairs = 500000;
+  plan = PlanBundleAdjustmentSolver(options, stats);
+  BOOST_CHECK_EQUAL(plan.linear_solver_type, ceres::ITERATIVE_SCHUR);
+  if (has_suite_sparse) {
+    BOOST_CHECK_EQUAL(plan.preconditioner_type, ceres::CLUSTER_JACOBI);
+    BOOST_CHECK_EQUAL(plan.visibility_clustering_type, ceres::SINGLE_LINKAGE);
+  } else {
+    BOOST_CHECK_EQUAL(plan.preconditioner_type, ceres::SCHUR_JACOBI);
+  }
+  BOOST_CHECK_EQUAL(plan.num_threads, 8);
+
+  options.auto_select_solver = false;
+  options.solver_options.preconditioner_type = ceres::JACOBI;
+  plan = PlanBundleAdjustmentSolver(options, stats);
+  BOOST_CHECK_EQUAL(plan.linear_solver_type, ceres::ITERATIVE_SCHUR);
+  BOOST_CHECK_EQUAL(plan.preconditioner_type, ceres::SCHUR_JACOBI);
+  BOOST_CHECK_EQUAL(plan.num_threads, 8);
+
+  stats.num_images = 500;
+  plan = PlanBundleAdjustmentSolver(options, stats);
+  BOOST_CHECK_EQUAL(plan.linear_solver_type, ceres::SPARSE_SCHUR);
+  BOOST_CHECK_EQUAL(plan.preconditioner_type, ceres::JACOBI);
+
+  stats.num_images = 20;
+  stats.num_residuals = 10000;
+  plan = PlanBundleAdjustmentSolver(options, stats);
+  BOOST_CHECK_EQUAL(plan.linear_solver_type, ceres::DENSE_SCHUR);
+  BOOST_CHECK_EQUAL(plan.num_threads, 1);
+}
+
 BOOST_AUTO_TEST_CASE(TestTwoView) {
   Reconstruction reconstruction;
   CorrespondenceGraph correspondence_graph;
@@ -644,6 +744,155 @@ BOOST_AUTO_TEST_CASE(TestConstantExtraParam) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestPersistentBundleAdjuster) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(4, 100, &reconstruction, &correspondence_graph);
+  const auto orig_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantPose(0);
+  config.SetConstantTvec(1, {0});
+
+  BundleAdjustmentOptions options;
+  PersistentBundleAdjuster bundle_adjuster;
+  BOOST_REQUIRE(bundle_adjuster.Solve(options, config, &reconstruction));
+
+  // 100 points, 2 images, 2 residuals per point per image
+  BOOST_CHECK_EQUAL(bundle_adjuster.Summary().num_residuals_reduced, 400);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumAddedResidualBlocks(), 200);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumRemovedResidualBlocks(), 0);
+
+  // Only the residuals of the new image are added.
+  config.AddImage(2);
+  BOOST_REQUIRE(bundle_adjuster.Solve(options, config, &reconstruction));
+  BOOST_CHECK_EQUAL(bundle_adjuster.Summary().num_residuals_reduced, 600);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumAddedResidualBlocks(), 100);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumRemovedResidualBlocks(), 0);
+
+  // The images with changed constant translation components are re-added.
+  config.AddImage(3);
+  config.RemoveConstantTvec(1);
+  config.SetConstantTvec(2, {0});
+  BOOST_REQUIRE(bundle_adjuster.Solve(options, config, &reconstruction));
+  BOOST_CHECK_EQUAL(bundle_adjuster.Summary().num_residuals_reduced, 800);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumAddedResidualBlocks(), 300);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumRemovedResidualBlocks(), 200);
+
+  // Only the residuals of the removed image are removed.
+  config.RemoveImage(3);
+  BOOST_REQUIRE(bundle_adjuster.Solve(options, config, &reconstruction));
+  BOOST_CHECK_EQUAL(bundle_adjuster.Summary().num_residuals_reduced, 600);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumAddedResidualBlocks(), 0);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumRemovedResidualBlocks(), 100);
+
+  CheckVariableCamera(reconstruction.Camera(0), orig_reconstruction.Camera(0));
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+
+  CheckVariableCamera(reconstruction.Camera(3), orig_reconstruction.Camera(3));
+  CheckVariableImage(reconstruction.Image(3), orig_reconstruction.Image(3));
+
+  for (const auto& point3D : reconstruction.Points3D()) {
+    CheckVariablePoint(point3D.second,
+                       orig_reconstruction.Point3D(point3D.first));
+  }
+}
+
+void CheckEqualReconstructions(const Reconstruction& reconstruction1,
+                               const Reconstruction& reconstruction2) {
+  const double kMaxDiff = 1e-6;
+  for (const auto& camera : reconstruction1.Cameras()) {
+    const Camera& camera2 = reconstruction2.Camera(camera.first);
+    for (size_t i = 0; i < camera.second.NumParams(); ++i) {
+      // Relative to the magnitude of the parameter, but the distortion
+      // parameters may be zero or negative.
+      BOOST_CHECK_LE(
+          std::abs(camera.second.Params(i) - camera2.Params(i)),
+          kMaxDiff * std::max(1.0, std::abs(camera.second.Params(i))));
+    }
+  }
+  for (const auto& image : reconstruction1.Images()) {
+    const Image& image2 = reconstruction2.Image(image.first);
+    BOOST_CHECK_LE((image.second.Qvec() - image2.Qvec()).norm(), kMaxDiff);
+    BOOST_CHECK_LE((image.second.Tvec() - image2.Tvec()).norm(), kMaxDiff);
+  }
+  BOOST_CHECK_EQUAL(reconstruction1.NumPoints3D(),
+                    reconstruction2.NumPoints3D());
+  for (const auto& point3D : reconstruction1.Points3D()) {
+    BOOST_CHECK_LE(
+        (point3D.second.XYZ() - reconstruction2.Point3D(point3D.first).XYZ())
+            .norm(),
+        kMaxDiff);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestPersistentBundleAdjusterMatchesBundleAdjuster) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(6, 100, &reconstruction, &correspondence_graph);
+  Reconstruction fresh_reconstruction = reconstruction;
+
+  BundleAdjustmentOptions options;
+  options.print_summary = false;
+  PersistentBundleAdjuster persistent_bundle_adjuster;
+
+  // Adjust both reconstructions with the same sequence of local bundles, once
+  // with a reused problem and once with a new problem for every bundle.
+  auto Solve = [&](const BundleAdjustmentConfig& config) {
+    BOOST_REQUIRE(
+        persistent_bundle_adjuster.Solve(options, config, &reconstruction));
+    BundleAdjuster bundle_adjuster(options, config);
+    BOOST_REQUIRE(bundle_adjuster.Solve(&fresh_reconstruction));
+    BOOST_CHECK_EQUAL(
+        persistent_bundle_adjuster.Summary().num_residuals_reduced,
+        bundle_adjuster.Summary().num_residuals_reduced);
+    CheckEqualReconstructions(reconstruction, fresh_reconstruction);
+  };
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantPose(0);
+  config.SetConstantTvec(1, {0});
+  Solve(config);
+
+  config.AddImage(2);
+  Solve(config);
+
+  // Move the bundle, so that residuals of constant images outside of the
+  // bundle are added for the variable points.
+  config = BundleAdjustmentConfig();
+  config.AddImage(1);
+  config.AddImage(2);
+  config.AddImage(3);
+  config.SetConstantPose(1);
+  config.SetConstantTvec(2, {0});
+  for (point3D_t point3D_id = 1; point3D_id <= 20; ++point3D_id) {
+    config.AddVariablePoint(point3D_id);
+  }
+  Solve(config);
+
+  // Deleted 3D points are removed from the reused problem.
+  for (point3D_t point3D_id = 1; point3D_id <= 10; ++point3D_id) {
+    reconstruction.DeletePoint3D(point3D_id);
+    fresh_reconstruction.DeletePoint3D(point3D_id);
+  }
+
+  config = BundleAdjustmentConfig();
+  config.AddImage(2);
+  config.AddImage(3);
+  config.AddImage(4);
+  config.SetConstantPose(2);
+  config.SetConstantTvec(3, {0});
+  for (point3D_t point3D_id = 11; point3D_id <= 20; ++point3D_id) {
+    config.AddVariablePoint(point3D_id);
+  }
+  Solve(config);
+  BOOST_CHECK_GT(persistent_bundle_adjuster.NumRemovedResidualBlocks(), 0);
+}
+
 BOOST_AUTO_TEST_CASE(TestParallelReconstructionSupported) {
   BundleAdjustmentOptions options;
   options.refine_focal_length = true;
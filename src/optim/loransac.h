@@ -108,48 +108,25 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
   typename Estimator::M_t best_model;
   bool best_model_is_local = false;
 
-  bool abort = false;
-
   const double max_residual = options_.max_error * options_.max_error;
 
-  std::vector<double> residuals(num_samples);
-
   std::vector<typename LocalEstimator::X_t> X_inlier;
   std::vector<typename LocalEstimator::Y_t> Y_inlier;
 
-  std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
-  std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
-
-  sampler.Initialize(num_samples);
-
-  size_t max_num_trials = options_.max_num_trials;
-  max_num_trials = std::min<size_t>(max_num_trials, sampler.MaxNumSamples());
-  size_t dyn_max_num_trials = max_num_trials;
-
-  for (report.num_trials = 0; report.num_trials < max_num_trials;
-       ++report.num_trials) {
-    if (abort) {
-      report.num_trials += 1;
-      break;
-    }
-
-    sampler.SampleXY(X, Y, &X_rand, &Y_rand);
-
-    // Estimate model for current subset.
-    const std::vector<typename Estimator::M_t> sample_models =
-        estimator.Estimate(X_rand, Y_rand);
-
-    // Iterate through all estimated models
-    for (const auto& sample_model : sample_models) {
-      estimator.Residuals(X, Y, sample_model, &residuals);
-      CHECK_EQ(residuals.size(), X.size());
-
-      const auto support = support_measurer.Evaluate(residuals, max_residual);
-
-      // Do local optimization if better than all previous subsets.
-      if (support_measurer.Compare(support, best_support)) {
+  const ResidualEvaluator<Estimator> residual_evaluator(&estimator, X, Y);
+  const ResidualEvaluator<LocalEstimator> local_residual_evaluator(
+      &local_estimator, X, Y);
+
+  // Do local optimization for every hypothesis that is better than all
+  // previous hypotheses. This depends on the best model so far and therefore
+  // runs serially, also if the hypotheses are evaluated in multiple threads.
+  report.num_trials = this->RunTrials(
+      X, Y, residual_evaluator, max_residual, &best_support,
+      [&](const typename Estimator::M_t& model,
+          const typename SupportMeasurer::Support& support,
+          std::vector<double>* residuals) {
         best_support = support;
-        best_model = sample_model;
+        best_model = model;
         best_model_is_local = false;
 
         // Estimate locally optimized model from inliers.
@@ -159,8 +136,8 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
           Y_inlier.clear();
           X_inlier.reserve(support.num_inliers);
           Y_inlier.reserve(support.num_inliers);
-          for (size_t i = 0; i < residuals.size(); ++i) {
-            if (residuals[i] <= max_residual) {
+          for (size_t i = 0; i < residuals->size(); ++i) {
+            if ((*residuals)[i] <= max_residual) {
               X_inlier.push_back(X[i]);
               Y_inlier.push_back(Y[i]);
             }
@@ -170,11 +147,11 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
               local_estimator.Estimate(X_inlier, Y_inlier);
 
           for (const auto& local_model : local_models) {
-            local_estimator.Residuals(X, Y, local_model, &residuals);
-            CHECK_EQ(residuals.size(), X.size());
+            local_residual_evaluator.Residuals(local_model, residuals);
+            CHECK_EQ(residuals->size(), X.size());
 
             const auto local_support =
-                support_measurer.Evaluate(residuals, max_residual);
+                support_measurer.Evaluate(*residuals, max_residual);
 
             // Check if non-locally optimized model is better.
             if (support_measurer.Compare(local_support, best_support)) {
@@ -184,20 +161,7 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
             }
           }
         }
-
-        dyn_max_num_trials =
-            RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeNumTrials(
-                best_support.num_inliers, num_samples, options_.confidence,
-                options_.dyn_num_trials_multiplier);
-      }
-
-      if (report.num_trials >= dyn_max_num_trials &&
-          report.num_trials >= options_.min_num_trials) {
-        abort = true;
-        break;
-      }
-    }
-  }
+      });
 
   report.support = best_support;
   report.model = best_model;
@@ -213,10 +177,11 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
   // best model twice, but saves to copy and fill the inlier mask for each
   // evaluated model. Some benchmarking revealed that this approach is faster.
 
+  std::vector<double> residuals(num_samples);
   if (best_model_is_local) {
-    local_estimator.Residuals(X, Y, report.model, &residuals);
+    local_residual_evaluator.Residuals(report.model, &residuals);
   } else {
-    estimator.Residuals(X, Y, report.model, &residuals);
+    residual_evaluator.Residuals(report.model, &residuals);
   }
 
   CHECK_EQ(residuals.size(), X.size());
@@ -33,14 +33,17 @@
 #define COLMAP_SRC_OPTIM_RANSAC_H_
 
 #include <cfloat>
+#include <memory>
 #include <random>
 #include <stdexcept>
 #include <vector>
 
 #include "optim/random_sampler.h"
+#include "optim/residual_evaluator.h"
 #include "optim/support_measurement.h"
 #include "util/alignment.h"
 #include "util/logging.h"
+#include "util/threading.h"
 
 namespace colmap {
 
@@ -65,6 +68,13 @@ struct RANSACOptions {
   size_t min_num_trials = 0;
   size_t max_num_trials = std::numeric_limits<size_t>::max();
 
+  // Number of threads used to estimate and evaluate hypotheses concurrently.
+  // Samples are always drawn serially from the sampler and the hypotheses are
+  // reduced in the order of their trials, so the result is independent of the
+  // number of threads for a fixed random seed. Requires the `Estimate` and
+  // `Residuals` methods of the estimator to be thread-safe.
+  int num_threads = 1;
+
   void Check() const {
     CHECK_GT(max_error, 0);
     CHECK_GE(min_inlier_ratio, 0);
@@ -72,6 +82,8 @@ struct RANSACOptions {
     CHECK_GE(confidence, 0);
     CHECK_LE(confidence, 1);
     CHECK_LE(min_num_trials, max_num_trials);
+    CHECK_NE(num_threads, 0);
+    CHECK_GE(num_threads, -1);
   }
 };
 
@@ -133,7 +145,49 @@ class RANSAC {
   SupportMeasurer support_measurer;
 
  protected:
+  // Estimated models and their support for a single sample.
+  struct Trial {
+    std::vector<typename Estimator::M_t> models;
+    std::vector<typename SupportMeasurer::Support> supports;
+  };
+
+  // Whether hypotheses are estimated and evaluated in multiple threads.
+  bool IsParallel() const;
+
+  // The thread pool of the parallel estimation, which is created on first use
+  // and then reused by subsequent calls to `Estimate`.
+  ThreadPool* GetThreadPool();
+
+  // Number of trials evaluated concurrently before the results are reduced.
+  size_t NumTrialsPerBatch(ThreadPool* thread_pool) const;
+
+  // Draw `num_trials` samples serially from the sampler and then estimate and
+  // evaluate the models of all samples concurrently in the thread pool.
+  void EvaluateTrials(const std::vector<typename Estimator::X_t>& X,
+                      const std::vector<typename Estimator::Y_t>& Y,
+                      const ResidualEvaluator<Estimator>& residual_evaluator,
+                      const size_t num_trials, const double max_residual,
+                      ThreadPool* thread_pool, std::vector<Trial>* trials);
+
+  // Sample, estimate, and evaluate hypotheses until the termination criterion
+  // is met and return the number of trials. The trials run serially or, with
+  // multiple threads, in batches that are reduced in the order of the trials,
+  // such that the result is independent of the number of threads. Every
+  // hypothesis with better support than `best_support` is passed to
+  // `update_best(model, support, residuals)` together with its residuals,
+  // which must update `best_support` and may overwrite the residuals.
+  template <typename UpdateBestFunc>
+  size_t RunTrials(const std::vector<typename Estimator::X_t>& X,
+                   const std::vector<typename Estimator::Y_t>& Y,
+                   const ResidualEvaluator<Estimator>& residual_evaluator,
+                   const double max_residual,
+                   const typename SupportMeasurer::Support* best_support,
+                   UpdateBestFunc update_best);
+
   RANSACOptions options_;
+
+ private:
+  std::unique_ptr<ThreadPool> thread_pool_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -195,58 +249,18 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
   typename SupportMeasurer::Support best_support;
   typename Estimator::M_t best_model;
 
-  bool abort = false;
-
   const double max_residual = options_.max_error * options_.max_error;
 
-  std::vector<double> residuals(num_samples);
-
-  std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
-  std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
-
-  sampler.Initialize(num_samples);
+  const ResidualEvaluator<Estimator> residual_evaluator(&estimator, X, Y);
 
-  size_t max_num_trials = options_.max_num_trials;
-  max_num_trials = std::min<size_t>(max_num_trials, sampler.MaxNumSamples());
-  size_t dyn_max_num_trials = max_num_trials;
-
-  for (report.num_trials = 0; report.num_trials < max_num_trials;
-       ++report.num_trials) {
-    if (abort) {
-      report.num_trials += 1;
-      break;
-    }
-
-    sampler.SampleXY(X, Y, &X_rand, &Y_rand);
-
-    // Estimate model for current subset.
-    const std::vector<typename Estimator::M_t> sample_models =
-        estimator.Estimate(X_rand, Y_rand);
-
-    // Iterate through all estimated models.
-    for (const auto& sample_model : sample_models) {
-      estimator.Residuals(X, Y, sample_model, &residuals);
-      CHECK_EQ(residuals.size(), X.size());
-
-      const auto support = support_measurer.Evaluate(residuals, max_residual);
-
-      // Save as best subset if better than all previous subsets.
-      if (support_measurer.Compare(support, best_support)) {
+  report.num_trials = RunTrials(
+      X, Y, residual_evaluator, max_residual, &best_support,
+      [&](const typename Estimator::M_t& model,
+          const typename SupportMeasurer::Support& support,
+          std::vector<double>* /* residuals */) {
         best_support = support;
-        best_model = sample_model;
-
-        dyn_max_num_trials = ComputeNumTrials(
-            best_support.num_inliers, num_samples, options_.confidence,
-            options_.dyn_num_trials_multiplier);
-      }
-
-      if (report.num_trials >= dyn_max_num_trials &&
-          report.num_trials >= options_.min_num_trials) {
-        abort = true;
-        break;
-      }
-    }
-  }
+        best_model = model;
+      });
 
   report.support = best_support;
   report.model = best_model;
@@ -262,7 +276,8 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
   // best model twice, but saves to copy and fill the inlier mask for each
   // evaluated model. Some benchmarking revealed that this approach is faster.
 
-  estimator.Residuals(X, Y, report.model, &residuals);
+  std::vector<double> residuals(num_samples);
+  residual_evaluator.Residuals(report.model, &residuals);
   CHECK_EQ(residuals.size(), X.size());
 
   report.inlier_mask.resize(num_samples);
@@ -277,6 +292,202 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
   return report;
 }
 
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+bool RANSAC<Estimator, SupportMeasurer, Sampler>::IsParallel() const {
+  return GetEffectiveNumThreads(options_.num_threads) > 1;
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+ThreadPool* RANSAC<Estimator, SupportMeasurer, Sampler>::GetThreadPool() {
+  if (!thread_pool_) {
+    thread_pool_.reset(new ThreadPool(options_.num_threads));
+  }
+  return thread_pool_.get();
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+size_t RANSAC<Estimator, SupportMeasurer, Sampler>::NumTrialsPerBatch(
+    ThreadPool* thread_pool) const {
+  // Large enough to amortize the synchronization of the threads and small
+  // enough to not waste many trials beyond the dynamic termination bound.
+  const size_t kNumTrialsPerThread = 8;
+  return kNumTrialsPerThread * thread_pool->NumThreads();
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+void RANSAC<Estimator, SupportMeasurer, Sampler>::EvaluateTrials(
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y,
+    const ResidualEvaluator<Estimator>& residual_evaluator,
+    const size_t num_trials, const double max_residual,
+    ThreadPool* thread_pool, std::vector<Trial>* trials) {
+  // The sampler is not thread-safe and its random state must advance in the
+  // same order as in the serial implementation.
+  std::vector<std::vector<typename Estimator::X_t>> X_rands(
+      num_trials,
+      std::vector<typename Estimator::X_t>(Estimator::kMinNumSamples));
+  std::vector<std::vector<typename Estimator::Y_t>> Y_rands(
+      num_trials,
+      std::vector<typename Estimator::Y_t>(Estimator::kMinNumSamples));
+  for (size_t i = 0; i < num_trials; ++i) {
+    sampler.SampleXY(X, Y, &X_rands[i], &Y_rands[i]);
+  }
+
+  trials->resize(num_trials);
+
+  auto EvaluateTrialRange = [&](const size_t begin, const size_t end) {
+    std::vector<double> residuals(X.size());
+    for (size_t i = begin; i < end; ++i) {
+      Trial& trial = (*trials)[i];
+      trial.models = estimator.Estimate(X_rands[i], Y_rands[i]);
+      trial.supports.resize(trial.models.size());
+      for (size_t j = 0; j < trial.models.size(); ++j) {
+        residual_evaluator.Residuals(trial.models[j], &residuals);
+        CHECK_EQ(residuals.size(), X.size());
+        trial.supports[j] = support_measurer.Evaluate(residuals, max_residual);
+      }
+    }
+  };
+
+  const size_t num_threads = thread_pool->NumThreads();
+  const size_t num_trials_per_thread =
+      (num_trials + num_threads - 1) / num_threads;
+
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_threads);
+  for (size_t begin = 0; begin < num_trials; begin += num_trials_per_thread) {
+    const size_t end = std::min(begin + num_trials_per_thread, num_trials);
+    futures.push_back(thread_pool->AddTask(EvaluateTrialRange, begin, end));
+  }
+
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+template <typename UpdateBestFunc>
+size_t RANSAC<Estimator, SupportMeasurer, Sampler>::RunTrials(
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y,
+    const ResidualEvaluator<Estimator>& residual_evaluator,
+    const double max_residual,
+    const typename SupportMeasurer::Support* best_support,
+    UpdateBestFunc update_best) {
+  const size_t num_samples = X.size();
+
+  std::vector<double> residuals(num_samples);
+
+  sampler.Initialize(num_samples);
+
+  size_t max_num_trials = options_.max_num_trials;
+  max_num_trials = std::min<size_t>(max_num_trials, sampler.MaxNumSamples());
+  size_t dyn_max_num_trials = max_num_trials;
+
+  size_t num_trials = 0;
+  bool abort = false;
+
+  // Update the best model and the dynamic termination bound with a hypothesis
+  // of the current trial and return whether the iteration terminates.
+  auto ReduceHypothesis = [&](const typename Estimator::M_t& model,
+                              const typename SupportMeasurer::Support& support,
+                              const bool has_residuals) {
+    if (support_measurer.Compare(support, *best_support)) {
+      if (!has_residuals) {
+        residual_evaluator.Residuals(model, &residuals);
+        CHECK_EQ(residuals.size(), X.size());
+      }
+
+      update_best(model, support, &residuals);
+
+      dyn_max_num_trials = ComputeNumTrials(
+          best_support->num_inliers, num_samples, options_.confidence,
+          options_.dyn_num_trials_multiplier);
+    }
+
+    return num_trials >= dyn_max_num_trials &&
+           num_trials >= options_.min_num_trials;
+  };
+
+  if (!IsParallel()) {
+    std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
+    std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
+
+    for (num_trials = 0; num_trials < max_num_trials; ++num_trials) {
+      if (abort) {
+        num_trials += 1;
+        break;
+      }
+
+      sampler.SampleXY(X, Y, &X_rand, &Y_rand);
+
+      // Estimate model for current subset.
+      const std::vector<typename Estimator::M_t> sample_models =
+          estimator.Estimate(X_rand, Y_rand);
+
+      // Iterate through all estimated models.
+      for (const auto& sample_model : sample_models) {
+        residual_evaluator.Residuals(sample_model, &residuals);
+        CHECK_EQ(residuals.size(), X.size());
+
+        const auto support = support_measurer.Evaluate(residuals, max_residual);
+
+        if (ReduceHypothesis(sample_model, support, /*has_residuals=*/true)) {
+          abort = true;
+          break;
+        }
+      }
+    }
+
+    return num_trials;
+  }
+
+  ThreadPool* thread_pool = GetThreadPool();
+  const size_t num_trials_per_batch = NumTrialsPerBatch(thread_pool);
+
+  std::vector<Trial> trials;
+
+  while (!abort && num_trials < max_num_trials) {
+    // The iteration aborts after the first trial that reaches the dynamic
+    // bound, so there is no need to evaluate trials beyond it.
+    const size_t last_trial =
+        std::max(dyn_max_num_trials, options_.min_num_trials);
+    size_t num_batch_trials =
+        std::min(num_trials_per_batch, max_num_trials - num_trials);
+    if (last_trial >= num_trials) {
+      // Clamp before adding one, since the last trial may be the maximum
+      // representable value, e.g., for a confidence of one.
+      num_batch_trials =
+          std::min(num_batch_trials - 1, last_trial - num_trials) + 1;
+    } else {
+      num_batch_trials = 1;
+    }
+
+    EvaluateTrials(X, Y, residual_evaluator, num_batch_trials, max_residual,
+                   thread_pool, &trials);
+
+    // Reduce the trials in the same order as the serial implementation. The
+    // residuals are only recomputed for improving hypotheses.
+    for (size_t i = 0; i < num_batch_trials && !abort; ++i, ++num_trials) {
+      const Trial& trial = trials[i];
+      for (size_t j = 0; j < trial.models.size(); ++j) {
+        if (ReduceHypothesis(trial.models[j], trial.supports[j],
+                             /*has_residuals=*/false)) {
+          abort = true;
+          break;
+        }
+      }
+    }
+  }
+
+  // Count the aborted trial as in the serial implementation.
+  if (abort && num_trials < max_num_trials) {
+    num_trials += 1;
+  }
+
+  return num_trials;
+}
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_OPTIM_RANSAC_H_
@@ -0,0 +1,168 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include <iostream>
+
+#include <Eigen/Core>
+
+#include "base/pose.h"
+#include "base/projection.h"
+#include "estimators/absolute_pose.h"
+#include "estimators/essential_matrix.h"
+#include "estimators/fundamental_matrix.h"
+#include "optim/loransac.h"
+#include "optim/ransac.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/random.h"
+#include "util/timer.h"
+
+using namespace colmap;
+
+namespace {
+
+// Synthetic correspondences between two normalized views and the 3D points,
+// where the first `num_outliers` correspondences are replaced by noise.
+struct Correspondences {
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+  std::vector<Eigen::Vector3d> points3D;
+};
+
+Correspondences CreateCorrespondences(const size_t num_points,
+                                      const size_t num_outliers) {
+  const Eigen::Vector4d qvec =
+      NormalizeQuaternion(Eigen::Vector4d(1, 0.1, -0.2, 0.05));
+  const Eigen::Vector3d tvec(1, 0.1, 0.2);
+  const Eigen::Matrix3x4d proj_matrix = ComposeProjectionMatrix(qvec, tvec);
+
+  Correspondences correspondences;
+  for (size_t i = 0; i < num_points; ++i) {
+    const Eigen::Vector3d point3D(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0),
+                                  RandomReal(4.0, 8.0));
+    correspondences.points3D.push_back(point3D);
+    correspondences.points1.push_back(point3D.hnormalized());
+    correspondences.points2.push_back(
+        (proj_matrix * point3D.homogeneous()).hnormalized());
+  }
+
+  for (size_t i = 0; i < num_outliers; ++i) {
+    correspondences.points1[i] =
+        Eigen::Vector2d(RandomReal(-0.3, 0.3), RandomReal(-0.3, 0.3));
+    correspondences.points2[i] =
+        Eigen::Vector2d(RandomReal(-0.3, 0.3), RandomReal(-0.3, 0.3));
+  }
+
+  return correspondences;
+}
+
+template <typename RANSACType, typename X_t, typename Y_t>
+double TimeRANSAC(const RANSACOptions& options, const int num_repetitions,
+                  const std::vector<X_t>& X, const std::vector<Y_t>& Y,
+                  size_t* num_inliers) {
+  Timer timer;
+  timer.Start();
+  for (int i = 0; i < num_repetitions; ++i) {
+    SetPRNGSeed(i);
+    RANSACType ransac(options);
+    const auto report = ransac.Estimate(X, Y);
+    CHECK(report.success);
+    *num_inliers = report.support.num_inliers;
+  }
+  return timer.ElapsedSeconds() / num_repetitions;
+}
+
+template <typename RANSACType, typename X_t, typename Y_t>
+void BenchmarkRANSAC(const std::string& name, const RANSACOptions& options,
+                     const std::vector<X_t>& X, const std::vector<Y_t>& Y) {
+  const int kNumRepetitions = 5;
+
+  double serial_time = 0;
+  size_t serial_num_inliers = 0;
+  for (const int num_threads : {1, 2, 4, 8, 16}) {
+    RANSACOptions parallel_options = options;
+    parallel_options.num_threads = num_threads;
+    size_t num_inliers = 0;
+    const double time = TimeRANSAC<RANSACType>(
+        parallel_options, kNumRepetitions, X, Y, &num_inliers);
+
+    // The result must not depend on the number of threads.
+    if (num_threads == 1) {
+      serial_time = time;
+      serial_num_inliers = num_inliers;
+    } else {
+      CHECK_EQ(num_inliers, serial_num_inliers);
+    }
+
+    std::cout << StringPrintf("%12s %8d %10d %11.4fs %9.2fx", name.c_str(),
+                              static_cast<int>(X.size()), num_threads, time,
+                              serial_time / time)
+              << std::endl;
+  }
+}
+
+}  // namespace
+
+// Benchmark of the multi-threaded hypothesis evaluation in RANSAC and
+// LO-RANSAC for the absolute pose, essential and fundamental matrix problems.
+int main(int argc, char** argv) {
+  InitializeGlog(argv);
+
+  SetPRNGSeed(0);
+
+  // Fix the number of trials to compare the throughput of the hypotheses.
+  RANSACOptions options;
+  options.max_error = 1e-3;
+  options.min_num_trials = 2000;
+  options.max_num_trials = 2000;
+
+  std::cout << StringPrintf("%12s %8s %10s %12s %10s", "estimator", "points",
+                            "threads", "time", "speedup")
+            << std::endl;
+
+  for (const size_t num_points : {500, 2000, 8000}) {
+    const Correspondences correspondences =
+        CreateCorrespondences(num_points, num_points / 2);
+
+    BenchmarkRANSAC<LORANSAC<P3PEstimator, EPNPEstimator>>(
+        "abs_pose", options, correspondences.points1,
+        correspondences.points3D);
+    BenchmarkRANSAC<RANSAC<EssentialMatrixFivePointEstimator>>(
+        "essential", options, correspondences.points1,
+        correspondences.points2);
+    BenchmarkRANSAC<LORANSAC<FundamentalMatrixSevenPointEstimator,
+                             FundamentalMatrixEightPointEstimator>>(
+        "fundamental", options, correspondences.points1,
+        correspondences.points2);
+  }
+
+  return EXIT_SUCCESS;
+}
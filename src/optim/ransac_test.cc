@@ -50,6 +50,7 @@ BOOST_AUTO_TEST_CASE(TestOptions) {
   BOOST_CHECK_EQUAL(options.confidence, 0.99);
   BOOST_CHECK_EQUAL(options.min_num_trials, 0);
   BOOST_CHECK_EQUAL(options.max_num_trials, std::numeric_limits<size_t>::max());
+  BOOST_CHECK_EQUAL(options.num_threads, 1);
 }
 
 BOOST_AUTO_TEST_CASE(TestReport) {
@@ -136,3 +137,94 @@ BOOST_AUTO_TEST_CASE(TestSimilarityTransform) {
       (orig_tform.Matrix().topLeftCorner<3, 4>() - report.model).norm();
   BOOST_CHECK(std::abs(matrix_diff) < 1e-6);
 }
+
+BOOST_AUTO_TEST_CASE(TestParallel) {
+  SetPRNGSeed(0);
+
+  const size_t num_samples = 1000;
+  const size_t num_outliers = 600;
+
+  const SimilarityTransform3 orig_tform(2, ComposeIdentityQuaternion(),
+                                        Eigen::Vector3d(100, 10, 10));
+
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> dst;
+  for (size_t i = 0; i < num_samples; ++i) {
+    src.emplace_back(i, std::sqrt(i) + 2, std::sqrt(2 * i + 2));
+    dst.push_back(src.back());
+    orig_tform.TransformPoint(&dst.back());
+    dst.back() += Eigen::Vector3d::Constant(RandomReal(-1.0, 1.0));
+  }
+
+  for (size_t i = 0; i < num_outliers; ++i) {
+    dst[i] = Eigen::Vector3d(RandomReal(-3000.0, -2000.0),
+                             RandomReal(-4000.0, -3000.0),
+                             RandomReal(-5000.0, -4000.0));
+  }
+
+  // The result must not depend on the number of threads for a fixed seed.
+  RANSACOptions options;
+  options.max_error = 2;
+  SetPRNGSeed(1);
+  RANSAC<SimilarityTransformEstimator<3>> ransac(options);
+  const auto ref_report = ransac.Estimate(src, dst);
+  BOOST_CHECK_EQUAL(ref_report.success, true);
+
+  for (const int num_threads : {2, 3, 8}) {
+    options.num_threads = num_threads;
+    SetPRNGSeed(1);
+    RANSAC<SimilarityTransformEstimator<3>> parallel_ransac(options);
+    const auto report = parallel_ransac.Estimate(src, dst);
+    BOOST_CHECK_EQUAL(report.success, ref_report.success);
+    BOOST_CHECK_EQUAL(report.num_trials, ref_report.num_trials);
+    BOOST_CHECK_EQUAL(report.support.num_inliers,
+                      ref_report.support.num_inliers);
+    BOOST_CHECK_EQUAL(report.support.residual_sum,
+                      ref_report.support.residual_sum);
+    BOOST_CHECK(report.inlier_mask == ref_report.inlier_mask);
+    BOOST_CHECK_EQUAL(report.model, ref_report.model);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelMaxConfidence) {
+  SetPRNGSeed(0);
+
+  const size_t num_samples = 100;
+
+  const SimilarityTransform3 orig_tform(2, ComposeIdentityQuaternion(),
+                                        Eigen::Vector3d(100, 10, 10));
+
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> dst;
+  for (size_t i = 0; i < num_samples; ++i) {
+    src.emplace_back(i, std::sqrt(i) + 2, std::sqrt(2 * i + 2));
+    dst.push_back(src.back());
+    orig_tform.TransformPoint(&dst.back());
+  }
+
+  // A confidence of one never terminates early, so the dynamic number of
+  // trials is the maximum representable value and all trials are evaluated.
+  RANSACOptions options;
+  options.max_error = 2;
+  options.confidence = 1;
+  options.max_num_trials = 100;
+  SetPRNGSeed(1);
+  RANSAC<SimilarityTransformEstimator<3>> ransac(options);
+  const auto ref_report = ransac.Estimate(src, dst);
+  BOOST_CHECK_EQUAL(ref_report.success, true);
+  BOOST_CHECK_EQUAL(ref_report.num_trials, options.max_num_trials);
+
+  options.num_threads = 3;
+  RANSAC<SimilarityTransformEstimator<3>> parallel_ransac(options);
+  // The thread pool is reused across multiple estimations.
+  for (int i = 0; i < 2; ++i) {
+    SetPRNGSeed(1);
+    const auto report = parallel_ransac.Estimate(src, dst);
+    BOOST_CHECK_EQUAL(report.success, ref_report.success);
+    BOOST_CHECK_EQUAL(report.num_trials, ref_report.num_trials);
+    BOOST_CHECK_EQUAL(report.support.num_inliers,
+                      ref_report.support.num_inliers);
+    BOOST_CHECK(report.inlier_mask == ref_report.inlier_mask);
+    BOOST_CHECK_EQUAL(report.model, ref_report.model);
+  }
+}
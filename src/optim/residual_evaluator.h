@@ -0,0 +1,70 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_OPTIM_RESIDUAL_EVALUATOR_H_
+#define COLMAP_SRC_OPTIM_RESIDUAL_EVALUATOR_H_
+
+#include <vector>
+
+namespace colmap {
+
+// Evaluate the residuals of the models estimated in RANSAC for all samples.
+//
+// The samples are passed once, such that specializations for an estimator can
+// prepare them for the repeated evaluation of many models, e.g. by converting
+// them to a structure-of-arrays layout for vectorized residual kernels. The
+// default implementation forwards to the `Residuals` method of the estimator.
+// Specializations are declared next to their estimator and typically derive
+// from one of the vectorized evaluators in `estimators/utils.h`.
+//
+// Note that `Residuals` may be called concurrently from multiple threads.
+template <typename Estimator>
+class ResidualEvaluator {
+ public:
+  ResidualEvaluator(Estimator* estimator,
+                    const std::vector<typename Estimator::X_t>& X,
+                    const std::vector<typename Estimator::Y_t>& Y)
+      : estimator_(estimator), X_(X), Y_(Y) {}
+
+  void Residuals(const typename Estimator::M_t& model,
+                 std::vector<double>* residuals) const {
+    estimator_->Residuals(X_, Y_, model, residuals);
+  }
+
+ private:
+  Estimator* estimator_;
+  const std::vector<typename Estimator::X_t>& X_;
+  const std::vector<typename Estimator::Y_t>& Y_;
+};
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_OPTIM_RESIDUAL_EVALUATOR_H_
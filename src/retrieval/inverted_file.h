@@ -95,8 +95,14 @@ class InvertedFile {
   void AddEntry(const int image_id, typename DescType::Index feature_idx,
                 const DescType& descriptor, const GeomType& geometry);
 
-  // Sorts the inverted file entries in ascending order of image ids. This is
-  // required for efficient scoring and must be called before ScoreFeature.
+  // Adds an inverted file entry, whose binary descriptor was already computed
+  // using ConvertToBinaryDescriptor.
+  void AddEntry(const EntryType& entry);
+
+  // Sorts the inverted file entries in ascending order of image ids and
+  // feature indices, such that the order of the entries does not depend on
+  // the order in which they were added. This is required for efficient scoring
+  // and must be called before ScoreFeature.
   void SortEntries();
 
   // Clear all entries in this file.
@@ -126,6 +132,9 @@ class InvertedFile {
   void ScoreFeature(const DescType& descriptor,
                     std::vector<ImageScore>* image_scores) const;
 
+  // Get the number of distinct images in this file.
+  size_t NumImages() const;
+
   // Get the identifiers of all indexed images in this file.
   void GetImageIds(std::unordered_set<int>* ids) const;
 
@@ -210,13 +219,18 @@ void InvertedFile<kEmbeddingDim>::AddEntry(const int image_id,
                                            typename DescType::Index feature_idx,
                                            const DescType& descriptor,
                                            const GeomType& geometry) {
-  CHECK_GE(image_id, 0);
   CHECK_EQ(descriptor.size(), kEmbeddingDim);
   EntryType entry;
   entry.image_id = image_id;
   entry.feature_idx = feature_idx;
   entry.geometry = geometry;
   ConvertToBinaryDescriptor(descriptor, &entry.descriptor);
+  AddEntry(entry);
+}
+
+template <int kEmbeddingDim>
+void InvertedFile<kEmbeddingDim>::AddEntry(const EntryType& entry) {
+  CHECK_GE(entry.image_id, 0);
   entries_.push_back(entry);
   status_ &= ~ENTRIES_SORTED;
 }
@@ -225,6 +239,9 @@ template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::SortEntries() {
   std::sort(entries_.begin(), entries_.end(),
             [](const EntryType& entry1, const EntryType& entry2) {
+              if (entry1.image_id == entry2.image_id) {
+                return entry1.feature_idx < entry2.feature_idx;
+              }
               return entry1.image_id < entry2.image_id;
             });
   status_ |= ENTRIES_SORTED;
@@ -260,11 +277,8 @@ void InvertedFile<kEmbeddingDim>::ComputeIDFWeight(const int num_total_images) {
     return;
   }
 
-  std::unordered_set<int> image_ids;
-  GetImageIds(&image_ids);
-
   idf_weight_ = std::log(static_cast<double>(num_total_images) /
-                         static_cast<double>(image_ids.size()));
+                         static_cast<double>(NumImages()));
 }
 
 template <int kEmbeddingDim>
@@ -355,11 +369,32 @@ void InvertedFile<kEmbeddingDim>::ScoreFeature(
   }
 }
 
+template <int kEmbeddingDim>
+size_t InvertedFile<kEmbeddingDim>::NumImages() const {
+  if (!EntriesSorted()) {
+    std::unordered_set<int> image_ids;
+    GetImageIds(&image_ids);
+    return image_ids.size();
+  }
+
+  // Sorted entries of the same image are consecutive.
+  size_t num_images = 0;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    if (i == 0 || entries_[i].image_id != entries_[i - 1].image_id) {
+      num_images += 1;
+    }
+  }
+  return num_images;
+}
+
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::GetImageIds(
     std::unordered_set<int>* ids) const {
-  for (const EntryType& entry : entries_) {
-    ids->insert(entry.image_id);
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    // Skip the consecutive entries of the same image.
+    if (i == 0 || entries_[i].image_id != entries_[i - 1].image_id) {
+      ids->insert(entries_[i].image_id);
+    }
   }
 }
 
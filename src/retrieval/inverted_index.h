@@ -36,6 +36,8 @@
 #include <bitset>
 #include <cstdint>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -46,6 +48,7 @@
 #include "retrieval/inverted_file.h"
 #include "util/alignment.h"
 #include "util/random.h"
+#include "util/threading.h"
 
 namespace colmap {
 namespace retrieval {
@@ -73,8 +76,10 @@ class InvertedIndex {
   void Initialize(const int num_words);
 
   // Finalizes the inverted index by sorting each inverted file such that all
-  // entries are in ascending order of image ids.
-  void Finalize();
+  // entries are in ascending order of image ids and by computing the weights
+  // and normalization constants. The inverted files are processed in parallel
+  // using the given number of threads.
+  void Finalize(const int num_threads = ThreadPool::kMaxNumThreads);
 
   // Generate projection matrix for Hamming embedding.
   void GenerateHammingEmbeddingProjection();
@@ -89,6 +94,14 @@ class InvertedIndex {
                 typename DescType::Index feature_idx,
                 const DescType& descriptor, const GeomType& geometry);
 
+  // Add the entries of all features of an image to the index, where each
+  // feature is assigned to the visual words in the corresponding row of
+  // word_ids. In contrast to AddEntry, this function can be called
+  // concurrently for different images.
+  void AddEntries(const int image_id, const Eigen::MatrixXi& word_ids,
+                  const DescType& descriptors,
+                  const std::vector<GeomType>& geometries);
+
   // Clear all index entries.
   void ClearEntries();
 
@@ -116,7 +129,16 @@ class InvertedIndex {
   void Write(std::ofstream* ofs) const;
 
  private:
-  void ComputeWeightsAndNormalizationConstants();
+  // The number of mutexes guarding the inverted files in AddEntries, where
+  // each mutex guards every kNumEntryMutexes-th inverted file.
+  static const size_t kNumEntryMutexes;
+
+  void ComputeWeightsAndNormalizationConstants(ThreadPool* thread_pool);
+
+  // Split the visual words into one contiguous range per thread and call
+  // func(range_idx, begin_word_id, end_word_id) for all ranges in parallel.
+  template <typename Func>
+  void ParallelForWordRanges(ThreadPool* thread_pool, const Func& func) const;
 
   // The individual inverted indices.
   std::vector<InvertedFile<kEmbeddingDim>,
@@ -129,6 +151,9 @@ class InvertedIndex {
 
   // The projection matrix used to project SIFT descriptors.
   ProjMatrixType proj_matrix_;
+
+  // The mutexes for concurrently adding entries to the inverted files.
+  std::vector<std::unique_ptr<std::mutex>> entry_mutexes_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -139,10 +164,18 @@ template <typename kDescType, int kDescDim, int kEmbeddingDim>
 const int InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::kInvalidWordId =
     std::numeric_limits<int>::max();
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+const size_t
+    InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::kNumEntryMutexes = 256;
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::InvertedIndex() {
   proj_matrix_.resize(kEmbeddingDim, kDescDim);
   proj_matrix_.setIdentity();
+  entry_mutexes_.reserve(kNumEntryMutexes);
+  for (size_t i = 0; i < kNumEntryMutexes; ++i) {
+    entry_mutexes_.emplace_back(new std::mutex());
+  }
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -161,14 +194,21 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Initialize(
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
-void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Finalize() {
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Finalize(
+    const int num_threads) {
   CHECK_GT(NumVisualWords(), 0);
 
-  for (auto& inverted_file : inverted_files_) {
-    inverted_file.SortEntries();
-  }
+  ThreadPool thread_pool(num_threads);
+
+  ParallelForWordRanges(&thread_pool, [this](const size_t range_idx,
+                                             const size_t begin,
+                                             const size_t end) {
+    for (size_t word_id = begin; word_id < end; ++word_id) {
+      inverted_files_[word_id].SortEntries();
+    }
+  });
 
-  ComputeWeightsAndNormalizationConstants();
+  ComputeWeightsAndNormalizationConstants(&thread_pool);
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -228,6 +268,57 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::AddEntry(
       .AddEntry(image_id, feature_idx, proj_desc, geometry);
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::AddEntries(
+    const int image_id, const Eigen::MatrixXi& word_ids,
+    const DescType& descriptors, const std::vector<GeomType>& geometries) {
+  CHECK_EQ(descriptors.rows(), word_ids.rows());
+  CHECK_EQ(static_cast<size_t>(descriptors.rows()), geometries.size());
+
+  // Create the entries before acquiring any lock, since the projection of the
+  // descriptors dominates the cost of adding entries.
+  std::vector<std::pair<int, EntryType>> word_entries;
+  word_entries.reserve(word_ids.size());
+  for (typename DescType::Index i = 0; i < descriptors.rows(); ++i) {
+    const ProjDescType proj_desc =
+        proj_matrix_ * descriptors.row(i).transpose().template cast<float>();
+    for (Eigen::MatrixXi::Index n = 0; n < word_ids.cols(); ++n) {
+      const int word_id = word_ids(i, n);
+      if (word_id == kInvalidWordId) {
+        continue;
+      }
+
+      EntryType entry;
+      entry.image_id = image_id;
+      entry.feature_idx = i;
+      entry.geometry = geometries[i];
+      inverted_files_.at(word_id).ConvertToBinaryDescriptor(proj_desc,
+                                                            &entry.descriptor);
+      word_entries.emplace_back(word_id, entry);
+    }
+  }
+
+  // Group the entries by their mutex, such that each mutex is acquired at most
+  // once per image.
+  std::sort(word_entries.begin(), word_entries.end(),
+            [](const std::pair<int, EntryType>& word_entry1,
+               const std::pair<int, EntryType>& word_entry2) {
+              return word_entry1.first % kNumEntryMutexes <
+                     word_entry2.first % kNumEntryMutexes;
+            });
+
+  size_t i = 0;
+  while (i < word_entries.size()) {
+    const size_t mutex_idx = word_entries[i].first % kNumEntryMutexes;
+    std::lock_guard<std::mutex> lock(*entry_mutexes_[mutex_idx]);
+    for (; i < word_entries.size() &&
+           word_entries[i].first % kNumEntryMutexes == mutex_idx;
+         ++i) {
+      inverted_files_[word_entries[i].first].AddEntry(word_entries[i].second);
+    }
+  }
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::ClearEntries() {
   for (auto& inverted_file : inverted_files_) {
@@ -414,18 +505,46 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Write(
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
-void InvertedIndex<kDescType, kDescDim,
-                   kEmbeddingDim>::ComputeWeightsAndNormalizationConstants() {
-  std::unordered_set<int> image_ids;
-  GetImageIds(&image_ids);
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::
+    ComputeWeightsAndNormalizationConstants(ThreadPool* thread_pool) {
+  // Collect the image identifiers per range of visual words and merge them.
+  std::vector<std::unordered_set<int>> range_image_ids(
+      thread_pool->NumThreads());
+  ParallelForWordRanges(thread_pool, [this, &range_image_ids](
+                                         const size_t range_idx,
+                                         const size_t begin, const size_t end) {
+    for (size_t word_id = begin; word_id < end; ++word_id) {
+      inverted_files_[word_id].GetImageIds(&range_image_ids[range_idx]);
+    }
+  });
 
-  for (auto& inverted_file : inverted_files_) {
-    inverted_file.ComputeIDFWeight(image_ids.size());
+  std::unordered_set<int> image_ids;
+  for (const auto& ids : range_image_ids) {
+    image_ids.insert(ids.begin(), ids.end());
   }
 
+  // Compute the weights and accumulate the self-similarities per range of
+  // visual words and merge them.
+  const int num_images = static_cast<int>(image_ids.size());
+  std::vector<std::unordered_map<int, double>> range_self_similarities(
+      thread_pool->NumThreads());
+  ParallelForWordRanges(thread_pool, [this, num_images,
+                                      &range_self_similarities](
+                                         const size_t range_idx,
+                                         const size_t begin, const size_t end) {
+    for (size_t word_id = begin; word_id < end; ++word_id) {
+      auto& inverted_file = inverted_files_[word_id];
+      inverted_file.ComputeIDFWeight(num_images);
+      inverted_file.ComputeImageSelfSimilarities(
+          &range_self_similarities[range_idx]);
+    }
+  });
+
   std::unordered_map<int, double> self_similarities(image_ids.size());
-  for (const auto& inverted_file : inverted_files_) {
-    inverted_file.ComputeImageSelfSimilarities(&self_similarities);
+  for (const auto& range_self_similarity : range_self_similarities) {
+    for (const auto& self_similarity : range_self_similarity) {
+      self_similarities[self_similarity.first] += self_similarity.second;
+    }
   }
 
   normalization_constants_.clear();
@@ -440,6 +559,20 @@ void InvertedIndex<kDescType, kDescDim,
   }
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+template <typename Func>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::ParallelForWordRanges(
+    ThreadPool* thread_pool, const Func& func) const {
+  const size_t num_words = inverted_files_.size();
+  const size_t num_ranges = thread_pool->NumThreads();
+  for (size_t range_idx = 0; range_idx < num_ranges; ++range_idx) {
+    const size_t begin = range_idx * num_words / num_ranges;
+    const size_t end = (range_idx + 1) * num_words / num_ranges;
+    thread_pool->AddTask(func, range_idx, begin, end);
+  }
+  thread_pool->Wait();
+}
+
 }  // namespace retrieval
 }  // namespace colmap
 
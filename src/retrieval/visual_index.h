@@ -32,6 +32,8 @@
 #ifndef COLMAP_SRC_RETRIEVAL_VISUAL_INDEX_H_
 #define COLMAP_SRC_RETRIEVAL_VISUAL_INDEX_H_
 
+#include <mutex>
+
 #include <boost/heap/fibonacci_heap.hpp>
 #include <Eigen/Core>
 
@@ -122,7 +124,10 @@ class VisualIndex {
 
   size_t NumVisualWords() const;
 
-  // Add image to the visual index.
+  // Add image to the visual index. Images can be added concurrently from
+  // multiple threads, in which case the number of threads in the options
+  // should typically be 1. However, adding images must not overlap with any
+  // other operation on the index.
   void Add(const IndexOptions& options, const int image_id,
            const GeomType& geometries, const DescType& descriptors);
 
@@ -139,7 +144,7 @@ class VisualIndex {
              std::vector<ImageScore>* image_scores) const;
 
   // Prepare the index after adding images and before querying.
-  void Prepare();
+  void Prepare(const int num_threads = kMaxNumThreads);
 
   // Build a visual index from a set of training descriptors by quantizing the
   // descriptor space into visual words and compute their Hamming embedding.
@@ -177,6 +182,7 @@ class VisualIndex {
 
   // Identifiers of all indexed images.
   std::unordered_set<int> image_ids_;
+  mutable std::mutex image_ids_mutex_;
 
   // Whether the index is prepared.
   bool prepared_;
@@ -208,14 +214,16 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Add(
     const DescType& descriptors) {
   CHECK_EQ(geometries.size(), descriptors.rows());
 
-  // If the image is already indexed, do nothing.
-  if (ImageIndexed(image_id)) {
-    return;
-  }
+  {
+    std::lock_guard<std::mutex> lock(image_ids_mutex_);
 
-  image_ids_.insert(image_id);
+    // If the image is already indexed, do nothing.
+    if (!image_ids_.insert(image_id).second) {
+      return;
+    }
 
-  prepared_ = false;
+    prepared_ = false;
+  }
 
   if (descriptors.rows() == 0) {
     return;
@@ -225,27 +233,23 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Add(
       FindWordIds(descriptors, options.num_neighbors, options.num_checks,
                   options.num_threads);
 
-  for (typename DescType::Index i = 0; i < descriptors.rows(); ++i) {
-    const auto& descriptor = descriptors.row(i);
-
-    typename InvertedIndexType::GeomType geometry;
-    geometry.x = geometries[i].x;
-    geometry.y = geometries[i].y;
-    geometry.scale = geometries[i].ComputeScale();
-    geometry.orientation = geometries[i].ComputeOrientation();
-
-    for (int n = 0; n < options.num_neighbors; ++n) {
-      const int word_id = word_ids(i, n);
-      if (word_id != InvertedIndexType::kInvalidWordId) {
-        inverted_index_.AddEntry(image_id, word_id, i, descriptor, geometry);
-      }
-    }
+  std::vector<typename InvertedIndexType::GeomType> index_geometries(
+      geometries.size());
+  for (size_t i = 0; i < geometries.size(); ++i) {
+    index_geometries[i].x = geometries[i].x;
+    index_geometries[i].y = geometries[i].y;
+    index_geometries[i].scale = geometries[i].ComputeScale();
+    index_geometries[i].orientation = geometries[i].ComputeOrientation();
   }
+
+  inverted_index_.AddEntries(image_id, word_ids, descriptors,
+                             index_geometries);
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 bool VisualIndex<kDescType, kDescDim, kEmbeddingDim>::ImageIndexed(
     const int image_id) const {
+  std::lock_guard<std::mutex> lock(image_ids_mutex_);
   return image_ids_.count(image_id) != 0;
 }
 
@@ -502,8 +506,9 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
-void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Prepare() {
-  inverted_index_.Finalize();
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Prepare(
+    const int num_threads) {
+  inverted_index_.Finalize(num_threads);
   prepared_ = true;
 }
 
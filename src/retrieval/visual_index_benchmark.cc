@@ -0,0 +1,145 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+
+#include "retrieval/visual_index.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/random.h"
+#include "util/threading.h"
+#include "util/timer.h"
+
+using namespace colmap;
+using namespace colmap::retrieval;
+
+namespace {
+
+typedef VisualIndex<> VisualIndexType;
+
+std::vector<VisualIndexType::DescType> CreateImageDescriptors(
+    const int num_images, const int num_features) {
+  std::vector<VisualIndexType::DescType> image_descriptors(num_images);
+  for (auto& descriptors : image_descriptors) {
+    descriptors.resize(num_features, 128);
+    for (int i = 0; i < descriptors.size(); ++i) {
+      descriptors(i) = RandomInteger<int>(0, 255);
+    }
+  }
+  return image_descriptors;
+}
+
+}  // namespace
+
+// Benchmark of the scaling of indexing images in a visual index with the
+// number of threads. The images are added concurrently with a single thread
+// per image and then the index is prepared using all threads.
+int main(int argc, char** argv) {
+  InitializeGlog(argv);
+
+  const int kNumVisualWords = 4096;
+  const int kNumTrainingFeatures = 50000;
+  const int kNumImages = 500;
+  const int kNumDistinctImages = 100;
+  const int kNumFeatures = 500;
+
+  SetPRNGSeed(0);
+
+  const std::string vocab_tree_path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path())
+          .string();
+
+  {
+    VisualIndexType visual_index;
+    VisualIndexType::BuildOptions build_options;
+    build_options.num_visual_words = kNumVisualWords;
+    build_options.branching = 64;
+    build_options.num_iterations = 2;
+    visual_index.Build(build_options,
+                       CreateImageDescriptors(1, kNumTrainingFeatures)[0]);
+    visual_index.Write(vocab_tree_path);
+  }
+
+  // Cycle through a smaller set of distinct images to limit the memory.
+  const std::vector<VisualIndexType::DescType> image_descriptors =
+      CreateImageDescriptors(kNumDistinctImages, kNumFeatures);
+  const VisualIndexType::GeomType keypoints(kNumFeatures);
+
+  std::cout << StringPrintf("%10s %12s %12s %12s", "threads", "add",
+                            "prepare", "speedup")
+            << std::endl;
+
+  double sequential_time = 0;
+  for (const int num_threads : {1, 2, 4, 8}) {
+    VisualIndexType visual_index;
+    visual_index.Read(vocab_tree_path);
+
+    VisualIndexType::IndexOptions index_options;
+    index_options.num_threads = 1;
+
+    Timer timer;
+    timer.Start();
+
+    ThreadPool thread_pool(num_threads);
+    for (int image_id = 0; image_id < kNumImages; ++image_id) {
+      thread_pool.AddTask(
+          [&](const int image_idx) {
+            visual_index.Add(
+                index_options, image_idx, keypoints,
+                image_descriptors[image_idx % kNumDistinctImages]);
+          },
+          image_id);
+    }
+    thread_pool.Wait();
+
+    const double add_time = timer.ElapsedSeconds();
+
+    timer.Restart();
+    visual_index.Prepare(num_threads);
+    const double prepare_time = timer.ElapsedSeconds();
+
+    if (num_threads == 1) {
+      sequential_time = add_time + prepare_time;
+    }
+
+    std::cout << StringPrintf("%10d %11.4fs %11.4fs %11.2fx", num_threads,
+                              add_time, prepare_time,
+                              sequential_time / (add_time + prepare_time))
+              << std::endl;
+  }
+
+  boost::filesystem::remove(vocab_tree_path);
+
+  return EXIT_SUCCESS;
+}
@@ -33,6 +33,7 @@
 #include "util/testing.h"
 
 #include "retrieval/visual_index.h"
+#include "util/threading.h"
 
 using namespace colmap;
 using namespace colmap::retrieval;
@@ -112,3 +113,69 @@ BOOST_AUTO_TEST_CASE(TestVocabTree) {
   TestVocabTreeType<float, 32, 16>();
   TestVocabTreeType<double, 32, 16>();
 }
+
+BOOST_AUTO_TEST_CASE(TestAddConcurrently) {
+  typedef VisualIndex<> VisualIndexType;
+
+  SetPRNGSeed(0);
+
+  const VisualIndexType::DescType descriptors =
+      VisualIndexType::DescType::Random(1000, 128);
+  VisualIndexType visual_index;
+  VisualIndexType::BuildOptions build_options;
+  build_options.num_visual_words = 100;
+  build_options.branching = 10;
+  visual_index.Build(build_options, descriptors);
+
+  const int kNumImages = 20;
+  const VisualIndexType::GeomType keypoints(50);
+  std::vector<VisualIndexType::DescType> image_descriptors;
+  for (int i = 0; i < kNumImages; ++i) {
+    image_descriptors.push_back(VisualIndexType::DescType::Random(50, 128));
+  }
+
+  // Add the images once sequentially and once concurrently under different
+  // identifiers, which must result in the same scores.
+  VisualIndexType::IndexOptions index_options;
+  index_options.num_threads = 1;
+  for (int i = 0; i < kNumImages; ++i) {
+    visual_index.Add(index_options, i, keypoints, image_descriptors[i]);
+  }
+
+  ThreadPool thread_pool(4);
+  for (int i = 0; i < kNumImages; ++i) {
+    thread_pool.AddTask(
+        [&](const int image_idx) {
+          visual_index.Add(index_options, kNumImages + image_idx, keypoints,
+                           image_descriptors[image_idx]);
+        },
+        i);
+  }
+  thread_pool.Wait();
+
+  visual_index.Prepare(4);
+
+  for (int i = 0; i < 2 * kNumImages; ++i) {
+    BOOST_CHECK(visual_index.ImageIndexed(i));
+  }
+
+  VisualIndexType::QueryOptions query_options;
+  for (int i = 0; i < kNumImages; ++i) {
+    std::vector<ImageScore> image_scores;
+    visual_index.Query(query_options, image_descriptors[i], &image_scores);
+    BOOST_CHECK_GE(image_scores.size(), 2);
+    BOOST_CHECK_EQUAL(image_scores[0].image_id % kNumImages, i);
+    BOOST_CHECK_EQUAL(image_scores[1].image_id % kNumImages, i);
+
+    std::unordered_map<int, float> scores;
+    for (const auto& image_score : image_scores) {
+      scores.emplace(image_score.image_id, image_score.score);
+    }
+    for (int j = 0; j < kNumImages; ++j) {
+      BOOST_CHECK_EQUAL(scores.count(j), scores.count(kNumImages + j));
+      if (scores.count(j) > 0) {
+        BOOST_CHECK_EQUAL(scores.at(j), scores.at(kNumImages + j));
+      }
+    }
+  }
+}
@@ -34,6 +34,7 @@
 #include <array>
 #include <fstream>
 
+#include "base/pose.h"
 #include "base/projection.h"
 #include "base/triangulation.h"
 #include "estimators/pose.h"
@@ -85,6 +86,8 @@ bool IncrementalMapper::Options::Check() const {
   CHECK_OPTION_GT(abs_pose_min_num_inliers, 0);
   CHECK_OPTION_GE(abs_pose_min_inlier_ratio, 0.0);
   CHECK_OPTION_LE(abs_pose_min_inlier_ratio, 1.0);
+  CHECK_OPTION_NE(abs_pose_ransac_num_threads, 0);
+  CHECK_OPTION_GE(abs_pose_ransac_num_threads, -1);
   CHECK_OPTION_GE(local_ba_num_images, 2);
   CHECK_OPTION_GE(local_ba_min_tri_angle, 0.0);
   CHECK_OPTION_GE(min_focal_length_ratio, 0.0);
@@ -102,7 +105,8 @@ IncrementalMapper::IncrementalMapper(const DatabaseCache* database_cache)
       triangulator_(nullptr),
       num_total_reg_images_(0),
       num_shared_reg_images_(0),
-      prev_init_image_pair_id_(kInvalidImagePairId) {}
+      prev_init_image_pair_id_(kInvalidImagePairId),
+      async_ba_print_summary_(false) {}
 
 void IncrementalMapper::BeginReconstruction(Reconstruction* reconstruction) {
   CHECK(reconstruction_ == nullptr);
@@ -139,8 +143,15 @@ void IncrementalMapper::EndReconstruction(const bool discard) {
   }
 
   reconstruction_->TearDown();
+  // Discard a pending asynchronous global bundle adjustment.
+  if (IsAsyncGlobalBundlePending()) {
+    async_ba_success_.get();
+    async_ba_reconstruction_.reset();
+  }
+
   reconstruction_ = nullptr;
   triangulator_.reset();
+  local_bundle_adjuster_.reset();
 }
 
 bool IncrementalMapper::FindInitialImagePair(const Options& options,
@@ -448,6 +459,8 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   abs_pose_options.ransac_options.min_num_trials = 100;
   abs_pose_options.ransac_options.max_num_trials = 10000;
   abs_pose_options.ransac_options.confidence = 0.99999;
+  abs_pose_options.ransac_options.num_threads =
+      options.abs_pose_ransac_num_threads;
 
   AbsolutePoseRefinementOptions abs_pose_refinement_options;
   if (num_reg_images_per_camera_[image.CameraId()] > 0) {
@@ -629,11 +642,19 @@ IncrementalMapper::AdjustLocalBundle(
     }
 
     // Adjust the local bundle.
-    BundleAdjuster bundle_adjuster(ba_options, ba_config);
-    bundle_adjuster.Solve(reconstruction_);
-
-    report.num_adjusted_observations =
-        bundle_adjuster.Summary().num_residuals / 2;
+    if (options.local_ba_reuse_problem) {
+      if (!local_bundle_adjuster_) {
+        local_bundle_adjuster_.reset(new PersistentBundleAdjuster());
+      }
+      local_bundle_adjuster_->Solve(ba_options, ba_config, reconstruction_);
+      report.num_adjusted_observations =
+          local_bundle_adjuster_->Summary().num_residuals / 2;
+    } else {
+      BundleAdjuster bundle_adjuster(ba_options, ba_config);
+      bundle_adjuster.Solve(reconstruction_);
+      report.num_adjusted_observations =
+          bundle_adjuster.Summary().num_residuals / 2;
+    }
 
     // Merge refined tracks with other existing points.
     report.num_merged_observations =
@@ -675,30 +696,13 @@ bool IncrementalMapper::AdjustGlobalBundle(
                                        "registered for global "
                                        "bundle-adjustment";
 
+  CHECK(!IsAsyncGlobalBundlePending());
+
   // Avoid degeneracies in bundle adjustment.
   reconstruction_->FilterObservationsWithNegativeDepth();
 
   // Configure bundle adjustment.
-  BundleAdjustmentConfig ba_config;
-  for (const image_t image_id : reg_image_ids) {
-    ba_config.AddImage(image_id);
-  }
-
-  // Fix the existing images, if option specified.
-  if (options.fix_existing_images) {
-    for (const image_t image_id : reg_image_ids) {
-      if (existing_image_ids_.count(image_id)) {
-        ba_config.SetConstantPose(image_id);
-      }
-    }
-  }
-
-  // Fix 7-DOFs of the bundle adjustment problem.
-  ba_config.SetConstantPose(reg_image_ids[0]);
-  if (!options.fix_existing_images ||
-      !existing_image_ids_.count(reg_image_ids[1])) {
-    ba_config.SetConstantTvec(reg_image_ids[1], {0});
-  }
+  const BundleAdjustmentConfig ba_config = CreateGlobalBundleConfig(options);
 
   // Run bundle adjustment.
   BundleAdjuster bundle_adjuster(ba_options, ba_config);
@@ -722,6 +726,7 @@ bool IncrementalMapper::AdjustParallelGlobalBundle(
 
   CHECK_GE(reg_image_ids.size(), 2)
       << "At least two images must be registered for global bundle-adjustment";
+  CHECK(!IsAsyncGlobalBundlePending());
 
   // Avoid degeneracies in bundle adjustment.
   reconstruction_->FilterObservationsWithNegativeDepth();
@@ -746,6 +751,144 @@ bool IncrementalMapper::AdjustParallelGlobalBundle(
   return true;
 }
 
+void IncrementalMapper::BeginAsyncGlobalBundle(
+    const Options& options, const BundleAdjustmentOptions& ba_options) {
+  CHECK_NOTNULL(reconstruction_);
+  CHECK(!IsAsyncGlobalBundlePending());
+
+  CHECK_GE(reconstruction_->NumRegImages(), 2)
+      << "At least two images must be registered for global bundle-adjustment";
+
+  // Avoid degeneracies in bundle adjustment.
+  reconstruction_->FilterObservationsWithNegativeDepth();
+
+  const BundleAdjustmentConfig ba_config = CreateGlobalBundleConfig(options);
+
+  // Copy the reconstruction and the parameters before the adjustment.
+  async_ba_reconstruction_.reset(new Reconstruction(*reconstruction_));
+
+  async_ba_camera_params_.clear();
+  for (const auto& camera : reconstruction_->Cameras()) {
+    async_ba_camera_params_.emplace(camera.first, camera.second.Params());
+  }
+
+  async_ba_qvecs_.clear();
+  async_ba_tvecs_.clear();
+  for (const image_t image_id : reconstruction_->RegImageIds()) {
+    const Image& image = reconstruction_->Image(image_id);
+    async_ba_qvecs_.emplace(image_id, image.Qvec());
+    async_ba_tvecs_.emplace(image_id, image.Tvec());
+  }
+
+  async_ba_points3D_.clear();
+  for (const auto& point3D : reconstruction_->Points3D()) {
+    async_ba_points3D_.emplace(point3D.first, point3D.second.XYZ());
+  }
+
+  // The adjustment runs quietly and its summary is printed by the calling
+  // thread when ending the adjustment, so that it does not interleave with
+  // the output of the registration.
+  BundleAdjustmentOptions async_ba_options = ba_options;
+  async_ba_options.print_summary = false;
+  async_ba_options.solver_options.minimizer_progress_to_stdout = false;
+  async_ba_print_summary_ = ba_options.print_summary;
+
+  if (!async_ba_thread_pool_) {
+    async_ba_thread_pool_.reset(new ThreadPool(1));
+  }
+
+  // The task only accesses the copy of the reconstruction and the summary,
+  // which are published to the calling thread through the future. The copy
+  // shares the correspondence graph with the reconstruction, but bundle
+  // adjustment never changes observations, so the graph is only read. The
+  // thread pool is declared last, such that it joins the task before the
+  // copy is destroyed.
+  async_ba_success_ =
+      async_ba_thread_pool_->AddTask([this, async_ba_options, ba_config]() {
+        BundleAdjuster bundle_adjuster(async_ba_options, ba_config);
+        const bool success =
+            bundle_adjuster.Solve(async_ba_reconstruction_.get());
+        async_ba_summary_ = bundle_adjuster.Summary();
+        return success;
+      });
+}
+
+bool IncrementalMapper::IsAsyncGlobalBundlePending() const {
+  return async_ba_success_.valid();
+}
+
+bool IncrementalMapper::IsAsyncGlobalBundleFinished() const {
+  return async_ba_success_.valid() &&
+         async_ba_success_.wait_for(std::chrono::seconds(0)) ==
+             std::future_status::ready;
+}
+
+bool IncrementalMapper::EndAsyncGlobalBundle() {
+  CHECK_NOTNULL(reconstruction_);
+  CHECK(IsAsyncGlobalBundlePending());
+
+  const bool success = async_ba_success_.get();
+
+  if (success) {
+    if (async_ba_print_summary_) {
+      PrintHeading2("Bundle adjustment report");
+      PrintSolverSummary(async_ba_summary_);
+    }
+
+    for (const auto& camera_params : async_ba_camera_params_) {
+      if (!reconstruction_->ExistsCamera(camera_params.first)) {
+        continue;
+      }
+      const std::vector<double>& adjusted_params =
+          async_ba_reconstruction_->Camera(camera_params.first).Params();
+      std::vector<double>& params =
+          reconstruction_->Camera(camera_params.first).Params();
+      for (size_t i = 0; i < params.size(); ++i) {
+        params[i] += adjusted_params[i] - camera_params.second[i];
+      }
+    }
+
+    // The pose of an image that was not modified since the copy is replaced
+    // by the adjusted pose, and otherwise the concurrent change is applied to
+    // the adjusted pose.
+    for (const auto& qvec : async_ba_qvecs_) {
+      if (!reconstruction_->IsImageRegistered(qvec.first)) {
+        continue;
+      }
+      const Image& adjusted_image =
+          async_ba_reconstruction_->Image(qvec.first);
+      Image& image = reconstruction_->Image(qvec.first);
+      Eigen::Vector4d merged_qvec;
+      Eigen::Vector3d merged_tvec;
+      ApplyPoseChange(qvec.second, async_ba_tvecs_.at(qvec.first),
+                      image.Qvec(), image.Tvec(), adjusted_image.Qvec(),
+                      adjusted_image.Tvec(), &merged_qvec, &merged_tvec);
+      image.Qvec() = merged_qvec;
+      image.Tvec() = merged_tvec;
+    }
+
+    for (const auto& point3D : async_ba_points3D_) {
+      if (reconstruction_->ExistsPoint3D(point3D.first)) {
+        reconstruction_->Point3D(point3D.first).XYZ() +=
+            async_ba_reconstruction_->Point3D(point3D.first).XYZ() -
+            point3D.second;
+      }
+    }
+
+    // Normalize scene for numerical stability and
+    // to avoid large scale changes in viewer.
+    reconstruction_->Normalize();
+  }
+
+  async_ba_reconstruction_.reset();
+  async_ba_camera_params_.clear();
+  async_ba_qvecs_.clear();
+  async_ba_tvecs_.clear();
+  async_ba_points3D_.clear();
+
+  return success;
+}
+
 size_t IncrementalMapper::FilterImages(const Options& options) {
   CHECK_NOTNULL(reconstruction_);
   CHECK(options.Check());
@@ -1196,4 +1339,32 @@ bool IncrementalMapper::EstimateInitialTwoViewGeometry(
   return false;
 }
 
+BundleAdjustmentConfig IncrementalMapper::CreateGlobalBundleConfig(
+    const Options& options) const {
+  const std::vector<image_t>& reg_image_ids = reconstruction_->RegImageIds();
+
+  BundleAdjustmentConfig ba_config;
+  for (const image_t image_id : reg_image_ids) {
+    ba_config.AddImage(image_id);
+  }
+
+  // Fix the existing images, if option specified.
+  if (options.fix_existing_images) {
+    for (const image_t image_id : reg_image_ids) {
+      if (existing_image_ids_.count(image_id)) {
+        ba_config.SetConstantPose(image_id);
+      }
+    }
+  }
+
+  // Fix 7-DOFs of the bundle adjustment problem.
+  ba_config.SetConstantPose(reg_image_ids[0]);
+  if (!options.fix_existing_images ||
+      !existing_image_ids_.count(reg_image_ids[1])) {
+    ba_config.SetConstantTvec(reg_image_ids[1], {0});
+  }
+
+  return ba_config;
+}
+
 }  // namespace colmap
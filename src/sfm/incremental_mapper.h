@@ -32,12 +32,15 @@
 #ifndef COLMAP_SRC_SFM_INCREMENTAL_MAPPER_H_
 #define COLMAP_SRC_SFM_INCREMENTAL_MAPPER_H_
 
+#include <future>
+
 #include "base/database.h"
 #include "base/database_cache.h"
 #include "base/reconstruction.h"
 #include "optim/bundle_adjustment.h"
 #include "sfm/incremental_triangulator.h"
 #include "util/alignment.h"
+#include "util/threading.h"
 
 namespace colmap {
 
@@ -95,12 +98,21 @@ class IncrementalMapper {
     // Whether to estimate the extra parameters in absolute pose estimation.
     bool abs_pose_refine_extra_params = true;
 
+    // Number of threads to evaluate the RANSAC trials of absolute pose
+    // estimation concurrently.
+    int abs_pose_ransac_num_threads = 1;
+
     // Number of images to optimize in local bundle adjustment.
     int local_ba_num_images = 6;
 
     // Minimum triangulation for images to be chosen in local bundle adjustment.
     double local_ba_min_tri_angle = 6;
 
+    // Whether to keep the local bundle adjustment problem alive across calls
+    // and only update the residuals of images and points that entered or left
+    // the local bundle.
+    bool local_ba_reuse_problem = false;
+
     // Thresholds for bogus camera parameters. Images with bogus camera
     // parameters are filtered and ignored in triangulation.
     double min_focal_length_ratio = 0.1;  // Opening angle of ~130deg
@@ -213,6 +225,27 @@ class IncrementalMapper {
       const BundleAdjustmentOptions& ba_options,
       const ParallelBundleAdjuster::Options& parallel_ba_options);
 
+  // Global bundle adjustment using Ceres Solver of a copy of the current
+  // reconstruction in a background thread, while images continue to be
+  // registered in the reconstruction. Only one asynchronous adjustment can be
+  // pending at a time and the other global bundle adjustment methods must not
+  // be called while it is pending.
+  void BeginAsyncGlobalBundle(const Options& options,
+                              const BundleAdjustmentOptions& ba_options);
+
+  // Whether an asynchronous global bundle adjustment was started but not yet
+  // ended and whether its computation has finished.
+  bool IsAsyncGlobalBundlePending() const;
+  bool IsAsyncGlobalBundleFinished() const;
+
+  // Wait for the pending asynchronous global bundle adjustment and transfer
+  // the refinement to the reconstruction. The cameras, images, and 3D points
+  // of the copy are updated by their change in the adjustment, such that
+  // concurrent refinements by local bundle adjustment are preserved. Images
+  // and 3D points that were added since the copy remain unchanged and removed
+  // ones are ignored.
+  bool EndAsyncGlobalBundle();
+
   // Filter images and point observations.
   size_t FilterImages(const Options& options);
   size_t FilterPoints(const Options& options);
@@ -260,6 +293,9 @@ class IncrementalMapper {
                                       const image_t image_id1,
                                       const image_t image_id2);
 
+  // Configuration of global bundle adjustment for all registered images.
+  BundleAdjustmentConfig CreateGlobalBundleConfig(const Options& options) const;
+
   // Class that holds all necessary data from database in memory.
   const DatabaseCache* database_cache_;
 
@@ -269,6 +305,22 @@ class IncrementalMapper {
   // Class that is responsible for incremental triangulation.
   std::unique_ptr<IncrementalTriangulator> triangulator_;
 
+  // Bundle adjuster that is reused across local bundle adjustments.
+  std::unique_ptr<PersistentBundleAdjuster> local_bundle_adjuster_;
+
+  // State of the asynchronous global bundle adjustment: The adjusted copy of
+  // the reconstruction and its parameters before the adjustment, which are
+  // used to determine the change of the parameters in the adjustment.
+  std::unique_ptr<Reconstruction> async_ba_reconstruction_;
+  std::unordered_map<camera_t, std::vector<double>> async_ba_camera_params_;
+  EIGEN_STL_UMAP(image_t, Eigen::Vector4d) async_ba_qvecs_;
+  std::unordered_map<image_t, Eigen::Vector3d> async_ba_tvecs_;
+  std::unordered_map<point3D_t, Eigen::Vector3d> async_ba_points3D_;
+  ceres::Solver::Summary async_ba_summary_;
+  bool async_ba_print_summary_;
+  std::future<bool> async_ba_success_;
+  std::unique_ptr<ThreadPool> async_ba_thread_pool_;
+
   // Number of images that are registered in at least on reconstruction.
   size_t num_total_reg_images_;
 
@@ -0,0 +1,215 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "sfm/incremental_mapper"
+#include "util/testing.h"
+
+#include "base/database.h"
+#include "base/database_cache.h"
+#include "base/pose.h"
+#include "base/projection.h"
+#include "sfm/incremental_mapper.h"
+#include "util/random.h"
+
+using namespace colmap;
+
+namespace {
+
+// Write a synthetic scene of images along a straight line, which all observe
+// all 3D points without noise, and all pairwise matches to the database.
+void CreateDatabase(const size_t num_images, const size_t num_points3D,
+                    Database* database) {
+  SetPRNGSeed(0);
+
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_RADIAL", 1000, 2000, 2000);
+  camera.SetPriorFocalLength(true);
+  camera.SetCameraId(database->WriteCamera(camera));
+
+  std::vector<Eigen::Vector3d> points3D(num_points3D);
+  for (auto& point3D : points3D) {
+    point3D = Eigen::Vector3d(RandomReal(0.0, num_images - 1.0),
+                              RandomReal(-2.0, 2.0), RandomReal(8.0, 12.0));
+  }
+
+  for (size_t i = 0; i < num_images; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(camera.CameraId());
+    image.Qvec() = ComposeIdentityQuaternion();
+    image.Tvec() = Eigen::Vector3d(-static_cast<double>(i), 0, 0);
+    image.SetImageId(database->WriteImage(image));
+
+    FeatureKeypoints keypoints;
+    for (const auto& point3D : points3D) {
+      const Eigen::Vector2d point2D =
+          ProjectPointToImage(point3D, image.ProjectionMatrix(), camera);
+      keypoints.emplace_back(point2D.x(), point2D.y());
+    }
+    database->WriteKeypoints(image.ImageId(), keypoints);
+  }
+
+  FeatureMatches matches;
+  for (size_t i = 0; i < num_points3D; ++i) {
+    matches.emplace_back(i, i);
+  }
+
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::CALIBRATED;
+  two_view_geometry.inlier_matches = matches;
+  for (image_t image_id1 = 1; image_id1 <= num_images; ++image_id1) {
+    for (image_t image_id2 = image_id1 + 1; image_id2 <= num_images;
+         ++image_id2) {
+      database->WriteMatches(image_id1, image_id2, matches);
+      database->WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+    }
+  }
+}
+
+// Mean reprojection error of all observations except for the given image.
+double ComputeMeanReprojectionError(const Reconstruction& reconstruction,
+                                    const image_t ignored_image_id) {
+  double error_sum = 0;
+  size_t num_observations = 0;
+  for (const auto& point3D : reconstruction.Points3D()) {
+    for (const auto& track_el : point3D.second.Track().Elements()) {
+      if (track_el.image_id == ignored_image_id) {
+        continue;
+      }
+      const Image& image = reconstruction.Image(track_el.image_id);
+      const Camera& camera = reconstruction.Camera(image.CameraId());
+      error_sum += std::sqrt(CalculateSquaredReprojectionError(
+          image.Point2D(track_el.point2D_idx).XY(), point3D.second.XYZ(),
+          image.Qvec(), image.Tvec(), camera));
+      num_observations += 1;
+    }
+  }
+  return num_observations == 0 ? 0 : error_sum / num_observations;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestAsyncGlobalBundle) {
+  const size_t kNumImages = 8;
+  const size_t kNumPoints3D = 200;
+
+  Database database(":memory:");
+  CreateDatabase(kNumImages, kNumPoints3D, &database);
+
+  DatabaseCache database_cache;
+  database_cache.Load(database, 15, true, {});
+
+  IncrementalMapper::Options options;
+  IncrementalTriangulator::Options tri_options;
+  BundleAdjustmentOptions ba_options;
+  ba_options.print_summary = false;
+
+  Reconstruction reconstruction;
+  IncrementalMapper mapper(&database_cache);
+  mapper.BeginReconstruction(&reconstruction);
+
+  image_t image_id1;
+  image_t image_id2;
+  BOOST_CHECK(mapper.FindInitialImagePair(options, &image_id1, &image_id2));
+  BOOST_CHECK(mapper.RegisterInitialImagePair(options, image_id1, image_id2));
+  mapper.TriangulateImage(tri_options, image_id1);
+  mapper.TriangulateImage(tri_options, image_id2);
+
+  // Register all but one image, which is registered during the adjustment.
+  image_t new_image_id = kInvalidImageId;
+  for (image_t image_id = 1; image_id <= kNumImages; ++image_id) {
+    if (reconstruction.IsImageRegistered(image_id)) {
+      continue;
+    } else if (new_image_id == kInvalidImageId) {
+      new_image_id = image_id;
+    } else {
+      BOOST_CHECK(mapper.RegisterNextImage(options, image_id));
+      mapper.TriangulateImage(tri_options, image_id);
+    }
+  }
+  BOOST_CHECK_EQUAL(reconstruction.NumRegImages(), kNumImages - 1);
+
+  // Perturb an image and a 3D point, which is corrected by the adjustment. The
+  // first two registered images are constant in global bundle adjustment.
+  const image_t perturbed_image_id = reconstruction.RegImageIds().at(2);
+  reconstruction.Image(perturbed_image_id).Tvec() +=
+      Eigen::Vector3d(0.05, 0.02, 0);
+  const point3D_t perturbed_point3D_id =
+      reconstruction.Points3D().begin()->first;
+  reconstruction.Point3D(perturbed_point3D_id).XYZ() +=
+      Eigen::Vector3d(0.1, -0.1, 0);
+  BOOST_CHECK_GT(ComputeMeanReprojectionError(reconstruction, kInvalidImageId),
+                 0.5);
+
+  mapper.BeginAsyncGlobalBundle(options, ba_options);
+  BOOST_CHECK(mapper.IsAsyncGlobalBundlePending());
+
+  // Simulate concurrent refinements while the copy is being adjusted, which
+  // must be preserved when ending the adjustment.
+  BOOST_CHECK(mapper.RegisterNextImage(options, new_image_id));
+  mapper.TriangulateImage(tri_options, new_image_id);
+  const size_t num_new_points3D =
+      reconstruction.Image(new_image_id).NumPoints3D();
+  BOOST_CHECK_GT(num_new_points3D, 0);
+
+  const image_t rotated_image_id = reconstruction.RegImageIds().at(3);
+  const Eigen::Matrix3d delta_rot_mat =
+      Eigen::AngleAxisd(0.05, Eigen::Vector3d::UnitY()).toRotationMatrix();
+  Image& rotated_image = reconstruction.Image(rotated_image_id);
+  const Eigen::Matrix3d rotated_rot_mat =
+      delta_rot_mat * rotated_image.RotationMatrix();
+  rotated_image.Qvec() = RotationMatrixToQuaternion(rotated_rot_mat);
+  rotated_image.Tvec() = delta_rot_mat * rotated_image.Tvec();
+
+  BOOST_CHECK(mapper.EndAsyncGlobalBundle());
+  BOOST_CHECK(!mapper.IsAsyncGlobalBundlePending());
+
+  // The new image is neither removed nor changed by the adjustment.
+  BOOST_CHECK(reconstruction.IsImageRegistered(new_image_id));
+  BOOST_CHECK_EQUAL(reconstruction.NumRegImages(), kNumImages);
+  BOOST_CHECK_EQUAL(reconstruction.Image(new_image_id).NumPoints3D(),
+                    num_new_points3D);
+
+  // The adjustment of the exact scene recovers the rotation of the unperturbed
+  // image, so the concurrent rotation is applied on top of it. Normalizing
+  // the reconstruction only scales and translates it.
+  BOOST_CHECK_LT((reconstruction.Image(rotated_image_id).RotationMatrix() -
+                  rotated_rot_mat)
+                     .norm(),
+                 1e-3);
+
+  // The perturbations are corrected and the new image is consistent with the
+  // adjusted reconstruction.
+  BOOST_CHECK_LT(ComputeMeanReprojectionError(reconstruction, rotated_image_id),
+                 0.1);
+
+  mapper.EndReconstruction(false);
+}
@@ -68,9 +68,8 @@ float PointColormapBase::AdjustScale(const float gray) {
 
 void PointColormapPhotometric::Prepare(EIGEN_STL_UMAP(camera_t, Camera) &
                                            cameras,
-                                       EIGEN_STL_UMAP(image_t, Image) & images,
-                                       EIGEN_STL_UMAP(point3D_t, Point3D) &
-                                           points3D,
+                                       Reconstruction::ImageMap& images,
+                                       Reconstruction::Point3DMap& points3D,
                                        std::vector<image_t>& reg_image_ids) {}
 
 Eigen::Vector4f PointColormapPhotometric::ComputeColor(
@@ -80,8 +79,8 @@ Eigen::Vector4f PointColormapPhotometric::ComputeColor(
 }
 
 void PointColormapError::Prepare(EIGEN_STL_UMAP(camera_t, Camera) & cameras,
-                                 EIGEN_STL_UMAP(image_t, Image) & images,
-                                 EIGEN_STL_UMAP(point3D_t, Point3D) & points3D,
+                                 Reconstruction::ImageMap& images,
+                                 Reconstruction::Point3DMap& points3D,
                                  std::vector<image_t>& reg_image_ids) {
   std::vector<float> errors;
   errors.reserve(points3D.size());
@@ -101,9 +100,8 @@ Eigen::Vector4f PointColormapError::ComputeColor(const point3D_t point3D_id,
 }
 
 void PointColormapTrackLen::Prepare(EIGEN_STL_UMAP(camera_t, Camera) & cameras,
-                                    EIGEN_STL_UMAP(image_t, Image) & images,
-                                    EIGEN_STL_UMAP(point3D_t, Point3D) &
-                                        points3D,
+                                    Reconstruction::ImageMap& images,
+                                    Reconstruction::Point3DMap& points3D,
                                     std::vector<image_t>& reg_image_ids) {
   std::vector<float> track_lengths;
   track_lengths.reserve(points3D.size());
@@ -124,8 +122,8 @@ Eigen::Vector4f PointColormapTrackLen::ComputeColor(const point3D_t point3D_id,
 
 void PointColormapGroundResolution::Prepare(
     EIGEN_STL_UMAP(camera_t, Camera) & cameras,
-    EIGEN_STL_UMAP(image_t, Image) & images,
-    EIGEN_STL_UMAP(point3D_t, Point3D) & points3D,
+    Reconstruction::ImageMap& images,
+    Reconstruction::Point3DMap& points3D,
     std::vector<image_t>& reg_image_ids) {
   std::vector<float> resolutions;
   resolutions.reserve(points3D.size());
@@ -211,9 +209,8 @@ const Eigen::Vector4f ImageColormapBase::kDefaultFrameColor = {0.8f, 0.1f, 0.0f,
 ImageColormapBase::ImageColormapBase() {}
 
 void ImageColormapUniform::Prepare(EIGEN_STL_UMAP(camera_t, Camera) & cameras,
-                                   EIGEN_STL_UMAP(image_t, Image) & images,
-                                   EIGEN_STL_UMAP(point3D_t, Point3D) &
-                                       points3D,
+                                   Reconstruction::ImageMap& images,
+                                   Reconstruction::Point3DMap& points3D,
                                    std::vector<image_t>& reg_image_ids) {}
 
 void ImageColormapUniform::ComputeColor(const Image& image,
@@ -225,9 +222,8 @@ void ImageColormapUniform::ComputeColor(const Image& image,
 
 void ImageColormapNameFilter::Prepare(EIGEN_STL_UMAP(camera_t, Camera) &
                                           cameras,
-                                      EIGEN_STL_UMAP(image_t, Image) & images,
-                                      EIGEN_STL_UMAP(point3D_t, Point3D) &
-                                          points3D,
+                                      Reconstruction::ImageMap& images,
+                                      Reconstruction::Point3DMap& points3D,
                                       std::vector<image_t>& reg_image_ids) {}
 
 void ImageColormapNameFilter::AddColorForWord(
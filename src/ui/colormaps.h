@@ -47,8 +47,8 @@ class PointColormapBase {
   virtual ~PointColormapBase() = default;
 
   virtual void Prepare(EIGEN_STL_UMAP(camera_t, Camera) & cameras,
-                       EIGEN_STL_UMAP(image_t, Image) & images,
-                       EIGEN_STL_UMAP(point3D_t, Point3D) & points3D,
+                       Reconstruction::ImageMap& images,
+                       Reconstruction::Point3DMap& points3D,
                        std::vector<image_t>& reg_image_ids) = 0;
 
   virtual Eigen::Vector4f ComputeColor(const point3D_t point3D_id,
@@ -69,8 +69,8 @@ class PointColormapBase {
 class PointColormapPhotometric : public PointColormapBase {
  public:
   void Prepare(EIGEN_STL_UMAP(camera_t, Camera) & cameras,
-               EIGEN_STL_UMAP(image_t, Image) & images,
-               EIGEN_STL_UMAP(point3D_t, Point3D) & points3D,
+               Reconstruction::ImageMap& images,
+               Reconstruction::Point3DMap& points3D,
                std::vector<image_t>& reg_image_ids) override;
 
   Eigen::Vector4f ComputeColor(const point3D_t point3D_id,
@@ -81,8 +81,8 @@ class PointColormapPhotometric : public PointColormapBase {
 class PointColormapError : public PointColormapBase {
  public:
   void Prepare(EIGEN_STL_UMAP(camera_t, Camera) & cameras,
-               EIGEN_STL_UMAP(image_t, Image) & images,
-               EIGEN_STL_UMAP(point3D_t, Point3D) & points3D,
+               Reconstruction::ImageMap& images,
+               Reconstruction::Point3DMap& points3D,
                std::vector<image_t>& reg_image_ids) override;
 
   Eigen::Vector4f ComputeColor(const point3D_t point3D_id,
@@ -93,8 +93,8 @@ class PointColormapError : public PointColormapBase {
 class PointColormapTrackLen : public PointColormapBase {
  public:
   void Prepare(EIGEN_STL_UMAP(camera_t, Camera) & cameras,
-               EIGEN_STL_UMAP(image_t, Image) & images,
-               EIGEN_STL_UMAP(point3D_t, Point3D) & points3D,
+               Reconstruction::ImageMap& images,
+               Reconstruction::Point3DMap& points3D,
                std::vector<image_t>& reg_image_ids) override;
 
   Eigen::Vector4f ComputeColor(const point3D_t point3D_id,
@@ -105,8 +105,8 @@ class PointColormapTrackLen : public PointColormapBase {
 class PointColormapGroundResolution : public PointColormapBase {
  public:
   void Prepare(EIGEN_STL_UMAP(camera_t, Camera) & cameras,
-               EIGEN_STL_UMAP(image_t, Image) & images,
-               EIGEN_STL_UMAP(point3D_t, Point3D) & points3D,
+               Reconstruction::ImageMap& images,
+               Reconstruction::Point3DMap& points3D,
                std::vector<image_t>& reg_image_ids) override;
 
   Eigen::Vector4f ComputeColor(const point3D_t point3D_id,
@@ -123,8 +123,8 @@ class ImageColormapBase {
   virtual ~ImageColormapBase() = default;
 
   virtual void Prepare(EIGEN_STL_UMAP(camera_t, Camera) & cameras,
-                       EIGEN_STL_UMAP(image_t, Image) & images,
-                       EIGEN_STL_UMAP(point3D_t, Point3D) & points3D,
+                       Reconstruction::ImageMap& images,
+                       Reconstruction::Point3DMap& points3D,
                        std::vector<image_t>& reg_image_ids) = 0;
 
   virtual void ComputeColor(const Image& image, Eigen::Vector4f* plane_color,
@@ -138,8 +138,8 @@ class ImageColormapBase {
 class ImageColormapUniform : public ImageColormapBase {
  public:
   void Prepare(EIGEN_STL_UMAP(camera_t, Camera) & cameras,
-               EIGEN_STL_UMAP(image_t, Image) & images,
-               EIGEN_STL_UMAP(point3D_t, Point3D) & points3D,
+               Reconstruction::ImageMap& images,
+               Reconstruction::Point3DMap& points3D,
                std::vector<image_t>& reg_image_ids) override;
 
   void ComputeColor(const Image& image, Eigen::Vector4f* plane_color,
@@ -153,8 +153,8 @@ class ImageColormapUniform : public ImageColormapBase {
 class ImageColormapNameFilter : public ImageColormapBase {
  public:
   void Prepare(EIGEN_STL_UMAP(camera_t, Camera) & cameras,
-               EIGEN_STL_UMAP(image_t, Image) & images,
-               EIGEN_STL_UMAP(point3D_t, Point3D) & points3D,
+               Reconstruction::ImageMap& images,
+               Reconstruction::Point3DMap& points3D,
                std::vector<image_t>& reg_image_ids) override;
 
   void AddColorForWord(const std::string& word,
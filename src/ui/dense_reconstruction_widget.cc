@@ -55,6 +55,9 @@ class StereoOptionsTab : public OptionsWidget {
 
     AddOptionInt(&options->patch_match_stereo->max_image_size, "max_image_size",
                  -1);
+    AddOptionBool(&options->patch_match_stereo->use_gpu, "use_gpu");
+    AddOptionInt(&options->patch_match_stereo->num_threads, "num_threads",
+                 -1);
     AddOptionText(&options->patch_match_stereo->gpu_index, "gpu_index");
     AddOptionDouble(&options->patch_match_stereo->depth_min, "depth_min", -1);
     AddOptionDouble(&options->patch_match_stereo->depth_max, "depth_max", -1);
@@ -116,6 +119,7 @@ class FusionOptionsTab : public OptionsWidget {
     AddOptionDouble(&options->stereo_fusion->cache_size,
                     "cache_size [gigabytes]", 0,
                     std::numeric_limits<double>::max(), 0.1, 1);
+    AddOptionInt(&options->stereo_fusion->num_threads, "num_threads", -1);
   }
 };
 
@@ -336,17 +340,11 @@ void DenseReconstructionWidget::Stereo() {
     return;
   }
 
-#ifdef CUDA_ENABLED
   mvs::PatchMatchController* processor = new mvs::PatchMatchController(
       *options_->patch_match_stereo, workspace_path, "COLMAP", "");
   processor->AddCallback(Thread::FINISHED_CALLBACK,
                          [this]() { refresh_workspace_action_->trigger(); });
   thread_control_widget_->StartThread("Stereo...", true, processor);
-#else
-  QMessageBox::critical(this, "",
-                        tr("Dense stereo reconstruction requires CUDA, which "
-                           "is not available on your system."));
-#endif
 }
 
 void DenseReconstructionWidget::Fusion() {
@@ -116,6 +116,9 @@ void FeatureMatchingTab::CreateGeneralOptions() {
                                    "max_distance");
   options_widget_->AddOptionBool(&options_->sift_matching->cross_check,
                                  "cross_check");
+  options_widget_->AddOptionBool(
+      &options_->sift_matching->cpu_brute_force_matcher,
+      "cpu_brute_force_matcher");
   options_widget_->AddOptionInt(&options_->sift_matching->max_num_matches,
                                 "max_num_matches");
   options_widget_->AddOptionDouble(&options_->sift_matching->max_error,
@@ -132,6 +135,8 @@ void FeatureMatchingTab::CreateGeneralOptions() {
                                  "multiple_models");
   options_widget_->AddOptionBool(&options_->sift_matching->guided_matching,
                                  "guided_matching");
+  options_widget_->AddOptionInt(&options_->sift_matching->write_batch_size,
+                                "write_batch_size", 1);
 
   options_widget_->AddSpacer();
 
@@ -256,6 +261,9 @@ SpatialMatchingTab::SpatialMatchingTab(QWidget* parent, OptionManager* options)
                                 "max_num_neighbors");
   options_widget_->AddOptionDouble(&options_->spatial_matching->max_distance,
                                    "max_distance");
+  options_widget_->AddOptionDouble(
+      &options_->spatial_matching->max_viewing_angle, "max_viewing_angle", 0,
+      180);
 
   CreateGeneralOptions();
 }
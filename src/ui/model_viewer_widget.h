@@ -124,8 +124,8 @@ class ModelViewerWidget : public QOpenGLWidget,
   // Copy of current scene data that is displayed
   Reconstruction* reconstruction = nullptr;
   EIGEN_STL_UMAP(camera_t, Camera) cameras;
-  EIGEN_STL_UMAP(image_t, Image) images;
-  EIGEN_STL_UMAP(point3D_t, Point3D) points3D;
+  Reconstruction::ImageMap images;
+  Reconstruction::Point3DMap points3D;
   std::vector<image_t> reg_image_ids;
 
   QLabel* statusbar_status_label;
@@ -44,6 +44,8 @@ MapperGeneralOptionsWidget::MapperGeneralOptionsWidget(QWidget* parent,
   AddOptionInt(&options->mapper->min_model_size, "min_model_size");
   AddOptionBool(&options->mapper->extract_colors, "extract_colors");
   AddOptionInt(&options->mapper->num_threads, "num_threads", -1);
+  AddOptionInt(&options->mapper->abs_pose_ransac_num_threads,
+               "abs_pose_ransac_num_threads", -1);
   AddOptionInt(&options->mapper->min_num_matches, "min_num_matches");
   AddOptionBool(&options->mapper->ignore_watermarks, "ignore_watermarks");
   AddOptionDirPath(&options->mapper->snapshot_path, "snapshot_path");
@@ -122,6 +124,7 @@ MapperBundleAdjustmentOptionsWidget::MapperBundleAdjustmentOptionsWidget(
   AddOptionInt(&options->mapper->ba_local_num_images, "num_images");
   AddOptionInt(&options->mapper->ba_local_max_num_iterations,
                "max_num_iterations");
+  AddOptionBool(&options->mapper->ba_local_reuse_problem, "reuse_problem");
   AddOptionInt(&options->mapper->ba_local_max_refinements, "max_refinements",
                1);
   AddOptionDouble(&options->mapper->ba_local_max_refinement_change,
@@ -139,6 +142,7 @@ MapperBundleAdjustmentOptionsWidget::MapperBundleAdjustmentOptionsWidget(
   AddOptionInt(&options->mapper->ba_global_max_num_iterations,
                "max_num_iterations");
   AddOptionInt(&options->mapper->ba_global_pba_gpu_index, "pba_gpu_index", -1);
+  AddOptionBool(&options->mapper->ba_global_async, "async");
   AddOptionInt(&options->mapper->ba_global_max_refinements, "max_refinements",
                1);
   AddOptionDouble(&options->mapper->ba_global_max_refinement_change,
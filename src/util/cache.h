@@ -32,9 +32,15 @@
 #ifndef COLMAP_SRC_UTIL_CACHE_H_
 #define COLMAP_SRC_UTIL_CACHE_H_
 
+#include <algorithm>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include "util/logging.h"
 
@@ -119,6 +125,58 @@ class MemoryConstrainedLRUCache : public LRUCache<key_t, value_t> {
   std::unordered_map<key_t, size_t> elems_num_bytes_;
 };
 
+// Thread-safe Least Recently Used cache that hands out shared handles to
+// immutable values. The keys are distributed over a number of independently
+// locked LRU shards, such that concurrent lookups of different keys rarely
+// contend on the same lock. The getter function is called without holding any
+// shard lock, so misses of different keys are computed concurrently, while
+// concurrent misses of the same key wait for a single computation. Since the
+// values are reference counted, eviction never invalidates a value that is
+// still used by a caller. The least recently used order is maintained per
+// shard, i.e. the maximum number of elements is split evenly over the shards.
+template <typename key_t, typename value_t>
+class ShardedLRUCache {
+ public:
+  typedef std::shared_ptr<const value_t> value_ptr_t;
+
+  ShardedLRUCache(const size_t max_num_elems, const size_t num_shards,
+                  const std::function<value_ptr_t(const key_t&)>& getter_func);
+
+  // The number of elements in the cache.
+  size_t NumElems() const;
+  size_t MaxNumElems() const;
+  size_t NumShards() const;
+
+  // Check whether the element with the given key exists.
+  bool Exists(const key_t& key) const;
+
+  // Get the value of an element either from the cache or compute the new value.
+  // Exceptions of the getter function are passed on to all threads waiting for
+  // the same value and the value is not cached.
+  value_ptr_t Get(const key_t& key);
+
+  // Manually set the value of an element.
+  void Set(const key_t& key, const value_ptr_t& value);
+
+  // Clear all elements from cache.
+  void Clear();
+
+ private:
+  struct Shard {
+    mutable std::mutex mutex;
+    std::unique_ptr<LRUCache<key_t, value_ptr_t>> cache;
+    // Values that are currently computed by the getter function.
+    std::unordered_map<key_t, std::shared_future<value_ptr_t>> pending;
+  };
+
+  Shard& GetShard(const key_t& key);
+  const Shard& GetShard(const key_t& key) const;
+
+  const size_t max_num_elems_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  const std::function<value_ptr_t(const key_t&)> getter_func_;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -268,6 +326,128 @@ void MemoryConstrainedLRUCache<key_t, value_t>::Clear() {
   elems_num_bytes_.clear();
 }
 
+template <typename key_t, typename value_t>
+ShardedLRUCache<key_t, value_t>::ShardedLRUCache(
+    const size_t max_num_elems, const size_t num_shards,
+    const std::function<value_ptr_t(const key_t&)>& getter_func)
+    : max_num_elems_(max_num_elems), getter_func_(getter_func) {
+  CHECK(getter_func);
+  CHECK_GT(max_num_elems, 0);
+  CHECK_GT(num_shards, 0);
+
+  const size_t num_effective_shards = std::min(num_shards, max_num_elems);
+  const size_t max_num_shard_elems =
+      (max_num_elems + num_effective_shards - 1) / num_effective_shards;
+
+  shards_.reserve(num_effective_shards);
+  for (size_t i = 0; i < num_effective_shards; ++i) {
+    shards_.emplace_back(new Shard());
+    // Values are only inserted through `Set`, so the getter is never called.
+    shards_.back()->cache.reset(new LRUCache<key_t, value_ptr_t>(
+        max_num_shard_elems, [](const key_t&) { return value_ptr_t(); }));
+  }
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::NumElems() const {
+  size_t num_elems = 0;
+  for (const auto& shard : shards_) {
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    num_elems += shard->cache->NumElems();
+  }
+  return num_elems;
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::MaxNumElems() const {
+  return max_num_elems_;
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::NumShards() const {
+  return shards_.size();
+}
+
+template <typename key_t, typename value_t>
+bool ShardedLRUCache<key_t, value_t>::Exists(const key_t& key) const {
+  const Shard& shard = GetShard(key);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+  return shard.cache->Exists(key);
+}
+
+template <typename key_t, typename value_t>
+typename ShardedLRUCache<key_t, value_t>::value_ptr_t
+ShardedLRUCache<key_t, value_t>::Get(const key_t& key) {
+  Shard& shard = GetShard(key);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+
+  if (shard.cache->Exists(key)) {
+    return shard.cache->Get(key);
+  }
+
+  // Another thread is already computing the value, wait for its result.
+  const auto pending_it = shard.pending.find(key);
+  if (pending_it != shard.pending.end()) {
+    const std::shared_future<value_ptr_t> future = pending_it->second;
+    lock.unlock();
+    return future.get();
+  }
+
+  std::promise<value_ptr_t> promise;
+  shard.pending.emplace(key, promise.get_future().share());
+  lock.unlock();
+
+  value_ptr_t value;
+  try {
+    value = getter_func_(key);
+  } catch (...) {
+    lock.lock();
+    shard.pending.erase(key);
+    lock.unlock();
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+
+  lock.lock();
+  value_ptr_t cached_value = value;
+  shard.cache->Set(key, std::move(cached_value));
+  shard.pending.erase(key);
+  lock.unlock();
+
+  promise.set_value(value);
+
+  return value;
+}
+
+template <typename key_t, typename value_t>
+void ShardedLRUCache<key_t, value_t>::Set(const key_t& key,
+                                          const value_ptr_t& value) {
+  Shard& shard = GetShard(key);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+  value_ptr_t cached_value = value;
+  shard.cache->Set(key, std::move(cached_value));
+}
+
+template <typename key_t, typename value_t>
+void ShardedLRUCache<key_t, value_t>::Clear() {
+  for (auto& shard : shards_) {
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    shard->cache->Clear();
+  }
+}
+
+template <typename key_t, typename value_t>
+typename ShardedLRUCache<key_t, value_t>::Shard&
+ShardedLRUCache<key_t, value_t>::GetShard(const key_t& key) {
+  return *shards_[std::hash<key_t>()(key) % shards_.size()];
+}
+
+template <typename key_t, typename value_t>
+const typename ShardedLRUCache<key_t, value_t>::Shard&
+ShardedLRUCache<key_t, value_t>::GetShard(const key_t& key) const {
+  return *shards_[std::hash<key_t>()(key) % shards_.size()];
+}
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_UTIL_CACHE_H_
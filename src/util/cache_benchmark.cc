@@ -0,0 +1,164 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util/cache.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/random.h"
+#include "util/timer.h"
+
+using namespace colmap;
+
+namespace {
+
+// Value similar in size to the SIFT descriptors of an image.
+typedef std::vector<uint8_t> Value;
+
+const size_t kValueSize = 128 * 2000;
+
+// Simulates a database read, which is serialized on the database connection.
+Value ReadValue(std::mutex* database_mutex, const int key) {
+  std::unique_lock<std::mutex> lock(*database_mutex);
+  return Value(kValueSize, static_cast<uint8_t>(key));
+}
+
+// Random sequence of keys, where most accesses hit a small working set of
+// images, as for the image pairs of sequential or vocabulary tree matching.
+std::vector<int> CreateKeys(const size_t num_accesses, const int num_keys) {
+  std::vector<int> keys(num_accesses);
+  for (auto& key : keys) {
+    if (RandomReal(0.0, 1.0) < 0.9) {
+      key = RandomInteger(0, num_keys / 10);
+    } else {
+      key = RandomInteger(0, num_keys - 1);
+    }
+  }
+  return keys;
+}
+
+template <typename Func>
+double RunThreads(const int num_threads,
+                  const std::vector<std::vector<int>>& keys, Func func) {
+  Timer timer;
+  timer.Start();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back([&, i]() {
+      size_t checksum = 0;
+      for (const int key : keys[i]) {
+        checksum += func(key);
+      }
+      CHECK_GT(checksum, 0);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return timer.ElapsedSeconds();
+}
+
+// The previous scheme of the feature matcher cache, where every access locks
+// the database mutex and returns a copy of the cached value.
+double BenchmarkGlobalLock(const int num_threads, const size_t cache_size,
+                           const std::vector<std::vector<int>>& keys) {
+  std::mutex database_mutex;
+  LRUCache<int, Value> cache(cache_size, [&](const int key) {
+    return ReadValue(&database_mutex, key);
+  });
+  std::mutex cache_mutex;
+  return RunThreads(num_threads, keys, [&](const int key) {
+    Value value;
+    {
+      std::unique_lock<std::mutex> lock(cache_mutex);
+      value = cache.Get(key);
+    }
+    return static_cast<size_t>(value[0]) + 1;
+  });
+}
+
+double BenchmarkSharded(const int num_threads, const size_t cache_size,
+                        const size_t num_shards,
+                        const std::vector<std::vector<int>>& keys) {
+  std::mutex database_mutex;
+  ShardedLRUCache<int, Value> cache(
+      cache_size, num_shards, [&](const int key) {
+        return std::make_shared<const Value>(ReadValue(&database_mutex, key));
+      });
+  return RunThreads(num_threads, keys, [&](const int key) {
+    const auto value = cache.Get(key);
+    return static_cast<size_t>((*value)[0]) + 1;
+  });
+}
+
+}  // namespace
+
+// Benchmark of concurrent cache accesses by the feature matching threads,
+// comparing a single lock around the cache against the sharded cache with
+// shared value handles.
+int main(int argc, char** argv) {
+  InitializeGlog(argv);
+
+  const int kNumKeys = 2000;
+  const size_t kCacheSize = 500;
+  const size_t kNumAccessesPerThread = 20000;
+
+  SetPRNGSeed(0);
+
+  std::cout << StringPrintf("%10s %12s %12s %12s", "threads", "global_lock",
+                            "sharded_1", "sharded_16")
+            << std::endl;
+
+  for (const int num_threads : {1, 2, 4, 8, 16, 32}) {
+    std::vector<std::vector<int>> keys(num_threads);
+    for (auto& thread_keys : keys) {
+      thread_keys = CreateKeys(kNumAccessesPerThread, kNumKeys);
+    }
+
+    const double global_lock_time =
+        BenchmarkGlobalLock(num_threads, kCacheSize, keys);
+    const double sharded_1_time =
+        BenchmarkSharded(num_threads, kCacheSize, 1, keys);
+    const double sharded_16_time =
+        BenchmarkSharded(num_threads, kCacheSize, 16, keys);
+
+    std::cout << StringPrintf("%10d %11.4fs %11.4fs %11.4fs", num_threads,
+                              global_lock_time, sharded_1_time,
+                              sharded_16_time)
+              << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -32,6 +32,10 @@
 #define TEST_NAME "util/cache"
 #include "util/testing.h"
 
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
 #include "util/cache.h"
 
 using namespace colmap;
@@ -271,3 +275,117 @@ BOOST_AUTO_TEST_CASE(TestMemoryConstrainedLRUCacheUpdateNumBytes) {
   BOOST_CHECK_EQUAL(cache.Get(2).NumBytes(), 2);
   BOOST_CHECK_EQUAL(cache.NumBytes(), 2);
 }
+
+BOOST_AUTO_TEST_CASE(TestShardedLRUCacheEmpty) {
+  ShardedLRUCache<int, int> cache(
+      8, 4, [](const int key) { return std::make_shared<const int>(key); });
+  BOOST_CHECK_EQUAL(cache.NumElems(), 0);
+  BOOST_CHECK_EQUAL(cache.MaxNumElems(), 8);
+  BOOST_CHECK_EQUAL(cache.NumShards(), 4);
+
+  ShardedLRUCache<int, int> small_cache(
+      2, 4, [](const int key) { return std::make_shared<const int>(key); });
+  BOOST_CHECK_EQUAL(small_cache.NumShards(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedLRUCacheGet) {
+  int num_getter_calls = 0;
+  ShardedLRUCache<int, int> cache(4, 2, [&](const int key) {
+    num_getter_calls += 1;
+    return std::make_shared<const int>(key);
+  });
+
+  for (int i = 0; i < 4; ++i) {
+    BOOST_CHECK_EQUAL(*cache.Get(i), i);
+    BOOST_CHECK_EQUAL(cache.NumElems(), i + 1);
+    BOOST_CHECK(cache.Exists(i));
+  }
+  BOOST_CHECK_EQUAL(num_getter_calls, 4);
+
+  BOOST_CHECK_EQUAL(*cache.Get(2), 2);
+  BOOST_CHECK_EQUAL(num_getter_calls, 4);
+
+  // Keys 0 and 2 share a shard, so 0 is the least recently used one.
+  BOOST_CHECK_EQUAL(*cache.Get(4), 4);
+  BOOST_CHECK_EQUAL(cache.NumElems(), 4);
+  BOOST_CHECK(!cache.Exists(0));
+  BOOST_CHECK(cache.Exists(1));
+  BOOST_CHECK(cache.Exists(2));
+  BOOST_CHECK(cache.Exists(4));
+
+  cache.Set(0, std::make_shared<const int>(10));
+  BOOST_CHECK_EQUAL(*cache.Get(0), 10);
+  BOOST_CHECK(!cache.Exists(2));
+
+  cache.Clear();
+  BOOST_CHECK_EQUAL(cache.NumElems(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedLRUCacheEvictionKeepsValue) {
+  ShardedLRUCache<int, int> cache(
+      1, 1, [](const int key) { return std::make_shared<const int>(key); });
+  const auto value = cache.Get(0);
+  BOOST_CHECK_EQUAL(*cache.Get(1), 1);
+  BOOST_CHECK(!cache.Exists(0));
+  BOOST_CHECK_EQUAL(*value, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedLRUCacheConcurrentGet) {
+  const int kNumKeys = 100;
+  std::atomic<int> num_getter_calls(0);
+  ShardedLRUCache<int, int> cache(kNumKeys, 8, [&](const int key) {
+    num_getter_calls += 1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return std::make_shared<const int>(key);
+  });
+
+  std::vector<std::thread> threads;
+  std::atomic<int> num_errors(0);
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&]() {
+      for (int key = 0; key < kNumKeys; ++key) {
+        if (*cache.Get(key) != key) {
+          num_errors += 1;
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  BOOST_CHECK_EQUAL(num_errors, 0);
+  BOOST_CHECK_EQUAL(num_getter_calls, kNumKeys);
+  BOOST_CHECK_EQUAL(cache.NumElems(), kNumKeys);
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedLRUCacheGetterException) {
+  std::atomic<int> num_getter_calls(0);
+  ShardedLRUCache<int, int> cache(2, 1, [&](const int key) {
+    if (num_getter_calls++ == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      throw std::runtime_error("Failed to get value");
+    }
+    return std::make_shared<const int>(key);
+  });
+
+  // A thread waiting for the failed value must not block forever.
+  std::atomic<int> num_waiter_values(0);
+  std::thread waiter([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    try {
+      if (*cache.Get(0) == 0) {
+        num_waiter_values += 1;
+      }
+    } catch (const std::runtime_error&) {
+    }
+  });
+
+  BOOST_CHECK_THROW(cache.Get(0), std::runtime_error);
+  waiter.join();
+  BOOST_CHECK(!cache.Exists(0) || num_waiter_values == 1);
+
+  BOOST_CHECK_EQUAL(*cache.Get(0), 0);
+  BOOST_CHECK(cache.Exists(0));
+}
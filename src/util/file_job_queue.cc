@@ -0,0 +1,212 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include "util/file_job_queue.h"
+
+#include <algorithm>
+#include <ctime>
+
+#include <boost/filesystem.hpp>
+
+#include "util/logging.h"
+#include "util/misc.h"
+
+namespace colmap {
+namespace {
+
+const std::string kOutputDirName = "output";
+
+const std::vector<FileJobQueue::JobStatus> kJobStatuses = {
+    FileJobQueue::JobStatus::CREATED, FileJobQueue::JobStatus::PENDING,
+    FileJobQueue::JobStatus::RUNNING, FileJobQueue::JobStatus::FINISHED,
+    FileJobQueue::JobStatus::FAILED};
+
+std::string JobStatusToDirName(const FileJobQueue::JobStatus status) {
+  switch (status) {
+    case FileJobQueue::JobStatus::CREATED:
+      return "created";
+    case FileJobQueue::JobStatus::PENDING:
+      return "pending";
+    case FileJobQueue::JobStatus::RUNNING:
+      return "running";
+    case FileJobQueue::JobStatus::FINISHED:
+      return "finished";
+    case FileJobQueue::JobStatus::FAILED:
+      return "failed";
+  }
+  return "";
+}
+
+}  // namespace
+
+FileJobQueue::FileJobQueue(const std::string& path) : path_(path) {
+  // Multiple processes may concurrently create the same queue.
+  boost::filesystem::create_directories(path_);
+  for (const auto status : kJobStatuses) {
+    boost::filesystem::create_directories(
+        JoinPaths(path_, JobStatusToDirName(status)));
+  }
+  boost::filesystem::create_directories(JoinPaths(path_, kOutputDirName));
+}
+
+std::string FileJobQueue::Create(const std::string& name) {
+  CHECK(!name.empty());
+  CHECK(JobPath(name).empty()) << "Job " << name << " already exists";
+  const std::string job_path = JobPath(name, JobStatus::CREATED);
+  CHECK(boost::filesystem::create_directory(job_path));
+  return job_path;
+}
+
+void FileJobQueue::Push(const std::string& name) {
+  CHECK(Move(name, JobStatus::CREATED, JobStatus::PENDING));
+}
+
+bool FileJobQueue::Pop(std::string* name) {
+  CHECK_NOTNULL(name);
+  // Other consumers may claim any of the pending jobs in the meantime, in
+  // which case renaming fails and the next job is tried. Renaming does not
+  // change the modification time of the job directory, so the lease is
+  // started explicitly.
+  for (const auto& pending_name : Jobs(JobStatus::PENDING)) {
+    if (Move(pending_name, JobStatus::PENDING, JobStatus::RUNNING)) {
+      Renew(pending_name);
+      *name = pending_name;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FileJobQueue::Finish(const std::string& name) {
+  return Move(name, JobStatus::RUNNING, JobStatus::FINISHED);
+}
+
+bool FileJobQueue::Fail(const std::string& name) {
+  return Move(name, JobStatus::RUNNING, JobStatus::FAILED);
+}
+
+std::string FileJobQueue::CreateOutput(const std::string& name) {
+  CHECK(!name.empty());
+  const std::string output_path =
+      JoinPaths(path_, kOutputDirName,
+                name + "." + boost::filesystem::unique_path().string());
+  CHECK(boost::filesystem::create_directory(output_path));
+  return output_path;
+}
+
+bool FileJobQueue::Finish(const std::string& name,
+                          const std::string& output_path,
+                          const std::string& output_name) {
+  CHECK(!output_name.empty());
+  // Renaming fails if the job is no longer running or if another consumer
+  // already moved its output into the job.
+  boost::system::error_code error_code;
+  boost::filesystem::rename(
+      output_path,
+      JoinPaths(JobPath(name, JobStatus::RUNNING), output_name), error_code);
+  if (error_code) {
+    boost::filesystem::remove_all(output_path, error_code);
+    return false;
+  }
+  return Finish(name);
+}
+
+bool FileJobQueue::Renew(const std::string& name) {
+  boost::system::error_code error_code;
+  boost::filesystem::last_write_time(JobPath(name, JobStatus::RUNNING),
+                                     std::time(nullptr), error_code);
+  return !error_code;
+}
+
+double FileJobQueue::LeaseAge(const std::string& name) const {
+  boost::system::error_code error_code;
+  const std::time_t renew_time = boost::filesystem::last_write_time(
+      JobPath(name, JobStatus::RUNNING), error_code);
+  if (error_code) {
+    return -1;
+  }
+  return std::max(0.0, std::difftime(std::time(nullptr), renew_time));
+}
+
+bool FileJobQueue::Requeue(const std::string& name) {
+  return Move(name, JobStatus::RUNNING, JobStatus::PENDING) ||
+         Move(name, JobStatus::FAILED, JobStatus::PENDING);
+}
+
+std::vector<std::string> FileJobQueue::RequeueStale(
+    const double lease_timeout) {
+  CHECK_GT(lease_timeout, 0);
+  // Another process may requeue the same job concurrently, in which case
+  // renaming fails for all but one of them.
+  std::vector<std::string> names;
+  for (const auto& name : Jobs(JobStatus::RUNNING)) {
+    if (LeaseAge(name) > lease_timeout &&
+        Move(name, JobStatus::RUNNING, JobStatus::PENDING)) {
+      names.push_back(name);
+    }
+  }
+  return names;
+}
+
+std::vector<std::string> FileJobQueue::Jobs(const JobStatus status) const {
+  std::vector<std::string> names;
+  for (const auto& job_path :
+       GetDirList(JoinPaths(path_, JobStatusToDirName(status)))) {
+    names.push_back(GetPathBaseName(job_path));
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+std::string FileJobQueue::JobPath(const std::string& name) const {
+  for (const auto status : kJobStatuses) {
+    const std::string job_path = JobPath(name, status);
+    if (ExistsDir(job_path)) {
+      return job_path;
+    }
+  }
+  return "";
+}
+
+std::string FileJobQueue::JobPath(const std::string& name,
+                                  const JobStatus status) const {
+  return JoinPaths(path_, JobStatusToDirName(status), name);
+}
+
+bool FileJobQueue::Move(const std::string& name, const JobStatus from_status,
+                        const JobStatus to_status) {
+  boost::system::error_code error_code;
+  boost::filesystem::rename(JobPath(name, from_status),
+                            JobPath(name, to_status), error_code);
+  return !error_code;
+}
+
+}  // namespace colmap
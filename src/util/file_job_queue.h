@@ -0,0 +1,129 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_UTIL_FILE_JOB_QUEUE_H_
+#define COLMAP_SRC_UTIL_FILE_JOB_QUEUE_H_
+
+#include <string>
+#include <vector>
+
+namespace colmap {
+
+// Job queue backed by a directory, which can be shared between any number of
+// processes, e.g., on different machines with access to the same storage.
+// Every job is a directory, in which the producer stores the job inputs and
+// the consumer the job outputs. Jobs change their status by renaming the job
+// directory between the sub-directories of the queue. Since renaming is
+// atomic, every pending job is claimed by exactly one consumer.
+//
+// A running job is leased to its consumer, which must periodically renew the
+// lease. The lease is the modification time of the job directory, so that
+// jobs of crashed or killed consumers can be detected and requeued by any
+// other process. A consumer may thus lose its job while it is still running,
+// so long-running consumers store their outputs in a private output directory
+// that is only moved into the job when the job is finished.
+class FileJobQueue {
+ public:
+  enum class JobStatus {
+    // The job was created but is not yet visible to consumers.
+    CREATED,
+    PENDING,
+    RUNNING,
+    FINISHED,
+    FAILED,
+  };
+
+  // Open the queue at the given path and create it, if it does not exist.
+  explicit FileJobQueue(const std::string& path);
+
+  // Create the directory of a new job with a unique name and return its path.
+  // The job can be populated before it is pushed to the consumers.
+  std::string Create(const std::string& name);
+
+  // Make a created job visible to the consumers.
+  void Push(const std::string& name);
+
+  // Claim the next pending job in lexicographic order of the job names, mark
+  // it as running, and start its lease. Returns false if there are no pending
+  // jobs left.
+  bool Pop(std::string* name);
+
+  // Mark a running job as finished or failed. Returns false if the job is no
+  // longer running, e.g., because its lease expired and it was requeued.
+  bool Finish(const std::string& name);
+  bool Fail(const std::string& name);
+
+  // Create a private output directory for a job with a unique name and return
+  // its path. The directory is stored inside the queue, so that it can be
+  // atomically moved into the job directory.
+  std::string CreateOutput(const std::string& name);
+
+  // Move the output directory into the running job directory under the given
+  // name and mark the job as finished. Returns false and deletes the output
+  // directory if the job is no longer running or already has an output of the
+  // same name, e.g., because another consumer finished the requeued job.
+  bool Finish(const std::string& name, const std::string& output_path,
+              const std::string& output_name);
+
+  // Renew the lease of a running job. Returns false if the job is no longer
+  // running.
+  bool Renew(const std::string& name);
+
+  // The number of seconds since the lease of a running job was last renewed.
+  // Returns a negative value if the job is not running.
+  double LeaseAge(const std::string& name) const;
+
+  // Move a running or failed job back to the pending jobs, e.g., after its
+  // consumer crashed. Returns false if the job was not running or failed.
+  bool Requeue(const std::string& name);
+
+  // Requeue all running jobs, whose lease was not renewed for the given
+  // number of seconds, and return their names.
+  std::vector<std::string> RequeueStale(const double lease_timeout);
+
+  // The names of all jobs with the given status in lexicographic order.
+  std::vector<std::string> Jobs(const JobStatus status) const;
+
+  // The path of the job directory for the current status of the job. Returns
+  // an empty string if the job does not exist.
+  std::string JobPath(const std::string& name) const;
+
+ private:
+  std::string JobPath(const std::string& name, const JobStatus status) const;
+  bool Move(const std::string& name, const JobStatus from_status,
+            const JobStatus to_status);
+
+  const std::string path_;
+};
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_UTIL_FILE_JOB_QUEUE_H_
@@ -0,0 +1,220 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "util/file_job_queue"
+#include "util/testing.h"
+
+#include <ctime>
+#include <fstream>
+#include <set>
+
+#include <boost/filesystem.hpp>
+
+#include "util/file_job_queue.h"
+#include "util/misc.h"
+#include "util/threading.h"
+
+using namespace colmap;
+
+BOOST_AUTO_TEST_CASE(TestPushPop) {
+  const std::string path = CreateTempPath();
+  FileJobQueue queue(path);
+  BOOST_CHECK(ExistsDir(path));
+
+  std::string name;
+  BOOST_CHECK(!queue.Pop(&name));
+
+  const std::string job_path = queue.Create("job2");
+  BOOST_CHECK(ExistsDir(job_path));
+  BOOST_CHECK_EQUAL(queue.JobPath("job2"), job_path);
+  BOOST_CHECK(queue.JobPath("job1").empty());
+  {
+    std::ofstream file(JoinPaths(job_path, "input.txt"));
+    file << "input";
+  }
+  BOOST_CHECK(!queue.Pop(&name));
+  queue.Push("job2");
+  queue.Create("job1");
+  queue.Push("job1");
+  BOOST_CHECK_EQUAL(queue.Jobs(FileJobQueue::JobStatus::PENDING).size(), 2);
+
+  BOOST_CHECK(queue.Pop(&name));
+  BOOST_CHECK_EQUAL(name, "job1");
+  BOOST_CHECK(queue.Pop(&name));
+  BOOST_CHECK_EQUAL(name, "job2");
+  BOOST_CHECK(!queue.Pop(&name));
+  BOOST_CHECK(ExistsFile(JoinPaths(queue.JobPath("job2"), "input.txt")));
+  BOOST_CHECK_EQUAL(queue.Jobs(FileJobQueue::JobStatus::RUNNING).size(), 2);
+
+  BOOST_CHECK(queue.Finish("job1"));
+  BOOST_CHECK(queue.Fail("job2"));
+  BOOST_CHECK(!queue.Finish("job1"));
+  BOOST_CHECK(!queue.Fail("job2"));
+  BOOST_CHECK_EQUAL(queue.Jobs(FileJobQueue::JobStatus::RUNNING).size(), 0);
+  BOOST_CHECK_EQUAL(queue.Jobs(FileJobQueue::JobStatus::FINISHED).at(0),
+                    "job1");
+  BOOST_CHECK_EQUAL(queue.Jobs(FileJobQueue::JobStatus::FAILED).at(0), "job2");
+
+  BOOST_CHECK(!queue.Requeue("job1"));
+  BOOST_CHECK(queue.Requeue("job2"));
+  BOOST_CHECK(queue.Pop(&name));
+  BOOST_CHECK_EQUAL(name, "job2");
+
+  // The queue state is shared with other instances, e.g., in other processes.
+  FileJobQueue queue2(path);
+  BOOST_CHECK_EQUAL(queue2.Jobs(FileJobQueue::JobStatus::RUNNING).at(0),
+                    "job2");
+
+  boost::filesystem::remove_all(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestLease) {
+  const std::string path = CreateTempPath();
+  FileJobQueue queue(path);
+  for (const std::string name : {"job1", "job2", "job3"}) {
+    queue.Create(name);
+    queue.Push(name);
+  }
+
+  BOOST_CHECK_LT(queue.LeaseAge("job1"), 0);
+
+  std::string name;
+  BOOST_CHECK(queue.Pop(&name));
+  BOOST_CHECK(queue.Pop(&name));
+  BOOST_CHECK_GE(queue.LeaseAge("job1"), 0);
+  BOOST_CHECK_LT(queue.LeaseAge("job1"), 60);
+  BOOST_CHECK(queue.Renew("job1"));
+  BOOST_CHECK(!queue.Renew("job3"));
+
+  // Simulate a consumer of the first job, which stopped renewing its lease.
+  boost::filesystem::last_write_time(queue.JobPath("job1"),
+                                     std::time(nullptr) - 120);
+  BOOST_CHECK_GE(queue.LeaseAge("job1"), 120);
+
+  const std::vector<std::string> stale_names = queue.RequeueStale(60);
+  BOOST_CHECK_EQUAL(stale_names.size(), 1);
+  BOOST_CHECK_EQUAL(stale_names.at(0), "job1");
+  BOOST_CHECK(queue.RequeueStale(60).empty());
+  BOOST_CHECK_EQUAL(queue.Jobs(FileJobQueue::JobStatus::RUNNING).at(0),
+                    "job2");
+
+  // The crashed consumer can no longer finish the requeued job.
+  BOOST_CHECK(!queue.Finish("job1"));
+  BOOST_CHECK(queue.Pop(&name));
+  BOOST_CHECK_EQUAL(name, "job1");
+  BOOST_CHECK(queue.Finish("job1"));
+
+  boost::filesystem::remove_all(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestFinishWithOutput) {
+  const std::string path = CreateTempPath();
+  FileJobQueue queue(path);
+  queue.Create("job1");
+  queue.Push("job1");
+
+  std::string name;
+  BOOST_CHECK(queue.Pop(&name));
+  const std::string output_path1 = queue.CreateOutput("job1");
+  BOOST_CHECK(ExistsDir(output_path1));
+  BOOST_CHECK_EQUAL(output_path1.find(queue.JobPath("job1")),
+                    std::string::npos);
+
+  // The first consumer loses its lease and the job is claimed by another
+  // consumer, which finishes the job first.
+  boost::filesystem::last_write_time(queue.JobPath("job1"),
+                                     std::time(nullptr) - 120);
+  BOOST_CHECK_EQUAL(queue.RequeueStale(60).size(), 1);
+  BOOST_CHECK(queue.Pop(&name));
+  const std::string output_path2 = queue.CreateOutput("job1");
+  BOOST_CHECK_NE(output_path1, output_path2);
+  {
+    std::ofstream file(JoinPaths(output_path2, "output.txt"));
+    file << "output";
+  }
+  BOOST_CHECK(queue.Finish("job1", output_path2, "output"));
+  BOOST_CHECK(!ExistsDir(output_path2));
+  BOOST_CHECK(ExistsFile(JoinPaths(queue.JobPath("job1"), "output",
+                                   "output.txt")));
+
+  // The output of the first consumer is discarded.
+  BOOST_CHECK(!queue.Finish("job1", output_path1, "output"));
+  BOOST_CHECK(!ExistsDir(output_path1));
+  BOOST_CHECK_EQUAL(queue.Jobs(FileJobQueue::JobStatus::FINISHED).at(0),
+                    "job1");
+
+  boost::filesystem::remove_all(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestConcurrentPop) {
+  const std::string path = CreateTempPath();
+  const int kNumJobs = 100;
+
+  {
+    FileJobQueue queue(path);
+    for (int i = 0; i < kNumJobs; ++i) {
+      const std::string name = "job" + std::to_string(i);
+      queue.Create(name);
+      queue.Push(name);
+    }
+  }
+
+  // Every job must be claimed by exactly one of the consumers.
+  const int kNumConsumers = 4;
+  std::vector<std::vector<std::string>> consumer_names(kNumConsumers);
+  ThreadPool thread_pool(kNumConsumers);
+  for (int i = 0; i < kNumConsumers; ++i) {
+    thread_pool.AddTask([&path, &consumer_names, i]() {
+      FileJobQueue queue(path);
+      std::string name;
+      while (queue.Pop(&name)) {
+        consumer_names[i].push_back(name);
+        queue.Finish(name);
+      }
+    });
+  }
+  thread_pool.Wait();
+
+  std::set<std::string> names;
+  for (const auto& consumer_name : consumer_names) {
+    for (const auto& name : consumer_name) {
+      BOOST_CHECK(names.insert(name).second);
+    }
+  }
+  BOOST_CHECK_EQUAL(names.size(), kNumJobs);
+
+  FileJobQueue queue(path);
+  BOOST_CHECK_EQUAL(queue.Jobs(FileJobQueue::JobStatus::FINISHED).size(),
+                    kNumJobs);
+  BOOST_CHECK_EQUAL(queue.Jobs(FileJobQueue::JobStatus::PENDING).size(), 0);
+
+  boost::filesystem::remove_all(path);
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include "util/mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "util/logging.h"
+
+namespace colmap {
+
+MappedFile::MappedFile(const std::string& path)
+    : data_(nullptr), num_bytes_(0) {
+#ifdef _WIN32
+  HANDLE file_handle = CreateFileA(
+      path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  CHECK(file_handle != INVALID_HANDLE_VALUE) << path;
+  LARGE_INTEGER file_size;
+  CHECK(GetFileSizeEx(file_handle, &file_size)) << path;
+  num_bytes_ = static_cast<size_t>(file_size.QuadPart);
+  CHECK_GT(num_bytes_, 0) << path;
+  HANDLE mapping_handle =
+      CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CHECK(mapping_handle != nullptr) << path;
+  data_ = static_cast<const uint8_t*>(
+      MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+  CHECK(data_ != nullptr) << path;
+  // The view keeps the mapping alive after closing the handles.
+  CloseHandle(mapping_handle);
+  CloseHandle(file_handle);
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  CHECK_GE(fd, 0) << path;
+  struct stat file_stat;
+  CHECK_EQ(fstat(fd, &file_stat), 0) << path;
+  num_bytes_ = static_cast<size_t>(file_stat.st_size);
+  CHECK_GT(num_bytes_, 0) << path;
+  void* data = mmap(nullptr, num_bytes_, PROT_READ, MAP_SHARED, fd, 0);
+  CHECK(data != MAP_FAILED) << path;
+  data_ = static_cast<const uint8_t*>(data);
+  // The mapping stays valid after closing the file descriptor.
+  close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+#else
+  munmap(const_cast<uint8_t*>(data_), num_bytes_);
+#endif
+}
+
+}  // namespace colmap
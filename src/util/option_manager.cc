@@ -245,9 +245,19 @@ void OptionManager::AddExtractionOptions() {
                               &image_reader->default_focal_length_factor);
   AddAndRegisterDefaultOption("ImageReader.camera_mask_path",
                               &image_reader->camera_mask_path);
+  AddAndRegisterDefaultOption("ImageReader.num_threads",
+                              &image_reader->num_threads);
+  AddAndRegisterDefaultOption("ImageReader.prefetch_depth",
+                              &image_reader->prefetch_depth);
+  AddAndRegisterDefaultOption("ImageReader.prefetch_memory",
+                              &image_reader->prefetch_memory);
 
   AddAndRegisterDefaultOption("SiftExtraction.num_threads",
                               &sift_extraction->num_threads);
+  AddAndRegisterDefaultOption("SiftExtraction.num_threads_per_image",
+                              &sift_extraction->num_threads_per_image);
+  AddAndRegisterDefaultOption("SiftExtraction.max_tile_memory",
+                              &sift_extraction->max_tile_memory);
   AddAndRegisterDefaultOption("SiftExtraction.use_gpu",
                               &sift_extraction->use_gpu);
   AddAndRegisterDefaultOption("SiftExtraction.gpu_index",
@@ -299,6 +309,8 @@ void OptionManager::AddMatchingOptions() {
                               &sift_matching->max_distance);
   AddAndRegisterDefaultOption("SiftMatching.cross_check",
                               &sift_matching->cross_check);
+  AddAndRegisterDefaultOption("SiftMatching.cpu_brute_force_matcher",
+                              &sift_matching->cpu_brute_force_matcher);
   AddAndRegisterDefaultOption("SiftMatching.max_error",
                               &sift_matching->max_error);
   AddAndRegisterDefaultOption("SiftMatching.max_num_matches",
@@ -315,6 +327,8 @@ void OptionManager::AddMatchingOptions() {
                               &sift_matching->multiple_models);
   AddAndRegisterDefaultOption("SiftMatching.guided_matching",
                               &sift_matching->guided_matching);
+  AddAndRegisterDefaultOption("SiftMatching.write_batch_size",
+                              &sift_matching->write_batch_size);
 }
 
 void OptionManager::AddExhaustiveMatchingOptions() {
@@ -403,6 +417,8 @@ void OptionManager::AddSpatialMatchingOptions() {
                               &spatial_matching->max_num_neighbors);
   AddAndRegisterDefaultOption("SpatialMatching.max_distance",
                               &spatial_matching->max_distance);
+  AddAndRegisterDefaultOption("SpatialMatching.max_viewing_angle",
+                              &spatial_matching->max_viewing_angle);
 }
 
 void OptionManager::AddTransitiveMatchingOptions() {
@@ -448,6 +464,8 @@ void OptionManager::AddBundleAdjustmentOptions() {
                               &bundle_adjustment->refine_extra_params);
   AddAndRegisterDefaultOption("BundleAdjustment.refine_extrinsics",
                               &bundle_adjustment->refine_extrinsics);
+  AddAndRegisterDefaultOption("BundleAdjustment.auto_select_solver",
+                              &bundle_adjustment->auto_select_solver);
 }
 
 void OptionManager::AddMapperOptions() {
@@ -472,6 +490,8 @@ void OptionManager::AddMapperOptions() {
                               &mapper->init_num_trials);
   AddAndRegisterDefaultOption("Mapper.extract_colors", &mapper->extract_colors);
   AddAndRegisterDefaultOption("Mapper.num_threads", &mapper->num_threads);
+  AddAndRegisterDefaultOption("Mapper.abs_pose_ransac_num_threads",
+                              &mapper->abs_pose_ransac_num_threads);
   AddAndRegisterDefaultOption("Mapper.min_focal_length_ratio",
                               &mapper->min_focal_length_ratio);
   AddAndRegisterDefaultOption("Mapper.max_focal_length_ratio",
@@ -491,6 +511,8 @@ void OptionManager::AddMapperOptions() {
                               &mapper->ba_local_num_images);
   AddAndRegisterDefaultOption("Mapper.ba_local_max_num_iterations",
                               &mapper->ba_local_max_num_iterations);
+  AddAndRegisterDefaultOption("Mapper.ba_local_reuse_problem",
+                              &mapper->ba_local_reuse_problem);
   AddAndRegisterDefaultOption("Mapper.ba_global_use_pba",
                               &mapper->ba_global_use_pba);
   AddAndRegisterDefaultOption("Mapper.ba_global_pba_gpu_index",
@@ -505,6 +527,8 @@ void OptionManager::AddMapperOptions() {
                               &mapper->ba_global_points_freq);
   AddAndRegisterDefaultOption("Mapper.ba_global_max_num_iterations",
                               &mapper->ba_global_max_num_iterations);
+  AddAndRegisterDefaultOption("Mapper.ba_global_async",
+                              &mapper->ba_global_async);
   AddAndRegisterDefaultOption("Mapper.ba_global_max_refinements",
                               &mapper->ba_global_max_refinements);
   AddAndRegisterDefaultOption("Mapper.ba_global_max_refinement_change",
@@ -576,6 +600,10 @@ void OptionManager::AddPatchMatchStereoOptions() {
 
   AddAndRegisterDefaultOption("PatchMatchStereo.max_image_size",
                               &patch_match_stereo->max_image_size);
+  AddAndRegisterDefaultOption("PatchMatchStereo.use_gpu",
+                              &patch_match_stereo->use_gpu);
+  AddAndRegisterDefaultOption("PatchMatchStereo.num_threads",
+                              &patch_match_stereo->num_threads);
   AddAndRegisterDefaultOption("PatchMatchStereo.gpu_index",
                               &patch_match_stereo->gpu_index);
   AddAndRegisterDefaultOption("PatchMatchStereo.depth_min",
@@ -649,6 +677,8 @@ void OptionManager::AddStereoFusionOptions() {
                               &stereo_fusion->check_num_images);
   AddAndRegisterDefaultOption("StereoFusion.cache_size",
                               &stereo_fusion->cache_size);
+  AddAndRegisterDefaultOption("StereoFusion.num_threads",
+                              &stereo_fusion->num_threads);
 }
 
 void OptionManager::AddPoissonMeshingOptions() {
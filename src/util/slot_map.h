@@ -0,0 +1,581 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_UTIL_SLOT_MAP_H_
+#define COLMAP_SRC_UTIL_SLOT_MAP_H_
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace colmap {
+
+// Associative container for dense, integral identifiers, such as the image and
+// 3D point identifiers of a reconstruction, with the interface of a subset of
+// `std::unordered_map`. The elements are stored in blocks of `kBlockSize`
+// consecutive identifiers, which are allocated on demand. Lookups are a single
+// index computation and iteration traverses contiguous memory in identifier
+// order. As for `std::unordered_map`, references to elements stay valid when
+// other elements are inserted or erased, while iterators may be invalidated by
+// insertions.
+//
+// Memory is allocated for the entire identifier range of a block. To bound the
+// memory for sparse or large identifiers, e.g., of imported models, a new block
+// is only allocated while the blocks hold at least one element per
+// `kMaxNumSlotsPerElement` slots. Other elements are stored in a hash map and
+// visited after the elements in blocks during iteration.
+template <typename Key, typename Value, size_t kBlockSize = 256>
+class SlotMap {
+ public:
+  static_assert(std::is_integral<Key>::value, "Key must be integral");
+
+  typedef Key key_type;
+  typedef Value mapped_type;
+  typedef std::pair<const Key, Value> value_type;
+  typedef size_t size_type;
+
+  template <bool kConst>
+  class Iterator;
+  typedef Iterator<false> iterator;
+  typedef Iterator<true> const_iterator;
+
+  SlotMap();
+  SlotMap(const SlotMap& other);
+  SlotMap(SlotMap&& other);
+  ~SlotMap();
+
+  SlotMap& operator=(const SlotMap& other);
+  SlotMap& operator=(SlotMap&& other);
+
+  size_t size() const;
+  bool empty() const;
+
+  // The number of slots in all allocated blocks.
+  size_t capacity() const;
+
+  // The number of elements, which are not stored in blocks.
+  size_t num_sparse_elements() const;
+
+  void clear();
+
+  // Only a hint, since memory is allocated per identifier range.
+  void reserve(const size_t num_elements);
+
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  size_t count(const Key& key) const;
+  iterator find(const Key& key);
+  const_iterator find(const Key& key) const;
+
+  Value& at(const Key& key);
+  const Value& at(const Key& key) const;
+  Value& operator[](const Key& key);
+
+  // Construct the value from the given arguments, if the key does not exist.
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(const Key& key, Args&&... args);
+
+  size_t erase(const Key& key);
+  iterator erase(const_iterator pos);
+
+ private:
+  typedef std::unordered_map<Key, Value, std::hash<Key>, std::equal_to<Key>,
+                             Eigen::aligned_allocator<value_type>>
+      SparseMap;
+
+ public:
+  template <bool kConst>
+  class Iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename SlotMap::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename std::conditional<kConst, const value_type*,
+                                      value_type*>::type pointer;
+    typedef typename std::conditional<kConst, const value_type&,
+                                      value_type&>::type reference;
+
+    Iterator() : map_(nullptr), idx_(0) {}
+
+    operator Iterator<true>() const {
+      return Iterator<true>(map_, idx_, sparse_it_);
+    }
+
+    reference operator*() const { return *operator->(); }
+    pointer operator->() const {
+      return idx_ < map_->EndIndex() ? map_->Slot(idx_) : &*sparse_it_;
+    }
+
+    Iterator& operator++() {
+      if (idx_ < map_->EndIndex()) {
+        idx_ = map_->NextIndex(idx_ + 1);
+        if (idx_ == map_->EndIndex()) {
+          sparse_it_ = map_->sparse_elements_.begin();
+        }
+      } else {
+        ++sparse_it_;
+      }
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      const Iterator it = *this;
+      ++(*this);
+      return it;
+    }
+
+    template <bool kOtherConst>
+    bool operator==(const Iterator<kOtherConst>& other) const {
+      return idx_ == other.idx_ &&
+             (idx_ < map_->EndIndex() || sparse_it_ == other.sparse_it_);
+    }
+
+    template <bool kOtherConst>
+    bool operator!=(const Iterator<kOtherConst>& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class SlotMap;
+    template <bool kOtherConst>
+    friend class Iterator;
+
+    typedef typename std::conditional<kConst, const SlotMap*, SlotMap*>::type
+        MapPointer;
+    typedef typename std::conditional<kConst,
+                                      typename SparseMap::const_iterator,
+                                      typename SparseMap::iterator>::type
+        SparseIterator;
+
+    // Iterator to the element in a block at the given index or, if the index
+    // is the end of the blocks, to the first element in the hash map.
+    Iterator(MapPointer map, const size_t idx) : map_(map), idx_(idx) {
+      if (idx_ == map_->EndIndex()) {
+        sparse_it_ = map_->sparse_elements_.begin();
+      }
+    }
+
+    Iterator(MapPointer map, const size_t idx, SparseIterator sparse_it)
+        : map_(map), idx_(idx), sparse_it_(sparse_it) {}
+
+    MapPointer map_;
+    size_t idx_;
+    SparseIterator sparse_it_;
+  };
+
+ private:
+  struct Block {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    Block() : num_elements(0) {
+      std::fill(occupied, occupied + kBlockSize, false);
+    }
+
+    typename std::aligned_storage<sizeof(value_type),
+                                  alignof(value_type)>::type slots[kBlockSize];
+    bool occupied[kBlockSize];
+    size_t num_elements;
+  };
+
+  // Minimum number of blocks that can be allocated regardless of the number
+  // of elements and maximum number of slots per element in blocks beyond.
+  static const size_t kMinNumBlocks = 4;
+  static const size_t kMaxNumSlotsPerElement = 8;
+
+  // Whether an element with the given index is stored in a block.
+  bool IsDenseIndex(const size_t idx) const;
+
+  bool IsOccupied(const size_t idx) const;
+  value_type* Slot(const size_t idx);
+  const value_type* Slot(const size_t idx) const;
+
+  // Index of the first element at or after the given index.
+  size_t NextIndex(size_t idx) const;
+  size_t EndIndex() const;
+
+  void CopyFrom(const SlotMap& other);
+
+  std::vector<std::unique_ptr<Block>> blocks_;
+  size_t num_blocks_;
+  size_t num_dense_elements_;
+  SparseMap sparse_elements_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename Key, typename Value, size_t kBlockSize>
+SlotMap<Key, Value, kBlockSize>::SlotMap()
+    : num_blocks_(0), num_dense_elements_(0) {}
+
+template <typename Key, typename Value, size_t kBlockSize>
+SlotMap<Key, Value, kBlockSize>::SlotMap(const SlotMap& other)
+    : num_blocks_(0), num_dense_elements_(0) {
+  CopyFrom(other);
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+SlotMap<Key, Value, kBlockSize>::SlotMap(SlotMap&& other)
+    : blocks_(std::move(other.blocks_)),
+      num_blocks_(other.num_blocks_),
+      num_dense_elements_(other.num_dense_elements_),
+      sparse_elements_(std::move(other.sparse_elements_)) {
+  other.blocks_.clear();
+  other.num_blocks_ = 0;
+  other.num_dense_elements_ = 0;
+  other.sparse_elements_.clear();
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+SlotMap<Key, Value, kBlockSize>::~SlotMap() {
+  clear();
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+SlotMap<Key, Value, kBlockSize>& SlotMap<Key, Value, kBlockSize>::operator=(
+    const SlotMap& other) {
+  if (this != &other) {
+    clear();
+    CopyFrom(other);
+  }
+  return *this;
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+SlotMap<Key, Value, kBlockSize>& SlotMap<Key, Value, kBlockSize>::operator=(
+    SlotMap&& other) {
+  if (this != &other) {
+    clear();
+    blocks_ = std::move(other.blocks_);
+    num_blocks_ = other.num_blocks_;
+    num_dense_elements_ = other.num_dense_elements_;
+    sparse_elements_ = std::move(other.sparse_elements_);
+    other.blocks_.clear();
+    other.num_blocks_ = 0;
+    other.num_dense_elements_ = 0;
+    other.sparse_elements_.clear();
+  }
+  return *this;
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+size_t SlotMap<Key, Value, kBlockSize>::size() const {
+  return num_dense_elements_ + sparse_elements_.size();
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+bool SlotMap<Key, Value, kBlockSize>::empty() const {
+  return size() == 0;
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+size_t SlotMap<Key, Value, kBlockSize>::capacity() const {
+  return num_blocks_ * kBlockSize;
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+size_t SlotMap<Key, Value, kBlockSize>::num_sparse_elements() const {
+  return sparse_elements_.size();
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+void SlotMap<Key, Value, kBlockSize>::clear() {
+  for (size_t idx = NextIndex(0); idx < EndIndex(); idx = NextIndex(idx + 1)) {
+    Slot(idx)->~value_type();
+  }
+  blocks_.clear();
+  num_blocks_ = 0;
+  num_dense_elements_ = 0;
+  sparse_elements_.clear();
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+void SlotMap<Key, Value, kBlockSize>::reserve(const size_t num_elements) {
+  blocks_.reserve((num_elements + kBlockSize - 1) / kBlockSize);
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+typename SlotMap<Key, Value, kBlockSize>::iterator
+SlotMap<Key, Value, kBlockSize>::begin() {
+  return iterator(this, NextIndex(0));
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+typename SlotMap<Key, Value, kBlockSize>::iterator
+SlotMap<Key, Value, kBlockSize>::end() {
+  return iterator(this, EndIndex(), sparse_elements_.end());
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+typename SlotMap<Key, Value, kBlockSize>::const_iterator
+SlotMap<Key, Value, kBlockSize>::begin() const {
+  return const_iterator(this, NextIndex(0));
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+typename SlotMap<Key, Value, kBlockSize>::const_iterator
+SlotMap<Key, Value, kBlockSize>::end() const {
+  return const_iterator(this, EndIndex(), sparse_elements_.end());
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+size_t SlotMap<Key, Value, kBlockSize>::count(const Key& key) const {
+  return IsOccupied(static_cast<size_t>(key)) ? 1
+                                              : sparse_elements_.count(key);
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+typename SlotMap<Key, Value, kBlockSize>::iterator
+SlotMap<Key, Value, kBlockSize>::find(const Key& key) {
+  const size_t idx = static_cast<size_t>(key);
+  if (IsOccupied(idx)) {
+    return iterator(this, idx);
+  }
+  return iterator(this, EndIndex(), sparse_elements_.find(key));
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+typename SlotMap<Key, Value, kBlockSize>::const_iterator
+SlotMap<Key, Value, kBlockSize>::find(const Key& key) const {
+  const size_t idx = static_cast<size_t>(key);
+  if (IsOccupied(idx)) {
+    return const_iterator(this, idx);
+  }
+  return const_iterator(this, EndIndex(), sparse_elements_.find(key));
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+Value& SlotMap<Key, Value, kBlockSize>::at(const Key& key) {
+  const size_t idx = static_cast<size_t>(key);
+  if (IsOccupied(idx)) {
+    return Slot(idx)->second;
+  }
+  const auto it = sparse_elements_.find(key);
+  if (it == sparse_elements_.end()) {
+    throw std::out_of_range("SlotMap::at");
+  }
+  return it->second;
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+const Value& SlotMap<Key, Value, kBlockSize>::at(const Key& key) const {
+  const size_t idx = static_cast<size_t>(key);
+  if (IsOccupied(idx)) {
+    return Slot(idx)->second;
+  }
+  const auto it = sparse_elements_.find(key);
+  if (it == sparse_elements_.end()) {
+    throw std::out_of_range("SlotMap::at");
+  }
+  return it->second;
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+Value& SlotMap<Key, Value, kBlockSize>::operator[](const Key& key) {
+  return emplace(key).first->second;
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+template <typename... Args>
+std::pair<typename SlotMap<Key, Value, kBlockSize>::iterator, bool>
+SlotMap<Key, Value, kBlockSize>::emplace(const Key& key, Args&&... args) {
+  const size_t idx = static_cast<size_t>(key);
+  if (IsOccupied(idx)) {
+    return std::make_pair(iterator(this, idx), false);
+  }
+
+  // An element in the hash map stays there, even if its block was allocated
+  // after its insertion.
+  const auto sparse_it = sparse_elements_.find(key);
+  if (sparse_it != sparse_elements_.end()) {
+    return std::make_pair(iterator(this, EndIndex(), sparse_it), false);
+  }
+
+  if (!IsDenseIndex(idx)) {
+    const auto inserted = sparse_elements_.emplace(
+        std::piecewise_construct, std::forward_as_tuple(key),
+        std::forward_as_tuple(std::forward<Args>(args)...));
+    return std::make_pair(iterator(this, EndIndex(), inserted.first), true);
+  }
+
+  const size_t block_idx = idx / kBlockSize;
+  const size_t slot_idx = idx % kBlockSize;
+
+  if (block_idx >= blocks_.size()) {
+    blocks_.resize(block_idx + 1);
+  }
+
+  std::unique_ptr<Block>& block = blocks_[block_idx];
+  if (!block) {
+    block.reset(new Block());
+    num_blocks_ += 1;
+  }
+
+  new (&block->slots[slot_idx])
+      value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                 std::forward_as_tuple(std::forward<Args>(args)...));
+  block->occupied[slot_idx] = true;
+  block->num_elements += 1;
+  num_dense_elements_ += 1;
+
+  return std::make_pair(iterator(this, idx), true);
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+size_t SlotMap<Key, Value, kBlockSize>::erase(const Key& key) {
+  const size_t idx = static_cast<size_t>(key);
+  if (!IsOccupied(idx)) {
+    return sparse_elements_.erase(key);
+  }
+
+  std::unique_ptr<Block>& block = blocks_[idx / kBlockSize];
+  Slot(idx)->~value_type();
+  block->occupied[idx % kBlockSize] = false;
+  block->num_elements -= 1;
+  num_dense_elements_ -= 1;
+
+  // Release empty blocks, which does not affect references to other elements.
+  if (block->num_elements == 0) {
+    block.reset();
+    num_blocks_ -= 1;
+  }
+
+  return 1;
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+typename SlotMap<Key, Value, kBlockSize>::iterator
+SlotMap<Key, Value, kBlockSize>::erase(const_iterator pos) {
+  const size_t idx = pos.idx_;
+  if (idx == EndIndex()) {
+    return iterator(this, idx, sparse_elements_.erase(pos.sparse_it_));
+  }
+  erase(static_cast<Key>(idx));
+  return iterator(this, NextIndex(idx + 1));
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+bool SlotMap<Key, Value, kBlockSize>::IsDenseIndex(const size_t idx) const {
+  const size_t block_idx = idx / kBlockSize;
+  if (block_idx < blocks_.size() && blocks_[block_idx]) {
+    return true;
+  }
+
+  // Both the allocated blocks and the pointers to all blocks up to the new
+  // one must not exceed the slot budget of the elements. The division avoids
+  // overflow for large identifiers.
+  const size_t max_num_slots = kMinNumBlocks * kBlockSize +
+                               kMaxNumSlotsPerElement * (num_dense_elements_ + 1);
+  return (num_blocks_ + 1) * kBlockSize <= max_num_slots &&
+         block_idx < max_num_slots;
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+bool SlotMap<Key, Value, kBlockSize>::IsOccupied(const size_t idx) const {
+  const size_t block_idx = idx / kBlockSize;
+  return block_idx < blocks_.size() && blocks_[block_idx] &&
+         blocks_[block_idx]->occupied[idx % kBlockSize];
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+typename SlotMap<Key, Value, kBlockSize>::value_type*
+SlotMap<Key, Value, kBlockSize>::Slot(const size_t idx) {
+  return reinterpret_cast<value_type*>(
+      &blocks_[idx / kBlockSize]->slots[idx % kBlockSize]);
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+const typename SlotMap<Key, Value, kBlockSize>::value_type*
+SlotMap<Key, Value, kBlockSize>::Slot(const size_t idx) const {
+  return reinterpret_cast<const value_type*>(
+      &blocks_[idx / kBlockSize]->slots[idx % kBlockSize]);
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+size_t SlotMap<Key, Value, kBlockSize>::NextIndex(size_t idx) const {
+  const size_t end_idx = EndIndex();
+  while (idx < end_idx) {
+    const Block* block = blocks_[idx / kBlockSize].get();
+    if (block == nullptr) {
+      idx = (idx / kBlockSize + 1) * kBlockSize;
+    } else if (block->occupied[idx % kBlockSize]) {
+      return idx;
+    } else {
+      idx += 1;
+    }
+  }
+  return end_idx;
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+size_t SlotMap<Key, Value, kBlockSize>::EndIndex() const {
+  return blocks_.size() * kBlockSize;
+}
+
+template <typename Key, typename Value, size_t kBlockSize>
+void SlotMap<Key, Value, kBlockSize>::CopyFrom(const SlotMap& other) {
+  blocks_.resize(other.blocks_.size());
+  for (size_t block_idx = 0; block_idx < other.blocks_.size(); ++block_idx) {
+    const Block* other_block = other.blocks_[block_idx].get();
+    if (other_block == nullptr) {
+      continue;
+    }
+    Block* block = new Block();
+    blocks_[block_idx].reset(block);
+    for (size_t slot_idx = 0; slot_idx < kBlockSize; ++slot_idx) {
+      if (other_block->occupied[slot_idx]) {
+        new (&block->slots[slot_idx]) value_type(*reinterpret_cast<
+            const value_type*>(&other_block->slots[slot_idx]));
+        block->occupied[slot_idx] = true;
+      }
+    }
+    block->num_elements = other_block->num_elements;
+  }
+  num_blocks_ = other.num_blocks_;
+  num_dense_elements_ = other.num_dense_elements_;
+  sparse_elements_ = other.sparse_elements_;
+}
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_UTIL_SLOT_MAP_H_
@@ -0,0 +1,227 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "util/slot_map"
+#include "util/testing.h"
+
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "util/slot_map.h"
+
+using namespace colmap;
+
+BOOST_AUTO_TEST_CASE(TestEmpty) {
+  SlotMap<int, int> map;
+  BOOST_CHECK_EQUAL(map.size(), 0);
+  BOOST_CHECK(map.empty());
+  BOOST_CHECK_EQUAL(map.capacity(), 0);
+  BOOST_CHECK(map.begin() == map.end());
+  BOOST_CHECK_EQUAL(map.count(0), 0);
+  BOOST_CHECK(map.find(0) == map.end());
+  BOOST_CHECK_THROW(map.at(0), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(TestEmplaceFindErase) {
+  SlotMap<size_t, std::string, 4> map;
+
+  BOOST_CHECK(map.emplace(1, "1").second);
+  BOOST_CHECK(map.emplace(9, "9").second);
+  BOOST_CHECK(!map.emplace(9, "x").second);
+  BOOST_CHECK_EQUAL(map.size(), 2);
+  BOOST_CHECK_EQUAL(map.capacity(), 8);
+  BOOST_CHECK_EQUAL(map.at(9), "9");
+  BOOST_CHECK_EQUAL(map.count(1), 1);
+  BOOST_CHECK_EQUAL(map.count(2), 0);
+  BOOST_CHECK_EQUAL(map.count(100), 0);
+  BOOST_CHECK_EQUAL(map.find(1)->first, 1);
+  BOOST_CHECK_EQUAL(map.find(1)->second, "1");
+
+  map[4] = "4";
+  BOOST_CHECK_EQUAL(map.size(), 3);
+  BOOST_CHECK_EQUAL(map[4], "4");
+  BOOST_CHECK_EQUAL(map[5], "");
+  BOOST_CHECK_EQUAL(map.size(), 4);
+
+  BOOST_CHECK_EQUAL(map.erase(5), 1);
+  BOOST_CHECK_EQUAL(map.erase(5), 0);
+  BOOST_CHECK_EQUAL(map.size(), 3);
+  BOOST_CHECK_EQUAL(map.capacity(), 12);
+
+  // Empty blocks are released.
+  BOOST_CHECK_EQUAL(map.erase(4), 1);
+  BOOST_CHECK_EQUAL(map.capacity(), 8);
+
+  map.clear();
+  BOOST_CHECK(map.empty());
+  BOOST_CHECK_EQUAL(map.capacity(), 0);
+  BOOST_CHECK(map.begin() == map.end());
+}
+
+BOOST_AUTO_TEST_CASE(TestIterate) {
+  SlotMap<int, int, 4> map;
+  for (const int key : {13, 2, 0, 7, 3}) {
+    map.emplace(key, 2 * key);
+  }
+
+  std::vector<int> keys;
+  for (const auto& elem : map) {
+    BOOST_CHECK_EQUAL(elem.second, 2 * elem.first);
+    keys.push_back(elem.first);
+  }
+  BOOST_CHECK(keys == std::vector<int>({0, 2, 3, 7, 13}));
+
+  for (auto it = map.begin(); it != map.end();) {
+    if (it->first % 2 == 1) {
+      it = map.erase(it);
+    } else {
+      it->second += 1;
+      ++it;
+    }
+  }
+
+  const SlotMap<int, int, 4>& const_map = map;
+  keys.clear();
+  for (auto it = const_map.begin(); it != const_map.end(); ++it) {
+    BOOST_CHECK_EQUAL(it->second, 2 * it->first + 1);
+    keys.push_back(it->first);
+  }
+  BOOST_CHECK(keys == std::vector<int>({0, 2}));
+}
+
+BOOST_AUTO_TEST_CASE(TestReferenceStability) {
+  SlotMap<int, int, 4> map;
+  int& value = map[1];
+  value = 42;
+  for (int key = 2; key < 1000; ++key) {
+    map.emplace(key, key);
+  }
+  for (int key = 2; key < 1000; key += 2) {
+    map.erase(key);
+  }
+  BOOST_CHECK_EQUAL(&value, &map.at(1));
+  BOOST_CHECK_EQUAL(value, 42);
+}
+
+BOOST_AUTO_TEST_CASE(TestCopyMove) {
+  SlotMap<int, std::shared_ptr<int>, 4> map;
+  map.emplace(1, std::make_shared<int>(1));
+  map.emplace(10, std::make_shared<int>(10));
+
+  SlotMap<int, std::shared_ptr<int>, 4> map_copy(map);
+  BOOST_CHECK_EQUAL(map_copy.size(), 2);
+  BOOST_CHECK_EQUAL(*map_copy.at(10), 10);
+  BOOST_CHECK_EQUAL(map.at(10).use_count(), 2);
+
+  map_copy = map;
+  BOOST_CHECK_EQUAL(map_copy.size(), 2);
+  BOOST_CHECK_EQUAL(map.at(10).use_count(), 2);
+
+  SlotMap<int, std::shared_ptr<int>, 4> map_move(std::move(map_copy));
+  BOOST_CHECK_EQUAL(map_move.size(), 2);
+  BOOST_CHECK(map_copy.empty());
+  BOOST_CHECK_EQUAL(map.at(10).use_count(), 2);
+
+  map_move.clear();
+  BOOST_CHECK_EQUAL(map.at(1).use_count(), 1);
+
+  map_copy = std::move(map);
+  BOOST_CHECK(map.empty());
+  BOOST_CHECK_EQUAL(map_copy.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(TestSparseKeys) {
+  SlotMap<uint64_t, int, 4> map;
+
+  // The first blocks are allocated regardless of the density.
+  BOOST_CHECK(map.emplace(1, 1).second);
+  BOOST_CHECK(map.emplace(15, 15).second);
+  BOOST_CHECK_EQUAL(map.capacity(), 8);
+  BOOST_CHECK_EQUAL(map.num_sparse_elements(), 0);
+
+  // Large and sparse keys do not allocate blocks.
+  const uint64_t kLargeKey = std::numeric_limits<uint64_t>::max() - 1;
+  BOOST_CHECK(map.emplace(kLargeKey, 2).second);
+  BOOST_CHECK(!map.emplace(kLargeKey, 3).second);
+  for (uint64_t key = 1000; key < 100000; key += 1000) {
+    BOOST_CHECK(map.emplace(key, static_cast<int>(key)).second);
+  }
+  BOOST_CHECK_LE(map.capacity(), 16 + 8 * map.size());
+  BOOST_CHECK_GT(map.num_sparse_elements(), 0);
+  BOOST_CHECK_EQUAL(map.size(), 102);
+
+  BOOST_CHECK_EQUAL(map.count(kLargeKey), 1);
+  BOOST_CHECK_EQUAL(map.at(kLargeKey), 2);
+  BOOST_CHECK_EQUAL(map.find(kLargeKey)->second, 2);
+  BOOST_CHECK_EQUAL(map[99000], 99000);
+  BOOST_CHECK(map.find(kLargeKey - 1) == map.end());
+  BOOST_CHECK_THROW(map.at(kLargeKey - 1), std::out_of_range);
+
+  // Dense keys are still stored in blocks.
+  const size_t num_sparse_elements = map.num_sparse_elements();
+  for (uint64_t key = 16; key < 400; ++key) {
+    map.emplace(key, static_cast<int>(key));
+  }
+  BOOST_CHECK_EQUAL(map.num_sparse_elements(), num_sparse_elements);
+
+  // All elements are visited and can be erased during iteration.
+  size_t num_elements = 0;
+  for (auto it = map.begin(); it != map.end();) {
+    num_elements += 1;
+    if (it->first >= 1000) {
+      it = map.erase(it);
+    } else {
+      BOOST_CHECK_EQUAL(it->second, static_cast<int>(it->first));
+      ++it;
+    }
+  }
+  BOOST_CHECK_EQUAL(num_elements, 102 + 384);
+  BOOST_CHECK_EQUAL(map.size(), 2 + 384);
+  BOOST_CHECK_EQUAL(map.num_sparse_elements(), 0);
+
+  const SlotMap<uint64_t, int, 4> map_copy(map);
+  BOOST_CHECK_EQUAL(map_copy.size(), map.size());
+  BOOST_CHECK_EQUAL(map_copy.at(399), 399);
+}
+
+BOOST_AUTO_TEST_CASE(TestAlignment) {
+  SlotMap<int, Eigen::Vector4d, 4> map;
+  for (int key = 0; key < 10; ++key) {
+    map.emplace(key, Eigen::Vector4d::Constant(key));
+  }
+  for (const auto& elem : map) {
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(elem.second.data()) %
+                          EIGEN_MAX_ALIGN_BYTES,
+                      0);
+    BOOST_CHECK_EQUAL(elem.second(3), elem.first);
+  }
+}
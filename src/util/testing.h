@@ -44,4 +44,23 @@
 
 #include <boost/test/unit_test.hpp>
 
+#ifndef __CUDACC__
+
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+namespace colmap {
+
+// Return a unique path in the temporary directory, which does not exist yet.
+inline std::string CreateTempPath() {
+  return (boost::filesystem::temp_directory_path() /
+          boost::filesystem::unique_path())
+      .string();
+}
+
+}  // namespace colmap
+
+#endif  // __CUDACC__
+
 #endif  // COLMAP_SRC_UTIL_TESTING_H_